@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2024-08-27     Evlers       first implementation
+ * 2024-10-19     Evlers       add hot-path placement into SRAM and TCMSRAM
  */
 
 #ifndef __BOARD_H__
@@ -49,4 +50,21 @@ extern int __bss_end;
 
 #define HEAP_END                        GD32_SRAM_END
 
+/*
+ * Hot-path placement:
+ * RT_SECTION_FASTCODE: the function is copied to SRAM by the startup code and executed from there.
+ * RT_SECTION_FASTDATA: initialized data placed in TCMSRAM.
+ * RT_SECTION_FASTBSS : zero initialized data (e.g. thread stacks) placed in TCMSRAM.
+ * Note: TCMSRAM can only be accessed by the data bus of the core, DMA can not access it.
+ */
+#if defined(__ICCARM__)
+#define RT_SECTION_FASTCODE             __ramfunc
+#define RT_SECTION_FASTDATA             _Pragma("location=\".sram\"")
+#define RT_SECTION_FASTBSS              _Pragma("location=\".sram\"")
+#else
+#define RT_SECTION_FASTCODE             __attribute__((section(".ramfunc"), noinline))
+#define RT_SECTION_FASTDATA             __attribute__((section(".sram")))
+#define RT_SECTION_FASTBSS              __attribute__((section(".bss.sram")))
+#endif
+
 #endif
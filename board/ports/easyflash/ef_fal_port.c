@@ -48,7 +48,8 @@ static const ef_env default_env_set[] = {
 };
 
 static char log_buf[RT_CONSOLEBUF_SIZE];
-static struct rt_semaphore env_cache_lock;
+/* a mutex for the priority inheritance, the low priority GC holds it for a whole sector erasing */
+static struct rt_mutex env_cache_lock;
 static const struct fal_partition *part = NULL;
 
 /**
@@ -65,7 +66,7 @@ EfErrCode ef_port_init(ef_env const **default_env, size_t *default_env_size) {
     *default_env = default_env_set;
     *default_env_size = sizeof(default_env_set) / sizeof(default_env_set[0]);
 
-    rt_sem_init(&env_cache_lock, "env lock", 1, RT_IPC_FLAG_PRIO);
+    rt_mutex_init(&env_cache_lock, "env lock", RT_IPC_FLAG_PRIO);
 
     part = fal_partition_find(FAL_EF_PART_NAME);
     EF_ASSERT(part);
@@ -140,14 +141,14 @@ EfErrCode ef_port_write(uint32_t addr, const uint32_t *buf, size_t size) {
  * lock the ENV ram cache
  */
 void ef_port_env_lock(void) {
-    rt_sem_take(&env_cache_lock, RT_WAITING_FOREVER);
+    rt_mutex_take(&env_cache_lock, RT_WAITING_FOREVER);
 }
 
 /**
  * unlock the ENV ram cache
  */
 void ef_port_env_unlock(void) {
-    rt_sem_release(&env_cache_lock);
+    rt_mutex_release(&env_cache_lock);
 }
 
 /**
@@ -211,4 +212,38 @@ void ef_print(const char *format, ...) {
     va_end(args);
 }
 
+#ifdef EF_ENV_USING_INCREMENTAL_GC
+
+/* the background GC thread runs before the idle thread only */
+#define EF_GC_THREAD_PRIORITY          (RT_THREAD_PRIORITY_MAX - 2)
+#define EF_GC_THREAD_STACK_SIZE        2048
+/* the delay between two sectors collecting */
+#define EF_GC_BUSY_DELAY_MS            10
+/* the delay of checking the GC work */
+#define EF_GC_IDLE_DELAY_MS            100
+
+static void ef_gc_thread_entry(void *parameter) {
+    while (1) {
+        rt_thread_mdelay(ef_env_gc_step() ? EF_GC_BUSY_DELAY_MS : EF_GC_IDLE_DELAY_MS);
+    }
+}
+
+/**
+ * Start the background GC thread of ENV. It's after the easyflash_init in component initialization.
+ */
+static int ef_gc_thread_init(void) {
+    rt_thread_t tid;
+
+    tid = rt_thread_create("ef_gc", ef_gc_thread_entry, RT_NULL, EF_GC_THREAD_STACK_SIZE,
+            EF_GC_THREAD_PRIORITY, 10);
+    if (tid == RT_NULL) {
+        return -RT_ENOMEM;
+    }
+
+    return rt_thread_startup(tid);
+}
+INIT_APP_EXPORT(ef_gc_thread_init);
+
+#endif /* EF_ENV_USING_INCREMENTAL_GC */
+
 #endif /* PKG_USING_EASYFLASH */
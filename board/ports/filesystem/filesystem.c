@@ -7,6 +7,7 @@
  * Date         Author      Notes
  * 2024-01-27   Evlers      first implementation
  * 2024-07-14   Evlers      add support for sdcard and romfs
+ * 2024-10-21   Evlers      add the mount point of the usb disk
  */
 
 #include "rtthread.h"
@@ -38,6 +39,9 @@
 #ifdef RT_USING_DFS_ROMFS
 static const struct romfs_dirent _romfs_root[] = {
     {ROMFS_DIRENT_DIR, "flash", RT_NULL, 0},
+#ifdef BSP_USING_USBH
+    {ROMFS_DIRENT_DIR, "udisk", RT_NULL, 0},
+#endif
     {ROMFS_DIRENT_DIR, "sdcard", RT_NULL, 0}};
 
 const struct romfs_dirent romfs_root = {
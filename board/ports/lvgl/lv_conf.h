@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2006-2024, Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-22   Evlers      first implementation
+ */
+
+#ifndef LV_CONF_H
+#define LV_CONF_H
+
+#include <rtconfig.h>
+
+/* the draw buffers are the frame buffers of the lcd, the format must match them */
+#ifdef BSP_LCD_PIXEL_FORMAT_ARGB8888
+#define LV_COLOR_DEPTH          32
+#else
+#define LV_COLOR_DEPTH          16
+#endif
+#define LV_COLOR_16_SWAP        0
+
+/* the benchmark prints its report through the log */
+#define LV_USE_LOG              1
+#define LV_LOG_LEVEL            LV_LOG_LEVEL_WARN
+#define LV_LOG_PRINTF           0
+
+#ifdef PKG_LVGL_USING_DEMOS
+#define LV_USE_DEMO_BENCHMARK   1
+#endif
+
+#endif /* LV_CONF_H */
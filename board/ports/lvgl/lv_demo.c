@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2006-2024, Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-22   Evlers      first implementation
+ */
+
+#include <rtthread.h>
+#include <lvgl.h>
+
+#ifdef PKG_LVGL_USING_DEMOS
+#include <lv_demos.h>
+#endif
+
+#if LV_USE_DEMO_BENCHMARK
+extern void lv_port_disp_stats_reset(void);
+extern void lv_port_disp_stats_print(void);
+
+/* the statistics cover the scenes, the report screen is not counted */
+static void benchmark_finished (void)
+{
+    rt_kprintf("lvgl benchmark finished\n");
+    lv_port_disp_stats_print();
+}
+#endif /* LV_USE_DEMO_BENCHMARK */
+
+/* the application replaces the demo with its own gui */
+rt_weak void lv_user_gui_init (void)
+{
+#if LV_USE_DEMO_BENCHMARK
+    lv_port_disp_stats_reset();
+    lv_demo_benchmark_set_finished_cb(benchmark_finished);
+    lv_demo_benchmark();
+#endif
+}
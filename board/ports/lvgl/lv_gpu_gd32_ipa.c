@@ -0,0 +1,507 @@
+/*
+ * Copyright (c) 2006-2024, Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-22   Evlers      first implementation
+ */
+
+#include <board.h>
+#include <rthw.h>
+#include "lv_gpu_gd32_ipa.h"
+
+#ifdef BSP_LVGL_USING_IPA
+
+#include "delay.h"
+
+#define DBG_TAG             "lv.ipa"
+#define DBG_LVL             DBG_INFO
+#include "rtdbg.h"
+
+#if LV_COLOR_16_SWAP
+#error "the IPA can not draw byte swapped RGB565, disable LV_COLOR_16_SWAP"
+#endif
+
+#if LV_COLOR_DEPTH == 16
+#define IPA_FG_PF_NATIVE            FOREGROUND_PPF_RGB565
+#define IPA_BG_PF_NATIVE            BACKGROUND_PPF_RGB565
+#define IPA_DPF_NATIVE              IPA_DPF_RGB565
+#elif LV_COLOR_DEPTH == 32
+#define IPA_FG_PF_NATIVE            FOREGROUND_PPF_ARGB8888
+#define IPA_BG_PF_NATIVE            BACKGROUND_PPF_ARGB8888
+#define IPA_DPF_NATIVE              IPA_DPF_ARGB8888
+#else
+#error "the IPA draws only with a color depth of 16 or 32"
+#endif
+
+/* smaller areas are drawn faster by the cpu than the IPA is set up */
+#ifndef BSP_LVGL_IPA_MIN_PIXELS
+#define BSP_LVGL_IPA_MIN_PIXELS     64
+#endif
+
+/* the cpu sleeps on the completion interrupt for jobs from this size on, it polls smaller ones */
+#define IPA_IRQ_PIXELS              4096
+#define IPA_TIMEOUT                 (RT_TICK_PER_SECOND / 10)
+
+#define IPA_INT_ALL                 (IPA_INTC_TAEIFC | IPA_INTC_FTFIFC | IPA_INTC_TLMIFC | \
+                                     IPA_INTC_LACIFC | IPA_INTC_LLFIFC | IPA_INTC_WCFIFC)
+#define IPA_FG_ALPHA(opa)           ((rt_uint32_t)(opa) << 24)
+#define IPA_RGB888(color)           (lv_color_to32(color) & 0x00FFFFFF)
+
+static struct
+{
+    struct rt_semaphore done;
+    volatile rt_bool_t busy;            /* a job was started and nobody waited for it yet */
+    volatile rt_bool_t irq;             /* the job started last completes by the interrupt */
+    struct lv_gpu_gd32_ipa_stats stats;
+} _ipa;
+
+void IPA_IRQHandler (void)
+{
+    rt_uint32_t flags;
+
+    rt_interrupt_enter();
+
+    flags = IPA_INTF;
+    IPA_INTC = flags;
+
+    if (flags & (IPA_INTF_TAEIF | IPA_INTF_WCFIF))
+    {
+        _ipa.stats.errors ++;
+    }
+
+    /* an aborted job does not finish, the error completes it */
+    if (_ipa.irq && (flags & (IPA_INTF_FTFIF | IPA_INTF_TAEIF | IPA_INTF_WCFIF)))
+    {
+        _ipa.irq = RT_FALSE;
+        rt_sem_release(&_ipa.done);
+    }
+
+    rt_interrupt_leave();
+}
+
+void lv_gpu_gd32_ipa_wait (void)
+{
+    rt_uint32_t start;
+
+    if (!_ipa.busy)
+    {
+        return;
+    }
+
+    start = get_cpu_tick();
+
+    if (IPA_CTL & IPA_CTL_FTFIE)
+    {
+        _ipa.stats.irq_waits ++;
+        if (rt_sem_take(&_ipa.done, IPA_TIMEOUT) != RT_EOK)
+        {
+            IPA_CTL |= IPA_CTL_TST;
+            _ipa.irq = RT_FALSE;
+            _ipa.stats.timeouts ++;
+            LOG_W("the transfer timed out, stopped");
+        }
+    }
+
+    /* the semaphore may hold a count of an earlier job, the enable bit tells the truth */
+    while (IPA_CTL & IPA_CTL_TEN);
+
+    _ipa.busy = RT_FALSE;
+    _ipa.stats.wait_cycles += get_cpu_tick() - start;
+}
+
+/* the sources and the destination are set, the job may not be waited for yet */
+static void ipa_start (rt_uint32_t mode, lv_coord_t width, lv_coord_t height)
+{
+    rt_uint32_t pixels = (rt_uint32_t)width * (rt_uint32_t)height;
+    rt_uint32_t ctl = mode | IPA_CTL_TAEIE | IPA_CTL_WCFIE;
+
+    if (pixels >= IPA_IRQ_PIXELS)
+    {
+        ctl |= IPA_CTL_FTFIE;
+    }
+
+    _ipa.irq = (ctl & IPA_CTL_FTFIE) ? RT_TRUE : RT_FALSE;
+    _ipa.busy = RT_TRUE;
+    _ipa.stats.pixels += pixels;
+
+    IPA_IMS = ((rt_uint32_t)width << 16) | (rt_uint32_t)height;
+    IPA_INTC = IPA_INT_ALL;
+    IPA_CTL = ctl;
+    IPA_CTL = ctl | IPA_CTL_TEN;
+}
+
+static lv_color_t *ipa_dest_addr (lv_draw_ctx_t *draw_ctx, const lv_area_t *area, lv_coord_t stride)
+{
+    return (lv_color_t *)draw_ctx->buf + (rt_uint32_t)stride * area->y1 + area->x1;
+}
+
+/* the area is relative to the buffer, the job reads nothing but the buffer so it runs on */
+static void ipa_fill (lv_draw_ctx_t *draw_ctx, lv_coord_t stride, const lv_area_t *area,
+                      lv_color_t color, lv_opa_t opa)
+{
+    lv_coord_t width = lv_area_get_width(area);
+    lv_coord_t height = lv_area_get_height(area);
+    lv_color_t *dest = ipa_dest_addr(draw_ctx, area, stride);
+
+    lv_gpu_gd32_ipa_wait();
+
+    IPA_DPCTL = IPA_DPF_NATIVE;
+    IPA_DMADDR = (rt_uint32_t)dest;
+    IPA_DLOFF = stride - width;
+
+    if (opa >= LV_OPA_MAX)
+    {
+        IPA_DPV = color.full;
+        ipa_start(IPA_FILL_UP_DE, width, height);
+    }
+    else
+    {
+        /* the foreground is the color with a fixed alpha, its memory is never read */
+        IPA_FPCTL = FOREGROUND_PPF_A8 | IPA_FG_ALPHA_MODE_1 | IPA_FG_ALPHA(opa);
+        IPA_FPV = IPA_RGB888(color);
+        IPA_FMADDR = (rt_uint32_t)dest;
+        IPA_FLOFF = stride - width;
+        IPA_BPCTL = IPA_BG_PF_NATIVE;
+        IPA_BMADDR = (rt_uint32_t)dest;
+        IPA_BLOFF = stride - width;
+        ipa_start(IPA_FGBGTODE, width, height);
+    }
+
+    _ipa.stats.fills ++;
+}
+
+/* the mask is reused by the caller for the next lines, the job is waited for */
+static void ipa_paint (lv_draw_ctx_t *draw_ctx, lv_coord_t stride, const lv_area_t *area,
+                       const lv_opa_t *mask, lv_coord_t mask_stride, lv_color_t color, lv_opa_t opa)
+{
+    lv_coord_t width = lv_area_get_width(area);
+    lv_coord_t height = lv_area_get_height(area);
+    lv_color_t *dest = ipa_dest_addr(draw_ctx, area, stride);
+
+    lv_gpu_gd32_ipa_wait();
+
+    if (opa >= LV_OPA_MAX)
+    {
+        IPA_FPCTL = FOREGROUND_PPF_A8 | IPA_FG_ALPHA_MODE_0;
+    }
+    else
+    {
+        IPA_FPCTL = FOREGROUND_PPF_A8 | IPA_FG_ALPHA_MODE_2 | IPA_FG_ALPHA(opa);
+    }
+    IPA_FPV = IPA_RGB888(color);
+    IPA_FMADDR = (rt_uint32_t)mask;
+    IPA_FLOFF = mask_stride - width;
+    IPA_BPCTL = IPA_BG_PF_NATIVE;
+    IPA_BMADDR = (rt_uint32_t)dest;
+    IPA_BLOFF = stride - width;
+    IPA_DPCTL = IPA_DPF_NATIVE;
+    IPA_DMADDR = (rt_uint32_t)dest;
+    IPA_DLOFF = stride - width;
+    ipa_start(IPA_FGBGTODE, width, height);
+    lv_gpu_gd32_ipa_wait();
+
+    _ipa.stats.paints ++;
+}
+
+/*
+ * Draws an image of the foreground format on the buffer, the source may be a temporary buffer
+ * so the job is waited for. An image with alpha or a lower opacity is blended, an image without
+ * alpha in another format is converted, the alpha byte of an ignored alpha is set to opaque.
+ */
+static void ipa_map (lv_draw_ctx_t *draw_ctx, lv_coord_t stride, const lv_area_t *area,
+                     const rt_uint8_t *src, lv_coord_t src_stride, rt_uint32_t src_pf,
+                     rt_bool_t src_alpha, lv_opa_t opa)
+{
+    lv_coord_t width = lv_area_get_width(area);
+    lv_coord_t height = lv_area_get_height(area);
+    lv_color_t *dest = ipa_dest_addr(draw_ctx, area, stride);
+    rt_uint32_t mode;
+
+    lv_gpu_gd32_ipa_wait();
+
+    if (opa < LV_OPA_MAX || src_alpha)
+    {
+        if (opa >= LV_OPA_MAX)
+        {
+            IPA_FPCTL = src_pf | IPA_FG_ALPHA_MODE_0;
+        }
+        else if (src_alpha)
+        {
+            IPA_FPCTL = src_pf | IPA_FG_ALPHA_MODE_2 | IPA_FG_ALPHA(opa);
+        }
+        else
+        {
+            IPA_FPCTL = src_pf | IPA_FG_ALPHA_MODE_1 | IPA_FG_ALPHA(opa);
+        }
+        IPA_BPCTL = IPA_BG_PF_NATIVE;
+        IPA_BMADDR = (rt_uint32_t)dest;
+        IPA_BLOFF = stride - width;
+        mode = IPA_FGBGTODE;
+    }
+    else if (src_pf == IPA_FG_PF_NATIVE)
+    {
+        IPA_FPCTL = src_pf;
+        mode = IPA_FGTODE;
+    }
+    else
+    {
+        IPA_FPCTL = src_pf | IPA_FG_ALPHA_MODE_1 | IPA_FG_ALPHA(LV_OPA_COVER);
+        mode = IPA_FGTODE_PF_CONVERT;
+    }
+    IPA_FPV = 0;
+    IPA_FMADDR = (rt_uint32_t)src;
+    IPA_FLOFF = src_stride - width;
+    IPA_DPCTL = IPA_DPF_NATIVE;
+    IPA_DMADDR = (rt_uint32_t)dest;
+    IPA_DLOFF = stride - width;
+    ipa_start(mode, width, height);
+    lv_gpu_gd32_ipa_wait();
+
+    _ipa.stats.maps ++;
+}
+
+/* the layers with alpha are drawn in a format the IPA does not know */
+static rt_bool_t ipa_buffer_usable (void)
+{
+    lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+
+    return disp == RT_NULL || !disp->driver->screen_transp;
+}
+
+static void lv_draw_gd32_ipa_blend (lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc)
+{
+    const lv_opa_t *mask = dsc->mask_buf;
+    lv_coord_t stride = lv_area_get_width(draw_ctx->buf_area);
+    lv_area_t area;
+
+    if (!_lv_area_intersect(&area, dsc->blend_area, draw_ctx->clip_area))
+    {
+        return;
+    }
+    if (mask != RT_NULL && dsc->mask_res == LV_DRAW_MASK_RES_TRANSP)
+    {
+        return;
+    }
+    if (dsc->mask_res == LV_DRAW_MASK_RES_FULL_COVER)
+    {
+        mask = RT_NULL;
+    }
+
+    /* an image through a mask would need the mask merged into a copy first */
+    if (dsc->blend_mode != LV_BLEND_MODE_NORMAL || (mask != RT_NULL && dsc->src_buf != RT_NULL) ||
+        lv_area_get_size(&area) < BSP_LVGL_IPA_MIN_PIXELS || !ipa_buffer_usable())
+    {
+        lv_gpu_gd32_ipa_wait();
+        lv_draw_sw_blend_basic(draw_ctx, dsc);
+        _ipa.stats.sw_fallbacks ++;
+        return;
+    }
+
+    if (mask != RT_NULL)
+    {
+        lv_coord_t mask_stride = lv_area_get_width(dsc->mask_area);
+
+        mask += (rt_uint32_t)mask_stride * (area.y1 - dsc->mask_area->y1) + (area.x1 - dsc->mask_area->x1);
+        lv_area_move(&area, -draw_ctx->buf_area->x1, -draw_ctx->buf_area->y1);
+        ipa_paint(draw_ctx, stride, &area, mask, mask_stride, dsc->color, dsc->opa);
+    }
+    else if (dsc->src_buf != RT_NULL)
+    {
+        lv_coord_t src_stride = lv_area_get_width(dsc->blend_area);
+        const lv_color_t *src = dsc->src_buf;
+
+        src += (rt_uint32_t)src_stride * (area.y1 - dsc->blend_area->y1) + (area.x1 - dsc->blend_area->x1);
+        lv_area_move(&area, -draw_ctx->buf_area->x1, -draw_ctx->buf_area->y1);
+        ipa_map(draw_ctx, stride, &area, (const rt_uint8_t *)src, src_stride,
+                IPA_FG_PF_NATIVE, RT_FALSE, dsc->opa);
+    }
+    else
+    {
+        lv_area_move(&area, -draw_ctx->buf_area->x1, -draw_ctx->buf_area->y1);
+        ipa_fill(draw_ctx, stride, &area, dsc->color, dsc->opa);
+    }
+}
+
+static void lv_draw_gd32_ipa_img_decoded (lv_draw_ctx_t *draw_ctx, const lv_draw_img_dsc_t *dsc,
+                                          const lv_area_t *coords, const uint8_t *src_buf, lv_img_cf_t cf)
+{
+    rt_uint32_t src_pf;
+    rt_uint8_t src_bpp;
+    rt_bool_t src_alpha;
+    lv_coord_t src_stride;
+    lv_area_t area;
+
+    switch (cf)
+    {
+    case LV_IMG_CF_TRUE_COLOR:
+        src_pf = IPA_FG_PF_NATIVE;
+        src_bpp = sizeof(lv_color_t);
+        src_alpha = RT_FALSE;
+        break;
+#if LV_COLOR_DEPTH == 32
+    case LV_IMG_CF_TRUE_COLOR_ALPHA:
+#endif
+    case LV_IMG_CF_RGBA8888:
+        src_pf = FOREGROUND_PPF_ARGB8888;
+        src_bpp = 4;
+        src_alpha = RT_TRUE;
+        break;
+#if LV_COLOR_DEPTH == 16
+    /* converted with the alpha byte replaced, a copy would keep it */
+    case LV_IMG_CF_RGBX8888:
+        src_pf = FOREGROUND_PPF_ARGB8888;
+        src_bpp = 4;
+        src_alpha = RT_FALSE;
+        break;
+#endif
+    case LV_IMG_CF_RGB565:
+        src_pf = FOREGROUND_PPF_RGB565;
+        src_bpp = 2;
+        src_alpha = RT_FALSE;
+        break;
+    default:
+        src_bpp = 0;
+        break;
+    }
+
+    if (!_lv_area_intersect(&area, coords, draw_ctx->clip_area))
+    {
+        return;
+    }
+
+    if (src_bpp == 0 || dsc->angle != 0 || dsc->zoom != LV_IMG_ZOOM_NONE ||
+        dsc->recolor_opa != LV_OPA_TRANSP || dsc->blend_mode != LV_BLEND_MODE_NORMAL ||
+        lv_draw_mask_is_any(&area) || lv_area_get_size(&area) < BSP_LVGL_IPA_MIN_PIXELS ||
+        !ipa_buffer_usable())
+    {
+        lv_gpu_gd32_ipa_wait();
+        lv_draw_sw_img_decoded(draw_ctx, dsc, coords, src_buf, cf);
+        _ipa.stats.sw_fallbacks ++;
+        return;
+    }
+
+    if (dsc->opa <= LV_OPA_MIN)
+    {
+        return;
+    }
+
+    src_stride = lv_area_get_width(coords);
+    src_buf += ((rt_uint32_t)src_stride * (area.y1 - coords->y1) + (area.x1 - coords->x1)) * src_bpp;
+    lv_area_move(&area, -draw_ctx->buf_area->x1, -draw_ctx->buf_area->y1);
+    ipa_map(draw_ctx, lv_area_get_width(draw_ctx->buf_area), &area, src_buf, src_stride,
+            src_pf, src_alpha, dsc->opa);
+}
+
+/* the buffers are frame buffers, the copy runs on until the next draw */
+static void lv_draw_gd32_ipa_buffer_copy (lv_draw_ctx_t *draw_ctx,
+                                          void *dest_buf, lv_coord_t dest_stride, const lv_area_t *dest_area,
+                                          void *src_buf, lv_coord_t src_stride, const lv_area_t *src_area)
+{
+    lv_coord_t width = lv_area_get_width(dest_area);
+    lv_coord_t height = lv_area_get_height(dest_area);
+
+    lv_gpu_gd32_ipa_wait();
+
+    if (lv_area_get_size(dest_area) < BSP_LVGL_IPA_MIN_PIXELS)
+    {
+        lv_draw_sw_buffer_copy(draw_ctx, dest_buf, dest_stride, dest_area, src_buf, src_stride, src_area);
+        _ipa.stats.sw_fallbacks ++;
+        return;
+    }
+
+    IPA_FPCTL = IPA_FG_PF_NATIVE;
+    IPA_FMADDR = (rt_uint32_t)((lv_color_t *)src_buf + (rt_uint32_t)src_stride * src_area->y1 + src_area->x1);
+    IPA_FLOFF = src_stride - width;
+    IPA_DPCTL = IPA_DPF_NATIVE;
+    IPA_DMADDR = (rt_uint32_t)((lv_color_t *)dest_buf + (rt_uint32_t)dest_stride * dest_area->y1 + dest_area->x1);
+    IPA_DLOFF = dest_stride - width;
+    ipa_start(IPA_FGTODE, width, height);
+
+    _ipa.stats.copies ++;
+}
+
+static void lv_draw_gd32_ipa_wait_for_finish (lv_draw_ctx_t *draw_ctx)
+{
+    lv_gpu_gd32_ipa_wait();
+    lv_draw_sw_wait_for_finish(draw_ctx);
+}
+
+/* the layers move, clear and free the buffers the IPA may still be drawing into */
+static lv_draw_layer_ctx_t *lv_draw_gd32_ipa_layer_init (lv_draw_ctx_t *draw_ctx, lv_draw_layer_ctx_t *layer_ctx,
+                                                         lv_draw_layer_flags_t flags)
+{
+    lv_gpu_gd32_ipa_wait();
+    return lv_draw_sw_layer_create(draw_ctx, layer_ctx, flags);
+}
+
+static void lv_draw_gd32_ipa_layer_adjust (lv_draw_ctx_t *draw_ctx, lv_draw_layer_ctx_t *layer_ctx,
+                                           lv_draw_layer_flags_t flags)
+{
+    lv_gpu_gd32_ipa_wait();
+    lv_draw_sw_layer_adjust(draw_ctx, layer_ctx, flags);
+}
+
+static void lv_draw_gd32_ipa_layer_blend (lv_draw_ctx_t *draw_ctx, lv_draw_layer_ctx_t *layer_ctx,
+                                          const lv_draw_img_dsc_t *draw_dsc)
+{
+    lv_gpu_gd32_ipa_wait();
+    lv_draw_sw_layer_blend(draw_ctx, layer_ctx, draw_dsc);
+}
+
+static void lv_draw_gd32_ipa_layer_destroy (lv_draw_ctx_t *draw_ctx, lv_draw_layer_ctx_t *layer_ctx)
+{
+    lv_gpu_gd32_ipa_wait();
+    lv_draw_sw_layer_destroy(draw_ctx, layer_ctx);
+}
+
+void lv_draw_gd32_ipa_init (void)
+{
+    rt_sem_init(&_ipa.done, "ipa", 0, RT_IPC_FLAG_PRIO);
+
+    rcu_periph_clock_enable(RCU_IPA);
+    ipa_deinit();
+
+    IPA_INTC = IPA_INT_ALL;
+    nvic_irq_enable(IPA_IRQn, 2, 0);
+}
+
+void lv_draw_gd32_ipa_ctx_init (lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx)
+{
+    lv_draw_gd32_ipa_ctx_t *ipa_ctx = (lv_draw_gd32_ipa_ctx_t *)draw_ctx;
+
+    lv_draw_sw_init_ctx(drv, draw_ctx);
+
+    ipa_ctx->blend = lv_draw_gd32_ipa_blend;
+    ipa_ctx->base_draw.draw_img_decoded = lv_draw_gd32_ipa_img_decoded;
+    ipa_ctx->base_draw.buffer_copy = lv_draw_gd32_ipa_buffer_copy;
+    ipa_ctx->base_draw.wait_for_finish = lv_draw_gd32_ipa_wait_for_finish;
+    ipa_ctx->base_draw.layer_init = lv_draw_gd32_ipa_layer_init;
+    ipa_ctx->base_draw.layer_adjust = lv_draw_gd32_ipa_layer_adjust;
+    ipa_ctx->base_draw.layer_blend = lv_draw_gd32_ipa_layer_blend;
+    ipa_ctx->base_draw.layer_destroy = lv_draw_gd32_ipa_layer_destroy;
+}
+
+void lv_draw_gd32_ipa_ctx_deinit (lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx)
+{
+    lv_gpu_gd32_ipa_wait();
+    lv_draw_sw_deinit_ctx(drv, draw_ctx);
+}
+
+void lv_gpu_gd32_ipa_stats_get (struct lv_gpu_gd32_ipa_stats *stats)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+    *stats = _ipa.stats;
+    rt_hw_interrupt_enable(level);
+}
+
+void lv_gpu_gd32_ipa_stats_reset (void)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+    rt_memset(&_ipa.stats, 0, sizeof(_ipa.stats));
+    rt_hw_interrupt_enable(level);
+}
+
+#endif /* BSP_LVGL_USING_IPA */
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2006-2024, Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-22   Evlers      first implementation
+ */
+
+#ifndef __LV_GPU_GD32_IPA_H__
+#define __LV_GPU_GD32_IPA_H__
+
+#include <rtthread.h>
+#include <lvgl.h>
+#include <lv_draw_sw.h>
+
+#ifdef BSP_LVGL_USING_IPA
+
+/* the software context, only the blend, image, copy and wait hooks are replaced */
+typedef lv_draw_sw_ctx_t lv_draw_gd32_ipa_ctx_t;
+
+struct lv_gpu_gd32_ipa_stats
+{
+    rt_uint32_t fills;                  /* color fills, the cpu goes on drawing meanwhile */
+    rt_uint32_t paints;                 /* a color through an alpha mask, e.g. the letters */
+    rt_uint32_t maps;                   /* copies, conversions and blends of images */
+    rt_uint32_t copies;                 /* frame buffer to frame buffer copies */
+    rt_uint32_t sw_fallbacks;           /* the draws left to the cpu */
+    rt_uint32_t irq_waits;              /* waits for the completion interrupt */
+    rt_uint32_t errors;                 /* transfer access and configuration errors */
+    rt_uint32_t timeouts;
+    rt_uint64_t pixels;                 /* pixels drawn by the IPA */
+    rt_uint64_t wait_cycles;            /* cpu cycles spent waiting for the IPA */
+};
+
+void lv_draw_gd32_ipa_init(void);
+void lv_draw_gd32_ipa_ctx_init(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx);
+void lv_draw_gd32_ipa_ctx_deinit(lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx);
+
+/* wait for the job started last, the cpu may touch the drawn pixels after it */
+void lv_gpu_gd32_ipa_wait(void);
+
+void lv_gpu_gd32_ipa_stats_get(struct lv_gpu_gd32_ipa_stats *stats);
+void lv_gpu_gd32_ipa_stats_reset(void);
+
+#endif /* BSP_LVGL_USING_IPA */
+
+#endif /* __LV_GPU_GD32_IPA_H__ */
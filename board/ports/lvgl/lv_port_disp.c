@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2006-2024, Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-22   Evlers      first implementation
+ * 2024-10-23   Evlers      add the partial refresh and the thread statistics
+ */
+
+#include <board.h>
+#include <rthw.h>
+#include <rtdevice.h>
+#include <lvgl.h>
+#include "drv_lcd.h"
+#include "delay.h"
+#include "lv_gpu_gd32_ipa.h"
+#include "lv_rt_thread_port.h"
+
+#define DBG_TAG             "lv.disp"
+#define DBG_LVL             DBG_INFO
+#include "rtdbg.h"
+
+#if LV_COLOR_DEPTH != 16 && LV_COLOR_DEPTH != 32
+#error "the color depth of lvgl does not match the frame buffers"
+#endif
+
+struct lv_port_disp_stats
+{
+    rt_uint32_t frames;                 /* refreshes that drew something */
+    rt_uint32_t full_frames;            /* refreshes of the whole screen */
+    rt_uint32_t areas;                  /* areas drawn, after joining the invalid ones */
+    rt_uint32_t pixels;                 /* pixels of the areas drawn */
+    rt_uint32_t render_max;             /* the longest refresh, cpu cycles */
+    rt_uint64_t render_cycles;          /* from the start of the refresh to the flip */
+    rt_uint64_t flip_wait_cycles;       /* waits for the blank of the flip before */
+    rt_tick_t start_tick;
+};
+
+static lv_disp_drv_t disp_drv;
+static lv_disp_draw_buf_t disp_buf;
+static struct lv_port_disp_stats _stats;
+static rt_uint32_t render_start;
+static rt_uint32_t frame_pixels;
+
+/* the interrupt of the blank that took the frame buffer, the other one is free to draw now */
+static void disp_flip_done (void *framebuffer, void *arg)
+{
+    lv_disp_flush_ready((lv_disp_drv_t *)arg);
+}
+
+static void disp_render_start (lv_disp_drv_t *drv)
+{
+    render_start = get_cpu_tick();
+}
+
+/*
+ * Direct mode, the draw buffers are the frame buffers and only the last area flips.
+ * The frame is counted here, the benchmark demo takes the monitor callback for itself.
+ */
+static void disp_flush (lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p)
+{
+    rt_uint32_t cycles;
+
+    _stats.areas ++;
+    _stats.pixels += lv_area_get_size(area);
+    frame_pixels += lv_area_get_size(area);
+
+    if (!lv_disp_flush_is_last(drv))
+    {
+        lv_disp_flush_ready(drv);
+        return;
+    }
+
+    cycles = get_cpu_tick() - render_start;
+    _stats.frames ++;
+    if (frame_pixels >= (rt_uint32_t)drv->hor_res * drv->ver_res)
+    {
+        _stats.full_frames ++;
+    }
+    frame_pixels = 0;
+    _stats.render_cycles += cycles;
+    if (cycles > _stats.render_max)
+    {
+        _stats.render_max = cycles;
+    }
+
+    if (lcd_framebuffer_count() < 2)
+    {
+        lv_disp_flush_ready(drv);
+        return;
+    }
+
+    lcd_flip(color_p);
+}
+
+static void disp_wait (lv_disp_drv_t *drv)
+{
+    rt_uint32_t start = get_cpu_tick();
+
+    if (lcd_flip_wait(RT_TICK_PER_SECOND / 10) != RT_EOK)
+    {
+        /* the panel does not run, do not hang the gui on it */
+        LOG_W("no blank for the flip");
+        lv_disp_flush_ready(drv);
+    }
+    _stats.flip_wait_cycles += get_cpu_tick() - start;
+}
+
+/*
+ * The areas drawn in the last frame are copied from the shown buffer before the next one is drawn.
+ * The buffer drawn into is still shown until the blank, the copy waits for it.
+ */
+static void (*sync_copy)(lv_draw_ctx_t *draw_ctx, void *dest_buf, lv_coord_t dest_stride, const lv_area_t *dest_area,
+                         void *src_buf, lv_coord_t src_stride, const lv_area_t *src_area);
+
+static void disp_buffer_copy (lv_draw_ctx_t *draw_ctx, void *dest_buf, lv_coord_t dest_stride, const lv_area_t *dest_area,
+                              void *src_buf, lv_coord_t src_stride, const lv_area_t *src_area)
+{
+    if (lcd_flip_pending())
+    {
+        disp_wait(&disp_drv);
+    }
+    sync_copy(draw_ctx, dest_buf, dest_stride, dest_area, src_buf, src_stride, src_area);
+}
+
+static void disp_draw_ctx_init (lv_disp_drv_t *drv, lv_draw_ctx_t *draw_ctx)
+{
+#ifdef BSP_LVGL_USING_IPA
+    lv_draw_gd32_ipa_ctx_init(drv, draw_ctx);
+#else
+    lv_draw_sw_init_ctx(drv, draw_ctx);
+#endif
+    sync_copy = draw_ctx->buffer_copy;
+    draw_ctx->buffer_copy = disp_buffer_copy;
+}
+
+void lv_port_disp_init (void)
+{
+    rt_device_t device;
+    struct rt_device_graphic_info info;
+    int count = lcd_framebuffer_count();
+
+    device = rt_device_find(LCD_DEVICE_NAME);
+    if (device == RT_NULL || rt_device_control(device, RTGRAPHIC_CTRL_GET_INFO, &info) != RT_EOK)
+    {
+        LOG_E("the lcd is not ready");
+        return;
+    }
+
+    if (info.bits_per_pixel != LV_COLOR_DEPTH)
+    {
+        LOG_E("the lcd has %d bits per pixel, lvgl draws with %d", info.bits_per_pixel, LV_COLOR_DEPTH);
+        return;
+    }
+
+#ifdef BSP_LVGL_USING_IPA
+    lv_draw_gd32_ipa_init();
+#endif
+
+    lv_disp_draw_buf_init(&disp_buf, lcd_framebuffer_get(0), count > 1 ? lcd_framebuffer_get(1) : RT_NULL,
+                          info.width * info.height);
+
+    lv_disp_drv_init(&disp_drv);
+    disp_drv.hor_res = info.width;
+    disp_drv.ver_res = info.height;
+    disp_drv.draw_buf = &disp_buf;
+    disp_drv.direct_mode = 1;
+    disp_drv.flush_cb = disp_flush;
+    disp_drv.wait_cb = disp_wait;
+    disp_drv.render_start_cb = disp_render_start;
+    disp_drv.draw_ctx_init = disp_draw_ctx_init;
+#ifdef BSP_LVGL_USING_IPA
+    disp_drv.draw_ctx_deinit = lv_draw_gd32_ipa_ctx_deinit;
+    disp_drv.draw_ctx_size = sizeof(lv_draw_gd32_ipa_ctx_t);
+#else
+    disp_drv.draw_ctx_deinit = lv_draw_sw_deinit_ctx;
+    disp_drv.draw_ctx_size = sizeof(lv_draw_sw_ctx_t);
+#endif
+
+    lcd_flip_done_set(disp_flip_done, &disp_drv);
+    lv_disp_drv_register(&disp_drv);
+
+    _stats.start_tick = rt_tick_get();
+}
+
+void lv_port_disp_stats_reset (void)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+    rt_memset(&_stats, 0, sizeof(_stats));
+    _stats.start_tick = rt_tick_get();
+    rt_hw_interrupt_enable(level);
+
+#ifdef BSP_LVGL_USING_IPA
+    lv_gpu_gd32_ipa_stats_reset();
+#endif
+    lv_rt_thread_stats_reset();
+}
+
+/* the frame time and the cpu load since the init or the last reset */
+void lv_port_disp_stats_print (void)
+{
+    struct lv_port_disp_stats stats;
+    struct lv_rt_thread_stats thread;
+    rt_uint32_t elapsed_ms, mhz = SystemCoreClock / 1000000;
+    rt_uint64_t elapsed_cycles, busy;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    stats = _stats;
+    rt_hw_interrupt_enable(level);
+
+    elapsed_ms = (rt_tick_get() - stats.start_tick) * 1000 / RT_TICK_PER_SECOND;
+    elapsed_cycles = (rt_uint64_t)elapsed_ms * mhz * 1000;
+    if (elapsed_ms == 0 || stats.frames == 0)
+    {
+        rt_kprintf("no frames drawn yet\n");
+        return;
+    }
+
+    rt_kprintf("frames     : %u in %u ms, %u.%u fps\n", stats.frames, elapsed_ms,
+               stats.frames * 1000 / elapsed_ms, stats.frames * 10000 / elapsed_ms % 10);
+    rt_kprintf("frame time : %u us average, %u us max\n",
+               (rt_uint32_t)(stats.render_cycles / stats.frames / mhz), stats.render_max / mhz);
+    rt_kprintf("pixels     : %u per frame, %u%% of the screen\n", stats.pixels / stats.frames,
+               (rt_uint32_t)((rt_uint64_t)stats.pixels * 100 / stats.frames / (disp_drv.hor_res * disp_drv.ver_res)));
+    rt_kprintf("refresh    : %u full, %u partial, %u.%u areas per frame\n", stats.full_frames,
+               stats.frames - stats.full_frames, stats.areas / stats.frames, stats.areas * 10 / stats.frames % 10);
+    rt_kprintf("flip wait  : %u us\n", (rt_uint32_t)(stats.flip_wait_cycles / mhz));
+
+    /* the refresh waits for the blank of the last flip before it draws into the buffer */
+    busy = (stats.flip_wait_cycles < stats.render_cycles) ? stats.render_cycles - stats.flip_wait_cycles : 0;
+
+#ifdef BSP_LVGL_USING_IPA
+    {
+        struct lv_gpu_gd32_ipa_stats ipa;
+
+        lv_gpu_gd32_ipa_stats_get(&ipa);
+        rt_kprintf("ipa        : %u fills, %u paints, %u maps, %u copies, %u by the cpu\n",
+                   ipa.fills, ipa.paints, ipa.maps, ipa.copies, ipa.sw_fallbacks);
+        rt_kprintf("ipa pixels : %u K, %u us waited (%u on the interrupt)\n", (rt_uint32_t)(ipa.pixels >> 10),
+                   (rt_uint32_t)(ipa.wait_cycles / mhz), ipa.irq_waits);
+        if (ipa.errors || ipa.timeouts)
+        {
+            rt_kprintf("ipa errors : %u, %u timeouts\n", ipa.errors, ipa.timeouts);
+        }
+        busy = (ipa.wait_cycles < busy) ? busy - ipa.wait_cycles : 0;
+    }
+#endif /* BSP_LVGL_USING_IPA */
+
+    /* the rendering without the waits, the profiler has the load of the whole thread */
+    rt_kprintf("cpu time   : %u us per frame\n", (rt_uint32_t)(busy / stats.frames / mhz));
+    rt_kprintf("cpu load   : %u.%u %% rendering\n", (rt_uint32_t)(busy * 100 / elapsed_cycles),
+               (rt_uint32_t)(busy * 1000 / elapsed_cycles % 10));
+
+    /* the lvgl thread sleeps until a timer is due, a change or an input event */
+    lv_rt_thread_stats_get(&thread);
+    rt_kprintf("thread     : %u runs, %u ms asleep\n", thread.runs, thread.sleep_ms);
+    rt_kprintf("wakeups    : %u timer, %u signal, %u input\n", thread.wakeups_timer, thread.wakeups_signal,
+               thread.wakeups_indev);
+    if (thread.latency_count)
+    {
+        rt_kprintf("latency    : %u ms average, %u ms max from a signal to the flip\n",
+                   thread.latency_sum / thread.latency_count, thread.latency_max);
+    }
+}
+
+#ifdef RT_USING_FINSH
+static void lvgl_stat (int argc, char **argv)
+{
+    lv_port_disp_stats_print();
+
+    if (argc > 1 && !rt_strcmp(argv[1], "reset"))
+    {
+        lv_port_disp_stats_reset();
+    }
+}
+MSH_CMD_EXPORT(lvgl_stat, show the lvgl frame statistics: lvgl_stat [reset]);
+#endif /* RT_USING_FINSH */
@@ -0,0 +1,19 @@
+/*
+ * Copyright (c) 2006-2024, Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-22   Evlers      first implementation
+ */
+
+#include <lvgl.h>
+
+/*
+ * The board has no touch panel, a driver registers its input device here.
+ * An interrupt driven panel pauses the read timer and calls lv_rt_thread_indev_wakeup() on each change.
+ */
+rt_weak void lv_port_indev_init (void)
+{
+}
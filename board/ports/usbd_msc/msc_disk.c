@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2006-2024, Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-20   Evlers      first implementation
+ */
+
+#include "msc_disk.h"
+
+#define DBG_TAG             "msc.disk"
+#define DBG_LVL             DBG_INFO
+#include "rtdbg.h"
+
+rt_err_t msc_disk_init(struct msc_disk *disk, rt_size_t buffer_size,
+                       const struct msc_disk_xfer_ops *ops, void *user_data)
+{
+    RT_ASSERT(disk != RT_NULL);
+    RT_ASSERT(ops != RT_NULL);
+
+    rt_memset(disk, 0, sizeof(struct msc_disk));
+
+    disk->buffer[0] = rt_malloc(buffer_size);
+    disk->buffer[1] = rt_malloc(buffer_size);
+    if (disk->buffer[0] == RT_NULL || disk->buffer[1] == RT_NULL)
+    {
+        LOG_E("no memory for the media buffers (2 x %d bytes)", (int)buffer_size);
+        msc_disk_deinit(disk);
+        return -RT_ENOMEM;
+    }
+
+    disk->buffer_size = buffer_size;
+    disk->ops = ops;
+    disk->user_data = user_data;
+
+    return RT_EOK;
+}
+
+void msc_disk_deinit(struct msc_disk *disk)
+{
+    msc_disk_detach(disk);
+
+    if (disk->buffer[0] != RT_NULL)
+    {
+        rt_free(disk->buffer[0]);
+        disk->buffer[0] = RT_NULL;
+    }
+    if (disk->buffer[1] != RT_NULL)
+    {
+        rt_free(disk->buffer[1]);
+        disk->buffer[1] = RT_NULL;
+    }
+}
+
+rt_err_t msc_disk_attach(struct msc_disk *disk, const char *name)
+{
+    struct rt_device_blk_geometry geometry;
+    rt_device_t device;
+
+    msc_disk_detach(disk);
+
+    device = rt_device_find(name);
+    if (device == RT_NULL || device->type != RT_Device_Class_Block)
+    {
+        return -RT_ENOSYS;
+    }
+
+    if (rt_device_open(device, RT_DEVICE_OFLAG_RDWR) != RT_EOK)
+    {
+        return -RT_EIO;
+    }
+
+    rt_memset(&geometry, 0, sizeof(geometry));
+    if (rt_device_control(device, RT_DEVICE_CTRL_BLK_GETGEOME, &geometry) != RT_EOK ||
+        geometry.bytes_per_sector == 0 || geometry.sector_count == 0 ||
+        geometry.bytes_per_sector > disk->buffer_size)
+    {
+        LOG_E("%s: unusable geometry, %d bytes per sector", name, geometry.bytes_per_sector);
+        rt_device_close(device);
+        return -RT_EINVAL;
+    }
+
+    disk->device = device;
+    disk->block_size = geometry.bytes_per_sector;
+    disk->block_count = geometry.sector_count;
+    disk->buffer_blocks = disk->buffer_size / geometry.bytes_per_sector;
+
+    LOG_D("%s: %d blocks of %d bytes, %d blocks per buffer",
+          name, disk->block_count, disk->block_size, disk->buffer_blocks);
+
+    return RT_EOK;
+}
+
+void msc_disk_detach(struct msc_disk *disk)
+{
+    if (disk->device != RT_NULL)
+    {
+        rt_device_close(disk->device);
+        disk->device = RT_NULL;
+        disk->block_count = 0;
+    }
+}
+
+rt_ssize_t msc_disk_read(struct msc_disk *disk, rt_uint32_t lba, rt_uint32_t blocks)
+{
+    rt_bool_t pending = RT_FALSE;
+    rt_ssize_t done = 0, sent;
+    rt_uint32_t count;
+    rt_err_t result;
+    int index = 0;
+
+    disk->error = RT_EOK;
+
+    while (blocks)
+    {
+        count = RT_MIN(blocks, disk->buffer_blocks);
+
+        /* fill this buffer while the other one is being sent */
+        if (rt_device_read(disk->device, lba, disk->buffer[index], count) != count)
+        {
+            disk->error = -RT_EIO;
+            disk->media_errors ++;
+            break;
+        }
+
+        if (pending)
+        {
+            pending = RT_FALSE;
+            sent = disk->ops->wait(disk);
+            if (sent < 0)
+            {
+                disk->error = sent;
+                break;
+            }
+            done += sent;
+        }
+
+        result = disk->ops->start(disk, MSC_DISK_XFER_IN, disk->buffer[index], count * disk->block_size);
+        if (result != RT_EOK)
+        {
+            disk->error = result;
+            break;
+        }
+        pending = RT_TRUE;
+
+        lba += count;
+        blocks -= count;
+        index ^= 1;
+    }
+
+    if (pending)
+    {
+        sent = disk->ops->wait(disk);
+        if (sent < 0)
+        {
+            disk->error = sent;
+        }
+        else
+        {
+            done += sent;
+        }
+    }
+
+    disk->read_bytes += done;
+
+    return done;
+}
+
+rt_ssize_t msc_disk_write(struct msc_disk *disk, rt_uint32_t lba, rt_uint32_t blocks)
+{
+    rt_ssize_t done = 0, received;
+    rt_uint32_t count, next;
+    rt_err_t result;
+    int index = 0;
+
+    disk->error = RT_EOK;
+
+    count = RT_MIN(blocks, disk->buffer_blocks);
+    if (count)
+    {
+        result = disk->ops->start(disk, MSC_DISK_XFER_OUT, disk->buffer[0], count * disk->block_size);
+        if (result != RT_EOK)
+        {
+            disk->error = result;
+            return 0;
+        }
+    }
+
+    while (count)
+    {
+        received = disk->ops->wait(disk);
+        if (received < 0)
+        {
+            disk->error = received;
+            break;
+        }
+        done += received;
+
+        /* receive the next buffer while this one is being written */
+        blocks -= count;
+        next = RT_MIN(blocks, disk->buffer_blocks);
+        if (next)
+        {
+            result = disk->ops->start(disk, MSC_DISK_XFER_OUT, disk->buffer[index ^ 1], next * disk->block_size);
+            if (result != RT_EOK)
+            {
+                disk->error = result;
+                next = 0;
+            }
+        }
+
+        /* after a media error the data is still taken from the host, so the transport stays in step */
+        if (received != count * disk->block_size)
+        {
+            if (disk->error == RT_EOK)
+            {
+                disk->error = -RT_EIO;
+            }
+        }
+        else if (disk->error == RT_EOK)
+        {
+            if (rt_device_write(disk->device, lba, disk->buffer[index], count) != count)
+            {
+                disk->error = -RT_EIO;
+                disk->media_errors ++;
+            }
+        }
+
+        lba += count;
+        index ^= 1;
+        count = next;
+    }
+
+    disk->write_bytes += done;
+
+    return done;
+}
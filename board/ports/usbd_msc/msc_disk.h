@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2006-2024, Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-20   Evlers      first implementation
+ */
+
+#ifndef _MSC_DISK_H_
+#define _MSC_DISK_H_
+
+#include <rtthread.h>
+#include <rtdevice.h>
+
+/* the direction of a transfer, seen from the host */
+#define MSC_DISK_XFER_IN            0   /* media to host */
+#define MSC_DISK_XFER_OUT           1   /* host to media */
+
+struct msc_disk;
+
+/* the transport that moves a buffer to or from the host */
+struct msc_disk_xfer_ops
+{
+    /* start a transfer, it must not wait for the completion */
+    rt_err_t (*start)(struct msc_disk *disk, int dir, rt_uint8_t *buffer, rt_size_t size);
+    /* wait for the transfer started last, returns the bytes moved or a negative error code */
+    rt_ssize_t (*wait)(struct msc_disk *disk);
+};
+
+struct msc_disk
+{
+    rt_device_t device;
+    rt_uint32_t block_size;
+    rt_uint32_t block_count;
+
+    /* the media access of one buffer overlaps the host transfer of the other */
+    rt_uint8_t *buffer[2];
+    rt_size_t buffer_size;
+    rt_uint32_t buffer_blocks;
+
+    const struct msc_disk_xfer_ops *ops;
+    void *user_data;
+
+    /* the result of the last read or write */
+    rt_err_t error;
+
+    /* statistics */
+    rt_uint64_t read_bytes;
+    rt_uint64_t write_bytes;
+    rt_uint32_t media_errors;
+};
+
+rt_err_t msc_disk_init(struct msc_disk *disk, rt_size_t buffer_size,
+                       const struct msc_disk_xfer_ops *ops, void *user_data);
+void msc_disk_deinit(struct msc_disk *disk);
+
+/* open a block device and read its geometry */
+rt_err_t msc_disk_attach(struct msc_disk *disk, const char *name);
+void msc_disk_detach(struct msc_disk *disk);
+
+/*
+ * Move blocks between the media and the host, return the bytes moved to or from the host.
+ * On failure disk->error is -RT_EIO for a media error, or the error returned by the transport.
+ */
+rt_ssize_t msc_disk_read(struct msc_disk *disk, rt_uint32_t lba, rt_uint32_t blocks);
+rt_ssize_t msc_disk_write(struct msc_disk *disk, rt_uint32_t lba, rt_uint32_t blocks);
+
+#endif /* _MSC_DISK_H_ */
@@ -0,0 +1,795 @@
+/*
+ * Copyright (c) 2006-2024, Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-20   Evlers      first implementation
+ */
+
+#include <rtthread.h>
+#include <rtdevice.h>
+#include "msc_disk.h"
+
+#define DBG_TAG             "usbd.msc"
+#define DBG_LVL             DBG_INFO
+#include "rtdbg.h"
+
+#ifndef BSP_USBD_MSC_DEVICE_NAME
+#define BSP_USBD_MSC_DEVICE_NAME    "sd0"
+#endif
+
+#ifndef BSP_USBD_MSC_BUFFER_SIZE
+#define BSP_USBD_MSC_BUFFER_SIZE    (16 * 1024)
+#endif
+
+/* the media thread runs just below the usbd core thread */
+#define MSC_THREAD_STACK_SIZE       2048
+#define MSC_THREAD_PRIORITY         9
+
+/* bulk only transport */
+#define MSC_REQ_GET_MAX_LUN         0xFE
+#define MSC_REQ_RESET               0xFF
+#define MSC_CBW_SIGNATURE           0x43425355
+#define MSC_CSW_SIGNATURE           0x53425355
+#define MSC_CBW_SIZE                31
+#define MSC_CSW_SIZE                13
+#define MSC_CBW_DIR_IN              0x80
+#define MSC_CSW_PASSED              0x00
+#define MSC_CSW_FAILED              0x01
+#define MSC_CSW_PHASE_ERROR         0x02
+
+/* SCSI commands */
+#define SCSI_TEST_UNIT_READY        0x00
+#define SCSI_REQUEST_SENSE          0x03
+#define SCSI_INQUIRY                0x12
+#define SCSI_MODE_SENSE_6           0x1A
+#define SCSI_START_STOP_UNIT        0x1B
+#define SCSI_ALLOW_MEDIUM_REMOVAL   0x1E
+#define SCSI_READ_FORMAT_CAPACITIES 0x23
+#define SCSI_READ_CAPACITY_10       0x25
+#define SCSI_READ_10                0x28
+#define SCSI_WRITE_10               0x2A
+#define SCSI_VERIFY_10              0x2F
+#define SCSI_SYNCHRONIZE_CACHE_10   0x35
+#define SCSI_MODE_SENSE_10          0x5A
+
+/* sense keys and additional sense codes */
+#define SENSE_NO_SENSE              0x00
+#define SENSE_NOT_READY             0x02
+#define SENSE_MEDIUM_ERROR          0x03
+#define SENSE_ILLEGAL_REQUEST       0x05
+#define ASC_WRITE_FAULT             0x03
+#define ASC_UNRECOVERED_READ_ERROR  0x11
+#define ASC_INVALID_COMMAND         0x20
+#define ASC_LBA_OUT_OF_RANGE        0x21
+#define ASC_MEDIUM_NOT_PRESENT      0x3A
+
+enum msc_stage
+{
+    MSC_STAGE_CBW = 0,                  /* waiting for a command block */
+    MSC_STAGE_DATA_IN,                  /* sending a response from the command buffer */
+    MSC_STAGE_MEDIA,                    /* the media thread owns both bulk endpoints */
+    MSC_STAGE_CSW,                      /* sending the command status */
+    MSC_STAGE_ERROR,                    /* invalid command block, waiting for a reset recovery */
+};
+
+struct msc_command
+{
+    rt_uint32_t tag;
+    rt_uint32_t length;                 /* dCBWDataTransferLength */
+    rt_uint8_t flags;
+    rt_uint8_t opcode;
+    rt_uint32_t lba;
+    rt_uint32_t blocks;
+    rt_uint32_t session;
+};
+
+struct usbd_msc
+{
+    ufunction_t func;
+    uep_t ep_in;
+    uep_t ep_out;
+    enum msc_stage stage;
+
+    rt_align(4) rt_uint8_t cbw[MSC_CBW_SIZE + 1];
+    rt_align(4) rt_uint8_t csw[MSC_CSW_SIZE + 3];
+    rt_align(4) rt_uint8_t response[36];
+    struct msc_command cmd;
+    rt_uint32_t residue;
+    rt_uint8_t status;
+
+    rt_uint8_t sense_key;
+    rt_uint8_t sense_asc;
+
+    /* a host reset bumps the session, the media thread drops the command it is running */
+    volatile rt_uint32_t session;
+    rt_uint32_t media_session;
+    rt_ssize_t xfer_size;
+    struct rt_semaphore cmd_sem;
+    struct rt_semaphore xfer_sem;
+    struct msc_disk disk;
+};
+
+rt_align(4)
+static struct udevice_descriptor _dev_desc =
+{
+    USB_DESC_LENGTH_DEVICE,             /* bLength */
+    USB_DESC_TYPE_DEVICE,               /* type */
+    0x0200,                             /* bcdUSB */
+    0x00,                               /* bDeviceClass, defined by the interface */
+    0x00,                               /* bDeviceSubClass */
+    0x00,                               /* bDeviceProtocol */
+    0x40,                               /* bMaxPacketSize0 */
+    0x0FFE,                             /* idVendor */
+    0x0004,                             /* idProduct */
+    0x0100,                             /* bcdDevice */
+    USB_STRING_MANU_INDEX,              /* iManufacturer */
+    USB_STRING_PRODUCT_INDEX,           /* iProduct */
+    USB_STRING_SERIAL_INDEX,            /* iSerialNumber */
+    USB_DYNAMIC,                        /* bNumConfigurations */
+};
+
+rt_align(4)
+static struct usb_qualifier_descriptor _dev_qualifier =
+{
+    sizeof(struct usb_qualifier_descriptor),
+    USB_DESC_TYPE_DEVICEQUALIFIER,
+    0x0200,
+    0x00,
+    0x00,
+    0x00,
+    0x40,
+    0x01,
+    0,
+};
+
+struct usbd_msc_descriptor
+{
+#ifdef RT_USB_DEVICE_COMPOSITE
+    struct uiad_descriptor iad_desc;
+#endif
+    struct uinterface_descriptor intf_desc;
+    struct uendpoint_descriptor ep_out_desc;
+    struct uendpoint_descriptor ep_in_desc;
+};
+
+rt_align(4)
+static struct usbd_msc_descriptor _msc_desc =
+{
+#ifdef RT_USB_DEVICE_COMPOSITE
+    {
+        USB_DESC_LENGTH_IAD,
+        USB_DESC_TYPE_IAD,
+        USB_DYNAMIC,
+        0x01,
+        USB_CLASS_MASS_STORAGE,
+        0x06,                           /* SCSI transparent command set */
+        0x50,                           /* bulk only transport */
+        0x00,
+    },
+#endif
+    {
+        USB_DESC_LENGTH_INTERFACE,
+        USB_DESC_TYPE_INTERFACE,
+        USB_DYNAMIC,
+        0x00,
+        0x02,
+        USB_CLASS_MASS_STORAGE,
+        0x06,
+        0x50,
+        0x00,
+    },
+    {
+        USB_DESC_LENGTH_ENDPOINT,
+        USB_DESC_TYPE_ENDPOINT,
+        USB_DYNAMIC | USB_DIR_OUT,
+        USB_EP_ATTR_BULK,
+        0x40,
+        0x00,
+    },
+    {
+        USB_DESC_LENGTH_ENDPOINT,
+        USB_DESC_TYPE_ENDPOINT,
+        USB_DYNAMIC | USB_DIR_IN,
+        USB_EP_ATTR_BULK,
+        0x40,
+        0x00,
+    },
+};
+
+rt_align(4)
+static const char *_ustring[] =
+{
+    "Language",
+    "GigaDevice",
+    "GD32 Mass Storage",
+    "20241020",
+    "Configuration",
+    "Interface",
+};
+
+rt_align(4)
+static const rt_uint8_t _inquiry[36] =
+{
+    0x00,                               /* direct access block device */
+    0x80,                               /* removable medium */
+    0x02,                               /* SPC-2 */
+    0x02,                               /* response data format */
+    36 - 5,                             /* additional length */
+    0x00, 0x00, 0x00,
+    'G', 'D', '3', '2', ' ', ' ', ' ', ' ',
+    'M', 'a', 's', 's', ' ', 'S', 't', 'o', 'r', 'a', 'g', 'e', ' ', ' ', ' ', ' ',
+    '1', '.', '0', '0',
+};
+
+static struct usbd_msc *_msc;
+
+static rt_uint32_t _get_le32(const rt_uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((rt_uint32_t)p[3] << 24);
+}
+
+static void _put_le32(rt_uint8_t *p, rt_uint32_t value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+static rt_uint32_t _get_be32(const rt_uint8_t *p)
+{
+    return ((rt_uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void _put_be32(rt_uint8_t *p, rt_uint32_t value)
+{
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+static void _set_sense(struct usbd_msc *msc, rt_uint8_t key, rt_uint8_t asc)
+{
+    msc->sense_key = key;
+    msc->sense_asc = asc;
+}
+
+static void _read_cbw(struct usbd_msc *msc)
+{
+    msc->stage = MSC_STAGE_CBW;
+
+    msc->ep_out->request.buffer = msc->cbw;
+    msc->ep_out->request.size = MSC_CBW_SIZE;
+    msc->ep_out->request.req_type = UIO_REQUEST_READ_BEST;
+    rt_usbd_io_request(msc->func->device, msc->ep_out, &msc->ep_out->request);
+}
+
+/* it is queued by the core while the bulk in endpoint is halted */
+static void _send_csw(struct usbd_msc *msc, rt_uint32_t tag, rt_uint32_t residue, rt_uint8_t status)
+{
+    _put_le32(&msc->csw[0], MSC_CSW_SIGNATURE);
+    _put_le32(&msc->csw[4], tag);
+    _put_le32(&msc->csw[8], residue);
+    msc->csw[12] = status;
+
+    msc->stage = MSC_STAGE_CSW;
+
+    msc->ep_in->request.buffer = msc->csw;
+    msc->ep_in->request.size = MSC_CSW_SIZE;
+    msc->ep_in->request.req_type = UIO_REQUEST_WRITE;
+    rt_usbd_io_request(msc->func->device, msc->ep_in, &msc->ep_in->request);
+}
+
+/* end a command without its data stage, the host is stopped by halting the endpoint it expects data on */
+static void _fail_command(struct usbd_msc *msc, rt_uint8_t status)
+{
+    if (msc->cmd.length)
+    {
+        rt_usbd_ep_set_stall(msc->func->device, (msc->cmd.flags & MSC_CBW_DIR_IN) ? msc->ep_in : msc->ep_out);
+    }
+
+    _send_csw(msc, msc->cmd.tag, msc->cmd.length, status);
+}
+
+static void _data_in(struct usbd_msc *msc, rt_size_t size)
+{
+    if (msc->cmd.length == 0)
+    {
+        _send_csw(msc, msc->cmd.tag, 0, MSC_CSW_PASSED);
+        return;
+    }
+
+    if (!(msc->cmd.flags & MSC_CBW_DIR_IN))
+    {
+        _fail_command(msc, MSC_CSW_PHASE_ERROR);
+        return;
+    }
+
+    /* a short packet ends the data stage, the rest is reported as residue */
+    size = RT_MIN(size, msc->cmd.length);
+    msc->residue = msc->cmd.length - size;
+    msc->status = MSC_CSW_PASSED;
+    msc->stage = MSC_STAGE_DATA_IN;
+
+    msc->ep_in->request.buffer = msc->response;
+    msc->ep_in->request.size = size;
+    msc->ep_in->request.req_type = UIO_REQUEST_WRITE;
+    rt_usbd_io_request(msc->func->device, msc->ep_in, &msc->ep_in->request);
+}
+
+static rt_bool_t _media_ready(struct usbd_msc *msc)
+{
+    /* the card may be inserted after the enumeration */
+    if (msc->disk.device == RT_NULL && msc_disk_attach(&msc->disk, BSP_USBD_MSC_DEVICE_NAME) != RT_EOK)
+    {
+        _set_sense(msc, SENSE_NOT_READY, ASC_MEDIUM_NOT_PRESENT);
+        return RT_FALSE;
+    }
+
+    return RT_TRUE;
+}
+
+static void _media_command(struct usbd_msc *msc, const rt_uint8_t *cb)
+{
+    rt_uint32_t lba = _get_be32(&cb[2]);
+    rt_uint32_t blocks = (cb[7] << 8) | cb[8];
+    rt_bool_t dir_in = (cb[0] == SCSI_READ_10);
+
+    if (!_media_ready(msc))
+    {
+        _fail_command(msc, MSC_CSW_FAILED);
+        return;
+    }
+
+    if (lba >= msc->disk.block_count || blocks > msc->disk.block_count - lba)
+    {
+        _set_sense(msc, SENSE_ILLEGAL_REQUEST, ASC_LBA_OUT_OF_RANGE);
+        _fail_command(msc, MSC_CSW_FAILED);
+        return;
+    }
+
+    /* the host must expect at least the blocks it asked for, in the same direction */
+    if ((rt_uint64_t)blocks * msc->disk.block_size > msc->cmd.length ||
+        (blocks && dir_in != !!(msc->cmd.flags & MSC_CBW_DIR_IN)))
+    {
+        _fail_command(msc, MSC_CSW_PHASE_ERROR);
+        return;
+    }
+
+    if (blocks == 0)
+    {
+        _fail_command(msc, MSC_CSW_PASSED);
+        return;
+    }
+
+    msc->cmd.opcode = cb[0];
+    msc->cmd.lba = lba;
+    msc->cmd.blocks = blocks;
+    msc->cmd.session = msc->session;
+    msc->stage = MSC_STAGE_MEDIA;
+    rt_sem_release(&msc->cmd_sem);
+}
+
+static void _scsi_command(struct usbd_msc *msc)
+{
+    const rt_uint8_t *cb = &msc->cbw[15];
+    rt_uint8_t *response = msc->response;
+    rt_size_t size = 0;
+
+    switch (cb[0])
+    {
+    case SCSI_READ_10:
+    case SCSI_WRITE_10:
+        _media_command(msc, cb);
+        return;
+
+    case SCSI_TEST_UNIT_READY:
+        if (!_media_ready(msc))
+        {
+            _fail_command(msc, MSC_CSW_FAILED);
+            return;
+        }
+        break;
+
+    case SCSI_REQUEST_SENSE:
+        rt_memset(response, 0, 18);
+        response[0] = 0x70;             /* current error */
+        response[2] = msc->sense_key;
+        response[7] = 18 - 8;
+        response[12] = msc->sense_asc;
+        _set_sense(msc, SENSE_NO_SENSE, 0);
+        size = 18;
+        break;
+
+    case SCSI_INQUIRY:
+        rt_memcpy(response, _inquiry, sizeof(_inquiry));
+        size = sizeof(_inquiry);
+        break;
+
+    case SCSI_MODE_SENSE_6:
+        rt_memset(response, 0, 4);
+        response[0] = 4 - 1;
+        size = 4;
+        break;
+
+    case SCSI_MODE_SENSE_10:
+        rt_memset(response, 0, 8);
+        response[1] = 8 - 2;
+        size = 8;
+        break;
+
+    case SCSI_READ_FORMAT_CAPACITIES:
+        if (!_media_ready(msc))
+        {
+            _fail_command(msc, MSC_CSW_FAILED);
+            return;
+        }
+        rt_memset(response, 0, 12);
+        response[3] = 8;
+        _put_be32(&response[4], msc->disk.block_count);
+        _put_be32(&response[8], msc->disk.block_size);
+        response[8] = 0x02;             /* formatted media */
+        size = 12;
+        break;
+
+    case SCSI_READ_CAPACITY_10:
+        if (!_media_ready(msc))
+        {
+            _fail_command(msc, MSC_CSW_FAILED);
+            return;
+        }
+        _put_be32(&response[0], msc->disk.block_count - 1);
+        _put_be32(&response[4], msc->disk.block_size);
+        size = 8;
+        break;
+
+    case SCSI_SYNCHRONIZE_CACHE_10:
+        if (msc->disk.device != RT_NULL)
+        {
+            rt_device_control(msc->disk.device, RT_DEVICE_CTRL_BLK_SYNC, RT_NULL);
+        }
+        break;
+
+    case SCSI_START_STOP_UNIT:
+    case SCSI_ALLOW_MEDIUM_REMOVAL:
+    case SCSI_VERIFY_10:
+        break;
+
+    default:
+        LOG_D("unsupported command 0x%02x", cb[0]);
+        _set_sense(msc, SENSE_ILLEGAL_REQUEST, ASC_INVALID_COMMAND);
+        _fail_command(msc, MSC_CSW_FAILED);
+        return;
+    }
+
+    _data_in(msc, size);
+}
+
+static void _cbw_handler(struct usbd_msc *msc, rt_size_t size)
+{
+    if (size != MSC_CBW_SIZE || _get_le32(&msc->cbw[0]) != MSC_CBW_SIGNATURE)
+    {
+        LOG_W("invalid command block");
+        msc->stage = MSC_STAGE_ERROR;
+        rt_usbd_ep_set_stall(msc->func->device, msc->ep_in);
+        rt_usbd_ep_set_stall(msc->func->device, msc->ep_out);
+        return;
+    }
+
+    msc->cmd.tag = _get_le32(&msc->cbw[4]);
+    msc->cmd.length = _get_le32(&msc->cbw[8]);
+    msc->cmd.flags = msc->cbw[12];
+
+    _scsi_command(msc);
+}
+
+/* drop the command the media thread is running, it returns without sending the status */
+static void _abort(struct usbd_msc *msc)
+{
+    msc->session ++;
+    rt_sem_release(&msc->xfer_sem);
+}
+
+static rt_err_t _xfer_start(struct msc_disk *disk, int dir, rt_uint8_t *buffer, rt_size_t size)
+{
+    struct usbd_msc *msc = disk->user_data;
+    uep_t ep = (dir == MSC_DISK_XFER_IN) ? msc->ep_in : msc->ep_out;
+
+    /* a reset from the host must not slip in between the check and the request */
+    rt_enter_critical();
+
+    if (msc->media_session != msc->session)
+    {
+        rt_exit_critical();
+        return -RT_ERROR;
+    }
+
+    msc->xfer_size = size;
+    ep->request.buffer = buffer;
+    ep->request.size = size;
+    ep->request.req_type = (dir == MSC_DISK_XFER_IN) ? UIO_REQUEST_WRITE : UIO_REQUEST_READ_FULL;
+    rt_usbd_io_request(msc->func->device, ep, &ep->request);
+
+    rt_exit_critical();
+
+    return RT_EOK;
+}
+
+static rt_ssize_t _xfer_wait(struct msc_disk *disk)
+{
+    struct usbd_msc *msc = disk->user_data;
+
+    rt_sem_take(&msc->xfer_sem, RT_WAITING_FOREVER);
+
+    if (msc->media_session != msc->session)
+    {
+        return -RT_ERROR;
+    }
+
+    return msc->xfer_size;
+}
+
+static const struct msc_disk_xfer_ops _xfer_ops =
+{
+    _xfer_start,
+    _xfer_wait,
+};
+
+static void _media_thread_entry(void *parameter)
+{
+    struct usbd_msc *msc = parameter;
+    struct msc_command cmd;
+    rt_uint8_t status;
+    rt_ssize_t done;
+
+    while (1)
+    {
+        rt_sem_take(&msc->cmd_sem, RT_WAITING_FOREVER);
+
+        cmd = msc->cmd;
+        msc->media_session = cmd.session;
+        rt_sem_control(&msc->xfer_sem, RT_IPC_CMD_RESET, RT_NULL);
+
+        if (cmd.opcode == SCSI_READ_10)
+        {
+            done = msc_disk_read(&msc->disk, cmd.lba, cmd.blocks);
+        }
+        else
+        {
+            done = msc_disk_write(&msc->disk, cmd.lba, cmd.blocks);
+        }
+
+        if (cmd.session != msc->session)
+        {
+            continue;
+        }
+
+        status = MSC_CSW_PASSED;
+        if (msc->disk.error != RT_EOK)
+        {
+            _set_sense(msc, SENSE_MEDIUM_ERROR,
+                       (cmd.opcode == SCSI_READ_10) ? ASC_UNRECOVERED_READ_ERROR : ASC_WRITE_FAULT);
+            status = MSC_CSW_FAILED;
+        }
+
+        if (done < cmd.length)
+        {
+            rt_usbd_ep_set_stall(msc->func->device, (cmd.opcode == SCSI_READ_10) ? msc->ep_in : msc->ep_out);
+        }
+
+        _send_csw(msc, cmd.tag, cmd.length - done, status);
+    }
+}
+
+static rt_err_t _ep_in_handler(ufunction_t func, rt_size_t size)
+{
+    struct usbd_msc *msc = func->user_data;
+
+    switch (msc->stage)
+    {
+    case MSC_STAGE_DATA_IN:
+        _send_csw(msc, msc->cmd.tag, msc->residue, msc->status);
+        break;
+
+    case MSC_STAGE_MEDIA:
+        rt_sem_release(&msc->xfer_sem);
+        break;
+
+    case MSC_STAGE_CSW:
+        _read_cbw(msc);
+        break;
+
+    default:
+        break;
+    }
+
+    return RT_EOK;
+}
+
+static rt_err_t _ep_out_handler(ufunction_t func, rt_size_t size)
+{
+    struct usbd_msc *msc = func->user_data;
+
+    switch (msc->stage)
+    {
+    case MSC_STAGE_CBW:
+        _cbw_handler(msc, size);
+        break;
+
+    case MSC_STAGE_MEDIA:
+        msc->xfer_size = size;
+        rt_sem_release(&msc->xfer_sem);
+        break;
+
+    default:
+        break;
+    }
+
+    return RT_EOK;
+}
+
+static rt_err_t _interface_handler(ufunction_t func, ureq_t setup)
+{
+    struct usbd_msc *msc = func->user_data;
+    static rt_uint8_t lun = 0;
+
+    switch (setup->bRequest)
+    {
+    case MSC_REQ_GET_MAX_LUN:
+        rt_usbd_ep0_write(func->device, &lun, 1);
+        break;
+
+    case MSC_REQ_RESET:
+        _abort(msc);
+        /* the out endpoint is still armed for a command block in this stage */
+        if (msc->stage != MSC_STAGE_CBW)
+        {
+            _read_cbw(msc);
+        }
+        dcd_ep0_send_status(func->device->dcd);
+        break;
+
+    default:
+        rt_usbd_ep0_set_stall(func->device);
+        break;
+    }
+
+    return RT_EOK;
+}
+
+static rt_err_t _function_enable(ufunction_t func)
+{
+    struct usbd_msc *msc = func->user_data;
+
+    _abort(msc);
+
+    if (msc->disk.device == RT_NULL && msc_disk_attach(&msc->disk, BSP_USBD_MSC_DEVICE_NAME) != RT_EOK)
+    {
+        LOG_W("block device %s is not ready", BSP_USBD_MSC_DEVICE_NAME);
+    }
+
+    _read_cbw(msc);
+
+    return RT_EOK;
+}
+
+static rt_err_t _function_disable(ufunction_t func)
+{
+    struct usbd_msc *msc = func->user_data;
+
+    _abort(msc);
+    msc->stage = MSC_STAGE_CBW;
+
+    return RT_EOK;
+}
+
+static struct ufunction_ops _ops =
+{
+    _function_enable,
+    _function_disable,
+    RT_NULL,
+};
+
+static ufunction_t usbd_function_msc_create(udevice_t device)
+{
+    struct usbd_msc_descriptor *desc;
+    struct usbd_msc *msc;
+    ualtsetting_t setting;
+    rt_thread_t thread;
+    ufunction_t func;
+    uintf_t intf;
+
+    msc = rt_malloc(sizeof(struct usbd_msc));
+    if (msc == RT_NULL)
+    {
+        LOG_E("no memory for the mass storage function");
+        return RT_NULL;
+    }
+    rt_memset(msc, 0, sizeof(struct usbd_msc));
+
+    if (msc_disk_init(&msc->disk, BSP_USBD_MSC_BUFFER_SIZE, &_xfer_ops, msc) != RT_EOK)
+    {
+        rt_free(msc);
+        return RT_NULL;
+    }
+
+    rt_sem_init(&msc->cmd_sem, "msc_cmd", 0, RT_IPC_FLAG_FIFO);
+    rt_sem_init(&msc->xfer_sem, "msc_xfer", 0, RT_IPC_FLAG_FIFO);
+
+    thread = rt_thread_create("usbd_msc", _media_thread_entry, msc,
+                              MSC_THREAD_STACK_SIZE, MSC_THREAD_PRIORITY, 20);
+    RT_ASSERT(thread != RT_NULL);
+    rt_thread_startup(thread);
+
+#ifndef RT_USB_DEVICE_COMPOSITE
+    rt_usbd_device_set_string(device, _ustring);
+#endif
+
+    func = rt_usbd_function_new(device, &_dev_desc, &_ops);
+    device->dev_qualifier = &_dev_qualifier;
+    func->user_data = msc;
+    msc->func = func;
+
+    intf = rt_usbd_interface_new(device, _interface_handler);
+    setting = rt_usbd_altsetting_new(sizeof(struct usbd_msc_descriptor));
+    rt_usbd_altsetting_config_descriptor(setting, &_msc_desc,
+                                         (rt_off_t)&((struct usbd_msc_descriptor *)0)->intf_desc);
+
+    desc = (struct usbd_msc_descriptor *)setting->desc;
+    desc->ep_out_desc.wMaxPacketSize = device->dcd->device_is_hs ? 512 : 64;
+    desc->ep_in_desc.wMaxPacketSize = device->dcd->device_is_hs ? 512 : 64;
+    msc->ep_out = rt_usbd_endpoint_new(&desc->ep_out_desc, _ep_out_handler);
+    msc->ep_in = rt_usbd_endpoint_new(&desc->ep_in_desc, _ep_in_handler);
+
+    rt_usbd_altsetting_add_endpoint(setting, msc->ep_out);
+    rt_usbd_altsetting_add_endpoint(setting, msc->ep_in);
+    rt_usbd_interface_add_altsetting(intf, setting);
+    rt_usbd_set_altsetting(intf, 0);
+    rt_usbd_function_add_interface(func, intf);
+
+    _msc = msc;
+
+    return func;
+}
+
+static struct udclass _msc_class =
+{
+    .rt_usbd_function_create = usbd_function_msc_create
+};
+
+static int usbd_msc_class_register(void)
+{
+    rt_usbd_class_register(&_msc_class);
+    return 0;
+}
+INIT_PREV_EXPORT(usbd_msc_class_register);
+
+#ifdef RT_USING_FINSH
+static void usbd_msc(void)
+{
+    if (_msc == RT_NULL)
+    {
+        rt_kprintf("the mass storage function is not created\n");
+        return;
+    }
+
+    if (_msc->disk.device != RT_NULL)
+    {
+        rt_kprintf("device  : %s, %d blocks of %d bytes\n", BSP_USBD_MSC_DEVICE_NAME,
+                   _msc->disk.block_count, _msc->disk.block_size);
+    }
+    else
+    {
+        rt_kprintf("device  : %s, not ready\n", BSP_USBD_MSC_DEVICE_NAME);
+    }
+    rt_kprintf("buffers : 2 x %d bytes\n", _msc->disk.buffer_size);
+    rt_kprintf("read    : %d KB\n", (rt_uint32_t)(_msc->disk.read_bytes >> 10));
+    rt_kprintf("written : %d KB\n", (rt_uint32_t)(_msc->disk.write_bytes >> 10));
+    rt_kprintf("errors  : %d\n", _msc->disk.media_errors);
+}
+MSH_CMD_EXPORT(usbd_msc, show the usb mass storage status);
+#endif /* RT_USING_FINSH */
@@ -6,6 +6,7 @@
  * Change Logs:
  * Date         Author      Notes
  * 2024-01-08   Evlers      first implementation
+ * 2024-10-19   Evlers      save the config length and information by an ENV transaction
  */
 #include <stdio.h>
 #include <stdlib.h>
@@ -50,11 +51,25 @@ static int get_len(void)
 
 static int write_cfg(void *buff, int len)
 {
+#ifdef EF_ENV_USING_TXN
+    /* the wlan config lengths and information are saved together or not at all */
+    if (ef_env_txn_begin() != EF_NO_ERR)
+    {
+        return 0;
+    }
+    ef_env_txn_set("wlan_cfg_len", &len, sizeof(len));
+    ef_env_txn_set("wlan_cfg_info", buff, len);
+    if (ef_env_txn_commit() != EF_NO_ERR)
+    {
+        return 0;
+    }
+#else
     /* set and store the wlan config lengths to Env */
     ef_set_env_blob("wlan_cfg_len", &len, sizeof(len));
 
     /* set and store the wlan config information to Env */
     ef_set_env_blob("wlan_cfg_info", buff, len);
+#endif /* EF_ENV_USING_TXN */
 
     return len;
 }
@@ -161,6 +161,11 @@ Reset_Handler   PROC
                 EXPORT  Reset_Handler                     [WEAK]
                 IMPORT  SystemInit
                 IMPORT  __main
+                ; enable the TCMSRAM clock (RCU_AHB1EN) before its data is initialized
+                LDR     R0, =0x40023830
+                LDR     R1, [R0]
+                ORR     R1, R1, #0x00100000
+                STR     R1, [R0]
                 LDR     R0, =SystemInit
                 BLX     R0
                 LDR     R0, =__main
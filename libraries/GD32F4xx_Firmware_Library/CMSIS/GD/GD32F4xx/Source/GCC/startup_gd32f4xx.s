@@ -154,13 +154,45 @@ fill_bss_start:
     ldr r2, =__bss_end
     movs r0, 0
     subs r2, r1
-    ble startup_enter
+    ble tcmram_start
 
 loop_fill_bss:
     subs r2, #4
     str r0, [r1, r2]
     bgt loop_fill_bss
 
+tcmram_start:
+    /* enable the TCMSRAM clock (RCU_AHB1EN) */
+    ldr r1, =0x40023830
+    ldr r0, [r1]
+    orr r0, r0, #0x00100000
+    str r0, [r1]
+
+    ldr r1, =_sitcmram
+    ldr r2, =_stcmram
+    ldr r3, =_etcmram
+
+    subs r3, r2
+    ble fill_tcmram_bss_start
+
+loop_copy_tcmram:
+    subs r3, #4
+    ldr r0, [r1,r3]
+    str r0, [r2,r3]
+    bgt loop_copy_tcmram
+
+fill_tcmram_bss_start:
+    ldr r1, =_stcmram_bss
+    ldr r2, =_etcmram_bss
+    movs r0, 0
+    subs r2, r1
+    ble startup_enter
+
+loop_fill_tcmram_bss:
+    subs r2, #4
+    str r0, [r1, r2]
+    bgt loop_fill_tcmram_bss
+
 startup_enter:
     bl SystemInit
     bl entry
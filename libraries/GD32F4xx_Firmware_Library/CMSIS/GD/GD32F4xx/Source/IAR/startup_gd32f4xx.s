@@ -143,6 +143,11 @@ __vector_table
         PUBWEAK Reset_Handler
         SECTION .text:CODE:NOROOT:REORDER(2)
 Reset_Handler
+        ; enable the TCMSRAM clock (RCU_AHB1EN) before its data is initialized
+        LDR     R0, =0x40023830
+        LDR     R1, [R0]
+        ORR     R1, R1, #0x00100000
+        STR     R1, [R0]
         LDR     R0, =SystemInit
         BLX     R0
         LDR     R0, =__iar_program_start
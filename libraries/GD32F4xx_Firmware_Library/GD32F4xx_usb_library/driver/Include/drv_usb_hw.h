@@ -54,6 +54,10 @@ void usb_udelay (const uint32_t usec);
 void usb_mdelay (const uint32_t msec);
 /* configures system clock after wakeup from STOP mode */
 void system_clk_config_stop(void);
+#ifdef USB_FIFO_DMA_ENABLED
+/* move words between a FIFO and a word aligned buffer with a DMA channel, returns the words moved */
+uint32_t usb_fifo_dma_copy (uint32_t fifo, uint32_t buf, uint32_t word_count, uint8_t to_fifo);
+#endif /* USB_FIFO_DMA_ENABLED */
 #ifdef USE_HOST_MODE
 /* configure USB VBus */
 void usb_vbus_config (void);
@@ -36,6 +36,7 @@ OF SUCH DAMAGE.
 
 #include "drv_usb_core.h"
 #include "drv_usb_hw.h"
+#include <string.h>
 
 /* local function prototypes ('static') */
 static void usb_core_reset (usb_core_regs *usb_regs);
@@ -213,6 +214,34 @@ usb_status usb_core_init (usb_core_basic usb_basic, usb_core_regs *usb_regs)
     return USB_OK;
 }
 
+/*!
+    \brief      load a word from a buffer of any alignment
+    \param[in]  buf: pointer to the first byte
+    \param[out] none
+    \retval     the word
+*/
+static inline uint32_t usb_word_get (const uint8_t *buf)
+{
+    uint32_t word;
+
+    /* a single unaligned load on Cortex-M4, never merged into LDM/LDRD */
+    memcpy (&word, buf, 4U);
+
+    return word;
+}
+
+/*!
+    \brief      store a word into a buffer of any alignment
+    \param[in]  buf: pointer to the first byte
+    \param[in]  word: the word
+    \param[out] none
+    \retval     none
+*/
+static inline void usb_word_put (uint8_t *buf, uint32_t word)
+{
+    memcpy (buf, &word, 4U);
+}
+
 /*!
     \brief      write a packet into the Tx FIFO associated with the endpoint
     \param[in]  usb_regs: pointer to USB core registers
@@ -227,14 +256,67 @@ usb_status usb_txfifo_write (usb_core_regs *usb_regs,
                              uint8_t  fifo_num, 
                              uint16_t byte_count)
 {
-    uint32_t word_count = (byte_count + 3U) / 4U;
+    uint32_t word_count = (uint32_t)byte_count / 4U;
+    uint32_t tail = (uint32_t)byte_count & 3U;
 
     __IO uint32_t *fifo = usb_regs->DFIFO[fifo_num];
 
-    while (word_count-- > 0U) {
-        *fifo = *((__packed uint32_t *)src_buf);
+#ifdef USB_FIFO_DMA_ENABLED
+    if ((byte_count >= USB_FIFO_DMA_MIN_SIZE) && (0U == ((uint32_t)src_buf & 3U))) {
+        uint32_t moved = usb_fifo_dma_copy ((uint32_t)fifo, (uint32_t)src_buf, word_count, 1U);
 
-        src_buf += 4U;
+        src_buf += moved * 4U;
+        word_count -= moved;
+    }
+#endif /* USB_FIFO_DMA_ENABLED */
+
+    if (0U == ((uint32_t)src_buf & 3U)) {
+        const uint32_t *src = (const uint32_t *)src_buf;
+
+        /* the eight loads compile to one LDM */
+        while (word_count >= 8U) {
+            uint32_t w0 = src[0], w1 = src[1], w2 = src[2], w3 = src[3];
+            uint32_t w4 = src[4], w5 = src[5], w6 = src[6], w7 = src[7];
+
+            *fifo = w0; *fifo = w1; *fifo = w2; *fifo = w3;
+            *fifo = w4; *fifo = w5; *fifo = w6; *fifo = w7;
+
+            src += 8U;
+            word_count -= 8U;
+        }
+
+        while (word_count-- > 0U) {
+            *fifo = *src++;
+        }
+
+        src_buf = (uint8_t *)src;
+    } else {
+        while (word_count >= 4U) {
+            *fifo = usb_word_get (src_buf);
+            *fifo = usb_word_get (src_buf + 4U);
+            *fifo = usb_word_get (src_buf + 8U);
+            *fifo = usb_word_get (src_buf + 12U);
+
+            src_buf += 16U;
+            word_count -= 4U;
+        }
+
+        while (word_count-- > 0U) {
+            *fifo = usb_word_get (src_buf);
+
+            src_buf += 4U;
+        }
+    }
+
+    /* the last word is assembled from the remaining bytes, nothing past the buffer is read */
+    if (tail > 0U) {
+        uint32_t word = 0U, i;
+
+        for (i = 0U; i < tail; i++) {
+            word |= (uint32_t)src_buf[i] << (8U * i);
+        }
+
+        *fifo = word;
     }
 
     return USB_OK;
@@ -250,14 +332,67 @@ usb_status usb_txfifo_write (usb_core_regs *usb_regs,
 */
 void *usb_rxfifo_read (usb_core_regs *usb_regs, uint8_t *dest_buf, uint16_t byte_count)
 {
-    uint32_t word_count = (byte_count + 3U) / 4U;
+    uint32_t word_count = (uint32_t)byte_count / 4U;
+    uint32_t tail = (uint32_t)byte_count & 3U;
 
     __IO uint32_t *fifo = usb_regs->DFIFO[0];
 
-    while (word_count-- > 0U) {
-        *(__packed uint32_t *)dest_buf = *fifo;
+#ifdef USB_FIFO_DMA_ENABLED
+    if ((byte_count >= USB_FIFO_DMA_MIN_SIZE) && (0U == ((uint32_t)dest_buf & 3U))) {
+        uint32_t moved = usb_fifo_dma_copy ((uint32_t)fifo, (uint32_t)dest_buf, word_count, 0U);
+
+        dest_buf += moved * 4U;
+        word_count -= moved;
+    }
+#endif /* USB_FIFO_DMA_ENABLED */
+
+    if (0U == ((uint32_t)dest_buf & 3U)) {
+        uint32_t *dest = (uint32_t *)dest_buf;
+
+        /* the eight stores compile to one STM */
+        while (word_count >= 8U) {
+            uint32_t w0 = *fifo, w1 = *fifo, w2 = *fifo, w3 = *fifo;
+            uint32_t w4 = *fifo, w5 = *fifo, w6 = *fifo, w7 = *fifo;
+
+            dest[0] = w0; dest[1] = w1; dest[2] = w2; dest[3] = w3;
+            dest[4] = w4; dest[5] = w5; dest[6] = w6; dest[7] = w7;
+
+            dest += 8U;
+            word_count -= 8U;
+        }
+
+        while (word_count-- > 0U) {
+            *dest++ = *fifo;
+        }
+
+        dest_buf = (uint8_t *)dest;
+    } else {
+        while (word_count >= 4U) {
+            usb_word_put (dest_buf, *fifo);
+            usb_word_put (dest_buf + 4U, *fifo);
+            usb_word_put (dest_buf + 8U, *fifo);
+            usb_word_put (dest_buf + 12U, *fifo);
+
+            dest_buf += 16U;
+            word_count -= 4U;
+        }
+
+        while (word_count-- > 0U) {
+            usb_word_put (dest_buf, *fifo);
+
+            dest_buf += 4U;
+        }
+    }
+
+    /* the last word is popped whole, only the bytes of the packet are stored */
+    if (tail > 0U) {
+        uint32_t word = *fifo, i;
+
+        for (i = 0U; i < tail; i++) {
+            dest_buf[i] = (uint8_t)(word >> (8U * i));
+        }
 
-        dest_buf += 4U;
+        dest_buf += tail;
     }
 
     return ((void *)dest_buf);
@@ -313,7 +313,12 @@ static uint32_t usbh_int_pipe_in (usb_core_driver *udev, uint32_t pp_num)
         case USB_EPTYPE_BULK:
             usb_pp_halt (udev, (uint8_t)pp_num, HCHINTF_NAK, PIPE_XF);
 
-            pp->data_toggle_in ^= 1U;
+            /* the core advances the PID per packet, a transfer may hold an even number of them */
+            if (PIPE_DPID_DATA1 == (pp_reg->HCHLEN & HCHLEN_DPID)) {
+                pp->data_toggle_in = 1U;
+            } else {
+                pp->data_toggle_in = 0U;
+            }
             break;
 
         case USB_EPTYPE_INTR:
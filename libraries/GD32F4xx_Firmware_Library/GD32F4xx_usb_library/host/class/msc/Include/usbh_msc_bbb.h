@@ -50,6 +50,7 @@ typedef union {
     msc_bbb_csw field;
 
     uint8_t CSWArray[13];
+    uint32_t CSWWords[4];   /* the DMA stores whole words to a word aligned address */
 } usbh_csw_pkt;
 
 enum usbh_msc_state {
@@ -113,10 +114,16 @@ typedef struct
     bbb_cmd_state           cmd_state;
     usbh_cbw_pkt            cbw;
     usbh_csw_pkt            csw;
+    uint16_t                xfer_len;       /* length of the data IN transfer in progress */
 } bbb_handle;
 
 #define USBH_MSC_BBB_CBW_TAG                0x20304050U
 
+/* the data IN stage is received in transfers of up to this many bytes, rounded down to whole packets */
+#ifndef USBH_MSC_BBB_MAX_XFER_LEN
+#define USBH_MSC_BBB_MAX_XFER_LEN           32768U
+#endif /* USBH_MSC_BBB_MAX_XFER_LEN */
+
 #define USBH_MSC_CSW_MAX_LENGTH             63U
 
 #define USBH_MSC_SEND_CSW_DISABLE           0U
@@ -43,6 +43,11 @@ OF SUCH DAMAGE.
 
 #define MSC_MAX_SUPPORTED_LUN                   2U
 
+/* called while a read or write waits for the device, the platform may sleep until the next channel event */
+#ifndef USBH_MSC_RDWR_WAIT
+#define USBH_MSC_RDWR_WAIT(uhost)
+#endif /* USBH_MSC_RDWR_WAIT */
+
 typedef enum
 {
     MSC_INIT = 0U,
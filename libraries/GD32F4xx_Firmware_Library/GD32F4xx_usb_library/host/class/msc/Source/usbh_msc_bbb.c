@@ -41,6 +41,9 @@ OF SUCH DAMAGE.
 #include "usbh_transc.h"
 #include "drv_usbh_int.h"
 
+/* local function prototypes ('static') */
+static uint16_t usbh_msc_bbb_xfer_len (usbh_msc_handler *msc);
+
 /*!
     \brief      initialize the mass storage parameters
     \param[in]  uhost: pointer to USB host handler
@@ -107,10 +110,12 @@ usbh_status usbh_msc_bbb_process (usbh_host *uhost, uint8_t lun)
         break;
 
     case BBB_DATA_IN:
+        msc->bbb.xfer_len = usbh_msc_bbb_xfer_len (msc);
+
         usbh_data_recev (uhost->data, 
                          msc->bbb.pbuf, 
                          msc->pipe_in, 
-                         msc->ep_size_in);
+                         msc->bbb.xfer_len);
 
         msc->bbb.state = BBB_DATA_IN_WAIT;
         break;
@@ -120,18 +125,23 @@ usbh_status usbh_msc_bbb_process (usbh_host *uhost, uint8_t lun)
 
         /* BBB DATA IN stage */
         if (URB_DONE == urb_status) {
-            if (msc->bbb.cbw.field.dCBWDataTransferLength > msc->ep_size_in) {
-                msc->bbb.pbuf += msc->ep_size_in;
-                msc->bbb.cbw.field.dCBWDataTransferLength -= msc->ep_size_in;
+            uint32_t count = usbh_xfercount_get(uhost->data, msc->pipe_in);
+
+            if (msc->bbb.cbw.field.dCBWDataTransferLength > count) {
+                msc->bbb.pbuf += count;
+                msc->bbb.cbw.field.dCBWDataTransferLength -= count;
             } else {
                 msc->bbb.cbw.field.dCBWDataTransferLength = 0U;
             }
 
-            if (msc->bbb.cbw.field.dCBWDataTransferLength > 0U) {
+            /* a short transfer ends the data stage, the device sends the CSW next */
+            if ((msc->bbb.cbw.field.dCBWDataTransferLength > 0U) && (count >= msc->bbb.xfer_len)) {
+                msc->bbb.xfer_len = usbh_msc_bbb_xfer_len (msc);
+
                 usbh_data_recev (uhost->data, 
                                  msc->bbb.pbuf, 
                                  msc->pipe_in, 
-                                 msc->ep_size_in);
+                                 msc->bbb.xfer_len);
             } else {
                 msc->bbb.state = BBB_RECEIVE_CSW;
             }
@@ -253,6 +263,32 @@ usbh_status usbh_msc_bbb_process (usbh_host *uhost, uint8_t lun)
     return status;
 }
 
+/*!
+    \brief      get the length of the next transfer of the data IN stage
+    \param[in]  msc: pointer to MSC handler
+    \param[out] none
+    \retval     transfer length in bytes
+*/
+static uint16_t usbh_msc_bbb_xfer_len (usbh_msc_handler *msc)
+{
+    uint32_t max_len = USBH_MSC_BBB_MAX_XFER_LEN;
+    uint32_t len = msc->bbb.cbw.field.dCBWDataTransferLength;
+
+    /* the channel moves up to HC_MAX_PACKET_COUNT packets per transfer */
+    if (max_len > (HC_MAX_PACKET_COUNT * (uint32_t)msc->ep_size_in)) {
+        max_len = HC_MAX_PACKET_COUNT * (uint32_t)msc->ep_size_in;
+    }
+
+    /* only the last transfer may end with a short packet */
+    max_len -= max_len % msc->ep_size_in;
+
+    if (len > max_len) {
+        len = max_len;
+    }
+
+    return (uint16_t)len;
+}
+
 /*!
     \brief      manages the different error handling for stall
     \param[in]  uhost: pointer to USB host handler
@@ -507,6 +507,8 @@ usbh_status usbh_msc_read (usbh_host *uhost,
             msc->state = MSC_IDLE;
             return USBH_FAIL;
         }
+
+        USBH_MSC_RDWR_WAIT(uhost);
     }
 
     msc->state = MSC_IDLE;
@@ -555,6 +557,8 @@ usbh_status usbh_msc_write (usbh_host *uhost,
             msc->state = MSC_IDLE;
             return USBH_FAIL;
         }
+
+        USBH_MSC_RDWR_WAIT(uhost);
     }
 
     msc->state = MSC_IDLE;
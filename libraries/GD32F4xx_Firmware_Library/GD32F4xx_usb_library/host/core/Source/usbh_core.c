@@ -362,7 +362,11 @@ void usbh_core_task (usbh_host *uhost)
         /* deinitialize host for new enumeration */
         usbh_deinit (uhost);
         uhost->usr_cb->dev_deinit();
-        uhost->active_class->class_deinit(uhost);
+
+        /* the device may go before a class is bound */
+        if (NULL != uhost->active_class) {
+            uhost->active_class->class_deinit(uhost);
+        }
         break;
 
     case HOST_DEV_DETACHED:
@@ -372,7 +376,11 @@ void usbh_core_task (usbh_host *uhost)
         /* re-initialize host for new enumeration */
         usbh_deinit (uhost);
         uhost->usr_cb->dev_deinit();
-        uhost->active_class->class_deinit(uhost);
+
+        /* the device may go before a class is bound */
+        if (NULL != uhost->active_class) {
+            uhost->active_class->class_deinit(uhost);
+        }
         usbh_pipe_delete(udev);
         uhost->cur_state = HOST_DEFAULT;
         break;
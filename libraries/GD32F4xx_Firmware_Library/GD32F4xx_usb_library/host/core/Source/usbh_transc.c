@@ -367,6 +367,7 @@ static uint32_t usbh_request_submit (usb_core_driver *udev, uint8_t pp_num)
 {
     udev->host.pipe[pp_num].urb_state = URB_IDLE;
     udev->host.pipe[pp_num].xfer_count = 0U;
+    udev->host.backup_xfercount[pp_num] = 0U;
 
     if (1U == udev->host.pipe[pp_num].do_ping) {
         (void)usb_pipe_ping (udev, (uint8_t)pp_num);
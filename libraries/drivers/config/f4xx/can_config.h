@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2006-2024 RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-25   Evlers      first implementation
+ */
+
+#ifndef _CAN_CONFIG_H_
+#define _CAN_CONFIG_H_
+
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(BSP_USING_CAN0)
+#ifndef CAN0_CONFIG
+#define CAN0_CONFIG                                         \
+    {                                                       \
+        "can0",                                             \
+        CAN0,                                               \
+        CAN0_TX_IRQn, CAN0_RX0_IRQn,                        \
+        CAN0_RX1_IRQn, CAN0_EWMC_IRQn,                      \
+        RCU_CAN0, RCU_GPIOD, RCU_GPIOD,                     \
+        GPIOD, GPIO_AF_9, GPIO_PIN_1,                       \
+        GPIOD, GPIO_AF_9, GPIO_PIN_0,                       \
+    }
+#endif /* CAN0_CONFIG */
+#endif /* BSP_USING_CAN0 */
+
+#if defined(BSP_USING_CAN1)
+#ifndef CAN1_CONFIG
+#define CAN1_CONFIG                                         \
+    {                                                       \
+        "can1",                                             \
+        CAN1,                                               \
+        CAN1_TX_IRQn, CAN1_RX0_IRQn,                        \
+        CAN1_RX1_IRQn, CAN1_EWMC_IRQn,                      \
+        RCU_CAN1, RCU_GPIOB, RCU_GPIOB,                     \
+        GPIOB, GPIO_AF_9, GPIO_PIN_13,                      \
+        GPIOB, GPIO_AF_9, GPIO_PIN_12,                      \
+    }
+#endif /* CAN1_CONFIG */
+#endif /* BSP_USING_CAN1 */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CAN_CONFIG_H_ */
@@ -6,6 +6,9 @@
  * Change Logs:
  * Date         Author      Notes
  * 2024-03-20   Evlers      first implementation
+ * 2024-10-20   Evlers      add the usb fifo dma channel
+ * 2024-10-24   Evlers      add the dci dma channel
+ * 2024-10-26   Evlers      add the dac dma channels
  */
 
 #ifndef _DMA_CONFIG_H_
@@ -97,6 +100,9 @@ extern "C" {
 #elif defined(BSP_UART1_RX_USING_DMA) && !defined(UART1_RX_DMA_CONFIG)
 #define UART1_RX_DMA_CONFIG             DRV_DMA_CONFIG(0, 5, 4)
 #define UART1_DMA_RX_IRQHandler         DMA0_Channel5_IRQHandler
+#elif defined(BSP_DAC_USING_STREAM) && defined(BSP_USING_DAC0) && !defined(DAC0_DMA_CONFIG)
+#define DAC0_DMA_CONFIG                 DRV_DMA_CONFIG(0, 5, 7)
+#define DAC0_DMA_IRQHandler             DMA0_Channel5_IRQHandler
 #endif
 
 /* DMA0 Channel6 */
@@ -109,6 +115,9 @@ extern "C" {
 #elif defined(BSP_UART7_RX_USING_DMA) && !defined(UART7_RX_DMA_CONFIG)
 #define UART7_RX_DMA_CONFIG             DRV_DMA_CONFIG(0, 6, 5)
 #define UART7_DMA_RX_IRQHandler         DMA0_Channel6_IRQHandler
+#elif defined(BSP_DAC_USING_STREAM) && defined(BSP_USING_DAC1) && !defined(DAC1_DMA_CONFIG)
+#define DAC1_DMA_CONFIG                 DRV_DMA_CONFIG(0, 6, 7)
+#define DAC1_DMA_IRQHandler             DMA0_Channel6_IRQHandler
 #endif
 
 /* DMA0 Channel7 */
@@ -143,6 +152,9 @@ extern "C" {
 #elif defined(BSP_UART5_RX_USING_DMA) && !defined(UART5_RX_DMA_CONFIG)
 #define UART5_RX_DMA_CONFIG             DRV_DMA_CONFIG(1, 1, 5)
 #define UART5_DMA_RX_IRQHandler         DMA1_Channel1_IRQHandler
+#elif defined(BSP_USING_DCI) && !defined(DCI_DMA_CONFIG)
+#define DCI_DMA_CONFIG                  DRV_DMA_CONFIG(1, 1, 1)
+#define DCI_DMA_IRQHandler              DMA1_Channel1_IRQHandler
 #endif
 
 /* DMA1 Channel2 */
@@ -179,6 +191,8 @@ extern "C" {
 #elif defined(BSP_SPI3_TX_USING_DMA) && !defined(SPI3_TX_DMA_CONFIG)
 #define SPI3_TX_DMA_CONFIG              DRV_DMA_CONFIG(1, 4, 5)
 #define SPI3_DMA_TX_IRQHandler          DMA1_Channel4_IRQHandler
+#elif defined(BSP_USB_FIFO_USING_DMA) && !defined(USB_FIFO_DMA_CONFIG)
+#define USB_FIFO_DMA_CONFIG             DRV_DMA_CONFIG(1, 4, 0)
 #endif
 
 /* DMA1 Channel5 */
@@ -218,6 +232,11 @@ extern "C" {
 #elif defined(BSP_UART5_TX_USING_DMA) && !defined(UART5_TX_DMA_CONFIG)
 #define UART5_TX_DMA_CONFIG             DRV_DMA_CONFIG(1, 7, 5)
 #define UART5_DMA_TX_IRQHandler         DMA1_Channel7_IRQHandler
+#elif defined(BSP_USING_DCI) && !defined(DCI_DMA_CONFIG)
+#define DCI_DMA_CONFIG                  DRV_DMA_CONFIG(1, 7, 1)
+#define DCI_DMA_IRQHandler              DMA1_Channel7_IRQHandler
+#elif defined(BSP_USB_FIFO_USING_DMA) && !defined(USB_FIFO_DMA_CONFIG)
+#define USB_FIFO_DMA_CONFIG             DRV_DMA_CONFIG(1, 7, 0)
 #endif
 
 #ifdef __cplusplus
@@ -0,0 +1,1140 @@
+/*
+ * Copyright (c) 2006-2024 RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-25     Evlers       first version
+ */
+
+#include <board.h>
+#include <rthw.h>
+#include <rtdevice.h>
+
+#ifdef BSP_USING_CAN
+
+#if !defined(BSP_USING_CAN0) && !defined(BSP_USING_CAN1)
+#error "Please define at least one CANx"
+#endif
+
+#include "drv_can.h"
+#include "drv_config.h"
+#include "delay.h"
+
+//#define DRV_DEBUG
+#define LOG_TAG             "drv.can"
+#include <drv_log.h>
+
+#ifndef BSP_CAN_RX_RING_SIZE
+#define BSP_CAN_RX_RING_SIZE        64
+#endif
+#ifndef BSP_CAN_TX_QUEUE_SIZE
+#define BSP_CAN_TX_QUEUE_SIZE       16
+#endif
+#ifndef BSP_CAN1_FILTER_START_BANK
+#if defined(BSP_USING_CAN1)
+#define BSP_CAN1_FILTER_START_BANK  14
+#else
+#define BSP_CAN1_FILTER_START_BANK  27
+#endif
+#endif
+
+#if (BSP_CAN_RX_RING_SIZE & (BSP_CAN_RX_RING_SIZE - 1)) != 0
+#error "BSP_CAN_RX_RING_SIZE must be a power of two"
+#endif
+#if BSP_CAN_TX_QUEUE_SIZE < 1 || BSP_CAN_TX_QUEUE_SIZE > 32
+#error "BSP_CAN_TX_QUEUE_SIZE must be between 1 and 32"
+#endif
+
+#define CAN_MAILBOXES               3
+#define CAN_FILTER_BANKS            28
+#define CAN_FILTER_NUM_MAX          (CAN_FILTER_BANKS * 4)
+#define CAN_TIMEOUT_US              10000
+
+/* nominal bits of a frame on the bus with the interframe space, without the stuff bits */
+#define CAN_FRAME_BITS(ide, rtr, len)   (((ide) ? 67 : 47) + ((rtr) ? 0 : (len) * 8))
+
+/* the sample point in permille, the CiA recommendation */
+#define CAN_SAMPLE_POINT            875
+
+/* filter kinds, sorted into banks of the same kind */
+enum
+{
+    CAN_FILTER_STD_LIST,                /* 16 bit list, 4 identifiers each bank */
+    CAN_FILTER_STD_MASK,                /* 16 bit mask, 2 filters each bank */
+    CAN_FILTER_EXT_LIST,                /* 32 bit list, 2 identifiers each bank */
+    CAN_FILTER_EXT_MASK,                /* 32 bit mask, 1 filter each bank */
+    CAN_FILTER_KINDS,
+};
+
+static const rt_uint8_t can_filter_per_bank[CAN_FILTER_KINDS] = { 4, 2, 2, 1 };
+
+enum {
+#ifdef BSP_USING_CAN0
+    CAN0_INDEX,
+#endif
+#ifdef BSP_USING_CAN1
+    CAN1_INDEX,
+#endif
+};
+
+static const struct gd32_can_config can_config[] = {
+#ifdef BSP_USING_CAN0
+    CAN0_CONFIG,
+#endif
+#ifdef BSP_USING_CAN1
+    CAN1_CONFIG,
+#endif
+};
+
+/* a frame waiting for a mailbox or in one, the registers are built when it is queued */
+struct can_tx_slot
+{
+    rt_uint32_t key;                    /* the arbitration field, the lower key wins the bus */
+    rt_uint32_t seq;                    /* the order of the frames with the same key */
+    rt_uint32_t tmi;
+    rt_uint32_t tmp;
+    rt_uint32_t data0;
+    rt_uint32_t data1;
+    rt_uint16_t bits;
+};
+
+/* GD32 can driver class */
+struct gd32_can
+{
+    const struct gd32_can_config *config;
+
+    rt_uint8_t filter_start;            /* the filter banks of this can */
+    rt_uint8_t filter_end;
+    rt_int8_t hdr[2][CAN_FILTER_NUM_MAX]; /* the hdr of each filter number of the two FIFOs */
+
+    struct can_tx_slot slot[BSP_CAN_TX_QUEUE_SIZE];
+    rt_uint32_t pending;                /* slots waiting for a mailbox */
+    rt_uint32_t seq;
+    rt_int8_t mailbox[CAN_MAILBOXES];   /* the slot in each mailbox, -1 when empty */
+    rt_uint8_t aborting;                /* mailboxes stopped for a frame of a higher priority */
+    rt_bool_t int_tx;
+
+    struct can_rx_frame ring[BSP_CAN_RX_RING_SIZE];
+    volatile rt_uint32_t head;          /* written by the receive interrupts only */
+    volatile rt_uint32_t tail;          /* written by the reader only */
+    rt_bool_t int_rx;
+
+    rt_uint32_t err_flags;
+    rt_uint32_t bits;                   /* bits on the bus in this second */
+    struct rt_timer load_timer;
+    struct can_stats stats;
+
+    struct rt_can_device device;
+};
+
+static struct gd32_can can_obj[sizeof(can_config) / sizeof(can_config[0])] = {0};
+
+rt_weak void gd32_msp_can_init (const uint32_t *periph)
+{
+    struct gd32_can_config *config = rt_container_of(periph, struct gd32_can_config, periph);
+
+    /* enable gpio clock */
+    rcu_periph_clock_enable(config->tx_gpio_clk);
+    rcu_periph_clock_enable(config->rx_gpio_clk);
+
+    /* connect port to CANx_Tx */
+    gpio_af_set(config->tx_port, config->tx_af, config->tx_pin);
+
+    /* connect port to CANx_Rx */
+    gpio_af_set(config->rx_port, config->rx_af, config->rx_pin);
+
+    /* configure CAN Tx as alternate function push-pull */
+    gpio_mode_set(config->tx_port, GPIO_MODE_AF, GPIO_PUPD_PULLUP, config->tx_pin);
+    gpio_output_options_set(config->tx_port, GPIO_OTYPE_PP, GPIO_OSPEED_50MHZ, config->tx_pin);
+
+    /* configure CAN Rx as alternate function */
+    gpio_mode_set(config->rx_port, GPIO_MODE_AF, GPIO_PUPD_PULLUP, config->rx_pin);
+    gpio_output_options_set(config->rx_port, GPIO_OTYPE_PP, GPIO_OSPEED_50MHZ, config->rx_pin);
+}
+
+static rt_err_t can_init_mode (uint32_t periph, rt_bool_t enter)
+{
+    rt_uint32_t timeout = CAN_TIMEOUT_US;
+
+    if (enter)
+    {
+        CAN_CTL(periph) &= ~CAN_CTL_SLPWMOD;
+        CAN_CTL(periph) |= CAN_CTL_IWMOD;
+    }
+    else
+    {
+        CAN_CTL(periph) &= ~CAN_CTL_IWMOD;
+    }
+
+    /* leaving waits for 11 recessive bits on the bus */
+    while (!!(CAN_STAT(periph) & CAN_STAT_IWS) != !!enter)
+    {
+        if (timeout -- == 0)
+        {
+            return -RT_ETIMEOUT;
+        }
+        delay_us(1);
+    }
+
+    return RT_EOK;
+}
+
+/* the prescaler and segments of a baud rate, the sample point nearest to CAN_SAMPLE_POINT */
+static rt_err_t can_bit_timing (rt_uint32_t baud, rt_uint32_t *bt)
+{
+    rt_uint32_t clock = rcu_clock_freq_get(CK_APB1);
+    rt_uint32_t tq, psc, bs1, bs2, sp, error;
+    rt_uint32_t best_error = RT_UINT32_MAX;
+
+    if (baud == 0)
+    {
+        return -RT_EINVAL;
+    }
+
+    for (tq = 25; tq >= 8; tq --)
+    {
+        if (clock % (baud * tq) != 0)
+        {
+            continue;
+        }
+        psc = clock / (baud * tq);
+        if (psc == 0 || psc > 1024)
+        {
+            continue;
+        }
+
+        /* the sync segment and bit segment 1 are before the sample point */
+        sp = (tq * CAN_SAMPLE_POINT + 500) / 1000;
+        bs1 = RT_MIN(sp - 1, 16);
+        bs2 = tq - 1 - bs1;
+        if (bs2 < 1 || bs2 > 8)
+        {
+            continue;
+        }
+
+        sp = (1 + bs1) * 1000 / tq;
+        error = sp > CAN_SAMPLE_POINT ? sp - CAN_SAMPLE_POINT : CAN_SAMPLE_POINT - sp;
+        if (error < best_error)
+        {
+            best_error = error;
+            *bt = BT_BAUDPSC(psc - 1) | BT_BS1(bs1 - 1) | BT_BS2(bs2 - 1) | BT_SJW(RT_MIN(bs2, 4) - 1);
+        }
+    }
+
+    return best_error == RT_UINT32_MAX ? -RT_ERROR : RT_EOK;
+}
+
+static void can_filter_bank_set (rt_uint32_t bank, int kind, rt_uint32_t fifo, rt_uint32_t data0, rt_uint32_t data1)
+{
+    rt_uint32_t bit = 1UL << bank;
+
+    CAN_FW(CAN0) &= ~bit;
+
+    if (kind == CAN_FILTER_STD_LIST || kind == CAN_FILTER_EXT_LIST)
+    {
+        CAN_FMCFG(CAN0) |= bit;
+    }
+    else
+    {
+        CAN_FMCFG(CAN0) &= ~bit;
+    }
+
+    if (kind == CAN_FILTER_EXT_LIST || kind == CAN_FILTER_EXT_MASK)
+    {
+        CAN_FSCFG(CAN0) |= bit;
+    }
+    else
+    {
+        CAN_FSCFG(CAN0) &= ~bit;
+    }
+
+    if (fifo)
+    {
+        CAN_FAFIFO(CAN0) |= bit;
+    }
+    else
+    {
+        CAN_FAFIFO(CAN0) &= ~bit;
+    }
+
+    CAN_FDATA0(CAN0, bank) = data0;
+    CAN_FDATA1(CAN0, bank) = data1;
+
+    CAN_FW(CAN0) |= bit;
+}
+
+static int can_filter_kind (const struct rt_can_filter_item *item)
+{
+    /* mode 0 is the mask mode, as in the other drivers */
+    if (item->ide)
+    {
+        return item->mode ? CAN_FILTER_EXT_LIST : CAN_FILTER_EXT_MASK;
+    }
+    return item->mode ? CAN_FILTER_STD_LIST : CAN_FILTER_STD_MASK;
+}
+
+/* the identifier of an item in the layout of the filter data, the mask compares the frame format and type too */
+static rt_uint32_t can_filter_id (const struct rt_can_filter_item *item, int kind)
+{
+    if (kind == CAN_FILTER_STD_LIST || kind == CAN_FILTER_STD_MASK)
+    {
+        return ((item->id & CAN_SFID_MASK) << 5) | (item->rtr << 4);
+    }
+    return ((item->id & CAN_EFID_MASK) << 3) | (1UL << 2) | (item->rtr << 1);
+}
+
+static rt_uint32_t can_filter_mask (const struct rt_can_filter_item *item, int kind)
+{
+    if (kind == CAN_FILTER_STD_MASK)
+    {
+        return ((item->mask & CAN_SFID_MASK) << 5) | (1UL << 4) | (1UL << 3);
+    }
+    return ((item->mask & CAN_EFID_MASK) << 3) | (1UL << 2) | (1UL << 1);
+}
+
+/*
+ * The items are sorted by kind and FIFO and packed into as few banks as possible.
+ * The FIFOs number their filters in the order of the banks, the number of each
+ * filter is mapped to the hdr of its item. The items are not changed, the frames
+ * of an item without a hdr (-1) go to the receive buffer of the device.
+ */
+static rt_err_t can_filter_config (struct gd32_can *can, struct rt_can_filter_config *cfg)
+{
+    rt_uint32_t bank = can->filter_start;
+    rt_uint32_t number[2] = {0, 0};
+    rt_uint32_t fifo, i, n, used;
+    rt_uint32_t entry[4];
+    int kind;
+
+    rt_memset(can->hdr, -1, sizeof(can->hdr));
+
+    CAN_FCTL(CAN0) |= CAN_FCTL_FLD;
+
+    if (cfg == RT_NULL || !cfg->actived || cfg->count == 0)
+    {
+        /* accept everything into FIFO0 */
+        can_filter_bank_set(bank ++, CAN_FILTER_EXT_MASK, 0, 0, 0);
+        number[0] = 1;
+    }
+    else
+    {
+        for (fifo = 0; fifo < 2; fifo ++)
+        {
+            for (kind = 0; kind < CAN_FILTER_KINDS; kind ++)
+            {
+                used = 0;
+                for (i = 0; i <= cfg->count; i ++)
+                {
+                    const struct rt_can_filter_item *item = &cfg->items[i < cfg->count ? i : 0];
+
+                    if (i < cfg->count)
+                    {
+                        if (can_filter_kind(item) != kind || (item->rxfifo ? 1 : 0) != fifo)
+                        {
+                            continue;
+                        }
+
+                        switch (kind)
+                        {
+                        case CAN_FILTER_STD_MASK:
+                            entry[used] = can_filter_id(item, kind) | (can_filter_mask(item, kind) << 16);
+                            break;
+                        case CAN_FILTER_EXT_MASK:
+                            entry[0] = can_filter_id(item, kind);
+                            entry[1] = can_filter_mask(item, kind);
+                            break;
+                        default:
+                            entry[used] = can_filter_id(item, kind);
+                            break;
+                        }
+                        can->hdr[fifo][number[fifo] + used] = item->hdr_bank < 0 ? -1 : item->hdr_bank;
+                        used ++;
+
+                        if (used < can_filter_per_bank[kind])
+                        {
+                            continue;
+                        }
+                    }
+                    else if (used == 0)
+                    {
+                        break;
+                    }
+
+                    if (bank >= can->filter_end)
+                    {
+                        CAN_FCTL(CAN0) &= ~CAN_FCTL_FLD;
+                        LOG_E("%s: the filters need more than %d banks", can->config->device_name,
+                              can->filter_end - can->filter_start);
+                        return -RT_ENOMEM;
+                    }
+
+                    /* the unused entries of a bank repeat the first one */
+                    for (n = used; n < can_filter_per_bank[kind]; n ++)
+                    {
+                        entry[n] = entry[0];
+                    }
+
+                    switch (kind)
+                    {
+                    case CAN_FILTER_STD_LIST:
+                        can_filter_bank_set(bank, kind, fifo, entry[0] | (entry[1] << 16), entry[2] | (entry[3] << 16));
+                        break;
+                    case CAN_FILTER_STD_MASK:
+                    case CAN_FILTER_EXT_LIST:
+                    case CAN_FILTER_EXT_MASK:
+                        can_filter_bank_set(bank, kind, fifo, entry[0], entry[1]);
+                        break;
+                    }
+
+                    bank ++;
+                    number[fifo] += can_filter_per_bank[kind];
+                    used = 0;
+                }
+            }
+        }
+    }
+
+    /* the remaining banks of this can are disabled, they are numbered after the used ones */
+    for (; bank < can->filter_end; bank ++)
+    {
+        CAN_FW(CAN0) &= ~(1UL << bank);
+    }
+
+    CAN_FCTL(CAN0) &= ~CAN_FCTL_FLD;
+
+    LOG_D("%s: %d filters in FIFO0, %d in FIFO1", can->config->device_name, number[0], number[1]);
+
+    return RT_EOK;
+}
+
+static rt_err_t gd32_can_configure (struct rt_can_device *device, struct can_configure *cfg)
+{
+    struct gd32_can *can = rt_container_of(device, struct gd32_can, device);
+    uint32_t periph = can->config->periph;
+    rt_uint32_t bt;
+
+    RT_ASSERT(cfg != RT_NULL);
+
+    if (can_bit_timing(cfg->baud_rate, &bt) != RT_EOK)
+    {
+        LOG_E("%s: baud rate %d is not possible", can->config->device_name, cfg->baud_rate);
+        return -RT_ERROR;
+    }
+
+    switch (cfg->mode)
+    {
+    case RT_CAN_MODE_LISTEN:
+        bt |= CAN_BT_SCMOD;
+        break;
+    case RT_CAN_MODE_LOOPBACK:
+        bt |= CAN_BT_LCMOD;
+        break;
+    case RT_CAN_MODE_LOOPBACKANLISTEN:
+        bt |= CAN_BT_SCMOD | CAN_BT_LCMOD;
+        break;
+    default:
+        break;
+    }
+
+    gd32_msp_can_init(&can->config->periph);
+
+    /* the filters of both cans are in CAN0 */
+    rcu_periph_clock_enable(RCU_CAN0);
+    rcu_periph_clock_enable(can->config->per_clk);
+
+    if (can_init_mode(periph, RT_TRUE) != RT_EOK)
+    {
+        LOG_E("%s: can not enter the initial working mode", can->config->device_name);
+        return -RT_ETIMEOUT;
+    }
+
+    /*
+     * The mailboxes are sent in the order of the identifiers, a full FIFO keeps the older frames,
+     * bus-off recovers by itself and the time triggered mode stamps the frames with the bit time.
+     */
+    CAN_CTL(periph) &= ~(CAN_CTL_TFO | CAN_CTL_ARD | CAN_CTL_AWU);
+    CAN_CTL(periph) |= CAN_CTL_RFOD | CAN_CTL_ABOR | CAN_CTL_TTC;
+    CAN_BT(periph) = bt;
+
+    if (can_init_mode(periph, RT_FALSE) != RT_EOK)
+    {
+        /* it goes on by itself once the bus is idle */
+        LOG_W("%s: the bus is not idle", can->config->device_name);
+    }
+
+    CAN_INTEN(periph) = CAN_INT_TME | CAN_INT_RFNE0 | CAN_INT_RFO0 | CAN_INT_RFNE1 | CAN_INT_RFO1 |
+                        CAN_INT_WERR | CAN_INT_PERR | CAN_INT_BO | CAN_INT_ERRN | CAN_INT_ERR;
+
+    nvic_irq_enable(can->config->tx_irqn, 2, 0);
+    nvic_irq_enable(can->config->rx0_irqn, 2, 0);
+    nvic_irq_enable(can->config->rx1_irqn, 2, 0);
+    nvic_irq_enable(can->config->ewmc_irqn, 2, 0);
+
+    return RT_EOK;
+}
+
+static RT_SECTION_FASTCODE void can_tx_load (struct gd32_can *can, rt_uint32_t mb, rt_uint32_t index)
+{
+    uint32_t periph = can->config->periph;
+    struct can_tx_slot *slot = &can->slot[index];
+
+    CAN_TMI(periph, mb) = slot->tmi;
+    CAN_TMP(periph, mb) = slot->tmp;
+    CAN_TMDATA0(periph, mb) = slot->data0;
+    CAN_TMDATA1(periph, mb) = slot->data1;
+    CAN_TMI(periph, mb) |= CAN_TMI_TEN;
+
+    can->mailbox[mb] = index;
+    can->pending &= ~(1UL << index);
+}
+
+/*
+ * Fills the empty mailboxes with the waiting frames of the highest priority.
+ * When all mailboxes are busy with frames of a lower priority, the lowest one is
+ * stopped and queued again, so that a frame never waits behind a lower one.
+ * Frames with the same key keep their order. Called with the interrupts disabled.
+ */
+static RT_SECTION_FASTCODE void can_tx_schedule (struct gd32_can *can)
+{
+    uint32_t periph = can->config->periph;
+    rt_uint32_t pending, index, mb, best, worst;
+    rt_int32_t empty;
+
+    while (can->pending)
+    {
+        /* the waiting frame of the highest priority, the oldest of the same key */
+        best = __CLZ(__RBIT(can->pending));
+        for (pending = can->pending & (can->pending - 1); pending; pending &= pending - 1)
+        {
+            index = __CLZ(__RBIT(pending));
+            if (can->slot[index].key < can->slot[best].key ||
+                (can->slot[index].key == can->slot[best].key &&
+                 (rt_int32_t)(can->slot[index].seq - can->slot[best].seq) < 0))
+            {
+                best = index;
+            }
+        }
+
+        empty = -1;
+        worst = CAN_MAILBOXES;
+        for (mb = 0; mb < CAN_MAILBOXES; mb ++)
+        {
+            if (can->mailbox[mb] < 0)
+            {
+                if (CAN_TSTAT(periph) & (CAN_TSTAT_TME0 << mb))
+                {
+                    empty = mb;
+                }
+                continue;
+            }
+            if (can->slot[can->mailbox[mb]].key == can->slot[best].key)
+            {
+                /* the mailboxes would send the frames of the same identifier in any order */
+                return;
+            }
+            if (worst == CAN_MAILBOXES || can->slot[can->mailbox[mb]].key > can->slot[can->mailbox[worst]].key)
+            {
+                worst = mb;
+            }
+        }
+
+        if (empty >= 0)
+        {
+            can_tx_load(can, empty, best);
+            continue;
+        }
+
+        if (worst < CAN_MAILBOXES && !can->aborting &&
+            can->slot[best].key < can->slot[can->mailbox[worst]].key)
+        {
+            /* a frame being sent is not stopped, it finishes as usual */
+            can->aborting |= 1 << worst;
+            CAN_TSTAT(periph) = CAN_TSTAT_MST0 << (worst * 8);
+        }
+        return;
+    }
+}
+
+static rt_ssize_t gd32_can_sendmsg (struct rt_can_device *device, const void *buf, rt_uint32_t boxno)
+{
+    struct gd32_can *can = rt_container_of(device, struct gd32_can, device);
+    const struct rt_can_msg *msg = (const struct rt_can_msg *)buf;
+    struct can_tx_slot *slot;
+    rt_uint32_t len = RT_MIN(msg->len, 8);
+    rt_uint32_t queued, pending;
+    rt_base_t level;
+
+    if (boxno >= BSP_CAN_TX_QUEUE_SIZE)
+    {
+        return -RT_ERROR;
+    }
+
+    slot = &can->slot[boxno];
+
+    /* the fields in the order of the arbitration: base identifier, RTR or SRR, IDE, extension, RTR */
+    if (msg->ide)
+    {
+        slot->tmi = TMI_EFID(msg->id) | CAN_FF_EXTENDED | (msg->rtr ? CAN_FT_REMOTE : CAN_FT_DATA);
+        slot->key = ((msg->id >> 18) << 21) | (3UL << 19) | ((msg->id & 0x3FFFF) << 1) | msg->rtr;
+    }
+    else
+    {
+        slot->tmi = TMI_SFID(msg->id) | CAN_FF_STANDARD | (msg->rtr ? CAN_FT_REMOTE : CAN_FT_DATA);
+        slot->key = ((msg->id & CAN_SFID_MASK) << 21) | ((rt_uint32_t)msg->rtr << 20);
+    }
+    slot->tmp = len;
+    slot->data0 = msg->data[0] | (msg->data[1] << 8) | (msg->data[2] << 16) | ((rt_uint32_t)msg->data[3] << 24);
+    slot->data1 = msg->data[4] | (msg->data[5] << 8) | (msg->data[6] << 16) | ((rt_uint32_t)msg->data[7] << 24);
+    slot->bits = CAN_FRAME_BITS(msg->ide, msg->rtr, len);
+
+    level = rt_hw_interrupt_disable();
+    slot->seq = can->seq ++;
+    can->pending |= 1UL << boxno;
+    for (queued = 0, pending = can->pending; pending; pending &= pending - 1)
+    {
+        queued ++;
+    }
+    if (queued > can->stats.tx_queue_max)
+    {
+        can->stats.tx_queue_max = queued;
+    }
+    can_tx_schedule(can);
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+
+/* drops the waiting frames and stops the mailboxes, no more events are sent to the framework */
+static void can_tx_flush (struct gd32_can *can)
+{
+    uint32_t periph = can->config->periph;
+    rt_uint32_t mb;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    can->int_tx = RT_FALSE;
+    can->pending = 0;
+    for (mb = 0; mb < CAN_MAILBOXES; mb ++)
+    {
+        if (can->mailbox[mb] >= 0)
+        {
+            CAN_TSTAT(periph) = CAN_TSTAT_MST0 << (mb * 8);
+        }
+    }
+    rt_hw_interrupt_enable(level);
+}
+
+static rt_err_t gd32_can_control (struct rt_can_device *device, int cmd, void *arg)
+{
+    struct gd32_can *can = rt_container_of(device, struct gd32_can, device);
+    rt_uint32_t argval = (rt_uint32_t)arg;
+    rt_uint32_t err;
+
+    switch (cmd)
+    {
+    case RT_DEVICE_CTRL_SET_INT:
+        /* the interrupts stay enabled, the frames are always drained into the ring */
+        if (argval == RT_DEVICE_FLAG_INT_RX)
+        {
+            can->int_rx = RT_TRUE;
+        }
+        else if (argval == RT_DEVICE_FLAG_INT_TX)
+        {
+            can->int_tx = RT_TRUE;
+        }
+        break;
+
+    case RT_DEVICE_CTRL_CLR_INT:
+        if (argval == RT_DEVICE_FLAG_INT_RX)
+        {
+            can->int_rx = RT_FALSE;
+        }
+        else if (argval == RT_DEVICE_FLAG_INT_TX)
+        {
+            can_tx_flush(can);
+        }
+        break;
+
+    case RT_CAN_CMD_SET_FILTER:
+        return can_filter_config(can, (struct rt_can_filter_config *)arg);
+
+    case RT_CAN_CMD_SET_MODE:
+        if (argval != RT_CAN_MODE_NORMAL && argval != RT_CAN_MODE_LISTEN &&
+            argval != RT_CAN_MODE_LOOPBACK && argval != RT_CAN_MODE_LOOPBACKANLISTEN)
+        {
+            return -RT_ERROR;
+        }
+        if (argval != device->config.mode)
+        {
+            device->config.mode = argval;
+            return gd32_can_configure(device, &device->config);
+        }
+        break;
+
+    case RT_CAN_CMD_SET_BAUD:
+        if (argval != device->config.baud_rate)
+        {
+            device->config.baud_rate = argval;
+            return gd32_can_configure(device, &device->config);
+        }
+        break;
+
+    case RT_CAN_CMD_SET_PRIV:
+        if (argval != RT_CAN_MODE_PRIV && argval != RT_CAN_MODE_NOPRIV)
+        {
+            return -RT_ERROR;
+        }
+        /* the queue is always sent in the order of the priorities */
+        device->config.privmode = argval;
+        break;
+
+    case RT_CAN_CMD_GET_STATUS:
+        err = CAN_ERR(can->config->periph);
+        device->status.rcverrcnt = (err & CAN_ERR_RECNT) >> 24;
+        device->status.snderrcnt = (err & CAN_ERR_TECNT) >> 16;
+        device->status.errcode = err & (CAN_ERR_WERR | CAN_ERR_PERR | CAN_ERR_BOERR);
+        rt_memcpy(arg, &device->status, sizeof(device->status));
+        break;
+
+    default:
+        return -RT_EINVAL;
+    }
+
+    return RT_EOK;
+}
+
+static rt_ssize_t gd32_can_recvmsg (struct rt_can_device *device, void *buf, rt_uint32_t fifo)
+{
+    struct gd32_can *can = rt_container_of(device, struct gd32_can, device);
+    rt_uint32_t tail = can->tail;
+
+    /* the frames of both FIFOs are in the ring, in the order they were drained */
+    if (tail == can->head)
+    {
+        return -1;
+    }
+
+    rt_memcpy(buf, &can->ring[tail & (BSP_CAN_RX_RING_SIZE - 1)].msg, sizeof(struct rt_can_msg));
+    can->tail = tail + 1;
+
+    return RT_EOK;
+}
+
+rt_size_t can_rx_read (rt_device_t dev, struct can_rx_frame *frames, rt_size_t count)
+{
+    struct gd32_can *can = rt_container_of(dev, struct gd32_can, device.parent);
+    rt_uint32_t tail = can->tail;
+    rt_uint32_t head = can->head;
+    rt_size_t n;
+
+    RT_ASSERT(frames != RT_NULL);
+
+    for (n = 0; n < count && tail != head; n ++, tail ++)
+    {
+        frames[n] = can->ring[tail & (BSP_CAN_RX_RING_SIZE - 1)];
+    }
+    can->tail = tail;
+
+    return n;
+}
+
+static const struct rt_can_ops gd32_can_ops =
+{
+    .configure = gd32_can_configure,
+    .control = gd32_can_control,
+    .sendmsg = gd32_can_sendmsg,
+    .recvmsg = gd32_can_recvmsg,
+};
+
+static RT_SECTION_FASTCODE void can_tx_isr (struct gd32_can *can)
+{
+    uint32_t periph = can->config->periph;
+    rt_uint32_t tstat = CAN_TSTAT(periph);
+    rt_uint32_t mb, index, event;
+
+    for (mb = 0; mb < CAN_MAILBOXES; mb ++)
+    {
+        if (!(tstat & (CAN_TSTAT_MTF0 << (mb * 8))))
+        {
+            continue;
+        }
+
+        /* clears the flags of the mailbox */
+        CAN_TSTAT(periph) = CAN_TSTAT_MTF0 << (mb * 8);
+
+        if (can->mailbox[mb] < 0)
+        {
+            continue;
+        }
+        index = can->mailbox[mb];
+        can->mailbox[mb] = -1;
+
+        if (tstat & (CAN_TSTAT_MTFNERR0 << (mb * 8)))
+        {
+            can->stats.tx_frames ++;
+            can->bits += can->slot[index].bits;
+            event = RT_CAN_EVENT_TX_DONE;
+        }
+        else if ((can->aborting & (1 << mb)) && can->int_tx)
+        {
+            /* stopped for a frame of a higher priority, it waits for the next mailbox */
+            can->stats.tx_preempted ++;
+            can->pending |= 1UL << index;
+            event = 0;
+        }
+        else
+        {
+            can->stats.tx_failed ++;
+            event = RT_CAN_EVENT_TX_FAIL;
+        }
+        can->aborting &= ~(1 << mb);
+
+        if (event && can->int_tx)
+        {
+            rt_hw_can_isr(&can->device, event | (index << 8));
+        }
+    }
+
+    if (can->int_tx)
+    {
+        can_tx_schedule(can);
+    }
+}
+
+/* drains every frame of the FIFO, several frames arrive between two interrupts on a busy bus */
+static RT_SECTION_FASTCODE void can_rx_isr (struct gd32_can *can, rt_uint32_t fifo)
+{
+    uint32_t periph = can->config->periph;
+    volatile uint32_t *rfifo = fifo ? &CAN_RFIFO1(periph) : &CAN_RFIFO0(periph);
+    rt_uint32_t head = can->head;
+    rt_uint32_t count = 0, mi, mp, fi, data;
+    rt_tick_t tick = rt_tick_get();
+    rt_uint32_t cycle = get_cpu_tick();
+    struct can_rx_frame *frame;
+
+    /* the bits of the two FIFO registers are at the same places */
+    if (*rfifo & CAN_RFIFO0_RFO0)
+    {
+        *rfifo = CAN_RFIFO0_RFO0 | CAN_RFIFO0_RFF0;
+        can->stats.rx_overruns ++;
+    }
+
+    while (*rfifo & CAN_RFIFO0_RFL0)
+    {
+        mi = CAN_RFIFOMI(periph, fifo);
+        mp = CAN_RFIFOMP(periph, fifo);
+
+        count ++;
+        can->bits += CAN_FRAME_BITS(mi & CAN_RFIFOMI_FF, mi & CAN_RFIFOMI_FT, GET_RFIFOMP_DLENC(mp));
+
+        if (head - can->tail >= BSP_CAN_RX_RING_SIZE)
+        {
+            can->stats.rx_drops ++;
+            *rfifo = CAN_RFIFO0_RFD0;
+            continue;
+        }
+
+        frame = &can->ring[head & (BSP_CAN_RX_RING_SIZE - 1)];
+        if (mi & CAN_RFIFOMI_FF)
+        {
+            frame->msg.id = GET_RFIFOMI_EFID(mi);
+            frame->msg.ide = RT_CAN_EXTID;
+        }
+        else
+        {
+            frame->msg.id = GET_RFIFOMI_SFID(mi);
+            frame->msg.ide = RT_CAN_STDID;
+        }
+        frame->msg.rtr = (mi & CAN_RFIFOMI_FT) ? RT_CAN_RTR : RT_CAN_DTR;
+        frame->msg.len = RT_MIN(GET_RFIFOMP_DLENC(mp), 8);
+        fi = GET_RFIFOMP_FI(mp);
+        frame->msg.hdr_index = fi < CAN_FILTER_NUM_MAX ? can->hdr[fifo][fi] : -1;
+        frame->msg.rxfifo = fifo;
+        data = CAN_RFIFOMDATA0(periph, fifo);
+        frame->msg.data[0] = data;
+        frame->msg.data[1] = data >> 8;
+        frame->msg.data[2] = data >> 16;
+        frame->msg.data[3] = data >> 24;
+        data = CAN_RFIFOMDATA1(periph, fifo);
+        frame->msg.data[4] = data;
+        frame->msg.data[5] = data >> 8;
+        frame->msg.data[6] = data >> 16;
+        frame->msg.data[7] = data >> 24;
+        frame->bus_time = mp >> 16;
+        frame->tick = tick;
+        frame->cycle = cycle;
+
+        *rfifo = CAN_RFIFO0_RFD0;
+        head ++;
+    }
+
+    if (count == 0)
+    {
+        return;
+    }
+
+    can->stats.rx_frames += count;
+    can->stats.rx_batches ++;
+    if (count > can->stats.rx_batch_max)
+    {
+        can->stats.rx_batch_max = count;
+    }
+
+    count = head - can->head;
+    can->head = head;
+
+    if (can->int_rx)
+    {
+        /* the framework takes the frames one by one */
+        while (count --)
+        {
+            rt_hw_can_isr(&can->device, RT_CAN_EVENT_RX_IND | (fifo << 8));
+        }
+    }
+    else if (count && can->device.parent.rx_indicate != RT_NULL)
+    {
+        can->device.parent.rx_indicate(&can->device.parent, head - can->tail);
+    }
+}
+
+static void can_ewmc_isr (struct gd32_can *can)
+{
+    uint32_t periph = can->config->periph;
+    struct rt_can_status *status = &can->device.status;
+    rt_uint32_t err = CAN_ERR(periph);
+    rt_uint32_t flags, raised;
+
+    CAN_STAT(periph) = CAN_STAT_ERRIF;
+
+    switch (GET_ERR_ERRN(err))
+    {
+    case 1:
+        status->bitpaderrcnt ++;
+        break;
+    case 2:
+        status->formaterrcnt ++;
+        break;
+    case 3:
+        status->ackerrcnt ++;
+        break;
+    case 4:
+    case 5:
+        status->biterrcnt ++;
+        break;
+    case 6:
+        status->crcerrcnt ++;
+        break;
+    default:
+        break;
+    }
+    if (GET_ERR_ERRN(err) != 0)
+    {
+        status->lasterrtype = GET_ERR_ERRN(err);
+        can->stats.bus_errors ++;
+        CAN_ERR(periph) = err & ~CAN_ERR_ERRN;
+    }
+
+    status->rcverrcnt = (err & CAN_ERR_RECNT) >> 24;
+    status->snderrcnt = (err & CAN_ERR_TECNT) >> 16;
+    status->errcode = err & (CAN_ERR_WERR | CAN_ERR_PERR | CAN_ERR_BOERR);
+
+    flags = err & (CAN_ERR_WERR | CAN_ERR_PERR | CAN_ERR_BOERR);
+    raised = flags & ~can->err_flags;
+    can->err_flags = flags;
+    if (raised & CAN_ERR_WERR)
+    {
+        can->stats.error_warnings ++;
+    }
+    if (raised & CAN_ERR_PERR)
+    {
+        can->stats.error_passives ++;
+    }
+    if (raised & CAN_ERR_BOERR)
+    {
+        can->stats.bus_offs ++;
+    }
+}
+
+/* the bits of the frames seen in the last second over the bits of one second */
+static void can_load_timeout (void *parameter)
+{
+    struct gd32_can *can = (struct gd32_can *)parameter;
+    rt_uint32_t baud = can->device.config.baud_rate;
+    rt_uint32_t bits;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    bits = can->bits;
+    can->bits = 0;
+    rt_hw_interrupt_enable(level);
+
+    can->stats.load = baud ? (rt_uint32_t)((rt_uint64_t)bits * 1000 / baud) : 0;
+    if (can->stats.load > can->stats.load_max)
+    {
+        can->stats.load_max = can->stats.load;
+    }
+}
+
+rt_err_t can_stats_get (rt_device_t dev, struct can_stats *stats)
+{
+    struct gd32_can *can;
+    rt_base_t level;
+
+    RT_ASSERT(dev != RT_NULL && stats != RT_NULL);
+
+    if (dev->type != RT_Device_Class_CAN)
+    {
+        return -RT_EINVAL;
+    }
+    can = rt_container_of(dev, struct gd32_can, device.parent);
+
+    level = rt_hw_interrupt_disable();
+    *stats = can->stats;
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+
+rt_err_t can_stats_reset (rt_device_t dev)
+{
+    struct gd32_can *can;
+    rt_base_t level;
+
+    RT_ASSERT(dev != RT_NULL);
+
+    if (dev->type != RT_Device_Class_CAN)
+    {
+        return -RT_EINVAL;
+    }
+    can = rt_container_of(dev, struct gd32_can, device.parent);
+
+    level = rt_hw_interrupt_disable();
+    rt_memset(&can->stats, 0, sizeof(can->stats));
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+
+#define CAN_IRQ_HANDLERS(n)                                 \
+void CAN##n##_TX_IRQHandler (void)                          \
+{                                                           \
+    rt_interrupt_enter();                                   \
+    can_tx_isr(&can_obj[CAN##n##_INDEX]);                   \
+    rt_interrupt_leave();                                   \
+}                                                           \
+void CAN##n##_RX0_IRQHandler (void)                         \
+{                                                           \
+    rt_interrupt_enter();                                   \
+    can_rx_isr(&can_obj[CAN##n##_INDEX], 0);                \
+    rt_interrupt_leave();                                   \
+}                                                           \
+void CAN##n##_RX1_IRQHandler (void)                         \
+{                                                           \
+    rt_interrupt_enter();                                   \
+    can_rx_isr(&can_obj[CAN##n##_INDEX], 1);                \
+    rt_interrupt_leave();                                   \
+}                                                           \
+void CAN##n##_EWMC_IRQHandler (void)                        \
+{                                                           \
+    rt_interrupt_enter();                                   \
+    can_ewmc_isr(&can_obj[CAN##n##_INDEX]);                 \
+    rt_interrupt_leave();                                   \
+}
+
+#if defined(BSP_USING_CAN0)
+CAN_IRQ_HANDLERS(0)
+#endif /* BSP_USING_CAN0 */
+
+#if defined(BSP_USING_CAN1)
+CAN_IRQ_HANDLERS(1)
+#endif /* BSP_USING_CAN1 */
+
+int rt_hw_can_init (void)
+{
+    struct can_configure config = CANDEFAULTCONFIG;
+    rt_size_t obj_num = sizeof(can_obj) / sizeof(struct gd32_can);
+    rt_err_t result = RT_EOK;
+    rt_uint32_t mb;
+
+    /* the banks before the start bank are of CAN0, the others of CAN1 */
+    rcu_periph_clock_enable(RCU_CAN0);
+    can1_filter_start_bank(BSP_CAN1_FILTER_START_BANK);
+
+    config.sndboxnumber = BSP_CAN_TX_QUEUE_SIZE;
+
+    for (int i = 0; i < obj_num; i++)
+    {
+        can_obj[i].config = &can_config[i];
+        can_obj[i].device.config = config;
+        for (mb = 0; mb < CAN_MAILBOXES; mb ++)
+        {
+            can_obj[i].mailbox[mb] = -1;
+        }
+
+        if (can_config[i].periph == CAN0)
+        {
+            can_obj[i].filter_start = 0;
+            can_obj[i].filter_end = BSP_CAN1_FILTER_START_BANK;
+        }
+        else
+        {
+            can_obj[i].filter_start = BSP_CAN1_FILTER_START_BANK;
+            can_obj[i].filter_end = CAN_FILTER_BANKS;
+        }
+        can_filter_config(&can_obj[i], RT_NULL);
+
+        rt_timer_init(&can_obj[i].load_timer, can_config[i].device_name, can_load_timeout, &can_obj[i],
+                      RT_TICK_PER_SECOND, RT_TIMER_FLAG_PERIODIC);
+        rt_timer_start(&can_obj[i].load_timer);
+
+        /* register can device */
+        result = rt_hw_can_register(&can_obj[i].device, can_config[i].device_name, &gd32_can_ops, &can_obj[i]);
+        RT_ASSERT(result == RT_EOK);
+    }
+
+    return result;
+}
+INIT_DEVICE_EXPORT(rt_hw_can_init);
+
+#ifdef FINSH_USING_MSH
+#include <stdlib.h>
+
+static int can_stat (int argc, char **argv)
+{
+    struct can_stats stats;
+    struct rt_can_status status;
+    rt_device_t dev;
+    const char *name = argc > 1 ? argv[1] : can_config[0].device_name;
+
+    dev = rt_device_find(name);
+    if (dev == RT_NULL || can_stats_get(dev, &stats) != RT_EOK)
+    {
+        rt_kprintf("Usage: can_stat [can0 | can1] [reset]\n");
+        return -RT_ERROR;
+    }
+
+    if (argc > 2 && !rt_strcmp(argv[2], "reset"))
+    {
+        return can_stats_reset(dev);
+    }
+
+    rt_device_control(dev, RT_CAN_CMD_GET_STATUS, &status);
+
+    rt_kprintf("load      : %d.%d%% (max %d.%d%%) at %d bit/s\n", stats.load / 10, stats.load % 10,
+               stats.load_max / 10, stats.load_max % 10, ((struct rt_can_device *)dev)->config.baud_rate);
+    rt_kprintf("rx        : %u frames in %u batches (max %u), %u overruns, %u dropped\n", stats.rx_frames,
+               stats.rx_batches, stats.rx_batch_max, stats.rx_overruns, stats.rx_drops);
+    rt_kprintf("tx        : %u frames, %u preempted, %u failed, queue max %u\n", stats.tx_frames,
+               stats.tx_preempted, stats.tx_failed, stats.tx_queue_max);
+    rt_kprintf("errors    : %u bus errors, %u warnings, %u passive, %u bus-off\n", stats.bus_errors,
+               stats.error_warnings, stats.error_passives, stats.bus_offs);
+    rt_kprintf("counters  : rx %u, tx %u, state 0x%x\n", status.rcverrcnt, status.snderrcnt, status.errcode);
+
+    return 0;
+}
+MSH_CMD_EXPORT(can_stat, show the can statistics: can_stat [can0 | can1] [reset]);
+#endif /* FINSH_USING_MSH */
+
+#endif /* BSP_USING_CAN */
@@ -0,0 +1,694 @@
+/*
+ * Copyright (c) 2006-2024 RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-26     Evlers       first version
+ */
+
+#include <board.h>
+#include <rthw.h>
+#include <rtdevice.h>
+#include <stdlib.h>
+
+#ifdef BSP_USING_DAC
+
+#if !defined(BSP_USING_DAC0) && !defined(BSP_USING_DAC1)
+#error "Please define at least one DACx"
+#endif
+
+#if defined(BSP_DAC_USING_STREAM) && defined(BSP_USING_HWTIMER5)
+#error "The DAC stream needs the TIMER5_DAC interrupt, please disable the HWTIMER5"
+#endif
+
+#include "drv_dac.h"
+#include "drv_dma.h"
+#include "drv_config.h"
+
+//#define DRV_DEBUG
+#define LOG_TAG             "drv.dac"
+#include <drv_log.h>
+
+#if defined(BSP_USING_DAC0) && defined(BSP_USING_DAC1)
+#define DAC_OUTPUTS                 (DAC_OUT0 | DAC_OUT1)
+#elif defined(BSP_USING_DAC0)
+#define DAC_OUTPUTS                 DAC_OUT0
+#else
+#define DAC_OUTPUTS                 DAC_OUT1
+#endif
+
+#if defined(BSP_DAC_USING_TIMER5)
+#define DAC_TIMER                   TIMER5
+#define DAC_TIMER_RCU               RCU_TIMER5
+#define DAC_TIMER_TRIGGER           DAC_TRIGGER_T5_TRGO
+#else
+#define DAC_TIMER                   TIMER6
+#define DAC_TIMER_RCU               RCU_TIMER6
+#define DAC_TIMER_TRIGGER           DAC_TRIGGER_T6_TRGO
+#endif
+
+#define DAC_MID_SCALE               0x800
+#define DAC_DMA_MAX_SAMPLES         0xFFFE
+
+struct gd32_dac
+{
+    struct rt_dac_device device;
+    rt_uint8_t enabled;                 /* outputs written through the dac device */
+    rt_uint8_t running;                 /* outputs converted on the timer */
+
+#ifdef BSP_DAC_USING_STREAM
+    rt_bool_t stream;
+    rt_uint8_t outputs;
+    void *ring;
+    rt_uint32_t samples;
+    rt_uint8_t sample_size;
+    const struct dma_config *dma;
+    dac_refill_t refill;
+    void *arg;
+
+    struct rt_semaphore half_sem;
+    volatile rt_uint8_t half;           /* the half to refill */
+    volatile rt_bool_t half_pending;    /* not taken by dac_stream_wait() yet */
+#endif
+
+    struct dac_stats stats;
+};
+
+static struct gd32_dac _dac = { 0 };
+
+#ifdef DAC0_DMA_CONFIG
+static const struct dma_config dac0_dma = DAC0_DMA_CONFIG;
+#endif
+#ifdef DAC1_DMA_CONFIG
+static const struct dma_config dac1_dma = DAC1_DMA_CONFIG;
+#endif
+
+static rt_uint32_t dac_timer_clock (void)
+{
+    rt_uint32_t temp;
+
+    /* the timers of APB1 run at twice its clock when it is divided */
+    temp = (RCU_CFG0 & RCU_CFG0_APB1PSC) >> 10;
+    temp = (temp < 4) ? 0 : 1;
+
+    return rcu_clock_freq_get(CK_APB1) << temp;
+}
+
+/* the update event of the timer triggers the conversions, returns the rate that was set */
+static rt_uint32_t dac_timer_start (rt_uint32_t rate)
+{
+    timer_parameter_struct initpara;
+    rt_uint32_t clock = dac_timer_clock();
+    rt_uint32_t ticks, psc, period;
+
+    ticks = RT_MAX((clock + rate / 2) / rate, 2);
+    psc = (ticks - 1) / 0x10000 + 1;
+    period = (ticks + psc / 2) / psc;
+
+    rcu_periph_clock_enable(DAC_TIMER_RCU);
+    timer_deinit(DAC_TIMER);
+    timer_struct_para_init(&initpara);
+    initpara.prescaler = psc - 1;
+    initpara.period = period - 1;
+    timer_init(DAC_TIMER, &initpara);
+    timer_master_output_trigger_source_select(DAC_TIMER, TIMER_TRI_OUT_SRC_UPDATE);
+    timer_enable(DAC_TIMER);
+
+    return clock / (psc * period);
+}
+
+static void dac_output_init (rt_uint8_t outputs, rt_bool_t triggered)
+{
+    rt_uint32_t x;
+
+    rcu_periph_clock_enable(RCU_GPIOA);
+    rcu_periph_clock_enable(RCU_DAC);
+
+    for (x = 0; x < 2; x ++)
+    {
+        if (!(outputs & (1 << x)))
+        {
+            continue;
+        }
+
+        gpio_mode_set(GPIOA, GPIO_MODE_ANALOG, GPIO_PUPD_NONE, x ? GPIO_PIN_5 : GPIO_PIN_4);
+
+        dac_disable(x);
+        dac_dma_disable(x);
+        dac_wave_mode_config(x, DAC_WAVE_DISABLE);
+        if (triggered)
+        {
+            dac_trigger_source_config(x, DAC_TIMER_TRIGGER);
+            dac_trigger_enable(x);
+        }
+        else
+        {
+            dac_trigger_disable(x);
+        }
+        dac_output_buffer_enable(x);
+        dac_enable(x);
+    }
+}
+
+#ifdef BSP_DAC_USING_STREAM
+static void dac_stream_dma_start (void)
+{
+    dma_single_data_parameter_struct dma_init_struct = { 0 };
+    const struct dma_config *dma = _dac.dma;
+
+    rcu_periph_clock_enable(dma->rcu);
+
+    dma_deinit(dma->periph, dma->channel);
+    if (_dac.outputs == (DAC_OUT0 | DAC_OUT1))
+    {
+        /* one DMA request writes both outputs, they change on the same trigger */
+        dma_init_struct.periph_addr = (uint32_t)&DACC_R12DH;
+        dma_init_struct.periph_memory_width = DMA_PERIPH_WIDTH_32BIT;
+    }
+    else
+    {
+        dma_init_struct.periph_addr = (uint32_t)((_dac.outputs & DAC_OUT0) ? &DAC0_R12DH : &DAC1_R12DH);
+        dma_init_struct.periph_memory_width = DMA_PERIPH_WIDTH_16BIT;
+    }
+    dma_init_struct.periph_inc          = DMA_PERIPH_INCREASE_DISABLE;
+    dma_init_struct.memory0_addr        = (uint32_t)_dac.ring;
+    dma_init_struct.memory_inc          = DMA_MEMORY_INCREASE_ENABLE;
+    dma_init_struct.circular_mode       = DMA_CIRCULAR_MODE_ENABLE;
+    dma_init_struct.direction           = DMA_MEMORY_TO_PERIPH;
+    dma_init_struct.number              = _dac.samples;
+    dma_init_struct.priority            = DMA_PRIORITY_HIGH;
+    dma_single_data_mode_init(dma->periph, dma->channel, &dma_init_struct);
+    dma_channel_subperipheral_select(dma->periph, dma->channel, dma->subperiph);
+
+    dma_flag_clear(dma->periph, dma->channel, DMA_FLAG_FEE | DMA_FLAG_SDE | DMA_FLAG_TAE | DMA_FLAG_HTF | DMA_FLAG_FTF);
+    dma_interrupt_enable(dma->periph, dma->channel, DMA_CHXCTL_HTFIE | DMA_CHXCTL_FTFIE | DMA_CHXCTL_TAEIE);
+    nvic_irq_enable(dma->irq, 2, 0);
+    dma_channel_enable(dma->periph, dma->channel);
+}
+
+static void dac_stream_dma_stop (void)
+{
+    const struct dma_config *dma = _dac.dma;
+
+    dma_interrupt_disable(dma->periph, dma->channel, DMA_CHXCTL_HTFIE | DMA_CHXCTL_FTFIE | DMA_CHXCTL_TAEIE);
+    dma_channel_disable(dma->periph, dma->channel);
+    while (DMA_CHCTL(dma->periph, dma->channel) & DMA_CHXCTL_CHEN);
+    dma_flag_clear(dma->periph, dma->channel, DMA_FLAG_FEE | DMA_FLAG_SDE | DMA_FLAG_TAE | DMA_FLAG_HTF | DMA_FLAG_FTF);
+}
+
+/* the output that asks the DMA for the samples, DAC0 when both are streamed */
+rt_inline rt_uint32_t dac_stream_requester (void)
+{
+    return (_dac.outputs & DAC_OUT0) ? DAC0 : DAC1;
+}
+
+static void *dac_stream_half (rt_uint8_t half)
+{
+    return (rt_uint8_t *)_dac.ring + half * (_dac.samples / 2) * _dac.sample_size;
+}
+
+rt_err_t dac_stream_start (const struct dac_stream_config *config)
+{
+    rt_uint32_t n;
+
+    RT_ASSERT(config != RT_NULL);
+
+    if (_dac.running)
+    {
+        return -RT_EBUSY;
+    }
+
+    if (config->rate == 0 || config->samples < 2 || (config->samples & 1) || config->samples > DAC_DMA_MAX_SAMPLES ||
+        config->outputs == 0 || (config->outputs & ~DAC_OUTPUTS))
+    {
+        return -RT_EINVAL;
+    }
+
+    _dac.dma = RT_NULL;
+#ifdef DAC0_DMA_CONFIG
+    if (config->outputs & DAC_OUT0)
+    {
+        _dac.dma = &dac0_dma;
+    }
+#endif
+#ifdef DAC1_DMA_CONFIG
+    if (config->outputs == DAC_OUT1)
+    {
+        _dac.dma = &dac1_dma;
+    }
+#endif
+    if (_dac.dma == RT_NULL)
+    {
+        LOG_E("the DMA channel of the outputs 0x%x is used by another peripheral", config->outputs);
+        return -RT_EINVAL;
+    }
+
+    _dac.outputs = config->outputs;
+    _dac.sample_size = (config->outputs == (DAC_OUT0 | DAC_OUT1)) ? sizeof(rt_uint32_t) : sizeof(rt_uint16_t);
+    _dac.samples = config->samples;
+    _dac.refill = config->refill;
+    _dac.arg = config->arg;
+    _dac.ring = rt_malloc(_dac.samples * _dac.sample_size);
+    if (_dac.ring == RT_NULL)
+    {
+        return -RT_ENOMEM;
+    }
+
+    if (_dac.refill)
+    {
+        _dac.refill(dac_stream_half(0), _dac.samples / 2, _dac.arg);
+        _dac.refill(dac_stream_half(1), _dac.samples / 2, _dac.arg);
+    }
+    else
+    {
+        for (n = 0; n < _dac.samples; n ++)
+        {
+            if (_dac.sample_size == sizeof(rt_uint32_t))
+            {
+                ((rt_uint32_t *)_dac.ring)[n] = DAC_MID_SCALE | (DAC_MID_SCALE << 16);
+            }
+            else
+            {
+                ((rt_uint16_t *)_dac.ring)[n] = DAC_MID_SCALE;
+            }
+        }
+    }
+
+    rt_sem_control(&_dac.half_sem, RT_IPC_CMD_RESET, (void *)0);
+    _dac.half_pending = RT_FALSE;
+
+    dac_output_init(_dac.outputs, RT_TRUE);
+    dac_stream_dma_start();
+    dac_dma_enable(dac_stream_requester());
+    dac_interrupt_flag_clear(dac_stream_requester());
+    dac_interrupt_enable(dac_stream_requester());
+    nvic_irq_enable(TIMER5_DAC_IRQn, 2, 0);
+
+    _dac.stream = RT_TRUE;
+    _dac.running = _dac.outputs;
+    _dac.stats.rate = dac_timer_start(config->rate);
+
+    LOG_D("stream of %d samples at %d Hz", _dac.samples, _dac.stats.rate);
+
+    return RT_EOK;
+}
+
+void *dac_stream_wait (rt_uint32_t *count, rt_int32_t timeout)
+{
+    void *samples = RT_NULL;
+    rt_base_t level;
+
+    if (rt_sem_take(&_dac.half_sem, timeout) != RT_EOK)
+    {
+        return RT_NULL;
+    }
+
+    level = rt_hw_interrupt_disable();
+    if (_dac.stream)
+    {
+        _dac.half_pending = RT_FALSE;
+        samples = dac_stream_half(_dac.half);
+        if (count)
+        {
+            *count = _dac.samples / 2;
+        }
+    }
+    rt_hw_interrupt_enable(level);
+
+    return samples;
+}
+
+static void dac_stream_half_done (rt_uint8_t half)
+{
+    _dac.stats.halves ++;
+
+    if (_dac.refill)
+    {
+        _dac.refill(dac_stream_half(half), _dac.samples / 2, _dac.arg);
+        return;
+    }
+
+    /* the newest played half is refilled, the older one is played again */
+    _dac.half = half;
+    if (_dac.half_pending)
+    {
+        _dac.stats.late ++;
+        return;
+    }
+    _dac.half_pending = RT_TRUE;
+    rt_sem_release(&_dac.half_sem);
+}
+
+static void dac_dma_isr (const struct dma_config *dma)
+{
+    if (dma != _dac.dma || !_dac.stream)
+    {
+        return;
+    }
+
+    if (dma_interrupt_flag_get(dma->periph, dma->channel, DMA_INT_FLAG_HTF))
+    {
+        dma_interrupt_flag_clear(dma->periph, dma->channel, DMA_INT_FLAG_HTF);
+        dac_stream_half_done(0);
+    }
+
+    if (dma_interrupt_flag_get(dma->periph, dma->channel, DMA_INT_FLAG_FTF))
+    {
+        dma_interrupt_flag_clear(dma->periph, dma->channel, DMA_INT_FLAG_FTF);
+        dac_stream_half_done(1);
+    }
+
+    if (dma_interrupt_flag_get(dma->periph, dma->channel, DMA_INT_FLAG_TAE))
+    {
+        dma_interrupt_flag_clear(dma->periph, dma->channel, DMA_INT_FLAG_TAE);
+        _dac.stats.dma_errors ++;
+    }
+}
+
+#ifdef DAC0_DMA_CONFIG
+void DAC0_DMA_IRQHandler (void)
+{
+    /* enter interrupt */
+    rt_interrupt_enter();
+
+    dac_dma_isr(&dac0_dma);
+
+    /* leave interrupt */
+    rt_interrupt_leave();
+}
+#endif /* DAC0_DMA_CONFIG */
+
+#ifdef DAC1_DMA_CONFIG
+void DAC1_DMA_IRQHandler (void)
+{
+    /* enter interrupt */
+    rt_interrupt_enter();
+
+    dac_dma_isr(&dac1_dma);
+
+    /* leave interrupt */
+    rt_interrupt_leave();
+}
+#endif /* DAC1_DMA_CONFIG */
+
+/* a trigger came before the DMA delivered the sample, the DMA request stops until it is restarted */
+void TIMER5_DAC_IRQHandler (void)
+{
+    rt_uint32_t x;
+
+    /* enter interrupt */
+    rt_interrupt_enter();
+
+    for (x = DAC0; x <= DAC1; x ++)
+    {
+        if (dac_interrupt_flag_get(x) == SET)
+        {
+            dac_interrupt_flag_clear(x);
+            if (_dac.stream)
+            {
+                _dac.stats.underruns ++;
+                dac_dma_disable(x);
+                dac_stream_dma_stop();
+                dac_stream_dma_start();
+                dac_dma_enable(x);
+            }
+        }
+    }
+
+    /* leave interrupt */
+    rt_interrupt_leave();
+}
+#endif /* BSP_DAC_USING_STREAM */
+
+rt_err_t dac_wave_start (rt_uint8_t outputs, enum dac_wave wave, rt_uint16_t base, rt_uint8_t bits, rt_uint32_t rate)
+{
+    rt_uint32_t x;
+
+    if (_dac.running)
+    {
+        return -RT_EBUSY;
+    }
+
+    if (outputs == 0 || (outputs & ~DAC_OUTPUTS) || bits < 1 || bits > 12 || base > 0xFFF || rate == 0)
+    {
+        return -RT_EINVAL;
+    }
+
+    dac_output_init(outputs, RT_TRUE);
+
+    for (x = 0; x < 2; x ++)
+    {
+        if (!(outputs & (1 << x)))
+        {
+            continue;
+        }
+
+        dac_data_set(x, DAC_ALIGN_12B_R, base);
+        if (wave == DAC_WAVE_NOISE)
+        {
+            dac_wave_mode_config(x, DAC_WAVE_MODE_LFSR);
+            dac_lfsr_noise_config(x, DWBW(bits - 1));
+        }
+        else
+        {
+            /* the triangle is added to the base, the output saturates at the full scale */
+            dac_wave_mode_config(x, DAC_WAVE_MODE_TRIANGLE);
+            dac_triangle_noise_config(x, DWBW(bits - 1));
+        }
+    }
+
+    _dac.running = outputs;
+    _dac.stats.rate = dac_timer_start(rate);
+
+    return RT_EOK;
+}
+
+rt_err_t dac_stop (void)
+{
+    rt_uint32_t x;
+    rt_base_t level;
+
+    if (!_dac.running)
+    {
+        return RT_EOK;
+    }
+
+    timer_disable(DAC_TIMER);
+
+    for (x = 0; x < 2; x ++)
+    {
+        if (_dac.running & (1 << x))
+        {
+            dac_dma_disable(x);
+            dac_interrupt_disable(x);
+            dac_wave_mode_config(x, DAC_WAVE_DISABLE);
+            dac_trigger_disable(x);
+        }
+    }
+
+#ifdef BSP_DAC_USING_STREAM
+    if (_dac.stream)
+    {
+        dac_stream_dma_stop();
+
+        level = rt_hw_interrupt_disable();
+        _dac.stream = RT_FALSE;
+        rt_hw_interrupt_enable(level);
+
+        /* wakes a thread waiting for a half */
+        rt_sem_release(&_dac.half_sem);
+
+        rt_free(_dac.ring);
+        _dac.ring = RT_NULL;
+    }
+#endif
+
+    level = rt_hw_interrupt_disable();
+    _dac.running = 0;
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+
+void dac_stats_get (struct dac_stats *stats)
+{
+    rt_base_t level;
+
+    RT_ASSERT(stats != RT_NULL);
+
+    level = rt_hw_interrupt_disable();
+    *stats = _dac.stats;
+    rt_hw_interrupt_enable(level);
+}
+
+static rt_err_t gd32_dac_enabled (struct rt_dac_device *device, rt_uint32_t channel)
+{
+    if (channel > 1 || !(DAC_OUTPUTS & (1 << channel)))
+    {
+        LOG_E("invalid channel");
+        return -RT_EINVAL;
+    }
+
+    if (_dac.running & (1 << channel))
+    {
+        return -RT_EBUSY;
+    }
+
+    dac_output_init(1 << channel, RT_FALSE);
+    _dac.enabled |= 1 << channel;
+
+    return RT_EOK;
+}
+
+static rt_err_t gd32_dac_disabled (struct rt_dac_device *device, rt_uint32_t channel)
+{
+    if (channel > 1 || !(DAC_OUTPUTS & (1 << channel)))
+    {
+        LOG_E("invalid channel");
+        return -RT_EINVAL;
+    }
+
+    if (_dac.running & (1 << channel))
+    {
+        return -RT_EBUSY;
+    }
+
+    dac_disable(channel);
+    _dac.enabled &= ~(1 << channel);
+
+    return RT_EOK;
+}
+
+static rt_err_t gd32_dac_convert (struct rt_dac_device *device, rt_uint32_t channel, rt_uint32_t *value)
+{
+    if (channel > 1 || !(_dac.enabled & (1 << channel)) || value == RT_NULL)
+    {
+        LOG_E("invalid param");
+        return -RT_EINVAL;
+    }
+
+    if (_dac.running & (1 << channel))
+    {
+        return -RT_EBUSY;
+    }
+
+    /* without a trigger the output follows one clock after the write */
+    dac_data_set(channel, DAC_ALIGN_12B_R, *value & 0xFFF);
+
+    return RT_EOK;
+}
+
+static rt_uint8_t gd32_dac_get_resolution (struct rt_dac_device *device)
+{
+    return 12;
+}
+
+static const struct rt_dac_ops gd32_dac_ops =
+{
+    .disabled = gd32_dac_disabled,
+    .enabled = gd32_dac_enabled,
+    .convert = gd32_dac_convert,
+    .get_resolution = gd32_dac_get_resolution,
+};
+
+static int rt_hw_dac_init (void)
+{
+    rt_err_t ret;
+
+#ifdef BSP_DAC_USING_STREAM
+    rt_sem_init(&_dac.half_sem, "dac", 0, RT_IPC_FLAG_PRIO);
+#endif
+
+    ret = rt_hw_dac_register(&_dac.device, "dac", &gd32_dac_ops, RT_NULL);
+    if (ret != RT_EOK)
+    {
+        LOG_E("failed register dac, err=%d", ret);
+    }
+
+    return ret;
+}
+INIT_DEVICE_EXPORT(rt_hw_dac_init);
+
+#ifdef FINSH_USING_MSH
+#ifdef BSP_DAC_USING_STREAM
+static rt_uint32_t saw_phase, saw_step;
+
+/* a sawtooth from a phase accumulator, the same on both outputs */
+static void dac_saw_refill (void *samples, rt_uint32_t count, void *arg)
+{
+    rt_uint32_t n, value;
+
+    for (n = 0; n < count; n ++)
+    {
+        value = saw_phase >> 20;
+        saw_phase += saw_step;
+        if (_dac.sample_size == sizeof(rt_uint32_t))
+        {
+            ((rt_uint32_t *)samples)[n] = value | (value << 16);
+        }
+        else
+        {
+            ((rt_uint16_t *)samples)[n] = value;
+        }
+    }
+}
+#endif /* BSP_DAC_USING_STREAM */
+
+static int dac (int argc, char **argv)
+{
+    struct dac_stats stats;
+    rt_err_t result;
+
+    if (argc == 2 && !rt_strcmp(argv[1], "stop"))
+    {
+        return dac_stop();
+    }
+    else if ((argc == 5 || argc == 6) && !rt_strcmp(argv[1], "wave"))
+    {
+        result = dac_wave_start(DAC_OUTPUTS, !rt_strcmp(argv[2], "noise") ? DAC_WAVE_NOISE : DAC_WAVE_TRIANGLE,
+                                argc == 6 ? atoi(argv[5]) : 0, atoi(argv[3]), atoi(argv[4]));
+        if (result != RT_EOK)
+        {
+            rt_kprintf("wave failed: %d\n", result);
+        }
+        return result;
+    }
+#ifdef BSP_DAC_USING_STREAM
+    else if ((argc == 3 || argc == 4) && !rt_strcmp(argv[1], "saw"))
+    {
+        struct dac_stream_config config = { 0 };
+
+        config.rate = argc == 4 ? atoi(argv[3]) : 48000;
+        config.outputs = DAC_OUTPUTS;
+        config.samples = 1024;
+        config.refill = dac_saw_refill;
+        saw_phase = 0;
+        saw_step = config.rate ? (rt_uint32_t)(((rt_uint64_t)atoi(argv[2]) << 32) / config.rate) : 0;
+
+        result = dac_stream_start(&config);
+        if (result != RT_EOK)
+        {
+            rt_kprintf("stream failed: %d\n", result);
+        }
+        return result;
+    }
+#endif /* BSP_DAC_USING_STREAM */
+    else if (argc > 1)
+    {
+        rt_kprintf("Usage: dac [stop | wave <noise | triangle> <bits> <rate> [base] | saw <hz> [rate]]\n");
+        return 0;
+    }
+
+    dac_stats_get(&stats);
+    rt_kprintf("outputs   : 0x%x enabled, 0x%x on the timer at %u Hz\n", _dac.enabled, _dac.running, stats.rate);
+    rt_kprintf("stream    : %u halves played, %u late\n", stats.halves, stats.late);
+    rt_kprintf("errors    : %u underruns, %u DMA errors\n", stats.underruns, stats.dma_errors);
+
+    return 0;
+}
+MSH_CMD_EXPORT(dac, control the dac outputs: dac [stop | wave <noise | triangle> <bits> <rate> [base] | saw <hz> [rate]]);
+#endif /* FINSH_USING_MSH */
+
+#endif /* BSP_USING_DAC */
@@ -0,0 +1,647 @@
+/*
+ * Copyright (c) 2006-2024 RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-24     Evlers       first version
+ */
+
+#include <board.h>
+#include <rthw.h>
+#include <rtdevice.h>
+#include <stdlib.h>
+
+#ifdef BSP_USING_DCI
+
+#include "drv_dci.h"
+#include "drv_dma.h"
+#include "drv_config.h"
+#include "drv_sdram.h"
+
+//#define DRV_DEBUG
+#define LOG_TAG             "drv.dci"
+#include <drv_log.h>
+
+#ifndef BSP_DCI_WIDTH
+#define BSP_DCI_WIDTH               320
+#endif
+#ifndef BSP_DCI_HEIGHT
+#define BSP_DCI_HEIGHT              240
+#endif
+#ifndef BSP_DCI_BYTES_PER_PIXEL
+#define BSP_DCI_BYTES_PER_PIXEL     2
+#endif
+#ifndef BSP_DCI_FRAME_BUFFERS
+#define BSP_DCI_FRAME_BUFFERS       3
+#endif
+
+#define DCI_FB_SIZE                 (BSP_DCI_WIDTH * BSP_DCI_HEIGHT * BSP_DCI_BYTES_PER_PIXEL)
+#define DCI_DMA_MAX_WORDS           0xFFFF
+
+/* a buffer is captured into, holds the newest frame, or is borrowed by a consumer */
+#define DCI_BUF_FREE                0
+#define DCI_BUF_DMA                 1
+#define DCI_BUF_READY               2
+#define DCI_BUF_BORROWED            3
+
+/* one DMA transfer, a frame larger than a transfer takes several */
+struct dci_chunk
+{
+    rt_int8_t buf;
+    rt_uint16_t part;
+};
+
+struct gd32_dci
+{
+    rt_uint8_t *fb[BSP_DCI_FRAME_BUFFERS];
+    rt_uint8_t state[BSP_DCI_FRAME_BUFFERS];
+    rt_uint32_t sequence[BSP_DCI_FRAME_BUFFERS];
+    rt_tick_t tick[BSP_DCI_FRAME_BUFFERS];
+
+    rt_uint16_t width;                  /* the frame after the crop */
+    rt_uint16_t height;
+    rt_uint32_t frame_size;
+    rt_uint32_t chunk_words;            /* words of each transfer */
+    rt_uint16_t chunks;                 /* transfers of each frame */
+
+    /* the chunk written now and the one queued in the other memory target */
+    struct dci_chunk inflight[2];
+    volatile rt_int8_t ready;           /* the newest finished frame */
+    rt_uint8_t borrowed;
+    rt_uint32_t frames;
+
+    enum dci_mode mode;
+    volatile rt_bool_t running;
+    struct rt_semaphore frame_sem;
+
+    dci_frame_done_t frame_done;
+    void *frame_done_arg;
+
+    struct dci_stats stats;
+};
+
+static const struct dma_config dci_dma = DCI_DMA_CONFIG;
+static struct gd32_dci _dci;
+
+/**
+ * @brief DCI MSP Initialization
+ *        This function configures the hardware resources used in this example:
+ *           - Peripheral's GPIO Configuration
+ *        The pins are the camera connector of the GD32F4xx evaluation boards.
+ *        This function belongs to weak function, users can rewrite this function according to different needs
+ *
+ * @return None
+ */
+rt_weak void gd32_msp_dci_init (void)
+{
+    rcu_periph_clock_enable(RCU_GPIOA);
+    rcu_periph_clock_enable(RCU_GPIOB);
+    rcu_periph_clock_enable(RCU_GPIOC);
+    rcu_periph_clock_enable(RCU_GPIOD);
+
+    /* HSYNC(PA4), PCLK(PA6), VSYNC(PB7) */
+    /* D0(PC6), D1(PC7), D2(PC8), D3(PC9), D4(PC11), D5(PD3), D6(PB8), D7(PB9) */
+    gpio_af_set(GPIOA, GPIO_AF_13, GPIO_PIN_4 | GPIO_PIN_6);
+    gpio_mode_set(GPIOA, GPIO_MODE_AF, GPIO_PUPD_PULLUP, GPIO_PIN_4 | GPIO_PIN_6);
+    gpio_output_options_set(GPIOA, GPIO_OTYPE_PP, GPIO_OSPEED_50MHZ, GPIO_PIN_4 | GPIO_PIN_6);
+
+    gpio_af_set(GPIOB, GPIO_AF_13, GPIO_PIN_7 | GPIO_PIN_8 | GPIO_PIN_9);
+    gpio_mode_set(GPIOB, GPIO_MODE_AF, GPIO_PUPD_PULLUP, GPIO_PIN_7 | GPIO_PIN_8 | GPIO_PIN_9);
+    gpio_output_options_set(GPIOB, GPIO_OTYPE_PP, GPIO_OSPEED_50MHZ, GPIO_PIN_7 | GPIO_PIN_8 | GPIO_PIN_9);
+
+    gpio_af_set(GPIOC, GPIO_AF_13, GPIO_PIN_6 | GPIO_PIN_7 | GPIO_PIN_8 | GPIO_PIN_9 | GPIO_PIN_11);
+    gpio_mode_set(GPIOC, GPIO_MODE_AF, GPIO_PUPD_PULLUP, GPIO_PIN_6 | GPIO_PIN_7 | GPIO_PIN_8 | GPIO_PIN_9 | GPIO_PIN_11);
+    gpio_output_options_set(GPIOC, GPIO_OTYPE_PP, GPIO_OSPEED_50MHZ, GPIO_PIN_6 | GPIO_PIN_7 | GPIO_PIN_8 | GPIO_PIN_9 | GPIO_PIN_11);
+
+    gpio_af_set(GPIOD, GPIO_AF_13, GPIO_PIN_3);
+    gpio_mode_set(GPIOD, GPIO_MODE_AF, GPIO_PUPD_PULLUP, GPIO_PIN_3);
+    gpio_output_options_set(GPIOD, GPIO_OTYPE_PP, GPIO_OSPEED_50MHZ, GPIO_PIN_3);
+}
+
+/* split the frame into the fewest equal transfers the DMA counter holds */
+static rt_err_t dci_layout (rt_uint16_t width, rt_uint16_t height)
+{
+    rt_uint32_t size = (rt_uint32_t)width * height * BSP_DCI_BYTES_PER_PIXEL;
+    rt_uint32_t words, n;
+
+    if (size == 0 || size > DCI_FB_SIZE || (size & 3) != 0)
+    {
+        LOG_E("a %dx%d frame of %d bytes does not fit the buffers in words", width, height, size);
+        return -RT_EINVAL;
+    }
+
+    words = size / 4;
+    for (n = (words + DCI_DMA_MAX_WORDS - 1) / DCI_DMA_MAX_WORDS; words % n != 0; n ++);
+
+    _dci.width = width;
+    _dci.height = height;
+    _dci.frame_size = size;
+    _dci.chunks = n;
+    _dci.chunk_words = words / n;
+
+    LOG_D("%dx%d, %d transfers of %d words", width, height, n, words / n);
+
+    return RT_EOK;
+}
+
+static rt_uint32_t dci_chunk_addr (const struct dci_chunk *chunk)
+{
+    return (rt_uint32_t)_dci.fb[chunk->buf] + chunk->part * _dci.chunk_words * 4;
+}
+
+/* a free buffer for the next frame, else the newest frame nobody borrowed is dropped */
+static rt_int8_t dci_buffer_take (void)
+{
+    rt_int8_t i;
+
+    for (i = 0; i < BSP_DCI_FRAME_BUFFERS; i ++)
+    {
+        if (_dci.state[i] == DCI_BUF_FREE)
+        {
+            _dci.state[i] = DCI_BUF_DMA;
+            return i;
+        }
+    }
+
+    /* the borrow limit leaves the ready frame when no buffer is free */
+    i = _dci.ready;
+    RT_ASSERT(i >= 0);
+    _dci.ready = -1;
+    _dci.state[i] = DCI_BUF_DMA;
+    _dci.stats.dropped ++;
+
+    return i;
+}
+
+static void dci_chunk_next (struct dci_chunk *next, const struct dci_chunk *last)
+{
+    if (last->part + 1 < _dci.chunks)
+    {
+        next->buf = last->buf;
+        next->part = last->part + 1;
+    }
+    else
+    {
+        next->buf = dci_buffer_take();
+        next->part = 0;
+    }
+}
+
+static void dci_dma_start (void)
+{
+    dma_multi_data_parameter_struct dma_init_struct = { 0 };
+
+    _dci.inflight[0].buf = dci_buffer_take();
+    _dci.inflight[0].part = 0;
+    dci_chunk_next(&_dci.inflight[1], &_dci.inflight[0]);
+
+    dma_deinit(dci_dma.periph, dci_dma.channel);
+    dma_init_struct.periph_addr         = (uint32_t)&DCI_DATA;
+    dma_init_struct.periph_width        = DMA_PERIPH_WIDTH_32BIT;
+    dma_init_struct.periph_inc          = DMA_PERIPH_INCREASE_DISABLE;
+    dma_init_struct.memory0_addr        = dci_chunk_addr(&_dci.inflight[0]);
+    dma_init_struct.memory_width        = DMA_MEMORY_WIDTH_32BIT;
+    dma_init_struct.memory_inc          = DMA_MEMORY_INCREASE_ENABLE;
+    /* bursts to the SDRAM need whole bursts in the transfer */
+    dma_init_struct.memory_burst_width  = (_dci.chunk_words & 3) ? DMA_MEMORY_BURST_SINGLE : DMA_MEMORY_BURST_4_BEAT;
+    dma_init_struct.periph_burst_width  = DMA_PERIPH_BURST_SINGLE;
+    dma_init_struct.critical_value      = DMA_FIFO_4_WORD;
+    dma_init_struct.circular_mode       = DMA_CIRCULAR_MODE_ENABLE;
+    dma_init_struct.direction           = DMA_PERIPH_TO_MEMORY;
+    dma_init_struct.number              = _dci.chunk_words;
+    dma_init_struct.priority            = DMA_PRIORITY_ULTRA_HIGH;
+    dma_multi_data_mode_init(dci_dma.periph, dci_dma.channel, &dma_init_struct);
+    dma_channel_subperipheral_select(dci_dma.periph, dci_dma.channel, dci_dma.subperiph);
+
+    /* the DMA switches between the targets by itself, the idle one is set up for the chunk after */
+    dma_switch_buffer_mode_config(dci_dma.periph, dci_dma.channel, dci_chunk_addr(&_dci.inflight[1]), DMA_MEMORY_0);
+    dma_switch_buffer_mode_enable(dci_dma.periph, dci_dma.channel, ENABLE);
+
+    dma_flag_clear(dci_dma.periph, dci_dma.channel, DMA_FLAG_FEE | DMA_FLAG_SDE | DMA_FLAG_TAE | DMA_FLAG_HTF | DMA_FLAG_FTF);
+    dma_interrupt_enable(dci_dma.periph, dci_dma.channel, DMA_CHXCTL_FTFIE | DMA_CHXCTL_TAEIE);
+    dma_channel_enable(dci_dma.periph, dci_dma.channel);
+}
+
+static void dci_dma_stop (void)
+{
+    int i;
+
+    dma_channel_disable(dci_dma.periph, dci_dma.channel);
+    while (DMA_CHCTL(dci_dma.periph, dci_dma.channel) & DMA_CHXCTL_CHEN);
+    dma_flag_clear(dci_dma.periph, dci_dma.channel, DMA_FLAG_FEE | DMA_FLAG_SDE | DMA_FLAG_TAE | DMA_FLAG_HTF | DMA_FLAG_FTF);
+
+    /* the frames being captured are lost */
+    for (i = 0; i < BSP_DCI_FRAME_BUFFERS; i ++)
+    {
+        if (_dci.state[i] == DCI_BUF_DMA)
+        {
+            _dci.state[i] = DCI_BUF_FREE;
+        }
+    }
+}
+
+/* the DMA lost its place in the frame, the capture begins again at the next frame start */
+static void dci_restart (void)
+{
+    dci_capture_disable();
+    dci_dma_stop();
+    dci_dma_start();
+    dci_interrupt_flag_clear(DCI_INT_FLAG_OVR);
+    dci_capture_enable();
+}
+
+static void dci_frame_publish (rt_int8_t buf)
+{
+    struct dci_frame frame;
+
+    if (_dci.ready >= 0)
+    {
+        _dci.state[_dci.ready] = DCI_BUF_FREE;
+        _dci.stats.dropped ++;
+    }
+
+    _dci.state[buf] = DCI_BUF_READY;
+    _dci.sequence[buf] = _dci.frames ++;
+    _dci.tick[buf] = rt_tick_get();
+    _dci.ready = buf;
+    _dci.stats.frames ++;
+
+    rt_sem_release(&_dci.frame_sem);
+
+    if (_dci.frame_done != RT_NULL)
+    {
+        frame.data = _dci.fb[buf];
+        frame.size = _dci.frame_size;
+        frame.width = _dci.width;
+        frame.height = _dci.height;
+        frame.sequence = _dci.sequence[buf];
+        frame.tick = _dci.tick[buf];
+        frame.index = buf;
+        _dci.frame_done(&frame, _dci.frame_done_arg);
+    }
+}
+
+/* a memory target is full, the DMA writes into the other one already */
+static void dci_chunk_done (void)
+{
+    struct dci_chunk done = _dci.inflight[0];
+
+    if (done.part == _dci.chunks - 1)
+    {
+        dci_frame_publish(done.buf);
+
+        if (_dci.mode == DCI_MODE_SNAPSHOT)
+        {
+            /* the DCI stopped by itself after the frame */
+            dci_dma_stop();
+            _dci.running = RT_FALSE;
+            return;
+        }
+    }
+
+    _dci.inflight[0] = _dci.inflight[1];
+    dci_chunk_next(&_dci.inflight[1], &_dci.inflight[0]);
+    dma_memory_address_config(dci_dma.periph, dci_dma.channel,
+                              dma_using_memory_get(dci_dma.periph, dci_dma.channel) == DMA_MEMORY_0 ? DMA_MEMORY_1 : DMA_MEMORY_0,
+                              dci_chunk_addr(&_dci.inflight[1]));
+}
+
+void DCI_DMA_IRQHandler (void)
+{
+    rt_interrupt_enter();
+
+    if (dma_interrupt_flag_get(dci_dma.periph, dci_dma.channel, DMA_INT_FLAG_FTF))
+    {
+        dma_interrupt_flag_clear(dci_dma.periph, dci_dma.channel, DMA_INT_FLAG_FTF);
+        if (_dci.running)
+        {
+            dci_chunk_done();
+        }
+    }
+
+    if (dma_interrupt_flag_get(dci_dma.periph, dci_dma.channel, DMA_INT_FLAG_TAE))
+    {
+        dma_interrupt_flag_clear(dci_dma.periph, dci_dma.channel, DMA_INT_FLAG_TAE);
+        _dci.stats.dma_errors ++;
+        if (_dci.running)
+        {
+            dci_restart();
+        }
+    }
+
+    rt_interrupt_leave();
+}
+
+void DCI_IRQHandler (void)
+{
+    rt_interrupt_enter();
+
+    if (dci_interrupt_flag_get(DCI_INT_FLAG_OVR) == SET)
+    {
+        dci_interrupt_flag_clear(DCI_INT_FLAG_OVR);
+        _dci.stats.overruns ++;
+        if (_dci.running)
+        {
+            dci_restart();
+        }
+    }
+
+    rt_interrupt_leave();
+}
+
+rt_err_t dci_start (enum dci_mode mode)
+{
+    rt_base_t level;
+
+    if (_dci.running)
+    {
+        return -RT_EBUSY;
+    }
+
+    rt_sem_control(&_dci.frame_sem, RT_IPC_CMD_RESET, RT_NULL);
+
+    level = rt_hw_interrupt_disable();
+    /* a frame left from before is not handed out for the new capture */
+    if (_dci.ready >= 0)
+    {
+        _dci.state[_dci.ready] = DCI_BUF_FREE;
+        _dci.ready = -1;
+    }
+
+    _dci.mode = mode;
+    if (mode == DCI_MODE_SNAPSHOT)
+    {
+        DCI_CTL |= DCI_CTL_SNAP;
+    }
+    else
+    {
+        DCI_CTL &= ~DCI_CTL_SNAP;
+    }
+
+    dci_dma_start();
+    _dci.running = RT_TRUE;
+    dci_interrupt_flag_clear(DCI_INT_FLAG_OVR);
+    dci_capture_enable();
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+
+rt_err_t dci_stop (void)
+{
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    if (_dci.running)
+    {
+        dci_capture_disable();
+        dci_dma_stop();
+        _dci.running = RT_FALSE;
+    }
+    rt_hw_interrupt_enable(level);
+
+    /* the waiting consumers see the capture stopped */
+    rt_sem_release(&_dci.frame_sem);
+
+    return RT_EOK;
+}
+
+rt_err_t dci_crop_set (rt_uint16_t x, rt_uint16_t y, rt_uint16_t width, rt_uint16_t height)
+{
+    rt_err_t result;
+
+    if (_dci.running)
+    {
+        return -RT_EBUSY;
+    }
+
+    if (width == 0 || height == 0)
+    {
+        dci_crop_window_disable();
+        return dci_layout(BSP_DCI_WIDTH, BSP_DCI_HEIGHT);
+    }
+
+    if (x + width > BSP_DCI_WIDTH || y + height > BSP_DCI_HEIGHT)
+    {
+        return -RT_EINVAL;
+    }
+
+    result = dci_layout(width, height);
+    if (result != RT_EOK)
+    {
+        return result;
+    }
+
+    /* the window counts pixel clocks and lines, the sizes minus one */
+    dci_crop_window_config(x * BSP_DCI_BYTES_PER_PIXEL, y, width * BSP_DCI_BYTES_PER_PIXEL - 1, height - 1);
+    dci_crop_window_enable();
+
+    return RT_EOK;
+}
+
+rt_err_t dci_frame_borrow (struct dci_frame *frame, rt_int32_t timeout)
+{
+    rt_base_t level;
+    rt_int8_t buf;
+
+    RT_ASSERT(frame != RT_NULL);
+
+    while (1)
+    {
+        level = rt_hw_interrupt_disable();
+        buf = _dci.ready;
+        if (buf >= 0)
+        {
+            /* two buffers stay with the DMA */
+            if (_dci.borrowed >= BSP_DCI_FRAME_BUFFERS - 2)
+            {
+                rt_hw_interrupt_enable(level);
+                return -RT_EBUSY;
+            }
+
+            _dci.ready = -1;
+            _dci.state[buf] = DCI_BUF_BORROWED;
+            _dci.borrowed ++;
+            _dci.stats.borrowed ++;
+
+            frame->data = _dci.fb[buf];
+            frame->size = _dci.frame_size;
+            frame->width = _dci.width;
+            frame->height = _dci.height;
+            frame->sequence = _dci.sequence[buf];
+            frame->tick = _dci.tick[buf];
+            frame->index = buf;
+            rt_hw_interrupt_enable(level);
+
+            return RT_EOK;
+        }
+        rt_hw_interrupt_enable(level);
+
+        if (!_dci.running)
+        {
+            return -RT_EEMPTY;
+        }
+
+        /* the semaphore may hold the counts of the frames nobody waited for */
+        if (timeout == 0 || rt_sem_take(&_dci.frame_sem, timeout) != RT_EOK)
+        {
+            return -RT_ETIMEOUT;
+        }
+    }
+}
+
+void dci_frame_return (const struct dci_frame *frame)
+{
+    rt_base_t level;
+
+    RT_ASSERT(frame != RT_NULL);
+    RT_ASSERT(frame->index >= 0 && frame->index < BSP_DCI_FRAME_BUFFERS);
+
+    level = rt_hw_interrupt_disable();
+    if (_dci.state[frame->index] == DCI_BUF_BORROWED)
+    {
+        _dci.state[frame->index] = DCI_BUF_FREE;
+        _dci.borrowed --;
+    }
+    rt_hw_interrupt_enable(level);
+}
+
+void dci_frame_done_set (dci_frame_done_t done, void *arg)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+    _dci.frame_done = done;
+    _dci.frame_done_arg = arg;
+    rt_hw_interrupt_enable(level);
+}
+
+void dci_stats_get (struct dci_stats *stats)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+    *stats = _dci.stats;
+    rt_hw_interrupt_enable(level);
+}
+
+static int rt_hw_dci_init (void)
+{
+    dci_parameter_struct dci_init_struct;
+    int i;
+
+    for (i = 0; i < BSP_DCI_FRAME_BUFFERS; i ++)
+    {
+        _dci.fb[i] = sdram_framebuffer_alloc(DCI_FB_SIZE);
+        if (_dci.fb[i] == RT_NULL)
+        {
+            LOG_E("no memory for the frame buffers (%d x %d bytes)", BSP_DCI_FRAME_BUFFERS, DCI_FB_SIZE);
+            return -RT_ENOMEM;
+        }
+        _dci.state[i] = DCI_BUF_FREE;
+    }
+    _dci.ready = -1;
+    rt_sem_init(&_dci.frame_sem, "dci", 0, RT_IPC_FLAG_PRIO);
+
+    if (dci_layout(BSP_DCI_WIDTH, BSP_DCI_HEIGHT) != RT_EOK)
+    {
+        return -RT_EINVAL;
+    }
+
+    gd32_msp_dci_init();
+
+    rcu_periph_clock_enable(RCU_DCI);
+    rcu_periph_clock_enable(dci_dma.rcu);
+    dci_deinit();
+
+    dci_init_struct.capture_mode = DCI_CAPTURE_MODE_CONTINUOUS;
+#ifdef BSP_DCI_PCLK_RISING
+    dci_init_struct.clock_polarity = DCI_CK_POLARITY_RISING;
+#else
+    dci_init_struct.clock_polarity = DCI_CK_POLARITY_FALLING;
+#endif
+#ifdef BSP_DCI_HSYNC_HIGH
+    dci_init_struct.hsync_polarity = DCI_HSYNC_POLARITY_HIGH;
+#else
+    dci_init_struct.hsync_polarity = DCI_HSYNC_POLARITY_LOW;
+#endif
+#ifdef BSP_DCI_VSYNC_HIGH
+    dci_init_struct.vsync_polarity = DCI_VSYNC_POLARITY_HIGH;
+#else
+    dci_init_struct.vsync_polarity = DCI_VSYNC_POLARITY_LOW;
+#endif
+    dci_init_struct.frame_rate = DCI_FRAME_RATE_ALL;
+    dci_init_struct.interface_format = DCI_INTERFACE_FORMAT_8BITS;
+    dci_init(&dci_init_struct);
+
+    dci_interrupt_flag_clear(DCI_INT_FLAG_EF | DCI_INT_FLAG_OVR | DCI_INT_FLAG_ESE | DCI_INT_FLAG_VSYNC | DCI_INT_FLAG_EL);
+    dci_interrupt_enable(DCI_INT_OVR);
+    nvic_irq_enable(DCI_IRQn, 2, 0);
+    nvic_irq_enable(dci_dma.irq, 2, 0);
+    dci_enable();
+
+    LOG_I("%dx%d, %d frame buffers at 0x%08X", BSP_DCI_WIDTH, BSP_DCI_HEIGHT,
+          BSP_DCI_FRAME_BUFFERS, (rt_uint32_t)_dci.fb[0]);
+
+    return RT_EOK;
+}
+INIT_DEVICE_EXPORT(rt_hw_dci_init);
+
+#ifdef FINSH_USING_MSH
+static int dci (int argc, char **argv)
+{
+    struct dci_stats stats;
+    struct dci_frame frame;
+    rt_err_t result;
+
+    if (argc == 2 && !rt_strcmp(argv[1], "start"))
+    {
+        return dci_start(DCI_MODE_CONTINUOUS);
+    }
+    else if (argc == 2 && !rt_strcmp(argv[1], "stop"))
+    {
+        return dci_stop();
+    }
+    else if (argc == 2 && !rt_strcmp(argv[1], "snap"))
+    {
+        result = dci_start(DCI_MODE_SNAPSHOT);
+        if (result == RT_EOK)
+        {
+            result = dci_frame_borrow(&frame, RT_TICK_PER_SECOND);
+        }
+        if (result != RT_EOK)
+        {
+            rt_kprintf("no frame: %d\n", result);
+            dci_stop();
+            return result;
+        }
+        rt_kprintf("frame %u: %dx%d, %u bytes at 0x%08X\n", frame.sequence, frame.width, frame.height,
+                   frame.size, (rt_uint32_t)frame.data);
+        dci_frame_return(&frame);
+        return 0;
+    }
+    else if (argc == 6 && !rt_strcmp(argv[1], "crop"))
+    {
+        result = dci_crop_set(atoi(argv[2]), atoi(argv[3]), atoi(argv[4]), atoi(argv[5]));
+        if (result != RT_EOK)
+        {
+            rt_kprintf("crop failed: %d\n", result);
+        }
+        return result;
+    }
+    else if (argc > 1)
+    {
+        rt_kprintf("Usage: dci [start | stop | snap | crop <x> <y> <width> <height>]\n");
+        return 0;
+    }
+
+    dci_stats_get(&stats);
+    rt_kprintf("frame     : %dx%d, %d bytes in %d transfers\n", _dci.width, _dci.height, _dci.frame_size, _dci.chunks);
+    rt_kprintf("state     : %s\n", _dci.running ? (_dci.mode == DCI_MODE_SNAPSHOT ? "snapshot" : "capturing") : "stopped");
+    rt_kprintf("frames    : %u (%u borrowed, %u dropped)\n", stats.frames, stats.borrowed, stats.dropped);
+    rt_kprintf("errors    : %u FIFO overruns, %u DMA errors\n", stats.overruns, stats.dma_errors);
+
+    return 0;
+}
+MSH_CMD_EXPORT(dci, control the camera capture: dci [start | stop | snap | crop <x> <y> <width> <height>]);
+#endif /* FINSH_USING_MSH */
+
+#endif /* BSP_USING_DCI */
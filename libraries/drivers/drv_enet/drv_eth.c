@@ -7,6 +7,8 @@
  * Date         Author      Notes
  * 2024-06-13   Evlers      first implementation
  * 2024-08-27   Evlers      close flow control and osf function to fix dma tx stop bug
+ * 2024-10-19   Evlers      run the receive path from sram
+ * 2024-10-19   Evlers      add profiler probes
  */
 
 #include <stdint.h>
@@ -16,6 +18,7 @@
 
 #include "drv_config.h"
 #include "drv_eth.h"
+#include "profiler.h"
 
 #include <netif/ethernetif.h>
 #include <lwipopts.h>
@@ -59,6 +62,9 @@ static rt_uint8_t mac_addr[NETIF_MAX_HWADDR_LEN];
 static rt_uint32_t rx_err_cnt;
 #endif
 
+PROF_DEFINE(eth_rx);
+PROF_DEFINE(eth_tx);
+
 
 #if defined(ETH_RX_DUMP) || defined(ETH_TX_DUMP)
 #define __is_print(ch) ((unsigned int)((ch) - ' ') < 127u - ' ')
@@ -503,6 +509,8 @@ rt_err_t rt_gd32_eth_tx (rt_device_t dev, struct pbuf *p)
     uint32_t payload_offset, copy_count, buffer_offset = 0, frame_length = 0;
     enet_descriptors_struct *dma_tx_desc = dma_current_txdesc;
 
+    PROF_BEGIN(eth_tx);
+
     buffer = (uint8_t *)(dma_tx_desc->buffer1_addr);
 
     for (q = p; q != NULL; q = q->next)
@@ -569,11 +577,13 @@ rt_err_t rt_gd32_eth_tx (rt_device_t dev, struct pbuf *p)
 
     resume_dma_transfer();
 
+    PROF_END(eth_tx);
+
     return ret;
 }
 
 /* rxpkt chainmode */
-static rt_err_t rxpkt_chainmode (void)
+static RT_SECTION_FASTCODE rt_err_t rxpkt_chainmode (void)
 {
 #ifdef RT_LWIP_USING_HW_CHECKSUM
     /* using ENET_AUTOCHECKSUM_ACCEPT_FAILFRAMES checksum config */
@@ -638,7 +648,7 @@ static rt_err_t rxpkt_chainmode (void)
 }
 
 /* receive data*/
-struct pbuf *rt_gd32_eth_rx (rt_device_t dev)
+RT_SECTION_FASTCODE struct pbuf *rt_gd32_eth_rx (rt_device_t dev)
 {
     struct pbuf *p = NULL, *q;
     uint32_t len;
@@ -651,6 +661,8 @@ struct pbuf *rt_gd32_eth_rx (rt_device_t dev)
         return NULL;
     }
 
+    PROF_BEGIN(eth_rx);
+
     /* obtain the size of the packet and put it into the "len" variable. */
     len = rx_frame.length;
     buffer = (uint8_t *)rx_frame.buffer;
@@ -723,10 +735,12 @@ struct pbuf *rt_gd32_eth_rx (rt_device_t dev)
         ENET_DMA_RPEN = 0U;
     }
 
+    PROF_END(eth_rx);
+
     return p;
 }
 
-void ENET_IRQHandler (void)
+RT_SECTION_FASTCODE void ENET_IRQHandler (void)
 {
     /* enter interrupt */
     rt_interrupt_enter();
@@ -7,6 +7,7 @@
  * Date           Author            Notes
  * 2021-08-20     BruceOu           the first version
  * 2024-05-28     Evlers            add gd32_pin_get supports
+ * 2024-10-27     Evlers            add the port operations and dispatch the exti by the pending register
  */
 
 #include <rtdevice.h>
@@ -16,6 +17,7 @@
 #ifdef RT_USING_PIN
 
 #include "drv_gpio.h"
+#include "delay.h"
 
 static const struct pin_index pins[] =
 {
@@ -390,15 +392,13 @@ static void gd32_pin_mode(rt_device_t dev, rt_base_t pin, rt_uint8_t mode)
   */
 static void gd32_pin_write(rt_device_t dev, rt_base_t pin, rt_uint8_t value)
 {
-    const struct pin_index *index = RT_NULL;
-
-    index = get_pin(pin);
-    if (index == RT_NULL)
+    /* the port and the bit follow from the number, the table is not needed */
+    if ((rt_ubase_t)pin >= ITEM_NUM(pins))
     {
         return;
     }
 
-    gpio_bit_write(index->gpio_periph, index->pin, (bit_status)value);
+    GPIO_BOP(PIN_GDPORT(pin)) = value ? PIN_GDPIN(pin) : ((rt_uint32_t)PIN_GDPIN(pin) << 16);
 }
 
 /**
@@ -408,17 +408,32 @@ static void gd32_pin_write(rt_device_t dev, rt_base_t pin, rt_uint8_t value)
   */
 static rt_int8_t gd32_pin_read(rt_device_t dev, rt_base_t pin)
 {
-    rt_int8_t value = PIN_LOW;
-    const struct pin_index *index = RT_NULL;
+    if ((rt_ubase_t)pin >= ITEM_NUM(pins))
+    {
+        return PIN_LOW;
+    }
 
-    index = get_pin(pin);
-    if (index == RT_NULL)
+    return (GPIO_ISTAT(PIN_GDPORT(pin)) & PIN_GDPIN(pin)) ? PIN_HIGH : PIN_LOW;
+}
+
+/**
+  * @brief  resolve a pin for the gd32_io operations
+  * @param  io, pin
+  * @retval RT_EOK or -RT_EINVAL
+  */
+rt_err_t gd32_io_init(struct gd32_io *io, rt_base_t pin)
+{
+    const struct pin_index *index;
+
+    if ((rt_ubase_t)pin >= ITEM_NUM(pins) || (index = get_pin(pin)) == RT_NULL)
     {
-        return value;
+        return -RT_EINVAL;
     }
 
-    value = gpio_input_bit_get(index->gpio_periph, index->pin);
-    return value;
+    io->port = index->gpio_periph;
+    io->mask = index->pin;
+
+    return RT_EOK;
 }
 
 /**
@@ -617,12 +632,31 @@ static rt_err_t gd32_pin_irq_enable(struct rt_device *device, rt_base_t pin, rt_
     }
     else if (enabled == PIN_IRQ_DISABLE)
     {
+        rt_uint32_t lines = 0;
+        int i;
+
         irqmap = get_pin_irq_map(index->pin);
         if (irqmap == RT_NULL)
         {
             return -RT_EINVAL;
         }
-        nvic_irq_disable(irqmap->irqno);
+
+        /* the lines 5 to 9 and 10 to 15 share a vector, it stays on for the other lines */
+        for (i = 0; i < ITEM_NUM(pin_irq_map); i++)
+        {
+            if (pin_irq_map[i].irqno == irqmap->irqno)
+            {
+                lines |= pin_irq_map[i].pinbit;
+            }
+        }
+
+        level = rt_hw_interrupt_disable();
+        exti_interrupt_disable((exti_line_enum)(index->pin));
+        if ((EXTI_INTEN & lines) == 0)
+        {
+            nvic_irq_disable(irqmap->irqno);
+        }
+        rt_hw_interrupt_enable(level);
     }
     else
     {
@@ -656,6 +690,27 @@ rt_inline void pin_irq_hdr(int irqno)
     }
 }
 
+/**
+  * @brief  call the handlers of the pending lines of a vector
+  * @param  lines
+  * @retval None
+  */
+static RT_SECTION_FASTCODE void gd32_exti_dispatch(rt_uint32_t lines)
+{
+    rt_uint32_t pending = EXTI_PD & EXTI_INTEN & lines;
+    rt_uint32_t line;
+
+    while (pending)
+    {
+        line = 31 - __CLZ(pending);
+        pending &= ~(1UL << line);
+
+        /* cleared before the handler, an edge during the handler pends the line again */
+        EXTI_PD = 1UL << line;
+        pin_irq_hdr(line);
+    }
+}
+
 /**
   * @brief  gd32 exit interrupt
   * @param  exti_line
@@ -663,71 +718,145 @@ rt_inline void pin_irq_hdr(int irqno)
   */
 void GD32_GPIO_EXTI_IRQHandler(rt_int8_t exti_line)
 {
-    if(RESET != exti_interrupt_flag_get((exti_line_enum)(1 << exti_line)))
-    {
-        pin_irq_hdr(exti_line);
-        exti_interrupt_flag_clear((exti_line_enum)(1 << exti_line));
-    }
+    gd32_exti_dispatch(1UL << exti_line);
 }
 
-void EXTI0_IRQHandler(void)
+RT_SECTION_FASTCODE void EXTI0_IRQHandler(void)
 {
     rt_interrupt_enter();
-    GD32_GPIO_EXTI_IRQHandler(0);
+    gd32_exti_dispatch(EXTI_PD_PD0);
     rt_interrupt_leave();
 }
 
-void EXTI1_IRQHandler(void)
+RT_SECTION_FASTCODE void EXTI1_IRQHandler(void)
 {
     rt_interrupt_enter();
-    GD32_GPIO_EXTI_IRQHandler(1);
+    gd32_exti_dispatch(EXTI_PD_PD1);
     rt_interrupt_leave();
 }
 
-void EXTI2_IRQHandler(void)
+RT_SECTION_FASTCODE void EXTI2_IRQHandler(void)
 {
     rt_interrupt_enter();
-    GD32_GPIO_EXTI_IRQHandler(2);
+    gd32_exti_dispatch(EXTI_PD_PD2);
     rt_interrupt_leave();
 }
 
-void EXTI3_IRQHandler(void)
+RT_SECTION_FASTCODE void EXTI3_IRQHandler(void)
 {
     rt_interrupt_enter();
-    GD32_GPIO_EXTI_IRQHandler(3);
+    gd32_exti_dispatch(EXTI_PD_PD3);
     rt_interrupt_leave();
 }
 
-void EXTI4_IRQHandler(void)
+RT_SECTION_FASTCODE void EXTI4_IRQHandler(void)
 {
     rt_interrupt_enter();
-    GD32_GPIO_EXTI_IRQHandler(4);
+    gd32_exti_dispatch(EXTI_PD_PD4);
     rt_interrupt_leave();
 }
 
-void EXTI5_9_IRQHandler(void)
+RT_SECTION_FASTCODE void EXTI5_9_IRQHandler(void)
 {
     rt_interrupt_enter();
-    GD32_GPIO_EXTI_IRQHandler(5);
-    GD32_GPIO_EXTI_IRQHandler(6);
-    GD32_GPIO_EXTI_IRQHandler(7);
-    GD32_GPIO_EXTI_IRQHandler(8);
-    GD32_GPIO_EXTI_IRQHandler(9);
+    gd32_exti_dispatch(EXTI_PD_PD5 | EXTI_PD_PD6 | EXTI_PD_PD7 | EXTI_PD_PD8 | EXTI_PD_PD9);
     rt_interrupt_leave();
 }
 
-void EXTI10_15_IRQHandler(void)
+RT_SECTION_FASTCODE void EXTI10_15_IRQHandler(void)
 {
     rt_interrupt_enter();
-    GD32_GPIO_EXTI_IRQHandler(10);
-    GD32_GPIO_EXTI_IRQHandler(11);
-    GD32_GPIO_EXTI_IRQHandler(12);
-    GD32_GPIO_EXTI_IRQHandler(13);
-    GD32_GPIO_EXTI_IRQHandler(14);
-    GD32_GPIO_EXTI_IRQHandler(15);
+    gd32_exti_dispatch(EXTI_PD_PD10 | EXTI_PD_PD11 | EXTI_PD_PD12 |
+                       EXTI_PD_PD13 | EXTI_PD_PD14 | EXTI_PD_PD15);
     rt_interrupt_leave();
 }
 
+static volatile rt_uint32_t latency_cycle;
+static volatile rt_uint8_t latency_fired;
+
+static void gd32_pin_latency_hdr(void *args)
+{
+    latency_cycle = get_cpu_tick();
+    latency_fired = 1;
+}
+
+/**
+  * @brief  measure the latency from an edge to its handler
+  * @param  out, in, count, latency
+  * @retval RT_EOK or the error of the irq attach
+  */
+rt_err_t gd32_pin_latency(rt_base_t out, rt_base_t in, rt_uint32_t count, struct gd32_pin_latency *latency)
+{
+    struct gd32_io io;
+    rt_uint64_t sum = 0;
+    rt_uint32_t start, cycles, timeout;
+    rt_err_t result;
+
+    if (count == 0 || latency == RT_NULL || gd32_io_init(&io, out) != RT_EOK)
+    {
+        return -RT_EINVAL;
+    }
+
+    rt_pin_mode(out, PIN_MODE_OUTPUT);
+    rt_pin_mode(in, PIN_MODE_INPUT_PULLDOWN);
+    gd32_io_low(&io);
+
+    result = rt_pin_attach_irq(in, PIN_IRQ_MODE_RISING, gd32_pin_latency_hdr, RT_NULL);
+    if (result != RT_EOK)
+    {
+        return result;
+    }
+    result = rt_pin_irq_enable(in, PIN_IRQ_ENABLE);
+    if (result != RT_EOK)
+    {
+        rt_pin_detach_irq(in);
+        return result;
+    }
+
+    rt_memset(latency, 0, sizeof(*latency));
+    latency->min = RT_UINT32_MAX;
+    timeout = SystemCoreClock / 1000;
+
+    while (count--)
+    {
+        latency_fired = 0;
+        start = get_cpu_tick();
+        gd32_io_high(&io);
+
+        while (!latency_fired && get_cpu_tick() - start < timeout);
+
+        if (latency_fired)
+        {
+            cycles = latency_cycle - start;
+            sum += cycles;
+            latency->count ++;
+            if (cycles < latency->min) latency->min = cycles;
+            if (cycles > latency->max) latency->max = cycles;
+        }
+        else
+        {
+            latency->lost ++;
+        }
+
+        gd32_io_low(&io);
+        rt_thread_mdelay(1);
+    }
+
+    rt_pin_irq_enable(in, PIN_IRQ_DISABLE);
+    rt_pin_detach_irq(in);
+
+    if (latency->count)
+    {
+        latency->avg = (rt_uint32_t)(sum / latency->count);
+    }
+    else
+    {
+        latency->min = 0;
+    }
+
+    return RT_EOK;
+}
+
 int rt_hw_pin_init(void)
 {
     int result;
@@ -737,4 +866,43 @@ int rt_hw_pin_init(void)
     return result;
 }
 
+#ifdef FINSH_USING_MSH
+#include <stdlib.h>
+
+static int pin_latency (int argc, char **argv)
+{
+    struct gd32_pin_latency latency;
+    rt_base_t out, in;
+    rt_uint32_t mhz = SystemCoreClock / 1000000;
+    rt_err_t result;
+
+    if (argc < 3)
+    {
+        rt_kprintf("Usage: pin_latency <out> <in> [count], the two pins wired together, e.g. pin_latency PA.1 PA.2\n");
+        return -RT_EINVAL;
+    }
+
+    out = gd32_pin_get(argv[1]);
+    in = gd32_pin_get(argv[2]);
+    if (out < 0 || in < 0)
+    {
+        return -RT_EINVAL;
+    }
+
+    result = gd32_pin_latency(out, in, (argc > 3) ? atoi(argv[3]) : 1000, &latency);
+    if (result != RT_EOK)
+    {
+        rt_kprintf("the latency measure failed: %d\n", result);
+        return result;
+    }
+
+    rt_kprintf("edges: %u, lost: %u\n", latency.count, latency.lost);
+    rt_kprintf("edge to handler: min %u, avg %u, max %u cycles (avg %u ns)\n",
+                latency.min, latency.avg, latency.max, latency.avg * 1000 / mhz);
+
+    return RT_EOK;
+}
+MSH_CMD_EXPORT(pin_latency, measure the latency from a pin edge to its handler: pin_latency <out> <in> [count]);
+#endif /* FINSH_USING_MSH */
+
 #endif
@@ -0,0 +1,526 @@
+/*
+ * Copyright (c) 2006-2024 RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-22     Evlers       first version
+ */
+
+#include <board.h>
+#include <rthw.h>
+#include <rtdevice.h>
+
+#ifdef BSP_USING_LCD
+
+#include "drv_lcd.h"
+#include "drv_sdram.h"
+
+//#define DRV_DEBUG
+#define LOG_TAG             "drv.lcd"
+#include <drv_log.h>
+
+#ifndef BSP_LCD_WIDTH
+#define BSP_LCD_WIDTH           480
+#endif
+#ifndef BSP_LCD_HEIGHT
+#define BSP_LCD_HEIGHT          272
+#endif
+#ifndef BSP_LCD_HSYNC_WIDTH
+#define BSP_LCD_HSYNC_WIDTH     41
+#endif
+#ifndef BSP_LCD_HBP
+#define BSP_LCD_HBP             2
+#endif
+#ifndef BSP_LCD_HFP
+#define BSP_LCD_HFP             2
+#endif
+#ifndef BSP_LCD_VSYNC_WIDTH
+#define BSP_LCD_VSYNC_WIDTH     10
+#endif
+#ifndef BSP_LCD_VBP
+#define BSP_LCD_VBP             2
+#endif
+#ifndef BSP_LCD_VFP
+#define BSP_LCD_VFP             2
+#endif
+#ifndef BSP_LCD_PIXEL_CLOCK
+#define BSP_LCD_PIXEL_CLOCK     8000
+#endif
+#ifndef BSP_LCD_BACKLIGHT_PIN_NAME
+#define BSP_LCD_BACKLIGHT_PIN_NAME  ""
+#endif
+
+#ifdef BSP_LCD_PIXEL_FORMAT_ARGB8888
+#define LCD_LAYER_PPF           LAYER_PPF_ARGB8888
+#define LCD_PIXEL_FORMAT        RTGRAPHIC_PIXEL_FORMAT_ARGB888
+#define LCD_BITS_PER_PIXEL      32
+#else
+#define LCD_LAYER_PPF           LAYER_PPF_RGB565
+#define LCD_PIXEL_FORMAT        RTGRAPHIC_PIXEL_FORMAT_RGB565
+#define LCD_BITS_PER_PIXEL      16
+#endif /* BSP_LCD_PIXEL_FORMAT_ARGB8888 */
+
+#ifdef BSP_LCD_USING_DOUBLE_BUFFER
+#define LCD_FB_COUNT            2
+#else
+#define LCD_FB_COUNT            1
+#endif
+
+#define LCD_PITCH               (BSP_LCD_WIDTH * LCD_BITS_PER_PIXEL / 8)
+#define LCD_FB_SIZE             (LCD_PITCH * BSP_LCD_HEIGHT)
+
+struct gd32_lcd
+{
+    struct rt_device parent;
+    struct rt_device_graphic_info info;
+
+    rt_uint8_t *fb[LCD_FB_COUNT];
+    rt_uint8_t *volatile shown;         /* the frame buffer the TLI scans out */
+    rt_uint8_t *volatile pending;       /* the frame buffer shown from the next blank on */
+    struct rt_semaphore flip_sem;
+
+    lcd_flip_done_t flip_done;
+    void *flip_done_arg;
+
+    rt_base_t backlight_pin;
+    struct lcd_stats stats;
+};
+
+static struct gd32_lcd _lcd;
+
+/**
+ * @brief TLI MSP Initialization
+ *        This function configures the hardware resources used in this example:
+ *           - Peripheral's GPIO Configuration
+ *        The pins are the RGB565 wiring of the GD32F4xx evaluation boards.
+ *        This function belongs to weak function, users can rewrite this function according to different needs
+ *
+ * @return None
+ */
+rt_weak void gd32_msp_tli_init (void)
+{
+    rcu_periph_clock_enable(RCU_GPIOA);
+    rcu_periph_clock_enable(RCU_GPIOB);
+    rcu_periph_clock_enable(RCU_GPIOC);
+    rcu_periph_clock_enable(RCU_GPIOD);
+    rcu_periph_clock_enable(RCU_GPIOF);
+    rcu_periph_clock_enable(RCU_GPIOG);
+
+    /* HSYNC(PC6), VSYNC(PA4), PCLK(PG7), DE(PF10) */
+    /* R7(PG6), R6(PA8), R5(PA12), R4(PA11), R3(PB0) */
+    /* G7(PD3), G6(PC7), G5(PB11), G4(PB10), G3(PG10), G2(PA6) */
+    /* B7(PB9), B6(PB8), B5(PA3), B4(PG12), B3(PG11) */
+    gpio_af_set(GPIOA, GPIO_AF_14, GPIO_PIN_3 | GPIO_PIN_4 | GPIO_PIN_6 | GPIO_PIN_8 | GPIO_PIN_11 | GPIO_PIN_12);
+    gpio_mode_set(GPIOA, GPIO_MODE_AF, GPIO_PUPD_NONE, GPIO_PIN_3 | GPIO_PIN_4 | GPIO_PIN_6 | GPIO_PIN_8 | GPIO_PIN_11 | GPIO_PIN_12);
+    gpio_output_options_set(GPIOA, GPIO_OTYPE_PP, GPIO_OSPEED_50MHZ, GPIO_PIN_3 | GPIO_PIN_4 | GPIO_PIN_6 | GPIO_PIN_8 | GPIO_PIN_11 | GPIO_PIN_12);
+
+    gpio_af_set(GPIOB, GPIO_AF_9, GPIO_PIN_0);
+    gpio_af_set(GPIOB, GPIO_AF_14, GPIO_PIN_8 | GPIO_PIN_9 | GPIO_PIN_10 | GPIO_PIN_11);
+    gpio_mode_set(GPIOB, GPIO_MODE_AF, GPIO_PUPD_NONE, GPIO_PIN_0 | GPIO_PIN_8 | GPIO_PIN_9 | GPIO_PIN_10 | GPIO_PIN_11);
+    gpio_output_options_set(GPIOB, GPIO_OTYPE_PP, GPIO_OSPEED_50MHZ, GPIO_PIN_0 | GPIO_PIN_8 | GPIO_PIN_9 | GPIO_PIN_10 | GPIO_PIN_11);
+
+    gpio_af_set(GPIOC, GPIO_AF_14, GPIO_PIN_6 | GPIO_PIN_7);
+    gpio_mode_set(GPIOC, GPIO_MODE_AF, GPIO_PUPD_NONE, GPIO_PIN_6 | GPIO_PIN_7);
+    gpio_output_options_set(GPIOC, GPIO_OTYPE_PP, GPIO_OSPEED_50MHZ, GPIO_PIN_6 | GPIO_PIN_7);
+
+    gpio_af_set(GPIOD, GPIO_AF_14, GPIO_PIN_3);
+    gpio_mode_set(GPIOD, GPIO_MODE_AF, GPIO_PUPD_NONE, GPIO_PIN_3);
+    gpio_output_options_set(GPIOD, GPIO_OTYPE_PP, GPIO_OSPEED_50MHZ, GPIO_PIN_3);
+
+    gpio_af_set(GPIOF, GPIO_AF_14, GPIO_PIN_10);
+    gpio_mode_set(GPIOF, GPIO_MODE_AF, GPIO_PUPD_NONE, GPIO_PIN_10);
+    gpio_output_options_set(GPIOF, GPIO_OTYPE_PP, GPIO_OSPEED_50MHZ, GPIO_PIN_10);
+
+    gpio_af_set(GPIOG, GPIO_AF_9, GPIO_PIN_10 | GPIO_PIN_12);
+    gpio_af_set(GPIOG, GPIO_AF_14, GPIO_PIN_6 | GPIO_PIN_7 | GPIO_PIN_11);
+    gpio_mode_set(GPIOG, GPIO_MODE_AF, GPIO_PUPD_NONE, GPIO_PIN_6 | GPIO_PIN_7 | GPIO_PIN_10 | GPIO_PIN_11 | GPIO_PIN_12);
+    gpio_output_options_set(GPIOG, GPIO_OTYPE_PP, GPIO_OSPEED_50MHZ, GPIO_PIN_6 | GPIO_PIN_7 | GPIO_PIN_10 | GPIO_PIN_11 | GPIO_PIN_12);
+}
+
+/* the pixel clock is CK_PLLSAIR divided by 2 to 16, the search takes the closest one */
+static rt_err_t lcd_pixel_clock_config (rt_uint32_t khz)
+{
+    static const rt_uint32_t div_cfg[] = { RCU_PLLSAIR_DIV2, RCU_PLLSAIR_DIV4, RCU_PLLSAIR_DIV8, RCU_PLLSAIR_DIV16 };
+    rt_uint32_t best_n = 0, best_r = 0, best_div = 0, best_err = ~0U;
+    rt_uint32_t src, in_khz, n, r, d, out, err;
+
+    src = (RCU_PLL & RCU_PLL_PLLSEL) ? HXTAL_VALUE : IRC16M_VALUE;
+    in_khz = src / 1000 / (RCU_PLL & RCU_PLL_PLLPSC);
+
+    for (d = 0; d < sizeof(div_cfg) / sizeof(div_cfg[0]); d ++)
+    {
+        for (r = RCU_PLLSAIR_DIV_MIN; r <= RCU_PLLSAIR_DIV_MAX; r ++)
+        {
+            n = (khz * r * (2U << d) + in_khz / 2) / in_khz;
+            if (n < RCU_PLLSAIN_MUL_MIN || n > RCU_PLLSAIN_MUL_MAX)
+            {
+                continue;
+            }
+
+            out = in_khz * n / r / (2U << d);
+            err = (out > khz) ? (out - khz) : (khz - out);
+            if (err < best_err)
+            {
+                best_err = err;
+                best_n = n;
+                best_r = r;
+                best_div = d;
+            }
+        }
+    }
+
+    if (best_n == 0)
+    {
+        LOG_E("no PLLSAI setting for a %d kHz pixel clock", khz);
+        return -RT_EINVAL;
+    }
+
+    rcu_osci_off(RCU_PLLSAI_CK);
+    rcu_pllsai_config(best_n, 2, best_r);
+    rcu_tli_clock_div_config(div_cfg[best_div]);
+    rcu_osci_on(RCU_PLLSAI_CK);
+    if (rcu_osci_stab_wait(RCU_PLLSAI_CK) == ERROR)
+    {
+        LOG_E("the PLLSAI does not lock");
+        return -RT_ETIMEOUT;
+    }
+
+    LOG_D("pixel clock %d kHz (N %d, R %d, div %d)", in_khz * best_n / best_r / (2U << best_div),
+          best_n, best_r, 2U << best_div);
+
+    return RT_EOK;
+}
+
+static void lcd_backlight (rt_bool_t on)
+{
+#ifdef RT_USING_PIN
+    if (_lcd.backlight_pin >= 0)
+    {
+#ifdef BSP_LCD_BACKLIGHT_ACTIVE_LOW
+        rt_pin_write(_lcd.backlight_pin, on ? PIN_LOW : PIN_HIGH);
+#else
+        rt_pin_write(_lcd.backlight_pin, on ? PIN_HIGH : PIN_LOW);
+#endif
+    }
+#endif /* RT_USING_PIN */
+}
+
+void *lcd_framebuffer_get (int index)
+{
+    if (index < 0 || index >= LCD_FB_COUNT)
+    {
+        return RT_NULL;
+    }
+    return _lcd.fb[index];
+}
+
+int lcd_framebuffer_count (void)
+{
+    return LCD_FB_COUNT;
+}
+
+rt_err_t lcd_flip (void *framebuffer)
+{
+    rt_base_t level;
+
+    if (framebuffer == RT_NULL)
+    {
+        return -RT_EINVAL;
+    }
+
+    level = rt_hw_interrupt_disable();
+    if (_lcd.pending != RT_NULL)
+    {
+        _lcd.stats.replaced ++;
+    }
+    /* the address goes first, a reload before the request still shows a whole frame */
+    TLI_LxFBADDR(LAYER0) = (rt_uint32_t)framebuffer;
+    _lcd.pending = framebuffer;
+    tli_reload_config(TLI_FRAME_BLANK_RELOAD_EN);
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+
+rt_bool_t lcd_flip_pending (void)
+{
+    return _lcd.pending != RT_NULL;
+}
+
+rt_err_t lcd_flip_wait (rt_int32_t timeout)
+{
+    if (_lcd.pending == RT_NULL)
+    {
+        return RT_EOK;
+    }
+
+    _lcd.stats.waits ++;
+
+    /* the semaphore may hold the counts of the flips nobody waited for */
+    while (_lcd.pending != RT_NULL)
+    {
+        if (rt_sem_take(&_lcd.flip_sem, timeout) != RT_EOK)
+        {
+            return -RT_ETIMEOUT;
+        }
+    }
+
+    return RT_EOK;
+}
+
+void lcd_flip_done_set (lcd_flip_done_t done, void *arg)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+    _lcd.flip_done = done;
+    _lcd.flip_done_arg = arg;
+    rt_hw_interrupt_enable(level);
+}
+
+void lcd_stats_get (struct lcd_stats *stats)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+    *stats = _lcd.stats;
+    rt_hw_interrupt_enable(level);
+}
+
+void TLI_IRQHandler (void)
+{
+    rt_uint8_t *shown;
+
+    rt_interrupt_enter();
+
+    if (tli_interrupt_flag_get(TLI_INT_FLAG_LCR) == SET)
+    {
+        tli_interrupt_flag_clear(TLI_INT_FLAG_LCR);
+
+        /* a request still set belongs to a flip queued after this reload */
+        shown = _lcd.pending;
+        if (shown != RT_NULL && (TLI_RL & TLI_RL_FBR) == 0)
+        {
+            _lcd.shown = shown;
+            _lcd.pending = RT_NULL;
+            _lcd.stats.flips ++;
+            rt_sem_release(&_lcd.flip_sem);
+
+            if (_lcd.flip_done != RT_NULL)
+            {
+                _lcd.flip_done(shown, _lcd.flip_done_arg);
+            }
+        }
+    }
+
+    rt_interrupt_leave();
+}
+
+void TLI_ER_IRQHandler (void)
+{
+    rt_interrupt_enter();
+
+    if (tli_interrupt_flag_get(TLI_INT_FLAG_FE) == SET)
+    {
+        tli_interrupt_flag_clear(TLI_INT_FLAG_FE);
+        _lcd.stats.fifo_errors ++;
+    }
+    if (tli_interrupt_flag_get(TLI_INT_FLAG_TE) == SET)
+    {
+        tli_interrupt_flag_clear(TLI_INT_FLAG_TE);
+        _lcd.stats.bus_errors ++;
+    }
+
+    rt_interrupt_leave();
+}
+
+static rt_err_t _lcd_control (rt_device_t device, int cmd, void *args)
+{
+    switch (cmd)
+    {
+    case RTGRAPHIC_CTRL_GET_INFO:
+        RT_ASSERT(args != RT_NULL);
+        /* the clients of the device draw into the shown buffer */
+        _lcd.info.framebuffer = _lcd.shown;
+        rt_memcpy(args, &_lcd.info, sizeof(_lcd.info));
+        break;
+
+    case RTGRAPHIC_CTRL_RECT_UPDATE:
+        /* the TLI scans the frame buffer, there is nothing to copy */
+        break;
+
+    case RTGRAPHIC_CTRL_POWERON:
+        tli_enable();
+        lcd_backlight(RT_TRUE);
+        break;
+
+    case RTGRAPHIC_CTRL_POWEROFF:
+        lcd_backlight(RT_FALSE);
+        tli_disable();
+        break;
+
+#ifdef RTGRAPHIC_CTRL_PAN_DISPLAY
+    case RTGRAPHIC_CTRL_PAN_DISPLAY:
+        return lcd_flip(args);
+#endif
+
+#ifdef RTGRAPHIC_CTRL_WAIT_VSYNC
+    case RTGRAPHIC_CTRL_WAIT_VSYNC:
+        return lcd_flip_wait(RT_TICK_PER_SECOND / 10);
+#endif
+
+    default:
+        return -RT_EINVAL;
+    }
+
+    return RT_EOK;
+}
+
+#ifdef RT_USING_DEVICE_OPS
+static const struct rt_device_ops _lcd_ops =
+{
+    RT_NULL,
+    RT_NULL,
+    RT_NULL,
+    RT_NULL,
+    RT_NULL,
+    _lcd_control
+};
+#endif
+
+static int rt_hw_lcd_init (void)
+{
+    tli_parameter_struct tli_init_struct;
+    tli_layer_parameter_struct layer_init_struct;
+    int i;
+
+    for (i = 0; i < LCD_FB_COUNT; i ++)
+    {
+        _lcd.fb[i] = sdram_framebuffer_alloc(LCD_FB_SIZE);
+        if (_lcd.fb[i] == RT_NULL)
+        {
+            LOG_E("no memory for the frame buffers (%d x %d bytes)", LCD_FB_COUNT, LCD_FB_SIZE);
+            return -RT_ENOMEM;
+        }
+        rt_memset(_lcd.fb[i], 0, LCD_FB_SIZE);
+    }
+    _lcd.shown = _lcd.fb[0];
+    _lcd.pending = RT_NULL;
+    rt_sem_init(&_lcd.flip_sem, "lcd", 0, RT_IPC_FLAG_PRIO);
+
+    _lcd.backlight_pin = -1;
+#ifdef RT_USING_PIN
+    if (rt_strlen(BSP_LCD_BACKLIGHT_PIN_NAME) > 0)
+    {
+        _lcd.backlight_pin = rt_pin_get(BSP_LCD_BACKLIGHT_PIN_NAME);
+        if (_lcd.backlight_pin >= 0)
+        {
+            rt_pin_mode(_lcd.backlight_pin, PIN_MODE_OUTPUT);
+            lcd_backlight(RT_FALSE);
+        }
+    }
+#endif /* RT_USING_PIN */
+
+    gd32_msp_tli_init();
+
+    if (lcd_pixel_clock_config(BSP_LCD_PIXEL_CLOCK) != RT_EOK)
+    {
+        return -RT_ERROR;
+    }
+
+    rcu_periph_clock_enable(RCU_TLI);
+    tli_deinit();
+
+    /* the registers hold the accumulated widths minus one */
+    tli_struct_para_init(&tli_init_struct);
+    tli_init_struct.signalpolarity_hs = TLI_HSYN_ACTLIVE_LOW;
+    tli_init_struct.signalpolarity_vs = TLI_VSYN_ACTLIVE_LOW;
+    tli_init_struct.signalpolarity_de = TLI_DE_ACTLIVE_LOW;
+    tli_init_struct.signalpolarity_pixelck = TLI_PIXEL_CLOCK_TLI;
+    tli_init_struct.synpsz_hpsz = BSP_LCD_HSYNC_WIDTH - 1;
+    tli_init_struct.synpsz_vpsz = BSP_LCD_VSYNC_WIDTH - 1;
+    tli_init_struct.backpsz_hbpsz = BSP_LCD_HSYNC_WIDTH + BSP_LCD_HBP - 1;
+    tli_init_struct.backpsz_vbpsz = BSP_LCD_VSYNC_WIDTH + BSP_LCD_VBP - 1;
+    tli_init_struct.activesz_hasz = BSP_LCD_HSYNC_WIDTH + BSP_LCD_HBP + BSP_LCD_WIDTH - 1;
+    tli_init_struct.activesz_vasz = BSP_LCD_VSYNC_WIDTH + BSP_LCD_VBP + BSP_LCD_HEIGHT - 1;
+    tli_init_struct.totalsz_htsz = BSP_LCD_HSYNC_WIDTH + BSP_LCD_HBP + BSP_LCD_WIDTH + BSP_LCD_HFP - 1;
+    tli_init_struct.totalsz_vtsz = BSP_LCD_VSYNC_WIDTH + BSP_LCD_VBP + BSP_LCD_HEIGHT + BSP_LCD_VFP - 1;
+    tli_init_struct.backcolor_red = 0;
+    tli_init_struct.backcolor_green = 0;
+    tli_init_struct.backcolor_blue = 0;
+    tli_init(&tli_init_struct);
+
+    tli_layer_struct_para_init(&layer_init_struct);
+    layer_init_struct.layer_window_leftpos = BSP_LCD_HSYNC_WIDTH + BSP_LCD_HBP;
+    layer_init_struct.layer_window_rightpos = BSP_LCD_HSYNC_WIDTH + BSP_LCD_HBP + BSP_LCD_WIDTH - 1;
+    layer_init_struct.layer_window_toppos = BSP_LCD_VSYNC_WIDTH + BSP_LCD_VBP;
+    layer_init_struct.layer_window_bottompos = BSP_LCD_VSYNC_WIDTH + BSP_LCD_VBP + BSP_LCD_HEIGHT - 1;
+    layer_init_struct.layer_ppf = LCD_LAYER_PPF;
+    layer_init_struct.layer_sa = 0xFF;
+    layer_init_struct.layer_default_alpha = 0;
+    layer_init_struct.layer_default_red = 0;
+    layer_init_struct.layer_default_green = 0;
+    layer_init_struct.layer_default_blue = 0;
+    layer_init_struct.layer_acf1 = LAYER_ACF1_PASA;
+    layer_init_struct.layer_acf2 = LAYER_ACF2_PASA;
+    layer_init_struct.layer_frame_bufaddr = (rt_uint32_t)_lcd.shown;
+    layer_init_struct.layer_frame_line_length = LCD_PITCH + 3;
+    layer_init_struct.layer_frame_buf_stride_offset = LCD_PITCH;
+    layer_init_struct.layer_frame_total_line_number = BSP_LCD_HEIGHT;
+    tli_layer_init(LAYER0, &layer_init_struct);
+    tli_layer_enable(LAYER0);
+    tli_reload_config(TLI_REQUEST_RELOAD_EN);
+
+    tli_interrupt_flag_clear(TLI_INT_FLAG_LCR | TLI_INT_FLAG_FE | TLI_INT_FLAG_TE);
+    tli_interrupt_enable(TLI_INT_LCR | TLI_INT_FE | TLI_INT_TE);
+    nvic_irq_enable(TLI_IRQn, 2, 0);
+    nvic_irq_enable(TLI_ER_IRQn, 2, 0);
+
+    tli_enable();
+    lcd_backlight(RT_TRUE);
+
+    _lcd.info.pixel_format = LCD_PIXEL_FORMAT;
+    _lcd.info.bits_per_pixel = LCD_BITS_PER_PIXEL;
+    _lcd.info.pitch = LCD_PITCH;
+    _lcd.info.width = BSP_LCD_WIDTH;
+    _lcd.info.height = BSP_LCD_HEIGHT;
+    _lcd.info.framebuffer = _lcd.shown;
+
+    _lcd.parent.type = RT_Device_Class_Graphic;
+#ifdef RT_USING_DEVICE_OPS
+    _lcd.parent.ops = &_lcd_ops;
+#else
+    _lcd.parent.control = _lcd_control;
+#endif
+    _lcd.parent.user_data = &_lcd;
+    rt_device_register(&_lcd.parent, LCD_DEVICE_NAME, RT_DEVICE_FLAG_RDWR);
+
+    LOG_I("%dx%d %d bpp, %d frame buffers at 0x%08X", BSP_LCD_WIDTH, BSP_LCD_HEIGHT,
+          LCD_BITS_PER_PIXEL, LCD_FB_COUNT, (rt_uint32_t)_lcd.fb[0]);
+
+    return RT_EOK;
+}
+INIT_DEVICE_EXPORT(rt_hw_lcd_init);
+
+#ifdef FINSH_USING_MSH
+static int lcd (int argc, char **argv)
+{
+    struct lcd_stats stats;
+    rt_uint32_t htotal, vtotal;
+
+    lcd_stats_get(&stats);
+    htotal = BSP_LCD_HSYNC_WIDTH + BSP_LCD_HBP + BSP_LCD_WIDTH + BSP_LCD_HFP;
+    vtotal = BSP_LCD_VSYNC_WIDTH + BSP_LCD_VBP + BSP_LCD_HEIGHT + BSP_LCD_VFP;
+
+    rt_kprintf("mode      : %dx%d %d bpp, %d frame buffers\n", BSP_LCD_WIDTH, BSP_LCD_HEIGHT,
+               LCD_BITS_PER_PIXEL, LCD_FB_COUNT);
+    rt_kprintf("refresh   : %d.%d Hz\n", BSP_LCD_PIXEL_CLOCK * 1000 / (htotal * vtotal),
+               BSP_LCD_PIXEL_CLOCK * 10000 / (htotal * vtotal) % 10);
+    rt_kprintf("shown     : 0x%08X%s\n", (rt_uint32_t)_lcd.shown, _lcd.pending ? " (flip pending)" : "");
+    rt_kprintf("flips     : %u (%u replaced, %u waited)\n", stats.flips, stats.replaced, stats.waits);
+    rt_kprintf("errors    : %u FIFO underruns, %u bus errors\n", stats.fifo_errors, stats.bus_errors);
+
+    return 0;
+}
+MSH_CMD_EXPORT(lcd, show the state of the lcd);
+#endif /* FINSH_USING_MSH */
+
+#endif /* BSP_USING_LCD */
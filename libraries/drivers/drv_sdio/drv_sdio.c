@@ -11,6 +11,7 @@
  * 2024-03-21       Evlers          add msp layer supports
  * 2024-06-28       Evlers          fix wild pointer in clk_get
  * 2024-07-14       Evlers          fix an error caused by persistent set of the SDIO_STAT_RXRUN flag
+ * 2024-10-19       Evlers          add profiler probes
  */
 
 #include <rthw.h>
@@ -24,6 +25,7 @@
 #include "drv_sdio_crc.h"
 #include "drv_dma.h"
 #include "drv_config.h"
+#include "profiler.h"
 
 /**
  * When the WiFi module is hibernating,
@@ -63,6 +65,8 @@ struct rthw_sdio
 rt_align(SDIO_ALIGN)
 static rt_uint8_t cache_buf[SDIO_BUFF_SIZE];
 
+PROF_DEFINE(sdio_request);
+
 static rt_uint32_t gd32_sdio_clk_get(uint32_t hw_sdio)
 {
     return sdio_config.sdio_clock_freq;
@@ -411,6 +415,8 @@ static void rthw_sdio_request(struct rt_mmcsd_host *host, struct rt_mmcsd_req *r
 
     RTHW_SDIO_LOCK(sdio);
 
+    PROF_BEGIN(sdio_request);
+
     if (req->cmd != RT_NULL)
     {
         memset(&pkg, 0, sizeof(pkg));
@@ -465,6 +471,8 @@ static void rthw_sdio_request(struct rt_mmcsd_host *host, struct rt_mmcsd_req *r
         rthw_sdio_send_command(sdio, &pkg);
     }
 
+    PROF_END(sdio_request);
+
     RTHW_SDIO_UNLOCK(sdio);
 
     mmcsd_req_complete(sdio->host);
@@ -7,12 +7,14 @@
  * Date           Author       Notes
  * 2018-12-04     zylx         first version
  * 2023-08-20     yuanzihao    adapter gd32f4xx
+ * 2024-10-28     Evlers       add the frame buffer allocator
  */
 
 #include <board.h>
 
 #ifdef BSP_USING_SDRAM
 #include <sdram_port.h>
+#include "drv_sdram.h"
 
 #define DRV_DEBUG
 #define LOG_TAG             "drv.sdram"
@@ -24,6 +26,7 @@ static exmc_sdram_timing_parameter_struct  sdram_timing_init_struct;
 #ifdef RT_USING_MEMHEAP_AS_HEAP
 static struct rt_memheap system_heap;
 #endif
+static rt_bool_t sdram_init_ok = RT_FALSE;
 
 
 static void SDRAM_Initialization_GPIO(void)
@@ -257,12 +260,32 @@ static int SDRAM_Init(void)
         /* If RT_USING_MEMHEAP_AS_HEAP is enabled, SDRAM is initialized to the heap */
         rt_memheap_init(&system_heap, "sdram", (void *)SDRAM_BANK_ADDR, SDRAM_SIZE);
 #endif
+        sdram_init_ok = RT_TRUE;
     }
 
     return result;
 }
 INIT_BOARD_EXPORT(SDRAM_Init);
 
+/* the frame buffers of the LCD and the DCI, the TLI, the IPA and the DCI share its bandwidth with the CPU */
+void *sdram_framebuffer_alloc(rt_size_t size)
+{
+#ifdef RT_USING_MEMHEAP_AS_HEAP
+    return sdram_init_ok ? rt_memheap_alloc(&system_heap, size) : RT_NULL;
+#else
+    /* the SDRAM is not a heap, take it from its start */
+    static rt_uint32_t next = SDRAM_BANK_ADDR;
+    void *fb = RT_NULL;
+
+    if (sdram_init_ok && next + size <= SDRAM_BANK_ADDR + SDRAM_SIZE)
+    {
+        fb = (void *)next;
+        next += RT_ALIGN(size, 32);
+    }
+    return fb;
+#endif /* RT_USING_MEMHEAP_AS_HEAP */
+}
+
 #ifdef DRV_DEBUG
 #ifdef FINSH_USING_MSH
 int sdram_test(void)
@@ -13,10 +13,12 @@
  * 2024-03-21     Evlers       add msp layer supports
  * 2024-06-04     Evlers       use the new cs pin specification
  * 2024-06-05     Evlers       fix an issue where unknown data was received when dma rx was used only
+ * 2024-10-19     Evlers       add profiler probes
  */
 
 #include "drv_spi.h"
 #include "drv_config.h"
+#include "profiler.h"
 
 #ifdef RT_USING_SPI
 
@@ -68,6 +70,8 @@ static const struct gd32_spi_config spi_config[] = {
 
 static struct gd32_spi spi_bus_obj[sizeof(spi_config) / sizeof(spi_config[0])] = { 0 };
 
+PROF_DEFINE(spi_xfer);
+
 #if defined(BSP_SPI0_RX_USING_DMA) || \
     defined(BSP_SPI1_RX_USING_DMA) || \
     defined(BSP_SPI2_RX_USING_DMA) || \
@@ -667,6 +671,8 @@ static rt_ssize_t spixfer (struct rt_spi_device* device, struct rt_spi_message*
     RT_ASSERT(device != NULL);
     RT_ASSERT(message != NULL);
 
+    PROF_BEGIN(spi_xfer);
+
     /* take CS */
     if(message->cs_take)
     {
@@ -718,6 +724,8 @@ static rt_ssize_t spixfer (struct rt_spi_device* device, struct rt_spi_message*
         LOG_D("spi release cs\n");
     }
 
+    PROF_END(spi_xfer);
+
     return message->length;
 };
 
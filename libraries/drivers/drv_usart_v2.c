@@ -9,6 +9,7 @@
  * 2024-03-20   Evlers      add driver configure
  * 2024-03-21   Evlers      add msp layer supports
  * 2024-06-08   Evlers      fixed an exception caused by nested calls to dma_recv_isr functions by interrupt
+ * 2024-10-19   Evlers      run the interrupt service from sram
  */
 
 #include "drv_usart_v2.h"
@@ -123,7 +124,7 @@ static void dma_recv_isr (struct rt_serial_device *serial)
 }
 #endif
 
-static void usart_isr (struct rt_serial_device *serial)
+static RT_SECTION_FASTCODE void usart_isr (struct rt_serial_device *serial)
 {
     struct gd32_uart *uart;
 
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2006-2024 RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-19     Evlers       first version
+ * 2024-10-20     Evlers       add the DMA FIFO copy
+ */
+
+#include <board.h>
+#include <rthw.h>
+
+#if defined(BSP_USING_USBD) || defined(BSP_USING_USBH)
+#include "drv_usb_common.h"
+#include "delay.h"
+
+#ifdef BSP_USB_FIFO_USING_DMA
+#include "drv_dma.h"
+#include "drv_config.h"
+
+static const struct dma_config fifo_dma = USB_FIFO_DMA_CONFIG;
+#endif
+
+/* the hooks required by the GD32F4xx USB library */
+void usb_udelay(const uint32_t usec)
+{
+    delay_us(usec);
+}
+
+void usb_mdelay(const uint32_t msec)
+{
+    if (rt_thread_self() != RT_NULL && rt_interrupt_get_nest() == 0)
+    {
+        rt_thread_mdelay(msec);
+    }
+    else
+    {
+        delay_ms(msec);
+    }
+}
+
+#ifdef BSP_USB_FIFO_USING_DMA
+static void fifo_dma_init(void)
+{
+    dma_multi_data_parameter_struct dma_struct;
+
+    rcu_periph_clock_enable(fifo_dma.rcu);
+    dma_deinit(fifo_dma.periph, fifo_dma.channel);
+
+    /* the FIFO takes any address of its 4KB window, so both sides increase */
+    dma_multi_data_para_struct_init(&dma_struct);
+    dma_struct.direction          = DMA_MEMORY_TO_MEMORY;
+    dma_struct.periph_inc         = DMA_PERIPH_INCREASE_ENABLE;
+    dma_struct.memory_inc         = DMA_MEMORY_INCREASE_ENABLE;
+    dma_struct.periph_width       = DMA_PERIPH_WIDTH_32BIT;
+    dma_struct.memory_width       = DMA_MEMORY_WIDTH_32BIT;
+    dma_struct.periph_burst_width = DMA_PERIPH_BURST_SINGLE;
+    dma_struct.memory_burst_width = DMA_MEMORY_BURST_SINGLE;
+    dma_struct.critical_value     = DMA_FIFO_4_WORD;
+    dma_struct.circular_mode      = DMA_CIRCULAR_MODE_DISABLE;
+    dma_struct.priority           = DMA_PRIORITY_ULTRA_HIGH;
+    dma_multi_data_mode_init(fifo_dma.periph, fifo_dma.channel, &dma_struct);
+}
+
+/* the hook of drv_usb_core.c, the memory to memory source is the peripheral address */
+uint32_t usb_fifo_dma_copy(uint32_t fifo, uint32_t buf, uint32_t word_count, uint8_t to_fifo)
+{
+    rt_base_t level;
+    uint32_t remain;
+
+    /* the DMA can not reach the TCM SRAM */
+    if (word_count == 0 || (buf & 0xFFFF0000) == 0x10000000)
+    {
+        return 0;
+    }
+
+    /* the interrupt and the host thread may both copy packets */
+    level = rt_hw_interrupt_disable();
+
+    dma_flag_clear(fifo_dma.periph, fifo_dma.channel, DMA_FLAG_FEE);
+    dma_flag_clear(fifo_dma.periph, fifo_dma.channel, DMA_FLAG_SDE);
+    dma_flag_clear(fifo_dma.periph, fifo_dma.channel, DMA_FLAG_TAE);
+    dma_flag_clear(fifo_dma.periph, fifo_dma.channel, DMA_FLAG_HTF);
+    dma_flag_clear(fifo_dma.periph, fifo_dma.channel, DMA_FLAG_FTF);
+
+    dma_periph_address_config(fifo_dma.periph, fifo_dma.channel, to_fifo ? buf : fifo);
+    dma_memory_address_config(fifo_dma.periph, fifo_dma.channel, DMA_MEMORY_0, to_fifo ? fifo : buf);
+    dma_transfer_number_config(fifo_dma.periph, fifo_dma.channel, word_count);
+    dma_channel_enable(fifo_dma.periph, fifo_dma.channel);
+
+    while (dma_flag_get(fifo_dma.periph, fifo_dma.channel, DMA_FLAG_FTF) == RESET &&
+           dma_flag_get(fifo_dma.periph, fifo_dma.channel, DMA_FLAG_TAE) == RESET);
+
+    /* after an error the CPU copies what is left */
+    dma_channel_disable(fifo_dma.periph, fifo_dma.channel);
+    remain = dma_transfer_number_get(fifo_dma.periph, fifo_dma.channel);
+
+    rt_hw_interrupt_enable(level);
+
+    return word_count - remain;
+}
+#endif /* BSP_USB_FIFO_USING_DMA */
+
+void gd32_usb_hw_init(enum gd32_usb_core core, enum gd32_usb_phy phy)
+{
+#ifdef BSP_USB_FIFO_USING_DMA
+    fifo_dma_init();
+#endif
+
+    /* CK48M from PLLQ, the main PLL runs at 480MHz and PLL_Q is 10 */
+    rcu_pll48m_clock_config(RCU_PLL48MSRC_PLLQ);
+    rcu_ck48m_clock_config(RCU_CK48MSRC_PLL48M);
+
+    if (core == GD32_USB_CORE_FS)
+    {
+        /* DM(PA11), DP(PA12) */
+        rcu_periph_clock_enable(RCU_GPIOA);
+        gpio_af_set(GPIOA, GPIO_AF_10, GPIO_PIN_11 | GPIO_PIN_12);
+        gpio_mode_set(GPIOA, GPIO_MODE_AF, GPIO_PUPD_NONE, GPIO_PIN_11 | GPIO_PIN_12);
+        gpio_output_options_set(GPIOA, GPIO_OTYPE_PP, GPIO_OSPEED_MAX, GPIO_PIN_11 | GPIO_PIN_12);
+
+        rcu_periph_clock_enable(RCU_USBFS);
+    }
+    else if (phy == GD32_USB_PHY_EMBEDDED)
+    {
+        /* DM(PB14), DP(PB15) */
+        rcu_periph_clock_enable(RCU_GPIOB);
+        gpio_af_set(GPIOB, GPIO_AF_12, GPIO_PIN_14 | GPIO_PIN_15);
+        gpio_mode_set(GPIOB, GPIO_MODE_AF, GPIO_PUPD_NONE, GPIO_PIN_14 | GPIO_PIN_15);
+        gpio_output_options_set(GPIOB, GPIO_OTYPE_PP, GPIO_OSPEED_MAX, GPIO_PIN_14 | GPIO_PIN_15);
+
+        rcu_periph_clock_enable(RCU_USBHS);
+    }
+    else
+    {
+        rcu_periph_clock_enable(RCU_GPIOA);
+        rcu_periph_clock_enable(RCU_GPIOB);
+        rcu_periph_clock_enable(RCU_GPIOC);
+
+        /* D0(PA3), CK(PA5) */
+        gpio_af_set(GPIOA, GPIO_AF_10, GPIO_PIN_3 | GPIO_PIN_5);
+        gpio_mode_set(GPIOA, GPIO_MODE_AF, GPIO_PUPD_NONE, GPIO_PIN_3 | GPIO_PIN_5);
+        gpio_output_options_set(GPIOA, GPIO_OTYPE_PP, GPIO_OSPEED_MAX, GPIO_PIN_3 | GPIO_PIN_5);
+
+        /* D1(PB0), D2(PB1), D7(PB5), D3(PB10), D4(PB11), D5(PB12), D6(PB13) */
+        gpio_af_set(GPIOB, GPIO_AF_10, GPIO_PIN_0 | GPIO_PIN_1 | GPIO_PIN_5 |
+                    GPIO_PIN_10 | GPIO_PIN_11 | GPIO_PIN_12 | GPIO_PIN_13);
+        gpio_mode_set(GPIOB, GPIO_MODE_AF, GPIO_PUPD_NONE, GPIO_PIN_0 | GPIO_PIN_1 | GPIO_PIN_5 |
+                      GPIO_PIN_10 | GPIO_PIN_11 | GPIO_PIN_12 | GPIO_PIN_13);
+        gpio_output_options_set(GPIOB, GPIO_OTYPE_PP, GPIO_OSPEED_MAX, GPIO_PIN_0 | GPIO_PIN_1 | GPIO_PIN_5 |
+                                GPIO_PIN_10 | GPIO_PIN_11 | GPIO_PIN_12 | GPIO_PIN_13);
+
+        /* STP(PC0), DIR(PC2), NXT(PC3) */
+        gpio_af_set(GPIOC, GPIO_AF_10, GPIO_PIN_0 | GPIO_PIN_2 | GPIO_PIN_3);
+        gpio_mode_set(GPIOC, GPIO_MODE_AF, GPIO_PUPD_NONE, GPIO_PIN_0 | GPIO_PIN_2 | GPIO_PIN_3);
+        gpio_output_options_set(GPIOC, GPIO_OTYPE_PP, GPIO_OSPEED_MAX, GPIO_PIN_0 | GPIO_PIN_2 | GPIO_PIN_3);
+
+        rcu_periph_clock_enable(RCU_USBHS);
+        rcu_periph_clock_enable(RCU_USBHSULPI);
+    }
+}
+
+#endif /* BSP_USING_USBD || BSP_USING_USBH */
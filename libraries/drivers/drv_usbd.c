@@ -0,0 +1,653 @@
+/*
+ * Copyright (c) 2006-2024 RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-19     Evlers       first version
+ * 2024-10-20     Evlers       add a profiler probe to the interrupt
+ */
+
+#include <rtconfig.h>
+
+#ifdef BSP_USING_USBD
+/* the GD USB headers go first, usb_common.h redefines some of their names as macros */
+#include "drv_usbd_int.h"
+#include "usbd_transc.h"
+#undef USB_CLASS_HID
+#undef USB_CLASS_MSC
+
+#include <board.h>
+#include <rthw.h>
+#include <rtdevice.h>
+#include "drv_usb_common.h"
+#include "profiler.h"
+
+//#define DRV_DEBUG
+#define LOG_TAG             "drv.usbd"
+#include <drv_log.h>
+
+#ifdef BSP_USBD_TYPE_HS
+#define USBD_CORE           USB_CORE_ENUM_HS
+#define USBD_EP_COUNT       USBHS_MAX_EP_COUNT
+#define USBD_FIFO_WORDS     USBHS_MAX_FIFO_WORDLEN
+#define USBD_RX_FIFO_WORDS  RX_FIFO_HS_SIZE
+#define USBD_EP0_FIFO_WORDS TX0_FIFO_HS_SIZE
+#define USBD_IRQn           USBHS_IRQn
+#define USBD_IRQHandler     USBHS_IRQHandler
+#else
+#define USBD_CORE           USB_CORE_ENUM_FS
+#define USBD_EP_COUNT       USBFS_MAX_EP_COUNT
+#define USBD_FIFO_WORDS     USBFS_MAX_FIFO_WORDLEN
+#define USBD_RX_FIFO_WORDS  RX_FIFO_FS_SIZE
+#define USBD_EP0_FIFO_WORDS TX0_FIFO_FS_SIZE
+#define USBD_IRQn           USBFS_IRQn
+#define USBD_IRQHandler     USBFS_IRQHandler
+#endif /* BSP_USBD_TYPE_HS */
+
+#ifndef BSP_USBD_TX_FIFO_PACKETS
+#define BSP_USBD_TX_FIFO_PACKETS    2
+#endif
+
+#define EP0_MAX_PACKET      64
+
+/* the DMA needs word aligned buffers and can not reach the TCM SRAM */
+#define USBD_DMA_CAPABLE(addr)  ((((rt_uint32_t)(addr) & 0x3) == 0) && \
+                                 (((rt_uint32_t)(addr) & 0xFFFF0000) != 0x10000000))
+
+enum usbd_ep0_stage
+{
+    USBD_EP0_SETUP = 0,                 /* only SETUP packets are expected */
+    USBD_EP0_DATA_OUT,
+    USBD_EP0_STATUS_OUT,
+    USBD_EP0_STATUS_IN,
+};
+
+struct gd32_usbd_ep
+{
+    rt_uint8_t *buffer;                 /* buffer of the transfer, given by the udcd core */
+    rt_uint32_t size;                   /* length of the transfer */
+    rt_uint8_t *bounce;                 /* DMA buffer of the transfers that can not be done in place */
+    rt_uint16_t bounce_size;
+    rt_uint16_t fifo_size;              /* TX FIFO words of an IN endpoint */
+};
+
+struct gd32_usbd
+{
+    usb_core_driver core;
+    struct udcd udc;
+    rt_uint8_t ep0_stage;
+    rt_uint16_t fifo_top;               /* first free word of the FIFO RAM */
+    struct gd32_usbd_ep ep_in[USBD_EP_COUNT];
+    struct gd32_usbd_ep ep_out[USBD_EP_COUNT];
+};
+
+static struct gd32_usbd _usbd;
+
+/* the GD interrupt handler calls the SOF and isochronous hooks of the class core, they stay empty */
+static usb_class_core _class_core;
+
+/* EP0 data is always copied, the udcd core may pass a buffer on the stack of its thread */
+rt_align(4) static rt_uint8_t _ep0_in_buffer[EP0_MAX_PACKET];
+/* the DMA stores up to 3 back-to-back SETUP packets behind the data of a control OUT */
+rt_align(4) static rt_uint8_t _ep0_out_buffer[EP0_MAX_PACKET + 3 * 8];
+
+static struct ep_id _ep_pool[] =
+{
+    {0x0,  USB_EP_ATTR_CONTROL,     USB_DIR_INOUT,  EP0_MAX_PACKET,         ID_ASSIGNED  },
+    {0x1,  USB_EP_ATTR_BULK,        USB_DIR_IN,     USBD_DATA_MAX_PACKET,   ID_UNASSIGNED},
+    {0x1,  USB_EP_ATTR_BULK,        USB_DIR_OUT,    USBD_DATA_MAX_PACKET,   ID_UNASSIGNED},
+    {0x2,  USB_EP_ATTR_INT,         USB_DIR_IN,     64,                     ID_UNASSIGNED},
+    {0x2,  USB_EP_ATTR_INT,         USB_DIR_OUT,    64,                     ID_UNASSIGNED},
+    {0x3,  USB_EP_ATTR_BULK,        USB_DIR_IN,     USBD_DATA_MAX_PACKET,   ID_UNASSIGNED},
+    {0x3,  USB_EP_ATTR_BULK,        USB_DIR_OUT,    USBD_DATA_MAX_PACKET,   ID_UNASSIGNED},
+#ifdef BSP_USBD_TYPE_HS
+    {0x4,  USB_EP_ATTR_INT,         USB_DIR_IN,     64,                     ID_UNASSIGNED},
+    {0x4,  USB_EP_ATTR_INT,         USB_DIR_OUT,    64,                     ID_UNASSIGNED},
+    {0x5,  USB_EP_ATTR_ISOC,        USB_DIR_IN,     USBD_DATA_MAX_PACKET,   ID_UNASSIGNED},
+    {0x5,  USB_EP_ATTR_ISOC,        USB_DIR_OUT,    USBD_DATA_MAX_PACKET,   ID_UNASSIGNED},
+#endif
+    {0xFF, USB_EP_ATTR_TYPE_MASK,   USB_DIR_MASK,   0,                      ID_ASSIGNED  },
+};
+
+rt_inline usb_transc *_transc(rt_uint8_t address)
+{
+    rt_uint8_t num = address & 0x7F;
+    return (address & USB_DIR_IN) ? &_usbd.core.dev.transc_in[num] : &_usbd.core.dev.transc_out[num];
+}
+
+rt_inline struct gd32_usbd_ep *_uep(rt_uint8_t address)
+{
+    rt_uint8_t num = address & 0x7F;
+    return (address & USB_DIR_IN) ? &_usbd.ep_in[num] : &_usbd.ep_out[num];
+}
+
+rt_inline rt_bool_t _use_dma(void)
+{
+    return _usbd.core.bp.transfer_mode == (uint8_t)USB_USE_DMA;
+}
+
+/* arm EP0 OUT for the next SETUP packets */
+static void _ep0_setup_prepare(void)
+{
+    usb_core_regs *regs = &_usbd.core.regs;
+
+    _usbd.ep0_stage = USBD_EP0_SETUP;
+    regs->er_out[0]->DOEPLEN = DOEP0_TLEN(8U * 3U) | DOEP0_PCNT(1U) | DOEP0_STPCNT(3U);
+    if (_use_dma())
+    {
+        regs->er_out[0]->DOEPDMAADDR = (rt_uint32_t)_ep0_out_buffer;
+        regs->er_out[0]->DOEPCTL |= DEPCTL_EPACT | DEPCTL_EPEN;
+    }
+}
+
+/*
+ * The TX FIFOs of the data IN endpoints are allocated above the RX FIFO and
+ * the EP0 TX FIFO in the order the endpoints are enabled, so an allocation
+ * never moves the FIFO of an endpoint that is already running. They are
+ * released on bus reset, when the host configures the device again.
+ */
+static void _fifo_reset(void)
+{
+    usb_core_regs *regs = &_usbd.core.regs;
+    int i;
+
+    regs->gr->GRFLEN = USBD_RX_FIFO_WORDS;
+    regs->gr->DIEP0TFLEN_HNPTFLEN = ((rt_uint32_t)USBD_EP0_FIFO_WORDS << 16) | USBD_RX_FIFO_WORDS;
+    _usbd.fifo_top = USBD_RX_FIFO_WORDS + USBD_EP0_FIFO_WORDS;
+
+    for (i = 1; i < USBD_EP_COUNT; i++)
+    {
+        regs->gr->DIEPTFLEN[i - 1] = _usbd.fifo_top;
+        _usbd.ep_in[i].fifo_size = 0;
+    }
+}
+
+/* bulk and isochronous endpoints buffer BSP_USBD_TX_FIFO_PACKETS packets, interrupt endpoints one */
+static rt_err_t _fifo_alloc(rt_uint8_t num, rt_uint8_t type, rt_uint16_t max_packet)
+{
+    usb_core_regs *regs = &_usbd.core.regs;
+    struct gd32_usbd_ep *uep = &_usbd.ep_in[num];
+    rt_uint16_t words = (max_packet + 3) / 4;
+    rt_uint16_t size, free;
+    rt_base_t level;
+
+    if (words < 16)
+    {
+        words = 16;
+    }
+    size = words;
+    if (type == USB_EP_ATTR_BULK || type == USB_EP_ATTR_ISOC)
+    {
+        size = words * BSP_USBD_TX_FIFO_PACKETS;
+    }
+
+    level = rt_hw_interrupt_disable();
+    if (uep->fifo_size >= words)
+    {
+        /* enabled again with a FIFO that still holds a packet */
+        rt_hw_interrupt_enable(level);
+        return RT_EOK;
+    }
+    free = USBD_FIFO_WORDS - _usbd.fifo_top;
+    if (size > free)
+    {
+        size = (free / words) * words;
+    }
+    if (size == 0)
+    {
+        rt_hw_interrupt_enable(level);
+        LOG_E("no FIFO RAM for IN endpoint %d, %d words needed", num, words);
+        return -RT_ENOMEM;
+    }
+    regs->gr->DIEPTFLEN[num - 1] = ((rt_uint32_t)size << 16) | _usbd.fifo_top;
+    _usbd.fifo_top += size;
+    uep->fifo_size = size;
+    rt_hw_interrupt_enable(level);
+
+    usb_txfifo_flush(regs, num);
+    LOG_D("IN endpoint %d: TX FIFO %d words", num, size);
+
+    return RT_EOK;
+}
+
+static void _fifo_free(rt_uint8_t num)
+{
+    usb_core_regs *regs = &_usbd.core.regs;
+    struct gd32_usbd_ep *uep = &_usbd.ep_in[num];
+    rt_uint16_t start = regs->gr->DIEPTFLEN[num - 1] & DIEPTFLEN_IEPTXRSAR;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    /* only the last allocation returns to the free RAM, the others wait for the bus reset */
+    if (uep->fifo_size && start + uep->fifo_size == _usbd.fifo_top)
+    {
+        _usbd.fifo_top = start;
+        uep->fifo_size = 0;
+    }
+    rt_hw_interrupt_enable(level);
+}
+
+static rt_err_t _set_address(rt_uint8_t address)
+{
+    usb_devaddr_set(&_usbd.core, address);
+    return RT_EOK;
+}
+
+static rt_err_t _set_config(rt_uint8_t address)
+{
+    return RT_EOK;
+}
+
+static rt_err_t _ep_set_stall(rt_uint8_t address)
+{
+    usb_transc_stall(&_usbd.core, _transc(address));
+    if ((address & 0x7F) == 0)
+    {
+        /* the next SETUP packet clears the stall of EP0 */
+        _ep0_setup_prepare();
+    }
+    return RT_EOK;
+}
+
+static rt_err_t _ep_clear_stall(rt_uint8_t address)
+{
+    usb_transc_clrstall(&_usbd.core, _transc(address));
+    return RT_EOK;
+}
+
+static rt_err_t _ep_enable(uep_t ep)
+{
+    rt_uint8_t address, num, type;
+    rt_uint16_t max_packet, bounce_size;
+    struct gd32_usbd_ep *uep;
+    usb_transc *transc;
+
+    RT_ASSERT(ep != RT_NULL);
+    RT_ASSERT(ep->ep_desc != RT_NULL);
+
+    address = EP_ADDRESS(ep);
+    num = address & 0x7F;
+    type = ep->ep_desc->bmAttributes & USB_EP_ATTR_TYPE_MASK;
+    max_packet = EP_MAXPACKET(ep) & 0x7FF;
+    if (num == 0 || num >= USBD_EP_COUNT)
+    {
+        return -RT_EINVAL;
+    }
+
+    if ((address & USB_DIR_IN) && _fifo_alloc(num, type, max_packet) != RT_EOK)
+    {
+        return -RT_ENOMEM;
+    }
+
+    uep = _uep(address);
+    bounce_size = RT_ALIGN(max_packet, 4);
+    if (_use_dma() && uep->bounce_size < bounce_size)
+    {
+        rt_free(uep->bounce);
+        uep->bounce = rt_malloc(bounce_size);
+        uep->bounce_size = uep->bounce ? bounce_size : 0;
+        if (uep->bounce == RT_NULL)
+        {
+            LOG_E("no memory for the DMA buffer of endpoint 0x%02x", address);
+            return -RT_ENOMEM;
+        }
+    }
+
+    transc = _transc(address);
+    transc->ep_addr.num = num;
+    transc->ep_addr.dir = (address & USB_DIR_IN) ? 1U : 0U;
+    transc->ep_type = type;
+    transc->ep_stall = 0U;
+    transc->max_len = max_packet;
+    usb_transc_active(&_usbd.core, transc);
+
+    return RT_EOK;
+}
+
+static rt_err_t _ep_disable(uep_t ep)
+{
+    usb_core_regs *regs = &_usbd.core.regs;
+    rt_uint8_t address, num;
+    struct gd32_usbd_ep *uep;
+
+    RT_ASSERT(ep != RT_NULL);
+    RT_ASSERT(ep->ep_desc != RT_NULL);
+
+    address = EP_ADDRESS(ep);
+    num = address & 0x7F;
+    if (num == 0 || num >= USBD_EP_COUNT)
+    {
+        return -RT_EINVAL;
+    }
+
+    if (address & USB_DIR_IN)
+    {
+        if (regs->er_in[num]->DIEPCTL & DEPCTL_EPEN)
+        {
+            regs->er_in[num]->DIEPCTL |= DEPCTL_EPD | DEPCTL_SNAK;
+        }
+        usb_txfifo_flush(regs, num);
+        _fifo_free(num);
+    }
+    else
+    {
+        regs->er_out[num]->DOEPCTL |= DEPCTL_SNAK;
+    }
+    usb_transc_deactivate(&_usbd.core, _transc(address));
+
+    uep = _uep(address);
+    rt_free(uep->bounce);
+    uep->bounce = RT_NULL;
+    uep->bounce_size = 0;
+
+    return RT_EOK;
+}
+
+static rt_ssize_t _ep_read_prepare(rt_uint8_t address, void *buffer, rt_size_t size)
+{
+    rt_uint8_t num = address & 0x7F;
+    usb_transc *transc = &_usbd.core.dev.transc_out[num];
+    struct gd32_usbd_ep *uep = &_usbd.ep_out[num];
+    rt_uint8_t *data = buffer;
+    rt_base_t level;
+
+    if (num == 0)
+    {
+        size = RT_MIN(size, EP0_MAX_PACKET);
+        data = _ep0_out_buffer;
+        _usbd.ep0_stage = size ? USBD_EP0_DATA_OUT : USBD_EP0_STATUS_OUT;
+    }
+    else if (_use_dma() && (!USBD_DMA_CAPABLE(buffer) || (size % transc->max_len)))
+    {
+        /* the DMA writes whole packets, a short buffer would be overrun */
+        size = RT_MIN(size, uep->bounce_size);
+        data = uep->bounce;
+    }
+
+    uep->buffer = buffer;
+    uep->size = size;
+    transc->xfer_buf = data;
+    transc->xfer_len = size;
+    transc->xfer_count = 0U;
+    transc->dma_addr = (rt_uint32_t)data;
+
+    level = rt_hw_interrupt_disable();
+    usb_transc_outxfer(&_usbd.core, transc);
+    rt_hw_interrupt_enable(level);
+
+    return size;
+}
+
+static rt_ssize_t _ep_read(rt_uint8_t address, void *buffer)
+{
+    /* the data is already in the buffer given to _ep_read_prepare */
+    return 0;
+}
+
+static rt_ssize_t _ep_write(rt_uint8_t address, void *buffer, rt_size_t size)
+{
+    rt_uint8_t num = address & 0x7F;
+    usb_transc *transc = &_usbd.core.dev.transc_in[num];
+    struct gd32_usbd_ep *uep = &_usbd.ep_in[num];
+    rt_uint8_t *data = buffer;
+    rt_base_t level;
+
+    if (num == 0)
+    {
+        size = RT_MIN(size, EP0_MAX_PACKET);
+        if (size)
+        {
+            rt_memcpy(_ep0_in_buffer, buffer, size);
+        }
+        data = _ep0_in_buffer;
+    }
+    else if (size && _use_dma() && !USBD_DMA_CAPABLE(buffer))
+    {
+        size = RT_MIN(size, uep->bounce_size);
+        rt_memcpy(uep->bounce, buffer, size);
+        data = uep->bounce;
+    }
+
+    uep->buffer = buffer;
+    uep->size = size;
+    transc->xfer_buf = data;
+    transc->xfer_len = size;
+    transc->xfer_count = 0U;
+    transc->dma_addr = (rt_uint32_t)data;
+
+    level = rt_hw_interrupt_disable();
+    usb_transc_inxfer(&_usbd.core, transc);
+    rt_hw_interrupt_enable(level);
+
+    return size;
+}
+
+static rt_err_t _ep0_send_status(void)
+{
+    _usbd.ep0_stage = USBD_EP0_STATUS_IN;
+    _ep_write(0x80, RT_NULL, 0);
+    return RT_EOK;
+}
+
+static rt_err_t _suspend(void)
+{
+    return RT_EOK;
+}
+
+static rt_err_t _wakeup(void)
+{
+    return RT_EOK;
+}
+
+/* called by usbd_isr() when the SETUP stage of a control transfer is done */
+uint8_t usbd_setup_transc(usb_core_driver *udev)
+{
+    struct urequest *setup = (struct urequest *)&udev->dev.control.req;
+
+    if (_use_dma())
+    {
+        /* the DMA address is behind the last of the back-to-back SETUP packets */
+        rt_uint32_t addr = udev->regs.er_out[0]->DOEPDMAADDR;
+
+        setup = (struct urequest *)_ep0_out_buffer;
+        if (addr >= (rt_uint32_t)_ep0_out_buffer + 8 &&
+            addr <= (rt_uint32_t)_ep0_out_buffer + sizeof(_ep0_out_buffer))
+        {
+            setup = (struct urequest *)(addr - 8);
+        }
+    }
+
+    _usbd.ep0_stage = USBD_EP0_SETUP;
+    rt_usbd_ep0_setup_handler(&_usbd.udc, setup);
+
+    return (uint8_t)USBD_OK;
+}
+
+/* called by usbd_isr() when an OUT transfer is finished */
+uint8_t usbd_out_transc(usb_core_driver *udev, uint8_t ep_num)
+{
+    usb_transc *transc = &udev->dev.transc_out[ep_num];
+    struct gd32_usbd_ep *uep = &_usbd.ep_out[ep_num];
+    rt_uint32_t count = transc->xfer_count;
+
+    if (_use_dma())
+    {
+        /* usbd_isr() counts from one packet, a transfer may have several */
+        rt_uint32_t length = transc->max_len;
+
+        if (ep_num != 0 && uep->size != 0)
+        {
+            length = (uep->size + transc->max_len - 1) / transc->max_len * transc->max_len;
+        }
+        count = length - (udev->regs.er_out[ep_num]->DOEPLEN & DEPLEN_TLEN);
+    }
+    count = RT_MIN(count, uep->size);
+
+    if (ep_num == 0)
+    {
+        switch (_usbd.ep0_stage)
+        {
+        case USBD_EP0_DATA_OUT:
+            _usbd.ep0_stage = USBD_EP0_SETUP;
+            rt_memcpy(uep->buffer, _ep0_out_buffer, count);
+            rt_usbd_ep0_out_handler(&_usbd.udc, count);
+            break;
+        case USBD_EP0_STATUS_OUT:
+            _ep0_setup_prepare();
+            break;
+        default:
+            break;
+        }
+    }
+    else
+    {
+        if (transc->dma_addr != (rt_uint32_t)uep->buffer)
+        {
+            rt_memcpy(uep->buffer, uep->bounce, count);
+        }
+        rt_usbd_ep_out_handler(&_usbd.udc, ep_num, count);
+    }
+
+    return (uint8_t)USBD_OK;
+}
+
+/* called by usbd_isr() when an IN transfer is finished */
+uint8_t usbd_in_transc(usb_core_driver *udev, uint8_t ep_num)
+{
+    if (ep_num == 0)
+    {
+        if (_usbd.ep0_stage == USBD_EP0_STATUS_IN)
+        {
+            _ep0_setup_prepare();
+        }
+        else
+        {
+            rt_usbd_ep0_in_handler(&_usbd.udc);
+        }
+    }
+    else
+    {
+        rt_usbd_ep_in_handler(&_usbd.udc, ep_num | USB_DIR_IN, _usbd.ep_in[ep_num].size);
+    }
+
+    return (uint8_t)USBD_OK;
+}
+
+static void _bus_reset(void)
+{
+    usb_core_regs *regs = &_usbd.core.regs;
+    int i;
+
+    for (i = 1; i < USBD_EP_COUNT; i++)
+    {
+        if (regs->er_in[i]->DIEPCTL & DEPCTL_EPEN)
+        {
+            regs->er_in[i]->DIEPCTL |= DEPCTL_EPD | DEPCTL_SNAK;
+        }
+        regs->er_in[i]->DIEPCTL &= ~DEPCTL_EPACT;
+        regs->er_out[i]->DOEPCTL |= DEPCTL_SNAK;
+        regs->er_out[i]->DOEPCTL &= ~DEPCTL_EPACT;
+    }
+    _fifo_reset();
+    usb_txfifo_flush(regs, 0x10U);
+
+    /* usbd_isr() armed the SETUP reception into its own request buffer */
+    _ep0_setup_prepare();
+    rt_usbd_reset_handler(&_usbd.udc);
+}
+
+/* the service time of the interrupt, packets included, is shown by 'prof' */
+PROF_DEFINE(usbd_isr);
+
+void USBD_IRQHandler(void)
+{
+    usb_core_driver *udev = &_usbd.core;
+    rt_uint32_t intr;
+
+    rt_interrupt_enter();
+
+    PROF_BEGIN(usbd_isr);
+
+    intr = udev->regs.gr->GINTF & udev->regs.gr->GINTEN;
+    usbd_isr(udev);
+    if (intr & GINTF_RST)
+    {
+        _bus_reset();
+    }
+
+    PROF_END(usbd_isr);
+
+    rt_interrupt_leave();
+}
+
+static rt_err_t _init(rt_device_t device)
+{
+    usb_core_driver *udev = &_usbd.core;
+
+#if defined(BSP_USBD_TYPE_FS)
+    gd32_usb_hw_init(GD32_USB_CORE_FS, GD32_USB_PHY_EMBEDDED);
+#elif defined(BSP_USBD_PHY_ULPI)
+    gd32_usb_hw_init(GD32_USB_CORE_HS, GD32_USB_PHY_ULPI);
+#else
+    gd32_usb_hw_init(GD32_USB_CORE_HS, GD32_USB_PHY_EMBEDDED);
+#endif
+
+    udev->dev.class_core = &_class_core;
+    usb_basic_init(&udev->bp, &udev->regs, USBD_CORE);
+    usb_globalint_disable(&udev->regs);
+    usb_core_init(udev->bp, &udev->regs);
+    usb_dev_disconnect(udev);
+    usb_curmode_set(&udev->regs, DEVICE_MODE);
+    usb_devcore_init(udev);
+
+    /* the udcd core does not use SOF, it would interrupt every 125us at high speed */
+    udev->regs.gr->GINTEN &= ~GINTEN_SOFIE;
+    _fifo_reset();
+
+    nvic_irq_enable(USBD_IRQn, 2, 0);
+    usb_globalint_enable(&udev->regs);
+    usb_dev_connect(udev);
+
+    LOG_I("USB%s device, %s mode", (USBD_CORE == USB_CORE_ENUM_HS) ? "HS" : "FS", _use_dma() ? "DMA" : "FIFO");
+
+    return RT_EOK;
+}
+
+const static struct udcd_ops _udc_ops =
+{
+    _set_address,
+    _set_config,
+    _ep_set_stall,
+    _ep_clear_stall,
+    _ep_enable,
+    _ep_disable,
+    _ep_read_prepare,
+    _ep_read,
+    _ep_write,
+    _ep0_send_status,
+    _suspend,
+    _wakeup,
+};
+
+static int rt_hw_usbd_init(void)
+{
+    _usbd.udc.parent.type = RT_Device_Class_USBDevice;
+    _usbd.udc.parent.init = _init;
+    _usbd.udc.parent.user_data = &_usbd;
+    _usbd.udc.ops = &_udc_ops;
+    _usbd.udc.ep_pool = _ep_pool;
+    _usbd.udc.ep0.id = &_ep_pool[0];
+#ifdef BSP_USBD_SPEED_HS
+    _usbd.udc.device_is_hs = RT_TRUE;
+#endif
+
+    rt_device_register((rt_device_t)&_usbd.udc, "usbd", 0);
+    rt_usb_device_init();
+
+    return RT_EOK;
+}
+INIT_DEVICE_EXPORT(rt_hw_usbd_init);
+
+#endif /* BSP_USING_USBD */
@@ -0,0 +1,759 @@
+/*
+ * Copyright (c) 2006-2024 RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-21     Evlers       first version
+ */
+
+#include <rtconfig.h>
+
+#ifdef BSP_USING_USBH
+/* the GD USB headers go first, usb_common.h redefines some of their names as macros */
+#include "drv_usbh_int.h"
+#include "drv_usb_hw.h"
+#include "usbh_core.h"
+#include "usbh_msc_core.h"
+#undef USB_CLASS_HID
+#undef USB_CLASS_MSC
+
+#include <board.h>
+#include <rthw.h>
+#include <rtdevice.h>
+#include "drv_usb_common.h"
+#include "profiler.h"
+
+#ifdef RT_USING_DFS
+#include <dfs_fs.h>
+#endif
+#ifdef DFS_USING_POSIX
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+//#define DRV_DEBUG
+#define LOG_TAG             "drv.usbh"
+#include <drv_log.h>
+
+#ifdef BSP_USBH_TYPE_HS
+#define USBH_CORE           USB_CORE_ENUM_HS
+#define USBH_IRQn           USBHS_IRQn
+#define USBH_IRQHandler     USBHS_IRQHandler
+#else
+#define USBH_CORE           USB_CORE_ENUM_FS
+#define USBH_IRQn           USBFS_IRQn
+#define USBH_IRQHandler     USBFS_IRQHandler
+#endif /* BSP_USBH_TYPE_HS */
+
+#ifndef BSP_USBH_MSC_READ_AHEAD_SIZE
+#define BSP_USBH_MSC_READ_AHEAD_SIZE    32768
+#endif
+#ifndef BSP_USBH_MSC_MOUNT_POINT
+#define BSP_USBH_MSC_MOUNT_POINT        ""
+#endif
+
+#define USBH_DISK_NAME          "ud0"
+#define USBH_THREAD_STACK_SIZE  4096
+#define USBH_THREAD_PRIORITY    8
+
+/* the poll interval of the core thread while nothing is expected to change */
+#define USBH_IDLE_POLL_MS       100
+
+/* sectors of one READ(10) or WRITE(10), its transfer length field has 16 bits */
+#define USBH_MSC_MAX_SECTORS    0xFFFF
+
+#define USBH_EVENT_CORE         (1 << 0)    /* wakes the core thread */
+#define USBH_EVENT_XFER         (1 << 1)    /* wakes a disk read or write */
+
+/* the DMA needs word aligned buffers and can not reach the TCM SRAM */
+#define USBH_DMA_CAPABLE(addr)  ((((rt_uint32_t)(addr) & 0x3) == 0) && \
+                                 (((rt_uint32_t)(addr) & 0xFFFF0000) != 0x10000000))
+
+struct usbh_msc_disk
+{
+    struct rt_device parent;
+    rt_bool_t online;
+    rt_bool_t probed;                   /* the unit was looked at since the device came */
+    rt_uint32_t sector_size;
+    rt_uint32_t sector_count;
+
+    /* the read-ahead window, cache_count sectors from cache_start are valid */
+    rt_uint8_t *cache;
+    rt_uint32_t cache_sectors;
+    rt_uint32_t cache_start;
+    rt_uint32_t cache_count;
+    rt_uint32_t next_sector;            /* a read from here continues the last one */
+
+    /* statistics */
+    rt_uint64_t read_bytes;             /* from the device */
+    rt_uint64_t write_bytes;
+    rt_uint32_t commands;
+    rt_uint32_t cache_hits;             /* sectors copied from the window */
+    rt_uint32_t errors;
+};
+
+struct gd32_usbh
+{
+    usb_core_driver core;
+    usbh_host host;
+    struct rt_mutex lock;               /* serializes the core task and the disk accesses */
+    struct rt_event event;
+    rt_bool_t class_ready;              /* the MSC class finished the unit setup */
+    struct usbh_msc_disk disk;
+};
+
+static struct gd32_usbh _usbh;
+
+#ifdef BSP_USBH_USING_VBUS_PIN
+static rt_base_t _vbus_pin = -1;
+#endif
+
+rt_inline rt_bool_t _use_dma(void)
+{
+    return _usbh.core.bp.transfer_mode == (uint8_t)USB_USE_DMA;
+}
+
+rt_inline rt_bool_t _xfer_capable(const void *buffer)
+{
+    return !_use_dma() || USBH_DMA_CAPABLE(buffer);
+}
+
+/* the hooks of the GD32F4xx USB library for the VBUS switch */
+void usb_vbus_config(void)
+{
+#ifdef BSP_USBH_USING_VBUS_PIN
+    _vbus_pin = rt_pin_get(BSP_USBH_VBUS_PIN_NAME);
+    rt_pin_mode(_vbus_pin, PIN_MODE_OUTPUT);
+    usb_vbus_drive(0);
+#endif
+}
+
+void usb_vbus_drive(uint8_t state)
+{
+#ifdef BSP_USBH_USING_VBUS_PIN
+#ifdef BSP_USBH_VBUS_ACTIVE_LOW
+    state = !state;
+#endif
+    if (_vbus_pin >= 0)
+    {
+        rt_pin_write(_vbus_pin, state ? PIN_HIGH : PIN_LOW);
+    }
+#endif
+}
+
+/* the hook of usbh_msc_read() and usbh_msc_write(), sleeps while a transfer of the disk is in flight */
+void usbh_msc_rdwr_wait(struct _usbh_host *uhost)
+{
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->active_class->class_data;
+    rt_uint8_t pipe;
+    rt_uint32_t recved;
+
+    switch (msc->bbb.state)
+    {
+    case BBB_SEND_CBW_WAIT:
+    case BBB_DATA_OUT_WAIT:
+        pipe = msc->pipe_out;
+        break;
+    case BBB_DATA_IN_WAIT:
+    case BBB_RECEIVE_CSW_WAIT:
+        pipe = msc->pipe_in;
+        break;
+    default:
+        /* the next step starts a transfer or a control request, no need to wait */
+        return;
+    }
+
+    if (usbh_urbstate_get(&_usbh.core, pipe) == URB_IDLE)
+    {
+        /* the channel interrupt sets the event, a tick at most in case it was missed */
+        rt_event_recv(&_usbh.event, USBH_EVENT_XFER, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR, 1, &recved);
+    }
+}
+
+static rt_err_t _msc_read(struct usbh_msc_disk *disk, rt_uint32_t sector, rt_uint8_t *buffer, rt_uint32_t count)
+{
+    disk->commands ++;
+
+    if (usbh_msc_read(&_usbh.host, 0, sector, buffer, count) != USBH_OK)
+    {
+        disk->errors ++;
+        LOG_E("read of %d sectors at %d failed", count, sector);
+        return -RT_EIO;
+    }
+
+    disk->read_bytes += count * disk->sector_size;
+
+    return RT_EOK;
+}
+
+static rt_err_t _msc_write(struct usbh_msc_disk *disk, rt_uint32_t sector, rt_uint8_t *buffer, rt_uint32_t count)
+{
+    disk->commands ++;
+
+    if (usbh_msc_write(&_usbh.host, 0, sector, buffer, count) != USBH_OK)
+    {
+        disk->errors ++;
+        LOG_E("write of %d sectors at %d failed", count, sector);
+        return -RT_EIO;
+    }
+
+    disk->write_bytes += count * disk->sector_size;
+
+    return RT_EOK;
+}
+
+static rt_ssize_t _disk_read(rt_device_t device, rt_off_t pos, void *buffer, rt_size_t size)
+{
+    struct usbh_msc_disk *disk = (struct usbh_msc_disk *)device;
+    rt_uint8_t *buf = buffer;
+    rt_uint32_t sector = pos, count, offset;
+    rt_size_t done = 0;
+    rt_bool_t sequential;
+
+    rt_mutex_take(&_usbh.lock, RT_WAITING_FOREVER);
+
+    if (!disk->online || sector >= disk->sector_count)
+    {
+        rt_mutex_release(&_usbh.lock);
+        return 0;
+    }
+    size = RT_MIN(size, disk->sector_count - sector);
+    sequential = (sector == disk->next_sector);
+
+    while (done < size)
+    {
+        if (sector >= disk->cache_start && sector < disk->cache_start + disk->cache_count)
+        {
+            offset = sector - disk->cache_start;
+            count = RT_MIN(size - done, disk->cache_count - offset);
+            rt_memcpy(buf, disk->cache + offset * disk->sector_size, count * disk->sector_size);
+            disk->cache_hits += count;
+        }
+        else if (size - done >= disk->cache_sectors && _xfer_capable(buf))
+        {
+            /* a read of a whole window or more goes straight to the caller */
+            count = RT_MIN(size - done, USBH_MSC_MAX_SECTORS);
+            if (_msc_read(disk, sector, buf, count) != RT_EOK)
+            {
+                break;
+            }
+        }
+        else
+        {
+            /* a read that continues the last one fills the whole window, any other only what it asks for */
+            count = sequential ? disk->cache_sectors : RT_MIN(size - done, disk->cache_sectors);
+            count = RT_MIN(count, disk->sector_count - sector);
+
+            disk->cache_count = 0;
+            if (_msc_read(disk, sector, disk->cache, count) != RT_EOK)
+            {
+                break;
+            }
+            disk->cache_start = sector;
+            disk->cache_count = count;
+            continue;
+        }
+
+        sector += count;
+        buf += count * disk->sector_size;
+        done += count;
+    }
+
+    disk->next_sector = sector;
+
+    rt_mutex_release(&_usbh.lock);
+
+    return done;
+}
+
+static rt_ssize_t _disk_write(rt_device_t device, rt_off_t pos, const void *buffer, rt_size_t size)
+{
+    struct usbh_msc_disk *disk = (struct usbh_msc_disk *)device;
+    const rt_uint8_t *buf = buffer;
+    rt_uint32_t sector = pos, count;
+    rt_size_t done = 0;
+
+    rt_mutex_take(&_usbh.lock, RT_WAITING_FOREVER);
+
+    if (!disk->online || sector >= disk->sector_count)
+    {
+        rt_mutex_release(&_usbh.lock);
+        return 0;
+    }
+    size = RT_MIN(size, disk->sector_count - sector);
+
+    /* the writes go through, a window they overlap is dropped */
+    if (sector < disk->cache_start + disk->cache_count && sector + size > disk->cache_start)
+    {
+        disk->cache_count = 0;
+    }
+
+    while (done < size)
+    {
+        if (_xfer_capable(buf))
+        {
+            count = RT_MIN(size - done, USBH_MSC_MAX_SECTORS);
+            if (_msc_write(disk, sector, (rt_uint8_t *)buf, count) != RT_EOK)
+            {
+                break;
+            }
+        }
+        else
+        {
+            /* the window buffer bounces the data the DMA can not take */
+            count = RT_MIN(size - done, disk->cache_sectors);
+            disk->cache_count = 0;
+            rt_memcpy(disk->cache, buf, count * disk->sector_size);
+            if (_msc_write(disk, sector, disk->cache, count) != RT_EOK)
+            {
+                break;
+            }
+        }
+
+        sector += count;
+        buf += count * disk->sector_size;
+        done += count;
+    }
+
+    rt_mutex_release(&_usbh.lock);
+
+    return done;
+}
+
+static rt_err_t _disk_control(rt_device_t device, int cmd, void *args)
+{
+    struct usbh_msc_disk *disk = (struct usbh_msc_disk *)device;
+
+    if (cmd == RT_DEVICE_CTRL_BLK_GETGEOME)
+    {
+        struct rt_device_blk_geometry *geometry = args;
+
+        if (geometry == RT_NULL)
+        {
+            return -RT_ERROR;
+        }
+
+        geometry->bytes_per_sector = disk->sector_size;
+        geometry->block_size = disk->sector_size;
+        geometry->sector_count = disk->sector_count;
+    }
+
+    return RT_EOK;
+}
+
+#ifdef RT_USING_DEVICE_OPS
+const static struct rt_device_ops _disk_ops =
+{
+    RT_NULL,
+    RT_NULL,
+    RT_NULL,
+    _disk_read,
+    _disk_write,
+    _disk_control
+};
+#endif
+
+static void _disk_attach(void)
+{
+    struct usbh_msc_disk *disk = &_usbh.disk;
+    msc_lun info;
+
+    disk->probed = RT_TRUE;
+
+    rt_mutex_take(&_usbh.lock, RT_WAITING_FOREVER);
+
+    if (usbh_msc_lun_info_get(&_usbh.host, 0, &info) != USBH_OK || info.error != MSC_OK)
+    {
+        rt_mutex_release(&_usbh.lock);
+        LOG_W("the disk is not ready");
+        return;
+    }
+
+    if (info.capacity.block_size == 0 || info.capacity.block_size > BSP_USBH_MSC_READ_AHEAD_SIZE)
+    {
+        rt_mutex_release(&_usbh.lock);
+        LOG_E("unusable sector size %d", info.capacity.block_size);
+        return;
+    }
+
+    disk->sector_size = info.capacity.block_size;
+    disk->sector_count = info.capacity.block_nbr;
+    disk->cache_sectors = BSP_USBH_MSC_READ_AHEAD_SIZE / disk->sector_size;
+    disk->cache_count = 0;
+    disk->next_sector = 0;
+    disk->online = RT_TRUE;
+    rt_mutex_release(&_usbh.lock);
+
+#ifdef RT_USING_DEVICE_OPS
+    disk->parent.ops = &_disk_ops;
+#else
+    disk->parent.init = RT_NULL;
+    disk->parent.open = RT_NULL;
+    disk->parent.close = RT_NULL;
+    disk->parent.read = _disk_read;
+    disk->parent.write = _disk_write;
+    disk->parent.control = _disk_control;
+#endif
+    disk->parent.type = RT_Device_Class_Block;
+    disk->parent.user_data = &_usbh;
+    rt_device_register(&disk->parent, USBH_DISK_NAME, RT_DEVICE_FLAG_RDWR | RT_DEVICE_FLAG_REMOVABLE);
+
+    LOG_I("%s: %d sectors of %d bytes (%d MB)", USBH_DISK_NAME, disk->sector_count, disk->sector_size,
+          (rt_uint32_t)(((rt_uint64_t)disk->sector_count * disk->sector_size) >> 20));
+
+#ifdef RT_USING_DFS
+    if (BSP_USBH_MSC_MOUNT_POINT[0] != '\0')
+    {
+        if (dfs_mount(USBH_DISK_NAME, BSP_USBH_MSC_MOUNT_POINT, "elm", 0, 0) == RT_EOK)
+        {
+            LOG_I("%s mount to '%s'", USBH_DISK_NAME, BSP_USBH_MSC_MOUNT_POINT);
+        }
+        else
+        {
+            LOG_W("%s mount to '%s' failed!", USBH_DISK_NAME, BSP_USBH_MSC_MOUNT_POINT);
+        }
+    }
+#endif
+}
+
+static void _disk_detach(void)
+{
+    struct usbh_msc_disk *disk = &_usbh.disk;
+
+    disk->probed = RT_FALSE;
+    if (!disk->online)
+    {
+        return;
+    }
+
+    rt_mutex_take(&_usbh.lock, RT_WAITING_FOREVER);
+    disk->online = RT_FALSE;
+    disk->cache_count = 0;
+    rt_mutex_release(&_usbh.lock);
+
+#ifdef RT_USING_DFS
+    if (BSP_USBH_MSC_MOUNT_POINT[0] != '\0')
+    {
+        dfs_unmount(BSP_USBH_MSC_MOUNT_POINT);
+    }
+#endif
+    rt_device_unregister(&disk->parent);
+
+    LOG_I("%s: removed", USBH_DISK_NAME);
+}
+
+/* the user callbacks of the GD host core */
+static void _usr_none(void)
+{
+}
+
+static void _usr_deinit(void)
+{
+    _usbh.class_ready = RT_FALSE;
+}
+
+static void _usr_speed_detected(uint32_t speed)
+{
+    LOG_D("%s speed device", (speed == PORT_SPEED_HIGH) ? "high" : (speed == PORT_SPEED_FULL) ? "full" : "low");
+}
+
+static void _usr_devdesc_assigned(void *desc)
+{
+}
+
+static void _usr_cfgdesc_assigned(usb_desc_config *cfg_desc, usb_desc_itf *itf_desc, usb_desc_ep *ep_desc)
+{
+}
+
+static void _usr_string(void *str)
+{
+}
+
+static void _usr_prod_str(void *str)
+{
+    LOG_I("device: %s", (char *)str);
+}
+
+static void _usr_enumerated(void)
+{
+    usb_desc_dev *desc = &_usbh.host.dev_prop.dev_desc;
+
+    LOG_D("enumerated %04x:%04x", desc->idVendor, desc->idProduct);
+}
+
+static usbh_user_status _usr_input(void)
+{
+    return USR_IN_RESP_OK;
+}
+
+static int _usr_app(void)
+{
+    /* the class calls it in every pass of the core task once the units are set up */
+    _usbh.class_ready = RT_TRUE;
+    return 0;
+}
+
+static void _usr_not_supported(void)
+{
+    LOG_W("the device is not a SCSI mass storage");
+}
+
+static void _usr_error(void)
+{
+    LOG_E("unrecovered error, the device is enumerated again");
+}
+
+static usbh_user_cb _usr_cb =
+{
+    _usr_none,
+    _usr_deinit,
+    _usr_none,
+    _usr_none,
+    _usr_none,
+    _usr_none,
+    _usr_speed_detected,
+    _usr_devdesc_assigned,
+    _usr_none,
+    _usr_cfgdesc_assigned,
+    _usr_string,
+    _usr_prod_str,
+    _usr_string,
+    _usr_enumerated,
+    _usr_input,
+    _usr_app,
+    _usr_not_supported,
+    _usr_error,
+};
+
+/* the service time of the interrupt, FIFO copies included, is shown by 'prof' */
+PROF_DEFINE(usbh_isr);
+
+void USBH_IRQHandler(void)
+{
+    usb_core_driver *udev = &_usbh.core;
+    rt_uint32_t intr;
+
+    rt_interrupt_enter();
+
+    PROF_BEGIN(usbh_isr);
+
+    intr = udev->regs.gr->GINTF & udev->regs.gr->GINTEN;
+    usbh_isr(udev);
+
+    /* the SOF only counts the frames of the timeouts, the others move a state machine */
+    if (intr & (GINTF_HCIF | GINTF_HPIF | GINTF_DISCIF))
+    {
+        rt_event_send(&_usbh.event, USBH_EVENT_CORE | USBH_EVENT_XFER);
+    }
+
+    PROF_END(usbh_isr);
+
+    rt_interrupt_leave();
+}
+
+static void _usbh_thread_entry(void *parameter)
+{
+    rt_int32_t timeout;
+    rt_uint32_t recved;
+
+    while (1)
+    {
+        rt_mutex_take(&_usbh.lock, RT_WAITING_FOREVER);
+        usbh_core_task(&_usbh.host);
+        rt_mutex_release(&_usbh.lock);
+
+        /* the file system reads the disk while it mounts, so outside of the lock */
+        if (_usbh.class_ready && !_usbh.disk.probed)
+        {
+            _disk_attach();
+        }
+        else if (!_usbh.class_ready && _usbh.disk.probed)
+        {
+            _disk_detach();
+        }
+
+        /* enumeration steps without an interrupt are polled every tick */
+        if (_usbh.class_ready || (_usbh.host.cur_state == HOST_DEFAULT && !_usbh.core.host.connect_status))
+        {
+            timeout = rt_tick_from_millisecond(USBH_IDLE_POLL_MS);
+        }
+        else
+        {
+            timeout = 1;
+        }
+        rt_event_recv(&_usbh.event, USBH_EVENT_CORE, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR, timeout, &recved);
+    }
+}
+
+/* the disk is mounted by the host thread, the file systems are up at the application level */
+static int rt_hw_usbh_init(void)
+{
+    rt_thread_t thread;
+
+    _usbh.disk.cache = rt_malloc(BSP_USBH_MSC_READ_AHEAD_SIZE);
+    if (_usbh.disk.cache == RT_NULL || !USBH_DMA_CAPABLE(_usbh.disk.cache))
+    {
+        LOG_E("no DMA capable memory for the read-ahead window");
+        return -RT_ENOMEM;
+    }
+
+    rt_mutex_init(&_usbh.lock, "usbh", RT_IPC_FLAG_PRIO);
+    rt_event_init(&_usbh.event, "usbh", RT_IPC_FLAG_PRIO);
+
+#if defined(BSP_USBH_TYPE_FS)
+    gd32_usb_hw_init(GD32_USB_CORE_FS, GD32_USB_PHY_EMBEDDED);
+#elif defined(BSP_USBH_PHY_ULPI)
+    gd32_usb_hw_init(GD32_USB_CORE_HS, GD32_USB_PHY_ULPI);
+#else
+    gd32_usb_hw_init(GD32_USB_CORE_HS, GD32_USB_PHY_EMBEDDED);
+#endif
+    usb_vbus_config();
+
+    usbh_class_register(&_usbh.host, &usbh_msc);
+    usbh_init(&_usbh.host, &_usbh.core, USBH_CORE, &_usr_cb);
+
+    nvic_irq_enable(USBH_IRQn, 2, 0);
+
+    thread = rt_thread_create("usbh", _usbh_thread_entry, RT_NULL,
+                              USBH_THREAD_STACK_SIZE, USBH_THREAD_PRIORITY, 10);
+    if (thread == RT_NULL)
+    {
+        LOG_E("no memory for the host thread");
+        return -RT_ENOMEM;
+    }
+    rt_thread_startup(thread);
+
+    LOG_I("USB%s host, %s mode", (USBH_CORE == USB_CORE_ENUM_HS) ? "HS" : "FS", _use_dma() ? "DMA" : "FIFO");
+
+    return RT_EOK;
+}
+INIT_APP_EXPORT(rt_hw_usbh_init);
+
+#ifdef RT_USING_FINSH
+static void usbh(void)
+{
+    struct usbh_msc_disk *disk = &_usbh.disk;
+
+    rt_kprintf("core    : USB%s, %s mode\n", (USBH_CORE == USB_CORE_ENUM_HS) ? "HS" : "FS", _use_dma() ? "DMA" : "FIFO");
+    if (disk->online)
+    {
+        rt_kprintf("disk    : %s, %d sectors of %d bytes\n", USBH_DISK_NAME, disk->sector_count, disk->sector_size);
+        rt_kprintf("window  : %d sectors\n", disk->cache_sectors);
+    }
+    else
+    {
+        rt_kprintf("disk    : %s\n", _usbh.core.host.connect_status ? "not ready" : "no device");
+    }
+    rt_kprintf("read    : %d KB in %d commands, %d sectors from the window\n",
+               (rt_uint32_t)(disk->read_bytes >> 10), disk->commands, disk->cache_hits);
+    rt_kprintf("written : %d KB\n", (rt_uint32_t)(disk->write_bytes >> 10));
+    rt_kprintf("errors  : %d\n", disk->errors);
+}
+MSH_CMD_EXPORT(usbh, show the usb host status);
+
+#ifdef DFS_USING_POSIX
+#define USBH_BENCH_BUFFER_SIZE  32768
+
+static void _print_rate(const char *what, rt_uint32_t bytes, rt_tick_t ticks)
+{
+    rt_uint32_t ms = RT_MAX(ticks * 1000 / RT_TICK_PER_SECOND, 1);
+    rt_uint32_t kbps = (rt_uint32_t)((rt_uint64_t)bytes * 1000 / 1024 / ms);
+
+    rt_kprintf("%s: %d KB in %d ms, %d.%02d MB/s\n", what, bytes >> 10, ms, kbps / 1024, (kbps % 1024) * 100 / 1024);
+}
+
+static void usbh_bench(int argc, char **argv)
+{
+    char path[DFS_PATH_MAX];
+    const char *name;
+    rt_uint8_t *buffer;
+    rt_uint32_t total;
+    rt_tick_t tick;
+    int in, out, len;
+
+    if (argc < 2)
+    {
+        rt_kprintf("usage: usbh_bench <file> [copy]\n");
+        rt_kprintf("reads the file, then copies it, to /sdcard/<name> unless a copy is given\n");
+        return;
+    }
+
+    if (argc > 2)
+    {
+        rt_strncpy(path, argv[2], sizeof(path) - 1);
+        path[sizeof(path) - 1] = '\0';
+    }
+    else
+    {
+        name = strrchr(argv[1], '/');
+        rt_snprintf(path, sizeof(path), "/sdcard/%s", name ? name + 1 : argv[1]);
+    }
+
+    buffer = rt_malloc(USBH_BENCH_BUFFER_SIZE);
+    if (buffer == RT_NULL)
+    {
+        rt_kprintf("no memory for the buffer\n");
+        return;
+    }
+
+    /* the read alone */
+    in = open(argv[1], O_RDONLY);
+    if (in < 0)
+    {
+        rt_kprintf("can not open %s\n", argv[1]);
+        rt_free(buffer);
+        return;
+    }
+    total = 0;
+    tick = rt_tick_get();
+    while ((len = read(in, buffer, USBH_BENCH_BUFFER_SIZE)) > 0)
+    {
+        total += len;
+    }
+    tick = rt_tick_get() - tick;
+    close(in);
+    _print_rate("read", total, tick);
+
+    /* the copy, the reads and the writes take turns */
+    in = open(argv[1], O_RDONLY);
+    out = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0);
+    if (in < 0 || out < 0)
+    {
+        rt_kprintf("can not open %s\n", (in < 0) ? argv[1] : path);
+        if (in >= 0)
+        {
+            close(in);
+        }
+        if (out >= 0)
+        {
+            close(out);
+        }
+        rt_free(buffer);
+        return;
+    }
+    total = 0;
+    tick = rt_tick_get();
+    while ((len = read(in, buffer, USBH_BENCH_BUFFER_SIZE)) > 0)
+    {
+        if (write(out, buffer, len) != len)
+        {
+            rt_kprintf("write to %s failed\n", path);
+            break;
+        }
+        total += len;
+    }
+    close(out);
+    tick = rt_tick_get() - tick;
+    close(in);
+    _print_rate("copy", total, tick);
+
+    rt_free(buffer);
+}
+MSH_CMD_EXPORT(usbh_bench, measure the usb disk read and copy throughput);
+#endif /* DFS_USING_POSIX */
+#endif /* RT_USING_FINSH */
+
+#endif /* BSP_USING_USBH */
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2006-2024 RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-25     Evlers       first version
+ */
+
+#ifndef __DRV_CAN_H__
+#define __DRV_CAN_H__
+
+#include <rthw.h>
+#include <rtthread.h>
+#include <rtdevice.h>
+#include <board.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* GD32 can config class */
+struct gd32_can_config
+{
+    char *device_name;
+    uint32_t periph;
+    IRQn_Type tx_irqn;
+    IRQn_Type rx0_irqn;
+    IRQn_Type rx1_irqn;
+    IRQn_Type ewmc_irqn;
+    rcu_periph_enum per_clk;
+    rcu_periph_enum tx_gpio_clk;
+    rcu_periph_enum rx_gpio_clk;
+    uint32_t tx_port;
+    uint16_t tx_af;
+    uint16_t tx_pin;
+    uint32_t rx_port;
+    uint16_t rx_af;
+    uint16_t rx_pin;
+};
+
+/* a received frame as it was drained from the hardware FIFO */
+struct can_rx_frame
+{
+    struct rt_can_msg msg;
+    rt_uint16_t bus_time;               /* the bit time counter at the start of the frame, wraps every 65536 bits */
+    rt_tick_t tick;                     /* when the frame was drained */
+    rt_uint32_t cycle;                  /* get_cpu_tick() when the frame was drained */
+};
+
+struct can_stats
+{
+    rt_uint32_t rx_frames;
+    rt_uint32_t tx_frames;
+    rt_uint32_t rx_batches;             /* receive interrupts that drained frames */
+    rt_uint32_t rx_batch_max;           /* most frames drained by one interrupt */
+    rt_uint32_t rx_overruns;            /* a hardware FIFO was full, the frame was lost on the bus */
+    rt_uint32_t rx_drops;               /* the ring was full, the frame was read but dropped */
+    rt_uint32_t tx_preempted;           /* pulled out of a mailbox for a frame of a higher priority */
+    rt_uint32_t tx_failed;
+    rt_uint32_t tx_queue_max;           /* most frames waiting for a mailbox */
+    rt_uint32_t bus_errors;
+    rt_uint32_t error_warnings;
+    rt_uint32_t error_passives;
+    rt_uint32_t bus_offs;
+    rt_uint32_t load;                   /* bus load of the last second, permille */
+    rt_uint32_t load_max;
+};
+
+/*
+ * Read the received frames when the device is not opened with RT_DEVICE_FLAG_INT_RX,
+ * the rx indication is called once for each batch with the number of frames in the ring.
+ * Returns the number of frames read, it does not wait.
+ */
+rt_size_t can_rx_read(rt_device_t dev, struct can_rx_frame *frames, rt_size_t count);
+
+/* the bus load counts the frames sent and the frames accepted by the filters */
+rt_err_t can_stats_get(rt_device_t dev, struct can_stats *stats);
+rt_err_t can_stats_reset(rt_device_t dev);
+
+int rt_hw_can_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DRV_CAN_H__ */
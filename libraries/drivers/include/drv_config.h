@@ -22,6 +22,7 @@ extern "C" {
 #include "f4xx/spi_config.h"
 #include "f4xx/uart_config.h"
 #include "f4xx/sdio_config.h"
+#include "f4xx/can_config.h"
 #elif defined(SOC_SERIES_GD32F30x)
 #include "f30x/dma_config.h"
 #endif
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2006-2024 RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-26     Evlers       first version
+ */
+
+#ifndef __DRV_DAC_H__
+#define __DRV_DAC_H__
+
+#include <rtthread.h>
+
+#define DAC_OUT0                0x01    /* PA4 */
+#define DAC_OUT1                0x02    /* PA5 */
+
+enum dac_wave
+{
+    DAC_WAVE_NOISE,                     /* the LFSR, the bits give the unmasked bits */
+    DAC_WAVE_TRIANGLE,                  /* counts up and down, the bits give the amplitude 2^bits - 1 */
+};
+
+/*
+ * Called in the interrupt with the half of the ring that was just played, the other half plays meanwhile.
+ * The samples are rt_uint16_t of one output, or rt_uint32_t with OUT0 in the bits 0-11 and OUT1 in the bits 16-27.
+ */
+typedef void (*dac_refill_t)(void *samples, rt_uint32_t count, void *arg);
+
+struct dac_stream_config
+{
+    rt_uint32_t rate;                   /* samples per second */
+    rt_uint8_t outputs;                 /* DAC_OUT0, DAC_OUT1, or both converted on the same trigger */
+    rt_uint32_t samples;                /* of the ring, an even number up to 65534 */
+    dac_refill_t refill;                /* RT_NULL to refill with dac_stream_wait() in a thread */
+    void *arg;
+};
+
+struct dac_stats
+{
+    rt_uint32_t rate;                   /* the rate of the timer, the nearest one to the requested rate */
+    rt_uint32_t halves;                 /* halves of the ring played */
+    rt_uint32_t late;                   /* halves played again, the thread did not refill them in time */
+    rt_uint32_t underruns;              /* triggers without a sample, the DMA is restarted */
+    rt_uint32_t dma_errors;
+};
+
+#ifdef BSP_DAC_USING_STREAM
+/* the ring is filled by the refill callback before the start, or with the middle of the scale without one */
+rt_err_t dac_stream_start(const struct dac_stream_config *config);
+
+/* waits for the half of the ring to refill, the count is in samples; returns RT_NULL on timeout or stop */
+void *dac_stream_wait(rt_uint32_t *count, rt_int32_t timeout);
+#endif
+
+/* the outputs step once per trigger around the base value, a triangle repeats every 2^(bits + 1) triggers */
+rt_err_t dac_wave_start(rt_uint8_t outputs, enum dac_wave wave, rt_uint16_t base, rt_uint8_t bits, rt_uint32_t rate);
+
+/* stops the stream or the wave, a stream keeps its last sample and a wave returns to its base */
+rt_err_t dac_stop(void);
+
+void dac_stats_get(struct dac_stats *stats);
+
+#endif /* __DRV_DAC_H__ */
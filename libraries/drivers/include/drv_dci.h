@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2006-2024 RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-24     Evlers       first version
+ */
+
+#ifndef __DRV_DCI_H__
+#define __DRV_DCI_H__
+
+#include <rtthread.h>
+
+enum dci_mode
+{
+    DCI_MODE_CONTINUOUS,                /* capture every frame until stopped */
+    DCI_MODE_SNAPSHOT,                  /* capture one frame and stop */
+};
+
+struct dci_frame
+{
+    void *data;
+    rt_uint32_t size;                   /* bytes */
+    rt_uint16_t width;
+    rt_uint16_t height;
+    rt_uint32_t sequence;               /* counts the captured frames, the dropped ones too */
+    rt_tick_t tick;                     /* the end of the capture */
+    int index;                          /* the frame buffer, for the driver */
+};
+
+/* called in the interrupt with a finished frame, it may borrow the frame without waiting */
+typedef void (*dci_frame_done_t)(const struct dci_frame *frame, void *arg);
+
+struct dci_stats
+{
+    rt_uint32_t frames;                 /* frames captured */
+    rt_uint32_t borrowed;               /* frames handed to the consumers */
+    rt_uint32_t dropped;                /* frames replaced by a newer one before they were borrowed */
+    rt_uint32_t overruns;               /* DCI FIFO overruns, the capture restarts at the next frame */
+    rt_uint32_t dma_errors;
+};
+
+rt_err_t dci_start(enum dci_mode mode);
+rt_err_t dci_stop(void);
+
+/* the window in pixels of the sensor output, a width or height of 0 disables it; capture must be stopped */
+rt_err_t dci_crop_set(rt_uint16_t x, rt_uint16_t y, rt_uint16_t width, rt_uint16_t height);
+
+/*
+ * Borrow the newest finished frame, waits for the next one if there is none.
+ * The frame stays in its buffer until it is returned, the capture goes on into the other buffers.
+ * Up to BSP_DCI_FRAME_BUFFERS - 2 frames can be borrowed at once, -RT_EBUSY after that.
+ */
+rt_err_t dci_frame_borrow(struct dci_frame *frame, rt_int32_t timeout);
+void dci_frame_return(const struct dci_frame *frame);
+
+void dci_frame_done_set(dci_frame_done_t done, void *arg);
+void dci_stats_get(struct dci_stats *stats);
+
+#endif /* __DRV_DCI_H__ */
@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author            Notes
  * 2021-08-20     BruceOu           the first version
+ * 2024-10-27     Evlers            add the port operations and the pin handles
  */
 
 #ifndef __DRV_GPIO_H__
@@ -70,6 +71,72 @@ struct pin_irq_map
     IRQn_Type irqno;
 };
 
+/* a pin resolved once by gd32_io_init(), for the protocols that drive it on every edge */
+struct gd32_io
+{
+    rt_uint32_t port;
+    rt_uint32_t mask;
+};
+
+struct gd32_pin_latency
+{
+    rt_uint32_t count;
+    rt_uint32_t min;                    /* cycles from the edge to the handler */
+    rt_uint32_t max;
+    rt_uint32_t avg;
+    rt_uint32_t lost;                   /* edges without the handler in 1 ms */
+};
+
+/*
+ * The port operations take the port as GPIOx and change or read only the bits of the mask,
+ * a write is one store to the bit operate register and no other pin of the port can be lost.
+ */
+rt_inline void gd32_port_write(rt_uint32_t port, rt_uint16_t mask, rt_uint16_t value)
+{
+    GPIO_BOP(port) = (rt_uint32_t)(value & mask) | ((rt_uint32_t)(~value & mask) << 16);
+}
+
+rt_inline void gd32_port_set(rt_uint32_t port, rt_uint16_t mask)
+{
+    GPIO_BOP(port) = mask;
+}
+
+rt_inline void gd32_port_clear(rt_uint32_t port, rt_uint16_t mask)
+{
+    GPIO_BC(port) = mask;
+}
+
+rt_inline rt_uint16_t gd32_port_read(rt_uint32_t port, rt_uint16_t mask)
+{
+    return (rt_uint16_t)(GPIO_ISTAT(port) & mask);
+}
+
+rt_inline void gd32_io_high(const struct gd32_io *io)
+{
+    GPIO_BOP(io->port) = io->mask;
+}
+
+rt_inline void gd32_io_low(const struct gd32_io *io)
+{
+    GPIO_BC(io->port) = io->mask;
+}
+
+rt_inline void gd32_io_write(const struct gd32_io *io, rt_uint8_t value)
+{
+    GPIO_BOP(io->port) = value ? io->mask : (io->mask << 16);
+}
+
+rt_inline rt_uint8_t gd32_io_read(const struct gd32_io *io)
+{
+    return (GPIO_ISTAT(io->port) & io->mask) ? PIN_HIGH : PIN_LOW;
+}
+
+/* the pin must be configured by rt_pin_mode() before */
+rt_err_t gd32_io_init(struct gd32_io *io, rt_base_t pin);
+
+/* toggles the output and times the interrupt of the input, the two pins must be wired together */
+rt_err_t gd32_pin_latency(rt_base_t out, rt_base_t in, rt_uint32_t count, struct gd32_pin_latency *latency);
+
 int rt_hw_pin_init(void);
 
 #ifdef __cplusplus
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2006-2024 RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-22     Evlers       first version
+ */
+
+#ifndef __DRV_LCD_H__
+#define __DRV_LCD_H__
+
+#include <rtthread.h>
+
+#define LCD_DEVICE_NAME         "lcd"
+
+/* called in the interrupt after the TLI took a flipped frame buffer */
+typedef void (*lcd_flip_done_t)(void *framebuffer, void *arg);
+
+struct lcd_stats
+{
+    rt_uint32_t flips;                  /* frame buffers shown */
+    rt_uint32_t replaced;               /* flips replaced by a later one before the blank */
+    rt_uint32_t waits;                  /* waits for a blank */
+    rt_uint32_t fifo_errors;            /* underruns of the layer FIFO, the SDRAM was too slow */
+    rt_uint32_t bus_errors;
+};
+
+/* the frame buffers are in the SDRAM, the first one is shown after the init */
+void *lcd_framebuffer_get(int index);
+int lcd_framebuffer_count(void);
+
+/* show the frame buffer from the next vertical blank on, it does not wait */
+rt_err_t lcd_flip(void *framebuffer);
+/* wait until the last flip was taken, returns at once if none is pending */
+rt_err_t lcd_flip_wait(rt_int32_t timeout);
+rt_bool_t lcd_flip_pending(void);
+
+void lcd_flip_done_set(lcd_flip_done_t done, void *arg);
+void lcd_stats_get(struct lcd_stats *stats);
+
+#endif /* __DRV_LCD_H__ */
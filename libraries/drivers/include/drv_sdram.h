@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2006-2024 RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-28     Evlers       first version
+ */
+
+#ifndef __DRV_SDRAM_H__
+#define __DRV_SDRAM_H__
+
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* a frame buffer of the LCD or the DCI in the SDRAM, they are never freed */
+void *sdram_framebuffer_alloc(rt_size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __DRV_SDRAM_H__ */
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2006-2024 RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-19     Evlers       first version
+ */
+
+#ifndef __DRV_USB_COMMON_H__
+#define __DRV_USB_COMMON_H__
+
+#include <rtthread.h>
+
+enum gd32_usb_core
+{
+    GD32_USB_CORE_FS,                   /* USBFS, PA11/PA12 */
+    GD32_USB_CORE_HS,                   /* USBHS */
+};
+
+enum gd32_usb_phy
+{
+    GD32_USB_PHY_EMBEDDED,              /* embedded full speed PHY, PB14/PB15 on the USBHS */
+    GD32_USB_PHY_ULPI,                  /* external high speed ULPI PHY */
+};
+
+/* enable the 48MHz clock, the pins and the bus clock of a USB core */
+void gd32_usb_hw_init(enum gd32_usb_core core, enum gd32_usb_phy phy);
+
+#endif /* __DRV_USB_COMMON_H__ */
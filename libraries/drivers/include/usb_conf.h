@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2006-2024 RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-19     Evlers       first version
+ * 2024-10-20     Evlers       add the DMA FIFO copy option
+ * 2024-10-21     Evlers       add the host mode
+ */
+
+#ifndef __USB_CONF_H__
+#define __USB_CONF_H__
+
+#include <rtconfig.h>
+#include "gd32f4xx.h"
+
+/* configuration of the GD32F4xx USB library, derived from the BSP options */
+
+#ifdef BSP_USING_USBD
+#define USE_DEVICE_MODE
+
+#ifdef BSP_USBD_TYPE_HS
+#define USB_HS_CORE
+#define USE_USB_HS
+#else
+#define USB_FS_CORE
+#define USE_USB_FS
+#endif /* BSP_USBD_TYPE_HS */
+
+#ifdef BSP_USBD_PHY_ULPI
+#define USB_ULPI_PHY_ENABLED
+#endif
+
+#ifdef BSP_USBD_USING_DMA
+#define USB_HS_INTERNAL_DMA_ENABLED
+#endif
+
+#ifndef BSP_USBD_RX_FIFO_PACKETS
+#define BSP_USBD_RX_FIFO_PACKETS    4
+#endif
+
+#ifdef BSP_USBD_SPEED_HS
+#define USBD_DATA_MAX_PACKET        512U
+#else
+#define USBD_DATA_MAX_PACKET        64U
+#endif
+#endif /* BSP_USING_USBD */
+
+/* the host takes the core that the device leaves free */
+#ifdef BSP_USING_USBH
+#define USE_HOST_MODE
+
+#ifdef BSP_USBH_TYPE_HS
+#define USB_HS_CORE
+#else
+#define USB_FS_CORE
+#endif /* BSP_USBH_TYPE_HS */
+
+#ifdef BSP_USBH_PHY_ULPI
+#define USB_ULPI_PHY_ENABLED
+#endif
+
+#ifdef BSP_USBH_USING_DMA
+#define USB_HS_INTERNAL_DMA_ENABLED
+#endif
+#endif /* BSP_USING_USBH */
+
+/* packets from this size up are copied to and from the FIFO by a DMA channel */
+#ifdef BSP_USB_FIFO_USING_DMA
+#define USB_FIFO_DMA_ENABLED
+#define USB_FIFO_DMA_MIN_SIZE       BSP_USB_FIFO_DMA_MIN_SIZE
+#endif
+
+#define USBHS_SOF_OUTPUT            0U
+#define USBHS_LOW_POWER             0U
+#define USBFS_SOF_OUTPUT            0U
+#define USBFS_LOW_POWER             0U
+
+/*
+ * FIFO RAM in words. The RX FIFO keeps room for the SETUP packets, the
+ * transfer complete entries of every OUT endpoint and BSP_USBD_RX_FIFO_PACKETS
+ * data packets. Only endpoint 0 gets a TX FIFO here, the data IN endpoints are
+ * sized by drv_usbd.c when the host configures the device.
+ */
+#define RX_FIFO_HS_SIZE             (10U + 2U * 6U + (USBD_DATA_MAX_PACKET / 4U + 1U) * BSP_USBD_RX_FIFO_PACKETS)
+#define TX0_FIFO_HS_SIZE            16U
+#define TX1_FIFO_HS_SIZE            0U
+#define TX2_FIFO_HS_SIZE            0U
+#define TX3_FIFO_HS_SIZE            0U
+#define TX4_FIFO_HS_SIZE            0U
+#define TX5_FIFO_HS_SIZE            0U
+
+#define RX_FIFO_FS_SIZE             (10U + 2U * 4U + (64U / 4U + 1U) * BSP_USBD_RX_FIFO_PACKETS)
+#define TX0_FIFO_FS_SIZE            16U
+#define TX1_FIFO_FS_SIZE            0U
+#define TX2_FIFO_FS_SIZE            0U
+#define TX3_FIFO_FS_SIZE            0U
+
+/*
+ * Host FIFO RAM in words, the whole RAM of each core. The RX FIFO holds at
+ * least 3 bulk packets with their status entries, the TX FIFOs 2 packets.
+ */
+#define USB_RX_FIFO_HS_SIZE         512U
+#define USB_HTX_NPFIFO_HS_SIZE      256U
+#define USB_HTX_PFIFO_HS_SIZE       256U
+
+#define USB_RX_FIFO_FS_SIZE         128U
+#define USB_HTX_NPFIFO_FS_SIZE      96U
+#define USB_HTX_PFIFO_FS_SIZE       96U
+
+#if defined (__GNUC__)
+#define __ALIGN_BEGIN
+#define __ALIGN_END                 __attribute__ ((aligned (4)))
+#ifndef __packed
+#define __packed                    __attribute__ ((__packed__))
+#endif
+#elif defined (__CC_ARM)
+#define __ALIGN_BEGIN               __align(4)
+#define __ALIGN_END
+#else
+#define __ALIGN_BEGIN
+#define __ALIGN_END
+#endif
+
+#endif /* __USB_CONF_H__ */
@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2006-2024 RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-19     Evlers       first version
+ */
+
+#ifndef __USBD_CONF_H__
+#define __USBD_CONF_H__
+
+#include "usb_conf.h"
+
+/* the classes run on the RT-Thread udcd core, the GD device core only keeps the endpoint state */
+#define USBD_CFG_MAX_NUM            1U
+#define USBD_ITF_MAX_NUM            1U
+#define USB_STR_DESC_MAX_SIZE       64U
+
+#endif /* __USBD_CONF_H__ */
@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2006-2024 RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-21     Evlers       first version
+ */
+
+#ifndef __USBH_CONF_H__
+#define __USBH_CONF_H__
+
+#include "usb_conf.h"
+
+/* UAS capable disks offer a second alternate setting with 4 endpoints */
+#define USBH_MAX_EP_NUM             4U
+#define USBH_MAX_INTERFACES_NUM     2U
+#define USBH_MAX_ALT_SETTING        2U
+#define USBH_MAX_SUPPORTED_CLASS    1U
+#define USBH_DATA_BUF_MAX_LEN       512U
+#define USBH_CFG_DESC_KEEP          0U
+#define USBH_CFGSET_MAX_LEN         512U
+
+/* a read or write of a disk sleeps on the channel interrupts, see drv_usbh.c */
+struct _usbh_host;
+void usbh_msc_rdwr_wait(struct _usbh_host *uhost);
+#define USBH_MSC_RDWR_WAIT(uhost)   usbh_msc_rdwr_wait(uhost)
+
+#endif /* __USBH_CONF_H__ */
@@ -6,6 +6,7 @@
 #include <rtthread.h>
 
 #include <string.h>
+#include <errno.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -17,6 +18,14 @@
 #include <sys/select.h>
 #include <netdb.h>
 
+#ifdef RT_USING_LWIP
+#include <lwip/opt.h>
+#if LWIP_NETCONN
+#include <lwip/api.h>
+#define IPERF_USING_NETCONN
+#endif
+#endif
+
 #define DBG_SECTION_NAME               "iperf"
 #define DBG_LEVEL                      DBG_INFO
 #include <rtdbg.h>
@@ -28,6 +37,19 @@
 #define IPERF_MODE_SERVER   1
 #define IPERF_MODE_CLIENT   2
 
+#define IPERF_STREAMS_MAX   8
+#define IPERF_INTERVAL      5           /* seconds, the default report interval */
+#define IPERF_DUAL_TIME     10          /* seconds, the default test time of the dual test */
+#define IPERF_RECV_TIMEOUT  3           /* seconds, the period to check the stop request */
+
+/* the flags of the iperf2 client header */
+#define IPERF_HEADER_VERSION1   0x80000000
+#define IPERF_RUN_NOW           0x00000001
+
+/* the idle loop to estimate the cpu load */
+#define IPERF_CPU_LOOP      64
+#define IPERF_CPU_CALIBRATE (RT_TICK_PER_SECOND / 10)
+
 #if (RT_VER_NUM >= 0x50000)
 #define IPERF_GET_THREAD_NAME(th) (th->parent.name)
 #else
@@ -39,23 +61,343 @@ typedef struct
     int mode;
     char *host;
     int port;
+    int use_udp;
+    int dual;
+    int zerocopy;
+    int interval;
+    int time;
 } IPERF_PARAM;
 static IPERF_PARAM param = {IPERF_MODE_STOP, NULL, IPERF_PORT};
 
+/*
+ * The iperf2 client sends this header at the beginning of the stream (network order),
+ * the server connects back to the port for the dual (-d) or the tradeoff (-r) test.
+ */
+typedef struct
+{
+    rt_int32_t flags;
+    rt_int32_t num_threads;
+    rt_int32_t port;
+    rt_int32_t buffer_len;
+    rt_int32_t win_band;
+    rt_int32_t amount;                  /* > 0: bytes, < 0: time in 10ms */
+} IPERF_CLIENT_HDR;
+
+typedef struct
+{
+    int used;
+    int tx;                             /* 1: send, 0: receive */
+    int sock;
+#ifdef IPERF_USING_NETCONN
+    struct netconn *conn;
+#endif
+    char host[16];                      /* the peer address */
+    int port;
+    rt_int32_t amount;                  /* the limit of the client, same unit as the header, 0: until stop */
+    rt_uint32_t hdr_flags;              /* the header sent by the client or received by the server */
+    rt_int32_t hdr_threads;
+    rt_int32_t hdr_port;
+    rt_int32_t hdr_amount;
+    rt_uint8_t hdr_buf[sizeof(IPERF_CLIENT_HDR)];   /* the header received so far, it may be split by the segments */
+    int hdr_len;
+    volatile rt_uint32_t bytes;         /* free running, the reporter takes the difference */
+    rt_uint32_t last_bytes;
+    volatile rt_uint32_t lost;
+    volatile rt_uint32_t total;
+} IPERF_STREAM;
+static IPERF_STREAM streams[IPERF_STREAMS_MAX];
+
+#ifdef IPERF_USING_NETCONN
+/* the content is never changed, so it can still be referenced by the unacked segments */
+static rt_uint8_t iperf_zc_buf[IPERF_BUFSZ];
+#endif
+
+#ifdef RT_USING_IDLE_HOOK
+static volatile rt_uint32_t idle_count;
+static rt_uint32_t idle_count_max;      /* the idle loops per tick of an idle cpu */
+
+static void iperf_idle_hook(void)
+{
+    volatile rt_uint32_t loop;
+
+    for (loop = 0; loop < IPERF_CPU_LOOP; loop++);
+    idle_count++;
+}
+
+/* count the idle loops while the shell sleeps, once before the first test creates any stream */
+static void iperf_idle_calibrate(void)
+{
+    rt_uint32_t count;
+    rt_tick_t tick;
+
+    if (idle_count_max != 0) return;
+    if (rt_thread_idle_sethook(iperf_idle_hook) != RT_EOK) return;
+
+    /* start at a tick boundary */
+    rt_thread_delay(1);
+    count = idle_count;
+    tick = rt_tick_get();
+    rt_thread_delay(IPERF_CPU_CALIBRATE);
+    count = idle_count - count;
+    tick = rt_tick_get() - tick;
+    rt_thread_idle_delhook(iperf_idle_hook);
+
+    idle_count_max = tick ? count / tick : count;
+    if (idle_count_max == 0) idle_count_max = 1;
+}
+#endif
+
+static void iperf_pattern_fill(uint8_t *buf, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i ++)
+        buf[i] = i & 0xff;
+}
+
+static void iperf_client_hdr_fill(IPERF_CLIENT_HDR *hdr, IPERF_STREAM *stream)
+{
+    hdr->flags = htonl(stream->hdr_flags);
+    hdr->num_threads = htonl(stream->hdr_threads);
+    hdr->port = htonl(stream->hdr_port);
+    hdr->buffer_len = htonl(IPERF_BUFSZ);
+    hdr->win_band = 0;
+    hdr->amount = htonl(stream->hdr_amount);
+}
+
+static IPERF_STREAM *iperf_stream_alloc(int tx)
+{
+    IPERF_STREAM *stream = RT_NULL;
+    int i;
+
+    rt_enter_critical();
+    for (i = 0; i < IPERF_STREAMS_MAX; i++)
+    {
+        if (!streams[i].used)
+        {
+            stream = &streams[i];
+            rt_memset(stream, 0, sizeof(IPERF_STREAM));
+            stream->used = 1;
+            stream->tx = tx;
+            stream->sock = -1;
+            break;
+        }
+    }
+    rt_exit_critical();
+
+    if (stream == RT_NULL)
+    {
+        LOG_E("too many streams, the max is %d!", IPERF_STREAMS_MAX);
+    }
+
+    return stream;
+}
+
+static void iperf_stream_free(IPERF_STREAM *stream)
+{
+    stream->used = 0;
+}
+
+static int iperf_stream_start(IPERF_STREAM *stream, void (*entry)(void *parameter), const char *prefix)
+{
+    char tid_name[RT_NAME_MAX + 1] = {0};
+    rt_thread_t tid;
+
+    rt_snprintf(tid_name, sizeof(tid_name), "%s%02d", prefix, (int)(stream - streams) + 1);
+    tid = rt_thread_create(tid_name, entry, stream, IPERF_THREAD_STACK_SIZE, 20, 100);
+    if (tid == RT_NULL)
+    {
+        LOG_E("create thread %s failed!", tid_name);
+        iperf_stream_free(stream);
+        return -1;
+    }
+    rt_thread_startup(tid);
+
+    return 0;
+}
+
+/* the client stops by itself only for the amount asked by the iperf2 header */
+static int iperf_stream_expired(IPERF_STREAM *stream, rt_tick_t start)
+{
+    if (stream->amount < 0)
+        return (rt_tick_get() - start) >= rt_tick_from_millisecond(-stream->amount * 10);
+    if (stream->amount > 0)
+        return stream->bytes >= (rt_uint32_t)stream->amount;
+
+    return 0;
+}
+
+static void iperf_client(void *thread_param);
+#ifdef IPERF_USING_NETCONN
+static void iperf_netconn_client(void *thread_param);
+#endif
+
+/* connect back to the iperf2 client for the dual or the tradeoff test */
+static void iperf_reverse_start(IPERF_STREAM *rx)
+{
+    IPERF_STREAM *stream = iperf_stream_alloc(1);
+
+    if (stream == RT_NULL) return;
+
+    rt_strncpy(stream->host, rx->host, sizeof(stream->host) - 1);
+    stream->port = rx->hdr_port;
+    stream->amount = rx->hdr_amount ? rx->hdr_amount : -IPERF_DUAL_TIME * 100;
+
+    LOG_I("reverse test to (%s, %d)", stream->host, stream->port);
+#ifdef IPERF_USING_NETCONN
+    if (param.zerocopy)
+    {
+        iperf_stream_start(stream, iperf_netconn_client, "iperfc");
+        return;
+    }
+#endif
+    iperf_stream_start(stream, iperf_client, "iperfc");
+}
+
+/* check the iperf2 header at the beginning of the received stream, the data after the header is ignored */
+static void iperf_client_hdr_check(IPERF_STREAM *rx, const void *buf, int len)
+{
+    IPERF_CLIENT_HDR hdr;
+
+    if (rx->hdr_len >= (int)sizeof(hdr)) return;
+
+    if (len > (int)sizeof(hdr) - rx->hdr_len) len = (int)sizeof(hdr) - rx->hdr_len;
+    rt_memcpy(rx->hdr_buf + rx->hdr_len, buf, len);
+    rx->hdr_len += len;
+    if (rx->hdr_len < (int)sizeof(hdr)) return;
+
+    rt_memcpy(&hdr, rx->hdr_buf, sizeof(hdr));
+    if ((ntohl(hdr.flags) & IPERF_HEADER_VERSION1) == 0) return;
+
+    rx->hdr_flags = ntohl(hdr.flags);
+    rx->hdr_port = ntohl(hdr.port);
+    rx->hdr_amount = ntohl(hdr.amount);
+
+    if (rx->hdr_flags & IPERF_RUN_NOW)
+    {
+        iperf_reverse_start(rx);
+    }
+}
+
+/* the tradeoff test starts after the client stream is finished */
+static void iperf_tradeoff_check(IPERF_STREAM *rx)
+{
+    if ((rx->hdr_flags & IPERF_HEADER_VERSION1) && !(rx->hdr_flags & IPERF_RUN_NOW) &&
+        (param.mode != IPERF_MODE_STOP))
+    {
+        iperf_reverse_start(rx);
+    }
+}
+
+static void iperf_report_speed(const char *id, rt_uint32_t bytes, rt_tick_t from, rt_tick_t to, rt_tick_t start, const char *tail)
+{
+    rt_uint32_t ticks = (to - from) ? (to - from) : 1;
+    rt_uint32_t kbps = (rt_uint64_t)bytes * 8 * RT_TICK_PER_SECOND / 1000 / ticks;
+    rt_uint32_t t1 = (from - start) * 10 / RT_TICK_PER_SECOND;
+    rt_uint32_t t2 = (to - start) * 10 / RT_TICK_PER_SECOND;
+
+    rt_kprintf("[%3s] %4d.%d-%4d.%d sec %8d KBytes %4d.%03d Mbits/sec %s\n", id,
+               t1 / 10, t1 % 10, t2 / 10, t2 % 10, bytes / 1024, kbps / 1000, kbps % 1000, tail);
+}
+
+/* print the interval report of all the streams with the cpu load */
+static void iperf_report(rt_tick_t from, rt_tick_t to, rt_tick_t start, rt_uint32_t idle)
+{
+    rt_uint32_t delta, sum[2] = {0, 0};
+    int count[2] = {0, 0};
+    char id[4], tail[32];
+    int i;
+
+    for (i = 0; i < IPERF_STREAMS_MAX; i++)
+    {
+        IPERF_STREAM *stream = &streams[i];
+
+        if (!stream->used) continue;
+
+        delta = stream->bytes - stream->last_bytes;
+        stream->last_bytes += delta;
+        sum[stream->tx] += delta;
+        count[stream->tx]++;
+
+        if (param.use_udp && !stream->tx)
+            rt_snprintf(tail, sizeof(tail), "rx lost:%d total:%d", stream->lost, stream->total);
+        else
+            rt_snprintf(tail, sizeof(tail), "%s", stream->tx ? "tx" : "rx");
+        rt_snprintf(id, sizeof(id), "%d", i + 1);
+        iperf_report_speed(id, delta, from, to, start, tail);
+    }
+
+    if (count[1] > 1) iperf_report_speed("SUM", sum[1], from, to, start, "tx");
+    if (count[0] > 1) iperf_report_speed("SUM", sum[0], from, to, start, "rx");
+
+#ifdef RT_USING_IDLE_HOOK
+    if ((count[0] + count[1] > 0) && (idle_count_max != 0))
+    {
+        rt_uint32_t full = idle_count_max * (to - from);
+        int load = (full == 0 || idle >= full) ? 0 : 100 - (rt_uint64_t)idle * 100 / full;
+
+        rt_kprintf("[CPU] %d%%\n", load);
+    }
+#endif
+}
+
+static void iperf_reporter(void *thread_param)
+{
+    rt_tick_t start, last, now;
+    rt_uint32_t idle_last = 0, idle = 0;
+
+#ifdef RT_USING_IDLE_HOOK
+    rt_thread_idle_sethook(iperf_idle_hook);
+    idle_last = idle_count;
+#endif
+
+    start = last = rt_tick_get();
+    rt_kprintf("[ ID] Interval          Transfer         Bandwidth\n");
+
+    while (param.mode != IPERF_MODE_STOP)
+    {
+        rt_thread_mdelay(100);
+
+        now = rt_tick_get();
+#ifdef RT_USING_IDLE_HOOK
+        idle = idle_count - idle_last;
+#endif
+        if ((param.time > 0) && (now - start >= (rt_tick_t)param.time * RT_TICK_PER_SECOND))
+        {
+            iperf_report(last, now, start, idle);
+            param.mode = IPERF_MODE_STOP;
+            LOG_I("iperf test finished!");
+            break;
+        }
+
+        if (now - last >= (rt_tick_t)param.interval * RT_TICK_PER_SECOND)
+        {
+            iperf_report(last, now, start, idle);
+            last = now;
+            idle_last += idle;
+        }
+    }
+
+#ifdef RT_USING_IDLE_HOOK
+    rt_thread_idle_delhook(iperf_idle_hook);
+#endif
+}
+
 static void iperf_udp_client(void *thread_param)
 {
+    IPERF_STREAM *stream = (IPERF_STREAM *)thread_param;
     int sock;
     rt_uint32_t *buffer;
     struct sockaddr_in server;
     rt_uint32_t packet_count = 0;
     rt_uint32_t tick;
-    int send_size;
+    int send_size, ret;
 
     send_size = IPERF_BUFSZ > 1470 ? 1470 : IPERF_BUFSZ;
     buffer = rt_malloc(IPERF_BUFSZ);
     if (buffer == NULL)
     {
-        return;
+        goto __exit;
     }
     rt_memset(buffer, 0x00, IPERF_BUFSZ);
     sock = socket(PF_INET, SOCK_DGRAM, 0);
@@ -63,11 +405,11 @@ static void iperf_udp_client(void *thread_param)
     {
         LOG_E("can't create socket!");
         rt_free(buffer);
-        return;
+        goto __exit;
     }
     server.sin_family = PF_INET;
-    server.sin_port = htons(param.port);
-    server.sin_addr.s_addr = inet_addr(param.host);
+    server.sin_port = htons(stream->port);
+    server.sin_addr.s_addr = inet_addr(stream->host);
     LOG_I("iperf udp mode run...");
     while (param.mode != IPERF_MODE_STOP)
     {
@@ -76,35 +418,42 @@ static void iperf_udp_client(void *thread_param)
         buffer[0] = htonl(packet_count);
         buffer[1] = htonl(tick / RT_TICK_PER_SECOND);
         buffer[2] = htonl((tick % RT_TICK_PER_SECOND) * 1000);
-        sendto(sock, buffer, send_size, 0, (struct sockaddr *)&server, sizeof(struct sockaddr_in));
+        ret = sendto(sock, buffer, send_size, 0, (struct sockaddr *)&server, sizeof(struct sockaddr_in));
+        if (ret > 0)
+        {
+            stream->bytes += ret;
+        }
     }
     closesocket(sock);
     rt_free(buffer);
+
+__exit:
+    iperf_stream_free(stream);
 }
 
 static void iperf_udp_server(void *thread_param)
 {
+    IPERF_STREAM *stream = (IPERF_STREAM *)thread_param;
     int sock;
     rt_uint32_t *buffer;
     struct sockaddr_in server;
     struct sockaddr_in sender;
-    int sender_len, r_size;
-    rt_uint64_t sentlen;
+    socklen_t sender_len;
+    int r_size;
     rt_uint32_t pcount = 0, last_pcount = 0;
-    rt_uint32_t lost, total;
-    rt_tick_t tick1, tick2;
     struct timeval timeout;
 
     buffer = rt_malloc(IPERF_BUFSZ);
     if (buffer == NULL)
     {
-        return;
+        goto __exit;
     }
     sock = socket(PF_INET, SOCK_DGRAM, 0);
     if(sock < 0)
     {
         LOG_E("can't create socket! exit!");
-        return;
+        rt_free(buffer);
+        goto __exit;
     }
     server.sin_family = PF_INET;
     server.sin_port = htons(param.port);
@@ -117,75 +466,51 @@ static void iperf_udp_server(void *thread_param)
         LOG_E("setsockopt failed!");
         closesocket(sock);
         rt_free(buffer);
-        return;
+        goto __exit;
     }
     if (bind(sock, (struct sockaddr *)&server, sizeof(struct sockaddr_in)) < 0)
     {
         LOG_E("iperf server bind failed! exit!");
         closesocket(sock);
         rt_free(buffer);
-        return;
+        goto __exit;
     }
     while (param.mode != IPERF_MODE_STOP)
     {
-        tick1 = rt_tick_get();
-        tick2 = tick1;
-        lost = 0;
-        total = 0;
-        sentlen = 0;
-        while ((tick2 - tick1) < (RT_TICK_PER_SECOND * 5))
+        sender_len = sizeof(sender);
+        r_size = recvfrom(sock, buffer, IPERF_BUFSZ, 0, (struct sockaddr *)&sender, &sender_len);
+        if (r_size > 12)
         {
-            r_size = recvfrom(sock, buffer, IPERF_BUFSZ, 0, (struct sockaddr *)&sender, (socklen_t*)&sender_len);
-            if (r_size > 12)
+            pcount = ntohl(buffer[0]);
+            if (last_pcount < pcount)
             {
-                pcount = ntohl(buffer[0]);
-                if (last_pcount < pcount)
-                {
-                    lost += pcount - last_pcount - 1;
-                    total += pcount - last_pcount;
-                }
-                else
-                {
-                    last_pcount = pcount;
-                }
-                last_pcount = pcount;
-                sentlen += r_size;
+                stream->lost += pcount - last_pcount - 1;
+                stream->total += pcount - last_pcount;
             }
-            tick2 = rt_tick_get();
-        }
-        if (sentlen > 0)
-        {
-            long data;
-            int integer, decimal;
-            rt_thread_t tid;
-
-            tid = rt_thread_self();
-            data = sentlen * RT_TICK_PER_SECOND / 125 / (tick2 - tick1);
-            integer = data/1000;
-            decimal = data%1000;
-            LOG_I("%s: %d.%03d0 Mbps! lost:%d total:%d", IPERF_GET_THREAD_NAME(tid), integer, decimal, lost, total);
+            last_pcount = pcount;
+            stream->bytes += r_size;
         }
     }
     rt_free(buffer);
     closesocket(sock);
+
+__exit:
+    iperf_stream_free(stream);
 }
 
 static void iperf_client(void *thread_param)
 {
-    int i;
+    IPERF_STREAM *stream = (IPERF_STREAM *)thread_param;
     int sock;
     int ret;
     int tips = 1;
+    int header;
     uint8_t *send_buf;
-    rt_uint64_t sentlen;
-    rt_tick_t tick1, tick2;
+    rt_tick_t start;
     struct sockaddr_in addr;
 
     send_buf = (uint8_t *) rt_malloc(IPERF_BUFSZ);
-    if (!send_buf) return ;
-
-    for (i = 0; i < IPERF_BUFSZ; i ++)
-        send_buf[i] = i & 0xff;
+    if (!send_buf) goto __exit;
 
     while (param.mode != IPERF_MODE_STOP)
     {
@@ -198,8 +523,8 @@ static void iperf_client(void *thread_param)
         }
 
         addr.sin_family = PF_INET;
-        addr.sin_port = htons(param.port);
-        addr.sin_addr.s_addr = inet_addr((char *)param.host);
+        addr.sin_port = htons(stream->port);
+        addr.sin_addr.s_addr = inet_addr(stream->host);
 
         ret = connect(sock, (const struct sockaddr *)&addr, sizeof(addr));
         if (ret == -1)
@@ -226,31 +551,26 @@ static void iperf_client(void *thread_param)
                        sizeof(int));    /* length of option value */
         }
 
-        sentlen = 0;
-
-        tick1 = rt_tick_get();
-        while (param.mode != IPERF_MODE_STOP)
+        /* the header is only sent at the beginning of the stream */
+        iperf_pattern_fill(send_buf, IPERF_BUFSZ);
+        header = (stream->hdr_flags != 0);
+        if (header)
         {
-            tick2 = rt_tick_get();
-            if (tick2 - tick1 >= RT_TICK_PER_SECOND * 5)
-            {
-                long data;
-                int integer, decimal;
-                rt_thread_t tid;
-
-                tid = rt_thread_self();
-                data = sentlen * RT_TICK_PER_SECOND / 125 / (tick2 - tick1);
-                integer = data/1000;
-                decimal = data%1000;
-                LOG_I("%s: %d.%03d0 Mbps!", IPERF_GET_THREAD_NAME(tid), integer, decimal);
-                tick1 = tick2;
-                sentlen = 0;
-            }
+            iperf_client_hdr_fill((IPERF_CLIENT_HDR *)send_buf, stream);
+        }
 
+        start = rt_tick_get();
+        while ((param.mode != IPERF_MODE_STOP) && !iperf_stream_expired(stream, start))
+        {
             ret = send(sock, send_buf, IPERF_BUFSZ, 0);
             if (ret > 0)
             {
-                sentlen += ret;
+                stream->bytes += ret;
+                if (header)
+                {
+                    iperf_pattern_fill(send_buf, sizeof(IPERF_CLIENT_HDR));
+                    header = 0;
+                }
             }
 
             if (ret < 0) break;
@@ -258,23 +578,24 @@ static void iperf_client(void *thread_param)
 
         closesocket(sock);
 
+        /* the reverse test runs only once */
+        if (stream->amount != 0) break;
+
         rt_thread_delay(RT_TICK_PER_SECOND * 2);
         LOG_W("Disconnected, iperf server shut down!");
         tips = 1;
     }
     rt_free(send_buf);
+
+__exit:
+    iperf_stream_free(stream);
 }
 
-void iperf_server(void *thread_param)
+static void iperf_server_stream(void *thread_param)
 {
+    IPERF_STREAM *stream = (IPERF_STREAM *)thread_param;
     uint8_t *recv_data;
-    socklen_t sin_size;
-    rt_tick_t tick1, tick2;
-    int sock = -1, connected, bytes_received;
-    rt_uint64_t recvlen;
-    struct sockaddr_in server_addr, client_addr;
-    fd_set readset;
-    struct timeval timeout;
+    int bytes_received;
 
     recv_data = (uint8_t *)rt_malloc(IPERF_BUFSZ);
     if (recv_data == RT_NULL)
@@ -283,6 +604,33 @@ void iperf_server(void *thread_param)
         goto __exit;
     }
 
+    while (param.mode != IPERF_MODE_STOP)
+    {
+        bytes_received = recv(stream->sock, recv_data, IPERF_BUFSZ, 0);
+        if (bytes_received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) continue;
+        if (bytes_received <= 0) break;
+
+        iperf_client_hdr_check(stream, recv_data, bytes_received);
+        stream->bytes += bytes_received;
+    }
+    LOG_W("client disconnected (%s)", stream->host);
+    rt_free(recv_data);
+    iperf_tradeoff_check(stream);
+
+__exit:
+    closesocket(stream->sock);
+    iperf_stream_free(stream);
+}
+
+void iperf_server(void *thread_param)
+{
+    IPERF_STREAM *stream;
+    socklen_t sin_size;
+    int sock = -1, connected;
+    struct sockaddr_in server_addr, client_addr;
+    fd_set readset;
+    struct timeval timeout;
+
     sock = socket(AF_INET, SOCK_STREAM, 0);
     if (sock < 0)
     {
@@ -307,20 +655,21 @@ void iperf_server(void *thread_param)
         goto __exit;
     }
 
-    timeout.tv_sec = 3;
-    timeout.tv_usec = 0;
-
     while (param.mode != IPERF_MODE_STOP)
     {
         FD_ZERO(&readset);
         FD_SET(sock, &readset);
 
-        if (select(sock + 1, &readset, RT_NULL, RT_NULL, &timeout) == 0)
+        timeout.tv_sec = IPERF_RECV_TIMEOUT;
+        timeout.tv_usec = 0;
+        if (select(sock + 1, &readset, RT_NULL, RT_NULL, &timeout) <= 0)
             continue;
 
         sin_size = sizeof(struct sockaddr_in);
 
         connected = accept(sock, (struct sockaddr *)&client_addr, &sin_size);
+        if (connected < 0)
+            continue;
 
         LOG_I("new client connected from (%s, %d)",
                    inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
@@ -335,61 +684,212 @@ void iperf_server(void *thread_param)
                        sizeof(int));    /* length of option value */
         }
 
-        recvlen = 0;
-        tick1 = rt_tick_get();
-        while (param.mode != IPERF_MODE_STOP)
+        /* each client is received by its own thread */
+        stream = iperf_stream_alloc(0);
+        if (stream == RT_NULL)
+        {
+            closesocket(connected);
+            continue;
+        }
+
+        timeout.tv_sec = IPERF_RECV_TIMEOUT;
+        timeout.tv_usec = 0;
+        setsockopt(connected, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        stream->sock = connected;
+        rt_strncpy(stream->host, inet_ntoa(client_addr.sin_addr), sizeof(stream->host) - 1);
+        if (iperf_stream_start(stream, iperf_server_stream, "iperfr") != 0)
         {
-            bytes_received = recv(connected, recv_data, IPERF_BUFSZ, 0);
-            if (bytes_received <= 0) break;
+            closesocket(connected);
+        }
+    }
+
+__exit:
+    if (sock >= 0) closesocket(sock);
+}
+
+#ifdef IPERF_USING_NETCONN
+/* send the static buffer with NETCONN_NOCOPY, the socket layer and the copy into the pbuf are bypassed */
+static void iperf_netconn_client(void *thread_param)
+{
+    IPERF_STREAM *stream = (IPERF_STREAM *)thread_param;
+    IPERF_CLIENT_HDR hdr;
+    struct netconn *conn;
+    ip_addr_t addr;
+    rt_tick_t start;
+    err_t err;
+    int tips = 1;
 
-            recvlen += bytes_received;
+    if (!ipaddr_aton(stream->host, &addr))
+    {
+        LOG_E("invalid host %s!", stream->host);
+        goto __exit;
+    }
 
-            tick2 = rt_tick_get();
-            if (tick2 - tick1 >= RT_TICK_PER_SECOND * 5)
+    while (param.mode != IPERF_MODE_STOP)
+    {
+        conn = netconn_new(NETCONN_TCP);
+        if (conn == RT_NULL)
+        {
+            LOG_E("create netconn failed!");
+            rt_thread_delay(RT_TICK_PER_SECOND);
+            continue;
+        }
+
+        err = netconn_connect(conn, &addr, stream->port);
+        if (err != ERR_OK)
+        {
+            if (tips)
             {
-                long data;
-                int integer, decimal;
-                rt_thread_t tid;
-
-                tid = rt_thread_self();
-                data = recvlen * RT_TICK_PER_SECOND / 125 / (tick2 - tick1);
-                integer = data/1000;
-                decimal = data%1000;
-                LOG_I("%s: %d.%03d0 Mbps!", IPERF_GET_THREAD_NAME(tid), integer, decimal);
-                tick1 = tick2;
-                recvlen = 0;
+                LOG_E("Connect to iperf server faile, Waiting for the server to open!");
+                tips = 0;
             }
+            netconn_delete(conn);
+            rt_thread_delay(RT_TICK_PER_SECOND);
+            continue;
         }
-        LOG_W("client disconnected (%s, %d)",
-                   inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
-        if (connected >= 0) closesocket(connected);
-        connected = -1;
+
+        LOG_I("Connect to iperf server successful! (netconn nocopy)");
+
+        /* the header is on the stack, it must be copied */
+        if (stream->hdr_flags)
+        {
+            iperf_client_hdr_fill(&hdr, stream);
+            netconn_write(conn, &hdr, sizeof(hdr), NETCONN_COPY);
+        }
+
+        start = rt_tick_get();
+        while ((param.mode != IPERF_MODE_STOP) && !iperf_stream_expired(stream, start))
+        {
+            err = netconn_write(conn, iperf_zc_buf, IPERF_BUFSZ, NETCONN_NOCOPY);
+            if (err != ERR_OK) break;
+
+            stream->bytes += IPERF_BUFSZ;
+        }
+
+        netconn_close(conn);
+        netconn_delete(conn);
+
+        /* the reverse test runs only once */
+        if (stream->amount != 0) break;
+
+        rt_thread_delay(RT_TICK_PER_SECOND * 2);
+        LOG_W("Disconnected, iperf server shut down!");
+        tips = 1;
     }
 
 __exit:
-    if (sock >= 0) closesocket(sock);
-    if (recv_data) rt_free(recv_data);
+    iperf_stream_free(stream);
+}
+
+/* receive the pbufs from the stack directly, the data is never copied */
+static void iperf_netconn_server_stream(void *thread_param)
+{
+    IPERF_STREAM *stream = (IPERF_STREAM *)thread_param;
+    rt_uint8_t hdr[sizeof(IPERF_CLIENT_HDR)];
+    struct pbuf *p;
+    err_t err;
+
+    netconn_set_recvtimeout(stream->conn, IPERF_RECV_TIMEOUT * 1000);
+
+    while (param.mode != IPERF_MODE_STOP)
+    {
+        err = netconn_recv_tcp_pbuf(stream->conn, &p);
+        if (err == ERR_TIMEOUT) continue;
+        if (err != ERR_OK) break;
+
+        if (stream->hdr_len < (int)sizeof(hdr))
+        {
+            iperf_client_hdr_check(stream, hdr, pbuf_copy_partial(p, hdr, sizeof(hdr), 0));
+        }
+        stream->bytes += p->tot_len;
+        pbuf_free(p);
+    }
+    LOG_W("client disconnected (%s)", stream->host);
+    iperf_tradeoff_check(stream);
+
+    netconn_close(stream->conn);
+    netconn_delete(stream->conn);
+    iperf_stream_free(stream);
 }
 
+static void iperf_netconn_server(void *thread_param)
+{
+    IPERF_STREAM *stream;
+    struct netconn *conn, *newconn;
+    ip_addr_t addr;
+    u16_t port;
+
+    conn = netconn_new(NETCONN_TCP);
+    if (conn == RT_NULL)
+    {
+        LOG_E("create netconn failed!");
+        return;
+    }
+
+    if ((netconn_bind(conn, IP_ADDR_ANY, param.port) != ERR_OK) || (netconn_listen(conn) != ERR_OK))
+    {
+        LOG_E("Unable to bind!");
+        netconn_delete(conn);
+        return;
+    }
+    netconn_set_recvtimeout(conn, IPERF_RECV_TIMEOUT * 1000);
+
+    while (param.mode != IPERF_MODE_STOP)
+    {
+        if (netconn_accept(conn, &newconn) != ERR_OK)
+            continue;
+
+        netconn_peer(newconn, &addr, &port);
+        LOG_I("new client connected from (%s, %d)", ipaddr_ntoa(&addr), port);
+
+        stream = iperf_stream_alloc(0);
+        if (stream == RT_NULL)
+        {
+            netconn_close(newconn);
+            netconn_delete(newconn);
+            continue;
+        }
+
+        stream->conn = newconn;
+        rt_strncpy(stream->host, ipaddr_ntoa(&addr), sizeof(stream->host) - 1);
+        if (iperf_stream_start(stream, iperf_netconn_server_stream, "iperfr") != 0)
+        {
+            netconn_close(newconn);
+            netconn_delete(newconn);
+        }
+    }
+
+    netconn_delete(conn);
+}
+#endif /* IPERF_USING_NETCONN */
+
 void iperf_usage(void)
 {
-    rt_kprintf("Usage: iperf [-s|-c host] [options] [multi-threaded]\n");
+    rt_kprintf("Usage: iperf [-s|-c host] [options]\n");
     rt_kprintf("       iperf [-h|--stop]\n");
     rt_kprintf("\n");
     rt_kprintf("Client/Server:\n");
     rt_kprintf("  -p #         server port to listen on/connect to\n");
+    rt_kprintf("  -i #         seconds between periodic bandwidth reports (default %d)\n", IPERF_INTERVAL);
+    rt_kprintf("  -u           testing UDP protocol\n");
+#ifdef IPERF_USING_NETCONN
+    rt_kprintf("  -Z           TCP by the netconn API with NETCONN_NOCOPY\n");
+#endif
     rt_kprintf("\n");
     rt_kprintf("Server specific:\n");
     rt_kprintf("  -s           run in server mode\n");
     rt_kprintf("\n");
     rt_kprintf("Client specific:\n");
     rt_kprintf("  -c <host>    run in client mode, connecting to <host>\n");
+    rt_kprintf("  -P #         number of parallel client streams to run (max %d)\n", IPERF_STREAMS_MAX);
+    rt_kprintf("  -t #         time in seconds to transmit for (default until --stop)\n");
+    rt_kprintf("  -d           do a bidirectional test simultaneously with iperf2 (default %ds)\n", IPERF_DUAL_TIME);
     rt_kprintf("\n");
     rt_kprintf("Miscellaneous:\n");
     rt_kprintf("  -h           print this message and quit\n");
     rt_kprintf("  --stop       stop iperf program\n");
-    rt_kprintf("  -u           testing UDP protocol\n");
-    rt_kprintf("  -m <time>    the number of multi-threaded\n");
+    rt_kprintf("  -m <time>    the number of multi-threaded, same as -P\n");
     return;
 }
 
@@ -400,73 +900,80 @@ int iperf(int argc, char **argv)
     int port = IPERF_PORT;
     int numtid = 1;
     int use_udp = 0;
-    int index = 1;
+    int dual = 0;
+    int zerocopy = 0;
+    int interval = IPERF_INTERVAL;
+    int time = 0;
+    int index;
 
     if (argc == 1)
     {
         goto __usage;
     }
-    if (strcmp(argv[1], "-u") == 0)
-    {
-        index = 2;
-        use_udp = 1;
-    }
-    if (strcmp(argv[index], "-h") == 0) goto __usage;
-    else if (strcmp(argv[index], "--stop") == 0)
-    {
-        /* stop iperf */
-        param.mode = IPERF_MODE_STOP;
-        return 0;
-    }
-    else if (strcmp(argv[index], "-s") == 0)
-    {
-        mode = IPERF_MODE_SERVER; /* server mode */
 
-        /* iperf -s -p 5000 */
-        if (argc >= 4)
+    for (index = 1; index < argc; index++)
+    {
+        if (strcmp(argv[index], "-h") == 0) goto __usage;
+        else if (strcmp(argv[index], "--stop") == 0)
         {
-            if (strcmp(argv[index + 1], "-p") == 0)
-            {
-                port = atoi(argv[index + 2]);
-            }
-            else goto __usage;
+            /* stop iperf */
+            param.mode = IPERF_MODE_STOP;
+            return 0;
         }
-    }
-    else if (strcmp(argv[index], "-c") == 0)
-    {
-        mode = IPERF_MODE_CLIENT; /* client mode */
-        if (argc < 3) goto __usage;
-
-        host = argv[index + 1];
-        if (argc >= 5)
+        else if (strcmp(argv[index], "-u") == 0) use_udp = 1;
+        else if (strcmp(argv[index], "-d") == 0) dual = 1;
+        else if (strcmp(argv[index], "-Z") == 0) zerocopy = 1;
+        else if (strcmp(argv[index], "-s") == 0) mode = IPERF_MODE_SERVER;
+        else if (index + 1 >= argc) goto __usage;
+        else if (strcmp(argv[index], "-c") == 0)
         {
-            /* iperf -c host -p port */
-            if (strcmp(argv[index + 2], "-p") == 0)
-            {
-                port = atoi(argv[index + 3]);
-            }
-            else goto __usage;
+            mode = IPERF_MODE_CLIENT;
+            host = argv[++index];
         }
+        else if (strcmp(argv[index], "-p") == 0) port = atoi(argv[++index]);
+        else if (strcmp(argv[index], "-i") == 0) interval = atoi(argv[++index]);
+        else if (strcmp(argv[index], "-t") == 0) time = atoi(argv[++index]);
+        else if ((strcmp(argv[index], "-P") == 0) || (strcmp(argv[index], "-m") == 0)) numtid = atoi(argv[++index]);
+        else goto __usage;
     }
-    else goto __usage;
 
-    if (argc >= 7)
+    if (mode == 0) goto __usage;
+    if (interval < 1) interval = 1;
+    if (numtid < 1) numtid = 1;
+    if (numtid > IPERF_STREAMS_MAX) numtid = IPERF_STREAMS_MAX;
+
+    if (use_udp && (dual || zerocopy))
     {
-        if(strcmp(argv[argc - 2], "-m") == 0)
-        {
-            numtid = atoi(argv[argc - 1]);
-        }
-        else  goto __usage;
+        LOG_W("-d and -Z are only supported by the TCP test!");
+        dual = zerocopy = 0;
+    }
+#ifndef IPERF_USING_NETCONN
+    if (zerocopy)
+    {
+        LOG_W("-Z needs the lwIP netconn API!");
+        zerocopy = 0;
+    }
+#endif
+    if (dual && (time == 0))
+    {
+        time = IPERF_DUAL_TIME;
     }
 
     /* start iperf */
     if (param.mode == IPERF_MODE_STOP)
     {
         int i = 0;
-        char tid_name[RT_NAME_MAX + 1] = {0};
+        rt_thread_t tid = RT_NULL;
+        void (*server)(void *parameter) = iperf_server;
+        void (*client)(void *parameter) = iperf_client;
 
         param.mode = mode;
         param.port = port;
+        param.use_udp = use_udp;
+        param.dual = dual;
+        param.zerocopy = zerocopy;
+        param.interval = interval;
+        param.time = time;
         if (param.host)
         {
             rt_free(param.host);
@@ -474,41 +981,53 @@ int iperf(int argc, char **argv)
         }
         if (host) param.host = rt_strdup(host);
 
-        for (i = 0; i < numtid; i++)
+#ifdef IPERF_USING_NETCONN
+        if (zerocopy)
         {
-            rt_thread_t tid = RT_NULL;
-            void (*function)(void *parameter);
+            iperf_pattern_fill(iperf_zc_buf, IPERF_BUFSZ);
+            server = iperf_netconn_server;
+            client = iperf_netconn_client;
+        }
+#endif
 
-            if (use_udp)
-            {
-                if (mode == IPERF_MODE_CLIENT)
-                {
-                    rt_snprintf(tid_name, sizeof(tid_name), "iperfc%02d", i + 1);
-                    function = iperf_udp_client;
-                }
-                else if (mode == IPERF_MODE_SERVER)
-                {
-                    rt_snprintf(tid_name, sizeof(tid_name), "iperfd%02d", i + 1);
-                    function = iperf_udp_server;
-                }
-            }
-            else
-            {
-                if (mode == IPERF_MODE_CLIENT)
-                {
-                    rt_snprintf(tid_name, sizeof(tid_name), "iperfc%02d", i + 1);
-                    function = iperf_client;
-                }
-                else if (mode == IPERF_MODE_SERVER)
-                {
-                    rt_snprintf(tid_name, sizeof(tid_name), "iperfd%02d", i + 1);
-                    function = iperf_server;
-                }
-            }
+#ifdef RT_USING_IDLE_HOOK
+        /* the streams and their interrupts would make the idle loops of an idle cpu too few */
+        iperf_idle_calibrate();
+#endif
+
+        tid = rt_thread_create("iperfi", iperf_reporter, RT_NULL, IPERF_THREAD_STACK_SIZE, 19, 10);
+        if (tid) rt_thread_startup(tid);
+
+        if (use_udp && (mode == IPERF_MODE_SERVER))
+        {
+            IPERF_STREAM *stream = iperf_stream_alloc(0);
 
-            tid = rt_thread_create(tid_name, function, RT_NULL, IPERF_THREAD_STACK_SIZE, 20, 100);
+            if (stream) iperf_stream_start(stream, iperf_udp_server, "iperfd");
+        }
+        else if ((mode == IPERF_MODE_SERVER) || dual)
+        {
+            /* one listener for all the clients, the client of the dual test waits for the reverse streams */
+            tid = rt_thread_create("iperfd", server, RT_NULL, IPERF_THREAD_STACK_SIZE, 20, 100);
             if (tid) rt_thread_startup(tid);
         }
+
+        for (i = 0; (mode == IPERF_MODE_CLIENT) && (i < numtid); i++)
+        {
+            IPERF_STREAM *stream = iperf_stream_alloc(1);
+
+            if (stream == RT_NULL) break;
+
+            rt_strncpy(stream->host, host, sizeof(stream->host) - 1);
+            stream->port = port;
+            if (dual)
+            {
+                stream->hdr_flags = IPERF_HEADER_VERSION1 | IPERF_RUN_NOW;
+                stream->hdr_threads = numtid;
+                stream->hdr_port = port;
+                stream->hdr_amount = -time * 100;
+            }
+            iperf_stream_start(stream, use_udp ? iperf_udp_client : client, "iperfc");
+        }
     }
     else
     {
@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2018-07-13     never        the first version
+ * 2024-10-19     Evlers       add the capture ring, the filter, the snaplen and the pcapng tcp stream
  */
 
 #include <rtthread.h>
@@ -15,6 +16,9 @@
 #else
 #include <dfs_posix.h>
 #endif /* RT_VER_NUM >= 0x40100 */
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
 #include "netif/ethernetif.h"
 #include "optparse.h"
 
@@ -33,7 +37,23 @@
 
 #define TCPDUMP_DEFAULT_NANE        ("sample.pcap")
 
-#define TCPDUMP_MAX_MSG             (10)
+#ifndef PKG_NETUTILS_TCPDUMP_RING_SLOTS
+#define PKG_NETUTILS_TCPDUMP_RING_SLOTS (16)
+#endif
+#ifndef PKG_NETUTILS_TCPDUMP_SLOT_SIZE
+#define PKG_NETUTILS_TCPDUMP_SLOT_SIZE  (1536)
+#endif
+#ifndef PKG_NETUTILS_TCPDUMP_TCP_PORT
+#define PKG_NETUTILS_TCPDUMP_TCP_PORT   (2000)
+#endif
+
+#define TCPDUMP_RING_SLOTS          PKG_NETUTILS_TCPDUMP_RING_SLOTS
+#define TCPDUMP_SLOT_STRIDE         RT_ALIGN(sizeof(struct tcpdump_buf) + PKG_NETUTILS_TCPDUMP_SLOT_SIZE, RT_ALIGN_SIZE)
+#define TCPDUMP_SLOT(_index)        ((struct tcpdump_buf *)(tcpdump_ring + ((_index) % TCPDUMP_RING_SLOTS) * TCPDUMP_SLOT_STRIDE))
+#define TCPDUMP_FILTER_HDR_LEN      (64)                /* ethernet + vlan + ip header with options + ports */
+#define TCPDUMP_TCP_BATCH           (4 * 1024)          /* the records are sent in batches of this size */
+#define TCPDUMP_WAIT_TIME           (100)               /* ms, the period to check the stop request */
+
 #define PCAP_FILE_HEADER_SIZE       (24)
 #define PCAP_PKTHDR_SIZE            (16)
 
@@ -72,7 +92,12 @@
 #define LINKTYPE_PRISM_HEADER       (119)               /* 802.11+Prism II monitor mode */
 #define LINKTYPE_AIRONET_HEADER     (120)               /* FreeBSD Aironet driver stuff */
 
-#define MSH_CMD ("phi::m::w::")                         /* [-p] [-h] [-i] [-m] [-w] */
+#define PCAPNG_BLOCK_SHB            (0x0A0D0D0A)
+#define PCAPNG_BLOCK_IDB            (0x00000001)
+#define PCAPNG_BLOCK_EPB            (0x00000006)
+#define PCAPNG_BYTE_ORDER_MAGIC     (0x1A2B3C4D)
+
+#define MSH_CMD ("phi::dm::w::s::f::t::")               /* [-p] [-h] [-i] [-d] [-m] [-w] [-s] [-f] [-t] */
 #define STRCMP(a, R, b)   (rt_strcmp((a), (b)) R 0)
 
 #define PACP_FILE_HEADER_CREATE(_head)                          \
@@ -82,7 +107,7 @@ do {                                                            \
     (_head)->version_minor = PCAP_VERSION_MINOR;                \
     (_head)->thiszone = GREENWICH_MEAN_TIME;                    \
     (_head)->sigfigs = PRECISION_OF_TIME_STAMP;                 \
-    (_head)->snaplen = MAX_LENTH_OF_CAPTURE_PKG;                \
+    (_head)->snaplen = snaplen;                                 \
     (_head)->linktype = LINKTYPE_ETHERNET;                      \
 } while (0)
 
@@ -98,15 +123,72 @@ do{                                                             \
 do{                                                             \
     (_head)->ts.tv_sec = _p->tick / 1000;                       \
     (_head)->ts.tv_usec = (_p->tick % 1000) * 1000;             \
-    (_head)->caplen = _p->tot_len;                              \
+    (_head)->caplen = _p->caplen;                               \
     (_head)->len = _p->tot_len;                                 \
 } while (0)
 
+/* a fixed-size slot of the capture ring, the data is truncated to the snaplen */
 struct tcpdump_buf
 {
+    volatile rt_uint16_t ready;
+    rt_uint16_t caplen;
     rt_uint16_t tot_len;
     rt_tick_t tick;
-    void *buf;
+    rt_uint8_t buf[];
+};
+
+/* the zero fields match any packet */
+struct tcpdump_filter
+{
+    rt_uint16_t type;                                   /* ethertype */
+    rt_uint8_t proto;                                   /* ipv4 protocol */
+    rt_uint32_t host;                                   /* ipv4 source or destination address, network order */
+    rt_uint16_t port;                                   /* tcp or udp source or destination port */
+    rt_uint16_t exclude_port;                           /* tcp port never matched, the own pcapng stream */
+};
+
+struct tcpdump_stat
+{
+    rt_uint32_t captured;
+    rt_uint32_t filtered;
+    rt_uint32_t truncated;
+    rt_uint32_t ring_full;                              /* dropped because the ring was full */
+    rt_uint32_t disconnect;                             /* tcp clients lost while sending */
+};
+
+struct pcapng_block_head
+{
+    rt_uint32_t type;
+    rt_uint32_t total_len;
+};
+
+struct pcapng_shb
+{
+    struct pcapng_block_head head;
+    rt_uint32_t magic;
+    rt_uint16_t version_major;
+    rt_uint16_t version_minor;
+    rt_int32_t section_len[2];
+    rt_uint32_t total_len;
+};
+
+struct pcapng_idb
+{
+    struct pcapng_block_head head;
+    rt_uint16_t linktype;
+    rt_uint16_t reserved;
+    rt_uint32_t snaplen;
+    rt_uint32_t total_len;
+};
+
+struct pcapng_epb
+{
+    struct pcapng_block_head head;
+    rt_uint32_t interface_id;
+    rt_uint32_t ts_high;
+    rt_uint32_t ts_low;
+    rt_uint32_t caplen;
+    rt_uint32_t len;
 };
 
 struct rt_pcap_file_header
@@ -140,7 +222,33 @@ enum rt_tcpdump_return_param
 };
 
 static struct rt_device *tcpdump_pipe;
-static struct rt_mailbox *tcpdump_mb;
+static rt_thread_t tcpdump_tid;
+
+/*
+ * The capture ring is allocated when the capture starts.
+ * The producers (the rx thread and the tcpip thread) only mask the interrupts to reserve a slot,
+ * the copy is done outside and the slot is published by the ready flag.
+ * The only consumer is the tcpdump thread, it frees the slots in order.
+ */
+static rt_uint8_t *tcpdump_ring;
+static rt_uint32_t ring_head;
+static volatile rt_uint32_t ring_tail;
+static volatile rt_uint32_t ring_producers;         /* the producers between the reserve and the publish */
+static struct rt_semaphore tcpdump_sem;
+static volatile rt_bool_t tcpdump_running;
+static volatile rt_bool_t tcpdump_capture;          /* the output accepts packets */
+
+static rt_uint16_t snaplen;
+static struct tcpdump_filter filter;
+static rt_uint16_t snaplen_arg;
+static struct tcpdump_filter filter_arg;
+static struct tcpdump_stat stat;
+
+static int tcp_port;
+static int tcp_server = -1;
+static int tcp_client = -1;
+static rt_uint8_t *tcp_batch;
+static int tcp_batch_len;
 
 static struct netif *netif;
 static netif_linkoutput_fn link_output;
@@ -158,8 +266,10 @@ static void rt_tcpdump_ethname_del(void);
 static void rt_tcpdump_error_info_deal(void);
 static void rt_tcpdump_init_indicate(void);
 static rt_err_t rt_tcpdump_pcap_file_save(const void *buf, int len);
+static rt_err_t rt_tcpdump_tcp_write(const void *buf, int len);
 
 static rt_err_t (*tcpdump_write)(const void *buf, int len);
+static rt_err_t (*capture_write)(const void *buf, int len);   /* the output of the running capture */
 
 #ifdef  PKG_NETUTILS_TCPDUMP_PRINT
 #define __is_print(ch) ((unsigned int)((ch) - ' ') < 127u - ' ')
@@ -189,51 +299,139 @@ static void hex_dump(const rt_uint8_t *ptr, rt_size_t buflen)
 }
 #endif
 
-/* get tx data */
-static err_t _netif_linkoutput(struct netif *netif, struct pbuf *p)
+/* match the packet headers with the filter, the ip layer conditions only match ipv4 */
+static rt_bool_t rt_tcpdump_filter_match(const struct tcpdump_filter *f, const rt_uint8_t *frame, int len)
 {
-    // pbuf->payload + sizeof(struct tcpdump_buf)
-    struct tcpdump_buf *tbuf = (struct tcpdump_buf *)rt_malloc(p->tot_len+sizeof(struct tcpdump_buf));
+    const rt_uint8_t *ip;
+    rt_uint16_t type, sport = 0, dport = 0;
+    rt_bool_t has_ports;
+    int offset = 14, ihl;
 
-    RT_ASSERT(tbuf != RT_NULL);
-    RT_ASSERT(netif != RT_NULL);
+    if ((f->type == 0) && (f->proto == 0) && (f->host == 0) && (f->port == 0) && (f->exclude_port == 0))
+        return RT_TRUE;
+
+    if (len < offset)
+        return RT_FALSE;
+
+    type = (frame[12] << 8) | frame[13];
+    if ((type == 0x8100) && (len >= offset + 4))
+    {
+        /* skip the vlan tag */
+        type = (frame[16] << 8) | frame[17];
+        offset += 4;
+    }
+
+    if ((f->type != 0) && (type != f->type))
+        return RT_FALSE;
+
+    /* the excluded port only applies to ipv4 tcp, the other packets only need the ip conditions */
+    if ((type != 0x0800) || (len < offset + 20))
+        return (f->proto == 0) && (f->host == 0) && (f->port == 0);
+
+    ip = frame + offset;
+    ihl = (ip[0] & 0x0F) * 4;
+
+    /* only the first fragment of tcp or udp carries the ports */
+    has_ports = ((ip[9] == 6) || (ip[9] == 17)) && ((((ip[6] & 0x1F) | ip[7]) == 0) && (len >= offset + ihl + 4));
+    if (has_ports)
+    {
+        sport = (ip[ihl] << 8) | ip[ihl + 1];
+        dport = (ip[ihl + 2] << 8) | ip[ihl + 3];
+    }
+
+    if ((f->exclude_port != 0) && has_ports && (ip[9] == 6) && ((sport == f->exclude_port) || (dport == f->exclude_port)))
+        return RT_FALSE;
+
+    if ((f->proto != 0) && (ip[9] != f->proto))
+        return RT_FALSE;
+
+    if ((f->host != 0) && (rt_memcmp(&ip[12], &f->host, 4) != 0) && (rt_memcmp(&ip[16], &f->host, 4) != 0))
+        return RT_FALSE;
+
+    if ((f->port != 0) && (!has_ports || ((sport != f->port) && (dport != f->port))))
+        return RT_FALSE;
+
+    return RT_TRUE;
+}
+
+/* filter the packet and copy it into a free slot of the ring */
+static void rt_tcpdump_capture(struct pbuf *p)
+{
+    struct tcpdump_buf *tbuf;
+    rt_uint8_t hdr[TCPDUMP_FILTER_HDR_LEN];
+    const rt_uint8_t *frame = p->payload;
+    int len = p->len;
+    rt_base_t level;
+
+    if (!tcpdump_capture)
+        return;
+
+    /* the headers are normally in the first pbuf, the filter runs before any copy */
+    if ((len < TCPDUMP_FILTER_HDR_LEN) && (p->tot_len > p->len))
+    {
+        len = pbuf_copy_partial(p, hdr, sizeof(hdr), 0);
+        frame = hdr;
+    }
+
+    if (!rt_tcpdump_filter_match(&filter, frame, len))
+    {
+        stat.filtered++;
+        return;
+    }
+
+    level = rt_hw_interrupt_disable();
+    /* checked again with the interrupts masked, the deinit waits for the producers counted here */
+    if (!tcpdump_capture)
+    {
+        rt_hw_interrupt_enable(level);
+        return;
+    }
+    if (ring_head - ring_tail >= TCPDUMP_RING_SLOTS)
+    {
+        stat.ring_full++;
+        rt_hw_interrupt_enable(level);
+        return;
+    }
+    tbuf = TCPDUMP_SLOT(ring_head);
+    ring_head++;
+    ring_producers++;
+    stat.captured++;
+    if (p->tot_len > snaplen)
+        stat.truncated++;
+    rt_hw_interrupt_enable(level);
 
     tbuf->tick = rt_tick_get();
-    tbuf->buf = ((rt_uint8_t *)tbuf) + sizeof(struct tcpdump_buf);
     tbuf->tot_len = p->tot_len;
-    pbuf_copy_partial(p, tbuf->buf, p->tot_len, 0);
+    tbuf->caplen = (p->tot_len > snaplen) ? snaplen : p->tot_len;
+    pbuf_copy_partial(p, tbuf->buf, tbuf->caplen, 0);
+    tbuf->ready = 1;
+
+    rt_sem_release(&tcpdump_sem);
+
+    level = rt_hw_interrupt_disable();
+    ring_producers--;
+    rt_hw_interrupt_enable(level);
+}
+
+/* get tx data */
+static err_t _netif_linkoutput(struct netif *netif, struct pbuf *p)
+{
+    RT_ASSERT(netif != RT_NULL);
 
     if (p != RT_NULL)
-    {
-        if (rt_mb_send(tcpdump_mb, (rt_uint32_t)tbuf) != RT_EOK)
-        {
-            rt_free(tbuf);
-        }
-    }
+        rt_tcpdump_capture(p);
+
     return link_output(netif, p);
 }
 
 /* get rx data */
 static err_t _netif_input(struct pbuf *p, struct netif *inp)
 {
-    // pbuf->payload + sizeof(struct tcpdump_buf)
-    struct tcpdump_buf *tbuf = (struct tcpdump_buf *)rt_malloc(p->tot_len+sizeof(struct tcpdump_buf));
-
-    RT_ASSERT(tbuf != RT_NULL);
     RT_ASSERT(netif != RT_NULL);
 
-    tbuf->tick = rt_tick_get();
-    tbuf->buf = ((rt_uint8_t *)tbuf) + sizeof(struct tcpdump_buf);
-    tbuf->tot_len = p->tot_len;
-    pbuf_copy_partial(p, tbuf->buf, p->tot_len, 0);
-
     if (p != RT_NULL)
-    {
-        if (rt_mb_send(tcpdump_mb, (rt_uint32_t)tbuf) != RT_EOK)
-        {
-            rt_free(tbuf);
-        }
-    }
+        rt_tcpdump_capture(p);
+
     return input(p, inp);
 }
 
@@ -284,6 +482,117 @@ static rt_err_t rt_tcpdump_pcap_file_save(const void *buf, int len)
     return RT_EOK;
 }
 
+/* send the batched records to the host */
+static rt_err_t rt_tcpdump_tcp_flush(void)
+{
+    int offset = 0, res;
+
+    while (offset < tcp_batch_len)
+    {
+        res = send(tcp_client, tcp_batch + offset, tcp_batch_len - offset, 0);
+        if (res <= 0)
+        {
+            dbg_log(DBG_INFO, "the host is disconnected!\n");
+            tcpdump_capture = RT_FALSE;
+            closesocket(tcp_client);
+            tcp_client = -1;
+            tcp_batch_len = 0;
+            stat.disconnect++;
+            return -RT_ERROR;
+        }
+        offset += res;
+    }
+    tcp_batch_len = 0;
+
+    return RT_EOK;
+}
+
+/* stream pcapng to the host through tcp, the data is sent when the batch is full or the ring is empty */
+static rt_err_t rt_tcpdump_tcp_write(const void *buf, int len)
+{
+    const rt_uint8_t *ptr = buf;
+    int size;
+
+    while (len > 0)
+    {
+        if (tcp_client < 0)
+            return -RT_ERROR;
+
+        size = TCPDUMP_TCP_BATCH - tcp_batch_len;
+        if (size > len)
+            size = len;
+
+        rt_memcpy(tcp_batch + tcp_batch_len, ptr, size);
+        tcp_batch_len += size;
+        ptr += size;
+        len -= size;
+
+        if ((tcp_batch_len == TCPDUMP_TCP_BATCH) && (rt_tcpdump_tcp_flush() != RT_EOK))
+            return -RT_ERROR;
+    }
+
+    return RT_EOK;
+}
+
+/* wait for the host and start the pcapng section */
+static void rt_tcpdump_tcp_accept(void)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    struct pcapng_shb shb;
+    struct pcapng_idb idb;
+
+    tcp_client = accept(tcp_server, (struct sockaddr *)&addr, &addr_len);
+    if (tcp_client < 0)
+        return;
+
+    dbg_log(DBG_INFO, "the host %s is connected!\n", inet_ntoa(addr.sin_addr));
+
+    shb.head.type = PCAPNG_BLOCK_SHB;
+    shb.head.total_len = sizeof(shb);
+    shb.magic = PCAPNG_BYTE_ORDER_MAGIC;
+    shb.version_major = 1;
+    shb.version_minor = 0;
+    shb.section_len[0] = -1;                            /* the section length is not specified */
+    shb.section_len[1] = -1;
+    shb.total_len = sizeof(shb);
+
+    /* the default timestamp resolution of the interface is microseconds */
+    idb.head.type = PCAPNG_BLOCK_IDB;
+    idb.head.total_len = sizeof(idb);
+    idb.linktype = LINKTYPE_ETHERNET;
+    idb.reserved = 0;
+    idb.snaplen = snaplen;
+    idb.total_len = sizeof(idb);
+
+    tcp_batch_len = 0;
+    rt_tcpdump_tcp_write(&shb, sizeof(shb));
+    rt_tcpdump_tcp_write(&idb, sizeof(idb));
+    if (rt_tcpdump_tcp_flush() == RT_EOK)
+        tcpdump_capture = RT_TRUE;
+}
+
+/* write pcapng enhanced packet block */
+static void rt_tcpdump_pcapng_write(struct tcpdump_buf *p)
+{
+    struct pcapng_epb epb;
+    rt_uint64_t us = (rt_uint64_t)p->tick * 1000000 / RT_TICK_PER_SECOND;
+    rt_uint32_t pad = 0, total_len = sizeof(epb) + RT_ALIGN(p->caplen, 4) + sizeof(total_len);
+
+    epb.head.type = PCAPNG_BLOCK_EPB;
+    epb.head.total_len = total_len;
+    epb.interface_id = 0;
+    epb.ts_high = (rt_uint32_t)(us >> 32);
+    epb.ts_low = (rt_uint32_t)us;
+    epb.caplen = p->caplen;
+    epb.len = p->tot_len;
+
+    capture_write(&epb, sizeof(epb));
+    capture_write(p->buf, p->caplen);
+    capture_write(&pad, RT_ALIGN(p->caplen, 4) - p->caplen);
+    capture_write(&total_len, sizeof(total_len));
+}
+
 /* write ip mess and print */
 static void rt_tcpdump_ip_mess_write(struct tcpdump_buf *p)
 {
@@ -292,14 +601,14 @@ static void rt_tcpdump_ip_mess_write(struct tcpdump_buf *p)
     RT_ASSERT(tbuf != RT_NULL);
 
 #ifdef PKG_NETUTILS_TCPDUMP_PRINT
-    hex_dump(tbuf->buf, tbuf->tot_len);
+    hex_dump(tbuf->buf, tbuf->caplen);
 #endif
 
     /* write ip mess */
-    if (tcpdump_write != RT_NULL)
+    if (capture_write != RT_NULL)
     {
         // rt_kprintf("tbuf->tot_len = %d\n", tbuf->tot_len);
-        tcpdump_write(tbuf->buf, tbuf->tot_len);
+        capture_write(tbuf->buf, tbuf->caplen);
     }
 }
 
@@ -350,51 +659,95 @@ static rt_err_t rt_tcpdump_pcap_file_init(void)
     return RT_EOK;
 }
 
-static void rt_tcpdump_thread_entry(void *param)
+/* write the published slots in order and free them */
+static void rt_tcpdump_ring_drain(void)
 {
-    // struct pbuf *pbuf = RT_NULL;
-    struct tcpdump_buf *tbuf = RT_NULL;
+    struct tcpdump_buf *tbuf;
     struct rt_pcap_pkthdr pkthdr;
-    rt_uint32_t mbval;
 
-    while (1)
+    while (ring_tail != ring_head)
     {
-        if (rt_mb_recv(tcpdump_mb, (rt_ubase_t *)&mbval, RT_WAITING_FOREVER) == RT_EOK)
-        {
-            tbuf = (struct tcpdump_buf *)mbval;
-            RT_ASSERT(tbuf != RT_NULL);
+        tbuf = TCPDUMP_SLOT(ring_tail);
+        if (!tbuf->ready)
+            break;
 
+        if (capture_write == rt_tcpdump_tcp_write)
+        {
+            /* the packets captured before a disconnection are discarded */
+            if (tcp_client >= 0)
+                rt_tcpdump_pcapng_write(tbuf);
+        }
+        else
+        {
             /* write pkthdr */
-            if ((tcpdump_write != RT_NULL) && (tcpdump_write == rt_tcpdump_pcap_file_write))
+            if ((capture_write != RT_NULL) && (capture_write == rt_tcpdump_pcap_file_write))
             {
                 PACP_PKTHDR_CREATE(&pkthdr, tbuf);
-                tcpdump_write(&pkthdr, sizeof(pkthdr));
+                capture_write(&pkthdr, sizeof(pkthdr));
             }
 
 #ifdef  PKG_NETUTILS_TCPDUMP_PRINT
             hex_dump((rt_uint8_t *)&pkthdr, PCAP_PKTHDR_SIZE);
 #endif
             rt_tcpdump_ip_mess_write(tbuf);
-            rt_free(tbuf);
-            tbuf = RT_NULL;
         }
 
-        /* tcpdump deinit, the mailbox does not receive the data, exits the thread*/
-        else
-        {
-            dbg_log(DBG_INFO, "tcpdump stop and tcpdump thread exit!\n");
-            close(fd);
-            fd = -1;
+        tbuf->ready = 0;
+        ring_tail++;
+    }
 
-            if (tcpdump_pipe != RT_NULL)
-                rt_device_close((rt_device_t)tcpdump_pipe);
+    if ((tcp_client >= 0) && (tcp_batch_len > 0))
+        rt_tcpdump_tcp_flush();
+}
 
-            tcpdump_write = RT_NULL;
-            rt_tcpdump_filename_del();
-            rt_tcpdump_ethname_del();
-            return;
+static void rt_tcpdump_thread_entry(void *param)
+{
+    while (tcpdump_running)
+    {
+        if ((capture_write == rt_tcpdump_tcp_write) && (tcp_client < 0))
+        {
+            /* the accept returns after the receive timeout to check the stop request */
+            rt_tcpdump_tcp_accept();
+            rt_tcpdump_ring_drain();
+            continue;
         }
+
+        rt_sem_take(&tcpdump_sem, rt_tick_from_millisecond(TCPDUMP_WAIT_TIME));
+        rt_tcpdump_ring_drain();
     }
+
+    /* tcpdump deinit, exits the thread */
+    dbg_log(DBG_INFO, "tcpdump stop and tcpdump thread exit!\n");
+    if (fd >= 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+
+    if (tcp_client >= 0)
+    {
+        closesocket(tcp_client);
+        tcp_client = -1;
+    }
+    if (tcp_server >= 0)
+    {
+        closesocket(tcp_server);
+        tcp_server = -1;
+    }
+
+    if (tcpdump_pipe != RT_NULL)
+        rt_device_close((rt_device_t)tcpdump_pipe);
+
+    rt_free(tcp_batch);
+    tcp_batch = RT_NULL;
+    rt_free(tcpdump_ring);
+    tcpdump_ring = RT_NULL;
+
+    capture_write = RT_NULL;
+    rt_tcpdump_filename_del();
+    rt_tcpdump_ethname_del();
+    /* the last access of the thread, the deinit detaches the semaphore after it */
+    tcpdump_tid = RT_NULL;
 }
 
 /* set file name */
@@ -427,6 +780,56 @@ static void rt_tcpdump_ethname_del(void)
         rt_free(ethname);
 }
 
+/* listen for the host, the receive timeout lets the thread check the stop request */
+static rt_err_t rt_tcpdump_tcp_server_create(void)
+{
+    struct sockaddr_in addr;
+    struct timeval timeout;
+
+    tcp_batch = rt_malloc(TCPDUMP_TCP_BATCH);
+    if (tcp_batch == RT_NULL)
+    {
+        dbg_log(DBG_ERROR, "tcpdump tcp buffer create fail!\n");
+        return -RT_ERROR;
+    }
+
+    tcp_server = socket(AF_INET, SOCK_STREAM, 0);
+    if (tcp_server < 0)
+    {
+        dbg_log(DBG_ERROR, "tcpdump socket create fail!\n");
+        goto __exit;
+    }
+
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(tcp_port);
+    addr.sin_addr.s_addr = INADDR_ANY;
+    rt_memset(&(addr.sin_zero), 0, sizeof(addr.sin_zero));
+
+    if ((bind(tcp_server, (struct sockaddr *)&addr, sizeof(addr)) < 0) || (listen(tcp_server, 1) < 0))
+    {
+        dbg_log(DBG_ERROR, "tcpdump listen on port %d fail!\n", tcp_port);
+        goto __exit;
+    }
+
+    timeout.tv_sec = TCPDUMP_WAIT_TIME / 1000;
+    timeout.tv_usec = (TCPDUMP_WAIT_TIME % 1000) * 1000;
+    setsockopt(tcp_server, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    rt_kprintf("[TCPDUMP]waiting for the host on port %d, e.g.: nc <ip> %d | wireshark -k -i -\n", tcp_port, tcp_port);
+
+    return RT_EOK;
+
+__exit:
+    if (tcp_server >= 0)
+    {
+        closesocket(tcp_server);
+        tcp_server = -1;
+    }
+    rt_free(tcp_batch);
+    tcp_batch = RT_NULL;
+    return -RT_ERROR;
+}
+
 static int rt_tcpdump_init(void)
 {
     struct eth_device *device;
@@ -434,7 +837,7 @@ static int rt_tcpdump_init(void)
     rt_thread_t tid;
     rt_base_t level;
 
-    if (netif != RT_NULL)
+    if ((netif != RT_NULL) || (tcpdump_tid != RT_NULL))
     {
         dbg_log(DBG_ERROR, "This command is running, please stop before you use the [tcpdump -p] command!\n");
         return -RT_ERROR;
@@ -444,8 +847,12 @@ static int rt_tcpdump_init(void)
     rt_tcpdump_init_indicate();
 
     tcpdump_pipe = rt_device_find(TCPDUMP_PIPE_DEVICE);
-    /* file-system mode does not judge pipe */
-    if (tcpdump_write != rt_tcpdump_pcap_file_write)
+    /* file-system and tcp mode does not judge pipe */
+    if (tcpdump_write == rt_tcpdump_tcp_write)
+    {
+        tcpdump_pipe = RT_NULL;
+    }
+    else if (tcpdump_write != rt_tcpdump_pcap_file_write)
     {
         if (tcpdump_pipe == RT_NULL)
         {
@@ -467,18 +874,40 @@ static int rt_tcpdump_init(void)
         return -RT_ERROR;
     }
 
-    tcpdump_mb = rt_mb_create("tdrmb", TCPDUMP_MAX_MSG, RT_IPC_FLAG_FIFO);
-    if (tcpdump_mb == RT_NULL)
+    /* the capture ring is preallocated, nothing is allocated per packet */
+    tcpdump_ring = rt_malloc(TCPDUMP_RING_SLOTS * TCPDUMP_SLOT_STRIDE);
+    if (tcpdump_ring == RT_NULL)
+    {
+        dbg_log(DBG_ERROR, "tcpdump ring create fail!\n");
+        return -RT_ERROR;
+    }
+    rt_memset(tcpdump_ring, 0, TCPDUMP_RING_SLOTS * TCPDUMP_SLOT_STRIDE);
+    ring_head = ring_tail = 0;
+    ring_producers = 0;
+    rt_memset(&stat, 0, sizeof(stat));
+
+    if ((tcpdump_write == rt_tcpdump_tcp_write) && (rt_tcpdump_tcp_server_create() != RT_EOK))
     {
-        dbg_log(DBG_ERROR, "tcp dump mp create fail!\n");
+        rt_free(tcpdump_ring);
+        tcpdump_ring = RT_NULL;
         return -RT_ERROR;
     }
 
+    rt_sem_init(&tcpdump_sem, "tcpdump", 0, RT_IPC_FLAG_FIFO);
+
     tid = rt_thread_create("tcpdump", rt_tcpdump_thread_entry, RT_NULL, 2048, 12, 10);
     if (tid == RT_NULL)
     {
-        rt_mb_delete(tcpdump_mb);
-        tcpdump_mb = RT_NULL;
+        rt_sem_detach(&tcpdump_sem);
+        rt_free(tcp_batch);
+        tcp_batch = RT_NULL;
+        if (tcp_server >= 0)
+        {
+            closesocket(tcp_server);
+            tcp_server = -1;
+        }
+        rt_free(tcpdump_ring);
+        tcpdump_ring = RT_NULL;
         dbg_log(DBG_ERROR, "tcpdump thread create fail!\n");
         return -RT_ERROR;
     }
@@ -486,6 +915,15 @@ static int rt_tcpdump_init(void)
     rt_tcpdump_filename_set(name);
     rt_tcpdump_ethname_set(eth);
 
+    snaplen = snaplen_arg;
+    filter = filter_arg;
+    /* the stream is sent through the captured interface, it must not capture itself */
+    if (tcpdump_write == rt_tcpdump_tcp_write)
+        filter.exclude_port = tcp_port;
+    capture_write = tcpdump_write;
+    tcpdump_running = RT_TRUE;
+    tcpdump_tid = tid;
+
     netif = device->netif;
 
     /* linkoutput and input init */
@@ -501,6 +939,10 @@ static int rt_tcpdump_init(void)
     /* write pcap file header */
     rt_tcpdump_pcap_file_init();
 
+    /* the tcp mode starts to capture when the host is connected */
+    if (capture_write != rt_tcpdump_tcp_write)
+        tcpdump_capture = RT_TRUE;
+
     rt_thread_startup(tid);
 
     dbg_log(DBG_INFO, "tcpdump start!\n");
@@ -511,7 +953,6 @@ static int rt_tcpdump_init(void)
 static void rt_tcpdump_deinit(void)
 {
     rt_base_t level;
-    struct rt_mailbox *tcpdump_mb_tmp = RT_NULL;
 
     if (netif == RT_NULL)
     {
@@ -521,30 +962,53 @@ static void rt_tcpdump_deinit(void)
 
     /* linkoutput and input deinit */
     level = rt_hw_interrupt_disable();
-    tcpdump_mb_tmp = tcpdump_mb;
-    tcpdump_mb = RT_NULL;
+    tcpdump_capture = RT_FALSE;
     netif->linkoutput = link_output;
     netif->input = input;
     netif = RT_NULL;
     rt_hw_interrupt_enable(level);
     /* linkoutput and input deinit */
 
-    rt_thread_mdelay(10);
-    rt_mb_delete(tcpdump_mb_tmp);
-    tcpdump_mb_tmp = RT_NULL;
+    /* wait for the producers to publish their slots, the thread frees the ring when it exits */
+    while (ring_producers != 0)
+        rt_thread_mdelay(1);
+
+    /* wake up the thread to exit, the thread of the tcp mode may wait for the accept timeout */
+    tcpdump_running = RT_FALSE;
+    rt_sem_release(&tcpdump_sem);
+    while (tcpdump_tid != RT_NULL)
+        rt_thread_mdelay(10);
+    rt_sem_detach(&tcpdump_sem);
+}
+
+static void rt_tcpdump_stat_print(void)
+{
+    rt_kprintf("[TCPDUMP]%s\n", (tcpdump_tid != RT_NULL) ? "running" : "stopped");
+    rt_kprintf("captured  : %u\n", stat.captured);
+    rt_kprintf("filtered  : %u\n", stat.filtered);
+    rt_kprintf("truncated : %u (snaplen %u)\n", stat.truncated, snaplen);
+    rt_kprintf("ring full : %u (%u slots, %u used)\n", stat.ring_full, TCPDUMP_RING_SLOTS, ring_head - ring_tail);
+    rt_kprintf("disconnect: %u\n", stat.disconnect);
 }
 
 static void rt_tcpdump_help_info_print(void)
 {
     rt_kprintf("\n");
     rt_kprintf("|>------------------------- help -------------------------<|\n");
-    rt_kprintf("| tcpdump [-p] [-h] [-i interface] [-m mode] [-w file]     |\n");
+    rt_kprintf("| tcpdump [-p] [-h] [-d] [-i interface] [-m mode] [-w file]|\n");
+    rt_kprintf("|         [-s snaplen] [-f filter] [-t port]               |\n");
     rt_kprintf("|                                                          |\n");
     rt_kprintf("| -h: help                                                 |\n");
     rt_kprintf("| -i: specify the network interface for listening          |\n");
-    rt_kprintf("| -m: choose what mode(file-system or rdb) to save the file|\n");
+    rt_kprintf("| -m: choose the output mode(file-system, rdb or tcp)      |\n");
     rt_kprintf("| -w: write the captured packets into an xx.pcap file      |\n");
     rt_kprintf("| -p: stop capturing packets                               |\n");
+    rt_kprintf("| -d: print the capture and drop counters                  |\n");
+    rt_kprintf("| -s: truncate the packets to the snaplen                  |\n");
+    rt_kprintf("| -f: only capture the matched packets, the conditions are |\n");
+    rt_kprintf("|     separated by comma: arp, ip, ip6, tcp, udp, icmp,    |\n");
+    rt_kprintf("|     host=<ipv4>, port=<n>, type=<ethertype>              |\n");
+    rt_kprintf("| -t: the port of the pcapng stream in tcp mode            |\n");
     rt_kprintf("|                                                          |\n");
     rt_kprintf("| e.g.:                                                    |\n");
     rt_kprintf("| specify network interface and select save mode \\         |\n");
@@ -558,12 +1022,19 @@ static void rt_tcpdump_help_info_print(void)
     rt_kprintf("| -m: rdb mode                                             |\n");
     rt_kprintf("| tcpdump -mrdb                                            |\n");
     rt_kprintf("|                                                          |\n");
+    rt_kprintf("| -m: tcp mode, stream pcapng to the host                  |\n");
+    rt_kprintf("| tcpdump -mtcp -t2000 -s128 -ftcp,port=80                 |\n");
+    rt_kprintf("| nc <board ip> 2000 | wireshark -k -i -                   |\n");
+    rt_kprintf("|                                                          |\n");
     rt_kprintf("| -w: file                                                 |\n");
     rt_kprintf("| tcpdump -wtext.pcap                                      |\n");
     rt_kprintf("|                                                          |\n");
     rt_kprintf("| -p: stop                                                 |\n");
     rt_kprintf("| tcpdump -p                                               |\n");
     rt_kprintf("|                                                          |\n");
+    rt_kprintf("| -d: counters                                             |\n");
+    rt_kprintf("| tcpdump -d                                               |\n");
+    rt_kprintf("|                                                          |\n");
     rt_kprintf("| -h: help                                                 |\n");
     rt_kprintf("| tcpdump -h                                               |\n");
     rt_kprintf("|                                                          |\n");
@@ -615,15 +1086,66 @@ static void rt_tcpdump_init_indicate(void)
 
         if (STRCMP(mode, ==, "rdb"))
             rt_kprintf("[TCPDUMP]select  [rdb] mode\n");
+
+        if (STRCMP(mode, ==, "tcp"))
+            rt_kprintf("[TCPDUMP]select  [tcp] mode\n");
     }
 
     if (name_flag == 0)
         rt_kprintf("[TCPDUMP]save in [%s]\n", name);
 }
 
+/* parse the filter conditions, e.g.: "tcp,host=192.168.1.10,port=80" */
+static int rt_tcpdump_filter_parse(char *str, struct tcpdump_filter *f)
+{
+    char *cond, *next, *value;
+
+    rt_memset(f, 0, sizeof(*f));
+
+    for (cond = str; cond != RT_NULL; cond = next)
+    {
+        next = strchr(cond, ',');
+        if (next != RT_NULL)
+            *next++ = '\0';
+
+        value = strchr(cond, '=');
+        if (value != RT_NULL)
+            *value++ = '\0';
+
+        if (STRCMP(cond, ==, "arp"))
+            f->type = 0x0806;
+        else if (STRCMP(cond, ==, "ip"))
+            f->type = 0x0800;
+        else if (STRCMP(cond, ==, "ip6"))
+            f->type = 0x86DD;
+        else if (STRCMP(cond, ==, "icmp"))
+            f->proto = 1;
+        else if (STRCMP(cond, ==, "tcp"))
+            f->proto = 6;
+        else if (STRCMP(cond, ==, "udp"))
+            f->proto = 17;
+        else if (STRCMP(cond, ==, "host") && (value != RT_NULL))
+        {
+            f->host = inet_addr(value);
+            if (f->host == IPADDR_NONE)
+                return -RT_ERROR;
+        }
+        else if (STRCMP(cond, ==, "port") && (value != RT_NULL))
+            f->port = atoi(value);
+        else if (STRCMP(cond, ==, "type") && (value != RT_NULL))
+            f->type = strtoul(value, RT_NULL, 16);
+        else
+            return -RT_ERROR;
+    }
+
+    return RT_EOK;
+}
+
 /* msh command-line deal */
 static int rt_tcpdump_cmd_deal(struct optparse *options)
 {
+    int len;
+
     switch (options->optopt)
     {
     case 'p':
@@ -634,6 +1156,10 @@ static int rt_tcpdump_cmd_deal(struct optparse *options)
         rt_tcpdump_help_info_print();
         return HELP;
 
+    case 'd':
+        rt_tcpdump_stat_print();
+        return HELP;
+
     case 'i':
         /* it's illegal without parameters. */
         if (options->optarg == RT_NULL)
@@ -660,6 +1186,13 @@ static int rt_tcpdump_cmd_deal(struct optparse *options)
             return RT_EOK;
         }
 
+        if (STRCMP(options->optarg, ==, "tcp"))
+        {
+            mode = options->optarg;
+            tcpdump_write = rt_tcpdump_tcp_write;
+            return RT_EOK;
+        }
+
         /* User input Error */
         return -RT_ERROR;
 
@@ -670,6 +1203,30 @@ static int rt_tcpdump_cmd_deal(struct optparse *options)
         name = options->optarg;
         break;
 
+    case 's':
+        if (options->optarg == RT_NULL)
+            return -RT_ERROR;
+
+        /* the snaplen is limited by the slot size */
+        len = atoi(options->optarg);
+        if ((len <= 0) || (len > PKG_NETUTILS_TCPDUMP_SLOT_SIZE))
+            len = PKG_NETUTILS_TCPDUMP_SLOT_SIZE;
+        snaplen_arg = len;
+        break;
+
+    case 'f':
+        if (options->optarg == RT_NULL)
+            return -RT_ERROR;
+
+        return rt_tcpdump_filter_parse(options->optarg, &filter_arg);
+
+    case 't':
+        if (options->optarg == RT_NULL)
+            return -RT_ERROR;
+
+        tcp_port = atoi(options->optarg);
+        break;
+
     default:
         return -RT_ERROR;
     }
@@ -698,6 +1255,9 @@ static int rt_tcpdump_cmd_parse(char *argv[], const char *cmd)
         case 'h':
             return rt_tcpdump_cmd_deal(&options);
 
+        case 'd':
+            return rt_tcpdump_cmd_deal(&options);
+
         case 'i':
             res = rt_tcpdump_cmd_deal(&options);
             break;
@@ -710,6 +1270,18 @@ static int rt_tcpdump_cmd_parse(char *argv[], const char *cmd)
             res = rt_tcpdump_cmd_deal(&options);
             break;
 
+        case 's':
+            res = rt_tcpdump_cmd_deal(&options);
+            break;
+
+        case 'f':
+            res = rt_tcpdump_cmd_deal(&options);
+            break;
+
+        case 't':
+            res = rt_tcpdump_cmd_deal(&options);
+            break;
+
         default:
             rt_tcpdump_error_info_deal();
             return -RT_ERROR;
@@ -737,6 +1309,9 @@ static void rt_tcpdump_cmd_argv_deinit(void)
     eth = RT_NULL;
     tcpdump_write = RT_NULL;
     name = RT_NULL;
+    snaplen_arg = PKG_NETUTILS_TCPDUMP_SLOT_SIZE;
+    rt_memset(&filter_arg, 0, sizeof(filter_arg));
+    tcp_port = PKG_NETUTILS_TCPDUMP_TCP_PORT;
 }
 
 static int tcpdump_test(int argc, char *argv[])
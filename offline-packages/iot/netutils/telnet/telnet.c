@@ -7,13 +7,16 @@
  * Date           Author       Notes
  * 2012-04-01     Bernard      first version
  * 2018-01-25     armink       Fix it on RT-Thread 3.0+
+ * 2024-10-19     Evlers       add multiple sessions, the coalescing tx buffer and the scan-based IAC parser
  */
 
 #include <rtdevice.h>
+#include <stdlib.h>
 
 #ifdef PKG_NETUTILS_TELNET
 #if defined(RT_USING_DFS_NET) || defined(SAL_USING_POSIX)
 #include <sys/socket.h>
+#include <sys/select.h>
 #else
 #include <lwip/sockets.h>
 #endif /* defined(RT_USING_DFS_NET) || defined(SAL_USING_POSIX) */
@@ -36,10 +39,33 @@ static int dev_old_flag;
 #include <msh.h>
 #include <shell.h>
 
+#ifndef PKG_NETUTILS_TELNET_MAX_SESSIONS
+#define PKG_NETUTILS_TELNET_MAX_SESSIONS    2
+#endif
+#ifndef PKG_NETUTILS_TELNET_TX_BUFFER_SIZE
+#define PKG_NETUTILS_TELNET_TX_BUFFER_SIZE  4096
+#endif
+#ifndef PKG_NETUTILS_TELNET_FLUSH_SIZE
+#define PKG_NETUTILS_TELNET_FLUSH_SIZE      1024
+#endif
+#ifndef PKG_NETUTILS_TELNET_FLUSH_TIMEOUT
+#define PKG_NETUTILS_TELNET_FLUSH_TIMEOUT   20
+#endif
+
 #define TELNET_PORT         23
 #define TELNET_BACKLOG      5
 #define RX_BUFFER_SIZE      256
-#define TX_BUFFER_SIZE      4096
+/* the tx buffer of each session, it MUST be power of 2 */
+#define TX_BUFFER_SIZE      PKG_NETUTILS_TELNET_TX_BUFFER_SIZE
+/* the tx buffer is sent when it has so much data, or the data is older than the timeout (ms) */
+#define TX_FLUSH_SIZE       PKG_NETUTILS_TELNET_FLUSH_SIZE
+#define TX_FLUSH_TIMEOUT    PKG_NETUTILS_TELNET_FLUSH_TIMEOUT
+/* the shell waits so long (ms) for a client which doesn't read, then its output is dropped until it reads */
+#define TX_WAIT_TIMEOUT     1000
+
+#if (TX_BUFFER_SIZE & (TX_BUFFER_SIZE - 1)) || (TX_FLUSH_SIZE > TX_BUFFER_SIZE)
+#error "The telnet tx buffer size must be power of 2 and not less than the flush size"
+#endif
 
 #define ISO_nl              0x0a
 #define ISO_cr              0x0d
@@ -51,151 +77,366 @@ static int dev_old_flag;
 #define STATE_DO            4
 #define STATE_DONT          5
 #define STATE_CLOSE         6
+#define STATE_SB            7
+#define STATE_SB_IAC        8
 
 #define TELNET_IAC          255
 #define TELNET_WILL         251
 #define TELNET_WONT         252
 #define TELNET_DO           253
 #define TELNET_DONT         254
+#define TELNET_SB           250
+#define TELNET_SE           240
 
 struct telnet_session
+{
+    rt_int32_t client_fd;           /* -1: the session is free */
+
+    /* telnet protocol */
+    rt_uint8_t state;
+
+    /* the output is sent when the socket is writable */
+    rt_bool_t tx_blocked;
+    /* the shell waits for the tx buffer space out of the tx lock */
+    rt_bool_t tx_waiting;
+    rt_sem_t tx_space;
+    /* the client didn't read in the wait timeout, the output is dropped until it reads */
+    rt_bool_t tx_stalled;
+    /* the output buffer, the indexes are free running */
+    rt_uint8_t *tx_buffer;
+    rt_uint32_t tx_head;
+    rt_uint32_t tx_tail;
+    rt_tick_t tx_tick;              /* the tick of the oldest output which isn't sent */
+};
+
+struct telnet_server
 {
     struct rt_ringbuffer rx_ringbuffer;
-    struct rt_ringbuffer tx_ringbuffer;
 
     rt_mutex_t rx_ringbuffer_lock;
-    rt_mutex_t tx_ringbuffer_lock;
+    rt_mutex_t tx_lock;
 
     struct rt_device device;
     rt_int32_t server_fd;
-    rt_int32_t client_fd;
 
-    /* telnet protocol */
-    rt_uint8_t state;
     rt_uint8_t echo_mode;
+    rt_uint8_t session_num;
+    struct telnet_session session[PKG_NETUTILS_TELNET_MAX_SESSIONS];
 
     rt_sem_t read_notice;
+    rt_thread_t thread;
+
+    /* statistics */
+    rt_uint32_t tx_bytes;
+    rt_uint32_t tx_sends;
+    rt_uint32_t tx_drops;
 };
 
-static struct telnet_session* telnet;
+static struct telnet_server* telnet;
+
+#define SCAN_ONES           0x01010101UL
+#define SCAN_HIGHS          0x80808080UL
+/* the word has a zero byte */
+#define SCAN_HAS_ZERO(w)    (((w) - SCAN_ONES) & ~(w) & SCAN_HIGHS)
 
-/* process tx data */
-static void send_to_client(struct telnet_session* telnet)
+/* find the first c1 or c2 in the data, it checks a word per loop */
+static rt_size_t telnet_scan(const rt_uint8_t *data, rt_size_t length, rt_uint8_t c1, rt_uint8_t c2)
 {
-    rt_size_t length;
-    rt_uint8_t tx_buffer[32];
+    const rt_uint8_t *ptr = data, *end = data + length;
+    rt_uint32_t mask1 = c1 * SCAN_ONES, mask2 = c2 * SCAN_ONES, word;
 
-    while (1)
+    while (ptr < end && ((rt_ubase_t) ptr & (sizeof(rt_uint32_t) - 1)))
+    {
+        if (*ptr == c1 || *ptr == c2)
+            return ptr - data;
+        ptr++;
+    }
+    while (ptr + sizeof(rt_uint32_t) <= end)
+    {
+        word = *(const rt_uint32_t *) ptr;
+        if (SCAN_HAS_ZERO(word ^ mask1) || SCAN_HAS_ZERO(word ^ mask2))
+            break;
+        ptr += sizeof(rt_uint32_t);
+    }
+    while (ptr < end && *ptr != c1 && *ptr != c2)
+    {
+        ptr++;
+    }
+
+    return ptr - data;
+}
+
+/* send the output in the session tx buffer, MSG_DONTWAIT: it doesn't block on the socket */
+static void send_to_client(struct telnet_session* session, int flags)
+{
+    rt_uint32_t offset, length;
+    int sent;
+
+    session->tx_blocked = RT_FALSE;
+    while ((length = session->tx_head - session->tx_tail) > 0)
+    {
+        offset = session->tx_tail & (TX_BUFFER_SIZE - 1);
+        if (length > TX_BUFFER_SIZE - offset)
+            length = TX_BUFFER_SIZE - offset;
+
+        sent = send(session->client_fd, session->tx_buffer + offset, length, flags);
+        if (sent <= 0)
+        {
+            if (flags & MSG_DONTWAIT)
+            {
+                /* the socket buffer is full, the telnet thread sends it when the socket is writable */
+                session->tx_blocked = RT_TRUE;
+            }
+            else
+            {
+                /* the connection is broken, the telnet thread will close it */
+                telnet->tx_drops += session->tx_head - session->tx_tail;
+                session->tx_tail = session->tx_head;
+            }
+            break;
+        }
+        session->tx_tail += sent;
+        session->tx_stalled = RT_FALSE;
+        telnet->tx_bytes += sent;
+        telnet->tx_sends++;
+        if (session->tx_waiting)
+        {
+            session->tx_waiting = RT_FALSE;
+            rt_sem_release(session->tx_space);
+        }
+    }
+}
+
+/* copy data to the session tx buffer, it never blocks on the socket, return the length copied */
+static rt_size_t tx_put(struct telnet_session* session, const rt_uint8_t *data, rt_size_t length)
+{
+    rt_uint32_t offset, space, part;
+    rt_size_t copied = 0;
+
+    while (length > 0)
+    {
+        space = TX_BUFFER_SIZE - (session->tx_head - session->tx_tail);
+        if (space == 0 && !session->tx_blocked)
+        {
+            send_to_client(session, MSG_DONTWAIT);
+            space = TX_BUFFER_SIZE - (session->tx_head - session->tx_tail);
+        }
+        if (space == 0)
+            break;
+        if (session->tx_head == session->tx_tail)
+            session->tx_tick = rt_tick_get();
+
+        offset = session->tx_head & (TX_BUFFER_SIZE - 1);
+        part = TX_BUFFER_SIZE - offset;
+        if (part > length)
+            part = length;
+        if (part > space)
+            part = space;
+        rt_memcpy(session->tx_buffer + offset, data, part);
+        session->tx_head += part;
+        data += part;
+        length -= part;
+        copied += part;
+    }
+
+    return copied;
+}
+
+/**
+ * wait for the telnet thread to send the output when the tx buffer is full, the tx lock is released
+ * while waiting, so a client which doesn't read never blocks the telnet thread and the other sessions.
+ * return RT_FALSE when the output should be dropped: the client is stalled or closed.
+ */
+static rt_bool_t tx_wait(struct telnet_session* session)
+{
+    rt_int32_t client_fd = session->client_fd;
+    rt_err_t result;
+
+    /* the telnet thread can't wait for itself */
+    if (session->tx_stalled || rt_thread_self() == telnet->thread)
+        return RT_FALSE;
+
+    session->tx_waiting = RT_TRUE;
+    rt_mutex_release(telnet->tx_lock);
+    result = rt_sem_take(session->tx_space, rt_tick_from_millisecond(TX_WAIT_TIMEOUT));
+    rt_mutex_take(telnet->tx_lock, RT_WAITING_FOREVER);
+    session->tx_waiting = RT_FALSE;
+
+    if (session->client_fd != client_fd)
+        return RT_FALSE;
+    if (result != RT_EOK && session->tx_head - session->tx_tail == TX_BUFFER_SIZE)
     {
-        rt_memset(tx_buffer, 0, sizeof(tx_buffer));
-        rt_mutex_take(telnet->tx_ringbuffer_lock, RT_WAITING_FOREVER);
-        /* get buffer from ringbuffer */
-        length = rt_ringbuffer_get(&(telnet->tx_ringbuffer), tx_buffer, sizeof(tx_buffer));
-        rt_mutex_release(telnet->tx_ringbuffer_lock);
-
-        /* do a tx procedure */
-        if (length > 0)
+        session->tx_stalled = RT_TRUE;
+        return RT_FALSE;
+    }
+
+    return RT_TRUE;
+}
+
+/* copy the shell output to the session tx buffer, return the length dropped */
+static rt_size_t tx_write(struct telnet_session* session, const rt_uint8_t *data, rt_size_t length)
+{
+    rt_size_t copied;
+
+    while (length > 0)
+    {
+        copied = tx_put(session, data, length);
+        data += copied;
+        length -= copied;
+        if (length > 0 && !tx_wait(session))
+            break;
+    }
+
+    return length;
+}
+
+/* send the output of all sessions when it's enough or too old */
+static void send_to_clients(rt_bool_t force)
+{
+    struct telnet_session* session;
+    rt_uint32_t length;
+
+    rt_mutex_take(telnet->tx_lock, RT_WAITING_FOREVER);
+    for (session = telnet->session; session < telnet->session + PKG_NETUTILS_TELNET_MAX_SESSIONS; session++)
+    {
+        length = session->tx_head - session->tx_tail;
+        if (session->client_fd < 0 || length == 0 || session->tx_blocked)
+            continue;
+        if (force || length >= TX_FLUSH_SIZE
+                || rt_tick_get() - session->tx_tick >= rt_tick_from_millisecond(TX_FLUSH_TIMEOUT))
         {
-            send(telnet->client_fd, tx_buffer, length, 0);
+            send_to_client(session, MSG_DONTWAIT);
         }
-        else break;
     }
+    rt_mutex_release(telnet->tx_lock);
 }
 
 /* send telnet option to remote */
-static void send_option_to_client(struct telnet_session* telnet, rt_uint8_t option, rt_uint8_t value)
+static void send_option_to_client(struct telnet_session* session, rt_uint8_t option, rt_uint8_t value)
 {
-    rt_uint8_t optbuf[4];
+    rt_uint8_t optbuf[3];
 
     optbuf[0] = TELNET_IAC;
     optbuf[1] = option;
     optbuf[2] = value;
-    optbuf[3] = 0;
 
-    rt_mutex_take(telnet->tx_ringbuffer_lock, RT_WAITING_FOREVER);
-    rt_ringbuffer_put(&telnet->tx_ringbuffer, optbuf, 3);
-    rt_mutex_release(telnet->tx_ringbuffer_lock);
-
-    send_to_client(telnet);
+    /* it's sent after the received data is processed, it's dropped when the client doesn't read */
+    rt_mutex_take(telnet->tx_lock, RT_WAITING_FOREVER);
+    if (session->tx_head - session->tx_tail > TX_BUFFER_SIZE - sizeof(optbuf) && !session->tx_blocked)
+    {
+        send_to_client(session, MSG_DONTWAIT);
+    }
+    if (session->tx_head - session->tx_tail <= TX_BUFFER_SIZE - sizeof(optbuf))
+    {
+        tx_put(session, optbuf, sizeof(optbuf));
+    }
+    else
+    {
+        telnet->tx_drops += sizeof(optbuf);
+    }
+    rt_mutex_release(telnet->tx_lock);
 }
 
 /* process rx data */
-static void process_rx(struct telnet_session* telnet, rt_uint8_t *data, rt_size_t length)
+static void process_rx(struct telnet_session* session, rt_uint8_t *data, rt_size_t length)
 {
-    rt_size_t index;
+    rt_size_t run, rx_length = 0;
 
-    for (index = 0; index < length; index++)
+    rt_mutex_take(telnet->rx_ringbuffer_lock, RT_WAITING_FOREVER);
+    while (length > 0)
     {
-        switch (telnet->state)
+        if (session->state == STATE_NORMAL)
         {
-        case STATE_IAC:
-            if (*data == TELNET_IAC)
+            /* put the input before next IAC or '\r' to ringbuffer at once */
+            run = telnet_scan(data, length, TELNET_IAC, ISO_cr);
+            rx_length += rt_ringbuffer_put(&(telnet->rx_ringbuffer), data, run);
+            if (run < length)
             {
-                rt_mutex_take(telnet->rx_ringbuffer_lock, RT_WAITING_FOREVER);
-                /* put buffer to ringbuffer */
-                rt_ringbuffer_putchar(&(telnet->rx_ringbuffer), *data);
-                rt_mutex_release(telnet->rx_ringbuffer_lock);
-
-                telnet->state = STATE_NORMAL;
+                /* ignore '\r' */
+                if (data[run] == TELNET_IAC)
+                    session->state = STATE_IAC;
+                run++;
             }
-            else
+            data += run;
+            length -= run;
+            continue;
+        }
+
+        switch (session->state)
+        {
+        case STATE_IAC:
+            /* set telnet state according to received package */
+            switch (*data)
             {
-                /* set telnet state according to received package */
-                switch (*data)
-                {
-                case TELNET_WILL:
-                    telnet->state = STATE_WILL;
-                    break;
-                case TELNET_WONT:
-                    telnet->state = STATE_WONT;
-                    break;
-                case TELNET_DO:
-                    telnet->state = STATE_DO;
-                    break;
-                case TELNET_DONT:
-                    telnet->state = STATE_DONT;
-                    break;
-                default:
-                    telnet->state = STATE_NORMAL;
-                    break;
-                }
+            case TELNET_IAC:
+                rx_length += rt_ringbuffer_putchar(&(telnet->rx_ringbuffer), *data);
+                session->state = STATE_NORMAL;
+                break;
+            case TELNET_WILL:
+                session->state = STATE_WILL;
+                break;
+            case TELNET_WONT:
+                session->state = STATE_WONT;
+                break;
+            case TELNET_DO:
+                session->state = STATE_DO;
+                break;
+            case TELNET_DONT:
+                session->state = STATE_DONT;
+                break;
+            case TELNET_SB:
+                session->state = STATE_SB;
+                break;
+            default:
+                session->state = STATE_NORMAL;
+                break;
             }
             break;
 
             /* don't option */
         case STATE_WILL:
-        case STATE_WONT:
-            send_option_to_client(telnet, TELNET_DONT, *data);
-            telnet->state = STATE_NORMAL;
+            send_option_to_client(session, TELNET_DONT, *data);
+            session->state = STATE_NORMAL;
             break;
 
             /* won't option */
         case STATE_DO:
+            send_option_to_client(session, TELNET_WONT, *data);
+            session->state = STATE_NORMAL;
+            break;
+
+            /* the option is disabled already, don't acknowledge it (RFC 854) */
+        case STATE_WONT:
         case STATE_DONT:
-            send_option_to_client(telnet, TELNET_WONT, *data);
-            telnet->state = STATE_NORMAL;
+            session->state = STATE_NORMAL;
             break;
 
-        case STATE_NORMAL:
-            if (*data == TELNET_IAC)
-            {
-                telnet->state = STATE_IAC;
-            }
-            else if (*data != '\r') /* ignore '\r' */
-            {
-                rt_mutex_take(telnet->rx_ringbuffer_lock, RT_WAITING_FOREVER);
-                /* put buffer to ringbuffer */
-                rt_ringbuffer_putchar(&(telnet->rx_ringbuffer), *data);
-                rt_mutex_release(telnet->rx_ringbuffer_lock);
-                rt_sem_release(telnet->read_notice);
-            }
+            /* skip the sub-negotiation until IAC SE */
+        case STATE_SB:
+            run = telnet_scan(data, length, TELNET_IAC, TELNET_IAC);
+            if (run < length)
+                session->state = STATE_SB_IAC;
+            else
+                run = length - 1;
+            data += run;
+            length -= run;
+            break;
+
+        case STATE_SB_IAC:
+            session->state = (*data == TELNET_SE) ? STATE_NORMAL : STATE_SB;
             break;
         }
         data++;
+        length--;
+    }
+    rt_mutex_release(telnet->rx_ringbuffer_lock);
+
+    if (rx_length > 0)
+    {
+        rt_sem_release(telnet->read_notice);
     }
 
 #if !(defined(RT_USING_POSIX_STDIO) || defined(RT_USING_POSIX))
-    rt_size_t rx_length;
     rt_mutex_take(telnet->rx_ringbuffer_lock, RT_WAITING_FOREVER);
     /* get total size */
     rx_length = rt_ringbuffer_data_len(&telnet->rx_ringbuffer);
@@ -211,9 +452,88 @@ static void process_rx(struct telnet_session* telnet, rt_uint8_t *data, rt_size_
     return;
 }
 
+/* client open */
+static void client_open(struct telnet_session* session, rt_int32_t client_fd)
+{
+    rt_mutex_take(telnet->tx_lock, RT_WAITING_FOREVER);
+    session->state = STATE_NORMAL;
+    session->tx_blocked = RT_FALSE;
+    session->tx_stalled = RT_FALSE;
+    session->tx_head = session->tx_tail = 0;
+    session->client_fd = client_fd;
+    rt_mutex_release(telnet->tx_lock);
+
+    if (telnet->session_num++ > 0)
+    {
+        /* the console is telnet already, output the shell prompt to the new client */
+        const char *prompt = FINSH_PROMPT;
+
+        rt_mutex_take(telnet->tx_lock, RT_WAITING_FOREVER);
+        tx_put(session, (const rt_uint8_t *) prompt, rt_strlen(prompt));
+        send_to_client(session, MSG_DONTWAIT);
+        rt_mutex_release(telnet->tx_lock);
+        return;
+    }
+
+    /* process the new connection */
+    /* set console */
+    rt_console_set_device("telnet");
+
+    /* set finsh device */
+#if defined(RT_USING_POSIX_STDIO) || defined(RT_USING_POSIX)
+    /* backup flag */
+    dev_old_flag = ioctl(libc_stdio_get_console(), F_GETFL, (void *) RT_NULL);
+    /* add non-block flag */
+    ioctl(libc_stdio_get_console(), F_SETFL, (void *) (dev_old_flag | O_NONBLOCK));
+    /* set tcp shell device for console */
+    libc_stdio_set_console("telnet", O_RDWR);
+    /* resume finsh thread, make sure it will unblock from last device receive */
+    rt_thread_t tid = rt_thread_find(FINSH_THREAD_NAME);
+    if (tid)
+    {
+        rt_thread_resume(tid);
+        rt_schedule();
+    }
+#else
+    /* set finsh device */
+    finsh_set_device("telnet");
+#endif /* defined(RT_USING_POSIX_STDIO) || defined(RT_USING_POSIX) */
+
+    telnet->echo_mode = finsh_get_echo();
+    /* disable echo mode */
+    finsh_set_echo(0);
+    /* output RT-Thread version and shell prompt */
+#ifdef FINSH_USING_MSH
+    msh_exec("version", rt_strlen("version"));
+#endif /* FINSH_USING_MSH */
+    rt_kprintf(FINSH_PROMPT);
+}
+
 /* client close */
-static void client_close(struct telnet_session* telnet)
+static void client_close(struct telnet_session* session)
 {
+    rt_int32_t client_fd;
+
+    rt_mutex_take(telnet->tx_lock, RT_WAITING_FOREVER);
+    client_fd = session->client_fd;
+    session->client_fd = -1;
+    if (session->tx_waiting)
+    {
+        /* wake up the shell which is waiting for the client */
+        session->tx_waiting = RT_FALSE;
+        rt_sem_release(session->tx_space);
+    }
+    rt_mutex_release(telnet->tx_lock);
+
+    /* close connection */
+    closesocket(client_fd);
+
+    if (--telnet->session_num > 0)
+    {
+        rt_kprintf("telnet: client closed, %d client(s) connected\n", telnet->session_num);
+        return;
+    }
+
     /* set console */
     rt_console_set_device(RT_CONSOLE_DEVICE_NAME);
     /* set finsh device */
@@ -226,9 +546,6 @@ static void client_close(struct telnet_session* telnet)
 
     rt_sem_release(telnet->read_notice);
 
-    /* close connection */
-    closesocket(telnet->client_fd);
-
     /* restore shell option */
     finsh_set_echo(telnet->echo_mode);
 
@@ -255,11 +572,19 @@ static rt_ssize_t telnet_read(rt_device_t dev, rt_off_t pos, void* buffer, rt_si
 {
     rt_ssize_t result;
 
+    /* the shell is waiting for the input, so the output is complete */
+    send_to_clients(RT_TRUE);
+
     rt_sem_take(telnet->read_notice, RT_WAITING_FOREVER);
 
     /* read from rx ring buffer */
     rt_mutex_take(telnet->rx_ringbuffer_lock, RT_WAITING_FOREVER);
     result = rt_ringbuffer_get(&(telnet->rx_ringbuffer), buffer, size);
+    if (rt_ringbuffer_data_len(&telnet->rx_ringbuffer) > 0)
+    {
+        /* the notice is released once per received chunk, keep it for the rest */
+        rt_sem_release(telnet->read_notice);
+    }
     if (result == 0)
     {
         /**
@@ -276,27 +601,44 @@ static rt_ssize_t telnet_read(rt_device_t dev, rt_off_t pos, void* buffer, rt_si
 
 static rt_ssize_t telnet_write (rt_device_t dev, rt_off_t pos, const void* buffer, rt_size_t size)
 {
-    const rt_uint8_t *ptr;
-
-    ptr = (rt_uint8_t*) buffer;
+    const rt_uint8_t *data = (const rt_uint8_t *) buffer;
+    struct telnet_session* session;
+    rt_size_t run, length, dropped;
 
-    rt_mutex_take(telnet->tx_ringbuffer_lock, RT_WAITING_FOREVER);
-    while (size)
+    rt_mutex_take(telnet->tx_lock, RT_WAITING_FOREVER);
+    for (session = telnet->session; session < telnet->session + PKG_NETUTILS_TELNET_MAX_SESSIONS; session++)
     {
-        if (*ptr == '\n')
-            rt_ringbuffer_putchar(&telnet->tx_ringbuffer, '\r');
+        if (session->client_fd < 0)
+            continue;
 
-        if (rt_ringbuffer_putchar(&telnet->tx_ringbuffer, *ptr) == 0) /* overflow */
-            break;
-        ptr++;
-        size--;
-    }
-    rt_mutex_release(telnet->tx_ringbuffer_lock);
+        /* copy the runs between the '\n' and IAC, '\n' is sent as "\r\n" and IAC is escaped */
+        for (data = (const rt_uint8_t *) buffer, length = size; length > 0; data += run, length -= run)
+        {
+            run = telnet_scan(data, length, ISO_nl, TELNET_IAC);
+            dropped = tx_write(session, data, run);
+            if (dropped == 0 && run < length)
+            {
+                dropped = tx_write(session, (const rt_uint8_t *) (data[run] == ISO_nl ? "\r\n" : "\xff\xff"), 2);
+                run++;
+            }
+            if (dropped > 0)
+            {
+                /* the client is stalled or closed, drop the rest of the output for it */
+                if (session->client_fd >= 0)
+                    telnet->tx_drops += dropped + length - run;
+                break;
+            }
+        }
 
-    /* send data to telnet client */
-    send_to_client(telnet);
+        /* send it when there is a segment of data, the rest is sent by the telnet thread or before reading */
+        if (session->tx_head - session->tx_tail >= TX_FLUSH_SIZE && !session->tx_blocked)
+        {
+            send_to_client(session, MSG_DONTWAIT);
+        }
+    }
+    rt_mutex_release(telnet->tx_lock);
 
-    return (rt_uint32_t) ptr - (rt_uint32_t) buffer;
+    return size;
 }
 
 static rt_err_t telnet_control(rt_device_t dev, int cmd, void *args)
@@ -324,6 +666,10 @@ static void telnet_thread(void* parameter)
     rt_uint8_t recv_buf[RECV_BUF_LEN];
     rt_int32_t recv_len = 0;
     rt_int32_t keepalive = 1;
+    rt_int32_t client_fd, max_fd;
+    struct telnet_session* session;
+    struct timeval timeout;
+    fd_set readset, writeset;
 
     if ((telnet->server_fd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
     {
@@ -372,71 +718,90 @@ static void telnet_thread(void* parameter)
     /* register telnet device */
     rt_device_register(&telnet->device, "telnet", RT_DEVICE_FLAG_RDWR | RT_DEVICE_FLAG_STREAM);
 
+    rt_kprintf("telnet: waiting for connection\n");
+
     while (1)
     {
-        rt_kprintf("telnet: waiting for connection\n");
-
-        /* grab new connection */
-        if ((telnet->client_fd = accept(telnet->server_fd, (struct sockaddr *) &addr, &addr_size)) == -1)
+        FD_ZERO(&readset);
+        FD_ZERO(&writeset);
+        FD_SET(telnet->server_fd, &readset);
+        max_fd = telnet->server_fd;
+        for (session = telnet->session; session < telnet->session + PKG_NETUTILS_TELNET_MAX_SESSIONS; session++)
         {
-            continue;
+            if (session->client_fd < 0)
+                continue;
+            FD_SET(session->client_fd, &readset);
+            if (session->tx_blocked)
+                FD_SET(session->client_fd, &writeset);
+            if (session->client_fd > max_fd)
+                max_fd = session->client_fd;
         }
 
-        rt_kprintf("telnet: new telnet client(%s:%d) connection, switch console to telnet...\n", inet_ntoa(addr.sin_addr), addr.sin_port);
-
-        /* process the new connection */
-        /* set console */
-        rt_console_set_device("telnet");
-
-        /* set finsh device */
-#if defined(RT_USING_POSIX_STDIO) || defined(RT_USING_POSIX)
-        /* backup flag */
-        dev_old_flag = ioctl(libc_stdio_get_console(), F_GETFL, (void *) RT_NULL);
-        /* add non-block flag */
-        ioctl(libc_stdio_get_console(), F_SETFL, (void *) (dev_old_flag | O_NONBLOCK));
-        /* set tcp shell device for console */
-        libc_stdio_set_console("telnet", O_RDWR);
-        /* resume finsh thread, make sure it will unblock from last device receive */
-        rt_thread_t tid = rt_thread_find(FINSH_THREAD_NAME);
-        if (tid)
+        /* wake up at the flush timeout to send the buffered output of other threads */
+        timeout.tv_sec = 0;
+        timeout.tv_usec = TX_FLUSH_TIMEOUT * 1000;
+        if (select(max_fd + 1, &readset, &writeset, RT_NULL, telnet->session_num > 0 ? &timeout : RT_NULL) < 0)
         {
-            rt_thread_resume(tid);
-            rt_schedule();
+            rt_thread_mdelay(TX_FLUSH_TIMEOUT);
+            continue;
         }
-#else
-        /* set finsh device */
-        finsh_set_device("telnet");
-#endif /* defined(RT_USING_POSIX_STDIO) || defined(RT_USING_POSIX) */
-
-        /* set init state */
-        telnet->state = STATE_NORMAL;
 
-        telnet->echo_mode = finsh_get_echo();
-        /* disable echo mode */
-        finsh_set_echo(0);
-        /* output RT-Thread version and shell prompt */
-#ifdef FINSH_USING_MSH
-        msh_exec("version", rt_strlen("version"));
-#endif /* FINSH_USING_MSH */
-        rt_kprintf(FINSH_PROMPT);
-
-        while (1)
+        for (session = telnet->session; session < telnet->session + PKG_NETUTILS_TELNET_MAX_SESSIONS; session++)
         {
-            /* try to send all data in tx ringbuffer */
-            send_to_client(telnet);
+            if (session->client_fd < 0)
+                continue;
+
+            if (FD_ISSET(session->client_fd, &writeset))
+            {
+                rt_mutex_take(telnet->tx_lock, RT_WAITING_FOREVER);
+                send_to_client(session, MSG_DONTWAIT);
+                rt_mutex_release(telnet->tx_lock);
+            }
 
             /* do a rx procedure */
-            if ((recv_len = recv(telnet->client_fd, recv_buf, RECV_BUF_LEN, 0)) > 0)
+            if (FD_ISSET(session->client_fd, &readset))
             {
-                process_rx(telnet, recv_buf, recv_len);
+                if ((recv_len = recv(session->client_fd, recv_buf, RECV_BUF_LEN, 0)) > 0)
+                {
+                    process_rx(session, recv_buf, recv_len);
+                }
+                else
+                {
+                    /* close connection */
+                    client_close(session);
+                }
             }
-            else
+        }
+
+        /* grab new connection */
+        if (FD_ISSET(telnet->server_fd, &readset))
+        {
+            addr_size = sizeof(addr);
+            if ((client_fd = accept(telnet->server_fd, (struct sockaddr *) &addr, &addr_size)) >= 0)
             {
-                /* close connection */
-                client_close(telnet);
-                break;
+                for (session = telnet->session; session < telnet->session + PKG_NETUTILS_TELNET_MAX_SESSIONS; session++)
+                {
+                    if (session->client_fd < 0)
+                        break;
+                }
+                if (session < telnet->session + PKG_NETUTILS_TELNET_MAX_SESSIONS)
+                {
+                    rt_kprintf("telnet: new telnet client(%s:%d) connection, switch console to telnet...\n",
+                            inet_ntoa(addr.sin_addr), addr.sin_port);
+                    client_open(session, client_fd);
+                }
+                else
+                {
+                    const char *busy = "telnet: too many clients\r\n";
+
+                    send(client_fd, busy, rt_strlen(busy), MSG_DONTWAIT);
+                    closesocket(client_fd);
+                }
             }
         }
+
+        /* try to send the option replies and the output which is enough or too old */
+        send_to_clients(RT_FALSE);
     }
 }
 
@@ -444,12 +809,12 @@ static void telnet_thread(void* parameter)
 void telnet_server(void)
 {
     rt_thread_t tid;
+    rt_uint8_t *ptr;
+    int i;
 
     if (telnet == RT_NULL)
     {
-        rt_uint8_t *ptr;
-
-        telnet = rt_malloc(sizeof(struct telnet_session));
+        telnet = rt_calloc(1, sizeof(struct telnet_server));
         if (telnet == RT_NULL)
         {
             rt_kprintf("telnet: no memory\n");
@@ -466,24 +831,26 @@ void telnet_server(void)
             rt_kprintf("telnet: no memory\n");
             return;
         }
-        ptr = rt_malloc(TX_BUFFER_SIZE);
-        if (ptr)
-        {
-            rt_ringbuffer_init(&telnet->tx_ringbuffer, ptr, TX_BUFFER_SIZE);
-        }
-        else
+        for (i = 0; i < PKG_NETUTILS_TELNET_MAX_SESSIONS; i++)
         {
-            rt_kprintf("telnet: no memory\n");
-            return;
+            telnet->session[i].client_fd = -1;
+            telnet->session[i].tx_buffer = rt_malloc(TX_BUFFER_SIZE);
+            telnet->session[i].tx_space = rt_sem_create("telnet_tx", 0, RT_IPC_FLAG_FIFO);
+            if (telnet->session[i].tx_buffer == RT_NULL || telnet->session[i].tx_space == RT_NULL)
+            {
+                rt_kprintf("telnet: no memory\n");
+                return;
+            }
         }
-        /* create tx ringbuffer lock */
-        telnet->tx_ringbuffer_lock = rt_mutex_create("telnet_tx", RT_IPC_FLAG_FIFO);
+        /* create tx buffer lock */
+        telnet->tx_lock = rt_mutex_create("telnet_tx", RT_IPC_FLAG_FIFO);
         /* create rx ringbuffer lock */
         telnet->rx_ringbuffer_lock = rt_mutex_create("telnet_rx", RT_IPC_FLAG_FIFO);
 
         telnet->read_notice = rt_sem_create("telnet_rx", 0, RT_IPC_FLAG_FIFO);
 
         tid = rt_thread_create("telnet", telnet_thread, RT_NULL, 2048, 25, 5);
+        telnet->thread = tid;
         if (tid != RT_NULL)
         {
             rt_thread_startup(tid);
@@ -492,16 +859,56 @@ void telnet_server(void)
     }
     else
     {
-        rt_kprintf("telnet: server already running\n");
+        rt_kprintf("telnet: server already running, %d client(s) connected\n", telnet->session_num);
+        rt_kprintf("telnet: sent %u bytes by %u sends, dropped %u bytes\n",
+                telnet->tx_bytes, telnet->tx_sends, telnet->tx_drops);
     }
 
 }
 
+/* shell output throughput over telnet */
+static void telnet_bench(int argc, char **argv)
+{
+    int lines = 1000, i;
+    rt_tick_t tick;
+    rt_uint32_t tx_bytes, tx_sends, tx_drops;
+
+    if (telnet == RT_NULL || telnet->session_num == 0)
+    {
+        rt_kprintf("telnet: please run it on a telnet client\n");
+        return;
+    }
+    if (argc > 1)
+    {
+        lines = atoi(argv[1]);
+    }
+
+    tx_bytes = telnet->tx_bytes;
+    tx_sends = telnet->tx_sends;
+    tx_drops = telnet->tx_drops;
+    tick = rt_tick_get();
+    for (i = 0; i < lines; i++)
+    {
+        rt_kprintf("[%6d] telnet shell output benchmark 0123456789abcdefghijklmnopqrstuvwxyz\n", i);
+    }
+    /* the output of the last lines */
+    send_to_clients(RT_TRUE);
+    tick = rt_tick_get() - tick;
+    tx_bytes = telnet->tx_bytes - tx_bytes;
+    tx_sends = telnet->tx_sends - tx_sends;
+    tx_drops = telnet->tx_drops - tx_drops;
+
+    rt_kprintf("%d lines in %d ms, %u bytes by %u sends (%u bytes per send), dropped %u bytes, %u KB/s\n",
+            lines, tick * 1000 / RT_TICK_PER_SECOND, tx_bytes, tx_sends, tx_sends ? tx_bytes / tx_sends : 0,
+            tx_drops, tick ? tx_bytes * RT_TICK_PER_SECOND / tick / 1024 : 0);
+}
+
 #ifdef RT_USING_FINSH
 #include <finsh.h>
 FINSH_FUNCTION_EXPORT(telnet_server, startup telnet server);
 #ifdef FINSH_USING_MSH
 MSH_CMD_EXPORT(telnet_server, startup telnet server)
+MSH_CMD_EXPORT(telnet_bench, shell output throughput over telnet: telnet_bench [lines])
 #endif /* FINSH_USING_MSH */
 #endif /* RT_USING_FINSH */
 #endif /* PKG_NETUTILS_TELNET */
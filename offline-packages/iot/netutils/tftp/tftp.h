@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2019-02-26     tyx          first implementation
+ * 2024-10-19     Evlers       add the blksize and windowsize of client, the FAL partition path
  */
 
 #ifndef __TFTP_H__
@@ -29,6 +30,9 @@
 
 #define tftp_printf printf
 
+/* the file name "fal:<partition>" is the FAL partition, it's not in the root of server */
+#define TFTP_FAL_PATH   "fal:"
+
 struct tftp_client
 {
     int max_retry;
@@ -49,6 +53,8 @@ void tftp_client_destroy(struct tftp_client *client);
 int tftp_client_push(struct tftp_client *client, const char *local_name, const char *remote_name);
 int tftp_client_pull(struct tftp_client *client, const char *remote_name, const char *local_name);
 int tftp_client_err(struct tftp_client *client);
+int tftp_client_blksize_set(struct tftp_client *client, int blksize);
+int tftp_client_windowsize_set(struct tftp_client *client, int windowsize);
 struct tftp_server *tftp_server_create(const char *root_name, int port);
 void tftp_server_run(struct tftp_server *server);
 void tftp_server_destroy(struct tftp_server *server);
@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2019-02-26     tyx          first implementation
+ * 2024-10-19     Evlers       negotiate the options, send and receive by window (RFC 7440)
  */
 
 #include <stdio.h>
@@ -21,8 +22,6 @@
 struct tftp_client_private
 {
     struct tftp_xfer *xfer;
-    fd_set fdr;
-    struct timeval timeout;
 };
 
 extern void *tftp_file_open(const char *fname, const char *mode, int is_write);
@@ -33,21 +32,73 @@ extern int tftp_thread_create(void **task, void (*entry)(void *param), void *par
 
 static int tftp_client_select(struct tftp_client_private *_private)
 {
-    int ret;
-    FD_ZERO(&_private->fdr);
-    FD_SET(_private->xfer->sock, &_private->fdr);
-    _private->timeout.tv_sec = 5;
-    _private->timeout.tv_usec = 0;
-    ret = select(_private->xfer->sock + 1, &_private->fdr, NULL, NULL, (void *)&_private->timeout);
-    if (ret == 0)
+    /* wait for the retransmit timeout */
+    return tftp_xfer_select(_private->xfer, tftp_xfer_rto(_private->xfer));
+}
+
+/* send the request and receive the first reply of server, return the size of reply */
+static int tftp_client_request(struct tftp_client *client, uint16_t cmd, const char *remote_name, struct tftp_packet *pack)
+{
+    struct tftp_client_private *_private;
+    int max_retry;
+    int res;
+
+    _private = client->_private;
+    max_retry = client->max_retry;
+    while (max_retry)
     {
-        return -TFTP_ETIMEOUT;
+        /* Send Request */
+        res = tftp_send_request(_private->xfer, cmd, remote_name);
+        if (res != TFTP_OK)
+        {
+            tftp_printf("tftp send request failed !! retry:%d. exit\n", client->max_retry - max_retry);
+            return res;
+        }
+        /* Waiting for server response */
+        res = tftp_client_select(_private);
+        if (res > 0)
+        {
+            /* Receive the server response */
+            return tftp_recv_packet(_private->xfer, pack, sizeof(struct tftp_packet));
+        }
+        else if (res == -TFTP_ETIMEOUT)
+        {
+            tftp_printf("tftp wait response timeout. retry\n");
+            tftp_xfer_rto_backoff(_private->xfer);
+            max_retry --;
+            continue;
+        }
+        else
+        {
+            /* Waiting for Response Error */
+            tftp_printf("tftp wait response err:%d. exit\n", res);
+            return res;
+        }
+    }
+    return -TFTP_ETIMEOUT;
+}
+
+/* apply the options of OACK, the options are the default if the server replies the data or ACK directly */
+static int tftp_client_options(struct tftp_client *client, struct tftp_packet *pack, int size)
+{
+    struct tftp_client_private *_private = client->_private;
+
+    if (size >= 2 && ntohs(pack->cmd) == TFTP_CMD_OACK)
+    {
+        if (tftp_parse_options(_private->xfer, pack->info.filename, size - 2, 0) < 0)
+        {
+            tftp_transfer_err(_private->xfer, 8, "bad options!");
+            return -TFTP_EINVAL;
+        }
+        return TFTP_CMD_OACK;
     }
-    else if (ret < 0)
+    tftp_parse_options(_private->xfer, NULL, 0, 0);
+    if (size >= 4 && ntohs(pack->cmd) == TFTP_CMD_ERROR)
     {
-        return -TFTP_ESYS;
+        tftp_printf("err[%d] msg:%.*s\n", ntohs(pack->info.code), size - 4, pack->data);
+        return -TFTP_ECMD;
     }
-    return ret;
+    return size >= 4 ? ntohs(pack->cmd) : -TFTP_EDATA;
 }
 
 struct tftp_client *tftp_client_create(const char *ip_addr, int port)
@@ -101,136 +152,132 @@ void tftp_client_destroy(struct tftp_client *client)
 int tftp_client_push(struct tftp_client *client, const char *local_name, const char *remote_name)
 {
     struct tftp_client_private *_private;
+    struct tftp_xfer *xfer;
     void *fp;
     struct tftp_packet *pack;
     int send_size, r_size;
     int file_size = 0;
     int res;
     int max_retry;
+    int base, next, last = 0;   /* the index of the first block not acknowledged, the next and the last block */
 
     _private = client->_private;
-    max_retry = client->max_retry;
+    xfer = _private->xfer;
     client->err = TFTP_OK;
-    while (max_retry)
+    pack = malloc(sizeof(struct tftp_packet));
+    if (pack == NULL)
     {
-        /* Send Write Request */
-        res = tftp_send_request(_private->xfer, TFTP_CMD_WRQ, remote_name);
-        if (res != TFTP_OK)
-        {
-            tftp_printf("tftp send request failed !! retry:%d. exit\n", client->max_retry - max_retry);
-            max_retry = 0;
-            client->err = res;
-            break;
-        }
-        /* Waiting for server response */
-        res = tftp_client_select(_private);
-        if (res > 0 && FD_ISSET(_private->xfer->sock, &_private->fdr))
-        {
-            /* Receive the server response */
-            break;
-        }
-        else if (res == -TFTP_ETIMEOUT)
-        {
-            tftp_printf("tftp wait response timeout. retry\n");
-            max_retry --;
-            continue;
-        }
-        else
-        {
-            /* Waiting for Response Error */
-            tftp_printf("tftp wait response err:%d. exit\n", res);
-            max_retry = 0;
-            client->err = res;
-            break;
-        }
+        client->err = -TFTP_EMEM;
+        return -TFTP_EMEM;
     }
-
-    if (max_retry == 0)
+    /* Send Write Request, the server replies OACK or ACK 0 */
+    res = tftp_client_request(client, TFTP_CMD_WRQ, remote_name, pack);
+    if (res >= 0)
     {
-        return res;
+        res = tftp_client_options(client, pack, res);
+        if (res == TFTP_CMD_ACK && ntohs(pack->info.block) != 0)
+        {
+            res = -TFTP_EBLK;
+        }
     }
-    /* Receiving ACK */
-    res = tftp_wait_ack(_private->xfer);
-    if (res != TFTP_OK)
+    if (res != TFTP_CMD_OACK && res != TFTP_CMD_ACK)
     {
         tftp_printf("wait ack failed!! exit\n");
-        client->err = res;
-        return res;
+        client->err = res < 0 ? res : -TFTP_EACK;
+        free(pack);
+        return client->err;
     }
     /* Open file */
-    fp = tftp_file_open(local_name, _private->xfer->mode, 0);
+    fp = tftp_file_open(local_name, xfer->mode, 0);
     if (fp == NULL)
     {
         tftp_printf("open file \"%s\" error.\n", local_name);
+        tftp_transfer_err(xfer, 0, "open file err!");
         client->err = -TFTP_EFILE;
+        free(pack);
         return -TFTP_EFILE;
     }
-    pack = malloc(sizeof(struct tftp_packet));
-    if (pack == NULL)
-    {
-        tftp_transfer_err(_private->xfer, 0, "malloc pack failed!");
-        tftp_file_close(fp);
-        client->err = -TFTP_EMEM;
-        return -TFTP_EMEM;
-    }
+
+    /* Send the window of blocks, then wait for the ACK of them */
+    tftp_xfer_block_set(xfer, 1);
+    base = next = 1;
+    max_retry = client->max_retry;
     while (1)
     {
-        /* read file */
-        r_size = tftp_file_read(fp, file_size, &pack->data, _private->xfer->blksize);
-        if (r_size < 0)
-        {
-            max_retry = 0;
-            client->err = -TFTP_EFILE;
-            break;
-        }
-        max_retry = client->max_retry;
-        while (max_retry)
+        while (tftp_window_inflight(xfer) < xfer->windowsize && (last == 0 || next <= last))
         {
-            /* Send data to server */
-            send_size = tftp_write_data(_private->xfer, pack, r_size + 4);
-            if (send_size != (r_size + 4))
+            /* read file */
+            r_size = tftp_file_read(fp, (next - 1) * xfer->blksize, &pack->data, xfer->blksize);
+            if (r_size < 0)
             {
-                tftp_transfer_err(_private->xfer, 0, "send file err!");
-                max_retry = 0;
-                client->err = -TFTP_EDATA;
+                tftp_transfer_err(xfer, 0, "read file err!");
+                client->err = -TFTP_EFILE;
                 break;
             }
-            /* Wait server ACK */
-            res = tftp_client_select(_private);
-            if (res > 0 && FD_ISSET(_private->xfer->sock, &_private->fdr))
+            /* Send data to server */
+            send_size = tftp_write_data(xfer, pack, r_size + 4);
+            if (send_size != (r_size + 4))
             {
-                /* Receive a server ACK */
+                tftp_transfer_err(xfer, 0, "send file err!");
+                client->err = -TFTP_EDATA;
                 break;
             }
-            else if (res == -TFTP_ETIMEOUT)
+            /* The block less than blksize is the last one */
+            if (r_size < xfer->blksize)
             {
-                tftp_printf("tftp wait response timeout. retry\n");
-                max_retry --;
-                continue;
+                last = next;
+                file_size = (last - 1) * xfer->blksize + r_size;
             }
-            else
+            next++;
+        }
+        if (client->err != TFTP_OK)
+        {
+            break;
+        }
+
+        /* Wait server ACK */
+        res = tftp_client_select(_private);
+        if (res == -TFTP_ETIMEOUT)
+        {
+            if (--max_retry == 0)
             {
-                tftp_printf("tftp wait response err:%d. exit\n", res);
-                max_retry = 0;
+                tftp_printf("tftp wait response timeout. exit\n");
                 client->err = res;
                 break;
             }
+            /* Resend the window from the first block not acknowledged */
+            tftp_xfer_rto_backoff(xfer);
+            tftp_window_rewind(xfer);
+            next = base;
+            continue;
         }
-
-        if (max_retry == 0)
+        else if (res < 0)
         {
+            tftp_printf("tftp wait response err:%d. exit\n", res);
+            client->err = res;
             break;
         }
         /* Receiving ACK */
-        if (tftp_wait_ack(_private->xfer) != TFTP_OK)
+        res = tftp_wait_ack(xfer);
+        if (res > 0)
         {
-            tftp_printf("wait ack failed!! exit\n");
-            client->err = -TFTP_EACK;
-            break;
+            base += res;
+            max_retry = client->max_retry;
+            if (last != 0 && base > last)
+            {
+                break;
+            }
+        }
+        else if (res == 0)
+        {
+            /* The server lost a block, send again from the block after the ACK */
+            tftp_window_rewind(xfer);
+            next = base;
         }
-        file_size += r_size;
-        if (r_size < _private->xfer->blksize)
+        else if (res != -TFTP_EBLK)
         {
+            tftp_printf("wait ack failed!! exit\n");
+            client->err = -TFTP_EACK;
             break;
         }
     }
@@ -243,78 +290,95 @@ int tftp_client_push(struct tftp_client *client, const char *local_name, const c
 int tftp_client_pull(struct tftp_client *client, const char *remote_name, const char *local_name)
 {
     struct tftp_client_private *_private;
+    struct tftp_xfer *xfer;
     void *fp;
     struct tftp_packet *pack;
     int recv_size, w_size;
     int file_size = 0;
-    int res;
+    int res, size;
     int max_retry;
+    int nak = 0;
 
     _private = client->_private;
-    max_retry = client->max_retry;
+    xfer = _private->xfer;
     client->err = TFTP_OK;
-    while (max_retry)
+    pack = malloc(sizeof(struct tftp_packet));
+    if (pack == NULL)
     {
-        /* Send Read File Request */
-        res = tftp_send_request(_private->xfer, TFTP_CMD_RRQ, remote_name);
-        if (res != TFTP_OK)
-        {
-            tftp_printf("tftp send request failed !! retry:%d. exit\n", max_retry);
-            max_retry = 0;
-            client->err = res;
-            break;
-        }
-        /* Waiting for the server to respond to the request */
-        res = tftp_client_select(_private);
-        if (res > 0 && FD_ISSET(_private->xfer->sock, &_private->fdr))
-        {
-            /* Receive the server response */
-            break;
-        }
-        else if (res == -TFTP_ETIMEOUT)
-        {
-            tftp_printf("tftp wait response timeout. retry\n");
-            max_retry --;
-            continue;
-        }
-        else
-        {
-            tftp_printf("tftp wait response err:%d. exit\n", res);
-            max_retry = 0;
-            client->err = res;
-            break;
-        }
+        client->err = -TFTP_EMEM;
+        return -TFTP_EMEM;
     }
-
-    /* More than the maximum number of retries. exit */
-    if (max_retry == 0)
+    /* Send Read File Request, the server replies OACK or the first block */
+    size = tftp_client_request(client, TFTP_CMD_RRQ, remote_name, pack);
+    res = size >= 0 ? tftp_client_options(client, pack, size) : size;
+    if (res != TFTP_CMD_OACK && res != TFTP_CMD_DATA)
     {
-        return res;
+        client->err = res < 0 ? res : -TFTP_EDATA;
+        free(pack);
+        return client->err;
     }
 
     /* Request successful. open file */
-    fp = tftp_file_open(local_name, _private->xfer->mode, 1);
+    fp = tftp_file_open(local_name, xfer->mode, 1);
     if (fp == NULL)
     {
         tftp_printf("open file \"%s\" error.\n", local_name);
+        tftp_transfer_err(xfer, 0, "open file err!");
         client->err = -TFTP_EFILE;
+        free(pack);
         return -TFTP_EFILE;
     }
-    pack = malloc(sizeof(struct tftp_packet));
-    if (pack == NULL)
+    tftp_xfer_block_set(xfer, 0);
+    if (res == TFTP_CMD_OACK)
     {
-        /* malloc failed. send err msg and exit */
-        tftp_transfer_err(_private->xfer, 0, "malloc pack failed!");
-        tftp_file_close(fp);
-        client->err = -TFTP_EMEM;
-        return -TFTP_EMEM;
+        /* ACK 0 starts the transfer */
+        tftp_resp_ack(xfer);
+        size = 0;
     }
+
+    max_retry = client->max_retry;
     while (1)
     {
+        if (size == 0)
+        {
+            /* Waiting for the server to send data */
+            res = tftp_client_select(_private);
+            if (res == -TFTP_ETIMEOUT)
+            {
+                if (--max_retry == 0)
+                {
+                    tftp_printf("tftp wait response timeout. exit\n");
+                    client->err = res;
+                    break;
+                }
+                /* Send the ACK of the last block again */
+                tftp_xfer_rto_backoff(xfer);
+                tftp_resp_ack(xfer);
+                nak = 0;
+                continue;
+            }
+            else if (res < 0)
+            {
+                tftp_printf("tftp wait response err:%d. exit\n", res);
+                client->err = res;
+                break;
+            }
+            size = tftp_recv_packet(xfer, pack, (int)((uint8_t *)&pack->data - (uint8_t *)pack) + xfer->blksize);
+        }
         /* Receiving data from server */
-        recv_size = tftp_read_data(_private->xfer, pack, \
-            (int)((uint8_t *)&pack->data - (uint8_t *)pack) + _private->xfer->blksize);
-        if (recv_size < 0)
+        recv_size = tftp_check_data(xfer, pack, size);
+        size = 0;
+        if (recv_size == -TFTP_EBLK || (recv_size == -TFTP_EOTHER && ntohs(pack->cmd) == TFTP_CMD_OACK))
+        {
+            /* A block is lost, ACK the last block received in order once, the server sends again after it */
+            if (!nak)
+            {
+                tftp_resp_ack(xfer);
+                nak = 1;
+            }
+            continue;
+        }
+        else if (recv_size < 0)
         {
             tftp_printf("read data err[%d]! exit\n", recv_size);
             client->err = -TFTP_EDATA;
@@ -325,44 +389,23 @@ int tftp_client_pull(struct tftp_client *client, const char *remote_name, const
         if (w_size != recv_size)
         {
             tftp_printf("write file err! exit\n");
-            tftp_transfer_err(_private->xfer, 0, "write file err!");
+            tftp_transfer_err(xfer, 0, "write file err!");
             client->err = -TFTP_EFILE;
             break;
         }
         file_size += recv_size;
+        max_retry = client->max_retry;
+        nak = 0;
         /* Data less than one package. Completion of reception */
-        if (recv_size < _private->xfer->blksize)
+        if (recv_size < xfer->blksize)
         {
-            tftp_resp_ack(_private->xfer);
+            tftp_resp_ack(xfer);
             break;
         }
-        max_retry = client->max_retry;
-        while (max_retry)
-        {
-            /* Send a response signal */
-            tftp_resp_ack(_private->xfer);
-            /* Waiting for the server to send data */
-            res = tftp_client_select(_private);
-            if (res > 0 && FD_ISSET(_private->xfer->sock, &_private->fdr))
-            {
-                break;
-            }
-            else if (res == -TFTP_ETIMEOUT)
-            {
-                tftp_printf("tftp wait response timeout. retry\n");
-                max_retry --;
-            }
-            else
-            {
-                tftp_printf("tftp wait response err:%d. exit\n", res);
-                max_retry = 0;
-                client->err = res;
-                break;
-            }
-        }
-        if (max_retry == 0)
+        /* The last block of the window */
+        if (tftp_ack_due(xfer))
         {
-            break;
+            tftp_resp_ack(xfer);
         }
     }
     /* close file */
@@ -375,3 +418,17 @@ int tftp_client_err(struct tftp_client *client)
 {
     return client->err;
 }
+
+int tftp_client_blksize_set(struct tftp_client *client, int blksize)
+{
+    struct tftp_client_private *_private = client->_private;
+
+    return tftp_xfer_blksize_set(_private->xfer, blksize);
+}
+
+int tftp_client_windowsize_set(struct tftp_client *client, int windowsize)
+{
+    struct tftp_client_private *_private = client->_private;
+
+    return tftp_xfer_windowsize_set(_private->xfer, windowsize);
+}
@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2019-02-26     tyx          first implementation
+ * 2024-10-19     Evlers       read and write at the position, FAL partition file, blksize and windowsize options
  */
 
 #include <rtthread.h>
@@ -19,47 +20,177 @@
 #include <stdlib.h>
 #include <string.h>
 #include "tftp.h"
+#ifdef RT_USING_FAL
+#include <fal.h>
+#endif
 
-rt_weak void *tftp_file_open(const char *fname, const char *mode, int is_write)
+struct tftp_file
+{
+    int fd;
+#ifdef RT_USING_FAL
+    /* the FAL partition is written directly, the blocks are erased before the first written */
+    const struct fal_partition *part;
+    size_t blk_size;
+    size_t erased;
+#endif
+};
+
+#ifdef RT_USING_FAL
+static int tftp_part_open(struct tftp_file *file, const char *name)
+{
+    const struct fal_flash_dev *flash;
+
+    file->part = fal_partition_find(name);
+    if (file->part == RT_NULL)
+    {
+        rt_kprintf("tftp: partition(%s) not found.\n", name);
+        return -1;
+    }
+    flash = fal_flash_device_find(file->part->flash_name);
+    file->blk_size = (flash && flash->blk_size) ? flash->blk_size : 4096;
+    file->erased = 0;
+
+    return 0;
+}
+
+static int tftp_part_write(struct tftp_file *file, int pos, void *buff, int len)
 {
-    int fd = 0;
+    size_t end = pos + len;
 
-    if (!rt_strcmp(mode, "octet"))
+    if (end > file->part->len)
+    {
+        rt_kprintf("tftp: partition(%s) is full.\n", file->part->name);
+        return -1;
+    }
+    /* erase the blocks before writing, the blocks are written in order */
+    if (end > file->erased)
     {
-        if (is_write)
+        size_t size = RT_ALIGN(end - file->erased, file->blk_size);
+
+        if (file->erased + size > file->part->len)
         {
-            fd = open(fname, O_WRONLY | O_CREAT, 0);
+            size = file->part->len - file->erased;
         }
-        else
+        if (fal_partition_erase(file->part, file->erased, size) < 0)
         {
-            fd = open(fname, O_RDONLY, 0);
+            return -1;
         }
+        file->erased += size;
     }
-    else
+
+    return fal_partition_write(file->part, pos, buff, len);
+}
+
+static int tftp_part_read(struct tftp_file *file, int pos, void *buff, int len)
+{
+    if (pos >= file->part->len)
+    {
+        return 0;
+    }
+    if (pos + len > file->part->len)
+    {
+        len = file->part->len - pos;
+    }
+
+    return fal_partition_read(file->part, pos, buff, len);
+}
+#endif /* RT_USING_FAL */
+
+rt_weak void *tftp_file_open(const char *fname, const char *mode, int is_write)
+{
+    struct tftp_file *file;
+
+    if (rt_strcmp(mode, "octet"))
     {
         rt_kprintf("tftp: No support this mode(%s).", mode);
+        return RT_NULL;
+    }
+    file = rt_calloc(1, sizeof(struct tftp_file));
+    if (file == RT_NULL)
+    {
+        return RT_NULL;
+    }
+    file->fd = -1;
+
+#ifdef RT_USING_FAL
+    if (!rt_strncmp(fname, TFTP_FAL_PATH, rt_strlen(TFTP_FAL_PATH)))
+    {
+        if (tftp_part_open(file, fname + rt_strlen(TFTP_FAL_PATH)) < 0)
+        {
+            rt_free(file);
+            return RT_NULL;
+        }
+        return file;
     }
+#endif
 
-    return (void *)fd;
+    if (is_write)
+    {
+        file->fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0);
+    }
+    else
+    {
+        file->fd = open(fname, O_RDONLY, 0);
+    }
+    if (file->fd < 0)
+    {
+        rt_free(file);
+        return RT_NULL;
+    }
+
+    return file;
 }
 
 rt_weak int tftp_file_write(void *handle, int pos, void *buff, int len)
 {
-    int fd = (int)handle;
+    struct tftp_file *file = handle;
 
-    return write(fd, buff, len);
+#ifdef RT_USING_FAL
+    if (file->part)
+    {
+        return tftp_part_write(file, pos, buff, len);
+    }
+#endif
+    /* the blocks are sent again after lost, write at the position of block */
+    if (lseek(file->fd, pos, SEEK_SET) != pos)
+    {
+        return -1;
+    }
+
+    return write(file->fd, buff, len);
 }
 
 rt_weak int tftp_file_read(void *handle, int pos, void *buff, int len)
 {
-    int fd = (int)handle;
+    struct tftp_file *file = handle;
 
-    return read(fd, buff, len);
+#ifdef RT_USING_FAL
+    if (file->part)
+    {
+        return tftp_part_read(file, pos, buff, len);
+    }
+#endif
+    if (lseek(file->fd, pos, SEEK_SET) != pos)
+    {
+        return -1;
+    }
+
+    return read(file->fd, buff, len);
 }
 
 rt_weak void tftp_file_close(void *handle)
 {
-    close((int)handle);
+    struct tftp_file *file = handle;
+
+    if (file == RT_NULL)
+    {
+        return;
+    }
+    if (file->fd >= 0)
+    {
+        close(file->fd);
+    }
+    rt_free(file);
 }
 
 static struct tftp_server *server;
@@ -75,6 +206,8 @@ static void tftp_server_thread(void *param)
 #define _CR_MODE_CMD       (102)
 #define _IP_MODE_CMD       (103)
 #define _P_MODE_CMD        (104)
+#define _B_MODE_CMD        (105)
+#define _WIN_MODE_CMD      (106)
 #define _STOP_MODE_CMD     (107)
 #define _UNKNOWN_MODE_CMD  (0)
 
@@ -91,22 +224,26 @@ static const struct _tftp_cmd _cmd_tab[] =
     {"-w", "client write file to server", _CW_MODE_CMD},
     {"-r", "client read file from server", _CR_MODE_CMD},
     {"-p", "server port to listen on/connect to", _P_MODE_CMD},
+    {"-b", "client block size (blksize option)", _B_MODE_CMD},
+    {"--window", "client window size (windowsize option)", _WIN_MODE_CMD},
     {"--stop", "stop tftp server", _STOP_MODE_CMD},
 };
 
 static void _tftp_help(void)
 {
     int i;
-    printf("Usage: tftp [-s|-w|-r host] [path]\n");
+    printf("Usage: tftp [-s|-w|-r host] [-b blksize] [--window n] [path]\n");
     printf("       tftp [-h|--stop]\n\n");
     for (i = 0; i < sizeof(_cmd_tab) / sizeof(_cmd_tab[0]); i++)
     {
-        printf("       %-6.6s:  %s\n", _cmd_tab[i].cmd_str, _cmd_tab[i].help_info);
+        printf("       %-8.8s:  %s\n", _cmd_tab[i].cmd_str, _cmd_tab[i].help_info);
     }
     printf("\neg: \n");
     printf("    open server: tftp -s /\n");
     printf("    read  file : tftp -r 192.168.1.1 test.data\n");
     printf("    wriet file : tftp -w 192.168.1.1 test.data\n");
+    printf("    fast read  : tftp -r 192.168.1.1 -b 1468 --window 8 test.data\n");
+    printf("    partition  : tftp -w 192.168.1.1 fal:filesystem fs.img\n");
 }
 
 static int _tftp_msh(int argc, char *argv[])
@@ -116,6 +253,7 @@ static int _tftp_msh(int argc, char *argv[])
     char *ip = RT_NULL;
     char *path[2] = {0};
     int port = 0, stop = 0;
+    int blksize = 0, windowsize = 0;
 
     if (argc == 1)
     {
@@ -165,6 +303,22 @@ static int _tftp_msh(int argc, char *argv[])
                 i ++;
             }
             break;
+        case _B_MODE_CMD:
+        case _WIN_MODE_CMD:
+            if ((i + 1) >= argc)
+            {
+                goto _help;
+            }
+            if (cmd == _B_MODE_CMD)
+            {
+                blksize = atoi(argv[i + 1]);
+            }
+            else
+            {
+                windowsize = atoi(argv[i + 1]);
+            }
+            i ++;
+            break;
         case _STOP_MODE_CMD:
             if (argc != 2)
             {
@@ -235,6 +389,17 @@ static int _tftp_msh(int argc, char *argv[])
             path[1] = path[0];
         }
         client = tftp_client_create(ip, port);
+        if (client == RT_NULL)
+        {
+            return -1;
+        }
+        if ((blksize && tftp_client_blksize_set(client, blksize) != TFTP_OK) ||
+            (windowsize && tftp_client_windowsize_set(client, windowsize) != TFTP_OK))
+        {
+            printf("invalid blksize or window size\n");
+            tftp_client_destroy(client);
+            return -1;
+        }
         if (tftp_mode == _CR_MODE_CMD)
         {
             printf("file size:%d\n", tftp_client_pull(client, path[0], path[1]));
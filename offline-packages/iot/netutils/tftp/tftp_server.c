@@ -7,6 +7,7 @@
  * Date           Author       Notes
  * 2019-02-26     tyx          first implementation
  * 2019-11-18     tjrong       fix a bug in tftp_server_request_handle.
+ * 2024-10-19     Evlers       negotiate the options, send and receive by window (RFC 7440), timer of each client
  */
 
 #include <stdio.h>
@@ -16,6 +17,7 @@
 #include <sys/time.h>
 #include <sys/socket.h>
 #include <sys/select.h>
+#include <rtthread.h>
 #include "tftp_xfer.h"
 #include "tftp.h"
 
@@ -38,8 +40,13 @@ struct tftp_client_xfer
     struct tftp_xfer *xfer;
     int16_t w_r;
     int16_t retry;
-    int pos;
-    int last_read;
+    int pos;            /* write: the length received */
+    int base;           /* read: the index of the first block not acknowledged */
+    int next;           /* read: the index of the next block to send */
+    int last;           /* read: the index of the last block, 0 is unknown */
+    int8_t oack;        /* the OACK is not acknowledged */
+    int8_t nak;         /* write: the ACK of lost block is sent */
+    rt_tick_t deadline; /* the retransmit timer */
     void *fd;
 };
 
@@ -48,11 +55,12 @@ struct tftp_server_private
     struct tftp_xfer *server_xfer;
     struct tftp_client_xfer *client_table;
     int table_num;
+    int port;
     fd_set fdr;
     struct timeval timeout;
 };
 
-static int tftp_server_select(struct tftp_server *server)
+static int tftp_server_select(struct tftp_server *server, int timeout_ms)
 {
     struct tftp_server_private *_private;
     int max_sock, i;
@@ -76,8 +84,8 @@ static int tftp_server_select(struct tftp_server *server)
         }
     }
     /* Setting timeout time */
-    _private->timeout.tv_sec = 5;
-    _private->timeout.tv_usec = 0;
+    _private->timeout.tv_sec = timeout_ms / 1000;
+    _private->timeout.tv_usec = (timeout_ms % 1000) * 1000;
     ret = select(max_sock + 1, &_private->fdr, NULL, NULL, (void *)&_private->timeout);
     if (ret == 0)
     {
@@ -149,56 +157,56 @@ static void tftp_client_xfer_destroy(struct tftp_server *server, struct tftp_cli
     tftp_client_xfer_delete(server, client->xfer);
 }
 
-static void tftp_server_send_file(struct tftp_server *server, struct tftp_client_xfer *client, struct tftp_packet *packet, bool resend)
+static void tftp_server_timer_start(struct tftp_client_xfer *client)
 {
+    client->deadline = rt_tick_get() + rt_tick_from_millisecond(tftp_xfer_rto(client->xfer));
+}
+
+/* send the blocks of the window which are not sent */
+static void tftp_server_send_file(struct tftp_server *server, struct tftp_client_xfer *client, struct tftp_packet *packet)
+{
+    struct tftp_xfer *xfer = client->xfer;
     int r_size, s_size;
-    int retry = TFTP_MAX_RETRY;
 
-    if (resend == false)
-    {
-        client->pos += client->last_read;
-    }
-    /* read file */
-    r_size = tftp_file_read(client->fd, client->pos, &packet->data, client->xfer->blksize);
-    if (r_size < 0)
-    {
-        r_size = 0;
-    }
-    while (1)
+    while (tftp_window_inflight(xfer) < xfer->windowsize && (client->last == 0 || client->next <= client->last))
     {
+        /* read file */
+        r_size = tftp_file_read(client->fd, (client->next - 1) * xfer->blksize, &packet->data, xfer->blksize);
+        if (r_size < 0)
+        {
+            /* Read file error, a short block would end the transfer as complete */
+            tftp_printf("server read file err! disconnect client\n");
+            tftp_transfer_err(xfer, 0, "read file err!");
+            tftp_client_xfer_destroy(server, client);
+            return;
+        }
         /* Send data to client */
-        s_size = tftp_write_data(client->xfer, packet, r_size + 4);
-        if (r_size == (s_size - 4))
+        s_size = tftp_write_data(xfer, packet, r_size + 4);
+        if (r_size != (s_size - 4))
         {
-            break;
+            /* Failed to send data. Destroy client connection */
+            tftp_client_xfer_destroy(server, client);
+            return;
         }
-        /* Failed to send data. retry */
-        if (retry-- == 0)
+        /* The block less than blksize is the last one */
+        if (r_size < xfer->blksize)
         {
-            break;
+            client->last = client->next;
         }
+        client->next++;
     }
-    /* Maximum number of retries */
-    if (retry == 0)
-    {
-        /* Destroy client connection */
-        tftp_client_xfer_destroy(server, client);
-    }
-    else
-    {
-        client->last_read = r_size;
-    }
+    tftp_server_timer_start(client);
 }
 
 static void tftp_server_send_ack(struct tftp_server *server, struct tftp_client_xfer *client)
 {
     int retry = TFTP_MAX_RETRY;
-    bool res;
+    int res;
 
     while (1)
     {
-        /* send ack */
-        res = tftp_resp_ack(client->xfer);
+        /* send ack, the OACK is the ACK of block 0 */
+        res = client->oack ? tftp_send_oack(client->xfer) : tftp_resp_ack(client->xfer);
         if (res == TFTP_OK)
         {
             break;
@@ -209,10 +217,121 @@ static void tftp_server_send_ack(struct tftp_server *server, struct tftp_client_
             break;
         }
     }
-    if (retry == 0)
+    if (res != TFTP_OK)
     {
         /* Maximum number of retries */
         tftp_client_xfer_destroy(server, client);
+        return;
+    }
+    tftp_server_timer_start(client);
+}
+
+static void tftp_server_read_handle(struct tftp_server *server, struct tftp_client_xfer *client, struct tftp_packet *packet)
+{
+    int res;
+
+    if (client->oack)
+    {
+        /* The OACK is acknowledged by ACK 0 */
+        res = tftp_recv_packet(client->xfer, packet, sizeof(struct tftp_packet));
+        if (res >= 4 && ntohs(packet->cmd) == TFTP_CMD_ACK && ntohs(packet->info.block) == 0)
+        {
+            client->oack = 0;
+            client->retry = TFTP_MAX_RETRY;
+            tftp_server_send_file(server, client, packet);
+        }
+        else if (res < 4 || ntohs(packet->cmd) == TFTP_CMD_ERROR)
+        {
+            tftp_client_xfer_destroy(server, client);
+        }
+        return;
+    }
+
+    /* If reques is read. Receive ACK */
+    res = tftp_wait_ack(client->xfer);
+    if (res > 0)
+    {
+        /* Receive ACK success. If it's the last package of data, close client */
+        client->base += res;
+        client->retry = TFTP_MAX_RETRY;
+        if (client->last != 0 && client->base > client->last)
+        {
+            tftp_client_xfer_destroy(server, client);
+            return;
+        }
+        /* Receive ACK success. Continue sending data */
+        tftp_server_send_file(server, client, packet);
+    }
+    else if (res == 0)
+    {
+        /* The client lost a block, send again from the block after the ACK */
+        tftp_window_rewind(client->xfer);
+        client->next = client->base;
+        tftp_server_send_file(server, client, packet);
+    }
+    else if (res != -TFTP_EBLK)
+    {
+        /* Receive ACK failed. close client */
+        tftp_transfer_err(client->xfer, 0, "err ack!");
+        tftp_client_xfer_destroy(server, client);
+    }
+}
+
+static void tftp_server_write_handle(struct tftp_server *server, struct tftp_client_xfer *client, struct tftp_packet *packet)
+{
+    int recv_size, w_size;
+
+    /* Receiving File Data from Client */
+    recv_size = tftp_recv_packet(client->xfer, packet,
+                                 (int)((uint8_t *)&packet->data - (uint8_t *)packet) + client->xfer->blksize);
+    recv_size = tftp_check_data(client->xfer, packet, recv_size);
+    if (recv_size == -TFTP_EBLK)
+    {
+        /* A block is lost, ACK the last block received in order once, the client sends again after it */
+        if (!client->nak)
+        {
+            tftp_server_send_ack(server, client);
+            client->nak = 1;
+        }
+    }
+    else if (recv_size < 0)
+    {
+        /* Receiving failed. */
+        tftp_printf("server read data err! disconnect client\n");
+        tftp_client_xfer_destroy(server, client);
+    }
+    else
+    {
+        client->oack = 0;
+        client->nak = 0;
+        client->retry = TFTP_MAX_RETRY;
+        /* write file */
+        w_size = tftp_file_write(client->fd, client->pos, &packet->data, recv_size);
+        if (w_size != recv_size)
+        {
+            /* Write file error, close connection */
+            tftp_printf("server write file err! disconnect client\n");
+            tftp_transfer_err(client->xfer, 0, "write file err!");
+            tftp_client_xfer_destroy(server, client);
+            return;
+        }
+        client->pos += recv_size;
+        /* Receive the last packet of data. Reply ack and close client */
+        if (recv_size < client->xfer->blksize)
+        {
+            tftp_resp_ack(client->xfer);
+            tftp_client_xfer_destroy(server, client);
+            return;
+        }
+        /* Reply ack at the end of window */
+        if (tftp_ack_due(client->xfer))
+        {
+            tftp_server_send_ack(server, client);
+        }
+        else
+        {
+            tftp_server_timer_start(client);
+        }
     }
 }
 
@@ -221,14 +340,14 @@ static void tftp_server_transf_handle(struct tftp_server *server, struct tftp_cl
     switch (event)
     {
     case TFTP_SERVER_EVENT_CONNECT:
-        if (client->w_r == TFTP_SERVER_REQ_READ)
+        if (client->w_r == TFTP_SERVER_REQ_READ && !client->oack)
         {
             /* Read the file request and return the file data */
-            tftp_server_send_file(server, client, packet, false);
+            tftp_server_send_file(server, client, packet);
         }
         else
         {
-            /* Write file request, return ACK */
+            /* Write file request or options, return ACK or OACK */
             tftp_server_send_ack(server, client);
         }
         break;
@@ -236,90 +355,35 @@ static void tftp_server_transf_handle(struct tftp_server *server, struct tftp_cl
         /* Receive data from client */
         if (client->w_r == TFTP_SERVER_REQ_READ)
         {
-            /* If reques is read. Receive ACK */
-            if (tftp_wait_ack(client->xfer) == TFTP_OK)
-            {
-                /* Receive ACK success. If it's the last package of data, close client */
-                if (client->last_read < client->xfer->blksize)
-                {
-                    tftp_client_xfer_destroy(server, client);
-                    break;
-                }
-                /* Receive ACK success. Continue sending data */
-                tftp_server_send_file(server, client, packet, false);
-                client->retry = TFTP_MAX_RETRY;
-            }
-            else
-            {
-                /* Receive ACK failed. close client */
-                tftp_transfer_err(client->xfer, 0, "err ack!");
-                tftp_client_xfer_destroy(server, client);
-            }
+            tftp_server_read_handle(server, client, packet);
         }
         else
         {
             /* Write File Request handle */
-            int recv_size, w_size;
-            /* Receiving File Data from Client */
-            recv_size = tftp_read_data(client->xfer, packet,
-                                       (int)((uint8_t *)&packet->data - (uint8_t *)packet) + client->xfer->blksize);
-            if (recv_size < 0)
-            {
-                /* Receiving failed. */
-                tftp_printf("server read data err! disconnect client\n");
-                tftp_client_xfer_destroy(server, client);
-            }
-            else
-            {
-                /* write file */
-                w_size = tftp_file_write(client->fd, client->pos, &packet->data, recv_size);
-                if (w_size != recv_size)
-                {
-                    /* Write file error, close connection */
-                    tftp_printf("server write file err! disconnect client\n");
-                    tftp_transfer_err(client->xfer, 0, "write file err!");
-                    tftp_client_xfer_destroy(server, client);
-                    break;
-                }
-                /* Reply ack */
-                tftp_server_send_ack(server, client);
-                client->pos += recv_size;
-                /* Receive the last packet of data. close client */
-                if (recv_size < client->xfer->blksize)
-                {
-                    tftp_client_xfer_destroy(server, client);
-                }
-            }
+            tftp_server_write_handle(server, client, packet);
         }
         break;
     case TFTP_SERVER_EVENT_TIMEOUT:
         /* Timeout handle */
-        if (client->w_r == TFTP_SERVER_REQ_READ)
+        if (client->retry-- <= 0)
         {
-            /* resend file */
-            if (client->retry > 0)
-            {
-                tftp_server_send_file(server, client, packet, true);
-                client->retry--;
-            }
-            else
-            {
-                /* Maximum number of retransmissions */
-                tftp_client_xfer_destroy(server, client);
-            }
+            /* Maximum number of retransmissions */
+            tftp_client_xfer_destroy(server, client);
+            break;
+        }
+        tftp_xfer_rto_backoff(client->xfer);
+        if (client->w_r == TFTP_SERVER_REQ_READ && !client->oack)
+        {
+            /* resend the window */
+            tftp_window_rewind(client->xfer);
+            client->next = client->base;
+            tftp_server_send_file(server, client, packet);
         }
         else
         {
-            if (client->retry > 0)
-            {
-                /* resend ack */
-                tftp_server_send_ack(server, client);
-                client->retry--;
-            }
-            else
-            {
-                tftp_client_xfer_destroy(server, client);
-            }
+            /* resend ack or OACK */
+            tftp_server_send_ack(server, client);
+            client->nak = 0;
         }
         break;
     default:
@@ -335,10 +399,11 @@ static struct tftp_client_xfer *tftp_server_request_handle(struct tftp_server *s
     char *path, *full_path;
     int name_len;
     struct tftp_client_xfer *client_xfer;
+    const char *root_name = server->root_name;
     void *fd = NULL;
     char *mode;
-    char *blksize_str;
-    int blocksize;
+    char *options;
+    int num;
 
     _private = server->_private;
     /* Receiving client requests */
@@ -362,21 +427,30 @@ static struct tftp_client_xfer *tftp_server_request_handle(struct tftp_server *s
     /* Get transfer mode */
     mode = path + strlen(path) + 1;
     tftp_xfer_mode_set(xfer, mode);
-    /* Get block size */
-    blksize_str = mode + strlen(mode) + 1;
-    if (strcmp(blksize_str, "blksize") == 0)
+    /* Get the options, the transfer is RFC 1350 without them */
+    options = mode + strlen(mode) + 1;
+    xfer->blksize = XFER_BLKSIZE_DEFAULT;
+    xfer->windowsize = 1;
+    num = tftp_parse_options(xfer, options, (int)((char *)&packet[1] - 1 - options), 1);
+    if (num < 0)
+    {
+        tftp_printf("request options err!\n");
+        tftp_transfer_err(xfer, 8, "options err!");
+        tftp_xfer_destroy(xfer);
+        return NULL;
+    }
+    /* The size of the file to read is not reported */
+    if (ntohs(packet->cmd) == TFTP_CMD_RRQ && xfer->tsize >= 0)
     {
-        blocksize = atoi(blksize_str + strlen(blksize_str) + 1);
-        if (tftp_xfer_blksize_set(xfer, blocksize) != TFTP_OK)
-        {
-            tftp_printf("set block size err:%d\n", blocksize);
-            tftp_transfer_err(xfer, 0, "block size err!");
-            tftp_xfer_destroy(xfer);
-            return NULL;
-        }
+        xfer->tsize = -1;
+        num--;
     }
-    /* Get full file path */
-    name_len = strlen(path) + strlen(server->root_name) + 2;
+    /* Get full file path, the FAL partition is not in the root */
+    if (strncmp(path, TFTP_FAL_PATH, strlen(TFTP_FAL_PATH)) == 0)
+    {
+        root_name = "";
+    }
+    name_len = strlen(path) + strlen(root_name) + 2;
     if (name_len >= TFTP_SERVER_FILE_NAME_MAX)
     {
         tftp_printf("file name is to long!!\n");
@@ -393,8 +467,8 @@ static struct tftp_client_xfer *tftp_server_request_handle(struct tftp_server *s
         return NULL;
     }
 
-    strcpy(full_path, server->root_name);
-    if (path[0] != '/')
+    strcpy(full_path, root_name);
+    if (path[0] != '/' && root_name[0] != '\0')
     {
         strcat(full_path, "/");
     }
@@ -433,7 +507,9 @@ static struct tftp_client_xfer *tftp_server_request_handle(struct tftp_server *s
         client_xfer->retry = TFTP_MAX_RETRY;
         client_xfer->fd = fd;
         client_xfer->pos = 0;
-        client_xfer->last_read = 0;
+        client_xfer->base = client_xfer->next = 1;
+        client_xfer->last = 0;
+        client_xfer->oack = num > 0;
     }
     return client_xfer;
 }
@@ -443,7 +519,7 @@ void tftp_server_run(struct tftp_server *server)
     struct tftp_xfer *xfer;
     struct tftp_packet *packet;
     struct tftp_server_private *_private;
-    int res, i;
+    int res, i, timeout;
     struct tftp_client_xfer *client_xfer;
 
     if (server == NULL)
@@ -458,7 +534,7 @@ void tftp_server_run(struct tftp_server *server)
         return;
     }
     /* Create connect */
-    xfer = tftp_xfer_create("0.0.0.0", 69);
+    xfer = tftp_xfer_create("0.0.0.0", _private->port);
     if (xfer == NULL)
     {
         free(packet);
@@ -476,45 +552,49 @@ void tftp_server_run(struct tftp_server *server)
     /* run server */
     while (!server->is_stop)
     {
-        /* Waiting client data */
-        res = tftp_server_select(server);
-        if (res == -TFTP_ETIMEOUT)
+        /* Waiting client data until the nearest retransmit timer */
+        timeout = 5000;
+        for (i = 0; i < _private->table_num; i++)
         {
-            /* Waiting for data timeout */
-            for (i = 0; i < _private->table_num; i++)
+            if (_private->client_table[i].xfer != NULL)
             {
-                if (_private->client_table[i].xfer != NULL)
+                rt_int32_t left = (rt_int32_t)(_private->client_table[i].deadline - rt_tick_get());
+                left = left > 0 ? left * 1000 / RT_TICK_PER_SECOND : 0;
+                if (left < timeout)
                 {
-                    client_xfer = tftp_client_xfer_get(server, i);
-                    tftp_server_transf_handle(server, client_xfer, TFTP_SERVER_EVENT_TIMEOUT, packet);
+                    timeout = left;
                 }
             }
-            continue;
         }
-        else if (res < 0)
+        res = tftp_server_select(server, timeout);
+        if (res < 0 && res != -TFTP_ETIMEOUT)
         {
             break;
         }
-        else
+        /* Connection request handle */
+        if (res > 0 && FD_ISSET(_private->server_xfer->sock, &_private->fdr))
         {
-            /* Connection request handle */
-            if (FD_ISSET(_private->server_xfer->sock, &_private->fdr))
+            client_xfer = tftp_server_request_handle(server, packet);
+            if (client_xfer != NULL)
             {
-                client_xfer = tftp_server_request_handle(server, packet);
-                if (client_xfer != NULL)
-                {
-                    tftp_server_transf_handle(server, client_xfer, TFTP_SERVER_EVENT_CONNECT, packet);
-                }
+                tftp_server_transf_handle(server, client_xfer, TFTP_SERVER_EVENT_CONNECT, packet);
+            }
+        }
+        /* Client data and timeout handle */
+        for (i = 0; i < _private->table_num; i++)
+        {
+            client_xfer = tftp_client_xfer_get(server, i);
+            if (client_xfer->xfer == NULL)
+            {
+                continue;
             }
-            /* Client data handle */
-            for (i = 0; i < _private->table_num; i++)
+            if (res > 0 && FD_ISSET(client_xfer->xfer->sock, &_private->fdr))
             {
-                if (_private->client_table[i].xfer != NULL &&
-                    FD_ISSET(_private->client_table[i].xfer->sock, &_private->fdr))
-                {
-                    client_xfer = tftp_client_xfer_get(server, i);
-                    tftp_server_transf_handle(server, client_xfer, TFTP_SERVER_EVENT_DATA, packet);
-                }
+                tftp_server_transf_handle(server, client_xfer, TFTP_SERVER_EVENT_DATA, packet);
+            }
+            else if ((rt_int32_t)(rt_tick_get() - client_xfer->deadline) >= 0)
+            {
+                tftp_server_transf_handle(server, client_xfer, TFTP_SERVER_EVENT_TIMEOUT, packet);
             }
         }
     }
@@ -569,6 +649,7 @@ struct tftp_server *tftp_server_create(const char *root_name, int port)
     }
     rt_memset(_private->client_table, 0, mem_len);
     _private->table_num = TFTP_SERVER_CONNECT_MAX;
+    _private->port = port;
     return server;
 }
 
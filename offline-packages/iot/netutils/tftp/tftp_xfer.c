@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2019-02-26     tyx          first implementation
+ * 2024-10-19     Evlers       add option negotiation, windowsize (RFC 7440) and adaptive retransmit timeout
  */
 
 #include <stdio.h>
@@ -14,18 +15,86 @@
 #include <sys/time.h>
 #include <sys/socket.h>
 #include <sys/select.h>
+#include <rtthread.h>
 #include "tftp_xfer.h"
 #include "tftp.h"
 
+#define TFTP_OPT_BLKSIZE    (0x1 << 0)
+#define TFTP_OPT_WINDOWSIZE (0x1 << 1)
+#define TFTP_OPT_TSIZE      (0x1 << 2)
+
+#define TFTP_TIMING_NONE    (0) /* no round trip is measured */
+#define TFTP_TIMING_BLOCK   (1) /* from sending the timed block to its ACK */
+#define TFTP_TIMING_REPLY   (2) /* from sending a request, OACK or ACK to the next packet received */
+
 struct tftp_xfer_private
 {
     struct sockaddr_in server;
     struct sockaddr_in sender;
     char *ip_addr;
     uint16_t port;
-    uint16_t block;
+    uint16_t block;     /* sender: the first block not acknowledged, receiver: the last block received in order */
+    uint16_t next;      /* sender: the next block to send */
+    uint16_t count;     /* receiver: the blocks received after the last ACK */
+    int options;        /* the options accepted by the server */
+    /* round trip time in ms */
+    int srtt;
+    int rttvar;
+    int rto;
+    int timing;
+    uint16_t timed_block;
+    rt_tick_t timed_tick;
 };
 
+static void tftp_xfer_timing_start(struct tftp_xfer_private *_private, int timing, uint16_t block)
+{
+    if (_private->timing == TFTP_TIMING_NONE)
+    {
+        _private->timing = timing;
+        _private->timed_block = block;
+        _private->timed_tick = rt_tick_get();
+    }
+}
+
+/* update the retransmit timeout with a new round trip sample (RFC 6298) */
+static void tftp_xfer_rtt_sample(struct tftp_xfer_private *_private)
+{
+    int rtt, granularity;
+
+    rtt = (rt_tick_get() - _private->timed_tick) * 1000 / RT_TICK_PER_SECOND;
+    granularity = 1000 / RT_TICK_PER_SECOND;
+    if (granularity < 1)
+    {
+        granularity = 1;
+    }
+    if (rtt < granularity)
+    {
+        rtt = granularity;
+    }
+    _private->timing = TFTP_TIMING_NONE;
+
+    if (_private->srtt == 0)
+    {
+        _private->srtt = rtt;
+        _private->rttvar = rtt / 2;
+    }
+    else
+    {
+        _private->rttvar = (3 * _private->rttvar + abs(_private->srtt - rtt)) / 4;
+        _private->srtt = (7 * _private->srtt + rtt) / 8;
+    }
+
+    _private->rto = _private->srtt + (4 * _private->rttvar > granularity ? 4 * _private->rttvar : granularity);
+    if (_private->rto < XFER_RTO_MIN)
+    {
+        _private->rto = XFER_RTO_MIN;
+    }
+    else if (_private->rto > XFER_RTO_MAX)
+    {
+        _private->rto = XFER_RTO_MAX;
+    }
+}
+
 static int tftp_recv_raw_data(struct tftp_xfer *xfer, void *buff, int len)
 {
     struct tftp_xfer_private *_private;
@@ -39,9 +108,84 @@ static int tftp_recv_raw_data(struct tftp_xfer *xfer, void *buff, int len)
     {
         return -TFTP_EXFER;
     }
+    /* the reply of the last request, OACK or ACK */
+    if (_private->timing == TFTP_TIMING_REPLY)
+    {
+        tftp_xfer_rtt_sample(_private);
+    }
     return r_size;
 }
 
+int tftp_recv_packet(struct tftp_xfer *xfer, struct tftp_packet *pack, int len)
+{
+    return tftp_recv_raw_data(xfer, pack, len);
+}
+
+int tftp_xfer_select(struct tftp_xfer *xfer, int timeout_ms)
+{
+    fd_set fdr;
+    struct timeval timeout;
+    int ret;
+
+    FD_ZERO(&fdr);
+    FD_SET(xfer->sock, &fdr);
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_usec = (timeout_ms % 1000) * 1000;
+    ret = select(xfer->sock + 1, &fdr, NULL, NULL, (void *)&timeout);
+    if (ret == 0)
+    {
+        return -TFTP_ETIMEOUT;
+    }
+    else if (ret < 0)
+    {
+        return -TFTP_ESYS;
+    }
+    return ret;
+}
+
+int tftp_xfer_rto(struct tftp_xfer *xfer)
+{
+    return ((struct tftp_xfer_private *)xfer->_private)->rto;
+}
+
+void tftp_xfer_rto_backoff(struct tftp_xfer *xfer)
+{
+    struct tftp_xfer_private *_private = xfer->_private;
+
+    /* the round trip of the retransmitted packet is ambiguous (Karn's algorithm) */
+    _private->timing = TFTP_TIMING_NONE;
+    _private->rto *= 2;
+    if (_private->rto > XFER_RTO_MAX)
+    {
+        _private->rto = XFER_RTO_MAX;
+    }
+}
+
+void tftp_xfer_block_set(struct tftp_xfer *xfer, uint16_t block)
+{
+    struct tftp_xfer_private *_private = xfer->_private;
+
+    _private->block = block;
+    _private->next = block;
+    _private->count = 0;
+}
+
+int tftp_window_inflight(struct tftp_xfer *xfer)
+{
+    struct tftp_xfer_private *_private = xfer->_private;
+
+    return (uint16_t)(_private->next - _private->block);
+}
+
+void tftp_window_rewind(struct tftp_xfer *xfer)
+{
+    struct tftp_xfer_private *_private = xfer->_private;
+
+    /* send again from the first block not acknowledged */
+    _private->next = _private->block;
+    _private->timing = TFTP_TIMING_NONE;
+}
+
 void tftp_transfer_err(struct tftp_xfer *xfer, uint16_t err_no, const char *err_msg)
 {
     uint16_t *snd_packet;
@@ -76,7 +220,7 @@ int tftp_resp_ack(struct tftp_xfer *xfer)
     int size;
 
     _private = xfer->_private;
-    // Send ACK.
+    // Send ACK of the last block received in order.
     snd_packet[0] = htons(TFTP_CMD_ACK);
     snd_packet[1] = htons(_private->block);
     size = sendto(xfer->sock, snd_packet, sizeof(snd_packet), 0, (struct sockaddr *)&_private->sender, sizeof(struct sockaddr_in));
@@ -84,24 +228,33 @@ int tftp_resp_ack(struct tftp_xfer *xfer)
     {
         return -TFTP_EXFER;
     }
+    _private->count = 0;
+    /* the next window of data is the reply */
+    tftp_xfer_timing_start(_private, TFTP_TIMING_REPLY, 0);
     return TFTP_OK;
 }
 
+int tftp_ack_due(struct tftp_xfer *xfer)
+{
+    struct tftp_xfer_private *_private = xfer->_private;
+
+    /* RFC 7440: ACK the last block of each window */
+    return _private->count >= xfer->windowsize;
+}
+
+/* return the number of blocks acknowledged, 0 is a duplicate ACK */
 int tftp_wait_ack(struct tftp_xfer *xfer)
 {
     int r_size;
     struct tftp_xfer_private *_private;
-    uint16_t recv_buff[4];
+    struct tftp_packet *pack;
+    uint16_t recv_buff[2 + 64];     /* the message of ERROR may be truncated */
+    uint16_t acked;
 
     _private = xfer->_private;
+    pack = (struct tftp_packet *)recv_buff;
     /* Receiving raw data */
-    r_size = tftp_recv_raw_data(xfer, recv_buff, sizeof(recv_buff));
-    /* check is ack */
-    if (r_size >= 4 && ntohs(recv_buff[0]) == TFTP_CMD_ACK && ntohs(recv_buff[1]) == _private->block)
-    {
-        _private->block++;
-        return TFTP_OK;
-    }
+    r_size = tftp_recv_raw_data(xfer, recv_buff, sizeof(recv_buff) - 1);
     if (r_size < 0)
     {
         return r_size;
@@ -110,29 +263,45 @@ int tftp_wait_ack(struct tftp_xfer *xfer)
     {
         return -TFTP_EDATA;
     }
-    else if (ntohs(recv_buff[0]) != TFTP_CMD_ACK)
+    else if (ntohs(pack->cmd) == TFTP_CMD_ERROR)
+    {
+        ((char *)recv_buff)[r_size] = '\0';
+        tftp_printf("err[%d] msg:%s\n", ntohs(pack->info.code), pack->data);
+        return -TFTP_ECMD;
+    }
+    else if (ntohs(pack->cmd) != TFTP_CMD_ACK)
     {
         return -TFTP_EACK;
     }
-    else if (ntohs(recv_buff[1]) != _private->block)
+
+    /* the ACK of the block before the first one not acknowledged is duplicate */
+    acked = (uint16_t)(ntohs(pack->info.block) + 1 - _private->block);
+    if (acked > (uint16_t)(_private->next - _private->block))
     {
         return -TFTP_EBLK;
     }
-    return -TFTP_EOTHER;
+    if (acked > 0)
+    {
+        if (_private->timing == TFTP_TIMING_BLOCK && (uint16_t)(_private->timed_block - _private->block) < acked)
+        {
+            tftp_xfer_rtt_sample(_private);
+        }
+        _private->block += acked;
+    }
+    return acked;
 }
 
-int tftp_read_data(struct tftp_xfer *xfer, struct tftp_packet *pack, int len)
+/* check the DATA packet, return the data length of the next block, -TFTP_EBLK is out of order */
+int tftp_check_data(struct tftp_xfer *xfer, struct tftp_packet *pack, int r_size)
 {
-    int r_size;
     struct tftp_xfer_private *_private;
 
     _private = xfer->_private;
-    /* Receiving raw data */
-    r_size = tftp_recv_raw_data(xfer, pack, len);
     /* Check that the data is correct  */
     if (r_size >= 4 && ntohs(pack->cmd) == TFTP_CMD_DATA && ntohs(pack->info.block) == (uint16_t)(_private->block + 1))
     {
         _private->block = ntohs(pack->info.block);
+        _private->count++;
         /* Return data length */
         return r_size - 4;
     }
@@ -147,18 +316,25 @@ int tftp_read_data(struct tftp_xfer *xfer, struct tftp_packet *pack, int len)
     }
     else if (ntohs(pack->cmd) == TFTP_CMD_ERROR)
     {
-        tftp_printf("err[%d] msg:%s code:%d\n", ntohs(pack->info.code), pack->data, ntohs(pack->info.code));
+        tftp_printf("err[%d] msg:%.*s code:%d\n", ntohs(pack->info.code), r_size - 4, pack->data, ntohs(pack->info.code));
         return -TFTP_ECMD;
     }
-    else if ((_private->block + 1) != pack->info.block)
+    else if (ntohs(pack->cmd) == TFTP_CMD_DATA)
     {
-        tftp_printf("Bad block recv:%d != check:%d\n", _private->block + 1, pack->info.block);
+        /* a block is lost or duplicate in the window */
         return -TFTP_EBLK;
     }
 
     return -TFTP_EOTHER;
 }
 
+int tftp_read_data(struct tftp_xfer *xfer, struct tftp_packet *pack, int len)
+{
+    /* Receiving raw data */
+    return tftp_check_data(xfer, pack, tftp_recv_raw_data(xfer, pack, len));
+}
+
+/* send the next block of the window */
 int tftp_write_data(struct tftp_xfer *xfer, struct tftp_packet *pack, int len)
 {
     struct tftp_xfer_private *_private;
@@ -167,16 +343,122 @@ int tftp_write_data(struct tftp_xfer *xfer, struct tftp_packet *pack, int len)
     _private = xfer->_private;
     /* Packing header */
     pack->cmd = htons(TFTP_CMD_DATA);
-    pack->info.block = htons(_private->block);
+    pack->info.block = htons(_private->next);
     /* Send data */
     size = sendto(xfer->sock, pack, len, 0, (struct sockaddr *)&_private->sender, sizeof(struct sockaddr_in));
     if (size != len)
     {
         return -TFTP_EXFER;
     }
+    tftp_xfer_timing_start(_private, TFTP_TIMING_BLOCK, _private->next);
+    _private->next++;
     return size;
 }
 
+static int tftp_option_put(char *buff, const char *name, int value)
+{
+    return rt_sprintf(buff, "%s%c%d", name, 0, value) + 1;
+}
+
+int tftp_send_oack(struct tftp_xfer *xfer)
+{
+    struct tftp_xfer_private *_private;
+    char snd_packet[64];
+    int size, r_size;
+
+    _private = xfer->_private;
+    /* Packing the accepted options */
+    *(uint16_t *)snd_packet = htons(TFTP_CMD_OACK);
+    size = 2;
+    if (_private->options & TFTP_OPT_BLKSIZE)
+    {
+        size += tftp_option_put(&snd_packet[size], "blksize", xfer->blksize);
+    }
+    if (_private->options & TFTP_OPT_WINDOWSIZE)
+    {
+        size += tftp_option_put(&snd_packet[size], "windowsize", xfer->windowsize);
+    }
+    if ((_private->options & TFTP_OPT_TSIZE) && xfer->tsize >= 0)
+    {
+        size += tftp_option_put(&snd_packet[size], "tsize", xfer->tsize);
+    }
+    r_size = sendto(xfer->sock, snd_packet, size, 0, (struct sockaddr *)&_private->sender, sizeof(struct sockaddr_in));
+    if (r_size != size)
+    {
+        return -TFTP_EXFER;
+    }
+    tftp_xfer_timing_start(_private, TFTP_TIMING_REPLY, 0);
+    return TFTP_OK;
+}
+
+/*
+ * Parse the options of the request (server) or the OACK (client).
+ * The server limits the values to what it supports, the client accepts the values not larger than requested.
+ * Return the number of options accepted.
+ */
+int tftp_parse_options(struct tftp_xfer *xfer, const char *options, int len, int is_server)
+{
+    struct tftp_xfer_private *_private;
+    const char *end = options + len;
+    int blksize = xfer->blksize, windowsize = xfer->windowsize;
+    int num = 0;
+
+    _private = xfer->_private;
+    _private->options = 0;
+    /* the options not acknowledged by the server are the default */
+    if (!is_server)
+    {
+        xfer->blksize = XFER_BLKSIZE_DEFAULT;
+        xfer->windowsize = 1;
+    }
+
+    while (options < end && *options)
+    {
+        const char *name = options;
+        const char *value = name + strnlen(name, end - name) + 1;
+        int val;
+
+        if (value >= end)
+        {
+            break;
+        }
+        options = value + strnlen(value, end - value) + 1;
+        val = atoi(value);
+
+        if (rt_strcasecmp(name, "blksize") == 0)
+        {
+            if (val < 8 || (!is_server && val > blksize))
+            {
+                return -TFTP_EINVAL;
+            }
+            xfer->blksize = val > XFER_DATA_SIZE_MAX ? XFER_DATA_SIZE_MAX : val;
+            _private->options |= TFTP_OPT_BLKSIZE;
+        }
+        else if (rt_strcasecmp(name, "windowsize") == 0)
+        {
+            if (val < 1 || (!is_server && val > windowsize))
+            {
+                return -TFTP_EINVAL;
+            }
+            xfer->windowsize = val > XFER_WINDOWSIZE_MAX ? XFER_WINDOWSIZE_MAX : val;
+            _private->options |= TFTP_OPT_WINDOWSIZE;
+        }
+        else if (rt_strcasecmp(name, "tsize") == 0)
+        {
+            xfer->tsize = val;
+            _private->options |= TFTP_OPT_TSIZE;
+        }
+        else
+        {
+            /* the unknown option is ignored */
+            continue;
+        }
+        num++;
+    }
+
+    return num;
+}
+
 int tftp_send_request(struct tftp_xfer *xfer, uint16_t cmd, const char *remote_file)
 {
     struct tftp_packet *send_packet;
@@ -202,8 +484,17 @@ int tftp_send_request(struct tftp_xfer *xfer, uint16_t cmd, const char *remote_f
     }
     /* Packing request packet header */
     send_packet->cmd = htons(cmd);
-    size = rt_sprintf(send_packet->info.filename, "%s%c%s%c%s%c%d%c%s%c%d%c",
-        remote_file, 0, xfer->mode, 0, "blksize", 0, xfer->blksize, 0,"tsize", 0, 0, 0) + 2;
+    size = rt_sprintf(send_packet->info.filename, "%s%c%s%c", remote_file, 0, xfer->mode, 0) + 2;
+    /* Request the options, the server replies OACK if it supports them */
+    size += tftp_option_put((char *)send_packet + size, "blksize", xfer->blksize);
+    if (xfer->windowsize > 1)
+    {
+        size += tftp_option_put((char *)send_packet + size, "windowsize", xfer->windowsize);
+    }
+    if (cmd == TFTP_CMD_RRQ)
+    {
+        size += tftp_option_put((char *)send_packet + size, "tsize", 0);
+    }
     /* send data */
     r_size = sendto(xfer->sock, send_packet, size, 0,
         (struct sockaddr *)&_private->server, sizeof(struct sockaddr_in));
@@ -212,6 +503,14 @@ int tftp_send_request(struct tftp_xfer *xfer, uint16_t cmd, const char *remote_f
     {
         return -TFTP_EXFER;
     }
+    /* The write request is the block 0 acknowledged by ACK 0 or OACK */
+    tftp_xfer_block_set(xfer, 0);
+    if (cmd == TFTP_CMD_WRQ)
+    {
+        _private->next = 1;
+    }
+    _private->timing = TFTP_TIMING_NONE;
+    tftp_xfer_timing_start(_private, TFTP_TIMING_REPLY, 0);
     return TFTP_OK;
 }
 
@@ -234,8 +533,8 @@ struct tftp_xfer *tftp_recv_request(struct tftp_xfer *xfer, struct tftp_packet *
     /* get packet size */
     mem_size = sizeof(struct tftp_packet);
     rt_memset(packet, 0, mem_size);
-    /* Receiving raw data */
-    size = tftp_recv_raw_data(xfer, packet, mem_size);
+    /* Receiving raw data, the strings of the request are always terminated */
+    size = tftp_recv_raw_data(xfer, packet, mem_size - 1);
     if (size > 0)
     {
         /* Determine the type of request */
@@ -250,9 +549,9 @@ struct tftp_xfer *tftp_recv_request(struct tftp_xfer *xfer, struct tftp_packet *
                 struct tftp_xfer_private *_client_private = client_xfer->_private;
                 rt_memcpy(&_client_private->sender, &_private->sender, sizeof(struct sockaddr_in));
             }
-            if (ntohs(packet->cmd) == TFTP_CMD_RRQ)
+            if (client_xfer != NULL && ntohs(packet->cmd) == TFTP_CMD_RRQ)
             {
-                ((struct tftp_xfer_private *)client_xfer->_private)->block = 1;
+                tftp_xfer_block_set(client_xfer, 1);
             }
         }
     }
@@ -328,6 +627,17 @@ int tftp_xfer_blksize_set(struct tftp_xfer *xfer, int blksize)
     return TFTP_OK;
 }
 
+int tftp_xfer_windowsize_set(struct tftp_xfer *xfer, int windowsize)
+{
+    if ((windowsize < 1) || (windowsize > XFER_WINDOWSIZE_MAX))
+    {
+        return -TFTP_EINVAL;
+    }
+    xfer->windowsize = windowsize;
+
+    return TFTP_OK;
+}
+
 struct tftp_xfer *tftp_xfer_create(const char *ip_addr, int port)
 {
     int sock;
@@ -359,9 +669,13 @@ struct tftp_xfer *tftp_xfer_create(const char *ip_addr, int port)
     _private->ip_addr = rt_strdup(ip_addr);
     _private->port = port;
     _private->block = 0;
+    _private->rto = XFER_RTO_INIT;
     xfer->sock = sock;
     xfer->mode = rt_strdup(TFTP_XFER_OCTET);
+    /* the options of the request */
     xfer->blksize = XFER_DATA_SIZE_MAX;
+    xfer->windowsize = XFER_WINDOWSIZE_DEFAULT;
+    xfer->tsize = -1;
     xfer->_private = _private;
     return xfer;
 }
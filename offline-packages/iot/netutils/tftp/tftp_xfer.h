@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2019-02-26     tyx          first implementation
+ * 2024-10-19     Evlers       add option negotiation, windowsize (RFC 7440) and adaptive retransmit timeout
  */
 
 #include <stdint.h>
@@ -19,6 +20,7 @@
 #define TFTP_CMD_DATA       (3) /*Data (DATA)*/
 #define TFTP_CMD_ACK        (4) /*Acknowledgment (ACK)*/
 #define TFTP_CMD_ERROR      (5) /*Error (ERROR)*/
+#define TFTP_CMD_OACK       (6) /*Option Acknowledgment (OACK)*/
 
 #define TFTP_XFER_OCTET ("octet")
 #define TFTP_XFER_ASCII ("ascii")
@@ -26,7 +28,28 @@
 #define TFTP_XFER_TYPE_CLIENT (0x01)
 #define TFTP_XFER_TYPE_SERVER (0x02)
 
-#define XFER_DATA_SIZE_MAX (512)
+/* the block size of RFC 1350, it is used when the options are not acknowledged */
+#define XFER_BLKSIZE_DEFAULT (512)
+
+/* the largest block size, the default 1468 fits in one ethernet frame */
+#ifdef PKG_NETUTILS_TFTP_BLKSIZE_MAX
+#define XFER_DATA_SIZE_MAX PKG_NETUTILS_TFTP_BLKSIZE_MAX
+#else
+#define XFER_DATA_SIZE_MAX (1468)
+#endif
+
+/* the number of blocks sent before an ACK is required */
+#ifdef PKG_NETUTILS_TFTP_WINDOWSIZE
+#define XFER_WINDOWSIZE_DEFAULT PKG_NETUTILS_TFTP_WINDOWSIZE
+#else
+#define XFER_WINDOWSIZE_DEFAULT (8)
+#endif
+#define XFER_WINDOWSIZE_MAX (64)
+
+/* the range of the retransmit timeout in ms */
+#define XFER_RTO_INIT (1000)
+#define XFER_RTO_MIN  (20)
+#define XFER_RTO_MAX  (5000)
 
 union file_info
 {
@@ -47,6 +70,8 @@ struct tftp_xfer
     int sock;
     int type;
     int blksize;
+    int windowsize;
+    int tsize;          /* the transfer size of the tsize option, -1 is unknown */
     char *mode;
     void *_private;
 };
@@ -57,11 +82,29 @@ int tftp_send_request(struct tftp_xfer *xfer, uint16_t cmd, const char *remote_f
 struct tftp_xfer *tftp_recv_request(struct tftp_xfer *xfer, struct tftp_packet *packet);
 void tftp_xfer_mode_set(struct tftp_xfer *xfer, const char *mode);
 int tftp_xfer_blksize_set(struct tftp_xfer *xfer, int blksize);
+int tftp_xfer_windowsize_set(struct tftp_xfer *xfer, int windowsize);
 int tftp_xfer_type_set(struct tftp_xfer *xfer, int type);
+int tftp_xfer_select(struct tftp_xfer *xfer, int timeout_ms);
+void tftp_xfer_block_set(struct tftp_xfer *xfer, uint16_t block);
+int tftp_recv_packet(struct tftp_xfer *xfer, struct tftp_packet *pack, int len);
+int tftp_check_data(struct tftp_xfer *xfer, struct tftp_packet *pack, int size);
 int tftp_read_data(struct tftp_xfer *xfer, struct tftp_packet *pack, int size);
 void tftp_transfer_err(struct tftp_xfer *xfer, uint16_t err_no, const char *err_msg);
 int tftp_wait_ack(struct tftp_xfer *xfer);
 int tftp_write_data(struct tftp_xfer *xfer, struct tftp_packet *pack, int len);
 int tftp_resp_ack(struct tftp_xfer *xfer);
+int tftp_ack_due(struct tftp_xfer *xfer);
+
+/* options */
+int tftp_parse_options(struct tftp_xfer *xfer, const char *options, int len, int is_server);
+int tftp_send_oack(struct tftp_xfer *xfer);
+
+/* sliding window of the sender */
+int tftp_window_inflight(struct tftp_xfer *xfer);
+void tftp_window_rewind(struct tftp_xfer *xfer);
+
+/* adaptive retransmit timeout (RFC 6298) */
+int tftp_xfer_rto(struct tftp_xfer *xfer);
+void tftp_xfer_rto_backoff(struct tftp_xfer *xfer);
 
 #endif
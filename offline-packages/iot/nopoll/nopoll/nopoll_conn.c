@@ -48,6 +48,25 @@
 #include <nopoll_conn.h>
 #include <nopoll_private.h>
 
+/* bytes of the frame (header and payload) sent from the stack
+ * before the payload is sent directly from the caller buffer */
+#ifndef NOPOLL_SEND_CHUNK_SIZE
+#define NOPOLL_SEND_CHUNK_SIZE 256
+#endif
+
+/* size of the receive buffer of the frame views, the frames bigger
+ * than the buffer are delivered in several views */
+#ifndef NOPOLL_VIEW_BUFFER_SIZE
+#define NOPOLL_VIEW_BUFFER_SIZE 2048
+#endif
+
+/* a control frame is always viewed whole: 14 bytes of header and up to 125 of payload */
+#if NOPOLL_VIEW_BUFFER_SIZE < 14 + 125
+#error "NOPOLL_VIEW_BUFFER_SIZE must hold a whole control frame"
+#endif
+
+#define NOPOLL_VIEW_IS_CONTROL(op_code) ((op_code) == NOPOLL_PING_FRAME || (op_code) == NOPOLL_PONG_FRAME || (op_code) == NOPOLL_CLOSE_FRAME)
+
 #if defined(NOPOLL_OS_UNIX)
 # include <netinet/tcp.h>
 #endif
@@ -2194,6 +2213,9 @@ void nopoll_conn_unref (noPollConn * conn)
 	/* release pending write buffer */
 	nopoll_free (conn->pending_write);
 
+	/* release frame views buffer */
+	nopoll_free (conn->view_buf);
+
 	/* release mutexes */
 	nopoll_mutex_destroy (conn->handshake_mutex);
 	nopoll_mutex_destroy (conn->ref_mutex);
@@ -3095,15 +3117,51 @@ void nopoll_conn_complete_handshake (noPollConn * conn)
 	return;
 }
 
+/** 
+ * @internal Applies the mask to the payload (masking and unmasking
+ * are the same operation). The payload is processed 32 bits at a
+ * time once it is aligned, the bytes before and after the aligned
+ * words are processed one by one.
+ *
+ * @param desp Position of the payload inside the frame payload, used
+ * to rotate the mask.
+ */
 void nopoll_conn_mask_content (noPollCtx * ctx, char * payload, int payload_size, char * mask, int desp)
 {
-	int iter       = 0;
-	int mask_index = 0;
+	int            iter = 0;
+	unsigned int   word_mask;
+	char         * rotated = (char *) &word_mask;
 
+	/* head: byte by byte until the payload is aligned */
+	while (iter < payload_size && (((unsigned long) (payload + iter)) & 3)) {
+		payload[iter] ^= mask[(iter + desp) & 3];
+		iter++;
+	} /* end while */
+
+	if (payload_size - iter >= 4) {
+		/* the mask rotated to the first word, in memory order
+		   so it is valid for any endianness */
+		rotated[0] = mask[(iter + desp) & 3];
+		rotated[1] = mask[(iter + desp + 1) & 3];
+		rotated[2] = mask[(iter + desp + 2) & 3];
+		rotated[3] = mask[(iter + desp + 3) & 3];
+
+		while (payload_size - iter >= 16) {
+			((unsigned int *) (payload + iter))[0] ^= word_mask;
+			((unsigned int *) (payload + iter))[1] ^= word_mask;
+			((unsigned int *) (payload + iter))[2] ^= word_mask;
+			((unsigned int *) (payload + iter))[3] ^= word_mask;
+			iter += 16;
+		} /* end while */
+		while (payload_size - iter >= 4) {
+			*(unsigned int *) (payload + iter) ^= word_mask;
+			iter += 4;
+		} /* end while */
+	} /* end if */
+
+	/* tail */
 	while (iter < payload_size) {
-		/* rotate mask and apply it */
-		mask_index = (iter + desp) % 4;
-		payload[iter] ^= mask[mask_index];
+		payload[iter] ^= mask[(iter + desp) & 3];
 		iter++;
 	} /* end while */
 
@@ -3274,8 +3332,8 @@ noPollMsg   * nopoll_conn_get_msg (noPollConn * conn)
 			/* flag this message as a fragment */
 			msg->is_fragment = nopoll_true;
 
-			/* get fin bytes */
-			msg->has_fin      = 1; /* for now final message */
+			/* get fin bytes from the frame being read */
+			msg->has_fin      = conn->previous_msg->has_fin;
 			msg->op_code      = 0; /* continuation frame */
 
 			/* copy initial mask indication */
@@ -3670,6 +3728,236 @@ read_payload:
 	return msg;
 }
 
+/** 
+ * @internal Reads more bytes into the frame views buffer, moving the
+ * bytes not consumed yet to the begining.
+ *
+ * @return The number of bytes read, 0 when no bytes were available
+ * (or the buffer is full) and -1 when it fails.
+ */
+int __nopoll_conn_view_fill (noPollConn * conn)
+{
+	int bytes;
+
+	if (conn->view_buf == NULL) {
+		conn->view_buf = nopoll_new (char, NOPOLL_VIEW_BUFFER_SIZE);
+		if (conn->view_buf == NULL) {
+			nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Failed to allocate memory for frame views, closing session id: %d", conn->id);
+			nopoll_conn_shutdown (conn);
+			return -1;
+		} /* end if */
+	} /* end if */
+
+	/* move the bytes not consumed to the begining */
+	if (conn->view_start > 0) {
+		memmove (conn->view_buf, conn->view_buf + conn->view_start, conn->view_end - conn->view_start);
+		conn->view_end   -= conn->view_start;
+		conn->view_start  = 0;
+	} /* end if */
+
+	if (conn->view_end == NOPOLL_VIEW_BUFFER_SIZE)
+		return 0;
+
+	bytes = __nopoll_conn_receive (conn, conn->view_buf + conn->view_end, NOPOLL_VIEW_BUFFER_SIZE - conn->view_end);
+	if (bytes > 0)
+		conn->view_end += bytes;
+	return bytes;
+}
+
+/** 
+ * @brief Allows to get the payload of the next frame available on
+ * the provided connection without allocating a \ref noPollMsg: the
+ * view points to the payload (already unmasked) inside the
+ * connection receive buffer. As many frames as possible are read
+ * from the socket with a single receive operation.
+ *
+ * The view is valid until the next call to this function over the
+ * same connection. The payload is not nul terminated. Frames bigger
+ * than the receive buffer are delivered in several views (see
+ * noPollFrameView.remain_bytes). PING frames are replied and PONG
+ * frames are dropped internally, a CLOSE frame shuts down the
+ * connection.
+ *
+ * Do not mix this function with \ref nopoll_conn_get_msg (or a
+ * configured on message handler) over the same connection.
+ *
+ * @param conn The connection where the read operation will take
+ * place.
+ *
+ * @param view The view to be filled.
+ *
+ * @return nopoll_true if a view is available, otherwise nopoll_false
+ * is returned. In such case, check connection status with \ref
+ * nopoll_conn_is_ok.
+ */
+nopoll_bool   nopoll_conn_get_frame_view (noPollConn * conn, noPollFrameView * view)
+{
+	unsigned char * frame;
+	int             avail;
+	int             header_size;
+	long            payload_size;
+	long            size;
+	nopoll_bool     masked;
+
+	if (conn == NULL || view == NULL)
+		return nopoll_false;
+
+#if NOPOLL_TLS
+	/* let get_msg finish the TLS accept */
+	if (conn->pending_ssl_accept || conn->pending_ssl_connect) {
+		nopoll_conn_get_msg (conn);
+		return nopoll_false;
+	} /* end if */
+#endif
+
+	/* check connection status */
+	if (! conn->handshake_ok) {
+		nopoll_mutex_lock (conn->handshake_mutex);
+		nopoll_conn_complete_handshake (conn);
+		nopoll_mutex_unlock (conn->handshake_mutex);
+
+		if (! conn->handshake_ok) 
+			return nopoll_false;
+	} /* end if */
+
+	while (nopoll_conn_is_ok (conn)) {
+		avail = conn->view_end - conn->view_start;
+
+		/* payload of the current frame */
+		if (conn->view_remain > 0) {
+			if (avail == 0) {
+				if (__nopoll_conn_view_fill (conn) <= 0)
+					return nopoll_false;
+				continue;
+			} /* end if */
+
+			size = avail < conn->view_remain ? avail : conn->view_remain;
+			view->payload      = conn->view_buf + conn->view_start;
+			view->payload_size = (int) size;
+			if (conn->view_masked) {
+				nopoll_conn_mask_content (conn->ctx, conn->view_buf + conn->view_start, (int) size, conn->view_mask, conn->view_desp);
+				conn->view_desp += (int) size;
+			} /* end if */
+			conn->view_start  += (int) size;
+			conn->view_remain -= size;
+			goto deliver;
+		} /* end if */
+
+		/* frame header */
+		frame       = (unsigned char *) conn->view_buf + conn->view_start;
+		header_size = 2;
+		if (avail >= 2) {
+			if ((frame[1] & 0x7F) == 126)
+				header_size += 2;
+			else if ((frame[1] & 0x7F) == 127)
+				header_size += 8;
+			if (frame[1] & 0x80)
+				header_size += 4;
+		} /* end if */
+		if (avail < header_size) {
+			if (__nopoll_conn_view_fill (conn) <= 0)
+				return nopoll_false;
+			continue;
+		} /* end if */
+
+		masked       = nopoll_get_bit (frame[1], 7);
+		payload_size = frame[1] & 0x7F;
+		if (payload_size == 126) {
+			payload_size = nopoll_get_16bit ((const char *) frame + 2);
+		} else if (payload_size == 127) {
+			if (frame[2] || frame[3] || frame[4] || frame[5] || (frame[6] & 0x80)) {
+				nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "noPoll doesn't support frames bigger than 2GB, closing session id: %d", conn->id);
+				nopoll_conn_shutdown (conn);
+				return nopoll_false;
+			} /* end if */
+			payload_size = ((long) frame[6] << 24) | ((long) frame[7] << 16) | ((long) frame[8] << 8) | frame[9];
+		} /* end if */
+
+		/* ensure the frame is masked in case we are listener */
+		if (conn->role == NOPOLL_ROLE_LISTENER && ! masked) {
+			nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Received websocket frame with mask bit set to zero, closing session id: %d", 
+				    conn->id);
+			nopoll_conn_shutdown (conn);
+			return nopoll_false;
+		} /* end if */
+
+		/* control frames are never fragmented and carry up to 125 bytes (RFC 6455 5.5) */
+		if (NOPOLL_VIEW_IS_CONTROL (frame[0] & 0x0F) && (payload_size > 125 || ! nopoll_get_bit (frame[0], 7))) {
+			nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Received a control frame with a payload of %ld bytes or without FIN, closing session id: %d",
+				    payload_size, conn->id);
+			nopoll_conn_shutdown (conn);
+			return nopoll_false;
+		} /* end if */
+
+		/* wait for the whole frame unless it doesn't fit into the buffer */
+		if (payload_size > avail - header_size && header_size + payload_size <= NOPOLL_VIEW_BUFFER_SIZE) {
+			if (__nopoll_conn_view_fill (conn) <= 0)
+				return nopoll_false;
+			continue;
+		} /* end if */
+
+		conn->view_op_code = frame[0] & 0x0F;
+		conn->view_has_fin = nopoll_get_bit (frame[0], 7);
+		conn->view_masked  = masked;
+		conn->view_desp    = 0;
+		if (masked)
+			memcpy (conn->view_mask, frame + header_size - 4, 4);
+		conn->view_start  += header_size;
+		conn->view_remain  = payload_size;
+
+		/* control frames (always complete, up to 125 bytes) */
+		if (NOPOLL_VIEW_IS_CONTROL (conn->view_op_code)) {
+			if (conn->view_start + payload_size > conn->view_end) {
+				nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Control frame payload beyond the received data, closing session id: %d", conn->id);
+				nopoll_conn_shutdown (conn);
+				return nopoll_false;
+			} /* end if */
+			frame = (unsigned char *) conn->view_buf + conn->view_start;
+			if (masked)
+				nopoll_conn_mask_content (conn->ctx, (char *) frame, (int) payload_size, conn->view_mask, 0);
+			conn->view_start  += (int) payload_size;
+			conn->view_remain  = 0;
+
+			if (conn->view_op_code == NOPOLL_PING_FRAME) {
+				nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "PING received over connection id=%d, replying PONG", conn->id);
+				nopoll_conn_send_pong (conn, payload_size, (noPollPtr) frame);
+			} else if (conn->view_op_code == NOPOLL_CLOSE_FRAME) {
+				/* report that a closed frame was received */
+				conn->peer_close_status = 1005;
+				if (payload_size >= 2) {
+					conn->peer_close_status = nopoll_get_16bit ((const char *) frame);
+					conn->peer_close_reason = nopoll_new (char, payload_size - 1);
+					if (conn->peer_close_reason)
+						memcpy (conn->peer_close_reason, frame + 2, payload_size - 2);
+				} /* end if */
+				nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Proper connection close frame received id=%d, shutting down", conn->id);
+				nopoll_conn_shutdown (conn);
+				return nopoll_false;
+			} /* end if */
+			continue;
+		} /* end if */
+
+		if (payload_size > 0)
+			continue;
+
+		/* empty frame */
+		view->payload      = conn->view_buf + conn->view_start;
+		view->payload_size = 0;
+
+	deliver:
+		view->op_code      = conn->view_op_code;
+		view->remain_bytes = conn->view_remain;
+		view->has_fin      = conn->view_remain == 0 && conn->view_has_fin;
+		view->is_fragment  = ! view->has_fin || view->op_code == NOPOLL_CONTINUATION_FRAME;
+
+		/* next views of this frame are continuations */
+		conn->view_op_code = NOPOLL_CONTINUATION_FRAME;
+		return nopoll_true;
+	} /* end while */
+
+	return nopoll_false;
+}
+
 /** 
  * @internal Implementation to send Frames according to various
  * parameters passed in into the function. This is the core function
@@ -4413,6 +4701,108 @@ int nopoll_conn_flush_writes (noPollConn * conn, long timeout, int previous_resu
 }
 
 
+/** 
+ * @internal Sends the frame header and payload without building the
+ * whole frame in a new buffer: the header and the begining of the
+ * payload are sent together from a small chunk on the stack, the
+ * rest of the payload is sent directly from the caller buffer (or
+ * masked chunk by chunk when the frame is masked). In case not
+ * everything can be written, the rest is stored as pending write.
+ *
+ * @return The number of bytes written, including the header.
+ */
+int __nopoll_conn_send_gather (noPollConn * conn, const char * header, int header_size,
+			       const char * content, long length, char * mask)
+{
+	char          chunk[NOPOLL_SEND_CHUNK_SIZE];
+	const char  * data   = chunk;
+	long          offset;
+	long          total  = length + header_size;
+	int           size;
+	int           bytes_written;
+	int           desp   = 0;
+	int           tries  = 0;
+	char        * pending;
+
+	/* header and the begining of the payload */
+	offset = length < (long) (sizeof (chunk) - header_size) ? length : (long) (sizeof (chunk) - header_size);
+	memcpy (chunk, header, header_size);
+	if (offset > 0) {
+		memcpy (chunk + header_size, content, offset);
+		if (mask)
+			nopoll_conn_mask_content (conn->ctx, chunk + header_size, offset, mask, 0);
+	} /* end if */
+	size = header_size + offset;
+
+	while (nopoll_true) {
+		bytes_written = conn->send (conn, (char *) data, size);
+		if (bytes_written > 0)
+			desp += bytes_written;
+
+		if (bytes_written == size) {
+			if (desp == total)
+				break;
+
+			/* next part of the payload */
+			if (mask) {
+				size = (length - offset) < (long) sizeof (chunk) ? (length - offset) : (long) sizeof (chunk);
+				memcpy (chunk, content + offset, size);
+				nopoll_conn_mask_content (conn->ctx, chunk, size, mask, offset);
+				data = chunk;
+			} else {
+				size = length - offset;
+				data = content + offset;
+			} /* end if */
+			offset += size;
+			continue;
+		} /* end if */
+
+		nopoll_log (conn->ctx, NOPOLL_LEVEL_WARNING, 
+			    "Requested to write %d bytes but found %d written (masked? %d, header size: %d, length: %d), errno = %d : %s", 
+			    size, bytes_written, mask != NULL, header_size, (int) length, errno, strerror (errno));
+
+		/* part written */
+		if (bytes_written > 0) {
+			data += bytes_written;
+			size -= bytes_written;
+		} /* end if */
+
+		/* increase tries */
+		tries++;
+
+		if ((errno != 0) || tries > 50) {
+			nopoll_log (conn->ctx, NOPOLL_LEVEL_WARNING, "Found errno=%d (%s) value while trying to bytes to the WebSocket conn-id=%d or max tries reached=%d",
+				    errno, strerror (errno), conn->id, tries);
+			break;
+		} /* end if */
+
+		/* wait a bit */
+		nopoll_sleep (100000);
+	} /* end while */
+
+	if (desp == total)
+		return desp;
+
+	/* store the rest of the current part and the payload not
+	   sent as pending write */
+	pending = nopoll_new (char, total - desp);
+	if (pending == NULL) {
+		nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Unable to allocate memory to store pending write, shutting down conn-id=%d", conn->id);
+		nopoll_conn_shutdown (conn);
+		return desp;
+	} /* end if */
+	memcpy (pending, data, size);
+	if (length > offset) {
+		memcpy (pending + size, content + offset, length - offset);
+		if (mask)
+			nopoll_conn_mask_content (conn->ctx, pending + size, length - offset, mask, offset);
+	} /* end if */
+	conn->pending_write      = pending;
+	conn->pending_write_desp = 0;
+
+	return desp;
+}
+
 /** 
  * @internal Function used to send a frame over the provided
  * connection.
@@ -4528,110 +4918,117 @@ int nopoll_conn_send_frame (noPollConn * conn, nopoll_bool fin, nopoll_bool mask
 		header_size += 4;
 	} /* end if */
 
-	/* allocate enough memory to send content */
-	send_buffer = nopoll_new (char, length + header_size + 2);
-	if (send_buffer == NULL) {
-		nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Unable to allocate memory to implement send operation");
-		return -1;
-	} /* end if */
+	if (sleep_in_header == 0 && conn->__force_stop_after_header <= 0) {
+		/* common case: send header and payload without building the frame in a new buffer */
+		send_buffer   = NULL;
+		desp          = __nopoll_conn_send_gather (conn, header, header_size, (const char *) content, length, masked ? mask : NULL);
+		bytes_written = desp;
+	} else {
+		/* allocate enough memory to send content */
+		send_buffer = nopoll_new (char, length + header_size + 2);
+		if (send_buffer == NULL) {
+			nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Unable to allocate memory to implement send operation");
+			return -1;
+		} /* end if */
 	
-	/* copy content to be sent */
-	nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Copying into the buffer %d bytes of header (total memory allocated: %d)", 
-		    header_size, (int) length + header_size + 1);
-	memcpy (send_buffer, header, header_size);
-	if (length > 0) {
-		memcpy (send_buffer + header_size, content, length);
-
-		/* mask content before sending if requested */
-		if (masked) {
-			nopoll_conn_mask_content (conn->ctx, send_buffer + header_size, length, mask, 0);
-		}
-	} /* end if */
+		/* copy content to be sent */
+		nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Copying into the buffer %d bytes of header (total memory allocated: %d)", 
+			    header_size, (int) length + header_size + 1);
+		memcpy (send_buffer, header, header_size);
+		if (length > 0) {
+			memcpy (send_buffer + header_size, content, length);
+
+			/* mask content before sending if requested */
+			if (masked) {
+				nopoll_conn_mask_content (conn->ctx, send_buffer + header_size, length, mask, 0);
+			}
+		} /* end if */
 
 	
-	/* send content */
-	nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Mask used for this delivery: %d (about to send %d bytes)",
-		    nopoll_get_32bit (send_buffer + header_size - 2), (int) length + header_size);
+		/* send content */
+		nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Mask used for this delivery: %d (about to send %d bytes)",
+			    nopoll_get_32bit (send_buffer + header_size - 2), (int) length + header_size);
 
-	/* clear errno status before writting */
-	desp  = 0;
-	tries = 0;
+		/* clear errno status before writting */
+		desp  = 0;
+		tries = 0;
 
-	/***** BEGIN INTERNAL debug code for test_30, test_31, test_32, test_33, test_34, test_35 : nopoll-regression-client.c ******/
-	if ((conn->__force_stop_after_header > 0) && (conn->__force_stop_after_header < (length + header_size))) {
+		/***** BEGIN INTERNAL debug code for test_30, test_31, test_32, test_33, test_34, test_35 : nopoll-regression-client.c ******/
+		if ((conn->__force_stop_after_header > 0) && (conn->__force_stop_after_header < (length + header_size))) {
 		
-		nopoll_log (conn->ctx, NOPOLL_LEVEL_WARNING, "Sending broken header (just %d bytes) and implement a pause on purpose...", conn->__force_stop_after_header);
-
-		/* send just 2 bytes for the header and then implement a very long pause */
-		bytes_written = conn->send (conn, send_buffer, conn->__force_stop_after_header);
-		desp          = conn->__force_stop_after_header;
-		if (bytes_written != conn->__force_stop_after_header) {
-			nopoll_log (conn->ctx, NOPOLL_LEVEL_WARNING, "Requested to write %d bytes for the header but %d were written",
-				    conn->__force_stop_after_header, bytes_written);
-			desp  = 0;
-		} /* end if */
+			nopoll_log (conn->ctx, NOPOLL_LEVEL_WARNING, "Sending broken header (just %d bytes) and implement a pause on purpose...", conn->__force_stop_after_header);
 
-		/* sleep after header ... */
-		nopoll_sleep (5000000); /* 5 seconds */
+			/* send just 2 bytes for the header and then implement a very long pause */
+			bytes_written = conn->send (conn, send_buffer, conn->__force_stop_after_header);
+			desp          = conn->__force_stop_after_header;
+			if (bytes_written != conn->__force_stop_after_header) {
+				nopoll_log (conn->ctx, NOPOLL_LEVEL_WARNING, "Requested to write %d bytes for the header but %d were written",
+					    conn->__force_stop_after_header, bytes_written);
+				desp  = 0;
+			} /* end if */
 
-	} /* end if */
-	/****** END INTERNAL debug code for test_30 : nopoll-regression-client.c ******/
+			/* sleep after header ... */
+			nopoll_sleep (5000000); /* 5 seconds */
 
-	while (nopoll_true) {
-		/* try to write bytes */
-		if (sleep_in_header == 0) {
-			bytes_written = conn->send (conn, send_buffer + desp, length + header_size - desp);
-		} else {
-			nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Found sleep in header indication, sending header: %d bytes (waiting %ld)", header_size, sleep_in_header);
-			bytes_written = conn->send (conn, send_buffer, header_size);
-			if (bytes_written == header_size) {
-				/* sleep after header ... */
-				nopoll_sleep (sleep_in_header);
-				
-				/* now send the rest of the content (without the header) */
-				bytes_written = conn->send (conn, send_buffer + header_size, length);
-				nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Rest of content written %d (header size: %d, length: %d)", 
-					    bytes_written, header_size, length);
-				bytes_written = length + header_size;
-				nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "final bytes_written %d", bytes_written);
+		} /* end if */
+		/****** END INTERNAL debug code for test_30 : nopoll-regression-client.c ******/
+
+		while (nopoll_true) {
+			/* try to write bytes */
+			if (sleep_in_header == 0) {
+				bytes_written = conn->send (conn, send_buffer + desp, length + header_size - desp);
 			} else {
-				nopoll_log (conn->ctx, NOPOLL_LEVEL_WARNING, "Requested to write %d bytes for the header but %d were written",
-					    header_size, bytes_written);
-				return -1;
+				nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Found sleep in header indication, sending header: %d bytes (waiting %ld)", header_size, sleep_in_header);
+				bytes_written = conn->send (conn, send_buffer, header_size);
+				if (bytes_written == header_size) {
+					/* sleep after header ... */
+					nopoll_sleep (sleep_in_header);
+				
+					/* now send the rest of the content (without the header) */
+					bytes_written = conn->send (conn, send_buffer + header_size, length);
+					nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Rest of content written %d (header size: %d, length: %d)", 
+						    bytes_written, header_size, length);
+					bytes_written = length + header_size;
+					nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "final bytes_written %d", bytes_written);
+				} else {
+					nopoll_log (conn->ctx, NOPOLL_LEVEL_WARNING, "Requested to write %d bytes for the header but %d were written",
+						    header_size, bytes_written);
+					return -1;
+				} /* end if */
 			} /* end if */
-		} /* end if */
 		
-		if ((bytes_written + desp) != (length + header_size)) {
-			nopoll_log (conn->ctx, NOPOLL_LEVEL_WARNING, 
-				    "Requested to write %d bytes but found %d written (masked? %d, mask: %u, header size: %d, length: %d), errno = %d : %s", 
-				    (int) length + header_size - desp, bytes_written, masked, mask_value, header_size, (int) length, errno, strerror (errno));
-		} else {
+			if ((bytes_written + desp) != (length + header_size)) {
+				nopoll_log (conn->ctx, NOPOLL_LEVEL_WARNING, 
+					    "Requested to write %d bytes but found %d written (masked? %d, mask: %u, header size: %d, length: %d), errno = %d : %s", 
+					    (int) length + header_size - desp, bytes_written, masked, mask_value, header_size, (int) length, errno, strerror (errno));
+			} else {
+				/* accomulate bytes written to continue */
+				if (bytes_written > 0)
+					desp += bytes_written;
+
+				nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Bytes written to the wire %d (masked? %d, mask: %u, header size: %d, length: %d)", 
+					    bytes_written, masked, mask_value, header_size, (int) length);
+				break;
+			} /* end if */
+
 			/* accomulate bytes written to continue */
 			if (bytes_written > 0)
 				desp += bytes_written;
 
-			nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Bytes written to the wire %d (masked? %d, mask: %u, header size: %d, length: %d)", 
-				    bytes_written, masked, mask_value, header_size, (int) length);
-			break;
-		} /* end if */
-
-		/* accomulate bytes written to continue */
-		if (bytes_written > 0)
-			desp += bytes_written;
-
-		/* increase tries */
-		tries++;
+			/* increase tries */
+			tries++;
 
-		if ((errno != 0) || tries > 50) {
-			nopoll_log (conn->ctx, NOPOLL_LEVEL_WARNING, "Found errno=%d (%s) value while trying to bytes to the WebSocket conn-id=%d or max tries reached=%d",
-				    errno, strerror (errno), conn->id, tries);
-			break;
-		} /* end if */
+			if ((errno != 0) || tries > 50) {
+				nopoll_log (conn->ctx, NOPOLL_LEVEL_WARNING, "Found errno=%d (%s) value while trying to bytes to the WebSocket conn-id=%d or max tries reached=%d",
+					    errno, strerror (errno), conn->id, tries);
+				break;
+			} /* end if */
 
-		/* wait a bit */
-		nopoll_sleep (100000);
+			/* wait a bit */
+			nopoll_sleep (100000);
 
-	} /* end while */
+		} /* end while */
+	} /* end if */
 
 	/* record pending write bytes */
 	conn->pending_write_bytes = length + header_size - desp;
@@ -4676,13 +5073,14 @@ int nopoll_conn_send_frame (noPollConn * conn, nopoll_bool fin, nopoll_bool mask
 		    length, conn->pending_write_bytes, errno, conn->id);
 #endif
 
-	/* check pending bytes for the next operation */
-	if (conn->pending_write_bytes > 0) {
+	/* check pending bytes for the next operation (the gather send
+	   stores its own pending buffer) */
+	if (conn->pending_write_bytes > 0 && send_buffer) {
 		conn->pending_write = send_buffer;
 		conn->pending_write_desp = desp;
 		nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Stored %d bytes starting from %d out of %d bytes (header size: %d)", 
 			    conn->pending_write_bytes, desp, length + header_size, header_size);
-	} else {
+	} else if (send_buffer) {
 		/* release memory */
 		nopoll_free (send_buffer);
 	} /* end if */
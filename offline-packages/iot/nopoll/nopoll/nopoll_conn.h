@@ -175,6 +175,8 @@ nopoll_bool   nopoll_conn_set_sock_block         (NOPOLL_SOCKET socket,
 
 noPollMsg   * nopoll_conn_get_msg (noPollConn * conn);
 
+nopoll_bool   nopoll_conn_get_frame_view (noPollConn * conn, noPollFrameView * view);
+
 int           nopoll_conn_send_text (noPollConn * conn, const char * content, long length);
 
 int           nopoll_conn_send_text_fragment (noPollConn * conn, const char * content, long length);
@@ -239,6 +241,11 @@ int nopoll_conn_default_send (noPollConn * conn, char * buffer, int buffer_size)
 
 void nopoll_conn_mask_content (noPollCtx * ctx, char * payload, int payload_size, char * mask, int desp);
 
+int __nopoll_conn_send_gather (noPollConn * conn, const char * header, int header_size,
+			       const char * content, long length, char * mask);
+
+int __nopoll_conn_view_fill (noPollConn * conn);
+
 END_C_DECLS
 
 #endif
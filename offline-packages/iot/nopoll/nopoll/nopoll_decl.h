@@ -526,6 +526,36 @@ typedef enum {
 	NOPOLL_PONG_FRAME         = 10
 } noPollOpCode;
 
+/** 
+ * @brief Payload of a websocket frame received, pointing into the
+ * connection receive buffer (see \ref nopoll_conn_get_frame_view).
+ */
+typedef struct _noPollFrameView {
+	/** 
+	 * @brief Frame op code, \ref NOPOLL_CONTINUATION_FRAME for the
+	 * next views of a frame delivered in several views.
+	 */
+	noPollOpCode   op_code;
+	/** 
+	 * @brief The FIN flag, only set on the last view of the frame.
+	 */
+	nopoll_bool    has_fin;
+	/** 
+	 * @brief The view is not a complete message.
+	 */
+	nopoll_bool    is_fragment;
+	/** 
+	 * @brief Payload (unmasked and not nul terminated).
+	 */
+	const char   * payload;
+	int            payload_size;
+	/** 
+	 * @brief Payload bytes of the frame to be delivered in the next
+	 * views.
+	 */
+	long           remain_bytes;
+} noPollFrameView;
+
 /** 
  * @brief SSL/TLS protocol type to use for the client or listener
  * connection. 
@@ -322,6 +322,20 @@ struct _noPollConn {
 	int                   pending_write_desp;
     int                   pending_write_added_header;
 
+	/** 
+	 * @internal Receive buffer and state of the frame views (see
+	 * nopoll_conn_get_frame_view).
+	 */
+	char                * view_buf;
+	int                   view_start;
+	int                   view_end;
+	long                  view_remain;
+	int                   view_desp;
+	char                  view_mask[4];
+	nopoll_bool           view_masked;
+	nopoll_bool           view_has_fin;
+	noPollOpCode          view_op_code;
+
 	/** 
 	 * @internal Internal reference to the connection options.
 	 */
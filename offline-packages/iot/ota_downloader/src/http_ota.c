@@ -6,16 +6,23 @@
  * Change Logs:
  * Date           Author       Notes
  * 2018-03-22     Murphy       the first version
+ * 2024-10-19     Evlers       pipeline the download and flash write, add streaming verification and resume
+ * 2024-10-19     Evlers       add support for the compressed and delta firmware package
  */
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <rtthread.h>
 #include <finsh.h>
 
 #include "webclient.h"
 #include <fal.h>
 
+#ifdef PKG_OTA_DOWNLOADER_USING_PATCH
+#include "ota_patch.h"
+#endif
+
 #define DBG_ENABLE
 #define DBG_SECTION_NAME          "http_ota"
 #ifdef OTA_DOWNLOADER_DEBUG
@@ -28,20 +35,118 @@
 
 #ifdef PKG_USING_HTTP_OTA
 
-#define HTTP_OTA_BUFF_LEN         1024
+#if defined(PKG_USING_TINYCRYPT) && defined(TINY_CRYPT_SHA256)
+#include <tiny_sha2.h>
+#define HTTP_OTA_USING_SHA256
+#endif
+
+#if defined(PKG_HTTP_OTA_USING_CHECKPOINT) && defined(PKG_USING_EASYFLASH)
+#include <easyflash.h>
+#define HTTP_OTA_USING_CHECKPOINT
+#endif
+
+#ifndef HTTP_OTA_BUFF_LEN
+#define HTTP_OTA_BUFF_LEN         4096
+#endif
+
+/* the number of received buffers queued to the flash writer, 2 is the double buffering */
+#ifndef HTTP_OTA_PIPE_DEPTH
+#define HTTP_OTA_PIPE_DEPTH       2
+#endif
+
+/* the interval of the resume checkpoint, it is rounded up to the erase size of flash */
+#ifndef HTTP_OTA_CHECKPOINT_SIZE
+#define HTTP_OTA_CHECKPOINT_SIZE  (64 * 1024)
+#endif
+
 #define GET_HEADER_BUFSZ          512
 #define GET_RESP_BUFSZ            512
 #define HTTP_OTA_DL_DELAY         (10 * RT_TICK_PER_SECOND)
 
+#define HTTP_OTA_WRITER_STACK     2048
+#define HTTP_OTA_WRITER_PRIORITY  (RT_THREAD_PRIORITY_MAX / 2)
+
+#define HTTP_OTA_CHECKPOINT_KEY   "http_ota_ckpt"
+#define HTTP_OTA_CHECKPOINT_MAGIC 0x4F54414B
+
 #define HTTP_OTA_URL              PKG_HTTP_OTA_URL
 
 /* the address offset of download partition */
 #ifndef RT_USING_FAL
 #error "Please enable and confirgure FAL part."
 #endif /* RT_USING_FAL */
+
+/* the header of the rbl package made by ota_packager */
+struct http_ota_rbl_hdr
+{
+    char magic[4];
+    rt_uint16_t algo;
+    rt_uint16_t algo2;
+    rt_uint32_t time_stamp;
+    char name[16];
+    char version[24];
+    char sn[24];
+    rt_uint32_t body_crc;       /* crc32 of the package body */
+    rt_uint32_t hash_code;
+    rt_uint32_t raw_size;
+    rt_uint32_t pkg_size;       /* size of the package body */
+    rt_uint32_t hdr_crc;
+};
+
+/* the verification state, it covers all of the data before the write offset */
+struct http_ota_verify
+{
+    struct http_ota_rbl_hdr hdr;
+    rt_uint32_t body_crc;
+#ifdef HTTP_OTA_USING_SHA256
+    tiny_sha2_context sha256;
+#endif
+};
+
+struct http_ota_checkpoint
+{
+    rt_uint32_t magic;
+    rt_uint32_t id;             /* crc32 of the url and the ETag */
+    rt_uint32_t file_size;
+    rt_uint32_t offset;         /* the data before this offset has been written to flash */
+    struct http_ota_verify verify;
+};
+
+struct http_ota_block
+{
+    char *buffer;
+    int length;
+};
+
+struct http_ota_pipe
+{
+    rt_mq_t mq;
+    struct rt_semaphore done;
+    volatile int error;
+
+    rt_uint32_t id;
+    size_t image_size;          /* size of the image written to flash, it is the file size except the patch */
+    size_t received;            /* received length of the file */
+    rt_bool_t resumable;        /* the checkpoint is saved */
+    size_t blk_size;            /* erase size of the flash */
+    size_t checkpoint_size;
+    size_t offset;              /* write pointer */
+    size_t erased;              /* the flash before this offset is erased */
+    struct http_ota_verify verify;
+#ifdef PKG_OTA_DOWNLOADER_USING_PATCH
+    struct ota_patch *patch;
+#endif
+
+    /* statistics */
+    rt_tick_t erase_ticks;
+    rt_tick_t write_ticks;
+    rt_tick_t stall_ticks;      /* the receiver waits for the flash writer */
+};
+
 const struct fal_partition * dl_part = RT_NULL;
 static int begin_offset = 0;
 static int file_size = 0;
+static struct http_ota_pipe ota_pipe;
 
 static void print_progress(size_t cur_size, size_t total_size)
 {
@@ -74,35 +179,456 @@ static void print_progress(size_t cur_size, size_t total_size)
     LOG_I("Download: [%s] %03d%%\033[1A", progress_sign, per);
 }
 
-/* handle function, you can store data and so on */
+/* crc32 (IEEE 802.3) with the nibble table, the same as the rbl package */
+static rt_uint32_t http_ota_crc32(rt_uint32_t crc, const void *buf, size_t size)
+{
+    static const rt_uint32_t table[16] =
+    {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    const rt_uint8_t *p = buf;
+
+    crc = ~crc;
+    while (size--)
+    {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+
+    return ~crc;
+}
+
+/* update the verification state with the data at the offset of the download partition */
+static void http_ota_verify_update(struct http_ota_verify *verify, size_t offset, const rt_uint8_t *data, size_t size)
+{
+#ifdef HTTP_OTA_USING_SHA256
+    tiny_sha2_update(&verify->sha256, (uint8_t *) data, size);
+#endif
+
+    /* keep the header of the rbl package, the crc32 covers the body only */
+    if (offset < sizeof(verify->hdr))
+    {
+        size_t len = sizeof(verify->hdr) - offset;
+
+        if (len > size)
+        {
+            len = size;
+        }
+
+        rt_memcpy((rt_uint8_t *) &verify->hdr + offset, data, len);
+        data += len;
+        size -= len;
+    }
+
+    verify->body_crc = http_ota_crc32(verify->body_crc, data, size);
+}
+
+#ifdef HTTP_OTA_USING_CHECKPOINT
+static void http_ota_checkpoint_save(struct http_ota_pipe *pipe)
+{
+    struct http_ota_checkpoint *ckpt = rt_malloc(sizeof(struct http_ota_checkpoint));
+
+    if (ckpt == RT_NULL)
+    {
+        return;
+    }
+
+    ckpt->magic = HTTP_OTA_CHECKPOINT_MAGIC;
+    ckpt->id = pipe->id;
+    ckpt->file_size = file_size;
+    ckpt->offset = pipe->offset;
+    rt_memcpy(&ckpt->verify, &pipe->verify, sizeof(ckpt->verify));
+
+    if (ef_set_env_blob(HTTP_OTA_CHECKPOINT_KEY, ckpt, sizeof(struct http_ota_checkpoint)) != EF_NO_ERR)
+    {
+        LOG_W("Save the download checkpoint failed!");
+    }
+
+    rt_free(ckpt);
+}
+
+/* restore the state from the checkpoint of the same file, return the offset to resume from */
+static size_t http_ota_checkpoint_load(struct http_ota_pipe *pipe)
+{
+    struct http_ota_checkpoint *ckpt = rt_malloc(sizeof(struct http_ota_checkpoint));
+    size_t saved_len = 0, offset = 0;
+
+    if (ckpt == RT_NULL)
+    {
+        return 0;
+    }
+
+    ef_get_env_blob(HTTP_OTA_CHECKPOINT_KEY, ckpt, sizeof(struct http_ota_checkpoint), &saved_len);
+
+    /* the checkpoint is always at the erase boundary, so the flash after it is not written */
+    if (saved_len == sizeof(struct http_ota_checkpoint) && ckpt->magic == HTTP_OTA_CHECKPOINT_MAGIC &&
+        ckpt->id == pipe->id && ckpt->file_size == (rt_uint32_t) file_size &&
+        ckpt->offset < (rt_uint32_t) file_size && ckpt->offset % pipe->blk_size == 0)
+    {
+        rt_memcpy(&pipe->verify, &ckpt->verify, sizeof(pipe->verify));
+        offset = ckpt->offset;
+    }
+
+    rt_free(ckpt);
+
+    return offset;
+}
+#endif /* HTTP_OTA_USING_CHECKPOINT */
+
+/* write the data at the write pointer, the flash is erased lazily just ahead of the write pointer */
+static int http_ota_write(struct http_ota_pipe *pipe, const rt_uint8_t *data, size_t size)
+{
+    while (size)
+    {
+        size_t len = size;
+        size_t checkpoint = (pipe->offset / pipe->checkpoint_size + 1) * pipe->checkpoint_size;
+        rt_tick_t tick;
+
+        /* split the data at the checkpoint, the state of checkpoint covers the data before it exactly */
+        if (pipe->offset + len > checkpoint)
+        {
+            len = checkpoint - pipe->offset;
+        }
+
+        if (pipe->offset + len > pipe->image_size)
+        {
+            LOG_E("Firmware download failed! Receive more data than the image size(%d)!", (int) pipe->image_size);
+            return -RT_ERROR;
+        }
+
+        tick = rt_tick_get();
+        while (pipe->erased < pipe->offset + len)
+        {
+            if (fal_partition_erase(dl_part, pipe->erased, pipe->blk_size) < 0)
+            {
+                LOG_E("Firmware download failed! Partition (%s) erase error!", dl_part->name);
+                return -RT_ERROR;
+            }
+            pipe->erased += pipe->blk_size;
+        }
+        pipe->erase_ticks += rt_tick_get() - tick;
+
+        tick = rt_tick_get();
+        if (fal_partition_write(dl_part, pipe->offset, data, len) < 0)
+        {
+            LOG_E("Firmware download failed! Partition (%s) write data error!", dl_part->name);
+            return -RT_ERROR;
+        }
+        pipe->write_ticks += rt_tick_get() - tick;
+
+        /* verify the data in the ram, there is no read back of the flash */
+        http_ota_verify_update(&pipe->verify, pipe->offset, data, len);
+
+        pipe->offset += len;
+        data += len;
+        size -= len;
+
+#ifdef HTTP_OTA_USING_CHECKPOINT
+        if (pipe->resumable && pipe->offset == checkpoint && pipe->offset < pipe->image_size)
+        {
+            http_ota_checkpoint_save(pipe);
+        }
+#endif
+    }
+
+    print_progress(pipe->offset, pipe->image_size);
+
+    return RT_EOK;
+}
+
+#ifdef PKG_OTA_DOWNLOADER_USING_PATCH
+static int http_ota_patch_write(void *ctx, const rt_uint8_t *data, size_t size)
+{
+    return http_ota_write((struct http_ota_pipe *) ctx, data, size);
+}
+
+/* decode the compressed or delta package, the first block must have the header of the package */
+static int http_ota_patch_feed(struct http_ota_pipe *pipe, const rt_uint8_t *data, size_t size)
+{
+    const struct ota_patch_header *hdr;
+
+    if (pipe->patch == RT_NULL)
+    {
+        pipe->patch = ota_patch_create(fal_partition_find(OTA_PATCH_OLD_PART), http_ota_patch_write, pipe);
+        if (pipe->patch == RT_NULL)
+        {
+            LOG_E("Firmware download failed! No memory for the patch decoder!");
+            return -RT_ENOMEM;
+        }
+
+        /* get the image size before the data is decoded */
+        if (ota_patch_feed(pipe->patch, data, sizeof(struct ota_patch_header)) != RT_EOK)
+        {
+            return -RT_ERROR;
+        }
+        data += sizeof(struct ota_patch_header);
+        size -= sizeof(struct ota_patch_header);
+
+        hdr = ota_patch_get_header(pipe->patch);
+        if (hdr->new_size > dl_part->len)
+        {
+            LOG_E("Firmware download failed! The image size is larger than the partition (%s)!", dl_part->name);
+            return -RT_ERROR;
+        }
+        pipe->image_size = hdr->new_size;
+
+        /* the state of decoder is not saved, so the package is always downloaded from the beginning */
+        pipe->resumable = RT_FALSE;
+
+        LOG_I("The %s package (%d bytes) of the image (%d bytes).",
+              (hdr->flags & OTA_PATCH_FLAG_DELTA) ? "delta" : "compressed", file_size, hdr->new_size);
+    }
+
+    return ota_patch_feed(pipe->patch, data, size);
+}
+#endif /* PKG_OTA_DOWNLOADER_USING_PATCH */
+
+/* write the received data of the file */
+static int http_ota_receive(struct http_ota_pipe *pipe, const rt_uint8_t *data, size_t size)
+{
+    int ret;
+
+#ifdef PKG_OTA_DOWNLOADER_USING_PATCH
+    if (pipe->patch || (pipe->received == 0 && ota_patch_detect(data, size)))
+    {
+        ret = http_ota_patch_feed(pipe, data, size);
+    }
+    else
+#endif
+    {
+        ret = http_ota_write(pipe, data, size);
+    }
+
+    pipe->received += size;
+
+    return ret;
+}
+
+/* the flash writer thread, it writes the buffers queued by the receiver */
+static void http_ota_writer_entry(void *parameter)
+{
+    struct http_ota_pipe *pipe = (struct http_ota_pipe *) parameter;
+    struct http_ota_block block;
+
+    while (rt_mq_recv(pipe->mq, &block, sizeof(block), RT_WAITING_FOREVER) >= 0)
+    {
+        /* the end of download */
+        if (block.buffer == RT_NULL)
+        {
+#ifdef PKG_OTA_DOWNLOADER_USING_PATCH
+            /* flush the decoder and check the decoded image */
+            if (pipe->error == RT_EOK && pipe->patch && pipe->received == (size_t) file_size &&
+                ota_patch_finish(pipe->patch) != RT_EOK)
+            {
+                pipe->error = -RT_ERROR;
+            }
+#endif
+            break;
+        }
+
+        /* keep draining the queue after an error, so that the receiver is never blocked */
+        if (pipe->error == RT_EOK && http_ota_receive(pipe, (rt_uint8_t *) block.buffer, block.length) != RT_EOK)
+        {
+            pipe->error = -RT_ERROR;
+        }
+
+        rt_free(block.buffer);
+    }
+
+    rt_sem_release(&pipe->done);
+}
+
+/* handle function of the receiver, the buffer is passed to the flash writer */
 static int http_ota_shard_download_handle(char *buffer, int length)
 {
-    int ret = RT_EOK;
-    /* Write the data to the corresponding partition address */
-    if (fal_partition_write(dl_part, begin_offset, buffer, length) < 0)
+    struct http_ota_block block;
+    rt_tick_t tick;
+
+    if (ota_pipe.error != RT_EOK)
     {
-        LOG_E("Firmware download failed! Partition (%s) write data error!", dl_part->name);
-        ret = -RT_ERROR;
-        goto __exit;
+        rt_free(buffer);
+        return -RT_ERROR;
     }
+
+    block.buffer = buffer;
+    block.length = length;
+
+    /* the receiver continues with the next buffer while the writer is busy, it waits only if the queue is full */
+    tick = rt_tick_get();
+    if (rt_mq_send_wait(ota_pipe.mq, &block, sizeof(block), RT_WAITING_FOREVER) != RT_EOK)
+    {
+        rt_free(buffer);
+        return -RT_ERROR;
+    }
+    ota_pipe.stall_ticks += rt_tick_get() - tick;
+
     begin_offset += length;
 
-    print_progress(begin_offset, file_size);
+    return RT_EOK;
+}
+
+#ifdef HTTP_OTA_USING_SHA256
+/* compare the lower case hex string with the input, ignore the case of the input */
+static int http_ota_hex_compare(const char *hex, const char *input)
+{
+    while (*hex)
+    {
+        char ch = *input++;
+
+        if (ch >= 'A' && ch <= 'F')
+        {
+            ch += 'a' - 'A';
+        }
+
+        if (ch != *hex++)
+        {
+            return -1;
+        }
+    }
+
+    return *input == '\0' ? 0 : -1;
+}
+#endif
+
+/* check the data of download partition by the streaming verification state */
+static int http_ota_verify_finish(struct http_ota_pipe *pipe, const char *sha256_hex)
+{
+    struct http_ota_rbl_hdr *hdr = &pipe->verify.hdr;
+    int ret = RT_EOK;
+
+    if (pipe->image_size > sizeof(*hdr) && rt_memcmp(hdr->magic, "RBL", 4) == 0 &&
+        hdr->pkg_size == pipe->image_size - sizeof(*hdr))
+    {
+        if (hdr->body_crc != pipe->verify.body_crc)
+        {
+            LOG_E("Firmware verify failed! The body crc32 is 0x%08X, expect 0x%08X.", pipe->verify.body_crc, hdr->body_crc);
+            ret = -RT_ERROR;
+        }
+        else
+        {
+            LOG_I("Firmware (%.*s %.*s) crc32 check OK.", (int) sizeof(hdr->name), hdr->name,
+                  (int) sizeof(hdr->version), hdr->version);
+        }
+    }
+
+#ifdef HTTP_OTA_USING_SHA256
+    {
+        rt_uint8_t digest[32];
+        char hex[sizeof(digest) * 2 + 1];
+        int i;
+
+        tiny_sha2_finish(&pipe->verify.sha256, digest);
+        for (i = 0; i < (int) sizeof(digest); i++)
+        {
+            rt_snprintf(&hex[i * 2], 3, "%02x", digest[i]);
+        }
+        LOG_I("Firmware sha256: %s", hex);
+
+        if (sha256_hex && http_ota_hex_compare(hex, sha256_hex) != 0)
+        {
+            LOG_E("Firmware verify failed! The sha256 is mismatched.");
+            ret = -RT_ERROR;
+        }
+    }
+#else
+    if (sha256_hex)
+    {
+        LOG_W("The sha256 verification is not supported, please enable the SHA256 of TinyCrypt.");
+    }
+#endif
 
-__exit:
-    rt_free(buffer);
     return ret;
 }
 
+static int http_ota_pipe_init(struct http_ota_pipe *pipe, struct webclient_session *session, const char *uri)
+{
+    const struct fal_flash_dev *flash;
+    const char *etag;
+
+    rt_memset(pipe, 0, sizeof(struct http_ota_pipe));
+    pipe->image_size = file_size;
+    pipe->resumable = RT_TRUE;
+
+    flash = fal_flash_device_find(dl_part->flash_name);
+    pipe->blk_size = (flash && flash->blk_size) ? flash->blk_size : 4096;
+    pipe->checkpoint_size = RT_ALIGN(HTTP_OTA_CHECKPOINT_SIZE, pipe->blk_size);
+
+    /* the download is identified by the url and the ETag, a changed file is never resumed */
+    pipe->id = http_ota_crc32(0, uri, rt_strlen(uri));
+    etag = webclient_header_fields_get(session, "ETag");
+    if (etag)
+    {
+        pipe->id = http_ota_crc32(pipe->id, etag, rt_strlen(etag));
+    }
+
+#ifdef HTTP_OTA_USING_SHA256
+    tiny_sha2_starts(&pipe->verify.sha256, 0);
+#endif
+
+#ifdef HTTP_OTA_USING_CHECKPOINT
+    pipe->offset = http_ota_checkpoint_load(pipe);
+    if (pipe->offset)
+    {
+        LOG_I("Resume the download from the checkpoint (%d).", (int) pipe->offset);
+    }
+#endif
+    pipe->erased = pipe->offset;
+    pipe->received = pipe->offset;
+    begin_offset = pipe->offset;
+
+    pipe->mq = rt_mq_create("ota_pipe", sizeof(struct http_ota_block), HTTP_OTA_PIPE_DEPTH, RT_IPC_FLAG_FIFO);
+    if (pipe->mq == RT_NULL)
+    {
+        return -RT_ENOMEM;
+    }
+    rt_sem_init(&pipe->done, "ota_done", 0, RT_IPC_FLAG_FIFO);
+
+    return RT_EOK;
+}
+
+static void http_ota_pipe_deinit(struct http_ota_pipe *pipe)
+{
+    struct http_ota_block block;
+
+    if (pipe->mq)
+    {
+        /* release the buffers which are not written */
+        while (rt_mq_recv(pipe->mq, &block, sizeof(block), 0) >= 0)
+        {
+            if (block.buffer)
+            {
+                rt_free(block.buffer);
+            }
+        }
+
+        rt_mq_delete(pipe->mq);
+        rt_sem_detach(&pipe->done);
+        pipe->mq = RT_NULL;
+    }
+
+#ifdef PKG_OTA_DOWNLOADER_USING_PATCH
+    if (pipe->patch)
+    {
+        ota_patch_delete(pipe->patch);
+        pipe->patch = RT_NULL;
+    }
+#endif
+}
+
 rt_weak void http_ota_success (const struct fal_partition *part, uint32_t size)
 {
     /* Implement this function to write upgrade information */
 }
 
-static int http_ota_fw_download(const char* uri)
+static int http_ota_fw_download(const char* uri, const char *sha256_hex)
 {
     int ret = RT_EOK;
     struct webclient_session* session = RT_NULL;
+    struct http_ota_block block = { RT_NULL, 0 };
+    rt_thread_t writer;
+    rt_tick_t start_tick;
 
     /* create webclient session and set header response size */
     session = webclient_session_create(GET_HEADER_BUFSZ);
@@ -113,6 +639,8 @@ static int http_ota_fw_download(const char* uri)
         goto __exit;
     }
 
+    start_tick = rt_tick_get();
+
     /* get the real data length */
     webclient_shard_head_function(session, uri, &file_size);
 
@@ -131,7 +659,7 @@ static int http_ota_fw_download(const char* uri)
     LOG_I("OTA file size is (%d)", file_size);
     LOG_I("\033[1A");
 
-    /* Get download partition information and erase download partition data */
+    /* Get download partition information */
     if ((dl_part = fal_partition_find("download")) == RT_NULL)
     {
         LOG_E("Firmware download failed! Partition (%s) find error!", "download");
@@ -139,51 +667,94 @@ static int http_ota_fw_download(const char* uri)
         goto __exit;
     }
 
-    LOG_I("Start erase flash (%s) partition!", dl_part->name);
+    if ((size_t) file_size > dl_part->len)
+    {
+        LOG_E("Firmware download failed! The file size is larger than the partition (%s)!", dl_part->name);
+        ret = -RT_ERROR;
+        goto __exit;
+    }
+
+    /* the flash is erased by the writer just ahead of the data */
+    if (http_ota_pipe_init(&ota_pipe, session, uri) != RT_EOK)
+    {
+        LOG_E("Firmware download failed! No memory for the download pipe!");
+        ret = -RT_ERROR;
+        goto __exit;
+    }
 
-    if (fal_partition_erase(dl_part, 0, file_size) < 0)
+    writer = rt_thread_create("ota_wr", http_ota_writer_entry, &ota_pipe,
+                              HTTP_OTA_WRITER_STACK, HTTP_OTA_WRITER_PRIORITY, 10);
+    if (writer == RT_NULL)
     {
-        LOG_E("Firmware download failed! Partition (%s) erase error!", dl_part->name);
+        LOG_E("Firmware download failed! Create the flash writer thread failed!");
         ret = -RT_ERROR;
         goto __exit;
     }
-    LOG_I("Erase flash (%s) partition success!", dl_part->name);
+    rt_thread_startup(writer);
 
     /* register the handle function, you can handle data in the function */
     webclient_register_shard_position_function(session, http_ota_shard_download_handle);
 
     /* the "memory size" that you can provide in the project and uri */
-    ret = webclient_shard_position_function(session, uri, begin_offset, file_size, HTTP_OTA_BUFF_LEN);
+    ret = webclient_shard_position_function(session, uri, begin_offset, file_size - begin_offset, HTTP_OTA_BUFF_LEN);
 
     /* clear the handle function */
     webclient_register_shard_position_function(session, RT_NULL);
 
-    if (ret == RT_EOK)
+    if (session != RT_NULL)
     {
-        if (session != RT_NULL)
-        {
-            webclient_close(session);
-            session = RT_NULL;
-        }
+        webclient_close(session);
+        session = RT_NULL;
+    }
+
+    /* wait for the flash writer to finish the queued buffers */
+    rt_mq_send_wait(ota_pipe.mq, &block, sizeof(block), RT_WAITING_FOREVER);
+    rt_sem_take(&ota_pipe.done, RT_WAITING_FOREVER);
+
+    if (ret == RT_EOK && ota_pipe.error == RT_EOK)
+    {
+        rt_tick_t ticks = rt_tick_get() - start_tick;
+        int ms = ticks * 1000 / RT_TICK_PER_SECOND;
 
         LOG_I("\033[0B");
-        LOG_I("Download firmware to flash success.");
+        LOG_I("Time to flash: %d ms (%d KB/s), erase: %d ms, write: %d ms, receiver waited: %d ms.", ms,
+              ms ? (int) ((rt_uint64_t) file_size * 1000 / 1024 / ms) : 0,
+              ota_pipe.erase_ticks * 1000 / RT_TICK_PER_SECOND, ota_pipe.write_ticks * 1000 / RT_TICK_PER_SECOND,
+              ota_pipe.stall_ticks * 1000 / RT_TICK_PER_SECOND);
 
-        if (begin_offset == file_size)
+        if (ota_pipe.received != (size_t) file_size || ota_pipe.offset != ota_pipe.image_size)
+        {
+            LOG_E("Receive length error, receive length: %u, file size: %u\n", (unsigned) ota_pipe.received, file_size);
+            ret = -RT_ERROR;
+        }
+        else if (http_ota_verify_finish(&ota_pipe, sha256_hex) != RT_EOK)
         {
-            http_ota_success(dl_part, file_size);
+            ret = -RT_ERROR;
+#ifdef HTTP_OTA_USING_CHECKPOINT
+            /* the data is wrong, download it again next time */
+            ef_del_env(HTTP_OTA_CHECKPOINT_KEY);
+#endif
         }
         else
         {
-            LOG_E("Receive length error, receive length: %u, file size: %u\n", begin_offset, file_size);
+#ifdef HTTP_OTA_USING_CHECKPOINT
+            ef_del_env(HTTP_OTA_CHECKPOINT_KEY);
+#endif
+            LOG_I("Download firmware to flash success.");
+            http_ota_success(dl_part, ota_pipe.image_size);
         }
     }
     else
     {
+        ret = -RT_ERROR;
         LOG_E("Download firmware failed.");
+#ifdef HTTP_OTA_USING_CHECKPOINT
+        LOG_I("Run the command again to resume the download.");
+#endif
     }
 
 __exit:
+    http_ota_pipe_deinit(&ota_pipe);
     if (session != RT_NULL)
         webclient_close(session);
     begin_offset = 0;
@@ -196,15 +767,15 @@ void http_ota(uint8_t argc, char **argv)
     if (argc < 2)
     {
         rt_kprintf("using uri: " HTTP_OTA_URL "\n");
-        http_ota_fw_download(HTTP_OTA_URL);
+        http_ota_fw_download(HTTP_OTA_URL, RT_NULL);
     }
     else
     {
-        http_ota_fw_download(argv[1]);
+        http_ota_fw_download(argv[1], argc > 2 ? argv[2] : RT_NULL);
     }
 }
 /**
- * msh />http_ota [url]
+ * msh />http_ota [url] [sha256]
 */
 MSH_CMD_EXPORT(http_ota, Use HTTP to download the firmware);
 
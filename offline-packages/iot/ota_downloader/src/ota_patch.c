@@ -0,0 +1,609 @@
+/*
+ * Copyright (c) 2006-2024 LGT Development Team
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-19     Evlers       first implementation
+ */
+
+#include <string.h>
+#include <rtthread.h>
+#include <fal.h>
+
+#include "ota_patch.h"
+
+#define DBG_ENABLE
+#define DBG_SECTION_NAME          "ota_patch"
+#ifdef OTA_DOWNLOADER_DEBUG
+#define DBG_LEVEL                 DBG_LOG
+#else
+#define DBG_LEVEL                 DBG_INFO
+#endif
+#define DBG_COLOR
+#include <rtdbg.h>
+
+#ifdef PKG_OTA_DOWNLOADER_USING_PATCH
+
+/* the cache of the old image read from the flash */
+#ifndef OTA_PATCH_OLD_CACHE_SIZE
+#define OTA_PATCH_OLD_CACHE_SIZE  256
+#endif
+
+/* the output is written to the flash by this size */
+#ifndef OTA_PATCH_OUT_BUFSZ
+#define OTA_PATCH_OUT_BUFSZ       512
+#endif
+
+#define OTA_PATCH_MIN_MATCH       4
+
+enum
+{
+    LZ_TOKEN,
+    LZ_LITERAL_LEN,
+    LZ_LITERAL,
+    LZ_OFFSET_LOW,
+    LZ_OFFSET_HIGH,
+    LZ_MATCH_LEN,
+    LZ_END,
+};
+
+enum
+{
+    DELTA_DIFF_LEN,
+    DELTA_EXTRA_LEN,
+    DELTA_ADJUST,
+    DELTA_DIFF,
+    DELTA_EXTRA,
+};
+
+struct ota_patch
+{
+    struct ota_patch_header hdr;
+    size_t hdr_len;                         /* received length of the header */
+    rt_uint32_t in_pos;                     /* received length of the patch data */
+    int error;
+
+    const struct fal_partition *old_part;
+    ota_patch_write_t write;
+    void *ctx;
+
+    /* LZ stage */
+    rt_uint8_t *window;
+    rt_uint32_t window_mask;
+    rt_uint32_t window_pos;                 /* total output length of this stage */
+    int lz_state;
+    rt_uint32_t literal_len;
+    rt_uint32_t match_len;
+    rt_uint32_t match_offset;
+
+    /* DELTA stage */
+    int delta_state;
+    rt_uint32_t varint;
+    int varint_shift;
+    rt_uint32_t diff_len;
+    rt_uint32_t extra_len;
+    rt_int32_t adjust;
+    rt_uint32_t old_pos;
+    rt_uint32_t cache_pos;
+    rt_uint32_t cache_len;
+    rt_uint8_t cache[OTA_PATCH_OLD_CACHE_SIZE];
+
+    /* output */
+    rt_uint32_t out_total;
+    rt_uint32_t out_crc;
+    size_t out_len;
+    rt_uint8_t out[OTA_PATCH_OUT_BUFSZ];
+};
+
+/* crc32 (IEEE 802.3) with the nibble table */
+static rt_uint32_t ota_patch_crc32(rt_uint32_t crc, const void *buf, size_t size)
+{
+    static const rt_uint32_t table[16] =
+    {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    const rt_uint8_t *p = buf;
+
+    crc = ~crc;
+    while (size--)
+    {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+
+    return ~crc;
+}
+
+rt_bool_t ota_patch_detect(const void *data, size_t size)
+{
+    return (size >= sizeof(struct ota_patch_header) && rt_memcmp(data, OTA_PATCH_MAGIC, 4) == 0);
+}
+
+struct ota_patch *ota_patch_create(const struct fal_partition *old_part, ota_patch_write_t write, void *ctx)
+{
+    struct ota_patch *patch;
+
+    RT_ASSERT(write);
+
+    patch = rt_calloc(1, sizeof(struct ota_patch));
+    if (patch == RT_NULL)
+    {
+        return RT_NULL;
+    }
+
+    patch->old_part = old_part;
+    patch->write = write;
+    patch->ctx = ctx;
+
+    return patch;
+}
+
+void ota_patch_delete(struct ota_patch *patch)
+{
+    if (patch)
+    {
+        if (patch->window)
+        {
+            rt_free(patch->window);
+        }
+        rt_free(patch);
+    }
+}
+
+const struct ota_patch_header *ota_patch_get_header(struct ota_patch *patch)
+{
+    return (patch->hdr_len == sizeof(patch->hdr)) ? &patch->hdr : RT_NULL;
+}
+
+/* check the header and the old image */
+static int ota_patch_check_header(struct ota_patch *patch)
+{
+    struct ota_patch_header *hdr = &patch->hdr;
+
+    if (rt_memcmp(hdr->magic, OTA_PATCH_MAGIC, 4) != 0 || hdr->version != OTA_PATCH_VERSION ||
+        ota_patch_crc32(0, hdr, sizeof(*hdr) - sizeof(hdr->hdr_crc)) != hdr->hdr_crc)
+    {
+        LOG_E("The patch header is invalid!");
+        return -RT_ERROR;
+    }
+
+    if (hdr->flags & OTA_PATCH_FLAG_LZ)
+    {
+        if (hdr->window_bits > OTA_PATCH_WINDOW_BITS_MAX)
+        {
+            LOG_E("The patch window (%d bits) is larger than %d bits!", hdr->window_bits, OTA_PATCH_WINDOW_BITS_MAX);
+            return -RT_ERROR;
+        }
+
+        patch->window = rt_malloc(1UL << hdr->window_bits);
+        if (patch->window == RT_NULL)
+        {
+            LOG_E("No memory for the patch window!");
+            return -RT_ENOMEM;
+        }
+        patch->window_mask = (1UL << hdr->window_bits) - 1;
+    }
+
+    if (hdr->flags & OTA_PATCH_FLAG_DELTA)
+    {
+        rt_uint32_t crc = 0, pos;
+
+        if (patch->old_part == RT_NULL || hdr->old_size > patch->old_part->len)
+        {
+            LOG_E("The old image of the patch is not found!");
+            return -RT_ERROR;
+        }
+
+        /* the patch can only be applied on the same old image */
+        for (pos = 0; pos < hdr->old_size; pos += patch->cache_len)
+        {
+            patch->cache_len = hdr->old_size - pos;
+            if (patch->cache_len > sizeof(patch->cache))
+            {
+                patch->cache_len = sizeof(patch->cache);
+            }
+
+            if (fal_partition_read(patch->old_part, pos, patch->cache, patch->cache_len) < 0)
+            {
+                LOG_E("Read the old image failed!");
+                return -RT_ERROR;
+            }
+            crc = ota_patch_crc32(crc, patch->cache, patch->cache_len);
+        }
+        patch->cache_pos = pos - patch->cache_len;
+
+        if (crc != hdr->old_crc)
+        {
+            LOG_E("The old image does not match the patch, crc32 is 0x%08X, expect 0x%08X.", crc, hdr->old_crc);
+            return -RT_ERROR;
+        }
+    }
+
+    LOG_D("patch: flags 0x%02X, window %d bits, old %d bytes, new %d bytes, patch %d bytes.",
+          hdr->flags, hdr->window_bits, hdr->old_size, hdr->new_size, hdr->patch_size);
+
+    return RT_EOK;
+}
+
+static int ota_patch_flush(struct ota_patch *patch)
+{
+    if (patch->out_len)
+    {
+        patch->out_crc = ota_patch_crc32(patch->out_crc, patch->out, patch->out_len);
+        if (patch->write(patch->ctx, patch->out, patch->out_len) < 0)
+        {
+            return -RT_ERROR;
+        }
+        patch->out_len = 0;
+    }
+
+    return RT_EOK;
+}
+
+static int ota_patch_output(struct ota_patch *patch, rt_uint8_t byte)
+{
+    if (patch->out_total >= patch->hdr.new_size)
+    {
+        LOG_E("The patch output is larger than the new image!");
+        return -RT_ERROR;
+    }
+
+    patch->out[patch->out_len++] = byte;
+    patch->out_total++;
+
+    if (patch->out_len == sizeof(patch->out))
+    {
+        return ota_patch_flush(patch);
+    }
+
+    return RT_EOK;
+}
+
+static int ota_patch_old_byte(struct ota_patch *patch, rt_uint8_t *byte)
+{
+    rt_uint32_t pos = patch->old_pos;
+
+    if (pos >= patch->hdr.old_size)
+    {
+        LOG_E("The patch reads out of the old image!");
+        return -RT_ERROR;
+    }
+
+    if (pos < patch->cache_pos || pos >= patch->cache_pos + patch->cache_len)
+    {
+        patch->cache_pos = pos;
+        patch->cache_len = patch->hdr.old_size - pos;
+        if (patch->cache_len > sizeof(patch->cache))
+        {
+            patch->cache_len = sizeof(patch->cache);
+        }
+
+        if (fal_partition_read(patch->old_part, pos, patch->cache, patch->cache_len) < 0)
+        {
+            patch->cache_len = 0;
+            LOG_E("Read the old image failed!");
+            return -RT_ERROR;
+        }
+    }
+
+    *byte = patch->cache[pos - patch->cache_pos];
+    patch->old_pos++;
+
+    return RT_EOK;
+}
+
+/* read the LEB128 varint, return 1 when it is complete */
+static int ota_patch_varint(struct ota_patch *patch, rt_uint8_t byte)
+{
+    if (patch->varint_shift > 28)
+    {
+        return -RT_ERROR;
+    }
+
+    patch->varint |= (rt_uint32_t)(byte & 0x7F) << patch->varint_shift;
+    patch->varint_shift += 7;
+
+    return (byte & 0x80) ? 0 : 1;
+}
+
+static void ota_patch_next_record(struct ota_patch *patch)
+{
+    patch->old_pos += patch->adjust;
+    patch->delta_state = DELTA_DIFF_LEN;
+}
+
+/* the data part of the record */
+static void ota_patch_record_data(struct ota_patch *patch)
+{
+    if (patch->diff_len)
+    {
+        patch->delta_state = DELTA_DIFF;
+    }
+    else if (patch->extra_len)
+    {
+        patch->delta_state = DELTA_EXTRA;
+    }
+    else
+    {
+        ota_patch_next_record(patch);
+    }
+}
+
+static int ota_patch_delta(struct ota_patch *patch, rt_uint8_t byte)
+{
+    rt_uint8_t old;
+    int rc;
+
+    switch (patch->delta_state)
+    {
+    case DELTA_DIFF_LEN:
+    case DELTA_EXTRA_LEN:
+    case DELTA_ADJUST:
+        rc = ota_patch_varint(patch, byte);
+        if (rc <= 0)
+        {
+            return rc;
+        }
+
+        if (patch->delta_state == DELTA_DIFF_LEN)
+        {
+            patch->diff_len = patch->varint;
+            patch->delta_state = DELTA_EXTRA_LEN;
+        }
+        else if (patch->delta_state == DELTA_EXTRA_LEN)
+        {
+            patch->extra_len = patch->varint;
+            patch->delta_state = DELTA_ADJUST;
+        }
+        else
+        {
+            /* zigzag */
+            patch->adjust = (rt_int32_t)(patch->varint >> 1) ^ -(rt_int32_t)(patch->varint & 1);
+            ota_patch_record_data(patch);
+        }
+        patch->varint = 0;
+        patch->varint_shift = 0;
+        break;
+
+    case DELTA_DIFF:
+        if (ota_patch_old_byte(patch, &old) != RT_EOK)
+        {
+            return -RT_ERROR;
+        }
+        if (ota_patch_output(patch, old + byte) != RT_EOK)
+        {
+            return -RT_ERROR;
+        }
+        if (--patch->diff_len == 0)
+        {
+            ota_patch_record_data(patch);
+        }
+        break;
+
+    case DELTA_EXTRA:
+        if (ota_patch_output(patch, byte) != RT_EOK)
+        {
+            return -RT_ERROR;
+        }
+        if (--patch->extra_len == 0)
+        {
+            ota_patch_next_record(patch);
+        }
+        break;
+    }
+
+    return RT_EOK;
+}
+
+/* the output of the LZ stage */
+static int ota_patch_stage2(struct ota_patch *patch, rt_uint8_t byte)
+{
+    if (patch->hdr.flags & OTA_PATCH_FLAG_DELTA)
+    {
+        return ota_patch_delta(patch, byte);
+    }
+
+    return ota_patch_output(patch, byte);
+}
+
+static int ota_patch_lz_emit(struct ota_patch *patch, rt_uint8_t byte)
+{
+    patch->window[patch->window_pos++ & patch->window_mask] = byte;
+
+    return ota_patch_stage2(patch, byte);
+}
+
+static int ota_patch_lz_match(struct ota_patch *patch)
+{
+    rt_uint32_t len = patch->match_len + OTA_PATCH_MIN_MATCH;
+
+    if (patch->match_offset == 0 || patch->match_offset > patch->window_mask + 1 ||
+        patch->match_offset > patch->window_pos)
+    {
+        LOG_E("The patch match offset (%d) is invalid!", patch->match_offset);
+        return -RT_ERROR;
+    }
+
+    while (len--)
+    {
+        rt_uint8_t byte = patch->window[(patch->window_pos - patch->match_offset) & patch->window_mask];
+
+        if (ota_patch_lz_emit(patch, byte) != RT_EOK)
+        {
+            return -RT_ERROR;
+        }
+    }
+
+    patch->lz_state = LZ_TOKEN;
+
+    return RT_EOK;
+}
+
+/* the input is the last byte of the patch data */
+static int ota_patch_lz(struct ota_patch *patch, rt_uint8_t byte, rt_bool_t last)
+{
+    switch (patch->lz_state)
+    {
+    case LZ_TOKEN:
+        patch->literal_len = byte >> 4;
+        patch->match_len = byte & 0x0F;
+        if (patch->literal_len == 15)
+        {
+            patch->lz_state = LZ_LITERAL_LEN;
+        }
+        else
+        {
+            patch->lz_state = patch->literal_len ? LZ_LITERAL : LZ_OFFSET_LOW;
+        }
+        break;
+
+    case LZ_LITERAL_LEN:
+        patch->literal_len += byte;
+        if (byte != 255)
+        {
+            patch->lz_state = LZ_LITERAL;
+        }
+        break;
+
+    case LZ_LITERAL:
+        if (ota_patch_lz_emit(patch, byte) != RT_EOK)
+        {
+            return -RT_ERROR;
+        }
+        if (--patch->literal_len == 0)
+        {
+            /* the last sequence has no match */
+            patch->lz_state = last ? LZ_END : LZ_OFFSET_LOW;
+        }
+        break;
+
+    case LZ_OFFSET_LOW:
+        patch->match_offset = byte;
+        patch->lz_state = LZ_OFFSET_HIGH;
+        break;
+
+    case LZ_OFFSET_HIGH:
+        patch->match_offset |= (rt_uint32_t) byte << 8;
+        if (patch->match_len == 15)
+        {
+            patch->lz_state = LZ_MATCH_LEN;
+        }
+        else
+        {
+            return ota_patch_lz_match(patch);
+        }
+        break;
+
+    case LZ_MATCH_LEN:
+        patch->match_len += byte;
+        if (byte != 255)
+        {
+            return ota_patch_lz_match(patch);
+        }
+        break;
+
+    default:
+        return -RT_ERROR;
+    }
+
+    return RT_EOK;
+}
+
+int ota_patch_feed(struct ota_patch *patch, const rt_uint8_t *data, size_t size)
+{
+    RT_ASSERT(patch);
+
+    if (patch->error != RT_EOK)
+    {
+        return patch->error;
+    }
+
+    /* the header */
+    if (patch->hdr_len < sizeof(patch->hdr))
+    {
+        size_t len = sizeof(patch->hdr) - patch->hdr_len;
+
+        if (len > size)
+        {
+            len = size;
+        }
+
+        rt_memcpy((rt_uint8_t *) &patch->hdr + patch->hdr_len, data, len);
+        patch->hdr_len += len;
+        data += len;
+        size -= len;
+
+        if (patch->hdr_len == sizeof(patch->hdr))
+        {
+            patch->error = ota_patch_check_header(patch);
+            if (patch->error != RT_EOK)
+            {
+                patch->hdr_len = 0;
+                return patch->error;
+            }
+        }
+    }
+
+    /* the padding after the package is ignored */
+    if (size > patch->hdr.patch_size - patch->in_pos)
+    {
+        size = patch->hdr.patch_size - patch->in_pos;
+    }
+
+    while (size--)
+    {
+        int rc;
+
+        patch->in_pos++;
+        if (patch->hdr.flags & OTA_PATCH_FLAG_LZ)
+        {
+            rc = ota_patch_lz(patch, *data++, patch->in_pos == patch->hdr.patch_size);
+        }
+        else
+        {
+            rc = ota_patch_stage2(patch, *data++);
+        }
+
+        if (rc != RT_EOK)
+        {
+            patch->error = -RT_ERROR;
+            return patch->error;
+        }
+    }
+
+    return RT_EOK;
+}
+
+int ota_patch_finish(struct ota_patch *patch)
+{
+    RT_ASSERT(patch);
+
+    if (patch->error != RT_EOK || ota_patch_get_header(patch) == RT_NULL)
+    {
+        return -RT_ERROR;
+    }
+
+    if (ota_patch_flush(patch) != RT_EOK)
+    {
+        return -RT_ERROR;
+    }
+
+    if (patch->in_pos != patch->hdr.patch_size || patch->out_total != patch->hdr.new_size ||
+        ((patch->hdr.flags & OTA_PATCH_FLAG_LZ) && patch->in_pos && patch->lz_state != LZ_END))
+    {
+        LOG_E("The patch is incomplete, decoded %d of %d bytes.", patch->out_total, patch->hdr.new_size);
+        return -RT_ERROR;
+    }
+
+    if (patch->out_crc != patch->hdr.new_crc)
+    {
+        LOG_E("The new image crc32 is 0x%08X, expect 0x%08X.", patch->out_crc, patch->hdr.new_crc);
+        return -RT_ERROR;
+    }
+
+    return RT_EOK;
+}
+
+#endif /* PKG_OTA_DOWNLOADER_USING_PATCH */
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2006-2024 LGT Development Team
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-19     Evlers       first implementation
+ */
+
+#ifndef _OTA_PATCH_H_
+#define _OTA_PATCH_H_
+
+#include <rtthread.h>
+#include <fal.h>
+
+/*
+ * Streaming decoder of the compressed and delta firmware package made by tools/ota_patch.py.
+ *
+ * Package: the header (struct ota_patch_header) and the patch data.
+ * The patch data is decoded by two stages, each of them is optional:
+ * 1) LZ (OTA_PATCH_FLAG_LZ): LZ4 style sequences with the match offset limited by the window,
+ *    token(literal length: bits 7-4, match length - 4: bits 3-0), extended literal length, literals,
+ *    match offset (16 bits), extended match length. The last sequence has no match.
+ * 2) DELTA (OTA_PATCH_FLAG_DELTA): bsdiff style records based on the old image,
+ *    diff length, extra length, old position adjustment (LEB128 varints, the adjustment is zigzag),
+ *    diff data (new - old), extra data.
+ * The RAM used is the window (1 << window_bits bytes) and the small caches of the old image and output.
+ */
+
+#define OTA_PATCH_MAGIC                 "OTAP"
+#define OTA_PATCH_VERSION               1
+
+#define OTA_PATCH_FLAG_LZ               0x01
+#define OTA_PATCH_FLAG_DELTA            0x02
+
+/* the maximum window supported by the decoder */
+#ifndef OTA_PATCH_WINDOW_BITS_MAX
+#define OTA_PATCH_WINDOW_BITS_MAX       14
+#endif
+
+/* the partition of the running firmware, it is the old image of the delta package */
+#ifdef PKG_OTA_DOWNLOADER_PATCH_OLD_PART
+#define OTA_PATCH_OLD_PART              PKG_OTA_DOWNLOADER_PATCH_OLD_PART
+#else
+#define OTA_PATCH_OLD_PART              "application"
+#endif
+
+/* little endian */
+struct ota_patch_header
+{
+    char magic[4];
+    rt_uint8_t version;
+    rt_uint8_t flags;
+    rt_uint8_t window_bits;
+    rt_uint8_t reserved;
+    rt_uint32_t old_size;                   /* size of the old image in the old partition */
+    rt_uint32_t old_crc;                    /* crc32 of the old image */
+    rt_uint32_t new_size;
+    rt_uint32_t new_crc;                    /* crc32 of the new image */
+    rt_uint32_t patch_size;                 /* size of the patch data after the header */
+    rt_uint32_t hdr_crc;                    /* crc32 of the header before this field */
+};
+
+/* the output is written in order, return < 0 to abort the decoding */
+typedef int (*ota_patch_write_t)(void *ctx, const rt_uint8_t *data, size_t size);
+
+struct ota_patch;
+
+/* check the magic of the package, the size must be at least the header size */
+rt_bool_t ota_patch_detect(const void *data, size_t size);
+
+/* the old partition is used by the delta package only */
+struct ota_patch *ota_patch_create(const struct fal_partition *old_part, ota_patch_write_t write, void *ctx);
+void ota_patch_delete(struct ota_patch *patch);
+
+/* decode the package data, the data after the package is ignored */
+int ota_patch_feed(struct ota_patch *patch, const rt_uint8_t *data, size_t size);
+
+/* flush the output and check the new image, call it after all of the package data is fed */
+int ota_patch_finish(struct ota_patch *patch);
+
+/* the header is valid after it is fed, return RT_NULL before that */
+const struct ota_patch_header *ota_patch_get_header(struct ota_patch *patch);
+
+#endif /* _OTA_PATCH_H_ */
@@ -7,6 +7,7 @@
  * Date           Author       Notes
  * 2018-01-30     armink       the first version
  * 2018-08-27     Murphy       update log
+ * 2024-10-19     Evlers       erase the flash lazily, add support for the compressed and delta firmware package
  */
 
 #include <rtthread.h>
@@ -17,6 +18,10 @@
 #include <fal.h>
 #include <ymodem.h>
 
+#ifdef PKG_OTA_DOWNLOADER_USING_PATCH
+#include "ota_patch.h"
+#endif
+
 #define DBG_ENABLE
 #define DBG_SECTION_NAME               "ymodem"
 #ifdef OTA_DOWNLOADER_DEBUG
@@ -36,8 +41,43 @@
 #define DEFAULT_DOWNLOAD_PART "download"
 
 static size_t update_file_total_size, update_file_cur_size;
+static size_t update_image_size;            /* written length of the image */
+static size_t update_erased_size, update_blk_size;
 static const struct fal_partition * dl_part = RT_NULL;
 static uint8_t enable_output_log = 0;
+#ifdef PKG_OTA_DOWNLOADER_USING_PATCH
+static struct ota_patch *update_patch = RT_NULL;
+#endif
+
+/* write the image to DL partition, the flash is erased just ahead of the data */
+static int ymodem_ota_write(void *ctx, const rt_uint8_t *buf, size_t len)
+{
+    if (update_image_size + len > dl_part->len)
+    {
+        if (enable_output_log) {LOG_E("Firmware is too large! '%s' partition size (%d)", dl_part->name, dl_part->len);}
+        return -RT_ERROR;
+    }
+
+    while (update_erased_size < update_image_size + len)
+    {
+        if (fal_partition_erase(dl_part, update_erased_size, update_blk_size) < 0)
+        {
+            if (enable_output_log) {LOG_E("Firmware download failed! Partition (%s) erase error!", dl_part->name);}
+            return -RT_ERROR;
+        }
+        update_erased_size += update_blk_size;
+    }
+
+    if (fal_partition_write(dl_part, update_image_size, buf, len) < 0)
+    {
+        if (enable_output_log) {LOG_E("Firmware download failed! Partition (%s) write data error!", dl_part->name);}
+        return -RT_ERROR;
+    }
+
+    update_image_size += len;
+
+    return RT_EOK;
+}
 
 static enum rym_code ymodem_on_begin(struct rym_ctx *ctx, rt_uint8_t *buf, rt_size_t len)
 {
@@ -50,21 +90,21 @@ static enum rym_code ymodem_on_begin(struct rym_ctx *ctx, rt_uint8_t *buf, rt_si
     if (enable_output_log) {rt_kprintf("Ymodem file_size:%d\n", update_file_total_size);}
 
     update_file_cur_size = 0;
+    update_image_size = 0;
+    update_erased_size = 0;
 
-    /* Get download partition information and erase download partition data */
-    if (update_file_total_size > dl_part->len)
+#ifdef PKG_OTA_DOWNLOADER_USING_PATCH
+    if (update_patch)
     {
-        if (enable_output_log) {LOG_E("Firmware is too large! File size (%d), '%s' partition size (%d)", update_file_total_size, dl_part->name, dl_part->len);}
-        return RYM_CODE_CAN;
+        ota_patch_delete(update_patch);
+        update_patch = RT_NULL;
     }
+#endif
 
-    if (enable_output_log) {LOG_I("Start erase. Size (%d)", update_file_total_size);}
-
-    /* erase DL section */
-    if (fal_partition_erase(dl_part, 0, update_file_total_size) < 0)
+    /* the data is written to DL partition while it is received, so the partition is not erased at once */
     {
-        if (enable_output_log) {LOG_E("Firmware download failed! Partition (%s) erase error!", dl_part->name);}
-        return RYM_CODE_CAN;
+        const struct fal_flash_dev *flash = fal_flash_device_find(dl_part->flash_name);
+        update_blk_size = (flash && flash->blk_size) ? flash->blk_size : 4096;
     }
 
     return RYM_CODE_ACK;
@@ -72,13 +112,36 @@ static enum rym_code ymodem_on_begin(struct rym_ctx *ctx, rt_uint8_t *buf, rt_si
 
 static enum rym_code ymodem_on_data(struct rym_ctx *ctx, rt_uint8_t *buf, rt_size_t len)
 {
+    /* the padding of the last packet is not written */
     uint32_t write_length = MIN(update_file_total_size - update_file_cur_size, len);
 
-    /* write data of application to DL partition  */
-    if (fal_partition_write(dl_part, update_file_cur_size, buf, write_length) < 0)
+#ifdef PKG_OTA_DOWNLOADER_USING_PATCH
+    /* decode the compressed or delta package to DL partition */
+    if (update_file_cur_size == 0 && ota_patch_detect(buf, write_length))
     {
-        if (enable_output_log) {LOG_E("Firmware download failed! Partition (%s) write data error!", dl_part->name);}
-        return RYM_CODE_CAN;
+        update_patch = ota_patch_create(fal_partition_find(OTA_PATCH_OLD_PART), ymodem_ota_write, RT_NULL);
+        if (update_patch == RT_NULL)
+        {
+            if (enable_output_log) {LOG_E("Firmware download failed! No memory for the patch decoder!");}
+            return RYM_CODE_CAN;
+        }
+    }
+
+    if (update_patch)
+    {
+        if (ota_patch_feed(update_patch, buf, write_length) != RT_EOK)
+        {
+            return RYM_CODE_CAN;
+        }
+    }
+    else
+#endif
+    {
+        /* write data of application to DL partition  */
+        if (ymodem_ota_write(RT_NULL, buf, write_length) != RT_EOK)
+        {
+            return RYM_CODE_CAN;
+        }
     }
 
     update_file_cur_size += write_length;
@@ -149,11 +212,17 @@ void ymodem_ota(uint8_t argc, char **argv)
     if (!rym_recv_on_device(&rctx, dev, RT_DEVICE_OFLAG_RDWR | RT_DEVICE_FLAG_INT_RX,
                             ymodem_on_begin, ymodem_on_data, NULL, RT_TICK_PER_SECOND))
     {
-        rt_kprintf("Download firmware to flash success.\n");
-
+#ifdef PKG_OTA_DOWNLOADER_USING_PATCH
+        if (update_patch && ota_patch_finish(update_patch) != RT_EOK)
+        {
+            rt_kprintf("Decode the firmware package failed.\n");
+        }
+        else
+#endif
         if (update_file_cur_size == update_file_total_size)
         {
-            ymodem_ota_success(dl_part, update_file_total_size);
+            rt_kprintf("Download firmware to flash success.\n");
+            ymodem_ota_success(dl_part, update_image_size);
         }
         else
         {
@@ -167,6 +236,14 @@ void ymodem_ota(uint8_t argc, char **argv)
         rt_kprintf("Update firmware fail.\n");
     }
 
+#ifdef PKG_OTA_DOWNLOADER_USING_PATCH
+    if (update_patch)
+    {
+        ota_patch_delete(update_patch);
+        update_patch = RT_NULL;
+    }
+#endif
+
     return;
 }
 /**
@@ -0,0 +1,120 @@
+# -*- coding: UTF-8 -*-
+
+# Copyright (c) 2006-2024 LGT Development Team
+#
+# Change Logs:
+# Date           Author       Notes
+# 2024-10-19     Evlers       first implementation
+
+# A local HTTP/1.1 server for the time-to-flash benchmark of http_ota.
+# It supports the keep-alive connection, HEAD and the "Range" request used by the shard download,
+# and prints the sha256 of each file so it can be passed to the http_ota command.
+#
+# Usage:
+#   python http_ota_server.py rtthread.rbl [--port 8000] [--rate 0]
+#   msh />http_ota http://<pc ip>:8000/rtthread.rbl <sha256>
+
+import argparse
+import hashlib
+import http.server
+import os
+import re
+import socketserver
+import time
+
+
+class OtaHandler(http.server.BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+    files = {}
+    rate = 0
+
+    def _file(self):
+        name = os.path.basename(self.path.split('?')[0])
+        return self.files.get(name)
+
+    def _range(self, size):
+        m = re.match(r'bytes=(\d*)-(\d*)', self.headers.get('Range', ''))
+        if not m:
+            return 0, size - 1, False
+        start = int(m.group(1)) if m.group(1) else size - int(m.group(2))
+        end = int(m.group(2)) if m.group(1) and m.group(2) else size - 1
+        return start, min(end, size - 1), True
+
+    def _send_header(self, path):
+        size = os.path.getsize(path)
+        start, end, partial = self._range(size)
+        if start >= size or start > end:
+            self.send_response(416)
+            self.send_header('Content-Range', 'bytes */%d' % size)
+            self.send_header('Content-Length', '0')
+            self.end_headers()
+            return None
+
+        self.send_response(206 if partial else 200)
+        if partial:
+            self.send_header('Content-Range', 'bytes %d-%d/%d' % (start, end, size))
+        self.send_header('Content-Length', str(end - start + 1))
+        self.send_header('Content-Type', 'application/octet-stream')
+        self.send_header('ETag', '"%x-%x"' % (size, int(os.path.getmtime(path))))
+        self.end_headers()
+        return start, end
+
+    def do_HEAD(self):
+        path = self._file()
+        if path is None:
+            self.send_error(404)
+            return
+        self._send_header(path)
+
+    def do_GET(self):
+        path = self._file()
+        if path is None:
+            self.send_error(404)
+            return
+        span = self._send_header(path)
+        if span is None:
+            return
+
+        start, end = span
+        begin = time.time()
+        with open(path, 'rb') as f:
+            f.seek(start)
+            left = end - start + 1
+            while left > 0:
+                data = f.read(min(left, 16384))
+                self.wfile.write(data)
+                left -= len(data)
+                # limit the rate to simulate a slow network
+                if self.rate:
+                    sent = end - start + 1 - left
+                    delay = sent / self.rate - (time.time() - begin)
+                    if delay > 0:
+                        time.sleep(delay)
+
+        elapsed = time.time() - begin
+        self.log_message('sent %d bytes in %.3f s (%.1f KB/s)', end - start + 1, elapsed,
+                         (end - start + 1) / 1024 / elapsed if elapsed else 0)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='local HTTP server for the http_ota benchmark')
+    parser.add_argument('files', nargs='+', help='the firmware files to serve')
+    parser.add_argument('--port', type=int, default=8000, help='the listen port (default: 8000)')
+    parser.add_argument('--rate', type=int, default=0, help='limit the send rate in bytes per second (default: no limit)')
+    args = parser.parse_args()
+
+    for path in args.files:
+        with open(path, 'rb') as f:
+            digest = hashlib.sha256(f.read()).hexdigest()
+        OtaHandler.files[os.path.basename(path)] = path
+        print('%s: %d bytes, sha256 %s' % (os.path.basename(path), os.path.getsize(path), digest))
+    OtaHandler.rate = args.rate
+
+    socketserver.ThreadingTCPServer.allow_reuse_address = True
+    with socketserver.ThreadingTCPServer(('', args.port), OtaHandler) as server:
+        print('serving on port %d' % args.port)
+        server.serve_forever()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,386 @@
+# -*- coding: UTF-8 -*-
+
+# Copyright (c) 2006-2024 LGT Development Team
+#
+# Change Logs:
+# Date           Author       Notes
+# 2024-10-19     Evlers       first implementation
+
+# Make the compressed or delta firmware package for the ota_downloader (see src/ota_patch.h).
+#
+# Usage:
+#   python ota_patch.py compress rtthread.rbl rtthread.otap [--window 12]
+#   python ota_patch.py diff rtthread_old.bin rtthread.rbl rtthread.otap [--window 12] [--no-lz]
+#   python ota_patch.py apply [rtthread_old.bin] rtthread.otap rtthread_new.rbl
+#   python ota_patch.py test rtthread_old.bin rtthread.rbl [--window 12]
+#
+# The old image is the firmware running in the "app" partition (the bin file), the new image is the
+# package downloaded to the "download" partition, the delta works best when the rbl is not compressed or encrypted.
+
+import argparse
+import hashlib
+import struct
+import sys
+import zlib
+
+MAGIC = b'OTAP'
+VERSION = 1
+FLAG_LZ = 0x01
+FLAG_DELTA = 0x02
+WINDOW_BITS_MAX = 14
+HEADER = struct.Struct('<4sBBBBIIIII')
+MIN_MATCH = 4
+
+
+def crc32(data):
+    return zlib.crc32(data) & 0xFFFFFFFF
+
+
+# ---------------------------------------------------------------------------- varint
+
+def uvarint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def svarint(value):
+    # zigzag
+    return uvarint(value << 1 if value >= 0 else ((-value) << 1) - 1)
+
+
+def read_uvarint(data, pos):
+    value = shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+# ---------------------------------------------------------------------------- delta
+
+def _extend_forward(old, new, o, n, limit):
+    # the approximate match of bsdiff: maximize 2 * equal - length
+    best_len = score = best_score = 0
+    k = 0
+    while k < limit:
+        score += 1 if old[o + k] == new[n + k] else -1
+        k += 1
+        if score > best_score:
+            best_score, best_len = score, k
+        elif k - best_len > 64:
+            break
+    return best_len
+
+
+def _extend_backward(old, new, o, n, limit):
+    best_len = score = best_score = 0
+    k = 1
+    while k <= limit:
+        score += 1 if old[o - k] == new[n - k] else -1
+        if score > best_score:
+            best_score, best_len = score, k
+        elif k - best_len > 64:
+            break
+        k += 1
+    return best_len
+
+
+def diff(old, new):
+    # the segments (new position, old position, length) of the approximate matches
+    seed = 8
+    index = {}
+    for o in range(0, len(old) - seed + 1, 4):
+        index.setdefault(old[o:o + seed], []).append(o)
+
+    segments = []
+    last_delta = 0
+    n = 0
+    while n + seed <= len(new):
+        candidates = [n + last_delta] if 0 <= n + last_delta and n + last_delta + seed <= len(old) else []
+        candidates += index.get(new[n:n + seed], [])[-8:]
+
+        best = None
+        for o in candidates:
+            if old[o:o + seed] != new[n:n + seed]:
+                continue
+            length = _extend_forward(old, new, o, n, min(len(old) - o, len(new) - n))
+            if best is None or length > best[1]:
+                best = (o, length)
+
+        if best is None:
+            n += 1
+            continue
+
+        o, length = best
+        prev_end = segments[-1][0] + segments[-1][2] if segments else 0
+        back = _extend_backward(old, new, o, n, min(o, n - prev_end))
+        segments.append((n - back, o - back, length + back))
+        last_delta = o - n
+        n += length
+
+    # the records: diff, extra (until the next segment), old position adjustment
+    out = bytearray()
+    prev_new = prev_old = 0
+    if not segments or segments[0][:2] != (0, 0):
+        first = segments[0] if segments else (len(new), 0, 0)
+        out += uvarint(0) + uvarint(first[0]) + svarint(first[1])
+        out += new[:first[0]]
+        prev_new, prev_old = first[0], first[1]
+
+    for i, (sn, so, length) in enumerate(segments):
+        assert sn == prev_new and so == prev_old
+        next_new, next_old = segments[i + 1][:2] if i + 1 < len(segments) else (len(new), so + length)
+        out += uvarint(length) + uvarint(next_new - sn - length) + svarint(next_old - so - length)
+        out += bytes((new[sn + k] - old[so + k]) & 0xFF for k in range(length))
+        out += new[sn + length:next_new]
+        prev_new, prev_old = next_new, next_old
+
+    return bytes(out)
+
+
+def undiff(old, patch):
+    out = bytearray()
+    pos = old_pos = 0
+    while pos < len(patch):
+        diff_len, pos = read_uvarint(patch, pos)
+        extra_len, pos = read_uvarint(patch, pos)
+        adjust, pos = read_uvarint(patch, pos)
+        adjust = (adjust >> 1) ^ -(adjust & 1)
+        out += bytes((old[old_pos + k] + patch[pos + k]) & 0xFF for k in range(diff_len))
+        pos += diff_len
+        old_pos += diff_len
+        out += patch[pos:pos + extra_len]
+        pos += extra_len
+        old_pos += adjust
+    return bytes(out)
+
+
+# ---------------------------------------------------------------------------- LZ
+
+def _length(value):
+    out = bytearray()
+    while value >= 255:
+        out.append(255)
+        value -= 255
+    out.append(value)
+    return out
+
+
+def compress(data, window_bits):
+    window = min(1 << window_bits, 65535)
+    head = {}
+    chain = {}
+    out = bytearray()
+    anchor = pos = 0
+    # keep one literal at least for the last sequence
+    end = len(data) - 1
+
+    def insert(p):
+        key = data[p:p + MIN_MATCH]
+        chain[p] = head.get(key)
+        head[key] = p
+
+    while pos + MIN_MATCH <= end:
+        best_len = best_off = 0
+        cand = head.get(data[pos:pos + MIN_MATCH])
+        depth = 0
+        while cand is not None and pos - cand <= window and depth < 32:
+            length = 0
+            limit = end - pos
+            while length < limit and data[cand + length] == data[pos + length]:
+                length += 1
+            if length > best_len:
+                best_len, best_off = length, pos - cand
+            cand = chain.get(cand)
+            depth += 1
+
+        if best_len < MIN_MATCH:
+            insert(pos)
+            pos += 1
+            continue
+
+        literal = pos - anchor
+        match = best_len - MIN_MATCH
+        out.append((min(literal, 15) << 4) | min(match, 15))
+        if literal >= 15:
+            out += _length(literal - 15)
+        out += data[anchor:pos]
+        out += struct.pack('<H', best_off)
+        if match >= 15:
+            out += _length(match - 15)
+
+        for p in range(pos, pos + best_len):
+            if p + MIN_MATCH <= len(data):
+                insert(p)
+        pos += best_len
+        anchor = pos
+
+    literal = len(data) - anchor
+    if literal:
+        out.append(min(literal, 15) << 4)
+        if literal >= 15:
+            out += _length(literal - 15)
+        out += data[anchor:]
+    return bytes(out)
+
+
+def decompress(data, window_bits):
+    out = bytearray()
+    pos = 0
+    while pos < len(data):
+        token = data[pos]
+        pos += 1
+        literal = token >> 4
+        if literal == 15:
+            while True:
+                literal += data[pos]
+                pos += 1
+                if data[pos - 1] != 255:
+                    break
+        out += data[pos:pos + literal]
+        pos += literal
+        if pos >= len(data):
+            break
+        offset = struct.unpack_from('<H', data, pos)[0]
+        pos += 2
+        if offset == 0 or offset > (1 << window_bits) or offset > len(out):
+            raise ValueError('invalid match offset %d' % offset)
+        match = token & 0x0F
+        if match == 15:
+            while True:
+                match += data[pos]
+                pos += 1
+                if data[pos - 1] != 255:
+                    break
+        for _ in range(match + MIN_MATCH):
+            out.append(out[-offset])
+    return bytes(out)
+
+
+# ---------------------------------------------------------------------------- package
+
+def make(new, old=None, window_bits=12, lz=True):
+    flags = 0
+    data = new
+    if old is not None:
+        flags |= FLAG_DELTA
+        data = diff(old, new)
+    if lz:
+        flags |= FLAG_LZ
+        data = compress(data, window_bits)
+
+    old = old or b''
+    header = HEADER.pack(MAGIC, VERSION, flags, window_bits if lz else 0, 0,
+                         len(old), crc32(old), len(new), crc32(new), len(data))
+    return header + struct.pack('<I', crc32(header)) + data
+
+
+def apply(package, old=None):
+    size = HEADER.size + 4
+    magic, version, flags, window_bits, _, old_size, old_crc, new_size, new_crc, patch_size = \
+        HEADER.unpack_from(package)
+    if magic != MAGIC or version != VERSION or crc32(package[:HEADER.size]) != \
+            struct.unpack_from('<I', package, HEADER.size)[0]:
+        raise ValueError('invalid package header')
+    if window_bits > WINDOW_BITS_MAX:
+        raise ValueError('the window is too large')
+
+    data = package[size:size + patch_size]
+    if flags & FLAG_LZ:
+        data = decompress(data, window_bits)
+    if flags & FLAG_DELTA:
+        if old is None or len(old) < old_size or crc32(old[:old_size]) != old_crc:
+            raise ValueError('the old image does not match the package')
+        data = undiff(old[:old_size], data)
+    if len(data) != new_size or crc32(data) != new_crc:
+        raise ValueError('the new image crc32 mismatch')
+    return data
+
+
+def read(path):
+    with open(path, 'rb') as f:
+        return f.read()
+
+
+def write(path, data):
+    with open(path, 'wb') as f:
+        f.write(data)
+
+
+def test(old, new, window_bits):
+    result = 0
+    for name, package in (('compressed', make(new, None, window_bits)),
+                          ('delta', make(new, old, window_bits, False)),
+                          ('delta + compressed', make(new, old, window_bits))):
+        try:
+            ok = apply(package, old) == new
+        except ValueError:
+            ok = False
+        result |= not ok
+        print('%-20s %8d bytes %6.1f%%  round-trip %s' %
+              (name, len(package), 100.0 * len(package) / max(len(new), 1), 'OK' if ok else 'FAILED'))
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description='make the compressed or delta firmware package for ota_downloader')
+    sub = parser.add_subparsers(dest='command', required=True)
+
+    p = sub.add_parser('compress', help='make the compressed package')
+    p.add_argument('new')
+    p.add_argument('output')
+
+    p = sub.add_parser('diff', help='make the delta package based on the old image')
+    p.add_argument('old')
+    p.add_argument('new')
+    p.add_argument('output')
+    p.add_argument('--no-lz', action='store_true', help='do not compress the delta')
+
+    p = sub.add_parser('apply', help='decode the package')
+    p.add_argument('files', nargs='+', metavar='[old] package output')
+
+    p = sub.add_parser('test', help='check the round-trip and print the transfer sizes')
+    p.add_argument('old')
+    p.add_argument('new')
+
+    for p in sub.choices.values():
+        p.add_argument('--window', type=int, default=12,
+                       help='window bits of the LZ stage, the RAM used by the device (default: 12, max: %d)' % WINDOW_BITS_MAX)
+
+    args = parser.parse_args()
+    if not 8 <= args.window <= WINDOW_BITS_MAX:
+        parser.error('the window bits must be 8 ~ %d' % WINDOW_BITS_MAX)
+
+    if args.command in ('compress', 'diff'):
+        new = read(args.new)
+        if args.command == 'compress':
+            package = make(new, None, args.window)
+        else:
+            package = make(new, read(args.old), args.window, not args.no_lz)
+        write(args.output, package)
+        # the sha256 is checked on the decoded image by http_ota
+        print('%s: %d bytes -> %d bytes (%.1f%%), image sha256 %s' %
+              (args.output, len(new), len(package), 100.0 * len(package) / max(len(new), 1),
+               hashlib.sha256(new).hexdigest()))
+    elif args.command == 'apply':
+        if len(args.files) not in (2, 3):
+            parser.error('apply needs [old] package output')
+        old = read(args.files[0]) if len(args.files) == 3 else None
+        write(args.files[-1], apply(read(args.files[-2]), old))
+    else:
+        return test(read(args.old), read(args.new), args.window)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
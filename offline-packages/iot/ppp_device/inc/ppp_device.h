@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author          Notes
  * 2019-08-15     xiangxistu      the first version
+ * 2024-10-19     Evlers          read the uart data to the receive buffer directly
  */
 
 #ifndef __PPP_DEVICE_H__
@@ -45,6 +46,10 @@
 #define PPP_FRAME_MAX       1550
 #define PPP_DROP_BUF        PPP_FRAME_MAX
 
+#ifndef PPP_RECV_BUF_SIZE
+#define PPP_RECV_BUF_SIZE   PPP_FRAME_MAX
+#endif
+
 
 #define PPP_DEVICE_SW_VERSION           "1.1.0"
 #define PPP_DEVICE_SW_VERSION_NUM       0x10100
@@ -82,8 +87,9 @@ struct ppp_device
     rt_uint8_t dropbuf[PPP_DROP_BUF];           /* drop buffer */
 #endif
 
-    rt_size_t  rxpos;                           /* valid size of receive frame buffer */
-    rt_uint8_t rxbuf[PPP_FRAME_MAX];            /* receive frame buffer */
+    rt_size_t  framelen;                        /* received size of the current frame */
+    rt_size_t  rxpos;                           /* size of the frame kept in receive buffer */
+    rt_uint8_t rxbuf[PPP_RECV_BUF_SIZE];        /* receive buffer, the uart data is read to it directly */
     rt_uint8_t state;                           /* internal state */
 
     struct rt_event event;                      /* interthread communication */
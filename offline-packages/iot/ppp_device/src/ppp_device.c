@@ -7,10 +7,12 @@
  * Date           Author          Notes
  * 2019-08-15     xiangxistu      the first version
  * 2019-10-01     xiaofan         rewrite ppp_recv thread
+ * 2024-10-19     Evlers          scan the frames by block, input the spans of frames to lwIP directly
  */
 
 #include <ppp_device.h>
 #include <ppp_netif.h>
+#include <string.h>
 
 #define DBG_TAG    "ppp.dev"
 
@@ -40,7 +42,7 @@ enum
 #define DATA_EFFECTIVE_FLAG      0x00
 #define RECON_ERR_COUNTS         0x02
 #define PPP_RECONNECT_TIME       2500
-#define PPP_RECV_READ_MAX        32
+#define PPP_INPUT_RETRY          10
 
 
 #define PPP_EVENT_RX_NOTIFY 1   // serial incoming a byte
@@ -206,13 +208,13 @@ static void ppp_status_changed(ppp_pcb *pcb, int err_code, void *ctx)
 }
 
 /**
- * prepare for starting recieve ppp frame, clear recieve buff and set ppp device state
+ * prepare for starting recieve ppp frame, set ppp device state
  *
  * @param device  the point of device driver structure, ppp_device structure
  */
 static inline void ppp_start_receive_frame(struct ppp_device *device)
 {
-    device->rxpos = 0;
+    device->framelen = 0;
     device->state = PPP_STATE_WAIT_HEAD;
 }
 
@@ -233,56 +235,35 @@ static inline void ppp_show_dropbuf(struct ppp_device *device)
 }
 
 /**
- * ppp_show_rxbuf_as_drop, printf the data whom ppp devcie drop out, and increase drop data conut
+ * ppp_drop, save the data whom ppp devcie drop out, printf them when the drop buffer is full
  *
  * @param device  the point of device driver structure, ppp_device structure
+ * @param data    the data dropped
+ * @param len     the length of data dropped
  */
-static inline void ppp_show_rxbuf_as_drop(struct ppp_device *device)
+static void ppp_drop(struct ppp_device *device, const rt_uint8_t *data, rt_size_t len)
 {
-    if (!device->rxpos)
-        return;
-    LOG_D("DROP: ");
-    ppp_debug_hexdump(device->rxbuf, device->rxpos);
-    device->dropcnt += device->rxpos;
-    device->rxpos = 0;
-}
-
-/**
- * ppp_rxbuf_drop, printf the data whom ppp devcie drop out
- *
- * @param device  the point of device driver structure, ppp_device structure
- */
-static inline void ppp_rxbuf_drop(struct ppp_device *device)
-{
-    /* if we have no enough drop-buffer, we should display and clear drop-buffer */
-    if (PPP_DROP_BUF - device->droppos < device->rxpos)
-    {
-        ppp_show_dropbuf(device);
-        /* if our drop-buffer size less than or equal current valid size of rx-buffer,
-            we should display and clear rx-buffer */
-        if (PPP_DROP_BUF <= device->rxpos)
-        {
-            ppp_show_rxbuf_as_drop(device);
-        }
-    }
+    rt_size_t size;
 
-    if (device->rxpos)
+    while (len)
     {
-        rt_memcpy(&device->dropbuf[device->droppos], device->rxbuf, device->rxpos);
-        device->droppos += device->rxpos;
-        device->rxpos = 0;
+        size = PPP_DROP_BUF - device->droppos;
+        if (size > len)
+            size = len;
+        rt_memcpy(&device->dropbuf[device->droppos], data, size);
+        device->droppos += size;
+        data += size;
+        len -= size;
 
         if (device->droppos == PPP_DROP_BUF)
         {
             ppp_show_dropbuf(device);
         }
     }
-
-    ppp_start_receive_frame(device);
 }
 #else
 static inline void ppp_show_dropbuf(struct ppp_device *device) {}
-#define ppp_rxbuf_drop(device) ppp_start_receive_frame(device)
+#define ppp_drop(device, data, len)
 #endif /* PPP_DEVICE_DEBUG_DROP */
 
 /**
@@ -292,6 +273,7 @@ static inline void ppp_show_dropbuf(struct ppp_device *device) {}
  */
 static inline void ppp_processdata_enter(struct ppp_device *device)
 {
+    device->rxpos = 0;
     ppp_start_receive_frame(device);
 #ifdef PPP_DEVICE_DEBUG_DROP
     device->droppos = 0;
@@ -305,82 +287,132 @@ static inline void ppp_processdata_enter(struct ppp_device *device)
  */
 static inline void ppp_processdata_leave(struct ppp_device *device)
 {
-    ppp_rxbuf_drop(device);
+    device->rxpos = 0;
+    ppp_start_receive_frame(device);
     ppp_show_dropbuf(device);
 }
 
 /**
- * ppp_savebyte, save this data into ppp device buff
+ * ppp_input, input the data of frames to lwIP, the data is copied to pbuf and posted to the tcpip thread.
+ * Retry when the pbuf pool or the tcpip message queue is full, the frame is broken if the data is lost.
  *
  * @param   device  the point of device driver structure, ppp_device structure
- * @param   dat     the character of recieve data
+ * @param   data    the data of frames, it begins with 0x7e or follows the data input before
+ * @param   len     the length of data
  */
-static inline void ppp_savebyte(struct ppp_device *device, rt_uint8_t dat)
+static void ppp_input(struct ppp_device *device, const rt_uint8_t *data, rt_size_t len)
 {
-    RT_ASSERT(device->rxpos < sizeof(device->rxbuf));
-    device->rxbuf[device->rxpos++] = dat;
+    int retry;
+
+    if (len == 0)
+        return;
+
+#ifdef PPP_DEVICE_DEBUG_RX
+    LOG_D("RX:");
+    ppp_debug_hexdump(data, len);
+#endif
+    for (retry = 0; pppos_input_tcpip(device->pcb, (u8_t *)data, len) != ERR_OK; retry++)
+    {
+        if (retry == PPP_INPUT_RETRY)
+        {
+            LOG_W("lwIP input queue is full, drop %u bytes.", (unsigned int)len);
+            break;
+        }
+        rt_thread_mdelay(1);
+    }
 }
 
 /**
- * ppp_recv_processdata, save data from uart, recieve complete ppp frame data
+ * ppp_recv_processdata, scan the frames (0x7e ... 0x7e) in the data read from uart, input them to lwIP.
+ * The frames next to each other are input by one span, the data between frames is dropped.
+ * The frame not ended is kept in the buffer and input with the following data, unless the buffer is full.
+ * lwIP unescapes the frame and checks the FCS.
  *
  * @param   device  the point of device driver structure, ppp_device structure
- * @param   buf     the address of recieve data from uart
- * @param   len     the length of recieve data
+ * @param   len     the length of recieve data, it is read to the buffer after the data kept
  */
-static void ppp_recv_processdata(struct ppp_device *device, const rt_uint8_t *buf, rt_size_t len)
+static void ppp_recv_processdata(struct ppp_device *device, rt_size_t len)
 {
-    rt_uint8_t dat;
-
-    while (len--)
+    static const rt_uint8_t flag_end = PPP_DATA_BEGIN_END;
+    const rt_uint8_t *span = device->rxbuf;     /* the begin of the frame data not input */
+    const rt_uint8_t *head = device->rxbuf;     /* the begin of the frame not ended */
+    const rt_uint8_t *buf = device->rxbuf + device->rxpos;
+    const rt_uint8_t *end = buf + len;
+    const rt_uint8_t *flag;
+    rt_size_t size;
+
+    while (buf < end)
     {
-        dat = *buf++;
+        flag = memchr(buf, PPP_DATA_BEGIN_END, end - buf);
+        size = (flag ? flag : end) - buf;
 
-process_dat:
-        switch (device->state)
+        if (device->state == PPP_STATE_WAIT_HEAD)
         {
-        case PPP_STATE_WAIT_HEAD:
-            ppp_savebyte(device, dat);
-            if (dat == PPP_DATA_BEGIN_END)              /* if recieve 0x7e */
+            if (size)
             {
-                ppp_show_dropbuf(device);
-                device->state = PPP_STATE_RECV_DATA;    /* begin recieve the second data */
+                /* the frames before are input, the data out of the frame is dropped */
+                ppp_input(device, span, buf - span);
+                ppp_drop(device, buf, size);
+                buf += size;
+                span = buf;
             }
-            else
+            if (flag)
             {
-                ppp_rxbuf_drop(device);
+                /* if recieve 0x7e, begin recieve the frame */
+                ppp_show_dropbuf(device);
+                device->state = PPP_STATE_RECV_DATA;
+                device->framelen = 1;
+                head = buf++;
             }
-            break;
-        case PPP_STATE_RECV_DATA:
-            if (dat == PPP_DATA_BEGIN_END && device->rxpos == 1)    /* if we recieve 0x7e when this data is the second data */
+            continue;
+        }
+
+        device->framelen += size;
+        if (device->framelen >= PPP_FRAME_MAX)
+        {
+            LOG_W("receive ppp frame is lagger than %u", (unsigned int)PPP_FRAME_MAX);
+            /* the frame is ended by the flag and dropped by the FCS check of lwIP */
+            ppp_input(device, span, buf - span);
+            ppp_input(device, &flag_end, 1);
+            ppp_drop(device, buf, size);
+            buf += size;
+            span = buf;
+            ppp_start_receive_frame(device);
+            continue;
+        }
+
+        buf += size;
+        if (flag)
+        {
+            buf++;
+            if (device->framelen > 1)
             {
-                LOG_D("found continuous 0x7e");
-                // start receive a new frame
-                ppp_rxbuf_drop(device);                 /* throw this data, because 0x7e is the begin of ppp frame, the second data shouldn't been 0x7e */
-                goto process_dat;
+                /* the end of ppp frame */
+                ppp_start_receive_frame(device);
             }
-            ppp_savebyte(device, dat);
-            if (dat == PPP_DATA_BEGIN_END)      /* the end of ppp frame */
+            else
             {
-#ifdef PPP_DEVICE_DEBUG_RX
-                LOG_D("RX:");
-                ppp_debug_hexdump(device->rxbuf, device->rxpos);
-#endif
-                rt_enter_critical();
-                pppos_input_tcpip(device->pcb, (u8_t *)device->rxbuf, device->rxpos);
-                rt_exit_critical();
-                ppp_start_receive_frame(device);
+                /* the continuous 0x7e is ignored by lwIP, the frame begins with the last one */
+                LOG_D("found continuous 0x7e");
             }
-            break;
-        default:
-            LOG_E("BUG: unexpect state: %u", (unsigned int)device->state);
         }
-        if (device->rxpos == sizeof(device->rxbuf))
+    }
+
+    if (device->state == PPP_STATE_RECV_DATA && (rt_size_t)(end - head) < sizeof(device->rxbuf))
+    {
+        /* input the frames ended, keep the frame not ended at the begin of buffer */
+        ppp_input(device, span, head - span);
+        device->rxpos = end - head;
+        if (head != device->rxbuf)
         {
-            LOG_W("receive ppp frame is lagger than %u", (unsigned int)sizeof(device->rxbuf));
-            ppp_rxbuf_drop(device);
+            rt_memmove(device->rxbuf, head, device->rxpos);
         }
     }
+    else
+    {
+        ppp_input(device, span, end - span);
+        device->rxpos = 0;
+    }
 }
 
 /**
@@ -395,7 +427,6 @@ static int ppp_recv_entry(struct ppp_device *device)
     const rt_uint32_t interested_event = PPP_EVENT_RX_NOTIFY | PPP_EVENT_LOST | PPP_EVENT_CLOSE_REQ;
     rt_uint32_t event;
     rt_size_t len;
-    rt_uint8_t buffer[PPP_RECV_READ_MAX];
     rt_bool_t closing = RT_FALSE;
 
     rt_event_control(&device->event, RT_IPC_CMD_RESET, RT_NULL);
@@ -424,9 +455,9 @@ static int ppp_recv_entry(struct ppp_device *device)
         {
             do
             {
-                len = rt_device_read(device->uart, 0, buffer, PPP_RECV_READ_MAX);
+                len = rt_device_read(device->uart, 0, device->rxbuf + device->rxpos, sizeof(device->rxbuf) - device->rxpos);
                 if (len)
-                    ppp_recv_processdata(device, buffer, len);
+                    ppp_recv_processdata(device, len);
             } while (len);
         }
 
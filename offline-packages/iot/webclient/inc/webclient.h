@@ -12,6 +12,7 @@
  * 2018-01-04     aozima       add ipv6 address support.
  * 2018-07-26     chenyong     modify log information
  * 2018-08-07     chenyong     modify header processing
+ * 2024-10-19     Evlers       add receive buffer and keep-alive connection reuse
  */
 
 #ifndef __WEBCLIENT_H__
@@ -79,6 +80,11 @@ extern "C" {
 #define WEBCLIENT_HEADER_BUFSZ         4096
 #define WEBCLIENT_RESPONSE_BUFSZ       4096
 
+/* receive buffer of the response header, chunk size line and small body reads */
+#ifndef WEBCLIENT_RECV_BUFSZ
+#define WEBCLIENT_RECV_BUFSZ           1024
+#endif
+
 enum WEBCLIENT_STATUS
 {
     WEBCLIENT_OK,
@@ -124,6 +130,14 @@ struct webclient_session
     size_t content_remainder;           /* remainder of content length */
     int (*handle_function)(char *buffer, int size); /* handle function */
 
+    char *recv_buf;                     /* receive buffer */
+    size_t recv_pos;                    /* read position of receive buffer */
+    size_t recv_len;                    /* data length of receive buffer */
+
+    int req_method;                     /* method of the last request */
+    rt_bool_t keep_alive;               /* the connection is kept by server after the response */
+    char *origin;                       /* "scheme://host[:port]" of the connection */
+
     rt_bool_t is_tls;                   /* HTTPS connect */
 #ifdef WEBCLIENT_USING_MBED_TLS
     MbedTLSSession *tls_session;        /* mbedtls connect session */
@@ -13,6 +13,7 @@
  * 2018-07-26     chenyong     modify log information
  * 2018-08-07     chenyong     modify header processing
  * 2021-06-09     xiangxistu   add shard download function
+ * 2024-10-19     Evlers       add receive buffer and keep-alive connection reuse
  */
 
 #include <stdio.h>
@@ -47,6 +48,12 @@
 /* default receive or send timeout */
 #define WEBCLIENT_DEFAULT_TIMEO        6
 
+/* reconnect times of shard download without receiving any data */
+#define WEBCLIENT_SHARD_RETRY          3
+
+/* the maximum number of the 301 and 302 redirections of a request */
+#define WEBCLIENT_REDIRECT_MAX         5
+
 extern long int strtol(const char *nptr, char **endptr, int base);
 
 static int webclient_strncasecmp(const char *a, const char *b, size_t n)
@@ -105,39 +112,123 @@ static int webclient_recv(struct webclient_session* session, void *buffer, size_
     return recv(session->socket, buffer, len, flag);
 }
 
-static int webclient_read_line(struct webclient_session *session, char *buffer, int size)
+/* receive data, retry when the tls layer needs to be called again */
+static int webclient_recv_retry(struct webclient_session *session, void *buffer, size_t len)
 {
-    int rc, count = 0;
-    char ch = 0, last_ch = 0;
+    int rc;
 
-    RT_ASSERT(session);
-    RT_ASSERT(buffer);
-
-    /* Keep reading until we fill the buffer. */
-    while (count < size)
+    while (1)
     {
-        rc = webclient_recv(session, (unsigned char *) &ch, 1, 0);
+        rc = webclient_recv(session, buffer, len, 0);
 #if defined(WEBCLIENT_USING_MBED_TLS) || defined(WEBCLIENT_USING_SAL_TLS)
         if (session->is_tls && (rc == MBEDTLS_ERR_SSL_WANT_READ || rc == MBEDTLS_ERR_SSL_WANT_WRITE))
         {
             continue;
         }
 #endif
-        if (rc <= 0)
-            return rc;
+        return rc;
+    }
+}
 
-        if (ch == '\n' && last_ch == '\r')
-            break;
+/* make sure there is data in the receive buffer, return the buffered data length */
+static int webclient_recv_fill(struct webclient_session *session)
+{
+    int rc;
+
+    if (session->recv_pos < session->recv_len)
+    {
+        return session->recv_len - session->recv_pos;
+    }
+
+    session->recv_pos = session->recv_len = 0;
+
+    rc = webclient_recv_retry(session, session->recv_buf, WEBCLIENT_RECV_BUFSZ);
+    if (rc > 0)
+    {
+        session->recv_len = rc;
+    }
 
-        buffer[count++] = ch;
+    return rc;
+}
+
+/* read the buffered data first, a large read without buffered data goes to the user buffer directly */
+static int webclient_recv_buffered(struct webclient_session *session, void *buffer, size_t len)
+{
+    int rc;
 
-        last_ch = ch;
+    if (session->recv_pos >= session->recv_len && len >= WEBCLIENT_RECV_BUFSZ)
+    {
+        return webclient_recv_retry(session, buffer, len);
     }
 
-    if (count > size)
+    rc = webclient_recv_fill(session);
+    if (rc <= 0)
     {
-        LOG_E("read line failed. The line data length is out of buffer size(%d)!", count);
-        return -WEBCLIENT_ERROR;
+        return rc;
+    }
+
+    if (len > (size_t) rc)
+    {
+        len = rc;
+    }
+
+    web_memcpy(buffer, session->recv_buf + session->recv_pos, len);
+    session->recv_pos += len;
+
+    return len;
+}
+
+/**
+ * read a line ends with "\r\n", the '\r' is kept and the '\n' is dropped.
+ * the line longer than the buffer is an error, the rest of it must not be taken as the next line.
+ */
+static int webclient_read_line(struct webclient_session *session, char *buffer, int size)
+{
+    int rc, count = 0;
+    char *data, *lf;
+    int len;
+
+    RT_ASSERT(session);
+    RT_ASSERT(buffer);
+
+    while (1)
+    {
+        rc = webclient_recv_fill(session);
+        if (rc <= 0)
+            return rc;
+
+        data = session->recv_buf + session->recv_pos;
+        lf = memchr(data, '\n', rc);
+        len = lf ? lf - data : rc;
+        if (len > size - count)
+        {
+            LOG_E("the line is longer than the buffer size(%d)!", size);
+            return -WEBCLIENT_NOMEM;
+        }
+
+        web_memcpy(buffer + count, data, len);
+        session->recv_pos += len;
+        count += len;
+
+        if (lf == RT_NULL)
+        {
+            continue;
+        }
+
+        if (count > 0 && buffer[count - 1] == '\r')
+        {
+            session->recv_pos++;
+            break;
+        }
+
+        /* a single '\n' is a part of the line */
+        if (count == size)
+        {
+            LOG_E("the line is longer than the buffer size(%d)!", size);
+            return -WEBCLIENT_NOMEM;
+        }
+        buffer[count++] = '\n';
+        session->recv_pos++;
     }
 
     return count;
@@ -515,6 +606,129 @@ __exit:
     return rc;
 }
 
+/* get the length of "scheme://host[:port]" part of the URI, return 0 if the URI is not supported */
+static int webclient_origin_length(const char *URI)
+{
+    const char *host_addr, *path_ptr;
+
+    if (strncmp(URI, "http://", 7) == 0)
+    {
+        host_addr = URI + 7;
+    }
+    else if (strncmp(URI, "https://", 8) == 0)
+    {
+        host_addr = URI + 8;
+    }
+    else
+    {
+        return 0;
+    }
+
+    path_ptr = strchr(host_addr, '/');
+
+    return path_ptr ? path_ptr - URI : (int) strlen(URI);
+}
+
+/* the response has been read completely and the server keeps the connection */
+static rt_bool_t webclient_reusable(struct webclient_session *session)
+{
+    if (session->socket < 0 || session->keep_alive == RT_FALSE)
+    {
+        return RT_FALSE;
+    }
+
+    /* the remaining data of the previous response would be taken as the next response */
+    if (session->recv_pos < session->recv_len)
+    {
+        return RT_FALSE;
+    }
+
+    if (session->chunk_sz != 0)
+    {
+        return session->chunk_sz < 0;
+    }
+
+    return session->content_remainder == 0;
+}
+
+static int webclient_clean(struct webclient_session *session);
+
+/**
+ * open the connection of URI, the keep-alive connection to the same server is reused.
+ *
+ * @param session webclient session
+ * @param URI the input server URI address
+ *
+ * @return <0: connect failed or other error
+ *         =0: connect or reuse success
+ */
+static int webclient_open(struct webclient_session *session, const char *URI)
+{
+    int rc, origin_len;
+    char *req_url;
+
+    origin_len = webclient_origin_length(URI);
+
+    if (origin_len > 0 && session->origin && webclient_reusable(session) &&
+        strlen(session->origin) == (size_t) origin_len && strncmp(session->origin, URI, origin_len) == 0)
+    {
+        req_url = web_strdup(URI[origin_len] ? URI + origin_len : "/");
+        if (req_url == RT_NULL)
+        {
+            return -WEBCLIENT_NOMEM;
+        }
+
+        if (session->req_url)
+        {
+            web_free(session->req_url);
+        }
+        session->req_url = req_url;
+
+        LOG_D("reuse the connection of %s.", session->origin);
+        return WEBCLIENT_OK;
+    }
+
+    webclient_clean(session);
+
+    rc = webclient_connect(session, URI);
+    if (rc != WEBCLIENT_OK)
+    {
+        return rc;
+    }
+
+    session->origin = web_malloc(origin_len + 1);
+    if (session->origin)
+    {
+        web_memcpy(session->origin, URI, origin_len);
+        session->origin[origin_len] = '\0';
+    }
+
+    return WEBCLIENT_OK;
+}
+
+/* discard the rest of the response body, so that the connection can be reused by the next request */
+static void webclient_discard_body(struct webclient_session *session)
+{
+    char buffer[64];
+    int total = 0, length;
+
+    /* the body without the length is ended by closing the connection */
+    if (session->keep_alive == RT_FALSE || (session->chunk_sz == 0 && session->content_length < 0))
+    {
+        return;
+    }
+
+    while (webclient_reusable(session) == RT_FALSE && total < WEBCLIENT_RESPONSE_BUFSZ)
+    {
+        length = webclient_read(session, buffer, sizeof(buffer));
+        if (length <= 0)
+        {
+            break;
+        }
+        total += length;
+    }
+}
+
 /**
  * add fields data to request header data.
  *
@@ -637,6 +851,7 @@ static int webclient_send_header(struct webclient_session *session, int method)
     RT_ASSERT(session);
 
     header = session->header->buffer;
+    session->req_method = method;
 
     if (session->header->length == 0 && method <= WEBCLIENT_GET)
     {
@@ -746,6 +961,33 @@ __exit:
     return rc;
 }
 
+/* the last chunk has been received, read the trailer until the empty line */
+static void webclient_chunk_end(struct webclient_session *session)
+{
+    char line[64];
+    int length;
+
+    do
+    {
+        length = webclient_read_line(session, line, sizeof(line));
+    }
+    while (length > 1 || (length == 1 && line[0] != '\r'));
+
+    if (length <= 0)
+    {
+        session->keep_alive = RT_FALSE;
+    }
+
+    /* end of chunks */
+    session->chunk_sz = -1;
+
+    if (session->keep_alive == RT_FALSE)
+    {
+        closesocket(session->socket);
+        session->socket = -1;
+    }
+}
+
 /**
  * resolve server response data.
  *
@@ -760,6 +1002,7 @@ int webclient_handle_response(struct webclient_session *session)
     char *mime_buffer = RT_NULL;
     char *mime_ptr = RT_NULL;
     const char *transfer_encoding;
+    const char *connection;
     int i;
 
     RT_ASSERT(session);
@@ -768,6 +1011,13 @@ int webclient_handle_response(struct webclient_session *session)
     web_memset(session->header->buffer, 0x00, session->header->size);
     session->header->length = 0;
 
+    /* clean the state of the previous response on this connection */
+    session->resp_status = 0;
+    session->content_length = -1;
+    session->chunk_sz = 0;
+    session->chunk_offset = 0;
+    session->keep_alive = RT_FALSE;
+
     LOG_D("response header:");
     /* We now need to read the header information */
     while (1)
@@ -803,6 +1053,12 @@ int webclient_handle_response(struct webclient_session *session)
         }
     }
 
+    /* the connection is broken or a header line is too long */
+    if (rc < 0)
+    {
+        return rc;
+    }
+
     /* get HTTP status code */
     mime_ptr = web_strdup(session->header->buffer);
     if (mime_ptr == RT_NULL)
@@ -832,17 +1088,56 @@ int webclient_handle_response(struct webclient_session *session)
     {
         session->content_length = atoi(webclient_header_fields_get(session, "Content-Length"));
     }
-    session->content_remainder = session->content_length ? (size_t) session->content_length : 0xFFFFFFFF;
+    session->content_remainder = session->content_length >= 0 ? (size_t) session->content_length : 0xFFFFFFFF;
+
+    /* HTTP/1.1 keeps the connection by default, HTTP/1.0 closes it by default */
+    session->keep_alive = (strncmp(session->header->buffer, "HTTP/1.1", 8) == 0) ? RT_TRUE : RT_FALSE;
+    connection = webclient_header_fields_get(session, "Connection");
+    if (connection)
+    {
+        if (webclient_strncasecmp(connection, "close", 5) == 0)
+        {
+            session->keep_alive = RT_FALSE;
+        }
+        else if (webclient_strncasecmp(connection, "keep-alive", 10) == 0)
+        {
+            session->keep_alive = RT_TRUE;
+        }
+    }
 
     transfer_encoding = webclient_header_fields_get(session, "Transfer-Encoding");
-    if (transfer_encoding && strcmp(transfer_encoding, "chunked") == 0)
+    if (session->req_method == WEBCLIENT_HEAD || session->resp_status == 204 || session->resp_status == 304 ||
+        (session->resp_status >= 100 && session->resp_status < 200))
+    {
+        /* no body in the response */
+        session->content_remainder = 0;
+    }
+    else if (transfer_encoding && strcmp(transfer_encoding, "chunked") == 0)
     {
         rt_uint16_t len = session->header->size;
         char *line = rt_malloc(len);
         /* chunk mode, we should get the first chunk size */
-        webclient_read_line(session, line, len);
-        session->chunk_sz = strtol(line, RT_NULL, 16);
-        session->chunk_offset = 0;
+        if (line == RT_NULL)
+        {
+            web_free(mime_ptr);
+            return -WEBCLIENT_NOMEM;
+        }
+        web_memset(line, 0x00, len);
+        if (webclient_read_line(session, line, len - 1) > 0)
+        {
+            session->chunk_sz = strtol(line, RT_NULL, 16);
+            session->chunk_offset = 0;
+
+            /* the body is empty */
+            if (session->chunk_sz == 0)
+            {
+                webclient_chunk_end(session);
+            }
+        }
+        else
+        {
+            session->keep_alive = RT_FALSE;
+        }
         rt_free(line);
     }
 
@@ -851,11 +1146,6 @@ int webclient_handle_response(struct webclient_session *session)
         web_free(mime_ptr);
     }
 
-    if (rc < 0)
-    {
-        return rc;
-    }
-
     return session->resp_status;
 }
 
@@ -882,11 +1172,22 @@ struct webclient_session *webclient_session_create(size_t header_sz)
     /* initialize the socket of session */
     session->socket = -1;
     session->content_length = -1;
+    session->content_remainder = 0xFFFFFFFF;
+
+    session->recv_buf = (char *) web_malloc(WEBCLIENT_RECV_BUFSZ);
+    if (session->recv_buf == RT_NULL)
+    {
+        LOG_E("webclient create failed, no memory for session receive buffer!");
+        web_free(session);
+        session = RT_NULL;
+        return RT_NULL;
+    }
 
     session->header = (struct webclient_header *) web_calloc(1, sizeof(struct webclient_header));
     if (session->header == RT_NULL)
     {
         LOG_E("webclient create failed, no memory for session header!");
+        web_free(session->recv_buf);
         web_free(session);
         session = RT_NULL;
         return RT_NULL;
@@ -898,6 +1199,7 @@ struct webclient_session *webclient_session_create(size_t header_sz)
     {
         LOG_E("webclient create failed, no memory for session header buffer!");
         web_free(session->header);
+        web_free(session->recv_buf);
         web_free(session);
         session = RT_NULL;
         return RT_NULL;
@@ -906,21 +1208,8 @@ struct webclient_session *webclient_session_create(size_t header_sz)
     return session;
 }
 
-static int webclient_clean(struct webclient_session *session);
-
-/**
- *  send GET request to http server and get response header.
- *
- * @param session webclient session
- * @param URI input server URI address
- * @param header GET request header
- *             = NULL: use default header data
- *            != NULL: use custom header data
- *
- * @return <0: send GET request failed
- *         >0: response http status code
- */
-int webclient_get(struct webclient_session *session, const char *URI)
+/* send GET request and follow the 301 and 302 redirections, "redirects" is the number of them so far */
+static int webclient_get_location(struct webclient_session *session, const char *URI, int redirects)
 {
     int rc = WEBCLIENT_OK;
     int resp_status = 0;
@@ -928,7 +1217,7 @@ int webclient_get(struct webclient_session *session, const char *URI)
     RT_ASSERT(session);
     RT_ASSERT(URI);
 
-    rc = webclient_connect(session, URI);
+    rc = webclient_open(session, URI);
     if (rc != WEBCLIENT_OK)
     {
         /* connect to webclient server failed. */
@@ -951,8 +1240,8 @@ int webclient_get(struct webclient_session *session, const char *URI)
     {
         const char *location = webclient_header_fields_get(session, "Location");
 
-        /* relocation */
-        if ((resp_status == 302 || resp_status == 301) && location)
+        /* relocation, the status is returned when there are too many redirections */
+        if ((resp_status == 302 || resp_status == 301) && location && redirects < WEBCLIENT_REDIRECT_MAX)
         {
             char *new_url;
 
@@ -962,13 +1251,13 @@ int webclient_get(struct webclient_session *session, const char *URI)
                 return -WEBCLIENT_NOMEM;
             }
 
-            /* clean webclient session */
-            webclient_clean(session);
+            /* the connection is reused if the new location is on the same server */
+            webclient_discard_body(session);
             /* clean webclient session header */
             session->header->length = 0;
             web_memset(session->header->buffer, 0, session->header->size);
 
-            rc = webclient_get(session, new_url);
+            rc = webclient_get_location(session, new_url, redirects + 1);
 
             web_free(new_url);
             return rc;
@@ -978,6 +1267,23 @@ int webclient_get(struct webclient_session *session, const char *URI)
     return resp_status;
 }
 
+/**
+ *  send GET request to http server and get response header.
+ *
+ * @param session webclient session
+ * @param URI input server URI address
+ * @param header GET request header
+ *             = NULL: use default header data
+ *            != NULL: use custom header data
+ *
+ * @return <0: send GET request failed
+ *         >0: response http status code
+ */
+int webclient_get(struct webclient_session *session, const char *URI)
+{
+    return webclient_get_location(session, URI, 0);
+}
+
 /**
  *  register a handle function for http breakpoint resume and shard download.
  *
@@ -1010,13 +1316,10 @@ int webclient_shard_head_function(struct webclient_session *session, const char
     int rc = WEBCLIENT_OK;
     int resp_status = 0;
 
-    if(session->socket == -1)
+    rc = webclient_open(session, URI);
+    if (rc != WEBCLIENT_OK)
     {
-        rc = webclient_connect(session, URI);
-        if (rc != WEBCLIENT_OK)
-        {
-            return rc;
-        }
+        return rc;
     }
 
     /* clean header buffer and size */
@@ -1040,54 +1343,44 @@ int webclient_shard_head_function(struct webclient_session *session, const char
     return rc;
 }
 
-/**
- *  http breakpoint resume and shard download.
- *
- * @param session webclient session
- * @param URI input server URI address
- * @param start the position of you want to receive
- * @param length the length of data length from "webclient_shard_head_function"
- * @param mem_size the buffer size that you alloc
- *
- * @return <0: send GET request failed
- *         >0: response http status code
- */
-int webclient_shard_position_function(struct webclient_session *session, const char *URI, int start, int length, int mem_size)
+/* shard download from the position, "redirects" is the number of the 301 and 302 redirections so far */
+static int webclient_shard_position(struct webclient_session *session, const char *URI, int start, int length,
+                                    int mem_size, int redirects)
 {
     int rc = WEBCLIENT_OK;
     int result = RT_EOK;
     int resp_status = 0;
-    size_t resp_len = 0;
     char *buffer = RT_NULL;
-    int start_position, end_position = 0;
-    int total_len = 0;
+    int position, total_len, pass_position;
+    int data_len, piece_len;
+    int retry = 0;
 
     RT_ASSERT(session);
     RT_ASSERT(URI);
     RT_ASSERT(mem_size);
 
-    /* set the offset of "Range" and "total_len"  */
-    end_position = start;
+    position = start;
     total_len = start + length;
 
-    /* clean header buffer and size */
-    web_memset(session->header->buffer, 0x00, session->header->size);
-    session->header->length = 0;
-
-    for(start_position = end_position; total_len != end_position + 1;)
+    while (position < total_len)
     {
-        RT_ASSERT(start_position <= total_len);
-        int data_len = 0;
+        pass_position = position;
 
-        end_position = start_position + mem_size - 1;
-        if(end_position >= total_len)
+        /* reconnect if the connection is closed or not kept alive by server */
+        rc = webclient_open(session, URI);
+        if (rc != WEBCLIENT_OK)
         {
-            end_position = total_len - 1;
+            LOG_E("webclient reconnect failed. Please retry by yourself.");
+            return rc;
         }
 
+        /* clean header buffer and size */
+        web_memset(session->header->buffer, 0x00, session->header->size);
+        session->header->length = 0;
+
         /* splice header and send header */
-        LOG_D("Range: [%04d -> %04d]", start_position, end_position);
-        webclient_header_fields_add(session, "Range: bytes=%d-%d\r\n", start_position, end_position);
+        LOG_D("Range: [%04d -> %04d]", position, total_len - 1);
+        webclient_header_fields_add(session, "Range: bytes=%d-%d\r\n", position, total_len - 1);
         rc = webclient_send_header(session, WEBCLIENT_GET);
         if (rc != WEBCLIENT_OK)
         {
@@ -1097,11 +1390,11 @@ int webclient_shard_position_function(struct webclient_session *session, const c
         /* handle the response header of webclient server */
         resp_status = webclient_handle_response(session);
         LOG_D("get position handle response(%d).", resp_status);
-        if (resp_status == 206)
+        if (resp_status == 206 || (resp_status == 200 && position == 0))
         {
             /* normal resp_status */
         }
-        else if(resp_status > 0)
+        else if (resp_status > 0)
         {
             const char *location = webclient_header_fields_get(session, "Location");
 
@@ -1110,76 +1403,131 @@ int webclient_shard_position_function(struct webclient_session *session, const c
             {
                 char *new_url;
 
+                if (redirects >= WEBCLIENT_REDIRECT_MAX)
+                {
+                    LOG_E("shard download failed, too many redirections.");
+                    return -WEBCLIENT_ERROR;
+                }
+
                 new_url = web_strdup(location);
                 if (new_url == RT_NULL)
                 {
                     return -WEBCLIENT_NOMEM;
                 }
 
-                /* clean webclient session */
-                webclient_clean(session);
-                /* clean webclient session header */
-                session->header->length = 0;
-                web_memset(session->header->buffer, 0, session->header->size);
+                /* the connection is reused if the new location is on the same server */
+                webclient_discard_body(session);
 
-                rc = webclient_shard_position_function(session, new_url, start, length, mem_size);
+                rc = webclient_shard_position(session, new_url, position, total_len - position, mem_size, redirects + 1);
 
                 web_free(new_url);
                 return rc;
             }
+
+            LOG_E("shard download failed, response status(%d).", resp_status);
+            return -WEBCLIENT_ERROR;
         }
         else
         {
-            if(resp_status == -WEBCLIENT_ERROR)
+            /* the connection is lost, reconnect and retry at the same position */
+            webclient_clean(session);
+            if (++retry > WEBCLIENT_SHARD_RETRY)
             {
-                if(session->socket == -WEBCLIENT_ERROR)
-                {
-                    /* clean webclient session */
-                    webclient_clean(session);
-                    if(webclient_connect(session, URI) == WEBCLIENT_OK)
-                    {
-                        LOG_D("webclient reconnect success, retry at [%06d]", end_position);
-                        end_position = start_position;
-                        continue;
-                    }
-                    else
-                    {
-                        LOG_E("webclient reconnect failed. Please retry by yourself.");
-                        return -WEBCLIENT_ERROR;
-                    }
-                }
+                LOG_E("webclient reconnect failed. Please retry by yourself.");
+                return -WEBCLIENT_ERROR;
             }
+            LOG_D("webclient reconnect, retry at [%06d]", position);
+            continue;
         }
 
         /* receive the incoming data */
-        data_len = webclient_response(session, (void **)&buffer, &resp_len);
-        if(data_len > 0)
+        while (position < total_len)
         {
-            start_position += data_len;
+            piece_len = (total_len - position > mem_size) ? mem_size : total_len - position;
+
+            buffer = (char *) web_malloc(piece_len + 1);
+            if (buffer == RT_NULL)
+            {
+                LOG_E("no memory for shard download buffer!");
+                return -WEBCLIENT_NOMEM;
+            }
+
+            for (data_len = 0; data_len < piece_len;)
+            {
+                int read_len = webclient_read(session, buffer + data_len, piece_len - data_len);
+                if (read_len <= 0)
+                {
+                    break;
+                }
+                data_len += read_len;
+            }
+
+            if (data_len == 0)
+            {
+                web_free(buffer);
+                break;
+            }
+
+            buffer[data_len] = '\0';
+            position += data_len;
+
+            /* the buffer is released by the handle function */
             result = session->handle_function(buffer, data_len);
-            if(result != RT_EOK)
+            if (result != RT_EOK)
             {
                 return -WEBCLIENT_ERROR;
             }
+
+            if (data_len < piece_len)
+            {
+                break;
+            }
         }
-        else
+
+        if (position < total_len)
         {
-            /* clean webclient session */
-            webclient_clean(session);
-            if(session->socket == -WEBCLIENT_ERROR)
+            if (webclient_reusable(session) == RT_FALSE)
             {
-                webclient_connect(session, URI);
+                /* clean webclient session */
+                webclient_clean(session);
             }
-        }
 
-        /* clean header buffer and size */
-        web_memset(session->header->buffer, 0x00, session->header->size);
-        session->header->length = 0;
+            /* a response without any data, e.g. an empty or short body on a kept connection, is retried at most */
+            if (position > pass_position)
+            {
+                retry = 0;
+            }
+            else if (++retry > WEBCLIENT_SHARD_RETRY)
+            {
+                LOG_E("shard download failed, no data is received at [%06d].", position);
+                return -WEBCLIENT_ERROR;
+            }
+        }
     }
 
     return rc;
 }
 
+/**
+ *  http breakpoint resume and shard download.
+ *  All of the remaining data is requested by one "Range" request on the keep-alive connection,
+ *  and passed to the handle function in pieces of "mem_size" bytes.
+ *  The handle function must free the buffer of each piece.
+ *
+ * @param session webclient session
+ * @param URI input server URI address
+ * @param start the position of you want to receive
+ * @param length the length of data length from "webclient_shard_head_function"
+ * @param mem_size the buffer size that you alloc
+ *
+ * @return <0: send GET request failed
+ *         =0: success
+ */
+int webclient_shard_position_function(struct webclient_session *session, const char *URI, int start, int length, int mem_size)
+{
+    return webclient_shard_position(session, URI, start, length, mem_size, 0);
+}
+
 /**
  * send POST request to server and get response header data.
  *
@@ -1208,7 +1556,7 @@ int webclient_post(struct webclient_session *session, const char *URI, const voi
         return -WEBCLIENT_ERROR;
     }
 
-    rc = webclient_connect(session, URI);
+    rc = webclient_open(session, URI);
     if (rc != WEBCLIENT_OK)
     {
         /* connect to webclient server failed. */
@@ -1270,12 +1618,13 @@ static int webclient_next_chunk(struct webclient_session *session)
     RT_ASSERT(session);
 
     web_memset(line, 0x00, sizeof(line));
-    length = webclient_read_line(session, line, sizeof(line));
+    length = webclient_read_line(session, line, sizeof(line) - 1);
     if (length > 0)
     {
         if (strcmp(line, "\r") == 0)
         {
-            length = webclient_read_line(session, line, sizeof(line));
+            web_memset(line, 0x00, sizeof(line));
+            length = webclient_read_line(session, line, sizeof(line) - 1);
             if (length <= 0)
             {
                 closesocket(session->socket);
@@ -1297,10 +1646,8 @@ static int webclient_next_chunk(struct webclient_session *session)
 
     if (session->chunk_sz == 0)
     {
-        /* end of chunks */
-        closesocket(session->socket);
-        session->socket = -1;
-        session->chunk_sz = -1;
+        /* end of chunks, the connection is closed if it is not kept alive */
+        webclient_chunk_end(session);
     }
 
     return session->chunk_sz;
@@ -1349,7 +1696,7 @@ int webclient_read(struct webclient_session *session, void *buffer, size_t lengt
             length = session->chunk_sz - session->chunk_offset;
         }
 
-        bytes_read = webclient_recv(session, buffer, length, 0);
+        bytes_read = webclient_recv_buffered(session, buffer, length);
         if (bytes_read <= 0)
         {
             if (errno == EWOULDBLOCK || errno == EAGAIN)
@@ -1374,17 +1721,14 @@ int webclient_read(struct webclient_session *session, void *buffer, size_t lengt
         return bytes_read;
     }
 
-    if (session->content_length > 0)
+    if (length > session->content_remainder)
     {
-        if (length > session->content_remainder)
-        {
-            length = session->content_remainder;
-        }
+        length = session->content_remainder;
+    }
 
-        if (length == 0)
-        {
-            return 0;
-        }
+    if (length == 0)
+    {
+        return 0;
     }
 
     /*
@@ -1394,17 +1738,9 @@ int webclient_read(struct webclient_session *session, void *buffer, size_t lengt
     left = length;
     do
     {
-        bytes_read = webclient_recv(session, (void *)((char *)buffer + total_read), left, 0);
+        bytes_read = webclient_recv_buffered(session, (void *)((char *)buffer + total_read), left);
         if (bytes_read <= 0)
         {
-#if defined(WEBCLIENT_USING_SAL_TLS) || defined(WEBCLIENT_USING_MBED_TLS)
-            if(session->is_tls &&
-                (bytes_read == MBEDTLS_ERR_SSL_WANT_READ || bytes_read == MBEDTLS_ERR_SSL_WANT_WRITE))
-            {
-                continue;
-            }
-
-#endif
             LOG_D("receive data error(%d).", bytes_read);
 
             if (total_read)
@@ -1433,7 +1769,7 @@ int webclient_read(struct webclient_session *session, void *buffer, size_t lengt
     }
     while (left);
 
-    if (session->content_length > 0)
+    if (session->content_length >= 0)
     {
         session->content_remainder -= total_read;
     }
@@ -1522,6 +1858,8 @@ static int webclient_clean(struct webclient_session *session)
     if (session->tls_session)
     {
         mbedtls_client_close(session->tls_session);
+        session->tls_session = RT_NULL;
+        session->socket = -1;
     }
     else
     {
@@ -1551,6 +1889,15 @@ static int webclient_clean(struct webclient_session *session)
         session->req_url = RT_NULL;
     }
 
+    if (session->origin)
+    {
+        web_free(session->origin);
+        session->origin = RT_NULL;
+    }
+
+    session->is_tls = RT_FALSE;
+    session->keep_alive = RT_FALSE;
+    session->recv_pos = session->recv_len = 0;
     session->content_length = -1;
 
     return 0;
@@ -1579,6 +1926,11 @@ int webclient_close(struct webclient_session *session)
         web_free(session->header);
     }
 
+    if (session->recv_buf)
+    {
+        web_free(session->recv_buf);
+    }
+
     if (session)
     {
         web_free(session);
@@ -1701,7 +2053,7 @@ int webclient_request_header_add(char **request_header, const char *fmt, ...)
         if (header == RT_NULL)
         {
             LOG_E("No memory for webclient request header add.");
-            return RT_NULL;
+            return -WEBCLIENT_NOMEM;
         }
         *request_header = header;
     }
@@ -7,12 +7,15 @@
  * Date           Author       Notes
  * 2021-10-18     Meco Man     the first version
  * 2022-05-10     Meco Man     improve rt-thread initialization process
+ * 2024-10-23     Evlers       sleep until the next timer, a signal or an input event
  */
 
 #ifdef __RTTHREAD__
 
 #include <lvgl.h>
 #include <rtthread.h>
+#include <rthw.h>
+#include "lv_rt_thread_port.h"
 
 #define DBG_TAG    "LVGL"
 #define DBG_LVL    DBG_INFO
@@ -30,7 +33,15 @@ extern void lv_port_disp_init(void);
 extern void lv_port_indev_init(void);
 extern void lv_user_gui_init(void);
 
+#define LVGL_EVENT_WAKEUP   (1 << 0)
+#define LVGL_EVENT_INDEV    (1 << 1)
+
 static struct rt_thread lvgl_thread;
+static struct rt_mutex lvgl_mutex;
+static struct rt_event lvgl_event;
+static struct lv_rt_thread_stats lvgl_stats;
+static rt_tick_t lvgl_signal_tick;
+static rt_bool_t lvgl_signaled;
 
 #ifdef rt_align
 rt_align(RT_ALIGN_SIZE)
@@ -46,21 +57,163 @@ static void lv_rt_log(const char *buf)
 }
 #endif /* LV_USE_LOG */
 
+static void lvgl_signal(rt_uint32_t set)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+    if(!lvgl_signaled)
+    {
+        lvgl_signaled = RT_TRUE;
+        lvgl_signal_tick = rt_tick_get();
+    }
+    rt_hw_interrupt_enable(level);
+
+    rt_event_send(&lvgl_event, set);
+}
+
+void lv_rt_thread_lock(void)
+{
+    rt_mutex_take(&lvgl_mutex, RT_WAITING_FOREVER);
+}
+
+void lv_rt_thread_unlock(void)
+{
+    /* the lvgl thread takes the lock recursively, it runs the handler anyway */
+    if(rt_thread_self() != &lvgl_thread)
+    {
+        lvgl_signal(LVGL_EVENT_WAKEUP);
+    }
+    rt_mutex_release(&lvgl_mutex);
+}
+
+void lv_rt_thread_wakeup(void)
+{
+    lvgl_signal(LVGL_EVENT_WAKEUP);
+}
+
+void lv_rt_thread_indev_wakeup(void)
+{
+    lvgl_signal(LVGL_EVENT_INDEV);
+}
+
+void lv_rt_thread_stats_get(struct lv_rt_thread_stats *stats)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+    *stats = lvgl_stats;
+    rt_hw_interrupt_enable(level);
+}
+
+void lv_rt_thread_stats_reset(void)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+    rt_memset(&lvgl_stats, 0, sizeof(lvgl_stats));
+    rt_hw_interrupt_enable(level);
+}
+
+/* read the input devices in this run, the paused read timers of event driven devices too */
+static void lvgl_indev_ready(void)
+{
+    lv_indev_t *indev = lv_indev_get_next(NULL);
+
+    while(indev)
+    {
+        lv_timer_t *timer = indev->driver->read_timer;
+
+        if(timer->paused)
+        {
+            lv_indev_read_timer_cb(timer);
+        }
+        else
+        {
+            lv_timer_ready(timer);
+        }
+        indev = lv_indev_get_next(indev);
+    }
+}
+
 static void lvgl_thread_entry(void *parameter)
 {
+    rt_uint32_t set = 0;
+    rt_tick_t signal_tick = 0;
+
 #if LV_USE_LOG
     lv_log_register_print_cb(lv_rt_log);
 #endif /* LV_USE_LOG */
+    lv_rt_thread_lock();
     lv_init();
     lv_port_disp_init();
     lv_port_indev_init();
     lv_user_gui_init();
+    lv_rt_thread_unlock();
 
-    /* handle the tasks of LVGL */
+    /* handle the tasks of LVGL, sleep until the next timer is due or something changed */
     while(1)
     {
-        lv_task_handler();
-        rt_thread_mdelay(LV_DISP_DEF_REFR_PERIOD);
+        rt_uint32_t next;
+        rt_int32_t timeout;
+        rt_tick_t start;
+        rt_base_t level;
+
+        lv_rt_thread_lock();
+        if(set & LVGL_EVENT_INDEV)
+        {
+            lvgl_indev_ready();
+        }
+        next = lv_timer_handler();
+        lv_rt_thread_unlock();
+
+        level = rt_hw_interrupt_disable();
+        lvgl_stats.runs++;
+        if(set)
+        {
+            rt_tick_t latency = (rt_tick_get() - signal_tick) * 1000 / RT_TICK_PER_SECOND;
+            if(latency > lvgl_stats.latency_max)
+            {
+                lvgl_stats.latency_max = latency;
+            }
+            lvgl_stats.latency_sum += latency;
+            lvgl_stats.latency_count++;
+        }
+        rt_hw_interrupt_enable(level);
+
+        /* the refresh timer pauses itself when nothing is invalid, no timer means nothing to do */
+        if(next == LV_NO_TIMER_READY)
+        {
+            timeout = RT_WAITING_FOREVER;
+        }
+        else
+        {
+            timeout = rt_tick_from_millisecond(next);
+        }
+
+        start = rt_tick_get();
+        set = 0;
+        if(rt_event_recv(&lvgl_event, LVGL_EVENT_WAKEUP | LVGL_EVENT_INDEV, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR,
+                         timeout, &set) != RT_EOK)
+        {
+            set = 0;
+        }
+
+        level = rt_hw_interrupt_disable();
+        lvgl_stats.sleep_ms += (rt_tick_get() - start) * 1000 / RT_TICK_PER_SECOND;
+        if(set)
+        {
+            /* this run serves the signals so far, the ones during it wake the next run */
+            signal_tick = lvgl_signal_tick;
+            lvgl_signaled = RT_FALSE;
+        }
+        if(set & LVGL_EVENT_INDEV)
+        {
+            lvgl_stats.wakeups_indev++;
+        }
+        else if(set)
+        {
+            lvgl_stats.wakeups_signal++;
+        }
+        else
+        {
+            lvgl_stats.wakeups_timer++;
+        }
+        rt_hw_interrupt_enable(level);
     }
 }
 
@@ -68,6 +221,9 @@ static int lvgl_thread_init(void)
 {
     rt_err_t err;
 
+    rt_mutex_init(&lvgl_mutex, "LVGL", RT_IPC_FLAG_PRIO);
+    rt_event_init(&lvgl_event, "LVGL", RT_IPC_FLAG_PRIO);
+
     err = rt_thread_init(&lvgl_thread, "LVGL", lvgl_thread_entry, RT_NULL,
            &lvgl_thread_stack[0], sizeof(lvgl_thread_stack), PKG_LVGL_THREAD_PRIO, 10);
     if(err != RT_EOK)
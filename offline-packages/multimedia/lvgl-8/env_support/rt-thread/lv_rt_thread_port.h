@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2006-2024, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-23     Evlers       the first version
+ */
+
+#ifndef LV_RT_THREAD_PORT_H
+#define LV_RT_THREAD_PORT_H
+
+#include <rtthread.h>
+
+struct lv_rt_thread_stats
+{
+    rt_uint32_t runs;               /* calls of lv_timer_handler() */
+    rt_uint32_t wakeups_timer;      /* the next lvgl timer was due */
+    rt_uint32_t wakeups_signal;     /* woken by lv_rt_thread_unlock() or lv_rt_thread_wakeup() */
+    rt_uint32_t wakeups_indev;      /* woken by lv_rt_thread_indev_wakeup() */
+    rt_uint32_t sleep_ms;           /* time the lvgl thread slept */
+    rt_uint32_t latency_max;        /* from a signal to the end of the handler run serving it, ms */
+    rt_uint32_t latency_sum;
+    rt_uint32_t latency_count;
+};
+
+/* other threads hold the lock while they call lvgl, the unlock wakes the lvgl thread to draw the changes */
+void lv_rt_thread_lock(void);
+void lv_rt_thread_unlock(void);
+
+/* may be called in interrupts */
+void lv_rt_thread_wakeup(void);
+/* reads the input devices at once, an input driver may pause its read timer and call it on each change */
+void lv_rt_thread_indev_wakeup(void);
+
+void lv_rt_thread_stats_get(struct lv_rt_thread_stats *stats);
+void lv_rt_thread_stats_reset(void);
+
+#endif /* LV_RT_THREAD_PORT_H */
@@ -49,6 +49,16 @@ size_t ef_get_env_blob(const char *key, void *value_buf, size_t buf_len, size_t
 bool ef_get_env_obj(const char *key, env_node_obj_t env);
 size_t ef_read_env_value(env_node_obj_t env, uint8_t *value_buf, size_t buf_len);
 EfErrCode ef_set_env_blob(const char *key, const void *value_buf, size_t buf_len);
+#ifdef EF_ENV_USING_TXN
+EfErrCode ef_env_txn_begin(void);
+EfErrCode ef_env_txn_set(const char *key, const void *value_buf, size_t buf_len);
+EfErrCode ef_env_txn_commit(void);
+void ef_env_txn_abort(void);
+#endif
+#ifdef EF_ENV_USING_INCREMENTAL_GC
+bool ef_env_gc_step(void);
+void ef_env_get_gc_stats(env_gc_stats_t stats);
+#endif
 
 /* ef_env.c, ef_env_legacy_wl.c and ef_env_legacy.c */
 EfErrCode ef_load_env(void);
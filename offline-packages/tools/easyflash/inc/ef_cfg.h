@@ -46,6 +46,27 @@
 #define EF_ENV_VER_NUM            PKG_EASYFLASH_ENV_VER_NUM
 #endif
 
+#ifdef PKG_EASYFLASH_ENV_USING_INDEX
+/* Using the RAM index of all ENV, the ENV lookup doesn't scan the flash. */
+#define EF_ENV_USING_INDEX
+/* ENV index slot number, it MUST be power of 2. It holds 7/8 slot number ENV at most. */
+#define EF_ENV_INDEX_SIZE         PKG_EASYFLASH_ENV_INDEX_SIZE
+#endif
+
+#ifdef PKG_EASYFLASH_ENV_USING_TXN
+/* Using the ENV transaction, several ENV are saved atomically by ef_env_txn_begin/set/commit. */
+#define EF_ENV_USING_TXN
+/* ENV transaction buffer size, all ENV of one transaction are packed in it. */
+#define EF_ENV_TXN_BUF_SIZE       PKG_EASYFLASH_ENV_TXN_BUF_SIZE
+#endif
+
+#ifdef PKG_EASYFLASH_ENV_USING_INCREMENTAL_GC
+/* Using the background incremental GC, ef_env_gc_step is called by a low priority thread. */
+#define EF_ENV_USING_INCREMENTAL_GC
+/* The background GC works when the free space is less than it. */
+#define EF_ENV_GC_RESERVE_SIZE    PKG_EASYFLASH_ENV_GC_RESERVE_SIZE
+#endif
+
 #endif /* PKG_EASYFLASH_ENV */
 
 /* using IAP function */
@@ -117,6 +117,16 @@ struct env_node_obj {
 };
 typedef struct env_node_obj *env_node_obj_t;
 
+struct env_gc_stats {
+    uint32_t step;                               /**< background GC step (collected sector) count */
+    uint32_t collected;                          /**< sectors collected by the background GC */
+    uint32_t fg_collected;                       /**< sectors collected when saving ENV */
+    uint32_t moved_env;                          /**< moved ENV count */
+    uint32_t moved_size;                         /**< moved ENV total size */
+    uint32_t step_max_size;                      /**< the most moved size of one background GC step */
+};
+typedef struct env_gc_stats *env_gc_stats_t;
+
 #ifdef __cplusplus
 }
 #endif
@@ -44,7 +44,8 @@ static const ef_env default_env_set[] = {
 };
 
 static char log_buf[RT_CONSOLEBUF_SIZE];
-static struct rt_semaphore env_cache_lock;
+/* a mutex for the priority inheritance, the low priority GC holds it for a whole sector erasing */
+static struct rt_mutex env_cache_lock;
 
 static const sfud_flash *flash;
 
@@ -62,7 +63,7 @@ EfErrCode ef_port_init(ef_env const **default_env, size_t *default_env_size) {
     *default_env = default_env_set;
     *default_env_size = sizeof(default_env_set) / sizeof(default_env_set[0]);
 
-    rt_sem_init(&env_cache_lock, "env lock", 1, RT_IPC_FLAG_PRIO);
+    rt_mutex_init(&env_cache_lock, "env lock", RT_IPC_FLAG_PRIO);
 
     extern rt_spi_flash_device_t w25q64;
     flash = (sfud_flash_t)(w25q64->user_data);
@@ -140,14 +141,14 @@ EfErrCode ef_port_write(uint32_t addr, const uint32_t *buf, size_t size) {
  * lock the ENV ram cache
  */
 void ef_port_env_lock(void) {
-    rt_sem_take(&env_cache_lock, RT_WAITING_FOREVER);
+    rt_mutex_take(&env_cache_lock, RT_WAITING_FOREVER);
 }
 
 /**
  * unlock the ENV ram cache
  */
 void ef_port_env_unlock(void) {
-    rt_sem_release(&env_cache_lock);
+    rt_mutex_release(&env_cache_lock);
 }
 
 /**
@@ -82,6 +82,34 @@
 #define EF_ENV_USING_CACHE
 #endif
 
+#ifdef EF_ENV_USING_INDEX
+/* the ENV index slot number, it must be power of 2. The index holds at most 7/8 of it, more ENV disables the index */
+#ifndef EF_ENV_INDEX_SIZE
+#define EF_ENV_INDEX_SIZE                        128
+#endif
+
+#if (EF_ENV_INDEX_SIZE < 8) || (EF_ENV_INDEX_SIZE & (EF_ENV_INDEX_SIZE - 1))
+#error "The ENV index size must be power of 2 and not less than 8"
+#endif
+
+#define ENV_INDEX_MASK                           (EF_ENV_INDEX_SIZE - 1)
+#define ENV_INDEX_MAX_USED                       (EF_ENV_INDEX_SIZE - EF_ENV_INDEX_SIZE / 8)
+#endif /* EF_ENV_USING_INDEX */
+
+#ifdef EF_ENV_USING_TXN
+/* the transaction buffer size, all ENV of one transaction are packed in it then written to one sector */
+#ifndef EF_ENV_TXN_BUF_SIZE
+#define EF_ENV_TXN_BUF_SIZE                      1024
+#endif
+#endif /* EF_ENV_USING_TXN */
+
+#ifdef EF_ENV_USING_INCREMENTAL_GC
+/* the background GC works when the free space for new ENV is less than it */
+#ifndef EF_ENV_GC_RESERVE_SIZE
+#define EF_ENV_GC_RESERVE_SIZE                   (EF_ERASE_MIN_SIZE / 8)
+#endif
+#endif /* EF_ENV_USING_INCREMENTAL_GC */
+
 /* the sector is not combined value */
 #define SECTOR_NOT_COMBINED                      0xFFFFFFFF
 /* the next address is get failed */
@@ -130,6 +158,10 @@
 #define ENV_NAME_LEN_OFFSET                      ((unsigned long)(&((struct env_hdr_data *)0)->name_len))
 
 #define VER_NUM_ENV_NAME                         "__ver_num__"
+/* the transaction commit record, it's value is the committed ENV address range */
+#define TXN_ENV_NAME                             "__txn_commit__"
+#define TXN_RECORD_SIZE                          (ENV_HDR_DATA_SIZE + EF_WG_ALIGN(sizeof(TXN_ENV_NAME) - 1) \
+                                                 + EF_WG_ALIGN(2 * sizeof(uint32_t)))
 
 enum sector_store_status {
     SECTOR_STORE_UNUSED,
@@ -197,7 +229,14 @@ struct sector_cache_node {
 };
 typedef struct sector_cache_node *sector_cache_node_t;
 
+struct env_index_node {
+    uint32_t name_crc;                           /**< ENV name's CRC32 value */
+    uint32_t addr;                               /**< ENV node address, FAILED_ADDR: empty slot */
+};
+typedef struct env_index_node *env_index_node_t;
+
 static void gc_collect(void);
+static EfErrCode read_env(env_node_obj_t env);
 
 /* ENV start address in flash */
 static uint32_t env_start_addr = 0;
@@ -219,6 +258,35 @@ struct env_cache_node env_cache_table[EF_ENV_CACHE_TABLE_SIZE] = { 0 };
 struct sector_cache_node sector_cache_table[EF_SECTOR_CACHE_TABLE_SIZE] = { 0 };
 #endif /* EF_ENV_USING_CACHE */
 
+#ifdef EF_ENV_USING_INDEX
+/* ENV index table, open addressing hash table of all ENV_WRITE status ENV */
+static struct env_index_node env_index_table[EF_ENV_INDEX_SIZE];
+/* the used slot number of ENV index table */
+static size_t env_index_used = 0;
+/* the ENV index has all ENV, it's built on ENV loading */
+static bool env_index_ok = false;
+/* the ENV index is overflowed, it will be disabled until next loading */
+static bool env_index_full = false;
+#endif /* EF_ENV_USING_INDEX */
+
+#ifdef EF_ENV_USING_TXN
+/* the packed ENV nodes and commit record of current transaction, it's same as on flash */
+static uint32_t txn_buf[(EF_ENV_TXN_BUF_SIZE + TXN_RECORD_SIZE + 3) / 4];
+/* the used size of transaction buffer */
+static size_t txn_len = 0;
+/* the transaction is began */
+static bool txn_active = false;
+/* the first error of current transaction */
+static EfErrCode txn_result = EF_NO_ERR;
+#endif /* EF_ENV_USING_TXN */
+
+#ifdef EF_ENV_USING_INCREMENTAL_GC
+/* the GC statistics */
+static struct env_gc_stats gc_stats = { 0 };
+/* the background GC checks the sectors, it's set after an ENV is deleted */
+static bool gc_bg_check = true;
+#endif /* EF_ENV_USING_INCREMENTAL_GC */
+
 static size_t set_status(uint8_t status_table[], size_t status_num, size_t status_index)
 {
     size_t byte_index = ~0UL;
@@ -419,6 +487,126 @@ static bool get_env_from_cache(const char *name, size_t name_len, uint32_t *addr
 }
 #endif /* EF_ENV_USING_CACHE */
 
+#ifdef EF_ENV_USING_INDEX
+static void reset_env_index(void)
+{
+    size_t i;
+
+    for (i = 0; i < EF_ENV_INDEX_SIZE; i++) {
+        env_index_table[i].addr = FAILED_ADDR;
+    }
+    env_index_used = 0;
+    env_index_ok = false;
+    env_index_full = false;
+}
+
+/*
+ * Check the ENV name which is saved on flash
+ */
+static bool env_name_is_same(uint32_t addr, const char *name, size_t name_len)
+{
+    struct env_hdr_data env_hdr;
+    char saved_name[EF_ENV_NAME_MAX];
+
+    ef_port_read(addr, (uint32_t *) &env_hdr, sizeof(struct env_hdr_data));
+    if (env_hdr.name_len != name_len) {
+        return false;
+    }
+    ef_port_read(addr + ENV_HDR_DATA_SIZE, (uint32_t *) saved_name, EF_WG_ALIGN(name_len));
+
+    return !strncmp(name, saved_name, name_len);
+}
+
+/*
+ * Add or update the ENV address in index. Using linear probing.
+ */
+static void update_env_index(const char *name, size_t name_len, uint32_t addr)
+{
+    uint32_t name_crc = ef_calc_crc32(0, name, name_len);
+    size_t i;
+
+    if (env_index_full) {
+        return;
+    }
+
+    for (i = name_crc & ENV_INDEX_MASK; env_index_table[i].addr != FAILED_ADDR; i = (i + 1) & ENV_INDEX_MASK) {
+        if (env_index_table[i].name_crc == name_crc && (env_index_table[i].addr == addr
+                || env_name_is_same(env_index_table[i].addr, name, name_len))) {
+            env_index_table[i].addr = addr;
+            return;
+        }
+    }
+    if (env_index_used >= ENV_INDEX_MAX_USED) {
+        EF_INFO("Warning: The ENV index is full (%d slots). It's disabled now, please increase EF_ENV_INDEX_SIZE.\n",
+                EF_ENV_INDEX_SIZE);
+        env_index_full = true;
+        env_index_ok = false;
+        return;
+    }
+    env_index_table[i].name_crc = name_crc;
+    env_index_table[i].addr = addr;
+    env_index_used++;
+}
+
+/*
+ * Delete the ENV from index. Only the slot which has same address is deleted,
+ * so the ENV which is already moved or recreated in other address is kept.
+ */
+static void delete_env_index(const char *name, size_t name_len, uint32_t addr)
+{
+    uint32_t name_crc = ef_calc_crc32(0, name, name_len);
+    size_t i, j, home;
+
+    for (i = name_crc & ENV_INDEX_MASK; env_index_table[i].addr != FAILED_ADDR; i = (i + 1) & ENV_INDEX_MASK) {
+        if (env_index_table[i].name_crc == name_crc && env_index_table[i].addr == addr) {
+            /* shift back the following slots to fill the hole, the probe sequences keep no break */
+            for (j = (i + 1) & ENV_INDEX_MASK; env_index_table[j].addr != FAILED_ADDR; j = (j + 1) & ENV_INDEX_MASK) {
+                home = env_index_table[j].name_crc & ENV_INDEX_MASK;
+                /* the slot j can be moved when its home slot is not in (i, j] */
+                if (((j - home) & ENV_INDEX_MASK) >= ((j - i) & ENV_INDEX_MASK)) {
+                    env_index_table[i] = env_index_table[j];
+                    i = j;
+                }
+            }
+            env_index_table[i].addr = FAILED_ADDR;
+            env_index_used--;
+            return;
+        }
+    }
+}
+
+/*
+ * Find ENV by index. It's NOT need scan the flash, the missed ENV is not exist.
+ */
+static bool find_env_by_index(const char *key, size_t key_len, env_node_obj_t env)
+{
+    uint32_t name_crc = ef_calc_crc32(0, key, key_len);
+    size_t i;
+
+    for (i = name_crc & ENV_INDEX_MASK; env_index_table[i].addr != FAILED_ADDR; i = (i + 1) & ENV_INDEX_MASK) {
+        if (env_index_table[i].name_crc == name_crc) {
+            env->addr.start = env_index_table[i].addr;
+            read_env(env);
+            if (env->crc_is_ok && env->status == ENV_WRITE && env->name_len == key_len
+                    && !strncmp(env->name, key, key_len)) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+static bool build_env_index_cb(env_node_obj_t env, void *arg1, void *arg2)
+{
+    if (env->crc_is_ok && env->status == ENV_WRITE) {
+        update_env_index(env->name, env->name_len, env->addr.start);
+    }
+
+    return env_index_full;
+}
+#endif /* EF_ENV_USING_INDEX */
+
 /*
  * find the continue 0xFF flash address to end address
  */
@@ -737,9 +925,17 @@ static bool find_env(const char *key, env_node_obj_t env)
 {
     bool find_ok = false;
 
-#ifdef EF_ENV_USING_CACHE
+#if defined(EF_ENV_USING_CACHE) || defined(EF_ENV_USING_INDEX)
     size_t key_len = strlen(key);
+#endif
 
+#ifdef EF_ENV_USING_INDEX
+    if (env_index_ok) {
+        return find_env_by_index(key, key_len, env);
+    }
+#endif /* EF_ENV_USING_INDEX */
+
+#ifdef EF_ENV_USING_CACHE
     if (get_env_from_cache(key, key_len, &env->addr.start)) {
         read_env(env);
         return true;
@@ -1067,6 +1263,7 @@ static uint32_t alloc_env(sector_meta_data_t sector, size_t env_size)
 static EfErrCode del_env(const char *key, env_node_obj_t old_env, bool complete_del) {
     EfErrCode result = EF_NO_ERR;
     uint32_t dirty_status_addr;
+    struct env_node_obj env;
     static bool last_is_complete_del = false;
 
 #if (ENV_STATUS_TABLE_SIZE >= DIRTY_STATUS_TABLE_SIZE)
@@ -1077,7 +1274,6 @@ static EfErrCode del_env(const char *key, env_node_obj_t old_env, bool complete_
 
     /* need find ENV */
     if (!old_env) {
-        struct env_node_obj env;
         /* find ENV */
         if (find_env(key, &env)) {
             old_env = &env;
@@ -1093,6 +1289,16 @@ static EfErrCode del_env(const char *key, env_node_obj_t old_env, bool complete_
     } else {
         result = write_status(old_env->addr.start, status_table, ENV_STATUS_NUM, ENV_DELETED);
 
+#ifdef EF_ENV_USING_INDEX
+        if (result == EF_NO_ERR) {
+            if (key != NULL) {
+                delete_env_index(key, strlen(key), old_env->addr.start);
+            } else {
+                delete_env_index(old_env->name, old_env->name_len, old_env->addr.start);
+            }
+        }
+#endif /* EF_ENV_USING_INDEX */
+
         if (!last_is_complete_del && result == EF_NO_ERR) {
 #ifdef EF_ENV_USING_CACHE
             /* delete the ENV in flash and cache */
@@ -1109,6 +1315,10 @@ static EfErrCode del_env(const char *key, env_node_obj_t old_env, bool complete_
         last_is_complete_del = false;
     }
 
+#ifdef EF_ENV_USING_INCREMENTAL_GC
+    gc_bg_check = true;
+#endif /* EF_ENV_USING_INCREMENTAL_GC */
+
     dirty_status_addr = EF_ALIGN_DOWN(old_env->addr.start, SECTOR_SIZE) + SECTOR_DIRTY_OFFSET;
     /* read and change the sector dirty status */
     if (result == EF_NO_ERR
@@ -1129,25 +1339,26 @@ static EfErrCode move_env(env_node_obj_t env)
     uint32_t env_addr;
     struct sector_meta_data sector;
 
+    /* alloc the space first, the ENV is kept unchanged when there is no space */
+    if ((env_addr = alloc_env(&sector, env->len)) == FAILED_ADDR) {
+        return EF_ENV_FULL;
+    }
+
     /* prepare to delete the current ENV */
     if (env->status == ENV_WRITE) {
         del_env(NULL, env, false);
     }
 
-    if ((env_addr = alloc_env(&sector, env->len)) != FAILED_ADDR) {
-        if (in_recovery_check) {
-            struct env_node_obj env_bak;
-            char name[EF_ENV_NAME_MAX + 1] = { 0 };
-            strncpy(name, env->name, env->name_len);
-            /* check the ENV in flash is already create success */
-            if (find_env_no_cache(name, &env_bak)) {
-                /* already create success, don't need to duplicate */
-                result = EF_NO_ERR;
-                goto __exit;
-            }
+    if (in_recovery_check) {
+        struct env_node_obj env_bak;
+        char name[EF_ENV_NAME_MAX + 1] = { 0 };
+        strncpy(name, env->name, env->name_len);
+        /* check the ENV in flash is already create success */
+        if (find_env_no_cache(name, &env_bak)) {
+            /* already create success, don't need to duplicate */
+            result = EF_NO_ERR;
+            goto __exit;
         }
-    } else {
-        return EF_ENV_FULL;
     }
     /* start move the ENV */
     {
@@ -1175,6 +1386,10 @@ static EfErrCode move_env(env_node_obj_t env)
                 env_addr + ENV_HDR_DATA_SIZE + EF_WG_ALIGN(env->name_len) + EF_WG_ALIGN(env->value_len));
         update_env_cache(env->name, env->name_len, env_addr);
 #endif /* EF_ENV_USING_CACHE */
+
+#ifdef EF_ENV_USING_INDEX
+        update_env_index(env->name, env->name_len, env_addr);
+#endif /* EF_ENV_USING_INDEX */
     }
 
     EF_DEBUG("Moved the ENV (%.*s) from 0x%08X to 0x%08X.\n", env->name_len, env->name, env->addr.start, env_addr);
@@ -1209,6 +1424,229 @@ static uint32_t new_env_by_kv(sector_meta_data_t sector, size_t key_len, size_t
     return new_env(sector, env_len);
 }
 
+#ifdef EF_ENV_USING_INCREMENTAL_GC
+/* the sector which will be collected and the free space statistics */
+struct gc_victim {
+    uint32_t addr;                               /**< victim sector address, FAILED_ADDR: not found */
+    sector_dirty_status_t dirty;                 /**< victim sector dirty status */
+    size_t garbage;                              /**< deleted ENV size in the victim sector */
+    size_t empty_sec;                            /**< empty sector number */
+    size_t free_size;                            /**< the space for new ENV, the GC empty sectors are excluded */
+};
+
+/*
+ * sum the deleted ENV size in a sector, only the ENV headers are read
+ */
+static size_t gc_sector_garbage(sector_meta_data_t sector)
+{
+    struct env_hdr_data env_hdr;
+    struct env_node_obj env;
+    size_t garbage = 0;
+
+    env.addr.start = FAILED_ADDR;
+    while ((env.addr.start = get_next_env_addr(sector, &env)) != FAILED_ADDR) {
+        ef_port_read(env.addr.start, (uint32_t *) &env_hdr, sizeof(struct env_hdr_data));
+        env.status = (env_status_t) get_status(env_hdr.status_table, ENV_STATUS_NUM);
+        env.len = env_hdr.len;
+        /* same as read_env, an invalid length will find the next ENV by magic word */
+        env.crc_is_ok = !(env.len > SECTOR_SIZE - SECTOR_HDR_DATA_SIZE || env.len < ENV_NAME_LEN_OFFSET);
+        if (!env.crc_is_ok) {
+            env.len = EF_WG_ALIGN(1);
+        }
+        if (env.status != ENV_WRITE && env.status != ENV_PRE_DELETE) {
+            garbage += env.len;
+        }
+    }
+
+    return garbage;
+}
+
+static bool gc_victim_cb(sector_meta_data_t sector, void *arg1, void *arg2)
+{
+    struct gc_victim *victim = arg1;
+    bool *count_garbage = arg2;
+    size_t garbage = 0;
+
+    if (!sector->check_ok) {
+        return false;
+    }
+
+    if (sector->status.store == SECTOR_STORE_EMPTY) {
+        victim->empty_sec++;
+    } else if (sector->status.store == SECTOR_STORE_USING && sector->status.dirty != SECTOR_DIRTY_GC) {
+        victim->free_size += sector->remain;
+    }
+
+    if (sector->status.dirty == SECTOR_DIRTY_GC) {
+        /* the interrupted GC sector is always the first */
+        victim->addr = sector->addr;
+        victim->dirty = SECTOR_DIRTY_GC;
+    } else if (sector->status.dirty == SECTOR_DIRTY_TRUE && victim->dirty != SECTOR_DIRTY_GC) {
+        /* then the sector has the most deleted ENV, or the first dirty sector when the garbage isn't counted */
+        if (*count_garbage) {
+            garbage = gc_sector_garbage(sector);
+        }
+        if (victim->addr == FAILED_ADDR || garbage > victim->garbage) {
+            victim->addr = sector->addr;
+            victim->dirty = SECTOR_DIRTY_TRUE;
+            victim->garbage = garbage;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Find the victim sector. Counting the garbage reads all ENV headers, it's skipped when only the free
+ * space is needed.
+ */
+static void gc_find_victim(struct gc_victim *victim, bool count_garbage)
+{
+    struct sector_meta_data sector;
+
+    memset(victim, 0, sizeof(struct gc_victim));
+    victim->addr = FAILED_ADDR;
+    sector_iterator(&sector, SECTOR_STORE_UNUSED, victim, &count_garbage, gc_victim_cb, true);
+    if (victim->empty_sec > EF_GC_EMPTY_SEC_THRESHOLD) {
+        victim->free_size += (victim->empty_sec - EF_GC_EMPTY_SEC_THRESHOLD) * (SECTOR_SIZE - SECTOR_HDR_DATA_SIZE);
+    }
+}
+
+/*
+ * Move all ENV out of the victim sector then format it.
+ *
+ * @return the sector is formatted
+ */
+static bool gc_collect_sector(uint32_t addr, size_t *moved)
+{
+    struct sector_meta_data sector;
+    struct env_node_obj env;
+    uint8_t status_table[DIRTY_STATUS_TABLE_SIZE];
+    bool gc_request_bak = gc_request, collected = false;
+
+    *moved = 0;
+    read_sector_meta_data(addr, &sector, false);
+    if (sector.status.dirty != SECTOR_DIRTY_GC) {
+        write_status(sector.addr + SECTOR_DIRTY_OFFSET, status_table, SECTOR_DIRTY_STATUS_NUM, SECTOR_DIRTY_GC);
+    }
+    /* the moved ENV can use the GC empty sectors, and never goes to a dirty sector */
+    gc_request = true;
+    env.addr.start = FAILED_ADDR;
+    while ((env.addr.start = get_next_env_addr(&sector, &env)) != FAILED_ADDR) {
+        read_env(&env);
+        if (env.crc_is_ok && (env.status == ENV_WRITE || env.status == ENV_PRE_DELETE)) {
+            if (move_env(&env) != EF_NO_ERR) {
+                EF_INFO("Error: Moved the ENV (%.*s) for GC failed.\n", env.name_len, env.name);
+                goto __exit;
+            }
+            *moved += env.len;
+            gc_stats.moved_env++;
+        }
+    }
+    collected = format_sector(sector.addr, SECTOR_NOT_COMBINED) == EF_NO_ERR;
+    EF_DEBUG("Collect a sector @0x%08X\n", sector.addr);
+
+__exit:
+    gc_stats.moved_size += *moved;
+    gc_request = gc_request_bak;
+
+    return collected;
+}
+
+/*
+ * The GC will be triggered on the following scene:
+ * 1. alloc an ENV when the flash not has enough space
+ * 2. write an ENV then the flash not has enough space
+ *
+ * It only collects the sectors until there is a free empty sector, the others are left to ef_env_gc_step.
+ */
+static void gc_collect(void)
+{
+    struct gc_victim victim;
+    size_t moved;
+
+    for (gc_find_victim(&victim, true); victim.empty_sec <= EF_GC_EMPTY_SEC_THRESHOLD;
+            gc_find_victim(&victim, true)) {
+        EF_DEBUG("The remain empty sector is %d, GC threshold is %d.\n", victim.empty_sec, EF_GC_EMPTY_SEC_THRESHOLD);
+        if (victim.addr == FAILED_ADDR || !gc_collect_sector(victim.addr, &moved)) {
+            break;
+        }
+        gc_stats.fg_collected++;
+    }
+
+    gc_request = false;
+}
+
+/**
+ * Do one step of the background GC. It should be called by a low priority thread, not the idle hook,
+ * the step waits for the ENV lock. The port's lock should inherit the priority (e.g. a mutex), otherwise
+ * a high priority ENV saving may wait for the GC thread as long as the middle priority threads run.
+ * A step collects one sector at most, so the ENV lock is held for one sector moving and erasing.
+ * The GC works when the free space is less than EF_ENV_GC_RESERVE_SIZE, so the ENV saving doesn't
+ * wait for a GC in most cases.
+ *
+ * @return true: there is more GC work, please call it again soon
+ */
+bool ef_env_gc_step(void)
+{
+    struct gc_victim victim;
+    size_t moved = 0;
+    bool collected, more = false;
+
+    if (!init_ok) {
+        return false;
+    }
+
+    /* lock the ENV cache */
+    ef_port_env_lock();
+
+    if (!gc_bg_check) {
+        goto __exit;
+    }
+    gc_find_victim(&victim, false);
+    /* the garbage is counted when the reserve is used, most deletes don't need it */
+    if (victim.dirty != SECTOR_DIRTY_GC && victim.free_size < EF_ENV_GC_RESERVE_SIZE) {
+        gc_find_victim(&victim, true);
+    }
+    /* resume the interrupted GC, or collect a sector when the reserve is used and it's worth to collect */
+    if (victim.addr != FAILED_ADDR && (victim.dirty == SECTOR_DIRTY_GC || (victim.free_size < EF_ENV_GC_RESERVE_SIZE
+            && victim.garbage >= EF_ENV_GC_RESERVE_SIZE / 2 && victim.empty_sec >= EF_GC_EMPTY_SEC_THRESHOLD))) {
+        gc_stats.step++;
+        collected = gc_collect_sector(victim.addr, &moved);
+        if (collected) {
+            gc_stats.collected++;
+        }
+        if (moved > gc_stats.step_max_size) {
+            gc_stats.step_max_size = moved;
+        }
+        more = collected;
+    }
+    /* nothing to do or the GC is failed, wait for next ENV deleting */
+    if (!more) {
+        gc_bg_check = false;
+    }
+
+__exit:
+    /* unlock the ENV cache */
+    ef_port_env_unlock();
+
+    return more;
+}
+
+/**
+ * Get the GC statistics.
+ *
+ * @param stats the statistics
+ */
+void ef_env_get_gc_stats(env_gc_stats_t stats)
+{
+    EF_ASSERT(stats);
+
+    ef_port_env_lock();
+    *stats = gc_stats;
+    ef_port_env_unlock();
+}
+#else
 static bool gc_check_cb(sector_meta_data_t sector, void *arg1, void *arg2)
 {
     size_t *empty_sec = arg1;
@@ -1268,6 +1706,7 @@ static void gc_collect(void)
 
     gc_request = false;
 }
+#endif /* EF_ENV_USING_INCREMENTAL_GC */
 
 static EfErrCode align_write(uint32_t addr, const uint32_t *buf, size_t size)
 {
@@ -1353,6 +1792,10 @@ static EfErrCode create_env_blob(sector_meta_data_t sector, const char *key, con
             }
             update_env_cache(key, env_hdr.name_len, env_addr);
 #endif /* EF_ENV_USING_CACHE */
+
+#ifdef EF_ENV_USING_INDEX
+            update_env_index(key, env_hdr.name_len, env_addr);
+#endif /* EF_ENV_USING_INDEX */
         }
         /* write value */
         if (result == EF_NO_ERR) {
@@ -1365,8 +1808,13 @@ static EfErrCode create_env_blob(sector_meta_data_t sector, const char *key, con
         }
         /* trigger GC collect when current sector is full */
         if (result == EF_NO_ERR && is_full) {
+#ifdef EF_ENV_USING_INCREMENTAL_GC
+            /* it's left to the background GC, the ENV saving only collects when the alloc is failed */
+            gc_bg_check = true;
+#else
             EF_DEBUG("Trigger a GC check after created ENV.\n");
             gc_request = true;
+#endif /* EF_ENV_USING_INCREMENTAL_GC */
         }
     } else {
         result = EF_ENV_FULL;
@@ -1514,6 +1962,254 @@ EfErrCode ef_set_and_save_env(const char *key, const char *value)
     return ef_set_env_blob(key, value, strlen(value));
 }
 
+#ifdef EF_ENV_USING_TXN
+/*
+ * Finish the committed ENV nodes in [start, end): delete the old ENV then change the new to ENV_WRITE.
+ * It's also used to roll forward the committed transaction when recovery.
+ */
+static void txn_apply(uint32_t start, uint32_t end)
+{
+    struct env_hdr_data env_hdr;
+    struct env_node_obj old_env;
+    uint32_t addr;
+    char name[EF_ENV_NAME_MAX + 1];
+
+    for (addr = start; addr < end; addr += env_hdr.len) {
+        /* all nodes are written completely before commit, so only the header and name are read */
+        ef_port_read(addr, (uint32_t *) &env_hdr, sizeof(struct env_hdr_data));
+        if (env_hdr.len < ENV_HDR_DATA_SIZE || env_hdr.len > end - addr || env_hdr.name_len > EF_ENV_NAME_MAX) {
+            EF_INFO("Error: The ENV @0x%08X in transaction has an error.\n", addr);
+            break;
+        }
+        if (get_status(env_hdr.status_table, ENV_STATUS_NUM) != ENV_PRE_WRITE) {
+            continue;
+        }
+        ef_port_read(addr + ENV_HDR_DATA_SIZE, (uint32_t *) name, EF_WG_ALIGN(env_hdr.name_len));
+        name[env_hdr.name_len] = '\0';
+        if (find_env(name, &old_env)) {
+            del_env(name, &old_env, true);
+        }
+        write_status(addr, env_hdr.status_table, ENV_STATUS_NUM, ENV_WRITE);
+
+#ifdef EF_ENV_USING_CACHE
+        update_env_cache(name, env_hdr.name_len, addr);
+#endif /* EF_ENV_USING_CACHE */
+
+#ifdef EF_ENV_USING_INDEX
+        update_env_index(name, env_hdr.name_len, addr);
+#endif /* EF_ENV_USING_INDEX */
+    }
+}
+
+/*
+ * Pack an ENV node to the transaction buffer, the status is ENV_PRE_WRITE.
+ */
+static void txn_pack_env(const char *key, const void *value, size_t len)
+{
+    struct env_hdr_data env_hdr;
+    uint8_t *node = (uint8_t *) txn_buf + txn_len;
+
+    memset(&env_hdr, 0xFF, sizeof(struct env_hdr_data));
+    set_status(env_hdr.status_table, ENV_STATUS_NUM, ENV_PRE_WRITE);
+    env_hdr.magic = ENV_MAGIC_WORD;
+    env_hdr.name_len = strlen(key);
+    env_hdr.value_len = len;
+    env_hdr.len = ENV_HDR_DATA_SIZE + EF_WG_ALIGN(env_hdr.name_len) + EF_WG_ALIGN(env_hdr.value_len);
+
+    memset(node, 0xFF, env_hdr.len);
+    memcpy(node, &env_hdr, sizeof(struct env_hdr_data));
+    memcpy(node + ENV_HDR_DATA_SIZE, key, env_hdr.name_len);
+    memcpy(node + ENV_HDR_DATA_SIZE + EF_WG_ALIGN(env_hdr.name_len), value, len);
+    /* the CRC32 is calculated as same as the flash node, the node in buffer may be not aligned */
+    env_hdr.crc32 = ef_calc_crc32(0, node + ENV_NAME_LEN_OFFSET, env_hdr.len - ENV_NAME_LEN_OFFSET);
+    memcpy(node, &env_hdr, sizeof(struct env_hdr_data));
+
+    txn_len += env_hdr.len;
+}
+
+/*
+ * Remove the packed ENV which has same name from the transaction buffer.
+ */
+static void txn_unpack_env(const char *key)
+{
+    struct env_hdr_data env_hdr;
+    uint8_t *node;
+    size_t offset, name_len = strlen(key);
+
+    for (offset = 0; offset < txn_len; offset += env_hdr.len) {
+        node = (uint8_t *) txn_buf + offset;
+        memcpy(&env_hdr, node, sizeof(struct env_hdr_data));
+        if (env_hdr.name_len == name_len && !strncmp((char *) node + ENV_HDR_DATA_SIZE, key, name_len)) {
+            memmove(node, node + env_hdr.len, txn_len - offset - env_hdr.len);
+            txn_len -= env_hdr.len;
+            return;
+        }
+    }
+}
+
+/**
+ * Begin an ENV transaction. The ENV is locked until it's committed or aborted.
+ *
+ * @return result
+ */
+EfErrCode ef_env_txn_begin(void)
+{
+    if (!init_ok) {
+        EF_INFO("ENV isn't initialize OK.\n");
+        return EF_ENV_INIT_FAILED;
+    }
+
+    /* lock the ENV cache */
+    ef_port_env_lock();
+
+    EF_ASSERT(!txn_active);
+    txn_active = true;
+    txn_len = 0;
+    txn_result = EF_NO_ERR;
+
+    return EF_NO_ERR;
+}
+
+/**
+ * Set a blob ENV in current transaction. It's saved on commit.
+ * The set failed transaction will not be committed.
+ *
+ * @param key ENV name
+ * @param value ENV value, it can't be NULL
+ * @param len ENV value length
+ *
+ * @return result
+ */
+EfErrCode ef_env_txn_set(const char *key, const void *value_buf, size_t buf_len)
+{
+    EfErrCode result = EF_NO_ERR;
+
+    EF_ASSERT(txn_active);
+
+    if (strlen(key) > EF_ENV_NAME_MAX || value_buf == NULL) {
+        EF_INFO("Error: The ENV name length is more than %d or value is NULL\n", EF_ENV_NAME_MAX);
+        result = EF_ENV_NAME_ERR;
+    } else {
+        /* the last set is valid */
+        txn_unpack_env(key);
+        if (txn_len + ENV_HDR_DATA_SIZE + EF_WG_ALIGN(strlen(key)) + EF_WG_ALIGN(buf_len) > EF_ENV_TXN_BUF_SIZE) {
+            EF_INFO("Error: The ENV transaction buffer is full (%d bytes).\n", EF_ENV_TXN_BUF_SIZE);
+            result = EF_ENV_FULL;
+        } else {
+            txn_pack_env(key, value_buf, buf_len);
+        }
+    }
+    if (txn_result == EF_NO_ERR) {
+        txn_result = result;
+    }
+
+    return result;
+}
+
+/**
+ * Commit current transaction. All ENV are written to one sector by one flash write,
+ * then the commit record is changed to ENV_WRITE. The ENV are all saved or all not
+ * saved when power down. The GC runs once at most.
+ *
+ * @return result
+ */
+EfErrCode ef_env_txn_commit(void)
+{
+    EfErrCode result = txn_result;
+    struct sector_meta_data sector;
+    struct env_node_obj txn_env;
+    uint8_t status_table[ENV_STATUS_TABLE_SIZE];
+    uint32_t txn_addr, range[2];
+    size_t total_len;
+    bool is_full = false, already_gc = false;
+
+    EF_ASSERT(txn_active);
+
+    if (result != EF_NO_ERR || txn_len == 0) {
+        goto __exit;
+    }
+
+    total_len = txn_len + TXN_RECORD_SIZE;
+    if (total_len > SECTOR_SIZE - SECTOR_HDR_DATA_SIZE) {
+        EF_INFO("Error: The ENV transaction is too big\n");
+        result = EF_ENV_FULL;
+        goto __exit;
+    }
+    /* alloc the space for all ENV and the commit record, it's the only GC chance before writing */
+    if ((txn_addr = alloc_env(&sector, total_len)) == FAILED_ADDR && gc_request) {
+        gc_collect();
+        already_gc = true;
+        txn_addr = alloc_env(&sector, total_len);
+    }
+    if (txn_addr == FAILED_ADDR) {
+        result = EF_ENV_FULL;
+        goto __exit;
+    }
+    /* pack the commit record behind all ENV */
+    range[0] = txn_addr;
+    range[1] = txn_addr + txn_len;
+    txn_pack_env(TXN_ENV_NAME, range, sizeof(range));
+    result = update_sec_status(&sector, total_len, &is_full);
+    /* write all ENV and the commit record */
+    if (result == EF_NO_ERR) {
+        result = ef_port_write(txn_addr, txn_buf, txn_len);
+    }
+
+#ifdef EF_ENV_USING_CACHE
+    if (!is_full) {
+        update_sector_cache(sector.addr, txn_addr + txn_len);
+    }
+#endif /* EF_ENV_USING_CACHE */
+
+    /* commit: change the commit record to ENV_WRITE */
+    if (result == EF_NO_ERR) {
+        result = write_status(range[1], status_table, ENV_STATUS_NUM, ENV_WRITE);
+    }
+    if (result == EF_NO_ERR) {
+        txn_apply(range[0], range[1]);
+        /* the commit record is useless now */
+        txn_env.addr.start = range[1];
+        read_env(&txn_env);
+        del_env(NULL, &txn_env, true);
+        /* trigger GC collect when current sector is full */
+        if (is_full) {
+#ifdef EF_ENV_USING_INCREMENTAL_GC
+            gc_bg_check = true;
+#else
+            gc_request = true;
+#endif /* EF_ENV_USING_INCREMENTAL_GC */
+        }
+    }
+    /* process the GC after commit, when it isn't done on alloc */
+    if (gc_request && !already_gc) {
+        gc_collect();
+    }
+
+__exit:
+    txn_active = false;
+    txn_len = 0;
+
+    /* unlock the ENV cache */
+    ef_port_env_unlock();
+
+    return result;
+}
+
+/**
+ * Abort current transaction. Nothing is saved.
+ */
+void ef_env_txn_abort(void)
+{
+    EF_ASSERT(txn_active);
+
+    txn_active = false;
+    txn_len = 0;
+
+    /* unlock the ENV cache */
+    ef_port_env_unlock();
+}
+#endif /* EF_ENV_USING_TXN */
+
 /**
  * Save ENV to flash.
  *
@@ -1541,6 +2237,13 @@ EfErrCode ef_env_set_default(void)
 
     /* lock the ENV cache */
     ef_port_env_lock();
+
+#ifdef EF_ENV_USING_INDEX
+    /* all ENV will be recreated, it's still complete after set default */
+    reset_env_index();
+    env_index_ok = true;
+#endif /* EF_ENV_USING_INDEX */
+
     /* format all sectors */
     for (addr = env_start_addr; addr < env_start_addr + ENV_AREA_SIZE; addr += SECTOR_SIZE) {
         result = format_sector(addr, SECTOR_NOT_COMBINED);
@@ -1640,6 +2343,15 @@ void ef_print_env(void)
     ef_print("\nmode: next generation\n");
     ef_print("size: %lu/%lu bytes.\n", using_size + (SECTOR_NUM - EF_GC_EMPTY_SEC_THRESHOLD) * SECTOR_HDR_DATA_SIZE,
             ENV_AREA_SIZE - SECTOR_SIZE * EF_GC_EMPTY_SEC_THRESHOLD);
+#ifdef EF_ENV_USING_INDEX
+    ef_print("index: %lu/%lu slots, %s.\n", (unsigned long) env_index_used, (unsigned long) EF_ENV_INDEX_SIZE,
+            env_index_ok ? "enabled" : "disabled");
+#endif
+#ifdef EF_ENV_USING_INCREMENTAL_GC
+    ef_print("GC: %lu steps, %lu/%lu sectors collected by background/saving, %lu ENV (%lu bytes) moved.\n",
+            (unsigned long) gc_stats.step, (unsigned long) gc_stats.collected, (unsigned long) gc_stats.fg_collected,
+            (unsigned long) gc_stats.moved_env, (unsigned long) gc_stats.moved_size);
+#endif
 
     /* unlock the ENV cache */
     ef_port_env_unlock();
@@ -1709,8 +2421,29 @@ static bool check_and_recovery_gc_cb(sector_meta_data_t sector, void *arg1, void
     return false;
 }
 
+#ifdef EF_ENV_USING_TXN
+static bool check_and_recovery_txn_cb(env_node_obj_t env, void *arg1, void *arg2)
+{
+    uint32_t range[2];
+
+    /* the transaction is committed but not finished */
+    if (env->crc_is_ok && env->status == ENV_WRITE && env->name_len == sizeof(TXN_ENV_NAME) - 1
+            && !strncmp(env->name, TXN_ENV_NAME, env->name_len) && env->value_len == sizeof(range)) {
+        EF_INFO("Found an ENV transaction which has committed. Now will finish it.\n");
+        ef_port_read(env->addr.value, range, sizeof(range));
+        txn_apply(range[0], range[1]);
+        del_env(NULL, env, true);
+        return true;
+    }
+
+    return false;
+}
+#endif /* EF_ENV_USING_TXN */
+
 static bool check_and_recovery_env_cb(env_node_obj_t env, void *arg1, void *arg2)
 {
+    bool *interrupted = arg1;
+
     /* recovery the prepare deleted ENV */
     if (env->crc_is_ok && env->status == ENV_PRE_DELETE) {
         EF_INFO("Found an ENV (%.*s) which has changed value failed. Now will recovery it.\n", env->name_len, env->name);
@@ -1719,6 +2452,7 @@ static bool check_and_recovery_env_cb(env_node_obj_t env, void *arg1, void *arg2
             EF_DEBUG("Recovery the ENV successful.\n");
         } else {
             EF_DEBUG("Warning: Moved an ENV (size %d) failed when recovery. Now will GC then retry.\n", env->len);
+            *interrupted = true;
             return true;
         }
     } else if (env->status == ENV_PRE_WRITE) {
@@ -1726,8 +2460,14 @@ static bool check_and_recovery_env_cb(env_node_obj_t env, void *arg1, void *arg2
         /* the ENV has not write finish, change the status to error */
         //TODO 쳣״̬װͼ
         write_status(env->addr.start, status_table, ENV_STATUS_NUM, ENV_ERR_HDR);
-        return true;
+        /* keep on checking, the prepare deleted ENV behind it still needs recovery */
+    }
+#ifdef EF_ENV_USING_INDEX
+    else if (env->crc_is_ok && env->status == ENV_WRITE) {
+        /* build the index in the same scan */
+        update_env_index(env->name, env->name_len, env->addr.start);
     }
+#endif /* EF_ENV_USING_INDEX */
 
     return false;
 }
@@ -1743,6 +2483,7 @@ EfErrCode ef_load_env(void)
     struct env_node_obj env;
     struct sector_meta_data sector;
     size_t check_failed_count = 0;
+    bool interrupted;
 
     in_recovery_check = true;
     /* check all sector header */
@@ -1755,17 +2496,36 @@ EfErrCode ef_load_env(void)
 
     /* lock the ENV cache */
     ef_port_env_lock();
+#ifdef EF_ENV_USING_TXN
+    /* roll forward the committed transaction before any GC, the GC drops the ENV_PRE_WRITE ENV.
+     * The uncommitted ENV will be discarded by recovery check. */
+    env_iterator(&env, NULL, NULL, check_and_recovery_txn_cb);
+#endif
+
     /* check all sector header for recovery GC */
     sector_iterator(&sector, SECTOR_STORE_UNUSED, NULL, NULL, check_and_recovery_gc_cb, false);
 
 __retry:
+#ifdef EF_ENV_USING_INDEX
+    reset_env_index();
+#endif
     /* check all ENV for recovery */
-    env_iterator(&env, NULL, NULL, check_and_recovery_env_cb);
+    interrupted = false;
+    env_iterator(&env, &interrupted, NULL, check_and_recovery_env_cb);
     if (gc_request) {
         gc_collect();
         goto __retry;
     }
 
+#ifdef EF_ENV_USING_INDEX
+    if (interrupted) {
+        /* the recovery check was interrupted, so the index needs a full scan */
+        reset_env_index();
+        env_iterator(&env, NULL, NULL, build_env_index_cb);
+    }
+    env_index_ok = !env_index_full;
+#endif /* EF_ENV_USING_INDEX */
+
     in_recovery_check = false;
 
     /* unlock the ENV cache */
@@ -1811,6 +2571,10 @@ EfErrCode ef_env_init(ef_env const *default_env, size_t default_env_size) {
     }
 #endif /* EF_ENV_USING_CACHE */
 
+#ifdef EF_ENV_USING_INDEX
+    reset_env_index();
+#endif
+
     env_start_addr = EF_START_ADDR;
     default_env_set = default_env;
     default_env_set_size = default_env_size;
@@ -278,6 +278,8 @@
 #define PKG_WEBCLIENT_VER_NUM 0x99999
 #define PKG_USING_NETUTILS
 #define PKG_NETUTILS_TFTP
+#define PKG_NETUTILS_TFTP_BLKSIZE_MAX 1468
+#define PKG_NETUTILS_TFTP_WINDOWSIZE 8
 #define PKG_NETUTILS_IPERF
 #define IPERF_THREAD_STACK_SIZE 2048
 #define PKG_NETUTILS_NETIO
@@ -289,9 +291,16 @@
 #define NETUTILS_NTP_HOSTNAME2 "ntp.rt-thread.org"
 #define NETUTILS_NTP_HOSTNAME3 "edu.ntp.org.cn"
 #define PKG_NETUTILS_TELNET
+#define PKG_NETUTILS_TELNET_MAX_SESSIONS 2
+#define PKG_NETUTILS_TELNET_TX_BUFFER_SIZE 4096
+#define PKG_NETUTILS_TELNET_FLUSH_SIZE 1024
+#define PKG_NETUTILS_TELNET_FLUSH_TIMEOUT 20
 #define PKG_NETUTILS_TCPDUMP
 #define PKG_NETUTILS_TCPDUMP_PRINT
 #define PKG_NETUTILS_TCPDUMP_DBG
+#define PKG_NETUTILS_TCPDUMP_RING_SLOTS 16
+#define PKG_NETUTILS_TCPDUMP_SLOT_SIZE 1536
+#define PKG_NETUTILS_TCPDUMP_TCP_PORT 2000
 #define PKG_USING_NETUTILS_LATEST_VERSION
 #define PKG_NETUTILS_VER_NUM 0x99999
 
@@ -327,6 +336,12 @@
 
 #define PKG_USING_EASYFLASH
 #define PKG_EASYFLASH_ENV
+#define PKG_EASYFLASH_ENV_USING_INDEX
+#define PKG_EASYFLASH_ENV_INDEX_SIZE 64
+#define PKG_EASYFLASH_ENV_USING_TXN
+#define PKG_EASYFLASH_ENV_TXN_BUF_SIZE 1024
+#define PKG_EASYFLASH_ENV_USING_INCREMENTAL_GC
+#define PKG_EASYFLASH_ENV_GC_RESERVE_SIZE 512
 #define PKG_EASYFLASH_ERASE_GRAN 4096
 #define PKG_EASYFLASH_WRITE_GRAN_8BITS
 #define PKG_EASYFLASH_WRITE_GRAN 8
@@ -0,0 +1,57 @@
+# -*- coding: UTF-8 -*-
+
+# Copyright (c) 2006-2024 Evlers Developers
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+# Change Logs:
+# Date           Author       Notes
+# 2024-10-28     Evlers       first implementation
+
+# Make a pair of firmware-like images for test_ota_patch: the new image is the old one with
+# a few changed words, an inserted and a removed block and a longer tail, like a rebuild after a small change.
+#
+# Usage:
+#   python ota_images.py build/ota
+
+import os
+import random
+import struct
+import sys
+
+
+def firmware(rng, size):
+    # the code is made of a small set of instruction words, the data has strings and tables
+    words = [rng.getrandbits(32) for _ in range(256)]
+    out = bytearray()
+    while len(out) < size:
+        kind = rng.random()
+        if kind < 0.7:
+            out += struct.pack('<I', words[int(rng.expovariate(0.05)) % len(words)])
+        elif kind < 0.8:
+            out += b'rt_thread_%04d: %s\0' % (rng.randrange(10000), rng.choice([b'ok', b'failed', b'timeout']))
+        else:
+            out += bytes(rng.getrandbits(8) for _ in range(rng.randrange(1, 16)))
+    return out[:size]
+
+
+def main():
+    rng = random.Random(2024)
+    old = firmware(rng, 48 * 1024)
+
+    new = bytearray(old)
+    # the addresses after a changed function move by a few bytes
+    for pos in range(0x400, 0x800, 64):
+        new[pos] = (new[pos] + 8) & 0xFF
+    new[20000:20000] = firmware(rng, 300)
+    del new[30000:30500]
+    new += firmware(rng, 2048)
+
+    os.makedirs(sys.argv[1], exist_ok=True)
+    for name, data in (('old.bin', old), ('new.bin', new)):
+        with open(os.path.join(sys.argv[1], name), 'wb') as f:
+            f.write(data)
+
+
+if __name__ == '__main__':
+    main()
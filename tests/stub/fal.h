@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+/* the partition api of the fal used by the modules under the host tests, a test implements the access */
+
+#ifndef _FAL_H_
+#define _FAL_H_
+
+#include <rtthread.h>
+
+#define FAL_DEV_NAME_MAX        24
+
+struct fal_partition
+{
+    rt_uint32_t magic_word;
+    char name[FAL_DEV_NAME_MAX];
+    char flash_name[FAL_DEV_NAME_MAX];
+    long offset;
+    size_t len;
+    rt_uint32_t reserved;
+};
+
+int fal_partition_read(const struct fal_partition *part, rt_uint32_t addr, rt_uint8_t *buf, size_t size);
+
+#endif /* _FAL_H_ */
@@ -0,0 +1,14 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+#ifndef _LWIP_DNS_H_
+#define _LWIP_DNS_H_
+
+#endif /* _LWIP_DNS_H_ */
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+/* the lwip netif and pbuf as tcpdump and ppp_device use them */
+
+#ifndef _ETHERNETIF_H_
+#define _ETHERNETIF_H_
+
+#include <rtthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+typedef signed char err_t;
+
+struct pbuf
+{
+    struct pbuf *next;
+    void *payload;
+    rt_uint16_t tot_len;
+    rt_uint16_t len;
+};
+
+struct netif;
+typedef err_t (*netif_linkoutput_fn)(struct netif *netif, struct pbuf *p);
+typedef err_t (*netif_input_fn)(struct pbuf *p, struct netif *inp);
+
+struct netif
+{
+    netif_linkoutput_fn linkoutput;
+    netif_input_fn input;
+    rt_uint16_t mtu;
+    char name[2];
+};
+
+struct eth_device
+{
+    struct rt_device parent;
+    struct netif *netif;
+};
+
+rt_uint16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, rt_uint16_t len, rt_uint16_t offset);
+
+#define IPADDR_NONE             ((rt_uint32_t)0xffffffffUL)
+#define closesocket             close
+
+#endif /* _ETHERNETIF_H_ */
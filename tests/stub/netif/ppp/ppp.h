@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+/* the lwip ppp api as ppp_device uses it, the test implements the functions */
+
+#ifndef _PPP_H_
+#define _PPP_H_
+
+#include <lwip/netif.h>
+
+typedef uint8_t                 u8_t;
+typedef uint32_t                u32_t;
+
+#define ERR_OK                  0
+#define ERR_MEM                 -1
+
+#define PPPERR_NONE             0
+#define PPPERR_PARAM            1
+#define PPPERR_OPEN             2
+#define PPPERR_DEVICE           3
+#define PPPERR_ALLOC            4
+#define PPPERR_USER             5
+#define PPPERR_CONNECT          6
+#define PPPERR_AUTHFAIL         7
+#define PPPERR_PROTOCOL         8
+#define PPPERR_PEERDEAD         9
+#define PPPERR_IDLETIMEOUT      10
+#define PPPERR_CONNECTTIME      11
+#define PPPERR_LOOPBACK         12
+
+typedef struct ppp_pcb_s
+{
+    struct netif *netif;
+    void *ctx;
+} ppp_pcb;
+
+typedef u32_t (*pppos_output_cb_fn)(ppp_pcb *pcb, u8_t *data, u32_t len, void *ctx);
+typedef void (*ppp_link_status_cb_fn)(ppp_pcb *pcb, int err_code, void *ctx);
+
+#define ppp_netif(ppp)              ((ppp)->netif)
+#define ppp_set_usepeerdns(ppp, b)  ((void)(ppp), (void)(b))
+
+err_t ppp_free(ppp_pcb *pcb);
+
+#endif /* _PPP_H_ */
@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+#ifndef _PPPAPI_H_
+#define _PPPAPI_H_
+
+#include <netif/ppp/ppp.h>
+
+ppp_pcb *pppapi_pppos_create(struct netif *pppif, pppos_output_cb_fn output_cb,
+                             ppp_link_status_cb_fn link_status_cb, void *ctx_cb);
+err_t pppapi_set_default(ppp_pcb *pcb);
+err_t pppapi_connect(ppp_pcb *pcb, rt_uint16_t holdoff);
+err_t pppapi_close(ppp_pcb *pcb, rt_uint8_t nocarrier);
+
+#endif /* _PPPAPI_H_ */
@@ -0,0 +1,18 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+#ifndef _PPPOS_H_
+#define _PPPOS_H_
+
+#include <netif/ppp/ppp.h>
+
+err_t pppos_input_tcpip(ppp_pcb *ppp, u8_t *s, int l);
+
+#endif /* _PPPOS_H_ */
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+#ifndef __NOPOLL_CONFIG_H__
+#define __NOPOLL_CONFIG_H__
+
+/*
+ * The host configuration of nopoll for the tests, found before the rt-thread one of the package.
+ * The unix port with openssl, nopoll_private.h includes openssl under NOPLL_TLS and the code checks NOPOLL_TLS.
+ */
+#include <stdint.h>
+
+#define INT_TO_PTR(integer) ((noPollPtr) (intptr_t) (integer))
+#define PTR_TO_INT(ptr) ((int) (intptr_t) (ptr))
+
+#define NOPOLL_OS_UNIX (1)
+#define NOPOLL_HAVE_VASPRINTF (1)
+#define NOPOLL_64BIT_PLATFORM (1)
+
+#define NOPLL_TLS             (1)
+#define NOPOLL_TLS            (1)
+#define NOPLL_IPV6            (0)
+
+#define NOPOLL_HAVE_SSLv23_ENABLED (1)
+#define NOPOLL_HAVE_TLSv10_ENABLED (1)
+#define NOPOLL_HAVE_TLSv11_ENABLED (1)
+#define NOPOLL_HAVE_TLSv12_ENABLED (1)
+
+#endif
@@ -0,0 +1,2 @@
+/* the posix string.h of the rt-thread libc is the one of the host */
+#include <string.h>
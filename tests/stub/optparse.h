@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+#ifndef _OPTPARSE_H_
+#define _OPTPARSE_H_
+
+struct optparse
+{
+    char **argv;
+    int permute;
+    int optind;
+    int optopt;
+    char *optarg;
+    char errmsg[64];
+    int subopt;
+};
+
+void optparse_init(struct optparse *options, char **argv);
+int optparse(struct optparse *options, const char *optstring);
+
+#endif /* _OPTPARSE_H_ */
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+#include <stdlib.h>
+
+#include "ramdisk.h"
+
+static rt_bool_t ramdisk_covers(rt_off_t block, rt_off_t pos, rt_size_t count)
+{
+    return block >= pos && block < pos + (rt_off_t)count;
+}
+
+static rt_ssize_t ramdisk_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t count)
+{
+    struct ramdisk *disk = (struct ramdisk *)dev;
+
+    if (disk->access)
+        disk->access(disk, 0, pos, count);
+    disk->reads++;
+
+    if (pos < 0 || pos + count > disk->block_count || ramdisk_covers(disk->fail_read, pos, count))
+        return 0;
+
+    memcpy(buffer, disk->data + pos * disk->block_size, count * disk->block_size);
+    return count;
+}
+
+static rt_ssize_t ramdisk_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t count)
+{
+    struct ramdisk *disk = (struct ramdisk *)dev;
+
+    if (disk->access)
+        disk->access(disk, 1, pos, count);
+    disk->writes++;
+
+    if (pos < 0 || pos + count > disk->block_count || ramdisk_covers(disk->fail_write, pos, count))
+        return 0;
+
+    memcpy(disk->data + pos * disk->block_size, buffer, count * disk->block_size);
+    return count;
+}
+
+static rt_err_t ramdisk_control(rt_device_t dev, int cmd, void *args)
+{
+    struct ramdisk *disk = (struct ramdisk *)dev;
+    struct rt_device_blk_geometry *geometry = args;
+
+    if (cmd != RT_DEVICE_CTRL_BLK_GETGEOME)
+        return -RT_ENOSYS;
+
+    geometry->bytes_per_sector = disk->block_size;
+    geometry->block_size = disk->block_size;
+    geometry->sector_count = disk->block_count;
+    return RT_EOK;
+}
+
+rt_err_t ramdisk_init(struct ramdisk *disk, const char *name, rt_uint32_t block_size, rt_uint32_t block_count)
+{
+    memset(disk, 0, sizeof(*disk));
+    disk->data = calloc(block_count, block_size);
+    if (disk->data == RT_NULL)
+        return -RT_ENOMEM;
+
+    disk->block_size = block_size;
+    disk->block_count = block_count;
+    disk->fail_read = -1;
+    disk->fail_write = -1;
+
+    disk->parent.type = RT_Device_Class_Block;
+    disk->parent.read = ramdisk_read;
+    disk->parent.write = ramdisk_write;
+    disk->parent.control = ramdisk_control;
+
+    return rt_device_register(&disk->parent, name, 0);
+}
+
+void ramdisk_deinit(struct ramdisk *disk)
+{
+    rt_device_unregister(&disk->parent);
+    free(disk->data);
+    disk->data = RT_NULL;
+}
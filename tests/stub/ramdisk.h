@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+/* a block device in the host memory, the tests can make a block fail and watch every access */
+
+#ifndef _RAMDISK_H_
+#define _RAMDISK_H_
+
+#include <rtthread.h>
+#include <rtdevice.h>
+
+struct ramdisk
+{
+    struct rt_device parent;
+
+    rt_uint8_t *data;
+    rt_uint32_t block_size;
+    rt_uint32_t block_count;
+
+    /* an access that covers this block fails, -1 for none */
+    rt_off_t fail_read;
+    rt_off_t fail_write;
+
+    /* called before every access of the media */
+    void (*access)(struct ramdisk *disk, int write, rt_off_t pos, rt_size_t count);
+
+    rt_uint32_t reads;
+    rt_uint32_t writes;
+};
+
+rt_err_t ramdisk_init(struct ramdisk *disk, const char *name, rt_uint32_t block_size, rt_uint32_t block_count);
+void ramdisk_deinit(struct ramdisk *disk);
+
+#endif /* _RAMDISK_H_ */
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+/* the options of the modules under the host tests */
+
+#ifndef RT_CONFIG_H__
+#define RT_CONFIG_H__
+
+#define PKG_NETUTILS_TCPDUMP
+#define PKG_NETUTILS_TCPDUMP_RING_SLOTS 4
+#define PKG_NETUTILS_TCPDUMP_SLOT_SIZE 256
+
+#define RT_USING_SAL
+#define PKG_USING_WEBCLIENT
+
+#define PKG_OTA_DOWNLOADER_USING_PATCH
+
+#define IPERF_THREAD_STACK_SIZE 2048
+
+#define PKG_USING_PPP_DEVICE
+#define RT_LWIP_TCPTHREAD_STACKSIZE 4096
+
+/* the ENV features of easyflash are enabled by the Makefile */
+#define PKG_USING_EASYFLASH
+#define PKG_EASYFLASH_ENV
+#define PKG_EASYFLASH_ERASE_GRAN 4096
+#define PKG_EASYFLASH_WRITE_GRAN_8BITS
+#define PKG_EASYFLASH_WRITE_GRAN 8
+#define PKG_EASYFLASH_START_ADDR 0
+#define PKG_USING_EASYFLASH_V410
+#define PKG_EASYFLASH_VER_NUM 0x40100
+
+#endif /* RT_CONFIG_H__ */
@@ -0,0 +1,25 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+#ifndef _RTDBG_H_
+#define _RTDBG_H_
+
+#define DBG_ERROR               0
+#define DBG_WARNING             1
+#define DBG_INFO                2
+#define DBG_LOG                 3
+
+#define dbg_log(level, ...)     ((void)(level))
+#define LOG_E(...)              ((void)0)
+#define LOG_W(...)              ((void)0)
+#define LOG_I(...)              ((void)0)
+#define LOG_D(...)              ((void)0)
+
+#endif /* _RTDBG_H_ */
@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+/* the block device part of the rt-thread driver api used by the modules under the host tests */
+
+#ifndef _RTDEVICE_H_
+#define _RTDEVICE_H_
+
+#include <rtthread.h>
+
+#define RT_DEVICE_CTRL_BLK_GETGEOME     0x10
+
+struct rt_device_blk_geometry
+{
+    rt_uint64_t sector_count;
+    rt_uint32_t bytes_per_sector;
+    rt_uint32_t block_size;
+};
+
+#endif /* _RTDEVICE_H_ */
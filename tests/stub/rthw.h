@@ -0,0 +1,16 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+#ifndef _RTHW_H_
+#define _RTHW_H_
+
+#include <rtthread.h>
+
+#endif /* _RTHW_H_ */
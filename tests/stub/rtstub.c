@@ -0,0 +1,342 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+/* the rt-thread functions of stub/rtthread.h on the host, single threaded */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <rtthread.h>
+#include <netif/ethernetif.h>
+#include <optparse.h>
+
+void (*rtstub_mdelay_hook)(rt_int32_t ms);
+
+static rt_tick_t tick;
+
+void rt_assert_failed(const char *expr, const char *file, int line)
+{
+    printf("%s:%d: assertion failed: %s\n", file, line, expr);
+    abort();
+}
+
+int rt_kprintf(const char *fmt, ...)
+{
+    return 0;
+}
+
+int rt_snprintf(char *buf, rt_size_t size, const char *fmt, ...)
+{
+    va_list args;
+    int len;
+
+    va_start(args, fmt);
+    len = vsnprintf(buf, size, fmt, args);
+    va_end(args);
+
+    return len;
+}
+
+int rt_vsnprintf(char *buf, rt_size_t size, const char *fmt, va_list args)
+{
+    return vsnprintf(buf, size, fmt, args);
+}
+
+void *rt_malloc(rt_size_t size)
+{
+    return malloc(size);
+}
+
+void *rt_calloc(rt_size_t count, rt_size_t size)
+{
+    return calloc(count, size);
+}
+
+void *rt_realloc(void *ptr, rt_size_t size)
+{
+    return realloc(ptr, size);
+}
+
+void rt_free(void *ptr)
+{
+    free(ptr);
+}
+
+char *rt_strdup(const char *s)
+{
+    return s ? strdup(s) : RT_NULL;
+}
+
+rt_base_t rt_hw_interrupt_disable(void)
+{
+    return 0;
+}
+
+void rt_hw_interrupt_enable(rt_base_t level)
+{
+}
+
+void rt_enter_critical(void)
+{
+}
+
+void rt_exit_critical(void)
+{
+}
+
+rt_tick_t rt_tick_get(void)
+{
+    return ++tick;
+}
+
+rt_tick_t rt_tick_from_millisecond(rt_int32_t ms)
+{
+    return ms;
+}
+
+rt_err_t rt_thread_mdelay(rt_int32_t ms)
+{
+    tick += ms;
+    if (rtstub_mdelay_hook)
+        rtstub_mdelay_hook(ms);
+
+    return RT_EOK;
+}
+
+rt_err_t rt_thread_delay(rt_tick_t ticks)
+{
+    return rt_thread_mdelay(ticks);
+}
+
+rt_thread_t rt_thread_create(const char *name, void (*entry)(void *parameter), void *parameter,
+                             rt_uint32_t stack_size, rt_uint8_t priority, rt_uint32_t tick)
+{
+    return RT_NULL;
+}
+
+rt_err_t rt_thread_startup(rt_thread_t thread)
+{
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_init(rt_sem_t sem, const char *name, rt_uint32_t value, rt_uint8_t flag)
+{
+    sem->parent.type = RT_Object_Class_Semaphore;
+    sem->value = value;
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_detach(rt_sem_t sem)
+{
+    RT_ASSERT(sem->parent.type == RT_Object_Class_Semaphore);
+    sem->parent.type = 0;
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_take(rt_sem_t sem, rt_int32_t timeout)
+{
+    RT_ASSERT(sem->parent.type == RT_Object_Class_Semaphore);
+    if (sem->value == 0)
+        return -RT_ETIMEOUT;
+
+    sem->value--;
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_release(rt_sem_t sem)
+{
+    RT_ASSERT(sem->parent.type == RT_Object_Class_Semaphore);
+    sem->value++;
+    return RT_EOK;
+}
+
+rt_err_t rt_event_init(rt_event_t event, const char *name, rt_uint8_t flag)
+{
+    event->parent.type = RT_Object_Class_Event;
+    event->set = 0;
+    return RT_EOK;
+}
+
+rt_err_t rt_event_detach(rt_event_t event)
+{
+    RT_ASSERT(event->parent.type == RT_Object_Class_Event);
+    event->parent.type = 0;
+    return RT_EOK;
+}
+
+rt_err_t rt_event_send(rt_event_t event, rt_uint32_t set)
+{
+    RT_ASSERT(event->parent.type == RT_Object_Class_Event);
+    event->set |= set;
+    return RT_EOK;
+}
+
+/* nothing else runs, a wait forever for the events not sent is a dead lock */
+rt_err_t rt_event_recv(rt_event_t event, rt_uint32_t set, rt_uint8_t option, rt_int32_t timeout, rt_uint32_t *recved)
+{
+    rt_uint32_t got;
+
+    RT_ASSERT(event->parent.type == RT_Object_Class_Event);
+    got = event->set & set;
+    if ((option & RT_EVENT_FLAG_AND) ? got != set : got == 0)
+    {
+        RT_ASSERT(timeout != RT_WAITING_FOREVER);
+        return -RT_ETIMEOUT;
+    }
+
+    if (option & RT_EVENT_FLAG_CLEAR)
+        event->set &= ~got;
+    if (recved)
+        *recved = got;
+
+    return RT_EOK;
+}
+
+rt_err_t rt_event_control(rt_event_t event, int cmd, void *arg)
+{
+    RT_ASSERT(event->parent.type == RT_Object_Class_Event);
+    if (cmd == RT_IPC_CMD_RESET)
+        event->set = 0;
+
+    return RT_EOK;
+}
+
+/* the registered devices, a test registers a few at most */
+static rt_device_t devices[8];
+
+rt_err_t rt_device_register(rt_device_t dev, const char *name, rt_uint16_t flags)
+{
+    int i;
+
+    for (i = 0; i < (int)(sizeof(devices) / sizeof(devices[0])); i++)
+    {
+        if (devices[i] == RT_NULL)
+        {
+            strncpy(dev->parent.name, name, sizeof(dev->parent.name) - 1);
+            dev->flag = flags;
+            dev->ref_count = 0;
+            devices[i] = dev;
+            return RT_EOK;
+        }
+    }
+
+    return -RT_EFULL;
+}
+
+rt_err_t rt_device_unregister(rt_device_t dev)
+{
+    int i;
+
+    for (i = 0; i < (int)(sizeof(devices) / sizeof(devices[0])); i++)
+    {
+        if (devices[i] == dev)
+        {
+            devices[i] = RT_NULL;
+            return RT_EOK;
+        }
+    }
+
+    return -RT_ERROR;
+}
+
+rt_device_t rt_device_find(const char *name)
+{
+    int i;
+
+    for (i = 0; i < (int)(sizeof(devices) / sizeof(devices[0])); i++)
+    {
+        if (devices[i] != RT_NULL && strncmp(devices[i]->parent.name, name, sizeof(devices[i]->parent.name)) == 0)
+            return devices[i];
+    }
+
+    return RT_NULL;
+}
+
+rt_err_t rt_device_open(rt_device_t dev, rt_uint16_t oflag)
+{
+    rt_err_t result = RT_EOK;
+
+    if (dev->open)
+        result = dev->open(dev, oflag);
+    if (result == RT_EOK)
+        dev->ref_count++;
+
+    return result;
+}
+
+rt_err_t rt_device_close(rt_device_t dev)
+{
+    RT_ASSERT(dev->ref_count > 0);
+    dev->ref_count--;
+    if (dev->ref_count == 0 && dev->close)
+        return dev->close(dev);
+
+    return RT_EOK;
+}
+
+rt_ssize_t rt_device_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size)
+{
+    RT_ASSERT(dev->ref_count > 0);
+    return dev->read ? dev->read(dev, pos, buffer, size) : 0;
+}
+
+rt_ssize_t rt_device_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size)
+{
+    RT_ASSERT(dev->ref_count > 0);
+    return dev->write ? dev->write(dev, pos, buffer, size) : 0;
+}
+
+rt_err_t rt_device_control(rt_device_t dev, int cmd, void *arg)
+{
+    return dev->control ? dev->control(dev, cmd, arg) : -RT_ENOSYS;
+}
+
+rt_err_t rt_device_set_rx_indicate(rt_device_t dev, rt_err_t (*rx_ind)(rt_device_t dev, rt_size_t size))
+{
+    dev->rx_indicate = rx_ind;
+    return RT_EOK;
+}
+
+void optparse_init(struct optparse *options, char **argv)
+{
+    memset(options, 0, sizeof(*options));
+    options->argv = argv;
+    options->optind = 1;
+}
+
+int optparse(struct optparse *options, const char *optstring)
+{
+    return -1;
+}
+
+/* a chain of pbufs is copied like lwip does */
+rt_uint16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, rt_uint16_t len, rt_uint16_t offset)
+{
+    rt_uint16_t copied = 0, size;
+
+    for (; (p != RT_NULL) && (copied < len); p = p->next)
+    {
+        if (offset >= p->len)
+        {
+            offset -= p->len;
+            continue;
+        }
+
+        size = p->len - offset;
+        if (size > len - copied)
+            size = len - copied;
+        memcpy((rt_uint8_t *)dataptr + copied, (rt_uint8_t *)p->payload + offset, size);
+        copied += size;
+        offset = 0;
+    }
+
+    return copied;
+}
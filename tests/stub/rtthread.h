@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+/* the part of the rt-thread api used by the modules under the host tests, see rtstub.c */
+
+#ifndef _RTTHREAD_H_
+#define _RTTHREAD_H_
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "rtconfig.h"
+
+typedef long                    rt_base_t;
+typedef unsigned long           rt_ubase_t;
+typedef int                     rt_err_t;
+typedef int8_t                  rt_int8_t;
+typedef int16_t                 rt_int16_t;
+typedef int32_t                 rt_int32_t;
+typedef uint8_t                 rt_uint8_t;
+typedef uint16_t                rt_uint16_t;
+typedef uint32_t                rt_uint32_t;
+typedef uint64_t                rt_uint64_t;
+typedef int                     rt_bool_t;
+typedef size_t                  rt_size_t;
+typedef long                    rt_ssize_t;
+typedef long                    rt_off_t;
+typedef uint32_t                rt_tick_t;
+
+#define RT_VER_NUM              0x50002
+#define RT_NULL                 ((void *)0)
+#define RT_TRUE                 1
+#define RT_FALSE                0
+
+#define RT_EOK                  0
+#define RT_ERROR                1
+#define RT_ETIMEOUT             2
+#define RT_EFULL                3
+#define RT_EEMPTY               4
+#define RT_ENOMEM               5
+#define RT_ENOSYS               6
+#define RT_EBUSY                7
+#define RT_EIO                  8
+#define RT_EINVAL               10
+
+#define RT_TICK_PER_SECOND      1000
+#define RT_NAME_MAX             8
+#define RT_ALIGN_SIZE           8
+#define RT_ALIGN(size, align)   (((size) + (align) - 1) & ~((align) - 1))
+#define RT_MIN(a, b)            ((a) < (b) ? (a) : (b))
+#define RT_ASSERT(x)            do { if (!(x)) rt_assert_failed(#x, __FILE__, __LINE__); } while (0)
+#define RT_IPC_FLAG_FIFO        0
+#define RT_WAITING_FOREVER      -1
+#define RT_DEVICE_OFLAG_WRONLY  0x002
+#define RT_DEVICE_OFLAG_RDWR    0x003
+#define RT_DEVICE_FLAG_STANDALONE   0x008
+#define RT_DEVICE_FLAG_INT_RX   0x100
+#define RT_DEVICE_FLAG_DMA_RX   0x200
+#define RT_DEVICE_FLAG_INT_TX   0x400
+#define RT_DEVICE_FLAG_DMA_TX   0x800
+#define RT_EVENT_FLAG_AND       0x01
+#define RT_EVENT_FLAG_OR        0x02
+#define RT_EVENT_FLAG_CLEAR     0x04
+#define RT_IPC_CMD_RESET        0x01
+
+#define rt_inline               static inline
+#define MSH_CMD_EXPORT(cmd, desc)
+#define MSH_CMD_EXPORT_ALIAS(cmd, alias, desc)
+
+struct rt_object
+{
+    char name[8];
+    rt_uint8_t type;                    /* 0 when the object is detached */
+};
+
+#define RT_Object_Class_Semaphore   0x02
+#define RT_Object_Class_Event       0x04
+
+struct rt_semaphore
+{
+    struct rt_object parent;
+    rt_uint32_t value;
+};
+typedef struct rt_semaphore *rt_sem_t;
+
+struct rt_event
+{
+    struct rt_object parent;
+    rt_uint32_t set;
+};
+typedef struct rt_event *rt_event_t;
+
+struct rt_thread
+{
+    struct rt_object parent;
+};
+typedef struct rt_thread *rt_thread_t;
+
+enum rt_device_class_type
+{
+    RT_Device_Class_Char = 0,
+    RT_Device_Class_Block,
+    RT_Device_Class_NetIf,
+    RT_Device_Class_Unknown = 0x1F,
+};
+
+/* the members of the rt-thread device used by the tests, the operations are optional */
+struct rt_device
+{
+    struct rt_object parent;
+    enum rt_device_class_type type;
+    rt_uint16_t flag;
+    rt_uint8_t ref_count;
+
+    rt_err_t  (*rx_indicate)(struct rt_device *dev, rt_size_t size);
+
+    rt_err_t  (*init)   (struct rt_device *dev);
+    rt_err_t  (*open)   (struct rt_device *dev, rt_uint16_t oflag);
+    rt_err_t  (*close)  (struct rt_device *dev);
+    rt_ssize_t (*read)  (struct rt_device *dev, rt_off_t pos, void *buffer, rt_size_t size);
+    rt_ssize_t (*write) (struct rt_device *dev, rt_off_t pos, const void *buffer, rt_size_t size);
+    rt_err_t  (*control)(struct rt_device *dev, int cmd, void *args);
+
+    void *user_data;
+};
+typedef struct rt_device *rt_device_t;
+
+void rt_assert_failed(const char *expr, const char *file, int line);
+
+int rt_kprintf(const char *fmt, ...);
+int rt_snprintf(char *buf, rt_size_t size, const char *fmt, ...);
+int rt_vsnprintf(char *buf, rt_size_t size, const char *fmt, va_list args);
+void *rt_malloc(rt_size_t size);
+void *rt_calloc(rt_size_t count, rt_size_t size);
+void *rt_realloc(void *ptr, rt_size_t size);
+void rt_free(void *ptr);
+char *rt_strdup(const char *s);
+
+#define rt_memset               memset
+#define rt_memcpy               memcpy
+#define rt_memmove              memmove
+#define rt_memcmp               memcmp
+#define rt_strcmp               strcmp
+#define rt_strlen               strlen
+#define rt_strncpy              strncpy
+#define rt_sprintf              sprintf
+
+rt_base_t rt_hw_interrupt_disable(void);
+void rt_hw_interrupt_enable(rt_base_t level);
+void rt_enter_critical(void);
+void rt_exit_critical(void);
+
+rt_tick_t rt_tick_get(void);
+rt_tick_t rt_tick_from_millisecond(rt_int32_t ms);
+rt_err_t rt_thread_mdelay(rt_int32_t ms);
+rt_err_t rt_thread_delay(rt_tick_t tick);
+rt_thread_t rt_thread_create(const char *name, void (*entry)(void *parameter), void *parameter,
+                             rt_uint32_t stack_size, rt_uint8_t priority, rt_uint32_t tick);
+rt_err_t rt_thread_startup(rt_thread_t thread);
+
+rt_err_t rt_sem_init(rt_sem_t sem, const char *name, rt_uint32_t value, rt_uint8_t flag);
+rt_err_t rt_sem_detach(rt_sem_t sem);
+rt_err_t rt_sem_take(rt_sem_t sem, rt_int32_t timeout);
+rt_err_t rt_sem_release(rt_sem_t sem);
+
+rt_err_t rt_event_init(rt_event_t event, const char *name, rt_uint8_t flag);
+rt_err_t rt_event_detach(rt_event_t event);
+rt_err_t rt_event_send(rt_event_t event, rt_uint32_t set);
+rt_err_t rt_event_recv(rt_event_t event, rt_uint32_t set, rt_uint8_t option, rt_int32_t timeout, rt_uint32_t *recved);
+rt_err_t rt_event_control(rt_event_t event, int cmd, void *arg);
+
+rt_err_t rt_device_register(rt_device_t dev, const char *name, rt_uint16_t flags);
+rt_err_t rt_device_unregister(rt_device_t dev);
+rt_device_t rt_device_find(const char *name);
+rt_err_t rt_device_open(rt_device_t dev, rt_uint16_t oflag);
+rt_err_t rt_device_close(rt_device_t dev);
+rt_ssize_t rt_device_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size);
+rt_ssize_t rt_device_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size);
+rt_err_t rt_device_control(rt_device_t dev, int cmd, void *arg);
+rt_err_t rt_device_set_rx_indicate(rt_device_t dev, rt_err_t (*rx_ind)(rt_device_t dev, rt_size_t size));
+
+/* the tests hook the delay to play another thread while the code under test waits */
+extern void (*rtstub_mdelay_hook)(rt_int32_t ms);
+
+#endif /* _RTTHREAD_H_ */
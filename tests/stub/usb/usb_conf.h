@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+#ifndef __USB_CONF_H__
+#define __USB_CONF_H__
+
+/*
+ * The host configuration of the GD32F4xx USB library for the tests, found before the one of
+ * libraries/drivers/include. The USBFS core only, the registers are never touched but the FIFO.
+ */
+#include <stdint.h>
+
+#define __IO                        volatile
+#define __STATIC_INLINE             static inline
+
+#define BIT(x)                      ((uint32_t)((uint32_t)0x01U << (x)))
+#define BITS(start, end)            ((0xFFFFFFFFUL << (start)) & (0xFFFFFFFFUL >> (31U - (uint32_t)(end))))
+
+#define USB_FS_CORE
+#define USE_USB_FS
+
+#define USBFS_SOF_OUTPUT            0U
+#define USBFS_LOW_POWER             0U
+
+#endif /* __USB_CONF_H__ */
@@ -0,0 +1,806 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+/*
+ * The ENV of easyflash on a RAM flash simulator: 4 KB sectors of NOR flash, a program only clears bits.
+ * The flash time is modelled on a SPI NOR flash: 45 ms per sector erase, 50 us + 2.7 us/byte per program
+ * and 10 us + 0.4 us/byte per read. The ENV are checked against a model after random sets, deletes,
+ * reboots and power cuts (in a child process, the flash is shared), a transaction cut by the power is
+ * all saved or not at all, the background GC keeps the ENV saving from collecting. The benchmark prints
+ * the get/set latency at 100 and 1000 ENV, the cost of an update of 50 ENV, one by one and in a
+ * transaction, and the set latency with and without the GC steps between the sets.
+ * "make bench" runs it with more rounds.
+ * The Makefile builds it with the features of the board (test_easyflash) and without (test_easyflash_base).
+ */
+#include <easyflash.h>
+
+/* the board area has two sectors, the test needs room for 1000 ENV */
+#ifdef EF_TEST_AREA_SIZE
+#undef ENV_AREA_SIZE
+#define ENV_AREA_SIZE           EF_TEST_AREA_SIZE
+#endif
+
+#include "../offline-packages/tools/easyflash/src/ef_env.c"
+#include "../offline-packages/tools/easyflash/src/ef_utils.c"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "unit.h"
+
+#ifndef EF_BENCH_ROUNDS
+#define EF_BENCH_ROUNDS         200
+#endif
+
+#define MODEL_ENV_MAX           1000
+#define MODEL_VALUE_MAX         48
+
+#define FLASH_ERASE_US          45000.0
+#define FLASH_WRITE_US(size)    (50 + 2.7 * (size))
+#define FLASH_READ_US(size)     (10 + 0.4 * (size))
+
+struct flash_stats
+{
+    long reads, writes, erases;
+    double us;
+};
+
+struct model_env
+{
+    int len;                /* 0: not set */
+    uint8_t value[MODEL_VALUE_MAX];
+};
+
+static const ef_env defaults[] = { { "boot_times", "0", 0 } };
+
+/* the flash is shared with the child processes of the power cut test */
+static uint8_t *flash;
+static struct flash_stats stats;
+/* the power is cut at this flash write or erase, the write is torn */
+static long cut_countdown;
+
+static struct model_env model[MODEL_ENV_MAX];
+static unsigned int rnd_state = 1;
+
+/* the ENV search reads a little past the end of the area, the flash has a blank sector after it */
+EfErrCode ef_port_read(uint32_t addr, uint32_t *buf, size_t size)
+{
+    if (addr + size > ENV_AREA_SIZE + EF_ERASE_MIN_SIZE)
+    {
+        printf("read 0x%x %u out of the flash\n", (unsigned int)addr, (unsigned int)size);
+        unit_failed++;
+        return EF_READ_ERR;
+    }
+    memcpy(buf, flash + addr, size);
+    stats.reads++;
+    stats.us += FLASH_READ_US(size);
+
+    return EF_NO_ERR;
+}
+
+EfErrCode ef_port_erase(uint32_t addr, size_t size)
+{
+    if (addr % EF_ERASE_MIN_SIZE || size % EF_ERASE_MIN_SIZE || addr + size > ENV_AREA_SIZE)
+    {
+        printf("erase 0x%x %u not a sector\n", (unsigned int)addr, (unsigned int)size);
+        unit_failed++;
+        return EF_ERASE_ERR;
+    }
+    if (cut_countdown > 0 && --cut_countdown == 0)
+        _exit(0);
+
+    memset(flash + addr, 0xFF, size);
+    stats.erases++;
+    stats.us += FLASH_ERASE_US * size / EF_ERASE_MIN_SIZE;
+
+    return EF_NO_ERR;
+}
+
+EfErrCode ef_port_write(uint32_t addr, const uint32_t *buf, size_t size)
+{
+    const uint8_t *data = (const uint8_t *)buf;
+    size_t i, end = size;
+
+    if (addr + size > ENV_AREA_SIZE)
+    {
+        printf("write 0x%x %u out of the flash\n", (unsigned int)addr, (unsigned int)size);
+        unit_failed++;
+        return EF_WRITE_ERR;
+    }
+    if (cut_countdown > 0 && --cut_countdown == 0)
+        end = size / 2;
+
+    for (i = 0; i < end; i++)
+        flash[addr + i] &= data[i];
+    if (end != size)
+        _exit(0);
+    stats.writes++;
+    stats.us += FLASH_WRITE_US(size);
+
+    return EF_NO_ERR;
+}
+
+void ef_port_env_lock(void)
+{
+}
+
+void ef_port_env_unlock(void)
+{
+}
+
+void ef_log_debug(const char *file, const long line, const char *format, ...)
+{
+}
+
+void ef_log_info(const char *format, ...)
+{
+}
+
+void ef_print(const char *format, ...)
+{
+}
+
+static unsigned int rnd(void)
+{
+    rnd_state = rnd_state * 1103515245 + 12345;
+    return rnd_state >> 8;
+}
+
+static double now_us(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+static void env_name(char *name, int i)
+{
+    snprintf(name, EF_ENV_NAME_MAX, "cfg_key_%04d", i);
+}
+
+/* the RAM state of ef_env.c is lost, the ENV are loaded from the flash again */
+static void reboot(void)
+{
+    init_ok = false;
+    gc_request = false;
+    in_recovery_check = false;
+#ifdef EF_ENV_USING_TXN
+    txn_active = false;
+    txn_len = 0;
+#endif
+#ifdef EF_ENV_USING_INCREMENTAL_GC
+    memset(&gc_stats, 0, sizeof(gc_stats));
+    gc_bg_check = true;
+#endif
+    CHECK_EQ(ef_env_init(defaults, sizeof(defaults) / sizeof(defaults[0])), EF_NO_ERR);
+}
+
+static void flash_format(void)
+{
+    memset(flash, 0xFF, ENV_AREA_SIZE + EF_ERASE_MIN_SIZE);
+    memset(model, 0, sizeof(model));
+    reboot();
+}
+
+static void model_set(int i)
+{
+    char name[EF_ENV_NAME_MAX];
+    int k;
+
+    env_name(name, i);
+    model[i].len = 1 + rnd() % MODEL_VALUE_MAX;
+    for (k = 0; k < model[i].len; k++)
+        model[i].value[k] = rnd();
+    CHECK_EQ(ef_set_env_blob(name, model[i].value, model[i].len), EF_NO_ERR);
+}
+
+static void model_del(int i)
+{
+    char name[EF_ENV_NAME_MAX];
+
+    env_name(name, i);
+    CHECK_EQ(ef_del_env(name), model[i].len ? EF_NO_ERR : EF_ENV_NAME_ERR);
+    model[i].len = 0;
+}
+
+static bool model_same(int i)
+{
+    char name[EF_ENV_NAME_MAX];
+    uint8_t value[MODEL_VALUE_MAX];
+    size_t len = 0, read_len;
+
+    env_name(name, i);
+    read_len = ef_get_env_blob(name, value, sizeof(value), &len);
+    if (model[i].len == 0)
+        return read_len == 0;
+
+    return read_len == (size_t)model[i].len && len == read_len && memcmp(value, model[i].value, len) == 0;
+}
+
+static void model_check(int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (!model_same(i))
+        {
+            printf("ENV %d is not the one of the model\n", i);
+            unit_failed++;
+        }
+    }
+}
+
+static void test_model(void)
+{
+    int op, i;
+
+    flash_format();
+    for (op = 0; op < 5000; op++)
+    {
+        i = rnd() % 200;
+        switch (rnd() % 8)
+        {
+        case 0:
+            model_del(i);
+            break;
+        case 1:
+        case 2:
+            CHECK(model_same(i));
+            break;
+        default:
+            model_set(i);
+            break;
+        }
+        if (op % 997 == 996)
+        {
+            reboot();
+            model_check(200);
+        }
+    }
+    reboot();
+    model_check(200);
+}
+
+/* a set or delete cut at a random write or erase is done or not, the other ENV are not changed */
+static void test_power_cut(void)
+{
+    struct model_env old;
+    pid_t child;
+    int cut, i, del, status;
+    int done = 0, not_done = 0;
+
+    flash_format();
+    for (i = 0; i < 60; i++)
+        model_set(i);
+
+    for (cut = 0; cut < 300; cut++)
+    {
+        i = rnd() % 60;
+        del = model[i].len && rnd() % 4 == 0;
+        old = model[i];
+        if (del)
+            model[i].len = 0;
+        else
+            model[i].len = 1 + rnd() % MODEL_VALUE_MAX;
+        memset(model[i].value, rnd(), sizeof(model[i].value));
+
+        child = fork();
+        assert(child >= 0);
+        if (child == 0)
+        {
+            char name[EF_ENV_NAME_MAX];
+
+            cut_countdown = 1 + rnd() % 12;
+            env_name(name, i);
+            if (del)
+                ef_del_env(name);
+            else
+                ef_set_env_blob(name, model[i].value, model[i].len);
+            _exit(0);
+        }
+        waitpid(child, &status, 0);
+        CHECK(WIFEXITED(status));
+
+        reboot();
+        if (model_same(i))
+        {
+            done++;
+        }
+        else
+        {
+            model[i] = old;
+            not_done++;
+        }
+        model_check(60);
+    }
+    /* the cuts are before and after the end of the operations */
+    CHECK(done > 0);
+    CHECK(not_done > 0);
+}
+
+#ifdef EF_ENV_USING_INDEX
+/* a get hit reads the ENV found by the index, a get miss doesn't read the flash */
+static void test_index_reads(void)
+{
+    char name[EF_ENV_NAME_MAX];
+    uint8_t value[MODEL_VALUE_MAX];
+    int i;
+
+    flash_format();
+    for (i = 0; i < 100; i++)
+        model_set(i);
+    reboot();
+    CHECK(env_index_ok);
+
+    for (i = 0; i < 100; i++)
+    {
+        stats.reads = 0;
+        env_name(name, i);
+        CHECK(ef_get_env_blob(name, value, sizeof(value), NULL) > 0);
+        CHECK(stats.reads <= 6);
+    }
+    stats.reads = 0;
+    CHECK_EQ(ef_get_env_blob("missing", value, sizeof(value), NULL), 0);
+    CHECK_EQ(stats.reads, 0);
+}
+#endif /* EF_ENV_USING_INDEX */
+
+#ifdef EF_ENV_USING_TXN
+/* new values of the keys, set in the model by txn_done */
+static void txn_values(struct model_env *values, int count, int max_len)
+{
+    int i, k;
+
+    for (i = 0; i < count; i++)
+    {
+        values[i].len = 1 + rnd() % max_len;
+        for (k = 0; k < values[i].len; k++)
+            values[i].value[k] = rnd();
+    }
+}
+
+static EfErrCode txn_run(const int *keys, const struct model_env *values, int count)
+{
+    char name[EF_ENV_NAME_MAX];
+    int i;
+
+    ef_env_txn_begin();
+    for (i = 0; i < count; i++)
+    {
+        env_name(name, keys[i]);
+        ef_env_txn_set(name, values[i].value, values[i].len);
+    }
+    return ef_env_txn_commit();
+}
+
+static void txn_done(const int *keys, const struct model_env *values, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+        model[keys[i]] = values[i];
+}
+
+/*
+ * a commit saves all the ENV with fewer writes than the sets one by one, an abort saves none.
+ * 50 ENV of 16 bytes at most fit in the transaction buffer.
+ */
+static void test_txn(void)
+{
+    struct model_env values[50];
+    char name[EF_ENV_NAME_MAX];
+    int keys[50], i;
+    long set_writes;
+
+    flash_format();
+    for (i = 0; i < 60; i++)
+        model_set(i);
+    for (i = 0; i < 50; i++)
+        keys[i] = i + 5;
+
+    txn_values(values, 50, 16);
+    ef_env_txn_begin();
+    for (i = 0; i < 50; i++)
+    {
+        env_name(name, keys[i]);
+        CHECK_EQ(ef_env_txn_set(name, values[i].value, values[i].len), EF_NO_ERR);
+    }
+    ef_env_txn_abort();
+    model_check(60);
+
+    memset(&stats, 0, sizeof(stats));
+    for (i = 0; i < 50; i++)
+        model_set(keys[i]);
+    set_writes = stats.writes;
+    model_check(60);
+
+    txn_values(values, 50, 16);
+    memset(&stats, 0, sizeof(stats));
+    CHECK_EQ(txn_run(keys, values, 50), EF_NO_ERR);
+    txn_done(keys, values, 50);
+    CHECK(stats.writes * 2 < set_writes);
+    model_check(60);
+    reboot();
+    model_check(60);
+
+    /* the last value of a key set twice is saved */
+    ef_env_txn_begin();
+    env_name(name, 1);
+    CHECK_EQ(ef_env_txn_set(name, "old", 3), EF_NO_ERR);
+    CHECK_EQ(ef_env_txn_set(name, "new", 3), EF_NO_ERR);
+    CHECK_EQ(ef_env_txn_commit(), EF_NO_ERR);
+    model[1].len = 3;
+    memcpy(model[1].value, "new", 3);
+    reboot();
+    model_check(60);
+
+    /* a failed set fails the commit, nothing is saved */
+    ef_env_txn_begin();
+    env_name(name, 2);
+    CHECK_EQ(ef_env_txn_set(name, "new", 3), EF_NO_ERR);
+    env_name(name, 3);
+    CHECK_EQ(ef_env_txn_set(name, NULL, 0), EF_ENV_NAME_ERR);
+    CHECK_EQ(ef_env_txn_commit(), EF_ENV_NAME_ERR);
+    reboot();
+    model_check(60);
+}
+
+/* a transaction cut at a random write or erase is all saved or not at all */
+static void test_txn_power_cut(void)
+{
+    struct model_env values[8], old[8];
+    int keys[8], cut, count, i, k, status;
+    int done = 0, not_done = 0, same;
+    pid_t child;
+
+    flash_format();
+    for (i = 0; i < 60; i++)
+        model_set(i);
+
+    for (cut = 0; cut < 200; cut++)
+    {
+        count = 1 + rnd() % 8;
+        k = rnd() % 60;
+        /* the keys are distinct */
+        for (i = 0; i < count; i++)
+            keys[i] = (k + i * 7) % 60;
+        txn_values(values, count, MODEL_VALUE_MAX);
+
+        child = fork();
+        assert(child >= 0);
+        if (child == 0)
+        {
+            cut_countdown = 1 + rnd() % 40;
+            txn_run(keys, values, count);
+            _exit(0);
+        }
+        waitpid(child, &status, 0);
+        CHECK(WIFEXITED(status));
+
+        reboot();
+        for (i = 0; i < count; i++)
+            old[i] = model[keys[i]];
+        txn_done(keys, values, count);
+        for (i = 0, same = 0; i < count; i++)
+            same += model_same(keys[i]);
+        if (same == count)
+        {
+            done++;
+        }
+        else
+        {
+            CHECK_EQ(same, 0);
+            for (i = 0; i < count; i++)
+                model[keys[i]] = old[i];
+            not_done++;
+        }
+        model_check(60);
+    }
+    CHECK(done > 0);
+    CHECK(not_done > 0);
+}
+#endif /* EF_ENV_USING_TXN */
+
+#ifdef EF_ENV_USING_INCREMENTAL_GC
+/* run the GC steps until there is no more work, as the GC thread does */
+static void gc_steps(void)
+{
+    int i;
+
+    for (i = 0; ef_env_gc_step(); i++)
+    {
+        if (i == ENV_AREA_SIZE / SECTOR_SIZE)
+        {
+            printf("the GC steps don't end\n");
+            unit_failed++;
+            break;
+        }
+    }
+}
+
+/* the sets don't collect a sector when the GC steps run between them */
+static void test_gc_step(void)
+{
+    struct env_gc_stats gc;
+    int op;
+
+    flash_format();
+    for (op = 0; op < 5000; op++)
+    {
+        model_set(rnd() % MODEL_ENV_MAX);
+        gc_steps();
+    }
+    model_check(MODEL_ENV_MAX);
+
+    ef_env_get_gc_stats(&gc);
+    CHECK(gc.collected > 0);
+    CHECK(gc.moved_env > 0);
+    CHECK_EQ(gc.fg_collected, 0);
+    CHECK(gc.step_max_size <= SECTOR_SIZE);
+    reboot();
+    model_check(MODEL_ENV_MAX);
+}
+
+/* a GC step cut at a random write or erase loses no ENV, the next step goes on */
+static void test_gc_power_cut(void)
+{
+    struct env_gc_stats gc;
+    pid_t child;
+    int cut, status, collected = 0;
+
+    flash_format();
+    for (cut = 0; cut < 200; cut++)
+    {
+        /* use the reserve space, then the step has a sector to collect */
+        for (;;)
+        {
+            struct gc_victim victim;
+
+            gc_find_victim(&victim, false);
+            if (victim.free_size < EF_ENV_GC_RESERVE_SIZE)
+            {
+                gc_find_victim(&victim, true);
+                if (victim.garbage >= EF_ENV_GC_RESERVE_SIZE / 2)
+                    break;
+            }
+            model_set(rnd() % MODEL_ENV_MAX);
+        }
+
+        child = fork();
+        assert(child >= 0);
+        if (child == 0)
+        {
+            cut_countdown = 1 + rnd() % 200;
+            ef_env_gc_step();
+            _exit(0);
+        }
+        waitpid(child, &status, 0);
+        CHECK(WIFEXITED(status));
+
+        reboot();
+        model_check(MODEL_ENV_MAX);
+        gc_steps();
+        ef_env_get_gc_stats(&gc);
+        collected += gc.collected;
+        model_check(MODEL_ENV_MAX);
+    }
+    CHECK(collected > 0);
+}
+#endif /* EF_ENV_USING_INCREMENTAL_GC */
+
+static void bench_row(int count, const char *what, double t0, long ops)
+{
+    printf("| %d | %s | %.2f | %.1f | %.0f |\n", count, what, (now_us() - t0) / ops,
+           (double)stats.reads / ops, stats.us / ops);
+    memset(&stats, 0, sizeof(stats));
+}
+
+static void bench_latency(int count)
+{
+    char name[EF_ENV_NAME_MAX];
+    uint8_t value[16];
+    double t0;
+    int i;
+
+    flash_format();
+    for (i = 0; i < count; i++)
+    {
+        env_name(name, i);
+        memset(value, i, sizeof(value));
+        assert(ef_set_env_blob(name, value, sizeof(value)) == EF_NO_ERR);
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    t0 = now_us();
+    reboot();
+    bench_row(count, "boot load", t0, 1);
+
+    t0 = now_us();
+    for (i = 0; i < EF_BENCH_ROUNDS; i++)
+    {
+        env_name(name, (i * 7919) % count);
+        CHECK_EQ(ef_get_env_blob(name, value, sizeof(value), NULL), sizeof(value));
+    }
+    bench_row(count, "get hit", t0, EF_BENCH_ROUNDS);
+
+    t0 = now_us();
+    for (i = 0; i < EF_BENCH_ROUNDS; i++)
+    {
+        snprintf(name, sizeof(name), "missing_%04d", i);
+        CHECK_EQ(ef_get_env_blob(name, value, sizeof(value), NULL), 0);
+    }
+    bench_row(count, "get miss", t0, EF_BENCH_ROUNDS);
+
+    t0 = now_us();
+    for (i = 0; i < EF_BENCH_ROUNDS; i++)
+    {
+        env_name(name, (i * 7919) % count);
+        memset(value, i, sizeof(value));
+        CHECK_EQ(ef_set_env_blob(name, value, sizeof(value)), EF_NO_ERR);
+    }
+    bench_row(count, "set", t0, EF_BENCH_ROUNDS);
+}
+
+/* update 50 ENV of 16 bytes, one by one or in a transaction */
+static void bench_update(const char *what, bool txn)
+{
+    struct flash_stats total = { 0 };
+    char name[EF_ENV_NAME_MAX];
+    uint8_t value[16];
+    double t0, worst = 0;
+    int round, rounds = EF_BENCH_ROUNDS / 10, i;
+
+    flash_format();
+    for (i = 0; i < 50; i++)
+    {
+        env_name(name, i);
+        memset(value, i, sizeof(value));
+        assert(ef_set_env_blob(name, value, sizeof(value)) == EF_NO_ERR);
+    }
+
+    t0 = now_us();
+    for (round = 0; round < rounds; round++)
+    {
+        memset(&stats, 0, sizeof(stats));
+#ifdef EF_ENV_USING_TXN
+        if (txn)
+            ef_env_txn_begin();
+#endif
+        for (i = 0; i < 50; i++)
+        {
+            env_name(name, i);
+            memset(value, round + i, sizeof(value));
+#ifdef EF_ENV_USING_TXN
+            if (txn)
+            {
+                CHECK_EQ(ef_env_txn_set(name, value, sizeof(value)), EF_NO_ERR);
+                continue;
+            }
+#endif
+            CHECK_EQ(ef_set_env_blob(name, value, sizeof(value)), EF_NO_ERR);
+        }
+#ifdef EF_ENV_USING_TXN
+        if (txn)
+            CHECK_EQ(ef_env_txn_commit(), EF_NO_ERR);
+#endif
+        total.reads += stats.reads;
+        total.writes += stats.writes;
+        total.erases += stats.erases;
+        total.us += stats.us;
+        if (stats.us > worst)
+            worst = stats.us;
+    }
+    printf("| %s | %.1f | %.1f | %.2f | %.0f | %.0f | %.0f |\n", what, (double)total.reads / rounds,
+           (double)total.writes / rounds, (double)total.erases / rounds, total.us / rounds, worst,
+           (now_us() - t0) / rounds);
+    memset(&stats, 0, sizeof(stats));
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* random sets of 8..48 bytes on 200 ENV, the flash time of each set, the GC steps aren't counted in it */
+static void bench_gc(const char *what, bool worker)
+{
+    static double latency[EF_BENCH_ROUNDS * 10];
+    struct flash_stats set = { 0 }, gc = { 0 };
+    uint8_t value[MODEL_VALUE_MAX];
+    char name[EF_ENV_NAME_MAX];
+    int i, count = EF_BENCH_ROUNDS * 10;
+
+    flash_format();
+    for (i = 0; i < count; i++)
+    {
+        env_name(name, rnd() % 200);
+        memset(value, i, sizeof(value));
+        memset(&stats, 0, sizeof(stats));
+        CHECK_EQ(ef_set_env_blob(name, value, 8 + rnd() % 41), EF_NO_ERR);
+        latency[i] = stats.us;
+        set.erases += stats.erases;
+        set.us += stats.us;
+#ifdef EF_ENV_USING_INCREMENTAL_GC
+        if (worker)
+        {
+            memset(&stats, 0, sizeof(stats));
+            gc_steps();
+            gc.erases += stats.erases;
+            gc.us += stats.us;
+        }
+#endif
+    }
+    qsort(latency, count, sizeof(latency[0]), cmp_double);
+    printf("| %s | %.0f | %.0f | %.0f | %.0f | %ld | %ld | %.0f |\n", what, set.us / count, latency[count / 2],
+           latency[count * 99 / 100], latency[count - 1], set.erases, gc.erases, gc.us / count);
+    memset(&stats, 0, sizeof(stats));
+}
+
+static void bench(void)
+{
+#ifdef EF_ENV_USING_INDEX
+    printf("RAM index of %d slots, %d KB area, 16 byte values\n", EF_ENV_INDEX_SIZE, ENV_AREA_SIZE / 1024);
+#else
+    printf("%d entry ENV cache, %d KB area, 16 byte values\n", EF_ENV_CACHE_TABLE_SIZE, ENV_AREA_SIZE / 1024);
+#endif
+    printf("| ENV | Operation | Host us/op | Flash reads/op | Flash us/op |\n");
+    printf("| --- | --- | --- | --- | --- |\n");
+    bench_latency(100);
+    bench_latency(1000);
+
+    printf("\nUpdate of 50 ENV of 16 bytes\n");
+    printf("| Update | Flash reads | Flash writes | Erases | Flash us | Worst flash us | Host us |\n");
+    printf("| --- | --- | --- | --- | --- | --- | --- |\n");
+    bench_update("50 sets", false);
+#ifdef EF_ENV_USING_TXN
+    bench_update("transaction", true);
+#endif
+
+    printf("\n%d random sets of 8..48 bytes on 200 ENV, flash us\n", EF_BENCH_ROUNDS * 10);
+    printf("| GC | Set avg | Set p50 | Set p99 | Set worst | Set erases | GC step erases | GC step us/set |\n");
+    printf("| --- | --- | --- | --- | --- | --- | --- | --- |\n");
+    bench_gc("on the set", false);
+#ifdef EF_ENV_USING_INCREMENTAL_GC
+    bench_gc("steps between the sets", true);
+#endif
+}
+
+int main(void)
+{
+    flash = mmap(NULL, ENV_AREA_SIZE + EF_ERASE_MIN_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    assert(flash != MAP_FAILED);
+
+    UNIT_RUN(test_model);
+    UNIT_RUN(test_power_cut);
+#ifdef EF_ENV_USING_INDEX
+    UNIT_RUN(test_index_reads);
+#endif
+#ifdef EF_ENV_USING_TXN
+    UNIT_RUN(test_txn);
+    UNIT_RUN(test_txn_power_cut);
+#endif
+#ifdef EF_ENV_USING_INCREMENTAL_GC
+    UNIT_RUN(test_gc_step);
+    UNIT_RUN(test_gc_power_cut);
+#endif
+    bench();
+
+    munmap(flash, ENV_AREA_SIZE + EF_ERASE_MIN_SIZE);
+
+    return UNIT_RESULT();
+}
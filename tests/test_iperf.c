@@ -0,0 +1,386 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-30   Evlers      first implementation
+ */
+
+/*
+ * The dual (-d), the tradeoff (-r) and the parallel (-P) tests of iperf against the iperf2 wire format,
+ * the socket calls and the thread creation are replaced and the file is included to reach its static functions.
+ * The streams of the iperf2 peer are made as iperf 2.0.x sends them (Settings_GenerateClientHdr):
+ * the client header in network order, then the payload of ascii digits.
+ */
+#include <sys/types.h>
+#include <unistd.h>
+
+#define socket          rec_socket
+#define recv            rec_recv
+#define send            rec_send
+#define connect         rec_connect
+#define setsockopt      rec_setsockopt
+#define closesocket     rec_close
+#define rt_thread_create rec_thread_create
+
+static int rec_close(int fd);
+
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+
+#include "../offline-packages/iot/netutils/iperf/iperf.c"
+
+#include "unit.h"
+
+#define PEER            "192.168.1.10"
+#define THREADS_MAX     8
+
+/* the threads created by iperf, they are run by the test one by one */
+static struct
+{
+    char name[RT_NAME_MAX + 1];
+    void (*entry)(void *parameter);
+    void *parameter;
+} threads[THREADS_MAX];
+static int threads_len;
+static struct rt_thread thread_dummy;
+
+/* the stream from the iperf2 peer, it's received in segments of "segment" bytes */
+static const rt_uint8_t *rx_data;
+static size_t rx_pos, rx_len, segment;
+static int rx_stop;                     /* iperf is stopped at the end of the stream, before the peer closes */
+
+/* the stream to the iperf2 peer */
+static rt_uint8_t tx_head[2][64];      /* the beginning of the first and the second send */
+static int sends, sends_stop;
+static rt_uint32_t tx_bytes;
+static int connect_port;
+static char connect_host[16];
+
+rt_thread_t rec_thread_create(const char *name, void (*entry)(void *parameter), void *parameter,
+                              rt_uint32_t stack_size, rt_uint8_t priority, rt_uint32_t tick)
+{
+    if (threads_len >= THREADS_MAX)
+        return RT_NULL;
+
+    strncpy(threads[threads_len].name, name, RT_NAME_MAX);
+    threads[threads_len].entry = entry;
+    threads[threads_len].parameter = parameter;
+    threads_len++;
+
+    return &thread_dummy;
+}
+
+int rec_socket(int domain, int type, int protocol)
+{
+    return 7;
+}
+
+int rec_connect(int fd, __CONST_SOCKADDR_ARG addr, socklen_t len)
+{
+    const struct sockaddr_in *in = (const struct sockaddr_in *)addr;
+
+    connect_port = ntohs(in->sin_port);
+    strcpy(connect_host, inet_ntoa(in->sin_addr));
+    return 0;
+}
+
+int rec_setsockopt(int fd, int level, int name, const void *value, socklen_t len)
+{
+    return 0;
+}
+
+static int rec_close(int fd)
+{
+    return 0;
+}
+
+ssize_t rec_recv(int fd, void *buffer, size_t len, int flags)
+{
+    if (rx_pos >= rx_len)
+    {
+        if (!rx_stop)
+            return 0;
+
+        param.mode = IPERF_MODE_STOP;
+        errno = EAGAIN;
+        return -1;
+    }
+
+    if (len > segment)
+        len = segment;
+    if (len > rx_len - rx_pos)
+        len = rx_len - rx_pos;
+    memcpy(buffer, rx_data + rx_pos, len);
+    rx_pos += len;
+
+    return len;
+}
+
+ssize_t rec_send(int fd, const void *buffer, size_t len, int flags)
+{
+    if (sends < 2)
+        memcpy(tx_head[sends], buffer, sizeof(tx_head[0]));
+    sends++;
+    tx_bytes += len;
+
+    /* the peer ends the test, as the reporter does at the end of the time */
+    if (sends == sends_stop)
+        param.mode = IPERF_MODE_STOP;
+
+    return len;
+}
+
+static void reset(void)
+{
+    param.mode = IPERF_MODE_STOP;
+    memset(streams, 0, sizeof(streams));
+    memset(threads, 0, sizeof(threads));
+    threads_len = 0;
+    rx_data = RT_NULL;
+    rx_pos = rx_len = 0;
+    rx_stop = 0;
+    memset(tx_head, 0, sizeof(tx_head));
+    sends = sends_stop = 0;
+    tx_bytes = 0;
+    connect_port = 0;
+    connect_host[0] = '\0';
+}
+
+static int run(int argc, char **argv)
+{
+    return iperf(argc, argv);
+}
+
+/* the threads created by the name, return the count */
+static int threads_find(const char *prefix, int *index)
+{
+    int i, count = 0;
+
+    for (i = 0; i < threads_len; i++)
+    {
+        if (strncmp(threads[i].name, prefix, strlen(prefix)) == 0)
+        {
+            if (count++ == 0 && index) *index = i;
+        }
+    }
+
+    return count;
+}
+
+/* the stream of an iperf2 client: the header with the flags and the amount, then the digits */
+static rt_uint8_t *iperf2_stream(rt_uint32_t flags, int threads, int port, rt_int32_t amount, size_t size)
+{
+    rt_uint8_t *data = malloc(size);
+    rt_uint32_t hdr[6];
+    size_t i;
+
+    for (i = 0; i < size; i++)
+        data[i] = '0' + (size - i) % 10;
+
+    hdr[0] = htonl(flags);
+    hdr[1] = htonl(threads);
+    hdr[2] = htonl(port);
+    hdr[3] = 0;                                 /* bufferlen, 0 without -l */
+    hdr[4] = 0;                                 /* the tcp window, 0 without -w */
+    hdr[5] = htonl(amount);
+    memcpy(data, hdr, sizeof(hdr));
+
+    return data;
+}
+
+/* receive the stream of the iperf2 client by the server stream of the board */
+static IPERF_STREAM *serve(const rt_uint8_t *data, size_t size, size_t seg)
+{
+    IPERF_STREAM *rx = iperf_stream_alloc(0);
+
+    RT_ASSERT(rx != RT_NULL);
+    rx->sock = 5;
+    strcpy(rx->host, PEER);
+
+    rx_data = data;
+    rx_pos = 0;
+    rx_len = size;
+    segment = seg;
+    iperf_server_stream(rx);
+
+    return rx;
+}
+
+/* iperf -c <board> -d -t 5: the board connects back to the listener of the peer while it receives */
+static void test_dual_server (void)
+{
+    static const size_t segments[] = { 1, 10, 23, 1460 };
+    char *argv[] = { "iperf", "-s", RT_NULL };
+    rt_uint8_t *data = iperf2_stream(0x80000001, 1, 5001, -500, 64 * 1024);
+    IPERF_STREAM *rx, *tx = RT_NULL;
+    rt_uint32_t word;
+    size_t i;
+    int index = 0;
+
+    for (i = 0; i < sizeof(segments) / sizeof(segments[0]); i++)
+    {
+        reset();
+        run(2, argv);
+        CHECK_EQ(threads_find("iperfd", RT_NULL), 1);
+        threads_len = 0;
+
+        /* the header split by the segments is still found */
+        rx = serve(data, 64 * 1024, segments[i]);
+        CHECK_EQ(rx->bytes, 64 * 1024);
+        CHECK(!rx->used);
+        CHECK_EQ(rx->hdr_port, 5001);
+        CHECK_EQ(rx->hdr_amount, -500);
+
+        /* the reverse stream is started once, while the client stream is still received */
+        if (threads_find("iperfc", &index) != 1)
+        {
+            printf("segments of %d bytes: no reverse stream\n", (int)segments[i]);
+            unit_failed++;
+            continue;
+        }
+        tx = threads[index].parameter;
+        CHECK_EQ(tx->tx, 1);
+        CHECK_EQ(tx->port, 5001);
+        CHECK(strcmp(tx->host, PEER) == 0);
+        CHECK_EQ(tx->amount, -500);
+        CHECK_EQ(tx->hdr_flags, 0);
+    }
+
+    if (tx == RT_NULL)
+    {
+        free(data);
+        return;
+    }
+
+    /* run the reverse stream, it stops by itself at the time asked by the peer */
+    threads[index].entry(threads[index].parameter);
+    CHECK_EQ(connect_port, 5001);
+    CHECK(strcmp(connect_host, PEER) == 0);
+    CHECK(sends > 0);
+    CHECK(!tx->used);
+    CHECK(param.mode != IPERF_MODE_STOP);
+
+    /* no header with the version 1 flag, the listener of iperf2 would start another test */
+    memcpy(&word, tx_head[0], sizeof(word));
+    CHECK((ntohl(word) & IPERF_HEADER_VERSION1) == 0);
+
+    free(data);
+}
+
+/* iperf -c <board> -r: the reverse stream starts after the client stream is finished */
+static void test_tradeoff_server (void)
+{
+    char *argv[] = { "iperf", "-s", RT_NULL };
+    rt_uint8_t *data = iperf2_stream(0x80000000, 1, 5002, 1000000, 8 * 1024);
+    IPERF_STREAM *tx;
+    int index;
+
+    reset();
+    run(2, argv);
+    threads_len = 0;
+
+    serve(data, 8 * 1024, 1460);
+    CHECK_EQ(threads_find("iperfc", &index), 1);
+    tx = threads[index].parameter;
+    CHECK_EQ(tx->port, 5002);
+    CHECK_EQ(tx->amount, 1000000);
+
+    /* stops at the bytes asked by the peer */
+    threads[index].entry(tx);
+    CHECK_EQ(connect_port, 5002);
+    CHECK(tx_bytes >= 1000000 && tx_bytes < 1000000 + IPERF_BUFSZ);
+
+    /* not started when iperf is stopped while the client stream is received */
+    reset();
+    run(2, argv);
+    threads_len = 0;
+    rx_stop = 1;
+    serve(data, 8 * 1024, 1460);
+    CHECK_EQ(threads_find("iperfc", RT_NULL), 0);
+
+    free(data);
+}
+
+/* iperf -c <board>: the header of a normal test has no flags, iperf 2.0.x still sends it */
+static void test_normal_server (void)
+{
+    char *argv[] = { "iperf", "-s", RT_NULL };
+    rt_uint8_t *data = iperf2_stream(0, 1, 5001, -1000, 16 * 1024);
+
+    reset();
+    run(2, argv);
+    threads_len = 0;
+
+    serve(data, 16 * 1024, 10);
+    CHECK_EQ(threads_find("iperfc", RT_NULL), 0);
+
+    free(data);
+}
+
+/* iperf -c <peer> -d -t 5 -P 2 on the board against iperf -s on the peer */
+static void test_dual_client (void)
+{
+    char *argv[] = { "iperf", "-c", PEER, "-d", "-t", "5", "-P", "2", RT_NULL };
+    char *argv_normal[] = { "iperf", "-c", PEER, "-t", "5", RT_NULL };
+    rt_uint32_t hdr[6];
+    IPERF_STREAM *tx;
+    int index, i;
+
+    reset();
+    run(8, argv);
+    CHECK_EQ(param.time, 5);
+
+    /* the listener for the reverse streams and a client for each parallel stream */
+    CHECK_EQ(threads_find("iperfd", RT_NULL), 1);
+    CHECK_EQ(threads_find("iperfc", &index), 2);
+
+    for (i = index; i < threads_len; i++)
+    {
+        if (strncmp(threads[i].name, "iperfc", 6) != 0) continue;
+
+        sends = 0;
+        sends_stop = 3;
+        param.mode = IPERF_MODE_CLIENT;
+        tx = threads[i].parameter;
+        threads[i].entry(tx);
+        CHECK_EQ(connect_port, IPERF_PORT);
+        CHECK(strcmp(connect_host, PEER) == 0);
+        CHECK(!tx->used);
+
+        /* the header of each stream as iperf2 reads it */
+        memcpy(hdr, tx_head[0], sizeof(hdr));
+        CHECK_EQ(ntohl(hdr[0]), 0x80000001);
+        CHECK_EQ(ntohl(hdr[1]), 2);
+        CHECK_EQ(ntohl(hdr[2]), IPERF_PORT);
+        CHECK_EQ((rt_int32_t)ntohl(hdr[5]), -500);
+
+        /* only at the beginning of the stream */
+        memcpy(hdr, tx_head[1], sizeof(hdr));
+        CHECK((ntohl(hdr[0]) & IPERF_HEADER_VERSION1) == 0);
+    }
+
+    /* without -d there is no header */
+    reset();
+    run(5, argv_normal);
+    CHECK_EQ(threads_find("iperfd", RT_NULL), 0);
+    CHECK_EQ(threads_find("iperfc", &index), 1);
+    sends_stop = 2;
+    threads[index].entry(threads[index].parameter);
+    memcpy(hdr, tx_head[0], sizeof(hdr));
+    CHECK(ntohl(hdr[0]) == 0x00010203);
+
+    param.mode = IPERF_MODE_STOP;
+}
+
+int main(void)
+{
+    UNIT_RUN(test_dual_server);
+    UNIT_RUN(test_tradeoff_server);
+    UNIT_RUN(test_normal_server);
+    UNIT_RUN(test_dual_client);
+
+    return UNIT_RESULT();
+}
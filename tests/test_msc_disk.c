@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+/* the double buffered media access of the usb mass storage over a ram disk */
+#include "../board/ports/usbd_msc/msc_disk.c"
+
+#include <stdlib.h>
+
+#include "ramdisk.h"
+#include "unit.h"
+
+#define BLOCK_SIZE              512
+#define BLOCK_COUNT             64
+#define BUFFER_BLOCKS           4
+
+/*
+ * The host side of the transport. A transfer is in flight from start to wait:
+ * the data to the media lands in the buffer at the start, the data to the host is taken at the wait,
+ * so a buffer reused while its transfer is in flight corrupts the data.
+ */
+static struct
+{
+    rt_uint8_t stream[BLOCK_COUNT * BLOCK_SIZE];
+    rt_size_t pos;
+
+    int dir;
+    rt_uint8_t *buffer;
+    rt_size_t size;
+    rt_bool_t in_flight;
+
+    int starts, waits;
+    int start_fail;                     /* the start with this number fails, 0 for none */
+    int wait_fail;                      /* the wait with this number fails */
+    int wait_short;                     /* the wait with this number moves a block less */
+
+    int overlapped;                     /* the media accesses while a transfer is in flight */
+} host;
+
+static struct ramdisk ram;
+static struct msc_disk disk;
+
+static rt_err_t host_start(struct msc_disk *disk, int dir, rt_uint8_t *buffer, rt_size_t size)
+{
+    CHECK(!host.in_flight);
+    CHECK(buffer == disk->buffer[0] || buffer == disk->buffer[1]);
+    CHECK(size <= disk->buffer_size);
+
+    if (++host.starts == host.start_fail)
+        return -RT_EBUSY;
+
+    host.dir = dir;
+    host.buffer = buffer;
+    host.size = size;
+    host.in_flight = RT_TRUE;
+
+    if (dir == MSC_DISK_XFER_OUT)
+    {
+        memcpy(buffer, host.stream + host.pos, size);
+        host.pos += size;
+    }
+
+    return RT_EOK;
+}
+
+static rt_ssize_t host_wait(struct msc_disk *disk)
+{
+    rt_size_t size = host.size;
+
+    CHECK(host.in_flight);
+    host.in_flight = RT_FALSE;
+
+    if (++host.waits == host.wait_fail)
+        return -RT_ETIMEOUT;
+    if (host.waits == host.wait_short)
+        size -= BLOCK_SIZE;
+
+    if (host.dir == MSC_DISK_XFER_IN)
+    {
+        memcpy(host.stream + host.pos, host.buffer, size);
+        host.pos += size;
+    }
+
+    return size;
+}
+
+static const struct msc_disk_xfer_ops host_ops = { host_start, host_wait };
+
+static void media_access(struct ramdisk *ram, int write, rt_off_t pos, rt_size_t count)
+{
+    if (host.in_flight)
+        host.overlapped++;
+}
+
+static void pattern_fill(rt_uint8_t *data, rt_size_t size, rt_uint8_t seed)
+{
+    rt_size_t i;
+
+    for (i = 0; i < size; i++)
+        data[i] = (rt_uint8_t)(i * 7 + (i >> 9) + seed);
+}
+
+static void setup(void)
+{
+    memset(&host, 0, sizeof(host));
+    RT_ASSERT(ramdisk_init(&ram, "ram0", BLOCK_SIZE, BLOCK_COUNT) == RT_EOK);
+    ram.access = media_access;
+    RT_ASSERT(msc_disk_init(&disk, BUFFER_BLOCKS * BLOCK_SIZE, &host_ops, RT_NULL) == RT_EOK);
+    RT_ASSERT(msc_disk_attach(&disk, "ram0") == RT_EOK);
+}
+
+static void teardown(void)
+{
+    CHECK(!host.in_flight);
+    msc_disk_deinit(&disk);
+    CHECK_EQ(ram.parent.ref_count, 0);
+    ramdisk_deinit(&ram);
+}
+
+static void test_attach (void)
+{
+    struct rt_device chr;
+    struct ramdisk big;
+
+    CHECK_EQ(msc_disk_init(&disk, BUFFER_BLOCKS * BLOCK_SIZE, &host_ops, RT_NULL), RT_EOK);
+
+    CHECK_EQ(msc_disk_attach(&disk, "none"), -RT_ENOSYS);
+
+    memset(&chr, 0, sizeof(chr));
+    chr.type = RT_Device_Class_Char;
+    rt_device_register(&chr, "chr0", 0);
+    CHECK_EQ(msc_disk_attach(&disk, "chr0"), -RT_ENOSYS);
+    CHECK_EQ(chr.ref_count, 0);
+    rt_device_unregister(&chr);
+
+    /* a sector larger than the buffer */
+    ramdisk_init(&big, "big0", BUFFER_BLOCKS * BLOCK_SIZE * 2, 4);
+    CHECK_EQ(msc_disk_attach(&disk, "big0"), -RT_EINVAL);
+    CHECK_EQ(big.parent.ref_count, 0);
+    CHECK(disk.device == RT_NULL);
+    ramdisk_deinit(&big);
+
+    ramdisk_init(&ram, "ram0", BLOCK_SIZE, BLOCK_COUNT);
+    CHECK_EQ(msc_disk_attach(&disk, "ram0"), RT_EOK);
+    CHECK_EQ(ram.parent.ref_count, 1);
+    CHECK_EQ(disk.block_size, BLOCK_SIZE);
+    CHECK_EQ(disk.block_count, BLOCK_COUNT);
+    CHECK_EQ(disk.buffer_blocks, BUFFER_BLOCKS);
+
+    /* attaching again does not leak the open of the device */
+    CHECK_EQ(msc_disk_attach(&disk, "ram0"), RT_EOK);
+    CHECK_EQ(ram.parent.ref_count, 1);
+
+    msc_disk_detach(&disk);
+    CHECK_EQ(ram.parent.ref_count, 0);
+    CHECK_EQ(disk.block_count, 0);
+
+    msc_disk_deinit(&disk);
+    ramdisk_deinit(&ram);
+}
+
+static void test_read (void)
+{
+    setup();
+    pattern_fill(ram.data, BLOCK_COUNT * BLOCK_SIZE, 1);
+
+    /* 10 blocks are 3 buffers of 4, 4 and 2 blocks */
+    CHECK_EQ(msc_disk_read(&disk, 3, 10), 10 * BLOCK_SIZE);
+    CHECK_EQ(disk.error, RT_EOK);
+    CHECK(memcmp(host.stream, ram.data + 3 * BLOCK_SIZE, 10 * BLOCK_SIZE) == 0);
+    CHECK_EQ(ram.reads, 3);
+    CHECK_EQ(host.starts, 3);
+    CHECK_EQ(host.waits, 3);
+    /* the second and the third buffer are read from the media while the previous one is sent */
+    CHECK_EQ(host.overlapped, 2);
+    CHECK_EQ(disk.read_bytes, 10 * BLOCK_SIZE);
+
+    /* a single block */
+    host.pos = 0;
+    CHECK_EQ(msc_disk_read(&disk, BLOCK_COUNT - 1, 1), BLOCK_SIZE);
+    CHECK(memcmp(host.stream, ram.data + (BLOCK_COUNT - 1) * BLOCK_SIZE, BLOCK_SIZE) == 0);
+
+    teardown();
+}
+
+static void test_write (void)
+{
+    setup();
+    pattern_fill(host.stream, sizeof(host.stream), 2);
+
+    CHECK_EQ(msc_disk_write(&disk, 5, 10), 10 * BLOCK_SIZE);
+    CHECK_EQ(disk.error, RT_EOK);
+    CHECK(memcmp(ram.data + 5 * BLOCK_SIZE, host.stream, 10 * BLOCK_SIZE) == 0);
+    CHECK_EQ(ram.data[5 * BLOCK_SIZE - 1], 0);
+    CHECK_EQ(ram.data[15 * BLOCK_SIZE], 0);
+    CHECK_EQ(ram.writes, 3);
+    CHECK_EQ(host.starts, 3);
+    /* the first and the second buffer are written to the media while the next one is received */
+    CHECK_EQ(host.overlapped, 2);
+    CHECK_EQ(disk.write_bytes, 10 * BLOCK_SIZE);
+
+    /* nothing to move */
+    CHECK_EQ(msc_disk_write(&disk, 0, 0), 0);
+    CHECK_EQ(disk.error, RT_EOK);
+    CHECK_EQ(host.starts, 3);
+
+    teardown();
+}
+
+static void test_read_errors (void)
+{
+    /* a media error in the third buffer, the second one is still sent */
+    setup();
+    ram.fail_read = 9;
+    CHECK_EQ(msc_disk_read(&disk, 0, 12), 2 * BUFFER_BLOCKS * BLOCK_SIZE);
+    CHECK_EQ(disk.error, -RT_EIO);
+    CHECK_EQ(disk.media_errors, 1);
+    CHECK_EQ(host.starts, 2);
+    teardown();
+
+    /* the transport fails the wait of the second buffer */
+    setup();
+    host.wait_fail = 2;
+    CHECK_EQ(msc_disk_read(&disk, 0, 12), BUFFER_BLOCKS * BLOCK_SIZE);
+    CHECK_EQ(disk.error, -RT_ETIMEOUT);
+    CHECK_EQ(disk.media_errors, 0);
+    CHECK_EQ(host.starts, 2);
+    teardown();
+
+    /* the transport refuses the second buffer */
+    setup();
+    host.start_fail = 2;
+    CHECK_EQ(msc_disk_read(&disk, 0, 12), BUFFER_BLOCKS * BLOCK_SIZE);
+    CHECK_EQ(disk.error, -RT_EBUSY);
+    CHECK_EQ(host.waits, 1);
+    teardown();
+}
+
+static void test_write_errors (void)
+{
+    /* a media error in the second buffer, the host data is still taken but not written after the error */
+    setup();
+    pattern_fill(host.stream, sizeof(host.stream), 3);
+    ram.fail_write = 6;
+    CHECK_EQ(msc_disk_write(&disk, 0, 12), 12 * BLOCK_SIZE);
+    CHECK_EQ(disk.error, -RT_EIO);
+    CHECK_EQ(disk.media_errors, 1);
+    CHECK_EQ(host.pos, 12 * BLOCK_SIZE);
+    CHECK_EQ(ram.writes, 2);
+    CHECK(memcmp(ram.data, host.stream, BUFFER_BLOCKS * BLOCK_SIZE) == 0);
+    CHECK_EQ(ram.data[8 * BLOCK_SIZE], 0);
+    teardown();
+
+    /* the host sends a block less in the second buffer, the rest is taken and dropped */
+    setup();
+    pattern_fill(host.stream, sizeof(host.stream), 4);
+    host.wait_short = 2;
+    CHECK_EQ(msc_disk_write(&disk, 0, 12), 11 * BLOCK_SIZE);
+    CHECK_EQ(disk.error, -RT_EIO);
+    CHECK_EQ(disk.media_errors, 0);
+    CHECK_EQ(host.waits, 3);
+    CHECK_EQ(ram.writes, 1);
+    teardown();
+
+    /* the transport refuses the first buffer */
+    setup();
+    host.start_fail = 1;
+    CHECK_EQ(msc_disk_write(&disk, 0, 12), 0);
+    CHECK_EQ(disk.error, -RT_EBUSY);
+    CHECK_EQ(host.waits, 0);
+    CHECK_EQ(ram.writes, 0);
+    teardown();
+
+    /* the transport fails the wait of the third buffer, the first two are written */
+    setup();
+    pattern_fill(host.stream, sizeof(host.stream), 5);
+    host.wait_fail = 3;
+    CHECK_EQ(msc_disk_write(&disk, 0, 12), 2 * BUFFER_BLOCKS * BLOCK_SIZE);
+    CHECK_EQ(disk.error, -RT_ETIMEOUT);
+    CHECK_EQ(ram.writes, 2);
+    CHECK(memcmp(ram.data, host.stream, 2 * BUFFER_BLOCKS * BLOCK_SIZE) == 0);
+    teardown();
+}
+
+int main(void)
+{
+    UNIT_RUN(test_attach);
+    UNIT_RUN(test_read);
+    UNIT_RUN(test_write);
+    UNIT_RUN(test_read_errors);
+    UNIT_RUN(test_write_errors);
+
+    return UNIT_RESULT();
+}
@@ -0,0 +1,506 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+/*
+ * nopoll built for the unix port (stub/nopoll/nopoll_config.h) and run on the loopback:
+ * the word-wise masking against the byte-wise one, a round trip of messages of all the length encodings,
+ * fragmented with a PING in the middle, read by the frame views and by nopoll_conn_get_msg and answered
+ * by the gather send on a small socket buffer, and the control frames refused by the frame view.
+ * The benchmark compares the masking and the two receive paths, "make bench" runs it without the sanitizers.
+ */
+#include <nopoll.h>
+#include <nopoll_private.h>
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "unit.h"
+
+#ifndef NOPOLL_BENCH_MB
+#define NOPOLL_BENCH_MB         16
+#endif
+
+#define MESSAGES                400
+#define MESSAGE_MAX             70000
+
+static char mask[4] = { 0x12, (char)0x9a, 0x5c, (char)0xe7 };
+static int port;
+
+struct server
+{
+    noPollCtx *ctx;
+    noPollConn *listener;
+    pthread_t thread;
+    int views;              /* read by the frame views, else by nopoll_conn_get_msg */
+    int messages, frames, mismatch;
+    int pending;            /* the answers not written at once */
+    int control;            /* the session is still open after the control frame */
+    double ms;              /* the time taken to read the messages */
+};
+
+static double clock_ms(clockid_t clock)
+{
+    struct timespec t;
+
+    clock_gettime(clock, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+/* the masking before the word-wise one */
+static void byte_mask(char *payload, int payload_size, char *mask, int desp)
+{
+    int iter;
+
+    for (iter = 0; iter < payload_size; iter++)
+        payload[iter] ^= mask[(iter + desp) % 4];
+}
+
+/* the sizes cover the 7, 16 and 64 bit lengths, and the empty message */
+static int message_size(int i)
+{
+    unsigned int r = (unsigned int)i * 2654435761u;
+
+    r ^= r >> 15;
+    switch (i % 7)
+    {
+    case 0: return 1;
+    case 1: return r % 126;
+    case 2: return 126 + r % 200;
+    case 3: return r % 3000;
+    case 4: return 65530 + r % 20;
+    case 5: return r % MESSAGE_MAX;
+    default: return 1 + r % 2048;
+    }
+}
+
+static void message_fill(char *buf, int size, int i)
+{
+    int k;
+
+    for (k = 0; k < size; k++)
+        buf[k] = (char)(i * 31 + k * 7 + (k >> 8));
+}
+
+static void server_listen(struct server *server)
+{
+    char service[12];
+
+    memset(server, 0, sizeof(*server));
+    snprintf(service, sizeof(service), "%d", ++port);
+    server->ctx = nopoll_ctx_new();
+    server->listener = nopoll_listener_new(server->ctx, "127.0.0.1", service);
+    assert(nopoll_conn_is_ok(server->listener));
+}
+
+static noPollConn *server_accept(struct server *server)
+{
+    noPollConn *conn = NULL;
+    int i;
+
+    for (i = 0; i < 5000 && conn == NULL; i++)
+    {
+        conn = nopoll_conn_accept(server->ctx, server->listener);
+        if (conn == NULL)
+            usleep(1000);
+    }
+    return conn;
+}
+
+static void server_close(struct server *server)
+{
+    pthread_join(server->thread, NULL);
+    nopoll_conn_close(server->listener);
+    nopoll_ctx_unref(server->ctx);
+}
+
+static noPollConn *client_connect(noPollCtx *ctx)
+{
+    char service[12];
+    noPollConn *conn;
+    nopoll_bool ready;
+
+    snprintf(service, sizeof(service), "%d", port);
+    conn = nopoll_conn_new(ctx, "127.0.0.1", service, NULL, NULL, NULL, "http://localhost");
+    ready = nopoll_conn_wait_until_connection_ready(conn, 5);
+    assert(ready);
+    return conn;
+}
+
+/* finish the write kept by the connection, a frame must not be sent before */
+static void write_pending(noPollConn *conn)
+{
+    int i;
+
+    for (i = 0; i < 10000 && nopoll_conn_pending_write_bytes(conn) > 0; i++)
+    {
+        if (nopoll_conn_complete_pending_write(conn) <= 0)
+            usleep(1000);
+    }
+}
+
+/* read the next whole message, return its size or -1 when the session is closed */
+static int server_read(struct server *server, noPollConn *conn, char *buf)
+{
+    noPollFrameView view;
+    noPollMsg *msg = NULL;
+    const char *payload;
+    int len = 0, size, fin;
+
+    while (nopoll_conn_is_ok(conn))
+    {
+        if (server->views)
+        {
+            if (!nopoll_conn_get_frame_view(conn, &view))
+                continue;
+            payload = view.payload;
+            size = view.payload_size;
+            fin = view.has_fin;
+        }
+        else
+        {
+            msg = nopoll_conn_get_msg(conn);
+            if (msg == NULL)
+                continue;
+            payload = (const char *)nopoll_msg_get_payload(msg);
+            size = nopoll_msg_get_payload_size(msg);
+            /* a fragment is final without a previous message */
+            fin = nopoll_msg_is_final(msg) && conn->previous_msg == NULL;
+        }
+
+        if (size > 0 && len + size <= MESSAGE_MAX)
+            memcpy(buf + len, payload, size);
+        len += size;
+        server->frames++;
+        if (!server->views)
+            nopoll_msg_unref(msg);
+        if (fin)
+            return len;
+    }
+    return -1;
+}
+
+/* check the messages of the client, then answer by unmasked messages on a 4 KB socket buffer */
+static void *round_trip_server(void *parameter)
+{
+    struct server *server = parameter;
+    noPollConn *conn = server_accept(server);
+    noPollFrameView view;
+    char *buf = malloc(MESSAGE_MAX), *expected = malloc(MESSAGE_MAX);
+    int len, size, sndbuf = 4096, i;
+    double t0;
+
+    assert(conn != NULL);
+    /* the time of the thread, the socket of the server is blocking and the waits for the client are not counted */
+    t0 = clock_ms(CLOCK_THREAD_CPUTIME_ID);
+    while (server->messages < MESSAGES && (len = server_read(server, conn, buf)) >= 0)
+    {
+        size = message_size(server->messages);
+        message_fill(expected, size, server->messages);
+        if (len != size || memcmp(buf, expected, size) != 0)
+            server->mismatch++;
+        server->messages++;
+    }
+    server->ms = clock_ms(CLOCK_THREAD_CPUTIME_ID) - t0;
+
+    setsockopt(nopoll_conn_socket(conn), SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    nopoll_conn_set_sock_block(nopoll_conn_socket(conn), nopoll_false);
+    for (i = 0; i < MESSAGES; i++)
+    {
+        size = message_size(i);
+        message_fill(expected, size, i + MESSAGES);
+        nopoll_conn_send_frame(conn, nopoll_true, nopoll_false, NOPOLL_BINARY_FRAME, size, expected, 0);
+        if (nopoll_conn_pending_write_bytes(conn) > 0)
+            server->pending++;
+        write_pending(conn);
+    }
+
+    /* the client closes the session when it has read the answers */
+    for (i = 0; i < 10000 && nopoll_conn_is_ok(conn); i++)
+    {
+        if (!nopoll_conn_get_frame_view(conn, &view))
+            usleep(1000);
+    }
+    nopoll_conn_close(conn);
+    free(buf);
+    free(expected);
+
+    return NULL;
+}
+
+/* the client reads the answers from the socket and parses the frames itself, return the messages read */
+static int client_read_answers(noPollConn *conn)
+{
+    size_t size = 32 << 20, len = 0, pos = 0, header, payload;
+    unsigned char *raw = malloc(size), *frame;
+    char *expected = malloc(MESSAGE_MAX);
+    int fd = nopoll_conn_socket(conn), messages = 0, r;
+    double deadline = clock_ms(CLOCK_MONOTONIC) + 10000;
+
+    /* the socket of the client is not blocking */
+    while (messages < MESSAGES && clock_ms(CLOCK_MONOTONIC) < deadline)
+    {
+        r = recv(fd, raw + len, size - len, 0);
+        if (r == 0)
+            break;
+        if (r < 0)
+        {
+            usleep(100);
+            continue;
+        }
+        len += r;
+
+        for (;;)
+        {
+            frame = raw + pos;
+            if (len - pos < 2)
+                break;
+            payload = frame[1] & 0x7f;
+            header = 2;
+            if (payload == 126)
+            {
+                if (len - pos < 4)
+                    break;
+                payload = (frame[2] << 8) | frame[3];
+                header = 4;
+            }
+            else if (payload == 127)
+            {
+                if (len - pos < 10)
+                    break;
+                payload = ((size_t)frame[6] << 24) | (frame[7] << 16) | (frame[8] << 8) | frame[9];
+                header = 10;
+            }
+            if (len - pos < header + payload)
+                break;
+            pos += header + payload;
+
+            /* the PONG of the PING sent in the middle of the fragmented messages */
+            if ((frame[0] & 0x0f) == NOPOLL_PONG_FRAME)
+                continue;
+
+            message_fill(expected, message_size(messages), messages + MESSAGES);
+            if (frame[0] != 0x82 || (frame[1] & 0x80) || payload != (size_t)message_size(messages) ||
+                memcmp(frame + header, expected, payload) != 0)
+            {
+                printf("answer %d: header %02x %02x, %u bytes\n", messages, frame[0], frame[1], (unsigned int)payload);
+                unit_failed++;
+            }
+            messages++;
+        }
+    }
+    free(raw);
+    free(expected);
+
+    return messages;
+}
+
+static void round_trip(struct server *server, int views)
+{
+    noPollCtx *ctx = nopoll_ctx_new();
+    noPollConn *conn;
+    char *buf = malloc(MESSAGE_MAX);
+    int i, size, part;
+
+    server_listen(server);
+    server->views = views;
+    pthread_create(&server->thread, NULL, round_trip_server, server);
+    conn = client_connect(ctx);
+
+    for (i = 0; i < MESSAGES; i++)
+    {
+        size = message_size(i);
+        message_fill(buf, size, i);
+        if (i % 11 == 5 && size > 10)
+        {
+            /* fragmented, with a PING between the fragments */
+            part = size / 3;
+            nopoll_conn_send_frame(conn, nopoll_false, nopoll_true, NOPOLL_BINARY_FRAME, part, buf, 0);
+            nopoll_conn_send_frame(conn, nopoll_true, nopoll_true, NOPOLL_PING_FRAME, 5, "ping!", 0);
+            nopoll_conn_send_frame(conn, nopoll_true, nopoll_true, NOPOLL_CONTINUATION_FRAME, size - part, buf + part, 0);
+        }
+        else
+        {
+            nopoll_conn_send_frame(conn, nopoll_true, nopoll_true, NOPOLL_BINARY_FRAME, size, buf, 0);
+        }
+        write_pending(conn);
+    }
+
+    CHECK_EQ(client_read_answers(conn), MESSAGES);
+    nopoll_conn_close(conn);
+    server_close(server);
+    nopoll_ctx_unref(ctx);
+    free(buf);
+
+    CHECK_EQ(server->messages, MESSAGES);
+    CHECK_EQ(server->mismatch, 0);
+    /* the small socket buffer makes the gather send keep the rest of the frames */
+    CHECK(server->pending > 0);
+}
+
+static void test_mask(void)
+{
+    static char data[400], reference[400];
+    int offset, desp, len, i, bad = 0;
+
+    for (i = 0; i < (int)sizeof(data); i++)
+        data[i] = (char)(i * 131 + 7);
+    memcpy(reference, data, sizeof(data));
+
+    /* all the alignments of the head and the lengths of the tail */
+    for (offset = 0; offset < 8; offset++)
+    {
+        for (desp = 0; desp < 9; desp++)
+        {
+            for (len = 0; len < 300; len++)
+            {
+                nopoll_conn_mask_content(NULL, data + offset, len, mask, desp);
+                byte_mask(reference + offset, len, mask, desp);
+                if (memcmp(data, reference, sizeof(data)) != 0)
+                {
+                    memcpy(data, reference, sizeof(data));
+                    bad++;
+                }
+            }
+        }
+    }
+    CHECK_EQ(bad, 0);
+}
+
+static void test_round_trip(void)
+{
+    struct server server;
+
+    round_trip(&server, 1);
+    /* the large messages are delivered in several views */
+    CHECK(server.frames > MESSAGES);
+
+    round_trip(&server, 0);
+}
+
+static void *control_server(void *parameter)
+{
+    struct server *server = parameter;
+    noPollConn *conn = server_accept(server);
+    noPollFrameView view;
+    int i;
+
+    assert(conn != NULL);
+    nopoll_conn_set_sock_block(nopoll_conn_socket(conn), nopoll_false);
+    for (i = 0; i < 300 && nopoll_conn_is_ok(conn); i++)
+    {
+        if (nopoll_conn_get_frame_view(conn, &view))
+            server->frames++;
+        else
+            usleep(1000);
+    }
+    server->control = nopoll_conn_is_ok(conn);
+    nopoll_conn_close(conn);
+
+    return NULL;
+}
+
+/* send a raw frame with a zero mask to the frame view, return if the session is still open */
+static int control_frame(unsigned char op, size_t size)
+{
+    struct server server;
+    noPollCtx *ctx = nopoll_ctx_new();
+    noPollConn *conn;
+    unsigned char frame[8 + 4000];
+    size_t header = 2;
+    ssize_t sent;
+
+    assert(size <= 4000);
+    frame[0] = op;
+    if (size < 126)
+    {
+        frame[1] = 0x80 | size;
+    }
+    else
+    {
+        frame[1] = 0x80 | 126;
+        frame[2] = size >> 8;
+        frame[3] = size & 0xff;
+        header = 4;
+    }
+    memset(frame + header, 0, 4);
+    memset(frame + header + 4, 'x', size);
+
+    server_listen(&server);
+    pthread_create(&server.thread, NULL, control_server, &server);
+    conn = client_connect(ctx);
+    sent = send(nopoll_conn_socket(conn), frame, header + 4 + size, 0);
+    assert(sent == (ssize_t)(header + 4 + size));
+    server_close(&server);
+    nopoll_conn_close(conn);
+    nopoll_ctx_unref(ctx);
+
+    return server.control;
+}
+
+static void test_control_frames(void)
+{
+    /* a PING is answered, not given as a view */
+    CHECK(control_frame(0x80 | NOPOLL_PING_FRAME, 5));
+    /* more than 125 bytes or without FIN, the session is shut down */
+    CHECK(!control_frame(0x80 | NOPOLL_PING_FRAME, 3000));
+    CHECK(!control_frame(0x80 | NOPOLL_CLOSE_FRAME, 200));
+    CHECK(!control_frame(NOPOLL_PING_FRAME, 5));
+}
+
+static void bench(void)
+{
+    static const int sizes[] = { 125, 1460, 65536 };
+    char *data = malloc(65536 + 1);
+    double t0, t1, t2, mb;
+    struct server server;
+    int i, r, rounds;
+
+    memset(data, 0x5a, 65536 + 1);
+    printf("| Masking | Byte-wise ms/MB | Word-wise ms/MB |\n");
+    printf("| --- | --- | --- |\n");
+    for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++)
+    {
+        rounds = ((size_t)NOPOLL_BENCH_MB << 20) / sizes[i];
+        mb = (double)rounds * sizes[i] / 1048576;
+        /* an unaligned payload, the mask offset of a view going on */
+        t0 = clock_ms(CLOCK_MONOTONIC);
+        for (r = 0; r < rounds; r++)
+            byte_mask(data + 1, sizes[i], mask, r);
+        t1 = clock_ms(CLOCK_MONOTONIC);
+        for (r = 0; r < rounds; r++)
+            nopoll_conn_mask_content(NULL, data + 1, sizes[i], mask, r);
+        t2 = clock_ms(CLOCK_MONOTONIC);
+        printf("| %d bytes | %.2f | %.2f |\n", sizes[i], (t1 - t0) / mb, (t2 - t1) / mb);
+    }
+    free(data);
+
+    for (i = 0, mb = 0; i < MESSAGES; i++)
+        mb += message_size(i) / 1048576.0;
+    round_trip(&server, 0);
+    printf("nopoll_conn_get_msg: %.2f ms/MB, %d messages\n", server.ms / mb, server.frames);
+    round_trip(&server, 1);
+    printf("frame views: %.2f ms/MB, %d views\n", server.ms / mb, server.frames);
+}
+
+int main(void)
+{
+    port = 20000 + getpid() % 20000;
+
+    UNIT_RUN(test_mask);
+    UNIT_RUN(test_round_trip);
+    UNIT_RUN(test_control_frames);
+    bench();
+
+    return UNIT_RESULT();
+}
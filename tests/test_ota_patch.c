@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+/*
+ * The streaming decoder of the ota package against the packages made by tools/ota_patch.py.
+ * The Makefile makes the images (ota_images.py) and the packages in OTA_DATA.
+ */
+#include "../offline-packages/iot/ota_downloader/src/ota_patch.c"
+
+#include <stdlib.h>
+
+#include "unit.h"
+
+struct image
+{
+    rt_uint8_t *data;
+    size_t size;
+};
+
+/* the old image in the "application" partition */
+static struct image old;
+static struct fal_partition old_part = { .name = "application" };
+static int old_read_fail;
+
+/* the decoded image in the "download" partition */
+static rt_uint8_t *download;
+static size_t download_size, download_len;
+static int write_calls;
+
+int fal_partition_read(const struct fal_partition *part, rt_uint32_t addr, rt_uint8_t *buf, size_t size)
+{
+    RT_ASSERT(part == &old_part);
+    if (old_read_fail || addr + size > old.size)
+        return -1;
+
+    memcpy(buf, old.data + addr, size);
+    return size;
+}
+
+static int download_write(void *ctx, const rt_uint8_t *data, size_t size)
+{
+    CHECK(ctx == &download);
+    write_calls++;
+    if (download_len + size > download_size)
+        return -1;
+
+    memcpy(download + download_len, data, size);
+    download_len += size;
+    return 0;
+}
+
+static struct image image_load(const char *name)
+{
+    struct image image = { RT_NULL, 0 };
+    char path[256];
+    FILE *f;
+
+    snprintf(path, sizeof(path), "%s/%s", OTA_DATA, name);
+    f = fopen(path, "rb");
+    if (f == RT_NULL)
+    {
+        printf("%s: not found, make it with the Makefile\n", path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    image.size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    image.data = malloc(image.size);
+    RT_ASSERT(fread(image.data, 1, image.size, f) == image.size);
+    fclose(f);
+
+    return image;
+}
+
+/* feed the package by chunks of this size, the padding is added after the package like ymodem does */
+static int decode(const struct image *package, size_t chunk, size_t padding)
+{
+    struct ota_patch *patch;
+    rt_uint8_t *stream;
+    size_t pos, len, size = package->size + padding;
+    int rc = RT_EOK;
+
+    stream = malloc(size);
+    memcpy(stream, package->data, package->size);
+    memset(stream + package->size, 0x1A, padding);
+
+    download_len = 0;
+    write_calls = 0;
+    memset(download, 0, download_size);
+
+    patch = ota_patch_create(&old_part, download_write, &download);
+    RT_ASSERT(patch != RT_NULL);
+    CHECK(ota_patch_detect(stream, size));
+
+    for (pos = 0; pos < size && rc == RT_EOK; pos += len)
+    {
+        len = RT_MIN(chunk, size - pos);
+        rc = ota_patch_feed(patch, stream + pos, len);
+    }
+    if (rc == RT_EOK)
+    {
+        rc = ota_patch_finish(patch);
+    }
+
+    ota_patch_delete(patch);
+    free(stream);
+
+    return rc;
+}
+
+static rt_bool_t download_matches(const struct image *image)
+{
+    return download_len == image->size && memcmp(download, image->data, image->size) == 0;
+}
+
+static void check_package(const char *name, const struct image *new)
+{
+    static const size_t chunks[] = { 1, 3, 128, 1024, 1 << 20 };
+    struct image package = image_load(name);
+    size_t i;
+
+    for (i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++)
+    {
+        if (decode(&package, chunks[i], i * 37) != RT_EOK || !download_matches(new))
+        {
+            printf("%s: decoded by %d byte chunks, not the new image\n", name, (int)chunks[i]);
+            unit_failed++;
+        }
+    }
+    /* the output is written by the buffer of the decoder, not byte by byte */
+    CHECK_EQ(write_calls, (new->size + OTA_PATCH_OUT_BUFSZ - 1) / OTA_PATCH_OUT_BUFSZ);
+
+    free(package.data);
+}
+
+static void test_compressed (void)
+{
+    struct image new = image_load("new.bin");
+
+    check_package("compress.otap", &new);
+    check_package("compress_w8.otap", &new);
+    free(new.data);
+}
+
+static void test_delta (void)
+{
+    struct image new = image_load("new.bin");
+
+    check_package("delta.otap", &new);
+    check_package("delta_lz.otap", &new);
+    check_package("delta_lz_w14.otap", &new);
+    free(new.data);
+}
+
+static void test_wrong_old (void)
+{
+    struct image package = image_load("delta_lz.otap");
+
+    /* the delta is refused on another old image, nothing is written */
+    old.data[old.size / 2] ^= 0x01;
+    CHECK(decode(&package, 512, 0) != RT_EOK);
+    CHECK_EQ(download_len, 0);
+    old.data[old.size / 2] ^= 0x01;
+
+    old_read_fail = 1;
+    CHECK(decode(&package, 512, 0) != RT_EOK);
+    CHECK_EQ(download_len, 0);
+    old_read_fail = 0;
+
+    free(package.data);
+}
+
+static void test_corrupted (void)
+{
+    struct image package = image_load("delta_lz.otap");
+    struct image new = image_load("new.bin");
+    size_t header = sizeof(struct ota_patch_header);
+
+    /* truncated */
+    package.size -= 1;
+    CHECK(decode(&package, 256, 0) != RT_EOK);
+    package.size += 1;
+
+    /* the header crc */
+    package.data[12] ^= 0x01;
+    CHECK(decode(&package, 256, 0) != RT_EOK);
+    CHECK_EQ(download_len, 0);
+    package.data[12] ^= 0x01;
+
+    /* a byte of the patch data, caught by the decoder or by the crc of the new image */
+    package.data[header + (package.size - header) / 2] ^= 0x10;
+    CHECK(decode(&package, 256, 0) != RT_EOK);
+    package.data[header + (package.size - header) / 2] ^= 0x10;
+
+    CHECK(decode(&package, 256, 0) == RT_EOK && download_matches(&new));
+
+    free(package.data);
+    free(new.data);
+}
+
+int main(void)
+{
+    old = image_load("old.bin");
+    old_part.len = old.size;
+    /* the download partition is a little larger than the new image */
+    download_size = old.size * 2;
+    download = malloc(download_size);
+
+    UNIT_RUN(test_compressed);
+    UNIT_RUN(test_delta);
+    UNIT_RUN(test_wrong_old);
+    UNIT_RUN(test_corrupted);
+
+    free(download);
+    free(old.data);
+
+    return UNIT_RESULT();
+}
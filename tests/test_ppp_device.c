@@ -0,0 +1,575 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+/*
+ * The receive path of ppp_device replayed on a synthetic PPP capture: frames with escapes, double flags,
+ * AT noise between frames, oversized frames and the frames around the size limit.
+ * The data input to lwIP is decoded like pppos_input does, the frames with a good FCS must be the frames
+ * of the capture, for any size of the uart reads. The byte loop of the old receive path is the baseline
+ * of the benchmark, "make bench" runs it on 8 MB without the sanitizers.
+ */
+#include "../offline-packages/iot/ppp_device/src/ppp_device.c"
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "unit.h"
+
+#ifndef PPP_REPLAY_MB
+#define PPP_REPLAY_MB           1
+#endif
+
+#define PPP_FLAG                0x7e
+#define PPP_ESCAPE              0x7d
+#define PPP_FCS_GOOD            0xf0b8
+
+/* the frames (unescaped, without the FCS) one after another */
+struct frames
+{
+    rt_uint8_t *data;
+    size_t size, len;
+    size_t *ends;
+    int count, max;
+};
+
+/* the capture and the frames in it which lwIP must receive */
+static struct
+{
+    rt_uint8_t *data;
+    size_t size;
+    struct frames good;
+    int oversized;
+    size_t noise;
+} capture;
+
+/* the uart, it returns "chunk" bytes at most for a read */
+static struct rt_device uart;
+static size_t uart_pos, uart_chunk;
+
+/* the data input to lwIP */
+static struct
+{
+    rt_uint8_t *data;
+    size_t size, len;
+    int calls, flags_added;
+    int fail_every, fail_times, failed;     /* the input of every "fail_every" fails "fail_times" times */
+} lwip;
+
+static struct ppp_device device;
+static ppp_pcb pcb;
+
+static rt_uint32_t seed = 1;
+
+static rt_uint32_t random_next(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static rt_uint16_t fcs16(rt_uint16_t fcs, const rt_uint8_t *data, size_t len)
+{
+    int i;
+
+    while (len--)
+    {
+        fcs ^= *data++;
+        for (i = 0; i < 8; i++)
+            fcs = (fcs & 1) ? (fcs >> 1) ^ 0x8408 : fcs >> 1;
+    }
+
+    return fcs;
+}
+
+static void frames_init(struct frames *frames, size_t size, int max)
+{
+    frames->data = malloc(size);
+    frames->size = size;
+    frames->ends = malloc(max * sizeof(size_t));
+    frames->max = max;
+    frames->len = 0;
+    frames->count = 0;
+}
+
+static void frames_free(struct frames *frames)
+{
+    free(frames->data);
+    free(frames->ends);
+}
+
+static void frames_add(struct frames *frames, const rt_uint8_t *data, size_t len)
+{
+    RT_ASSERT(frames->len + len <= frames->size && frames->count < frames->max);
+    memcpy(frames->data + frames->len, data, len);
+    frames->len += len;
+    frames->ends[frames->count++] = frames->len;
+}
+
+static rt_bool_t frames_same(const struct frames *a, const struct frames *b)
+{
+    return a->count == b->count && a->len == b->len &&
+           memcmp(a->ends, b->ends, a->count * sizeof(size_t)) == 0 &&
+           memcmp(a->data, b->data, a->len) == 0;
+}
+
+static void capture_put(const void *data, size_t len)
+{
+    RT_ASSERT(capture.size + len <= (size_t)PPP_REPLAY_MB << 20);
+    memcpy(capture.data + capture.size, data, len);
+    capture.size += len;
+}
+
+/* the HDLC-like framing of RFC 1662 with the default ACCM, return the size of the escaped content */
+static size_t frame_escape(const rt_uint8_t *frame, size_t len, rt_uint8_t *out)
+{
+    rt_uint8_t fcs[2];
+    rt_uint16_t sum = ~fcs16(0xffff, frame, len);
+    size_t i, n = 0;
+
+    fcs[0] = sum & 0xff;
+    fcs[1] = sum >> 8;
+    for (i = 0; i < len + 2; i++)
+    {
+        rt_uint8_t c = i < len ? frame[i] : fcs[i - len];
+
+        if (c == PPP_FLAG || c == PPP_ESCAPE || c < 0x20)
+        {
+            out[n++] = PPP_ESCAPE;
+            c ^= 0x20;
+        }
+        out[n++] = c;
+    }
+
+    return n;
+}
+
+/* a frame of the address, the control, the protocol of IP and a payload, the 0x7e and 0x7d are frequent */
+static size_t frame_make(rt_uint8_t *frame, size_t payload)
+{
+    size_t i;
+
+    frame[0] = 0xff;
+    frame[1] = 0x03;
+    frame[2] = 0x00;
+    frame[3] = 0x21;
+    for (i = 0; i < payload; i++)
+    {
+        rt_uint32_t r = random_next();
+        frame[4 + i] = (r & 0x700) == 0 ? PPP_FLAG : (r & 0x700) == 0x100 ? PPP_ESCAPE : r & 0xff;
+    }
+
+    return 4 + payload;
+}
+
+/* the escaped content is "content" bytes, the frame is received whole up to PPP_FRAME_MAX - 2 */
+static size_t frame_make_escaped(rt_uint8_t *frame, rt_uint8_t *escaped, size_t content)
+{
+    size_t len = frame_make(frame, content / 4);
+    int last;
+
+    /* the bytes not escaped are added, the last one changes the FCS which may be escaped */
+    while (1)
+    {
+        for (last = 'A'; last <= 'Z'; last++)
+        {
+            frame[len - 1] = last;
+            if (frame_escape(frame, len, escaped) == content)
+                return len;
+        }
+        RT_ASSERT(len < content);
+        frame[len++] = 'A';
+    }
+}
+
+static void capture_frame(const rt_uint8_t *frame, size_t len, const rt_uint8_t *escaped, size_t n, rt_bool_t good)
+{
+    static const rt_uint8_t flag = PPP_FLAG;
+
+    capture_put(&flag, 1);
+    capture_put(escaped, n);
+    capture_put(&flag, 1);
+    if (good)
+        frames_add(&capture.good, frame, len);
+    else
+        capture.oversized++;
+}
+
+static void capture_make(void)
+{
+    static const char *const noise[] = { "\r\nOK\r\n", "\r\nRING\r\n", "\r\n+CSQ: 23,99\r\n", "\r\nNO CARRIER\r\n" };
+    rt_uint8_t frame[2048], escaped[4096 + 8];
+    size_t max = (size_t)PPP_REPLAY_MB << 20, len, n;
+    rt_uint32_t r;
+    rt_bool_t after_oversized = RT_FALSE;
+
+    capture.data = malloc(max);
+    frames_init(&capture.good, max, max / 8);
+
+    while (capture.size + 4096 + 64 < max)
+    {
+        r = random_next();
+
+        /* the noise between frames, not after an oversized frame: its end flag begins a frame then */
+        if ((r & 0x0f) == 0 && !after_oversized)
+        {
+            const char *s = noise[(r >> 4) % 4];
+
+            capture_put(s, strlen(s));
+            capture.noise += strlen(s);
+        }
+        /* the continuous flags */
+        if ((r & 0x70) == 0)
+        {
+            capture_put("\x7e", 1);
+            if ((r & 0x80) == 0)
+                capture_put("\x7e", 1);
+        }
+
+        after_oversized = RT_FALSE;
+        switch ((r >> 12) % 64)
+        {
+        case 0:
+            /* larger than the frame buffer */
+            len = frame_make(frame, 1600 + (r >> 18) % 400);
+            n = frame_escape(frame, len, escaped);
+            capture_frame(frame, len, escaped, n, RT_FALSE);
+            after_oversized = RT_TRUE;
+            break;
+        case 1:
+            /* the largest frame received and the smallest frame dropped */
+            len = frame_make_escaped(frame, escaped, PPP_FRAME_MAX - 2);
+            capture_frame(frame, len, escaped, PPP_FRAME_MAX - 2, RT_TRUE);
+            len = frame_make_escaped(frame, escaped, PPP_FRAME_MAX - 1);
+            capture_frame(frame, len, escaped, PPP_FRAME_MAX - 1, RT_FALSE);
+            after_oversized = RT_TRUE;
+            break;
+        default:
+            /* the acks and the full size packets mostly */
+            len = frame_make(frame, (r & 0x100) ? 36 + (r >> 20) % 40 : 600 + (r >> 18) % 600);
+            n = frame_escape(frame, len, escaped);
+            capture_frame(frame, len, escaped, n, RT_TRUE);
+            break;
+        }
+    }
+
+    /* the end flag of an oversized frame would begin a frame not ended */
+    len = frame_make(frame, 40);
+    n = frame_escape(frame, len, escaped);
+    capture_frame(frame, len, escaped, n, RT_TRUE);
+}
+
+/* decode the data input to lwIP like pppos_input: a flag ends a frame, the frame with a good FCS is received */
+static void lwip_decode(struct frames *frames)
+{
+    rt_uint8_t frame[4096];
+    size_t i, len = 0;
+    rt_bool_t escape = RT_FALSE;
+
+    frames_init(frames, lwip.len, lwip.len / 4 + 1);
+    for (i = 0; i < lwip.len; i++)
+    {
+        rt_uint8_t c = lwip.data[i];
+
+        if (c == PPP_FLAG)
+        {
+            if (len > 2 && fcs16(0xffff, frame, len) == PPP_FCS_GOOD)
+                frames_add(frames, frame, len - 2);
+            len = 0;
+            escape = RT_FALSE;
+        }
+        else if (c == PPP_ESCAPE)
+        {
+            escape = RT_TRUE;
+        }
+        else if (len < sizeof(frame))
+        {
+            frame[len++] = escape ? c ^ 0x20 : c;
+            escape = RT_FALSE;
+        }
+    }
+}
+
+err_t pppos_input_tcpip(ppp_pcb *ppp, u8_t *s, int l)
+{
+    CHECK(ppp == &pcb);
+    CHECK(l > 0);
+
+    if (lwip.fail_every && lwip.calls % lwip.fail_every == 0 && lwip.failed < lwip.fail_times)
+    {
+        lwip.failed++;
+        return ERR_MEM;
+    }
+    lwip.failed = 0;
+    lwip.calls++;
+
+    if (l == 1 && *s == PPP_FLAG && (s < device.rxbuf || s >= device.rxbuf + sizeof(device.rxbuf)))
+        lwip.flags_added++;
+
+    RT_ASSERT(lwip.len + l <= lwip.size);
+    memcpy(lwip.data + lwip.len, s, l);
+    lwip.len += l;
+
+    return ERR_OK;
+}
+
+/* the user close of lwIP reports the link down */
+err_t pppapi_close(ppp_pcb *pcb, rt_uint8_t nocarrier)
+{
+    ppp_status_changed(pcb, PPPERR_USER, pcb->ctx);
+    return ERR_OK;
+}
+
+err_t pppapi_connect(ppp_pcb *pcb, rt_uint16_t holdoff)
+{
+    return ERR_OK;
+}
+
+ppp_pcb *pppapi_pppos_create(struct netif *pppif, pppos_output_cb_fn output_cb,
+                             ppp_link_status_cb_fn link_status_cb, void *ctx_cb)
+{
+    return RT_NULL;
+}
+
+err_t pppapi_set_default(ppp_pcb *pcb)
+{
+    return ERR_OK;
+}
+
+err_t ppp_free(ppp_pcb *pcb)
+{
+    return ERR_OK;
+}
+
+rt_err_t ppp_netdev_add(struct netif *ppp_netif)
+{
+    return RT_EOK;
+}
+
+rt_err_t ppp_netdev_refresh(struct netif *ppp_netif)
+{
+    return RT_EOK;
+}
+
+void ppp_netdev_del(struct netif *ppp_netif)
+{
+}
+
+static rt_ssize_t uart_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size)
+{
+    size = RT_MIN(size, RT_MIN(uart_chunk, capture.size - uart_pos));
+    memcpy(buffer, capture.data + uart_pos, size);
+    uart_pos += size;
+
+    return size;
+}
+
+/* the modem is ready and has sent the whole capture, the user closes the device */
+static rt_err_t replay_prepare(struct ppp_device *dev)
+{
+    rt_event_send(&dev->event, PPP_EVENT_RX_NOTIFY | PPP_EVENT_CLOSE_REQ);
+    return RT_EOK;
+}
+
+static const struct ppp_device_ops replay_ops = { replay_prepare };
+
+/* run the receive thread on the capture read by "chunk" bytes, return the time taken in ms */
+static double replay(size_t chunk)
+{
+    struct timespec t0, t1;
+
+    memset(&device, 0, sizeof(device));
+    device.uart = &uart;
+    device.ops = &replay_ops;
+    device.pcb = &pcb;
+    pcb.ctx = &device;
+    rt_event_init(&device.event, "pppev", RT_IPC_FLAG_FIFO);
+
+    uart_pos = 0;
+    uart_chunk = chunk;
+    lwip.len = 0;
+    lwip.calls = 0;
+    lwip.flags_added = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    ppp_recv_entry(&device);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    CHECK_EQ(uart_pos, capture.size);
+    CHECK(device.event.set & PPP_EVENT_CLOSED);
+    rt_event_detach(&device.event);
+
+    return (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+}
+
+/* the receive path before the block scanner: 32 byte reads, a byte by byte copy, an input for each frame */
+static double byte_loop_replay(void)
+{
+    static rt_uint8_t rxbuf[PPP_FRAME_MAX];
+    struct timespec t0, t1;
+    rt_uint8_t buffer[32], dat;
+    size_t pos = 0, rxpos = 0, len, i;
+    int state = PPP_STATE_WAIT_HEAD;
+
+    lwip.len = 0;
+    lwip.calls = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    while (pos < capture.size)
+    {
+        len = RT_MIN(sizeof(buffer), capture.size - pos);
+        memcpy(buffer, capture.data + pos, len);
+        pos += len;
+
+        for (i = 0; i < len; i++)
+        {
+            dat = buffer[i];
+            if (state == PPP_STATE_RECV_DATA && dat == PPP_FLAG && rxpos == 1)
+            {
+                /* the continuous 0x7e, the frame begins with this one */
+                rxpos = 0;
+                state = PPP_STATE_WAIT_HEAD;
+            }
+            rxbuf[rxpos++] = dat;
+            if (state == PPP_STATE_WAIT_HEAD)
+            {
+                if (dat == PPP_FLAG)
+                    state = PPP_STATE_RECV_DATA;
+                else
+                    rxpos = 0;
+            }
+            else if (dat == PPP_FLAG)
+            {
+                rt_enter_critical();
+                pppos_input_tcpip(&pcb, rxbuf, rxpos);
+                rt_exit_critical();
+                rxpos = 0;
+                state = PPP_STATE_WAIT_HEAD;
+            }
+            if (rxpos == sizeof(rxbuf))
+            {
+                rxpos = 0;
+                state = PPP_STATE_WAIT_HEAD;
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    return (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+}
+
+static rt_bool_t replay_check(size_t chunk)
+{
+    struct frames decoded;
+    rt_bool_t same;
+
+    replay(chunk);
+    lwip_decode(&decoded);
+    same = frames_same(&decoded, &capture.good);
+    frames_free(&decoded);
+
+#ifdef PPP_DEVICE_DEBUG_DROP
+    /* each byte of the capture is input to lwIP or dropped, the flags ending the oversized frames are added */
+    if (lwip.fail_times <= PPP_INPUT_RETRY)
+        CHECK_EQ(lwip.len - lwip.flags_added + device.dropcnt, capture.size);
+#endif
+
+    return same;
+}
+
+static void test_frames (void)
+{
+    static const size_t chunks[] = { 1, 2, 3, 7, 31, 32, 255, 256, 1000, PPP_RECV_BUF_SIZE - 1, PPP_RECV_BUF_SIZE };
+    size_t i;
+
+    CHECK(capture.good.count > 100);
+    CHECK(capture.oversized > 10);
+
+    for (i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++)
+    {
+        if (!replay_check(chunks[i]))
+        {
+            printf("read by %u bytes: not the frames of the capture\n", (unsigned int)chunks[i]);
+            unit_failed++;
+        }
+    }
+
+    /* the frames next to each other are input together */
+    replay(PPP_RECV_BUF_SIZE);
+    CHECK(lwip.calls < capture.good.count);
+}
+
+static void test_baseline (void)
+{
+    struct frames decoded;
+
+    /* the old receive path gives the same frames to lwIP */
+    byte_loop_replay();
+    lwip_decode(&decoded);
+    CHECK(frames_same(&decoded, &capture.good));
+    frames_free(&decoded);
+}
+
+/* the input is retried while the pbuf pool or the tcpip message queue is full */
+static void test_input_full (void)
+{
+    lwip.fail_every = 5;
+    lwip.fail_times = PPP_INPUT_RETRY;
+    CHECK(replay_check(256));
+
+    /* the data is dropped after the retries, only the frames of it are lost */
+    lwip.fail_times = PPP_INPUT_RETRY + 1;
+    CHECK(!replay_check(256));
+
+    lwip.fail_every = 0;
+    lwip.fail_times = 0;
+}
+
+static void bench(void)
+{
+    static const size_t chunks[] = { 32, 256, PPP_RECV_BUF_SIZE };
+    double mb = capture.size / 1048576.0, ms;
+    size_t i;
+
+    printf("%.1f MB, %d frames, %d oversized, %u bytes of noise\n",
+           mb, capture.good.count, capture.oversized, (unsigned int)capture.noise);
+    printf("| Path | ms/MB | Input calls |\n");
+    printf("| --- | --- | --- |\n");
+
+    ms = byte_loop_replay();
+    printf("| Old byte loop, 32-byte reads | %.2f | %d |\n", ms / mb, lwip.calls);
+    for (i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++)
+    {
+        ms = replay(chunks[i]);
+        printf("| Block scanner, %u-byte reads | %.2f | %d |\n", (unsigned int)chunks[i], ms / mb, lwip.calls);
+    }
+}
+
+int main(void)
+{
+    uart.type = RT_Device_Class_Char;
+    uart.read = uart_read;
+    uart.ref_count = 1;
+
+    capture_make();
+    lwip.size = capture.size * 2;
+    lwip.data = malloc(lwip.size);
+
+    UNIT_RUN(test_frames);
+    UNIT_RUN(test_baseline);
+    UNIT_RUN(test_input_full);
+#ifndef PPP_DEVICE_DEBUG_DROP
+    bench();
+#endif
+
+    free(lwip.data);
+    frames_free(&capture.good);
+    free(capture.data);
+
+    return UNIT_RESULT();
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+#include <stdint.h>
+
+#include "prof_stat.h"
+#include "unit.h"
+
+static void test_bins (void)
+{
+    CHECK_EQ(prof_stat_hist_bin(0), 0);
+    CHECK_EQ(prof_stat_hist_bin(15), 0);
+    CHECK_EQ(prof_stat_hist_bin(16), 1);
+    CHECK_EQ(prof_stat_hist_bin(31), 1);
+    CHECK_EQ(prof_stat_hist_bin(32), 2);
+    CHECK_EQ(prof_stat_hist_bin(UINT32_MAX), PROFILER_HIST_BINS - 1);
+
+    /* every sample is below the limit of its bin and not below the limit of the bin before */
+    for (uint32_t shift = 0; shift < 32; shift ++)
+    {
+        uint32_t samples[] = { (uint32_t)1 << shift, ((uint32_t)1 << shift) - 1, ((uint32_t)1 << shift) + 1 };
+
+        for (uint32_t i = 0; i < 3; i ++)
+        {
+            uint32_t bin = prof_stat_hist_bin(samples[i]);
+
+            CHECK(bin < PROFILER_HIST_BINS);
+            CHECK(bin == PROFILER_HIST_BINS - 1 || samples[i] < prof_stat_hist_bin_limit(bin));
+            CHECK(bin == 0 || samples[i] >= prof_stat_hist_bin_limit(bin - 1));
+        }
+    }
+
+    CHECK_EQ(prof_stat_hist_bin_limit(0), 16);
+    CHECK_EQ(prof_stat_hist_bin_limit(1), 32);
+    CHECK_EQ(prof_stat_hist_bin_limit(PROFILER_HIST_BINS - 1), UINT32_MAX);
+}
+
+static void test_update (void)
+{
+    struct prof_stat stat;
+    uint32_t sum = 0;
+
+    prof_stat_init(&stat);
+    CHECK_EQ(stat.count, 0);
+    CHECK_EQ(prof_stat_avg(&stat), 0);
+    CHECK_EQ(prof_stat_percentile(&stat, 50), 0);
+
+    for (uint32_t i = 1; i <= 100; i ++)
+    {
+        prof_stat_update(&stat, i * 10);
+        sum += i * 10;
+    }
+
+    CHECK_EQ(stat.count, 100);
+    CHECK_EQ(stat.min, 10);
+    CHECK_EQ(stat.max, 1000);
+    CHECK_EQ(stat.total, sum);
+    CHECK_EQ(prof_stat_avg(&stat), 505);
+
+    /* 10 .. 1000 fall into the bins 0 (<16) .. 6 (<1024) */
+    CHECK_EQ(stat.hist[0], 1);
+    CHECK_EQ(stat.hist[1], 2);
+    CHECK_EQ(stat.hist[2], 3);
+    CHECK_EQ(stat.hist[3], 6);
+    CHECK_EQ(stat.hist[4], 13);
+    CHECK_EQ(stat.hist[5], 26);
+    CHECK_EQ(stat.hist[6], 49);
+}
+
+static void test_merge (void)
+{
+    struct prof_stat a, b, empty;
+
+    prof_stat_init(&a);
+    prof_stat_init(&b);
+    prof_stat_init(&empty);
+
+    prof_stat_update(&a, 100);
+    prof_stat_update(&a, 200);
+    prof_stat_update(&b, 5);
+    prof_stat_update(&b, 70000);
+
+    prof_stat_merge(&a, &empty);
+    CHECK_EQ(a.count, 2);
+    CHECK_EQ(a.min, 100);
+
+    prof_stat_merge(&a, &b);
+    CHECK_EQ(a.count, 4);
+    CHECK_EQ(a.min, 5);
+    CHECK_EQ(a.max, 70000);
+    CHECK_EQ(a.total, 70305);
+    CHECK_EQ(a.hist[0], 1);
+    CHECK_EQ(a.hist[prof_stat_hist_bin(70000)], 1);
+
+    /* merging into an empty statistic copies it */
+    prof_stat_merge(&empty, &b);
+    CHECK_EQ(empty.count, 2);
+    CHECK_EQ(empty.min, 5);
+    CHECK_EQ(empty.max, 70000);
+}
+
+static void test_percentile (void)
+{
+    struct prof_stat stat;
+
+    prof_stat_init(&stat);
+
+    /* 90 fast samples below 16 cycles and 10 slow ones of 3000 cycles */
+    for (uint32_t i = 0; i < 90; i ++)
+    {
+        prof_stat_update(&stat, 8);
+    }
+    for (uint32_t i = 0; i < 10; i ++)
+    {
+        prof_stat_update(&stat, 3000);
+    }
+
+    CHECK_EQ(prof_stat_percentile(&stat, 0), 16);
+    CHECK_EQ(prof_stat_percentile(&stat, 50), 16);
+    CHECK_EQ(prof_stat_percentile(&stat, 90), 16);
+
+    /* the limit of the bin of 3000 is 4096, clamped to the max sample */
+    CHECK_EQ(prof_stat_percentile(&stat, 91), 3000);
+    CHECK_EQ(prof_stat_percentile(&stat, 99), 3000);
+    CHECK_EQ(prof_stat_percentile(&stat, 100), 3000);
+    CHECK_EQ(prof_stat_percentile(&stat, 250), 3000);
+
+    /* a single sample is every percentile */
+    prof_stat_init(&stat);
+    prof_stat_update(&stat, 20);
+    CHECK_EQ(prof_stat_percentile(&stat, 1), 20);
+    CHECK_EQ(prof_stat_percentile(&stat, 100), 20);
+
+    /* the samples of the last bin have no limit but the max */
+    prof_stat_init(&stat);
+    prof_stat_update(&stat, UINT32_MAX - 1);
+    CHECK_EQ(prof_stat_percentile(&stat, 50), UINT32_MAX - 1);
+}
+
+int main (void)
+{
+    printf("prof_stat with %d histogram bins\n", PROFILER_HIST_BINS);
+
+    UNIT_RUN(test_bins);
+    UNIT_RUN(test_update);
+    UNIT_RUN(test_merge);
+    UNIT_RUN(test_percentile);
+
+    return UNIT_RESULT();
+}
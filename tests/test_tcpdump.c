@@ -0,0 +1,371 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+/* the filter and the capture ring of tcpdump, the file is included to reach its static functions */
+#include "../offline-packages/iot/netutils/tcpdump/tcpdump.c"
+
+#include <stdlib.h>
+
+#include "unit.h"
+
+#define ETH_IP                  0x0800
+#define ETH_ARP                 0x0806
+#define IP_TCP                  6
+#define IP_UDP                  17
+
+/* an ethernet frame with an ipv4 header of 20 bytes and the ports, the id is the last byte */
+static int frame_build(rt_uint8_t *f, int size, rt_uint16_t type, rt_bool_t vlan, rt_uint8_t proto,
+                       const char *src, const char *dst, rt_uint16_t sport, rt_uint16_t dport, rt_uint8_t id)
+{
+    rt_uint8_t *ip;
+    rt_uint32_t addr;
+    int offset = 12;
+
+    memset(f, 0, size);
+    if (vlan)
+    {
+        f[12] = 0x81;
+        f[13] = 0x00;
+        offset += 4;
+    }
+    f[offset] = type >> 8;
+    f[offset + 1] = type & 0xFF;
+
+    ip = f + offset + 2;
+    ip[0] = 0x45;
+    ip[9] = proto;
+    addr = inet_addr(src);
+    memcpy(&ip[12], &addr, 4);
+    addr = inet_addr(dst);
+    memcpy(&ip[16], &addr, 4);
+    ip[20] = sport >> 8;
+    ip[21] = sport & 0xFF;
+    ip[22] = dport >> 8;
+    ip[23] = dport & 0xFF;
+
+    f[size - 1] = id;
+    return size;
+}
+
+static rt_bool_t filter_check(const char *conditions, const rt_uint8_t *f, int len)
+{
+    struct tcpdump_filter flt;
+    char str[64];
+
+    strcpy(str, conditions);
+    if (rt_tcpdump_filter_parse(str, &flt) != RT_EOK)
+    {
+        printf("filter %s not parsed\n", conditions);
+        unit_failed++;
+        return RT_FALSE;
+    }
+
+    return rt_tcpdump_filter_match(&flt, f, len);
+}
+
+static void test_filter (void)
+{
+    struct tcpdump_filter flt;
+    rt_uint8_t f[64];
+    char bad[16];
+    int len;
+
+    len = frame_build(f, sizeof(f), ETH_IP, RT_FALSE, IP_TCP, "192.168.1.10", "192.168.1.20", 8080, 80, 0);
+
+    memset(&flt, 0, sizeof(flt));
+    CHECK(rt_tcpdump_filter_match(&flt, f, len));
+    CHECK(rt_tcpdump_filter_match(&flt, f, 4));
+
+    CHECK(filter_check("tcp,port=80", f, len));
+    CHECK(filter_check("ip,tcp", f, len));
+    CHECK(filter_check("host=192.168.1.10,port=8080", f, len));
+    CHECK(filter_check("host=192.168.1.20", f, len));
+    CHECK(filter_check("type=0800", f, len));
+    CHECK(!filter_check("udp", f, len));
+    CHECK(!filter_check("arp", f, len));
+    CHECK(!filter_check("ip6", f, len));
+    CHECK(!filter_check("port=81", f, len));
+    CHECK(!filter_check("host=192.168.1.30", f, len));
+
+    /* the headers are cut before the ports */
+    CHECK(!filter_check("port=80", f, 14 + 20 + 2));
+    CHECK(filter_check("tcp", f, 14 + 20));
+    CHECK(!filter_check("tcp", f, 14 + 19));
+
+    strcpy(bad, "bogus");
+    CHECK(rt_tcpdump_filter_parse(bad, &flt) != RT_EOK);
+    strcpy(bad, "host=x.y");
+    CHECK(rt_tcpdump_filter_parse(bad, &flt) != RT_EOK);
+
+    /* the vlan tag is skipped */
+    len = frame_build(f, sizeof(f), ETH_IP, RT_TRUE, IP_UDP, "10.0.0.1", "10.0.0.2", 53, 5353, 0);
+    CHECK(filter_check("udp,port=53", f, len));
+    CHECK(filter_check("ip", f, len));
+
+    /* only the first fragment carries the ports */
+    f[14 + 4 + 6] = 0x00;
+    f[14 + 4 + 7] = 0x10;
+    CHECK(!filter_check("port=53", f, len));
+    CHECK(filter_check("udp", f, len));
+
+    /* the ip conditions never match the other ethertypes */
+    len = frame_build(f, sizeof(f), ETH_ARP, RT_FALSE, 0, "0.0.0.0", "0.0.0.0", 0, 0, 0);
+    CHECK(filter_check("arp", f, len));
+    CHECK(!filter_check("host=192.168.1.10", f, len));
+    CHECK(!filter_check("tcp", f, len));
+}
+
+static void test_filter_exclude (void)
+{
+    struct tcpdump_filter flt;
+    rt_uint8_t f[64];
+    int len;
+
+    /* the own pcapng stream on the port 2000 */
+    memset(&flt, 0, sizeof(flt));
+    flt.exclude_port = 2000;
+
+    len = frame_build(f, sizeof(f), ETH_IP, RT_FALSE, IP_TCP, "192.168.1.10", "192.168.1.2", 2000, 50000, 0);
+    CHECK(!rt_tcpdump_filter_match(&flt, f, len));
+    len = frame_build(f, sizeof(f), ETH_IP, RT_FALSE, IP_TCP, "192.168.1.2", "192.168.1.10", 50000, 2000, 0);
+    CHECK(!rt_tcpdump_filter_match(&flt, f, len));
+    len = frame_build(f, sizeof(f), ETH_IP, RT_TRUE, IP_TCP, "192.168.1.2", "192.168.1.10", 50000, 2000, 0);
+    CHECK(!rt_tcpdump_filter_match(&flt, f, len));
+
+    /* the other traffic is still captured */
+    len = frame_build(f, sizeof(f), ETH_IP, RT_FALSE, IP_UDP, "192.168.1.2", "192.168.1.10", 50000, 2000, 0);
+    CHECK(rt_tcpdump_filter_match(&flt, f, len));
+    len = frame_build(f, sizeof(f), ETH_IP, RT_FALSE, IP_TCP, "192.168.1.2", "192.168.1.10", 50000, 80, 0);
+    CHECK(rt_tcpdump_filter_match(&flt, f, len));
+    len = frame_build(f, sizeof(f), ETH_ARP, RT_FALSE, 0, "0.0.0.0", "0.0.0.0", 0, 0, 0);
+    CHECK(rt_tcpdump_filter_match(&flt, f, len));
+
+    /* a port filter can't select the stream */
+    flt.port = 2000;
+    len = frame_build(f, sizeof(f), ETH_IP, RT_FALSE, IP_TCP, "192.168.1.2", "192.168.1.10", 50000, 2000, 0);
+    CHECK(!rt_tcpdump_filter_match(&flt, f, len));
+}
+
+static rt_uint8_t written_ids[32];
+static rt_uint16_t written_lens[32];
+static int written;
+
+static rt_err_t record_write(const void *buf, int len)
+{
+    written_ids[written] = ((const rt_uint8_t *)buf)[len - 1];
+    written_lens[written] = len;
+    written++;
+    return RT_EOK;
+}
+
+static void ring_start(rt_uint16_t caplen)
+{
+    tcpdump_ring = calloc(TCPDUMP_RING_SLOTS, TCPDUMP_SLOT_STRIDE);
+    ring_head = ring_tail = ring_producers = 0;
+    memset(&stat, 0, sizeof(stat));
+    memset(&filter, 0, sizeof(filter));
+    rt_sem_init(&tcpdump_sem, "tcpdump", 0, RT_IPC_FLAG_FIFO);
+    snaplen = caplen;
+    capture_write = record_write;
+    tcpdump_capture = RT_TRUE;
+    written = 0;
+}
+
+static void ring_stop(void)
+{
+    tcpdump_capture = RT_FALSE;
+    capture_write = RT_NULL;
+    free(tcpdump_ring);
+    tcpdump_ring = RT_NULL;
+}
+
+static void capture_one(rt_uint8_t proto, rt_uint16_t dport, rt_uint8_t id, int size)
+{
+    static rt_uint8_t f[300];
+    struct pbuf p = { RT_NULL, f, size, size };
+
+    frame_build(f, size, ETH_IP, RT_FALSE, proto, "10.0.0.1", "10.0.0.2", 1000, dport, id);
+    rt_tcpdump_capture(&p);
+}
+
+static void test_ring (void)
+{
+    rt_uint8_t f[100];
+    struct pbuf tail = { RT_NULL, f + 10, 90, 90 };
+    struct pbuf head = { &tail, f, 100, 10 };
+
+    ring_start(64);
+    filter.proto = IP_TCP;
+
+    /* a chained pbuf with the headers split, a truncated packet and a filtered one */
+    frame_build(f, sizeof(f), ETH_IP, RT_FALSE, IP_TCP, "10.0.0.1", "10.0.0.2", 1000, 80, 1);
+    rt_tcpdump_capture(&head);
+    capture_one(IP_TCP, 80, 2, 40);
+    capture_one(IP_UDP, 80, 3, 40);
+
+    CHECK_EQ(stat.captured, 2);
+    CHECK_EQ(stat.filtered, 1);
+    CHECK_EQ(stat.truncated, 1);
+    CHECK_EQ(ring_head - ring_tail, 2);
+    CHECK_EQ(ring_producers, 0);
+    CHECK_EQ(tcpdump_sem.value, 2);
+
+    /* the truncated slot keeps the original length */
+    CHECK_EQ(TCPDUMP_SLOT(0)->caplen, 64);
+    CHECK_EQ(TCPDUMP_SLOT(0)->tot_len, 100);
+    CHECK(memcmp(TCPDUMP_SLOT(0)->buf, f, 64) == 0);
+
+    rt_tcpdump_ring_drain();
+    CHECK_EQ(written, 2);
+    CHECK_EQ(written_lens[0], 64);
+    CHECK_EQ(written_ids[1], 2);
+    CHECK_EQ(ring_head, ring_tail);
+
+    /* the ring holds TCPDUMP_RING_SLOTS packets, the next ones are dropped */
+    for (int i = 0; i < TCPDUMP_RING_SLOTS + 2; i++)
+    {
+        capture_one(IP_TCP, 80, 10 + i, 40);
+    }
+    CHECK_EQ(stat.ring_full, 2);
+    CHECK_EQ(ring_head - ring_tail, TCPDUMP_RING_SLOTS);
+
+    written = 0;
+    rt_tcpdump_ring_drain();
+    CHECK_EQ(written, TCPDUMP_RING_SLOTS);
+    for (int i = 0; i < written; i++)
+    {
+        CHECK_EQ(written_ids[i], 10 + i);
+    }
+
+    /* the ring is used again after the wrap */
+    capture_one(IP_TCP, 80, 40, 40);
+    written = 0;
+    rt_tcpdump_ring_drain();
+    CHECK_EQ(written, 1);
+    CHECK_EQ(written_ids[0], 40);
+
+    /* a stopped capture takes nothing */
+    tcpdump_capture = RT_FALSE;
+    capture_one(IP_TCP, 80, 41, 40);
+    CHECK_EQ(ring_head, ring_tail);
+
+    ring_stop();
+}
+
+static void test_ring_order (void)
+{
+    struct tcpdump_buf *reserved;
+
+    ring_start(64);
+
+    /* a producer is preempted between the reserve and the publish */
+    reserved = TCPDUMP_SLOT(ring_head);
+    ring_head++;
+    ring_producers++;
+    capture_one(IP_TCP, 80, 2, 40);
+
+    written = 0;
+    rt_tcpdump_ring_drain();
+    CHECK_EQ(written, 0);
+
+    reserved->caplen = reserved->tot_len = 20;
+    reserved->buf[19] = 1;
+    reserved->ready = 1;
+    ring_producers--;
+
+    rt_tcpdump_ring_drain();
+    CHECK_EQ(written, 2);
+    CHECK_EQ(written_ids[0], 1);
+    CHECK_EQ(written_ids[1], 2);
+
+    ring_stop();
+}
+
+static int mdelay_calls;
+
+static void producer_finish(rt_int32_t ms)
+{
+    /* the preempted producer publishes its slot after a few delays */
+    if (++mdelay_calls == 3)
+        ring_producers = 0;
+
+    /* the thread is woken up by the stop request and exits */
+    if (!tcpdump_running && tcpdump_tid != RT_NULL)
+    {
+        CHECK(tcpdump_sem.value > 0);
+        rt_tcpdump_thread_entry(RT_NULL);
+    }
+}
+
+static err_t link_send(struct netif *nif, struct pbuf *p)
+{
+    return 0;
+}
+
+static err_t link_input(struct pbuf *p, struct netif *inp)
+{
+    return 0;
+}
+
+static void test_deinit_waits (void)
+{
+    static struct netif nif;
+    rt_uint8_t f[40];
+    struct pbuf p = { RT_NULL, f, sizeof(f), sizeof(f) };
+
+    ring_start(64);
+    nif.linkoutput = _netif_linkoutput;
+    nif.input = _netif_input;
+    link_output = link_send;
+    input = link_input;
+    netif = &nif;
+    tcpdump_running = RT_TRUE;
+    tcpdump_tid = (rt_thread_t)&nif;
+
+    /* the packets sent and received through the hooks are captured */
+    frame_build(f, sizeof(f), ETH_IP, RT_FALSE, IP_TCP, "10.0.0.1", "10.0.0.2", 1000, 80, 7);
+    nif.linkoutput(&nif, &p);
+    nif.input(&p, &nif);
+    CHECK_EQ(stat.captured, 2);
+
+    ring_producers = 1;
+    mdelay_calls = 0;
+    rtstub_mdelay_hook = producer_finish;
+    rt_tcpdump_deinit();
+    rtstub_mdelay_hook = RT_NULL;
+
+    /* the producers are waited for, then the thread, the semaphore is detached after the thread exits */
+    CHECK_EQ(mdelay_calls, 4);
+    CHECK_EQ(ring_producers, 0);
+    CHECK(!tcpdump_running);
+    CHECK(tcpdump_tid == RT_NULL);
+    CHECK(tcpdump_ring == RT_NULL);
+    CHECK_EQ(tcpdump_sem.parent.type, 0);
+    CHECK(nif.linkoutput == link_send);
+    CHECK(nif.input == link_input);
+    CHECK(netif == RT_NULL);
+
+    /* no producer gets a slot after the deinit */
+    rt_tcpdump_capture(&p);
+    CHECK_EQ(stat.captured, 2);
+
+    ring_stop();
+}
+
+int main (void)
+{
+    UNIT_RUN(test_filter);
+    UNIT_RUN(test_filter_exclude);
+    UNIT_RUN(test_ring);
+    UNIT_RUN(test_ring_order);
+    UNIT_RUN(test_deinit_waits);
+
+    return UNIT_RESULT();
+}
@@ -0,0 +1,521 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+/*
+ * The tftp server on the loopback against other implementations: curl (RFC 1350 and the blksize option),
+ * an RFC 7440 reader of this file with the window of 4 and 8 blocks, and the tftp client of the package
+ * with the datagrams lost at random. The files are in the memory by the tftp_file_* port functions.
+ * The sources are included to reach the client table of the server, the tick is the time of the host.
+ */
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#define rt_tick_get     host_tick_get
+#define sendto          lossy_sendto
+#define closesocket     close
+#define rt_strcasecmp   strcasecmp
+
+ssize_t lossy_sendto(int fd, const void *buf, size_t len, int flags, const struct sockaddr *addr, socklen_t addr_len);
+
+#include "../offline-packages/iot/netutils/tftp/tftp.h"
+#undef tftp_printf
+#define tftp_printf(...)    ((void)0)
+
+#include "../offline-packages/iot/netutils/tftp/tftp_xfer.c"
+#include "../offline-packages/iot/netutils/tftp/tftp_server.c"
+#include "../offline-packages/iot/netutils/tftp/tftp_client.c"
+
+#undef sendto
+
+#include <stdlib.h>
+#include <strings.h>
+
+#include "unit.h"
+
+#define FILES_MAX       16
+#define READER_TIMEOUT  (-0x10000)
+#define CURL_FILE       TFTP_DATA "/curl.out"
+#define FILE_SIZE_MAX   (1024 * 1024)
+
+/* the files of the server and the client, "fail" makes the read at this position fail */
+static struct
+{
+    char name[32];
+    rt_uint8_t *data;
+    int size;
+    int fail;
+} files[FILES_MAX];
+static pthread_mutex_t files_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* the datagrams are lost at this rate (percent), for both the server and the client */
+static volatile int loss;
+static volatile unsigned int loss_seed = 1;
+static volatile int sent, lost;
+
+static struct tftp_server *server;
+static pthread_t server_thread;
+static int port;
+
+rt_tick_t host_tick_get(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (rt_tick_t)(ts.tv_sec * RT_TICK_PER_SECOND + ts.tv_nsec / (1000000000 / RT_TICK_PER_SECOND));
+}
+
+ssize_t lossy_sendto(int fd, const void *buf, size_t len, int flags, const struct sockaddr *addr, socklen_t addr_len)
+{
+    unsigned int seed = __sync_add_and_fetch(&loss_seed, 0x9E3779B9);
+
+    __sync_add_and_fetch(&sent, 1);
+    if (loss && (seed >> 8) % 100 < (unsigned int)loss)
+    {
+        /* the stack took it, the network lost it */
+        __sync_add_and_fetch(&lost, 1);
+        return len;
+    }
+
+    return sendto(fd, buf, len, flags, addr, addr_len);
+}
+
+static int file_find(const char *name)
+{
+    int i;
+
+    for (i = 0; i < FILES_MAX; i++)
+    {
+        if (files[i].data && strcmp(files[i].name, name) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+static int file_create(const char *name, int size)
+{
+    int i, index;
+
+    pthread_mutex_lock(&files_lock);
+    index = file_find(name);
+    for (i = 0; index < 0 && i < FILES_MAX; i++)
+    {
+        if (files[i].data == RT_NULL)
+        {
+            index = i;
+            strncpy(files[i].name, name, sizeof(files[i].name) - 1);
+            files[i].data = calloc(1, FILE_SIZE_MAX);
+        }
+    }
+    RT_ASSERT(index >= 0);
+    files[index].size = size;
+    files[index].fail = -1;
+    pthread_mutex_unlock(&files_lock);
+
+    return index;
+}
+
+static int file_fill(const char *name, int size, unsigned int seed)
+{
+    int index = file_create(name, size), i;
+
+    for (i = 0; i < size; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        files[index].data[i] = seed >> 16;
+    }
+
+    return index;
+}
+
+static rt_bool_t file_same(const char *a, const char *b)
+{
+    int x = file_find(a), y = file_find(b);
+
+    return x >= 0 && y >= 0 && files[x].size == files[y].size &&
+           memcmp(files[x].data, files[y].data, files[x].size) == 0;
+}
+
+/* the port functions of the package, the handle is the index + 1 */
+void *tftp_file_open(const char *fname, const char *mode, int is_write)
+{
+    int index;
+
+    /* the root of the server is "" */
+    if (fname[0] == '/')
+        fname++;
+
+    if (is_write)
+        return (void *)(intptr_t)(file_create(fname, 0) + 1);
+
+    pthread_mutex_lock(&files_lock);
+    index = file_find(fname);
+    pthread_mutex_unlock(&files_lock);
+
+    return index < 0 ? RT_NULL : (void *)(intptr_t)(index + 1);
+}
+
+int tftp_file_write(void *handle, int pos, void *buff, int len)
+{
+    int index = (intptr_t)handle - 1;
+
+    if (pos + len > FILE_SIZE_MAX)
+        return -1;
+
+    pthread_mutex_lock(&files_lock);
+    memcpy(files[index].data + pos, buff, len);
+    if (files[index].size < pos + len)
+        files[index].size = pos + len;
+    pthread_mutex_unlock(&files_lock);
+
+    return len;
+}
+
+int tftp_file_read(void *handle, int pos, void *buff, int len)
+{
+    int index = (intptr_t)handle - 1;
+
+    pthread_mutex_lock(&files_lock);
+    if (files[index].fail >= 0 && pos + len > files[index].fail)
+        len = -1;
+    else if (pos >= files[index].size)
+        len = 0;
+    else if (len > files[index].size - pos)
+        len = files[index].size - pos;
+    if (len > 0)
+        memcpy(buff, files[index].data + pos, len);
+    pthread_mutex_unlock(&files_lock);
+
+    return len;
+}
+
+void tftp_file_close(void *handle)
+{
+}
+
+static void *server_entry(void *parameter)
+{
+    tftp_server_run(parameter);
+    return RT_NULL;
+}
+
+static void server_start(void)
+{
+    port = 20000 + getpid() % 20000;
+    server = tftp_server_create("", port);
+    RT_ASSERT(server != RT_NULL);
+    tftp_server_write_set(server, 1);
+    pthread_create(&server_thread, RT_NULL, server_entry, server);
+    usleep(50 * 1000);
+}
+
+static void server_stop(void)
+{
+    struct sockaddr_in addr;
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+    /* wake up the select of the server, the request is too short to be handled */
+    tftp_server_destroy(server);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sendto(sock, "", 1, 0, (struct sockaddr *)&addr, sizeof(addr));
+    close(sock);
+    pthread_join(server_thread, RT_NULL);
+}
+
+/* the clients of the server, all the sessions are closed after a transfer */
+static int server_sessions(void)
+{
+    struct tftp_server_private *_private = server->_private;
+    int i, count = 0;
+
+    for (i = 0; i < _private->table_num; i++)
+    {
+        if (_private->client_table[i].xfer != RT_NULL)
+            count++;
+    }
+
+    return count;
+}
+
+static void sessions_wait_closed(void)
+{
+    int i;
+
+    for (i = 0; i < 100 && server_sessions() != 0; i++)
+        usleep(10 * 1000);
+    CHECK_EQ(server_sessions(), 0);
+}
+
+/* ---------------------------------------------------------------------------- the RFC 7440 reader */
+
+struct reader
+{
+    int sock;
+    struct sockaddr_in peer;
+    rt_uint8_t packet[4 + XFER_DATA_SIZE_MAX];
+};
+
+static int reader_send(struct reader *r, const void *data, int len)
+{
+    return sendto(r->sock, data, len, 0, (struct sockaddr *)&r->peer, sizeof(r->peer));
+}
+
+/* wait for a packet from the server, the first one sets the port of the session */
+static int reader_recv(struct reader *r, int timeout_ms)
+{
+    struct timeval tv = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+    socklen_t len = sizeof(r->peer);
+
+    setsockopt(r->sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return recvfrom(r->sock, r->packet, sizeof(r->packet), 0, (struct sockaddr *)&r->peer, &len);
+}
+
+static void reader_ack(struct reader *r, rt_uint16_t block)
+{
+    rt_uint16_t ack[2] = { htons(TFTP_CMD_ACK), htons(block) };
+
+    reader_send(r, ack, sizeof(ack));
+}
+
+/*
+ * Read a file by the options (0 is not asked), the blocks are acknowledged by window as RFC 7440 asks.
+ * Return the size read, -1 - code of the ERROR packet received, or READER_TIMEOUT.
+ */
+static int reader_get(const char *name, int blksize, int windowsize, rt_uint8_t *out, int *acks)
+{
+    struct reader r;
+    char request[128];
+    int len, size = 0, block = 0, count = 0, n;
+
+    memset(&r, 0, sizeof(r));
+    r.sock = socket(AF_INET, SOCK_DGRAM, 0);
+    r.peer.sin_family = AF_INET;
+    r.peer.sin_port = htons(port);
+    r.peer.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    len = 2;
+    request[0] = 0;
+    request[1] = TFTP_CMD_RRQ;
+    len += sprintf(request + len, "%s", name) + 1;
+    len += sprintf(request + len, "octet") + 1;
+    if (blksize)
+    {
+        len += sprintf(request + len, "blksize") + 1;
+        len += sprintf(request + len, "%d", blksize) + 1;
+    }
+    if (windowsize)
+    {
+        len += sprintf(request + len, "windowsize") + 1;
+        len += sprintf(request + len, "%d", windowsize) + 1;
+    }
+    reader_send(&r, request, len);
+    *acks = 0;
+    if (!blksize) blksize = 512;
+    if (!windowsize) windowsize = 1;
+
+    while ((n = reader_recv(&r, 2000)) >= 4)
+    {
+        rt_uint16_t cmd = r.packet[0] << 8 | r.packet[1];
+        rt_uint16_t num = r.packet[2] << 8 | r.packet[3];
+
+        if (cmd == TFTP_CMD_ERROR)
+        {
+            close(r.sock);
+            return -1 - num;
+        }
+        if (cmd == TFTP_CMD_OACK)
+        {
+            reader_ack(&r, 0);
+            continue;
+        }
+        if (cmd != TFTP_CMD_DATA || num != (rt_uint16_t)(block + 1))
+            continue;
+
+        block++;
+        memcpy(out + size, r.packet + 4, n - 4);
+        size += n - 4;
+        count++;
+        if (n - 4 < blksize || count == windowsize)
+        {
+            reader_ack(&r, block);
+            (*acks)++;
+            count = 0;
+        }
+        if (n - 4 < blksize)
+        {
+            close(r.sock);
+            return size;
+        }
+    }
+
+    close(r.sock);
+    return READER_TIMEOUT;
+}
+
+/* ---------------------------------------------------------------------------- tests */
+
+static void test_curl (void)
+{
+    char cmd[256];
+    FILE *f;
+    int index, size;
+    rt_uint8_t *data;
+
+    if (system("curl --version 2>/dev/null | grep -q tftp") != 0)
+    {
+        printf("curl with tftp is not found, skipped\n");
+        return;
+    }
+
+    index = file_fill("curl.bin", 300 * 1024 + 100, 1);
+    data = malloc(FILE_SIZE_MAX);
+
+    /* RFC 1350, and the blksize option of curl */
+    snprintf(cmd, sizeof(cmd), "curl -s -o " CURL_FILE " tftp://127.0.0.1:%d/curl.bin", port);
+    CHECK_EQ(system(cmd), 0);
+    f = fopen(CURL_FILE, "rb");
+    size = f ? (int)fread(data, 1, FILE_SIZE_MAX, f) : -1;
+    if (f) fclose(f);
+    CHECK(size == files[index].size && memcmp(data, files[index].data, size) == 0);
+    sessions_wait_closed();
+
+    snprintf(cmd, sizeof(cmd), "curl -s --tftp-blksize 1024 -o " CURL_FILE " tftp://127.0.0.1:%d/curl.bin", port);
+    CHECK_EQ(system(cmd), 0);
+    f = fopen(CURL_FILE, "rb");
+    size = f ? (int)fread(data, 1, FILE_SIZE_MAX, f) : -1;
+    if (f) fclose(f);
+    CHECK(size == files[index].size && memcmp(data, files[index].data, size) == 0);
+    sessions_wait_closed();
+
+    /* the upload, the file of a multiple of the block size ends with an empty block */
+    f = fopen(CURL_FILE, "wb");
+    RT_ASSERT(f != RT_NULL);
+    fwrite(files[index].data, 1, 512 * 100, f);
+    fclose(f);
+    snprintf(cmd, sizeof(cmd), "curl -s -T " CURL_FILE " tftp://127.0.0.1:%d/curl_up.bin", port);
+    CHECK_EQ(system(cmd), 0);
+    sessions_wait_closed();
+    index = file_find("curl_up.bin");
+    CHECK(index >= 0 && files[index].size == 512 * 100 && memcmp(files[index].data, data, 512 * 100) == 0);
+
+    remove(CURL_FILE);
+    free(data);
+}
+
+static void test_window_reader (void)
+{
+    static const int windows[] = { 4, 8 };
+    rt_uint8_t *data = malloc(FILE_SIZE_MAX);
+    int index, i, size, acks, blocks;
+
+    index = file_fill("window.bin", 200 * 1024 + 7, 2);
+
+    for (i = 0; i < (int)(sizeof(windows) / sizeof(windows[0])); i++)
+    {
+        size = reader_get("window.bin", 1024, windows[i], data, &acks);
+        CHECK(size == files[index].size && memcmp(data, files[index].data, size) == 0);
+        /* one ACK for each window, not for each block */
+        blocks = files[index].size / 1024 + 1;
+        CHECK_EQ(acks, (blocks + windows[i] - 1) / windows[i]);
+        sessions_wait_closed();
+    }
+
+    /* without the options the transfer is RFC 1350 */
+    size = reader_get("window.bin", 0, 0, data, &acks);
+    CHECK(size == files[index].size && memcmp(data, files[index].data, size) == 0);
+    CHECK_EQ(acks, files[index].size / 512 + 1);
+    sessions_wait_closed();
+
+    free(data);
+}
+
+/* a failed read ends the transfer by an ERROR packet, not by a short block that looks like the end */
+static void test_read_error (void)
+{
+    rt_uint8_t *data = malloc(FILE_SIZE_MAX);
+    int index, acks;
+
+    index = file_fill("broken.bin", 64 * 1024, 3);
+    files[index].fail = 10 * 1024;
+
+    CHECK_EQ(reader_get("broken.bin", 1024, 4, data, &acks), -1);
+    sessions_wait_closed();
+
+    CHECK_EQ(reader_get("broken.bin", 0, 0, data, &acks), -1);
+    sessions_wait_closed();
+
+    /* the file not found */
+    CHECK(reader_get("none.bin", 0, 0, data, &acks) < 0);
+    sessions_wait_closed();
+
+    free(data);
+}
+
+/* the client of the package pushes and pulls the file with the datagrams lost at random */
+static void test_client_loss (void)
+{
+    static const int rates[] = { 0, 2, 5, 10 };
+    struct tftp_client *client;
+    char name[32];
+    int i, index, size;
+
+    index = file_fill("loss.bin", 256 * 1024 + 33, 4);
+    size = files[index].size;
+
+    for (i = 0; i < (int)(sizeof(rates) / sizeof(rates[0])); i++)
+    {
+        loss = rates[i];
+        sent = lost = 0;
+
+        client = tftp_client_create("127.0.0.1", port);
+        RT_ASSERT(client != RT_NULL);
+        tftp_client_blksize_set(client, 1024);
+        tftp_client_windowsize_set(client, 8);
+        snprintf(name, sizeof(name), "up%d.bin", rates[i]);
+        CHECK_EQ(tftp_client_push(client, "loss.bin", name), size);
+        tftp_client_destroy(client);
+        CHECK(file_same("loss.bin", name));
+
+        client = tftp_client_create("127.0.0.1", port);
+        RT_ASSERT(client != RT_NULL);
+        snprintf(name, sizeof(name), "down%d.bin", rates[i]);
+        CHECK_EQ(tftp_client_pull(client, "loss.bin", name), size);
+        tftp_client_destroy(client);
+        CHECK(file_same("loss.bin", name));
+
+        /* the last ACK may be lost, the session of the server times out then */
+        loss = 0;
+        for (index = 0; index < 500 && server_sessions() != 0; index++)
+            usleep(10 * 1000);
+        CHECK_EQ(server_sessions(), 0);
+        printf("loss %2d%%: %d datagrams, %d lost\n", rates[i], sent, lost);
+    }
+}
+
+int main(void)
+{
+    server_start();
+
+    UNIT_RUN(test_curl);
+    UNIT_RUN(test_window_reader);
+    UNIT_RUN(test_read_error);
+    UNIT_RUN(test_client_loss);
+
+    server_stop();
+
+    return UNIT_RESULT();
+}
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+/*
+ * usb_txfifo_write and usb_rxfifo_read of the GD32F4xx USB library against a fake FIFO register:
+ * the register is a page without access, each access faults, is done on the page and the next
+ * instruction traps (x86-64 single step), so the words pushed and popped are logged in order.
+ * Packets of 0..1100 bytes at the four alignments of the buffer, the buffer has the exact size, so
+ * the sanitizer finds any byte read or written outside the packet. The Makefile builds it with the
+ * DMA hook too (test_usb_fifo_dma), the fake DMA moves all, none or half of the words.
+ */
+#include <drv_usb_core.h>
+#include <drv_usb_hw.h>
+
+#include "../libraries/GD32F4xx_Firmware_Library/GD32F4xx_usb_library/driver/Source/drv_usb_core.c"
+
+#include <assert.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "unit.h"
+
+#define PACKET_MAX              1100
+#define FIFO_WORDS_MAX          ((PACKET_MAX + 3) / 4)
+#define FIFO_TX_NUM             1
+
+#define EFLAGS_TF               0x100
+#define PF_WRITE                0x2
+
+static uint32_t *fifo_page;
+static long page_size;
+
+/* the words written to the FIFO and the words the FIFO gives on read, changed by the signal handlers */
+static volatile uint32_t fifo_pushed[FIFO_WORDS_MAX + 1];
+static uint32_t fifo_queue[FIFO_WORDS_MAX + 1];
+static volatile int pushed, popped;
+static volatile int write_pending;
+
+#ifdef USB_FIFO_DMA_ENABLED
+/* the DMA takes 32 bit addresses, the high bits of the buffer are put back */
+static uintptr_t dma_buf_high;
+static int dma_mode, dma_words;
+#endif
+
+void usb_udelay(const uint32_t usec)
+{
+}
+
+void usb_mdelay(const uint32_t msec)
+{
+}
+
+#ifdef USB_FIFO_DMA_ENABLED
+uint32_t usb_fifo_dma_copy(uint32_t fifo, uint32_t buf, uint32_t word_count, uint8_t to_fifo)
+{
+    uint32_t *words = (uint32_t *)(dma_buf_high | buf), moved, i;
+
+    CHECK_EQ(fifo, (uint32_t)(uintptr_t)fifo_page);
+    CHECK_EQ(buf & 3, 0);
+    CHECK(word_count > 0);
+
+    /* all, none after an error or half of the words */
+    moved = dma_mode == 0 ? word_count : dma_mode == 1 ? 0 : word_count / 2;
+    for (i = 0; i < moved; i++)
+    {
+        if (to_fifo)
+            fifo_pushed[pushed++] = words[i];
+        else
+            words[i] = fifo_queue[popped++];
+    }
+    dma_words += moved;
+
+    return moved;
+}
+#endif /* USB_FIFO_DMA_ENABLED */
+
+/* an access to the FIFO register: the page is opened for one instruction, a read gets the next word */
+static void fifo_fault(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = context;
+
+    if ((uintptr_t)info->si_addr - (uintptr_t)fifo_page >= (uintptr_t)page_size)
+    {
+        static const char msg[] = "fault out of the FIFO register\n";
+
+        if (write(2, msg, sizeof(msg) - 1) < 0)
+            _exit(2);
+        _exit(1);
+    }
+    mprotect(fifo_page, page_size, PROT_READ | PROT_WRITE);
+    write_pending = uc->uc_mcontext.gregs[REG_ERR] & PF_WRITE;
+    if (!write_pending)
+        *fifo_page = fifo_queue[popped++];
+    uc->uc_mcontext.gregs[REG_EFL] |= EFLAGS_TF;
+}
+
+/* the instruction is done, a write is logged and the page is closed again */
+static void fifo_step(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = context;
+
+    if (write_pending)
+        fifo_pushed[pushed++] = *fifo_page;
+    mprotect(fifo_page, page_size, PROT_NONE);
+    uc->uc_mcontext.gregs[REG_EFL] &= ~EFLAGS_TF;
+}
+
+static void fifo_init(usb_core_regs *regs)
+{
+    struct sigaction sa;
+
+    page_size = sysconf(_SC_PAGESIZE);
+    fifo_page = mmap(NULL, page_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(fifo_page != MAP_FAILED);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_flags = SA_SIGINFO;
+    sa.sa_sigaction = fifo_fault;
+    sigaction(SIGSEGV, &sa, NULL);
+    sa.sa_sigaction = fifo_step;
+    sigaction(SIGTRAP, &sa, NULL);
+
+    /* only the FIFO of the endpoint is there, another one faults out of the register */
+    memset(regs, 0, sizeof(*regs));
+    regs->DFIFO[0] = fifo_page;
+    regs->DFIFO[FIFO_TX_NUM] = fifo_page;
+}
+
+static uint8_t *packet_alloc(int align, int len)
+{
+    uint8_t *buf = malloc(align + len);
+
+    assert(buf != NULL || align + len == 0);
+    memset(buf, 0xA5, align + len);
+#ifdef USB_FIFO_DMA_ENABLED
+    dma_buf_high = (uintptr_t)buf & ~(uintptr_t)0xFFFFFFFF;
+#endif
+
+    return buf;
+}
+
+/* all the lengths of the unrolled loops and the tails, then some larger packets, a fault costs a few us */
+static int next_len(int len)
+{
+    return len < 128 ? len + 1 : len + 37;
+}
+
+/* the bytes of the packet in little endian words, the last word is padded with zeros */
+static void test_txfifo(void)
+{
+    usb_core_regs regs;
+    uint8_t *buf, *src;
+    uint32_t word;
+    int align, len, i, k, bad = 0;
+
+    fifo_init(&regs);
+    for (len = 0; len <= PACKET_MAX; len = next_len(len))
+    {
+        for (align = 0; align < 4; align++)
+        {
+            buf = packet_alloc(align, len);
+            src = buf + align;
+            for (i = 0; i < len; i++)
+                src[i] = rand();
+#ifdef USB_FIFO_DMA_ENABLED
+            dma_mode = (len + align) % 3;
+#endif
+
+            pushed = 0;
+            CHECK_EQ(usb_txfifo_write(&regs, src, FIFO_TX_NUM, len), USB_OK);
+            CHECK_EQ(pushed, (len + 3) / 4);
+            for (i = 0; i < pushed; i++)
+            {
+                for (k = 0, word = 0; k < 4 && i * 4 + k < len; k++)
+                    word |= (uint32_t)src[i * 4 + k] << (8 * k);
+                bad += fifo_pushed[i] != word;
+            }
+            free(buf);
+        }
+    }
+    CHECK_EQ(bad, 0);
+}
+
+/* the words popped are stored in little endian, the bytes out of the packet are not written */
+static void test_rxfifo(void)
+{
+    usb_core_regs regs;
+    uint8_t *buf, *dest;
+    void *end;
+    int align, len, i, bad = 0;
+
+    fifo_init(&regs);
+    for (len = 0; len <= PACKET_MAX; len = next_len(len))
+    {
+        for (align = 0; align < 4; align++)
+        {
+            buf = packet_alloc(align, len);
+            dest = buf + align;
+            for (i = 0; i < FIFO_WORDS_MAX; i++)
+                fifo_queue[i] = ((uint32_t)rand() << 16) ^ rand();
+#ifdef USB_FIFO_DMA_ENABLED
+            dma_mode = (len + align) % 3;
+#endif
+
+            popped = 0;
+            end = usb_rxfifo_read(&regs, dest, len);
+            CHECK(end == dest + len);
+            CHECK_EQ(popped, (len + 3) / 4);
+            for (i = 0; i < len; i++)
+                bad += dest[i] != (uint8_t)(fifo_queue[i / 4] >> (8 * (i % 4)));
+            for (i = 0; i < align; i++)
+                bad += buf[i] != 0xA5;
+            free(buf);
+        }
+    }
+    CHECK_EQ(bad, 0);
+}
+
+int main(void)
+{
+    UNIT_RUN(test_txfifo);
+    UNIT_RUN(test_rxfifo);
+#ifdef USB_FIFO_DMA_ENABLED
+    /* the DMA is used for the aligned packets of USB_FIFO_DMA_MIN_SIZE bytes at least */
+    CHECK(dma_words > 0);
+#endif
+
+    return UNIT_RESULT();
+}
@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-30   Evlers      first implementation
+ */
+
+/*
+ * the response parser and the shard download of webclient on recorded responses,
+ * the socket calls are replaced and the file is included to reach its static functions.
+ */
+#include <sys/types.h>
+#include <unistd.h>
+
+#define recv            rec_recv
+#define send            rec_send
+#define connect         rec_connect
+#define closesocket     rec_close
+
+static int rec_close(int fd);
+
+#include "../offline-packages/iot/webclient/src/webclient.c"
+
+#include "unit.h"
+
+#define HOST            "http://127.0.0.1:8080"
+#define QUEUE_SIZE      16
+
+/* the responses are queued, a request takes the next one */
+static const char *queue[QUEUE_SIZE];
+static int queue_len, queue_pos;
+
+/* the response which is being received, it's received in fragments of "frag" bytes */
+static const char *rx_data;
+static size_t rx_pos, rx_len, frag;
+
+static char requests[4096];
+static size_t requests_len;
+static int connects, sends;
+
+/* the data passed to the shard handle function */
+static char shard[256];
+static int shard_len;
+
+ssize_t rec_recv(int fd, void *buffer, size_t len, int flags)
+{
+    if (rx_data == RT_NULL || rx_pos >= rx_len)
+        return 0;
+
+    if (len > frag)
+        len = frag;
+    if (len > rx_len - rx_pos)
+        len = rx_len - rx_pos;
+    memcpy(buffer, rx_data + rx_pos, len);
+    rx_pos += len;
+
+    return len;
+}
+
+ssize_t rec_send(int fd, const void *buffer, size_t len, int flags)
+{
+    if (requests_len + len < sizeof(requests))
+    {
+        memcpy(requests + requests_len, buffer, len);
+        requests_len += len;
+        requests[requests_len] = '\0';
+    }
+    sends++;
+
+    /* the previous response is over, the server answers the new request */
+    rx_data = queue_pos < queue_len ? queue[queue_pos++] : RT_NULL;
+    rx_pos = 0;
+    rx_len = rx_data ? strlen(rx_data) : 0;
+
+    return len;
+}
+
+int rec_connect(int fd, __CONST_SOCKADDR_ARG addr, socklen_t len)
+{
+    connects++;
+    return 0;
+}
+
+static int rec_close(int fd)
+{
+    rx_data = RT_NULL;
+    return close(fd);
+}
+
+static void record(size_t fragment)
+{
+    queue_len = queue_pos = 0;
+    rx_data = RT_NULL;
+    rx_pos = rx_len = 0;
+    frag = fragment;
+    requests_len = 0;
+    requests[0] = '\0';
+    connects = sends = 0;
+    shard_len = 0;
+}
+
+static void respond(const char *response)
+{
+    if (queue_len < QUEUE_SIZE)
+        queue[queue_len++] = response;
+}
+
+/* the header buffer holds the previous response, clean it for the next request as the redirection does */
+static int get(struct webclient_session *session, const char *URI)
+{
+    session->header->length = 0;
+    web_memset(session->header->buffer, 0, session->header->size);
+
+    return webclient_get(session, URI);
+}
+
+static int count(const char *str, const char *sub)
+{
+    int n = 0;
+
+    while ((str = strstr(str, sub)) != RT_NULL)
+    {
+        n++;
+        str += strlen(sub);
+    }
+
+    return n;
+}
+
+static int read_all(struct webclient_session *session, char *buffer, int size, int piece)
+{
+    int total = 0, len;
+
+    while (total < size - 1 && (len = webclient_read(session, buffer + total,
+            piece < size - 1 - total ? piece : size - 1 - total)) > 0)
+    {
+        total += len;
+    }
+    buffer[total] = '\0';
+
+    return total;
+}
+
+static int shard_handle(char *buffer, int size)
+{
+    if (shard_len + size < (int) sizeof(shard))
+    {
+        memcpy(shard + shard_len, buffer, size);
+        shard_len += size;
+        shard[shard_len] = '\0';
+    }
+    web_free(buffer);
+
+    return RT_EOK;
+}
+
+static void test_chunked(void)
+{
+    struct webclient_session *session = webclient_session_create(1024);
+    char body[64];
+
+    record(7);
+    respond("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+            "5\r\nhello\r\n6\r\n world\r\n0\r\nX-Trailer: 1\r\n\r\n");
+
+    CHECK_EQ(get(session, HOST "/chunked"), 200);
+    CHECK_EQ(read_all(session, body, sizeof(body), 3), 11);
+    CHECK(strcmp(body, "hello world") == 0);
+    /* the trailer is consumed, the connection can take the next request */
+    CHECK(webclient_reusable(session));
+
+    /* an empty chunked body */
+    respond("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n");
+    CHECK_EQ(get(session, HOST "/empty"), 200);
+    CHECK_EQ(read_all(session, body, sizeof(body), 16), 0);
+    CHECK(webclient_reusable(session));
+    CHECK_EQ(connects, 1);
+
+    webclient_close(session);
+}
+
+static void test_keep_alive(void)
+{
+    struct webclient_session *session = webclient_session_create(1024);
+    char body[64];
+
+    record(1024);
+    respond("HTTP/1.1 200 OK\r\nContent-Length: 4\r\n\r\nabcd");
+    respond("HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nef");
+    respond("HTTP/1.1 200 OK\r\nContent-Length: 1\r\nConnection: close\r\n\r\ng");
+    respond("HTTP/1.0 200 OK\r\nContent-Length: 1\r\n\r\nh");
+
+    CHECK_EQ(get(session, HOST "/a"), 200);
+    CHECK_EQ(read_all(session, body, sizeof(body), 64), 4);
+    CHECK(strcmp(body, "abcd") == 0);
+
+    /* the same server, the connection is reused */
+    CHECK_EQ(get(session, HOST "/b"), 200);
+    CHECK_EQ(read_all(session, body, sizeof(body), 64), 2);
+    CHECK(strcmp(body, "ef") == 0);
+    CHECK_EQ(connects, 1);
+
+    CHECK_EQ(get(session, HOST "/c"), 200);
+    CHECK_EQ(read_all(session, body, sizeof(body), 64), 1);
+    CHECK(!webclient_reusable(session));
+
+    /* the server closed the connection, then HTTP/1.0 isn't kept either */
+    CHECK_EQ(get(session, HOST "/d"), 200);
+    CHECK_EQ(connects, 2);
+    CHECK_EQ(read_all(session, body, sizeof(body), 64), 1);
+    CHECK(!webclient_reusable(session));
+    CHECK_EQ(count(requests, "GET "), 4);
+
+    webclient_close(session);
+}
+
+static void test_header_split(void)
+{
+    static const char response[] = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n"
+            "Content-Length: 5\r\nX-Single: a\nb\r\n\r\nsplit";
+    struct webclient_session *session;
+    char body[64];
+    size_t fragment;
+
+    /* every header line is split across the reads */
+    for (fragment = 1; fragment <= 5; fragment += 2)
+    {
+        session = webclient_session_create(1024);
+        record(fragment);
+        respond(response);
+
+        CHECK_EQ(get(session, HOST "/split"), 200);
+        CHECK_EQ(webclient_content_length_get(session), 5);
+        CHECK(webclient_header_fields_get(session, "Content-Type") != RT_NULL &&
+              strcmp(webclient_header_fields_get(session, "Content-Type"), "text/plain") == 0);
+        /* a single '\n' is a part of the line */
+        CHECK(webclient_header_fields_get(session, "X-Single") != RT_NULL &&
+              strcmp(webclient_header_fields_get(session, "X-Single"), "a\nb") == 0);
+        CHECK_EQ(read_all(session, body, sizeof(body), 64), 5);
+        CHECK(strcmp(body, "split") == 0);
+        CHECK(webclient_reusable(session));
+
+        webclient_close(session);
+    }
+}
+
+static void test_header_overlong(void)
+{
+    struct webclient_session *session;
+    char response[512], body[64];
+
+    /* the rest of the line must not be taken as the next header */
+    snprintf(response, sizeof(response), "HTTP/1.1 200 OK\r\nX-Pad: %0100dContent-Length: 3\r\n"
+             "Content-Length: 6\r\n\r\nabcdef", 0);
+    session = webclient_session_create(64);
+    record(1024);
+    respond(response);
+    CHECK_EQ(get(session, HOST "/long"), -WEBCLIENT_NOMEM);
+    CHECK(webclient_content_length_get(session) != 3);
+    webclient_close(session);
+
+    /* the line which fills the buffer exactly is too long for the header */
+    snprintf(response, sizeof(response), "HTTP/1.1 200 OK\r\nX-Pad: %040d\r\n\r\n", 0);
+    session = webclient_session_create(64);
+    record(1024);
+    respond(response);
+    CHECK(get(session, HOST "/fill") < 0);
+    webclient_close(session);
+
+    /* the chunk size line with a long extension isn't taken as the data */
+    snprintf(response, sizeof(response), "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+             "3\r\nabc\r\n3;ext=%080d\r\ndef\r\n0\r\n\r\n", 0);
+    session = webclient_session_create(1024);
+    record(1024);
+    respond(response);
+    CHECK_EQ(get(session, HOST "/ext"), 200);
+    read_all(session, body, sizeof(body), 64);
+    CHECK(strcmp(body, "abc") == 0);
+    CHECK(!webclient_reusable(session));
+    webclient_close(session);
+}
+
+static void test_shard(void)
+{
+    struct webclient_session *session = webclient_session_create(1024);
+
+    webclient_register_shard_position_function(session, shard_handle);
+
+    /* redirected on the same server, the body is received in pieces */
+    record(7);
+    respond("HTTP/1.1 302 Found\r\nLocation: " HOST "/fw\r\nContent-Length: 3\r\n\r\nxyz");
+    respond("HTTP/1.1 206 Partial Content\r\nContent-Length: 10\r\n\r\n0123456789");
+    CHECK_EQ(webclient_shard_position_function(session, HOST "/old", 0, 10, 4), 0);
+    CHECK(strcmp(shard, "0123456789") == 0);
+    CHECK(strstr(requests, "Range: bytes=0-9") != RT_NULL);
+    CHECK_EQ(connects, 1);
+
+    /* the short body is resumed on a new connection */
+    record(1024);
+    respond("HTTP/1.1 206 Partial Content\r\nContent-Length: 10\r\n\r\n0123");
+    respond("HTTP/1.1 206 Partial Content\r\nContent-Length: 6\r\n\r\n456789");
+    CHECK_EQ(webclient_shard_position_function(session, HOST "/fw", 0, 10, 4), 0);
+    CHECK(strcmp(shard, "0123456789") == 0);
+    CHECK(strstr(requests, "Range: bytes=4-9") != RT_NULL);
+
+    webclient_close(session);
+}
+
+static void test_shard_no_progress(void)
+{
+    struct webclient_session *session = webclient_session_create(1024);
+    int i;
+
+    webclient_register_shard_position_function(session, shard_handle);
+
+    /* the empty bodies on the kept connection don't make progress */
+    record(1024);
+    for (i = 0; i < QUEUE_SIZE; i++)
+        respond("HTTP/1.1 206 Partial Content\r\nContent-Length: 0\r\n\r\n");
+    CHECK_EQ(webclient_shard_position_function(session, HOST "/fw", 0, 10, 4), -WEBCLIENT_ERROR);
+    CHECK_EQ(count(requests, "GET "), WEBCLIENT_SHARD_RETRY + 1);
+    CHECK_EQ(shard_len, 0);
+
+    /* the data resets the retries */
+    record(1024);
+    respond("HTTP/1.1 206 Partial Content\r\nContent-Length: 0\r\n\r\n");
+    respond("HTTP/1.1 206 Partial Content\r\nContent-Length: 0\r\n\r\n");
+    respond("HTTP/1.1 206 Partial Content\r\nContent-Length: 2\r\n\r\n01");
+    respond("HTTP/1.1 206 Partial Content\r\nContent-Length: 0\r\n\r\n");
+    respond("HTTP/1.1 206 Partial Content\r\nContent-Length: 0\r\n\r\n");
+    respond("HTTP/1.1 206 Partial Content\r\nContent-Length: 2\r\n\r\n23");
+    CHECK_EQ(webclient_shard_position_function(session, HOST "/fw", 0, 4, 4), 0);
+    CHECK(strcmp(shard, "0123") == 0);
+
+    webclient_close(session);
+}
+
+static void test_redirect_loop(void)
+{
+    struct webclient_session *session = webclient_session_create(1024);
+    int i;
+
+    webclient_register_shard_position_function(session, shard_handle);
+
+    record(1024);
+    for (i = 0; i < QUEUE_SIZE; i++)
+        respond("HTTP/1.1 302 Found\r\nLocation: " HOST "/loop\r\nContent-Length: 0\r\n\r\n");
+    CHECK_EQ(webclient_shard_position_function(session, HOST "/loop", 0, 10, 4), -WEBCLIENT_ERROR);
+    CHECK_EQ(count(requests, "GET "), WEBCLIENT_REDIRECT_MAX + 1);
+
+    /* the get returns the redirection which isn't followed */
+    record(1024);
+    for (i = 0; i < QUEUE_SIZE; i++)
+        respond("HTTP/1.1 301 Moved Permanently\r\nLocation: " HOST "/loop\r\nContent-Length: 0\r\n\r\n");
+    CHECK_EQ(get(session, HOST "/loop"), 301);
+    CHECK_EQ(count(requests, "GET "), WEBCLIENT_REDIRECT_MAX + 1);
+
+    webclient_close(session);
+}
+
+int main(void)
+{
+    UNIT_RUN(test_chunked);
+    UNIT_RUN(test_keep_alive);
+    UNIT_RUN(test_header_split);
+    UNIT_RUN(test_header_overlong);
+    UNIT_RUN(test_shard);
+    UNIT_RUN(test_shard_no_progress);
+    UNIT_RUN(test_redirect_loop);
+
+    return UNIT_RESULT();
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2006-2024 Evlers Developers
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date         Author      Notes
+ * 2024-10-28   Evlers      first implementation
+ */
+
+#ifndef _UNIT_H_
+#define _UNIT_H_
+
+#include <stdio.h>
+
+/* a minimal check harness for the host tests, a test returns the number of failed checks */
+
+static int unit_failed;
+
+#define CHECK(cond)                                                             \
+    do {                                                                        \
+        if (!(cond))                                                            \
+        {                                                                       \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);     \
+            unit_failed ++;                                                     \
+        }                                                                       \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                          \
+    do {                                                                        \
+        long long _a = (long long)(a), _b = (long long)(b);                     \
+        if (_a != _b)                                                           \
+        {                                                                       \
+            printf("%s:%d: check failed: %s == %s (%lld != %lld)\n",            \
+                   __FILE__, __LINE__, #a, #b, _a, _b);                         \
+            unit_failed ++;                                                     \
+        }                                                                       \
+    } while (0)
+
+#define UNIT_RUN(test)                                                          \
+    do {                                                                        \
+        int _before = unit_failed;                                              \
+        test();                                                                 \
+        printf("%-40s %s\n", #test, (unit_failed == _before) ? "ok" : "FAILED"); \
+    } while (0)
+
+#define UNIT_RESULT()   (unit_failed ? 1 : 0)
+
+#endif /* _UNIT_H_ */
@@ -0,0 +1,177 @@
+# -*- coding: UTF-8 -*-
+
+# Copyright (c) 2006-2024 LGT Development Team
+#
+# Change Logs:
+# Date           Author       Notes
+# 2024-10-19     Evlers       first implementation
+
+# Decode the binary log stream of utility/blog.c into text.
+# The format strings are read from the ELF file:
+#   1) gcc builds keep them in the non-loaded '.blog_fmt' section, the ID is the offset in this section.
+#   2) other toolchains use the address of the string in the loaded sections.
+#
+# Usage:
+#   python blog_decode.py rtthread.elf blog.bin [--clock 240000000]
+#   JLinkRTTLogger ... -RTTChannel 2 /dev/stdout | python blog_decode.py rtthread.elf -
+#   python blog_decode.py rtthread.elf /dev/ttyUSB0   (the uart is configured raw, e.g. stty -F /dev/ttyUSB0 raw 921600)
+
+import argparse
+import re
+import struct
+import sys
+
+BLOG_SYNC = 0xA5
+BLOG_HEAD_WORDS = 3
+LEVELS = {3: 'E', 4: 'W', 6: 'I', 7: 'D'}
+
+
+class ElfStrings:
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.data = f.read()
+        if self.data[:4] != b'\x7fELF' or self.data[4] != 1:
+            raise ValueError('only the 32-bit ELF file is supported')
+
+        shoff, = struct.unpack_from('<I', self.data, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from('<HHH', self.data, 0x2E)
+
+        sections = []
+        for i in range(shnum):
+            name, stype, flags, addr, offset, size = struct.unpack_from('<IIIIII', self.data, shoff + i * shentsize)
+            sections.append([name, stype, flags, addr, offset, size])
+
+        strtab = sections[shstrndx]
+        self.fmt_section = None
+        self.loaded = []
+        for sec in sections:
+            sec[0] = self._cstring(strtab[4] + sec[0])
+            if sec[0] == '.blog_fmt':
+                self.fmt_section = sec
+            elif sec[1] == 1 and sec[5] > 0:  # SHT_PROGBITS
+                self.loaded.append(sec)
+
+    def _cstring(self, offset):
+        end = self.data.index(b'\0', offset)
+        return self.data[offset:end].decode('utf-8', 'replace')
+
+    def lookup(self, fmt_id):
+        if self.fmt_section is not None:
+            if fmt_id < self.fmt_section[5]:
+                return self._cstring(self.fmt_section[4] + fmt_id)
+            return None
+
+        for sec in self.loaded:
+            if sec[3] <= fmt_id < sec[3] + sec[5]:
+                return self._cstring(sec[4] + fmt_id - sec[3])
+        return None
+
+
+CONVERSION = re.compile(r'%([-+ #0]*)(\d*)(?:\.(\d+))?(hh|h|ll|l|z|t|j)?([diouxXcp%s])')
+
+
+def c_format(fmt, args):
+    """format the C printf string with the 32-bit raw arguments"""
+    args = list(args)
+
+    def replace(m):
+        flags, width, precision, _, conv = m.groups()
+        if conv == '%':
+            return '%'
+        value = args.pop(0) if args else 0
+        spec = '%' + flags + width + ('.' + precision if precision else '')
+        if conv in 'di':
+            value = value - (1 << 32) if value & 0x80000000 else value
+            return (spec + 'd') % value
+        if conv == 'c':
+            return chr(value & 0xFF)
+        if conv == 'p':
+            return '0x%08x' % value
+        if conv == 's':
+            return '<str@0x%08x>' % value
+        return (spec + conv) % value
+
+    return CONVERSION.sub(replace, fmt)
+
+
+class Decoder:
+    """decode the records incrementally, the stream may end in the middle of a record"""
+
+    def __init__(self, elf, clock, out):
+        self.elf = elf
+        self.clock = clock
+        self.out = out
+        self.buffer = bytearray()
+        self.last_seq = None
+        self.base = 0
+        self.last_stamp = None
+
+    def feed(self, chunk):
+        self.buffer += chunk
+        data = self.buffer
+        pos = 0
+
+        while pos + BLOG_HEAD_WORDS * 4 <= len(data):
+            head, fmt_id, stamp = struct.unpack_from('<III', data, pos)
+            if (head >> 24) != BLOG_SYNC:
+                # resynchronize on the next word
+                pos += 1
+                continue
+
+            level = (head >> 20) & 0x0F
+            nargs = (head >> 16) & 0x0F
+            seq = head & 0xFFFF
+            if pos + (BLOG_HEAD_WORDS + nargs) * 4 > len(data):
+                # wait for the rest of the record
+                break
+            args = struct.unpack_from('<%dI' % nargs, data, pos + BLOG_HEAD_WORDS * 4)
+            pos += (BLOG_HEAD_WORDS + nargs) * 4
+            self._record(level, seq, fmt_id, stamp, args)
+
+        del self.buffer[:pos]
+
+    def _record(self, level, seq, fmt_id, stamp, args):
+        if self.last_seq is not None and seq != ((self.last_seq + 1) & 0xFFFF):
+            self.out.write('*** %d records lost ***\n' % ((seq - self.last_seq - 1) & 0xFFFF))
+        self.last_seq = seq
+
+        # extend the 32-bit cycle counter, it wraps in about 17 seconds at 240MHz
+        if self.last_stamp is not None and stamp < self.last_stamp:
+            self.base += 1 << 32
+        self.last_stamp = stamp
+
+        fmt = self.elf.lookup(fmt_id)
+        text = c_format(fmt, args) if fmt is not None else '<unknown format id 0x%08x>' % fmt_id
+        self.out.write('[%12.6f] %s: %s\n' % ((self.base + stamp) / self.clock, LEVELS.get(level, str(level)), text))
+
+
+def decode(elf, stream, clock, out):
+    decoder = Decoder(elf, clock, out)
+    # read1() returns what is available, a live RTT/UART stream is printed as it arrives
+    read = getattr(stream, 'read1', stream.read)
+
+    while True:
+        chunk = read(4096)
+        if not chunk:
+            break
+        decoder.feed(chunk)
+        out.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='decode the binary log stream of utility/blog.c')
+    parser.add_argument('elf', help='the ELF file of the firmware')
+    parser.add_argument('input', help='the binary log stream, "-" for stdin')
+    parser.add_argument('--clock', type=float, default=240e6, help='the core clock in Hz (default: 240MHz)')
+    args = parser.parse_args()
+
+    elf = ElfStrings(args.elf)
+    if args.input == '-':
+        decode(elf, sys.stdin.buffer, args.clock, sys.stdout)
+    else:
+        with open(args.input, 'rb') as stream:
+            decode(elf, stream, args.clock, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()
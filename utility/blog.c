@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2006-2024 LGT Development Team
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-19     Evlers       first implementation
+ */
+
+#include <stdarg.h>
+#include <string.h>
+
+#include "board.h"
+
+#include "rthw.h"
+#include "rtthread.h"
+
+#include "delay.h"
+#include "blog.h"
+
+#ifdef BLOG_OUTPUT_RTT
+#include "SEGGER_RTT.h"
+#endif
+
+#ifndef BLOG_BUFFER_WORDS
+#define BLOG_BUFFER_WORDS       1024
+#endif
+
+#ifndef BLOG_FLUSH_PERIOD
+#define BLOG_FLUSH_PERIOD       20
+#endif
+
+#ifndef BLOG_THREAD_PRIORITY
+#define BLOG_THREAD_PRIORITY    (RT_THREAD_PRIORITY_MAX - 2)
+#endif
+
+#ifndef BLOG_THREAD_STACK_SIZE
+#define BLOG_THREAD_STACK_SIZE  1024
+#endif
+
+#ifndef BLOG_RTT_CHANNEL
+#define BLOG_RTT_CHANNEL        2
+#endif
+
+#ifndef BLOG_RTT_BUFFER_SIZE
+#define BLOG_RTT_BUFFER_SIZE    2048
+#endif
+
+#if (BLOG_BUFFER_WORDS & (BLOG_BUFFER_WORDS - 1)) != 0
+#error "BLOG_BUFFER_WORDS must be a power of 2"
+#endif
+
+#define BLOG_RING_MASK          (BLOG_BUFFER_WORDS - 1)
+#define BLOG_HEAD_WORDS         3
+
+/*
+ * The ring has a single consumer (the blog thread) that never takes a lock.
+ * The producers (threads and interrupts) only mask the interrupts while copying a few words,
+ * so a record is always complete before the write index is published.
+ */
+static uint32_t ring[BLOG_BUFFER_WORDS];
+static volatile uint32_t ring_head;
+static volatile uint32_t ring_tail;
+static uint32_t sequence;
+static uint32_t dropped;
+static struct rt_semaphore blog_sem;
+static rt_bool_t blog_ready = RT_FALSE;
+
+#ifdef BLOG_OUTPUT_DEVICE
+static rt_device_t blog_dev;
+#endif
+
+void blog_write (uint32_t level, uint32_t id, uint32_t nargs, ...)
+{
+    uint32_t args[BLOG_ARGS_MAX];
+    uint32_t head, used, len;
+    rt_base_t irq_level;
+    va_list ap;
+
+    if (nargs > BLOG_ARGS_MAX)
+    {
+        nargs = BLOG_ARGS_MAX;
+    }
+
+    va_start(ap, nargs);
+    for (uint32_t i = 0; i < nargs; i ++)
+    {
+        args[i] = va_arg(ap, uint32_t);
+    }
+    va_end(ap);
+
+    len = BLOG_HEAD_WORDS + nargs;
+
+    irq_level = rt_hw_interrupt_disable();
+
+    head = ring_head;
+    used = head - ring_tail;
+    if (BLOG_BUFFER_WORDS - used < len)
+    {
+        dropped ++;
+        sequence ++;
+        rt_hw_interrupt_enable(irq_level);
+        return;
+    }
+
+    ring[head ++ & BLOG_RING_MASK] = ((uint32_t)BLOG_SYNC << 24) | ((level & 0x0F) << 20) | (nargs << 16) | (sequence ++ & 0xFFFF);
+    ring[head ++ & BLOG_RING_MASK] = id;
+    ring[head ++ & BLOG_RING_MASK] = get_cpu_tick();
+    for (uint32_t i = 0; i < nargs; i ++)
+    {
+        ring[head ++ & BLOG_RING_MASK] = args[i];
+    }
+    ring_head = head;
+
+    rt_hw_interrupt_enable(irq_level);
+
+    /* wake up the consumer early when the ring is over half full */
+    if (blog_ready && used < BLOG_BUFFER_WORDS / 2 && used + len >= BLOG_BUFFER_WORDS / 2)
+    {
+        rt_sem_release(&blog_sem);
+    }
+}
+
+uint32_t blog_dropped (void)
+{
+    return dropped;
+}
+
+#ifdef BLOG_OUTPUT_CONSOLE
+/* format the records on the target, the ID is the address of the format string */
+static void output_records (void)
+{
+    uint32_t tail = ring_tail, head = ring_head;
+    uint32_t words[BLOG_HEAD_WORDS + BLOG_ARGS_MAX] = { 0 };
+
+    while (tail != head)
+    {
+        uint32_t nargs = (ring[tail & BLOG_RING_MASK] >> 16) & 0x0F;
+        uint32_t *args = &words[BLOG_HEAD_WORDS];
+
+        for (uint32_t i = 0; i < BLOG_HEAD_WORDS + nargs; i ++)
+        {
+            words[i] = ring[tail ++ & BLOG_RING_MASK];
+        }
+
+        /* the unused arguments are ignored by the formatter */
+        rt_kprintf("[%u] ", words[2]);
+        rt_kprintf((const char *)words[1], args[0], args[1], args[2], args[3], args[4], args[5], args[6], args[7]);
+        rt_kprintf("\n");
+
+        ring_tail = tail;
+    }
+}
+#else
+static rt_size_t output_write (const void *data, rt_size_t size)
+{
+#if defined(BLOG_OUTPUT_RTT)
+    return SEGGER_RTT_Write(BLOG_RTT_CHANNEL, data, size);
+#elif defined(BLOG_OUTPUT_DEVICE)
+    return rt_device_write(blog_dev, 0, data, size);
+#else
+    return size;
+#endif
+}
+
+/* output the raw words, each write is limited to the contiguous part of the ring */
+static void output_records (void)
+{
+    uint32_t tail = ring_tail, head = ring_head;
+
+    while (tail != head)
+    {
+        uint32_t index = tail & BLOG_RING_MASK;
+        uint32_t count = head - tail;
+        rt_size_t size;
+
+        if (count > BLOG_BUFFER_WORDS - index)
+        {
+            count = BLOG_BUFFER_WORDS - index;
+        }
+#ifdef BLOG_OUTPUT_RTT
+        if (count > BLOG_RTT_BUFFER_SIZE / 2 / sizeof(uint32_t))
+        {
+            count = BLOG_RTT_BUFFER_SIZE / 2 / sizeof(uint32_t);
+        }
+#endif
+
+        size = output_write(&ring[index], count * sizeof(uint32_t));
+        if (size != count * sizeof(uint32_t))
+        {
+            /* the output is busy, try again in the next period */
+            break;
+        }
+
+        tail += count;
+        ring_tail = tail;
+    }
+}
+#endif /* BLOG_OUTPUT_CONSOLE */
+
+void blog_flush (void)
+{
+    if (blog_ready)
+    {
+        rt_sem_release(&blog_sem);
+    }
+}
+
+static void blog_thread_entry (void *parameter)
+{
+    while (1)
+    {
+        rt_sem_take(&blog_sem, rt_tick_from_millisecond(BLOG_FLUSH_PERIOD));
+        output_records();
+    }
+}
+
+static int blog_init (void)
+{
+#if defined(BLOG_OUTPUT_RTT)
+    static uint8_t rtt_buffer[BLOG_RTT_BUFFER_SIZE];
+
+    /* a record is either written completely or skipped, the stream never gets out of sync */
+    SEGGER_RTT_ConfigUpBuffer(BLOG_RTT_CHANNEL, "blog", rtt_buffer, sizeof(rtt_buffer), SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+#elif defined(BLOG_OUTPUT_DEVICE)
+    rt_err_t result;
+
+    blog_dev = rt_device_find(BLOG_DEVICE_NAME);
+    if (blog_dev == RT_NULL)
+    {
+        rt_kprintf("blog: the output device %s is not found!\n", BLOG_DEVICE_NAME);
+        return -RT_ERROR;
+    }
+
+    /* transmit by dma first, the uart falls back to the interrupt mode when its tx dma is not enabled */
+    result = rt_device_open(blog_dev, RT_DEVICE_OFLAG_RDWR | RT_DEVICE_FLAG_DMA_TX);
+    if (result == -RT_EIO)
+    {
+        result = rt_device_open(blog_dev, RT_DEVICE_OFLAG_RDWR | RT_DEVICE_FLAG_INT_TX);
+    }
+    if (result != RT_EOK)
+    {
+        rt_kprintf("blog: open the output device %s failed!\n", BLOG_DEVICE_NAME);
+        return -RT_ERROR;
+    }
+#endif
+
+    rt_sem_init(&blog_sem, "blog", 0, RT_IPC_FLAG_FIFO);
+
+    rt_thread_startup(rt_thread_create("blog", blog_thread_entry, RT_NULL,
+                      BLOG_THREAD_STACK_SIZE, BLOG_THREAD_PRIORITY, 10));
+
+    blog_ready = RT_TRUE;
+
+    return RT_EOK;
+}
+INIT_COMPONENT_EXPORT(blog_init);
+
+static void blog_info (void)
+{
+    rt_kprintf("buffer: %u words, used: %u words\n", BLOG_BUFFER_WORDS, ring_head - ring_tail);
+    rt_kprintf("dropped records: %u\n", dropped);
+}
+MSH_CMD_EXPORT(blog_info, print the binary logger status);
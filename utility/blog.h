@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2006-2024 LGT Development Team
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-19     Evlers       first implementation
+ */
+
+#ifndef _BLOG_H_
+#define _BLOG_H_
+
+#include <stdint.h>
+
+/*
+ * Deferred binary logger.
+ * The call site only pushes the format string ID, a timestamp and the raw arguments into a ring buffer,
+ * the formatting is done later by a low priority thread or by the host tool (tools/blog/blog_decode.py).
+ * Only the integer, character and pointer conversions are supported (up to 8 arguments of 32 bits),
+ * the strings (%s) and floating point arguments can not be deferred.
+ *
+ * Record (little endian words):
+ * word0: sync(0xA5, bits 31-24), level(bits 23-20), argument count(bits 19-16), sequence number(bits 15-0)
+ * word1: format string ID
+ * word2: timestamp in cpu cycles
+ * word3+: arguments
+ */
+
+#define BLOG_SYNC               0xA5
+#define BLOG_ARGS_MAX           8
+
+/* same values as the rtdbg levels */
+#define BLOG_LVL_ERROR          3
+#define BLOG_LVL_WARNING        4
+#define BLOG_LVL_INFO           6
+#define BLOG_LVL_LOG            7
+
+/* with gcc the format strings are kept in a non-loaded section and the ID is the offset in this section,
+ * otherwise the ID is the address of the format string in the flash.
+ */
+#if defined(__GNUC__) && !defined(__ARMCC_VERSION) && !defined(BLOG_OUTPUT_CONSOLE)
+#define BLOG_FMT_SECTION        __attribute__((section(".blog_fmt")))
+#else
+#define BLOG_FMT_SECTION
+#endif
+
+#define _BLOG_NARGS(...)        _BLOG_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define _BLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, N, ...) N
+
+#ifdef UTILITY_USING_BLOG
+
+#define BLOG(level, fmt, ...)                                                       \
+    do                                                                              \
+    {                                                                               \
+        static const char _blog_fmt[] BLOG_FMT_SECTION = fmt;                       \
+        blog_write((level), (uint32_t)_blog_fmt,                                    \
+                   _BLOG_NARGS(__VA_ARGS__), ##__VA_ARGS__);                        \
+    }                                                                               \
+    while (0)
+
+void blog_write (uint32_t level, uint32_t id, uint32_t nargs, ...);
+void blog_flush (void);
+uint32_t blog_dropped (void);
+
+#else
+
+#define BLOG(level, fmt, ...)
+
+#endif /* UTILITY_USING_BLOG */
+
+#define BLOG_E(fmt, ...)        BLOG(BLOG_LVL_ERROR, fmt, ##__VA_ARGS__)
+#define BLOG_W(fmt, ...)        BLOG(BLOG_LVL_WARNING, fmt, ##__VA_ARGS__)
+#define BLOG_I(fmt, ...)        BLOG(BLOG_LVL_INFO, fmt, ##__VA_ARGS__)
+#define BLOG_D(fmt, ...)        BLOG(BLOG_LVL_LOG, fmt, ##__VA_ARGS__)
+
+#endif /* _BLOG_H_ */
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2006-2024 LGT Development Team
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-19     Evlers       first implementation
+ */
+
+#include <string.h>
+
+#include "prof_stat.h"
+
+static uint32_t bit_length (uint32_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return value ? 32 - __builtin_clz(value) : 0;
+#else
+    uint32_t len = 0;
+
+    while (value)
+    {
+        value >>= 1;
+        len ++;
+    }
+
+    return len;
+#endif
+}
+
+void prof_stat_init (struct prof_stat *stat)
+{
+    memset(stat, 0, sizeof(struct prof_stat));
+    stat->min = UINT32_MAX;
+}
+
+uint32_t prof_stat_hist_bin (uint32_t cycles)
+{
+    uint32_t bin = bit_length(cycles >> PROF_STAT_HIST_SHIFT);
+
+    return (bin < PROFILER_HIST_BINS) ? bin : (PROFILER_HIST_BINS - 1);
+}
+
+/* the exclusive upper limit of the bin in cycles, the last bin is unlimited */
+uint32_t prof_stat_hist_bin_limit (uint32_t bin)
+{
+    if (bin >= PROFILER_HIST_BINS - 1 || bin + PROF_STAT_HIST_SHIFT >= 32)
+    {
+        return UINT32_MAX;
+    }
+
+    return (uint32_t)1 << (bin + PROF_STAT_HIST_SHIFT);
+}
+
+void prof_stat_update (struct prof_stat *stat, uint32_t cycles)
+{
+    stat->count ++;
+    stat->total += cycles;
+
+    if (cycles < stat->min)
+    {
+        stat->min = cycles;
+    }
+    if (cycles > stat->max)
+    {
+        stat->max = cycles;
+    }
+
+    stat->hist[prof_stat_hist_bin(cycles)] ++;
+}
+
+void prof_stat_merge (struct prof_stat *dst, const struct prof_stat *src)
+{
+    if (src->count == 0)
+    {
+        return;
+    }
+
+    dst->count += src->count;
+    dst->total += src->total;
+
+    if (src->min < dst->min)
+    {
+        dst->min = src->min;
+    }
+    if (src->max > dst->max)
+    {
+        dst->max = src->max;
+    }
+
+    for (uint32_t i = 0; i < PROFILER_HIST_BINS; i ++)
+    {
+        dst->hist[i] += src->hist[i];
+    }
+}
+
+uint32_t prof_stat_avg (const struct prof_stat *stat)
+{
+    if (stat->count == 0)
+    {
+        return 0;
+    }
+
+    return (uint32_t)(stat->total / stat->count);
+}
+
+/* the upper limit (in cycles) of the bin holding the given percentile, clamped to the max sample */
+uint32_t prof_stat_percentile (const struct prof_stat *stat, uint32_t percent)
+{
+    uint64_t target, sum = 0;
+    uint32_t limit;
+
+    if (stat->count == 0)
+    {
+        return 0;
+    }
+
+    if (percent > 100)
+    {
+        percent = 100;
+    }
+
+    target = ((uint64_t)stat->count * percent + 99) / 100;
+
+    for (uint32_t i = 0; i < PROFILER_HIST_BINS; i ++)
+    {
+        sum += stat->hist[i];
+        if (sum >= target && sum != 0)
+        {
+            limit = prof_stat_hist_bin_limit(i);
+            return (limit > stat->max) ? stat->max : limit;
+        }
+    }
+
+    return stat->max;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2006-2024 LGT Development Team
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-19     Evlers       first implementation
+ */
+
+#ifndef _PROF_STAT_H_
+#define _PROF_STAT_H_
+
+#include <stdint.h>
+
+/* this module does not depend on the rt-thread, it can be built on the host with PROF_STAT_HOST defined */
+
+/* every file must see the PROFILER_HIST_BINS of the rtconfig.h, or the size of the struct differs */
+#ifndef PROF_STAT_HOST
+#include <rtconfig.h>
+#endif
+
+#ifndef PROFILER_HIST_BINS
+#define PROFILER_HIST_BINS      16
+#endif
+
+/* the first bin collects the samples less than (1 << PROF_STAT_HIST_SHIFT) cycles,
+ * each next bin doubles the range, the last bin collects all the remaining samples.
+ */
+#define PROF_STAT_HIST_SHIFT    4
+
+struct prof_stat
+{
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t hist[PROFILER_HIST_BINS];
+};
+
+void prof_stat_init (struct prof_stat *stat);
+void prof_stat_update (struct prof_stat *stat, uint32_t cycles);
+void prof_stat_merge (struct prof_stat *dst, const struct prof_stat *src);
+uint32_t prof_stat_avg (const struct prof_stat *stat);
+uint32_t prof_stat_hist_bin (uint32_t cycles);
+uint32_t prof_stat_hist_bin_limit (uint32_t bin);
+uint32_t prof_stat_percentile (const struct prof_stat *stat, uint32_t percent);
+
+#endif /* _PROF_STAT_H_ */
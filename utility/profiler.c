@@ -0,0 +1,632 @@
+/*
+ * Copyright (c) 2006-2024 LGT Development Team
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-19     Evlers       first implementation
+ */
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "board.h"
+
+#include "rthw.h"
+#include "rtthread.h"
+
+#include "profiler.h"
+
+#if defined(PKG_USING_SEGGER_RTT) && defined(SEGGER_RTT_ENABLE)
+#include "SEGGER_RTT.h"
+#define PROF_USING_RTT
+#endif
+
+/* exception number of the gd32f4xx: 16 system exceptions + 91 external interrupts */
+#define PROF_EXCEPTION_NUM          (16 + 91)
+#define PROF_ISR_NEST_MAX           8
+
+#ifndef PROFILER_IRQ_MAX
+#define PROFILER_IRQ_MAX            16
+#endif
+
+#ifndef PROFILER_THREAD_MAX
+#define PROFILER_THREAD_MAX         32
+#endif
+
+#ifndef PROFILER_RTT_CHANNEL
+#define PROFILER_RTT_CHANNEL        1
+#endif
+
+#ifndef PROFILER_RTT_BUFFER_SIZE
+#define PROFILER_RTT_BUFFER_SIZE    1024
+#endif
+
+struct prof_irq
+{
+    uint32_t irq;
+    struct prof_stat stat;
+};
+
+struct prof_thread
+{
+    rt_thread_t thread;
+    char name[RT_NAME_MAX];
+    uint64_t cycles;
+    uint32_t switches;
+};
+
+static struct prof_probe *probe_list;
+
+#ifdef PROFILER_USING_ISR
+static uint8_t irq_slot[PROF_EXCEPTION_NUM];  /* index + 1 of irq_tab, 0 is not assigned */
+static struct prof_irq irq_tab[PROFILER_IRQ_MAX];
+static uint32_t irq_used;
+static uint32_t isr_start[PROF_ISR_NEST_MAX];
+static uint32_t isr_nest;
+#endif
+
+/* cycles spent in the outermost interrupt services, excluded from the thread time */
+static uint32_t isr_cycles;
+static uint64_t isr_total;
+
+#ifdef PROFILER_USING_THREAD
+static struct prof_thread thread_tab[PROFILER_THREAD_MAX];
+static uint32_t switch_stamp;
+static uint32_t switch_isr_cycles;
+#endif
+
+void prof_probe_record (struct prof_probe *probe, uint32_t cycles)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+
+    if (!probe->registered)
+    {
+        prof_stat_init(&probe->stat);
+        probe->next = probe_list;
+        probe_list = probe;
+        probe->registered = 1;
+    }
+
+    prof_stat_update(&probe->stat, cycles);
+
+    rt_hw_interrupt_enable(level);
+}
+
+#ifdef PROFILER_USING_ISR
+static struct prof_stat *irq_stat_get (uint32_t irq)
+{
+    uint8_t slot;
+
+    if (irq >= PROF_EXCEPTION_NUM)
+    {
+        return RT_NULL;
+    }
+
+    slot = irq_slot[irq];
+    if (slot == 0)
+    {
+        if (irq_used >= PROFILER_IRQ_MAX)
+        {
+            return RT_NULL;
+        }
+
+        irq_tab[irq_used].irq = irq;
+        prof_stat_init(&irq_tab[irq_used].stat);
+        slot = irq_slot[irq] = ++ irq_used;
+    }
+
+    return &irq_tab[slot - 1].stat;
+}
+
+/* the interrupt hooks are called by the kernel with the interrupt disabled */
+static void isr_enter_hook (void)
+{
+    if (isr_nest < PROF_ISR_NEST_MAX)
+    {
+        isr_start[isr_nest] = get_cpu_tick();
+    }
+    isr_nest ++;
+}
+
+static void isr_leave_hook (void)
+{
+    uint32_t cycles, now = get_cpu_tick();
+    struct prof_stat *stat;
+
+    if (isr_nest == 0)
+    {
+        return;
+    }
+
+    if (-- isr_nest >= PROF_ISR_NEST_MAX)
+    {
+        return;
+    }
+
+    cycles = now - isr_start[isr_nest];
+    if (isr_nest == 0)
+    {
+        isr_cycles += cycles;
+        isr_total += cycles;
+    }
+
+    stat = irq_stat_get(__get_IPSR());
+    if (stat != RT_NULL)
+    {
+        prof_stat_update(stat, cycles);
+    }
+}
+#endif /* PROFILER_USING_ISR */
+
+#ifdef PROFILER_USING_THREAD
+static struct prof_thread *thread_slot_get (struct rt_thread *thread)
+{
+    const char *name = ((struct rt_object *)thread)->name;
+    struct prof_thread *empty = RT_NULL;
+
+    /* a static thread is detached before its last switch, it never gets a slot again */
+    if (rt_object_get_type((rt_object_t)thread) != RT_Object_Class_Thread)
+    {
+        return RT_NULL;
+    }
+
+    for (uint32_t i = 0; i < PROFILER_THREAD_MAX; i ++)
+    {
+        if (thread_tab[i].thread == thread)
+        {
+            /* the thread control block is reused by another thread */
+            if (strncmp(thread_tab[i].name, name, RT_NAME_MAX))
+            {
+                strncpy(thread_tab[i].name, name, RT_NAME_MAX);
+                thread_tab[i].cycles = 0;
+                thread_tab[i].switches = 0;
+            }
+            return &thread_tab[i];
+        }
+
+        if (empty == RT_NULL && thread_tab[i].thread == RT_NULL)
+        {
+            empty = &thread_tab[i];
+        }
+    }
+
+    if (empty != RT_NULL)
+    {
+        empty->thread = thread;
+        strncpy(empty->name, name, RT_NAME_MAX);
+    }
+
+    return empty;
+}
+
+/* the scheduler hook is called by the kernel with the interrupt disabled */
+static void scheduler_hook (struct rt_thread *from, struct rt_thread *to)
+{
+    uint32_t now = get_cpu_tick();
+    struct prof_thread *slot;
+
+    slot = thread_slot_get(from);
+    if (slot != RT_NULL)
+    {
+        slot->cycles += (now - switch_stamp) - (isr_cycles - switch_isr_cycles);
+    }
+
+    slot = thread_slot_get(to);
+    if (slot != RT_NULL)
+    {
+        slot->switches ++;
+    }
+
+    switch_stamp = now;
+    switch_isr_cycles = isr_cycles;
+}
+
+/* free the slot of a deleted or detached thread, so the table never fills up with the dead threads */
+static void thread_detach_hook (struct rt_object *object)
+{
+    rt_base_t level;
+
+    if (rt_object_get_type(object) != RT_Object_Class_Thread)
+    {
+        return;
+    }
+
+    level = rt_hw_interrupt_disable();
+    for (uint32_t i = 0; i < PROFILER_THREAD_MAX; i ++)
+    {
+        if (thread_tab[i].thread == (rt_thread_t)object)
+        {
+            memset(&thread_tab[i], 0, sizeof(thread_tab[i]));
+            break;
+        }
+    }
+    rt_hw_interrupt_enable(level);
+}
+#endif /* PROFILER_USING_THREAD */
+
+void prof_reset (void)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+
+    for (struct prof_probe *probe = probe_list; probe != RT_NULL; probe = probe->next)
+    {
+        prof_stat_init(&probe->stat);
+    }
+
+#ifdef PROFILER_USING_ISR
+    for (uint32_t i = 0; i < irq_used; i ++)
+    {
+        prof_stat_init(&irq_tab[i].stat);
+    }
+#endif
+
+#ifdef PROFILER_USING_THREAD
+    for (uint32_t i = 0; i < PROFILER_THREAD_MAX; i ++)
+    {
+        thread_tab[i].cycles = 0;
+        thread_tab[i].switches = 0;
+    }
+#endif
+
+    isr_total = 0;
+
+    rt_hw_interrupt_enable(level);
+}
+
+/* serialize the statistic as the u32 array: count, min, max, total(low, high), hist[PROFILER_HIST_BINS] */
+#define PROF_STAT_PACK_SIZE         ((5 + PROFILER_HIST_BINS) * sizeof(uint32_t))
+
+static uint16_t pack_stat (uint8_t *buffer, const struct prof_stat *stat)
+{
+    uint32_t words[5] = { stat->count, stat->min, stat->max, (uint32_t)stat->total, (uint32_t)(stat->total >> 32) };
+
+    memcpy(buffer, words, sizeof(words));
+    memcpy(buffer + sizeof(words), stat->hist, sizeof(stat->hist));
+
+    return PROF_STAT_PACK_SIZE;
+}
+
+static int export_record (prof_export_write_t write, void *arg, uint8_t type, const void *payload, uint16_t length)
+{
+    uint8_t head[4] = { type, 0, (uint8_t)length, (uint8_t)(length >> 8) };
+
+    if (write(head, sizeof(head), arg) != sizeof(head))
+    {
+        return -RT_ERROR;
+    }
+
+    if (write(payload, length, arg) != length)
+    {
+        return -RT_ERROR;
+    }
+
+    return RT_EOK;
+}
+
+/* export all the records in the binary format described in the profiler.h */
+int prof_export (prof_export_write_t write, void *arg)
+{
+    uint8_t payload[PROF_EXPORT_NAME_MAX + PROF_STAT_PACK_SIZE];
+    uint16_t length;
+    uint32_t header[3];
+    uint16_t count = 0;
+    struct prof_probe *probes;
+#ifdef PROFILER_USING_ISR
+    uint32_t irqs;
+#endif
+#ifdef PROFILER_USING_THREAD
+    uint32_t thread_mask[(PROFILER_THREAD_MAX + 31) / 32] = { 0 };
+#endif
+    rt_base_t level;
+
+    /*
+     * The records are chosen with the count under one lock, the header always matches them: the probe list only
+     * grows at its head and the irq table at its end, a thread slot counted is exported even if it is freed since.
+     */
+    level = rt_hw_interrupt_disable();
+    probes = probe_list;
+    for (struct prof_probe *probe = probes; probe != RT_NULL; probe = probe->next)
+    {
+        count ++;
+    }
+#ifdef PROFILER_USING_ISR
+    irqs = irq_used;
+    count += irqs;
+#endif
+#ifdef PROFILER_USING_THREAD
+    for (uint32_t i = 0; i < PROFILER_THREAD_MAX; i ++)
+    {
+        if (thread_tab[i].thread != RT_NULL)
+        {
+            thread_mask[i / 32] |= 1UL << (i % 32);
+            count ++;
+        }
+    }
+#endif
+    rt_hw_interrupt_enable(level);
+
+    header[0] = PROF_EXPORT_MAGIC;
+    header[1] = PROF_EXPORT_VERSION | ((uint32_t)count << 16);
+    header[2] = SystemCoreClock;
+    if (write(header, sizeof(header), arg) != sizeof(header))
+    {
+        return -RT_ERROR;
+    }
+
+    for (struct prof_probe *probe = probes; probe != RT_NULL; probe = probe->next)
+    {
+        memset(payload, 0, PROF_EXPORT_NAME_MAX);
+        strncpy((char *)payload, probe->name, PROF_EXPORT_NAME_MAX);
+        level = rt_hw_interrupt_disable();
+        length = PROF_EXPORT_NAME_MAX + pack_stat(payload + PROF_EXPORT_NAME_MAX, &probe->stat);
+        rt_hw_interrupt_enable(level);
+
+        if (export_record(write, arg, PROF_RECORD_PROBE, payload, length) != RT_EOK)
+        {
+            return -RT_ERROR;
+        }
+    }
+
+#ifdef PROFILER_USING_ISR
+    for (uint32_t i = 0; i < irqs; i ++)
+    {
+        level = rt_hw_interrupt_disable();
+        memcpy(payload, &irq_tab[i].irq, sizeof(uint32_t));
+        length = sizeof(uint32_t) + pack_stat(payload + sizeof(uint32_t), &irq_tab[i].stat);
+        rt_hw_interrupt_enable(level);
+
+        if (export_record(write, arg, PROF_RECORD_IRQ, payload, length) != RT_EOK)
+        {
+            return -RT_ERROR;
+        }
+    }
+#endif
+
+#ifdef PROFILER_USING_THREAD
+    for (uint32_t i = 0; i < PROFILER_THREAD_MAX; i ++)
+    {
+        if (!(thread_mask[i / 32] & (1UL << (i % 32))))
+        {
+            continue;
+        }
+
+        memset(payload, 0, PROF_EXPORT_NAME_MAX);
+        level = rt_hw_interrupt_disable();
+        strncpy((char *)payload, thread_tab[i].name, RT_NAME_MAX < PROF_EXPORT_NAME_MAX ? RT_NAME_MAX : PROF_EXPORT_NAME_MAX);
+        memcpy(payload + PROF_EXPORT_NAME_MAX, &thread_tab[i].cycles, sizeof(uint64_t));
+        memcpy(payload + PROF_EXPORT_NAME_MAX + sizeof(uint64_t), &thread_tab[i].switches, sizeof(uint32_t));
+        rt_hw_interrupt_enable(level);
+
+        if (export_record(write, arg, PROF_RECORD_THREAD, payload, PROF_EXPORT_NAME_MAX + sizeof(uint64_t) + sizeof(uint32_t)) != RT_EOK)
+        {
+            return -RT_ERROR;
+        }
+    }
+#endif
+
+    return RT_EOK;
+}
+
+static int prof_init (void)
+{
+#ifdef PROFILER_USING_ISR
+    rt_interrupt_enter_sethook(isr_enter_hook);
+    rt_interrupt_leave_sethook(isr_leave_hook);
+#endif
+
+#ifdef PROFILER_USING_THREAD
+    switch_stamp = get_cpu_tick();
+    rt_scheduler_sethook(scheduler_hook);
+    rt_object_detach_sethook(thread_detach_hook);
+#endif
+
+    return RT_EOK;
+}
+INIT_COMPONENT_EXPORT(prof_init);
+
+static void print_stat_head (const char *title)
+{
+    rt_kprintf("%-16s %10s %10s %10s %10s %10s\n", title, "count", "min", "avg", "max", "p99");
+}
+
+static void print_stat (const char *name, const struct prof_stat *stat)
+{
+    rt_kprintf("%-16.16s %10u %10u %10u %10u %10u\n", name, stat->count,
+               stat->count ? stat->min : 0, prof_stat_avg(stat), stat->max, prof_stat_percentile(stat, 99));
+}
+
+static void print_hist (const struct prof_stat *stat)
+{
+    for (uint32_t i = 0; i < PROFILER_HIST_BINS; i ++)
+    {
+        if (stat->hist[i] == 0)
+        {
+            continue;
+        }
+
+        if (prof_stat_hist_bin_limit(i) == UINT32_MAX)
+        {
+            rt_kprintf("  >= %-10u %u\n", prof_stat_hist_bin_limit(i - 1), stat->hist[i]);
+        }
+        else
+        {
+            rt_kprintf("  <  %-10u %u\n", prof_stat_hist_bin_limit(i), stat->hist[i]);
+        }
+    }
+}
+
+static void prof_print_probe (const char *name)
+{
+    struct prof_stat stat;
+    rt_base_t level;
+
+    print_stat_head("probe(cycles)");
+    for (struct prof_probe *probe = probe_list; probe != RT_NULL; probe = probe->next)
+    {
+        if (name != RT_NULL && strcmp(name, probe->name))
+        {
+            continue;
+        }
+
+        level = rt_hw_interrupt_disable();
+        stat = probe->stat;
+        rt_hw_interrupt_enable(level);
+
+        print_stat(probe->name, &stat);
+        if (name != RT_NULL)
+        {
+            print_hist(&stat);
+        }
+    }
+}
+
+#ifdef PROFILER_USING_ISR
+static void prof_print_irq (void)
+{
+    struct prof_stat stat;
+    char name[RT_NAME_MAX];
+    rt_base_t level;
+
+    print_stat_head("irq(cycles)");
+    for (uint32_t i = 0; i < irq_used; i ++)
+    {
+        level = rt_hw_interrupt_disable();
+        stat = irq_tab[i].stat;
+        rt_hw_interrupt_enable(level);
+
+        /* print the irq number (IRQn), the system exceptions are negative */
+        rt_snprintf(name, sizeof(name), "%d", (int)irq_tab[i].irq - 16);
+        print_stat(name, &stat);
+    }
+}
+#endif
+
+#ifdef PROFILER_USING_THREAD
+static void prof_print_thread (void)
+{
+    uint64_t total = isr_total;
+    rt_base_t level;
+
+    for (uint32_t i = 0; i < PROFILER_THREAD_MAX; i ++)
+    {
+        total += thread_tab[i].cycles;
+    }
+
+    rt_kprintf("%-16s %12s %10s %7s\n", "thread", "cycles(K)", "switches", "load");
+    for (uint32_t i = 0; i < PROFILER_THREAD_MAX; i ++)
+    {
+        struct prof_thread slot;
+
+        level = rt_hw_interrupt_disable();
+        slot = thread_tab[i];
+        rt_hw_interrupt_enable(level);
+
+        if (slot.thread == RT_NULL)
+        {
+            continue;
+        }
+
+        rt_kprintf("%-16.*s %12u %10u %6u%%\n", RT_NAME_MAX, slot.name, (uint32_t)(slot.cycles / 1000),
+                   slot.switches, total ? (uint32_t)(slot.cycles * 100 / total) : 0);
+    }
+    rt_kprintf("%-16s %12u %10s %6u%%\n", "(interrupt)", (uint32_t)(isr_total / 1000),
+               "-", total ? (uint32_t)(isr_total * 100 / total) : 0);
+}
+#endif
+
+#ifdef PROF_USING_RTT
+static int rtt_write (const void *data, size_t size, void *arg)
+{
+    return (int)SEGGER_RTT_Write(PROFILER_RTT_CHANNEL, data, size);
+}
+#else
+static int console_write (const void *data, size_t size, void *arg)
+{
+    for (size_t i = 0; i < size; i ++)
+    {
+        rt_kprintf("%02X", ((const uint8_t *)data)[i]);
+    }
+
+    return (int)size;
+}
+#endif
+
+static void prof_dump (void)
+{
+#ifdef PROF_USING_RTT
+    static uint8_t rtt_buffer[PROFILER_RTT_BUFFER_SIZE];
+    static rt_bool_t rtt_configured = RT_FALSE;
+
+    if (!rtt_configured)
+    {
+        /* never block the shell when no host is attached, the export fails if a record does not fit */
+        SEGGER_RTT_ConfigUpBuffer(PROFILER_RTT_CHANNEL, "prof", rtt_buffer, sizeof(rtt_buffer), SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+        rtt_configured = RT_TRUE;
+    }
+
+    if (prof_export(rtt_write, RT_NULL) != RT_EOK)
+    {
+        rt_kprintf("export to the rtt channel %d failed!\n", PROFILER_RTT_CHANNEL);
+    }
+#else
+    prof_export(console_write, RT_NULL);
+    rt_kprintf("\n");
+#endif
+}
+
+static void print_help (void)
+{
+    rt_kprintf("using: prof [command]\n");
+    rt_kprintf("the following is the command description:\n");
+    rt_kprintf("\tprobe\tprint the probe statistics. [name: print the histogram]\n");
+#ifdef PROFILER_USING_ISR
+    rt_kprintf("\tirq\tprint the interrupt service statistics.\n");
+#endif
+#ifdef PROFILER_USING_THREAD
+    rt_kprintf("\tthread\tprint the thread cpu usage.\n");
+#endif
+    rt_kprintf("\tdump\texport all the statistics in binary (rtt channel or hex on console).\n");
+    rt_kprintf("\treset\tclear all the statistics.\n");
+}
+
+static int prof_msh (int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        __help:
+        print_help();
+        return -RT_ERROR;
+    }
+
+    if (!strcmp("probe", argv[1]))
+    {
+        prof_print_probe(argc > 2 ? argv[2] : RT_NULL);
+    }
+#ifdef PROFILER_USING_ISR
+    else if (!strcmp("irq", argv[1]))
+    {
+        prof_print_irq();
+    }
+#endif
+#ifdef PROFILER_USING_THREAD
+    else if (!strcmp("thread", argv[1]))
+    {
+        prof_print_thread();
+    }
+#endif
+    else if (!strcmp("dump", argv[1]))
+    {
+        prof_dump();
+    }
+    else if (!strcmp("reset", argv[1]))
+    {
+        prof_reset();
+    }
+    else
+    {
+        goto __help;
+    }
+
+    return RT_EOK;
+}
+MSH_CMD_EXPORT_ALIAS(prof_msh, prof, cycle profiler command);
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2006-2024 LGT Development Team
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2024-10-19     Evlers       first implementation
+ */
+
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "prof_stat.h"
+
+#ifdef UTILITY_USING_PROFILER
+
+#include "delay.h"
+
+/* named probe, defined once by PROF_DEFINE and registered on the first record */
+struct prof_probe
+{
+    const char *name;
+    struct prof_stat stat;
+    struct prof_probe *next;
+    uint8_t registered;
+};
+
+#define PROF_DEFINE(name)       struct prof_probe prof_probe_##name = { #name }
+#define PROF_DECLARE(name)      extern struct prof_probe prof_probe_##name
+#define PROF_BEGIN(name)        uint32_t prof_start_##name = get_cpu_tick()
+#define PROF_END(name)          prof_probe_record(&prof_probe_##name, get_cpu_tick() - prof_start_##name)
+
+void prof_probe_record (struct prof_probe *probe, uint32_t cycles);
+void prof_reset (void);
+
+#else
+
+#define PROF_DEFINE(name)
+#define PROF_DECLARE(name)
+#define PROF_BEGIN(name)
+#define PROF_END(name)
+
+#endif /* UTILITY_USING_PROFILER */
+
+/*
+ * Binary export format (little endian), a header followed by the records:
+ * header: magic("PROF"), version(u16), record count(u16), core clock(u32)
+ * record: type(u8), reserved(u8), length of the payload(u16), payload
+ * stat  : u32 count, min, max, total low, total high, hist[PROFILER_HIST_BINS]
+ */
+#define PROF_EXPORT_MAGIC       0x464F5250
+#define PROF_EXPORT_VERSION     1
+
+enum prof_record_type
+{
+    PROF_RECORD_PROBE = 1,      /* name[16], stat */
+    PROF_RECORD_IRQ,            /* exception number(u32), stat */
+    PROF_RECORD_THREAD,         /* name[16], cycles(u64), switch count(u32) */
+};
+
+#define PROF_EXPORT_NAME_MAX    16
+
+typedef int (*prof_export_write_t)(const void *data, size_t size, void *arg);
+
+int prof_export (prof_export_write_t write, void *arg);
+
+#endif /* _PROFILER_H_ */